@@ -0,0 +1,1122 @@
+// Microbenchmarks of the CPU paths of the core library, in the style of Google Benchmark.
+//
+//   bench [--benchmark_filter=TEXT] [--benchmark_min_time=SECONDS] [--benchmark_list_tests]
+//
+// Every benchmark runs with a growing number of iterations until the run takes the minimum
+// time, then reports the wall and CPU time of an iteration of the last run. CPU time is the
+// process's, it includes the workers of the job system. The filter keeps the benchmarks whose
+// names contain the text.
+
+#include "block_compression.h"
+#include "draw_queue.h"
+#include "dynamic_buffer.h"
+#include "frame_arena.h"
+#include "frustum_culling.h"
+#include "job_system.h"
+#include "lz4.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "mip_generator.h"
+#include "null_backend.h"
+#include "parallel.h"
+#include "particle_system.h"
+#include "root_signature.h"
+#include "simd.h"
+#include "subresource_copy.h"
+#include "transform_hierarchy.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_MIN_TIME 0.5
+#define MAX_ITERATIONS 1000000000ull
+// Those of D3D12
+#define TEXTURE_PITCH_ALIGNMENT 256
+#define TEXTURE_PLACEMENT_ALIGNMENT 512
+
+typedef struct BenchState
+{
+    // Like state.range(0) and state.range(1), the second one is 0 for the cases with one
+    int64_t Argument;
+    int64_t SecondArgument;
+    uint64_t Iterations;
+    uint64_t Done;
+    bool Started;
+    double WallStart;
+    double WallSeconds;
+    clock_t CpuStart;
+    double CpuSeconds;
+    // Per iteration, reported as rates when set
+    uint64_t BytesProcessed;
+    uint64_t ItemsProcessed;
+    // Set when the setup failed, the benchmark is reported with it
+    const char* Error;
+} BenchState;
+
+typedef void (*BenchFunction)(BenchState* state);
+
+typedef struct BenchCase
+{
+    const char* Name;
+    BenchFunction Function;
+    int64_t Argument;
+    int64_t SecondArgument;
+} BenchCase;
+
+// Results are written to it so the work isn't optimized away
+static volatile uint64_t g_Sink;
+
+static double GetSeconds(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Times the loop it guards, like for (auto _ : state)
+static bool Bench_KeepRunning(BenchState* state)
+{
+    if (!state->Started)
+    {
+        state->Started = true;
+        state->CpuStart = clock();
+        state->WallStart = GetSeconds();
+    }
+    if (state->Done < state->Iterations)
+    {
+        state->Done++;
+        return true;
+    }
+    state->WallSeconds = GetSeconds() - state->WallStart;
+    state->CpuSeconds = (double)(clock() - state->CpuStart) / CLOCKS_PER_SEC;
+    return false;
+}
+
+// RGBA8 texture of Argument x Argument texels, the rows of the upload buffer padded to the
+// pitch alignment like GetCopyableFootprints does
+static void BM_SubresourceCopy(BenchState* state)
+{
+    uint32_t size = (uint32_t)state->Argument;
+    size_t rowSize = size * 4;
+    size_t rowPitch = (rowSize + TEXTURE_PITCH_ALIGNMENT - 1) / TEXTURE_PITCH_ALIGNMENT * TEXTURE_PITCH_ALIGNMENT;
+    uint8_t* source = malloc(rowSize * size);
+    uint8_t* destination = malloc(rowPitch * size);
+    if (source == NULL || destination == NULL)
+    {
+        state->Error = "out of memory";
+        free(source);
+        free(destination);
+        return;
+    }
+    memset(source, 0x5a, rowSize * size);
+
+    SubresourceData data = { source, (intptr_t)rowSize, (intptr_t)(rowSize * size) };
+    while (Bench_KeepRunning(state))
+        Subresource_Copy(destination, rowPitch, rowPitch * size, &data, rowSize, size, 1);
+    g_Sink = destination[rowPitch * (size - 1)];
+    state->BytesProcessed = rowSize * size;
+    free(source);
+    free(destination);
+}
+
+// The whole mip chain of an RGBA8 texture of Argument x Argument texels
+static void BM_SubresourceStage(BenchState* state)
+{
+    uint32_t size = (uint32_t)state->Argument;
+    uint32_t mipCount = 0;
+    while ((size >> mipCount) > 0)
+        ++mipCount;
+
+    SubresourceFootprint layouts[32];
+    uint32_t rowCounts[32];
+    uint64_t rowSizes[32];
+    SubresourceData sources[32];
+    uint64_t offset = 0;
+    size_t sourceSize = 0;
+    for (uint32_t i = 0; i < mipCount; ++i)
+    {
+        uint32_t mipSize = size >> i;
+        rowSizes[i] = mipSize * 4;
+        rowCounts[i] = mipSize;
+        uint32_t rowPitch = (uint32_t)((rowSizes[i] + TEXTURE_PITCH_ALIGNMENT - 1) / TEXTURE_PITCH_ALIGNMENT *
+                                       TEXTURE_PITCH_ALIGNMENT);
+        layouts[i] = (SubresourceFootprint){ offset, 28, mipSize, mipSize, 1, rowPitch };
+        offset += (uint64_t)rowPitch * mipSize;
+        offset = (offset + TEXTURE_PLACEMENT_ALIGNMENT - 1) / TEXTURE_PLACEMENT_ALIGNMENT * TEXTURE_PLACEMENT_ALIGNMENT;
+        sourceSize += (size_t)rowSizes[i] * mipSize;
+    }
+    uint8_t* source = malloc(sourceSize);
+    uint8_t* mapped = malloc((size_t)offset);
+    if (source == NULL || mapped == NULL)
+    {
+        state->Error = "out of memory";
+        free(source);
+        free(mapped);
+        return;
+    }
+    memset(source, 0x5a, sourceSize);
+    const uint8_t* mip = source;
+    for (uint32_t i = 0; i < mipCount; ++i)
+    {
+        sources[i] = (SubresourceData){ mip, (intptr_t)rowSizes[i], (intptr_t)(rowSizes[i] * rowCounts[i]) };
+        mip += rowSizes[i] * rowCounts[i];
+    }
+
+    while (Bench_KeepRunning(state))
+        Subresource_Stage(mapped, layouts, rowCounts, rowSizes, sources, mipCount);
+    g_Sink = mapped[layouts[mipCount - 1].Offset];
+    state->BytesProcessed = sourceSize;
+    free(source);
+    free(mapped);
+}
+
+// Argument parameters cycling through root constants, a CBV and a table of an SRV and a sampler
+// range, like the root signatures of the app
+static void BM_RootSignatureDowngrade(BenchState* state)
+{
+    uint32_t count = (uint32_t)state->Argument;
+    RootParameter1* parameters = calloc(count, sizeof(RootParameter1));
+    RootDescriptorRange1 ranges[2] = {
+        { .RangeType = 0, .NumDescriptors = 1, .Flags = 0x4, .OffsetInDescriptorsFromTableStart = 0xffffffff },
+        { .RangeType = 3, .NumDescriptors = 1 }
+    };
+    LinearArena arena;
+    if (parameters == NULL || !LinearArena_Create(&arena, 64 * 1024))
+    {
+        state->Error = "out of memory";
+        free(parameters);
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        parameters[i].ParameterType = i % 3 == 0 ? ROOT_PARAMETER_TYPE_32BIT_CONSTANTS :
+                                      i % 3 == 1 ? ROOT_PARAMETER_TYPE_CBV : ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+        if (parameters[i].ParameterType == ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+            parameters[i].Constants = (RootConstants){ .ShaderRegister = i, .Num32BitValues = 16 };
+        else if (parameters[i].ParameterType == ROOT_PARAMETER_TYPE_CBV)
+            parameters[i].Descriptor = (RootDescriptor1){ .ShaderRegister = i, .Flags = 0x8 };
+        else
+        {
+            parameters[i].DescriptorTable.NumDescriptorRanges = 2;
+            parameters[i].DescriptorTable.DescriptorRanges = ranges;
+        }
+    }
+    RootSignatureDesc1 desc = { count, parameters, 0, NULL, 0x1 };
+
+    while (Bench_KeepRunning(state))
+    {
+        ArenaMarker marker = LinearArena_GetMarker(&arena);
+        RootSignatureDesc result;
+        if (RootSignature_Downgrade(&desc, &arena, &result))
+            g_Sink = result.NumParameters;
+        LinearArena_Rollback(&arena, marker);
+    }
+    state->ItemsProcessed = count;
+    LinearArena_Destroy(&arena);
+    free(parameters);
+}
+
+static void ComposeViewProjection(mat4 viewProjection)
+{
+    vec3 eye = { 0.0f, 20.0f, -40.0f };
+    vec3 target = { 0.0f, 0.0f, 0.0f };
+    vec3 up = { 0.0f, 1.0f, 0.0f };
+    mat4 view, projection;
+    glm_lookat(eye, target, up, view);
+    glm_perspective(glm_rad(45.0f), 1280.0f / 720.0f, 0.1f, 100.0f, projection);
+    glm_mat4_mul(projection, view, viewProjection);
+}
+
+static void PoseInstance(uint32_t instance, uint64_t iteration, mat4 world)
+{
+    vec3 angles = { 0.001f * iteration, 0.01f * instance, 0.0f };
+    glm_euler(angles, world);
+    world[3][0] = (float)(instance % 100) - 50.0f;
+    world[3][2] = (float)(instance / 100);
+}
+
+// The instances posed with glm_euler, like UpdateBenchmarkMatrices does on every frame
+static void BM_PoseInstances(BenchState* state)
+{
+    uint32_t count = (uint32_t)state->Argument;
+    mat4* worlds = AlignedAlloc(count * sizeof(mat4), 32);
+    if (worlds == NULL)
+    {
+        state->Error = "out of memory";
+        return;
+    }
+    uint64_t iteration = 0;
+    while (Bench_KeepRunning(state))
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            PoseInstance(i, iteration, worlds[i]);
+        ++iteration;
+    }
+    g_Sink = (uint64_t)worlds[count - 1][0][0];
+    state->ItemsProcessed = count;
+    AlignedFree(worlds);
+}
+
+static bool CreateHierarchy(TransformHierarchy* hierarchy, uint32_t count)
+{
+    if (!TransformHierarchy_Create(hierarchy, count + 1))
+        return false;
+    mat4 identity;
+    glm_mat4_identity(identity);
+    int32_t root = TransformHierarchy_AddNode(hierarchy, TRANSFORM_NO_PARENT, identity);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        mat4 world;
+        PoseInstance(i, 0, world);
+        if (TransformHierarchy_AddNode(hierarchy, root, world) < 0)
+        {
+            TransformHierarchy_Destroy(hierarchy);
+            return false;
+        }
+    }
+    return true;
+}
+
+// What Simulate does with g_Context on the frames of an animated benchmark, every local matrix
+// changes and the world and MVP matrices are recomputed across the workers
+static void UpdateHierarchy(BenchState* state, bool naive)
+{
+    uint32_t count = (uint32_t)state->Argument;
+    TransformHierarchy hierarchy;
+    if (!CreateHierarchy(&hierarchy, count))
+    {
+        state->Error = "out of memory";
+        return;
+    }
+    mat4 viewProjection;
+    ComposeViewProjection(viewProjection);
+
+    uint64_t iteration = 0;
+    while (Bench_KeepRunning(state))
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            mat4 world;
+            PoseInstance(i, iteration, world);
+            TransformHierarchy_SetLocal(&hierarchy, i + 1, world);
+        }
+        if (naive)
+            TransformHierarchy_UpdateNaive(&hierarchy, viewProjection);
+        else
+            TransformHierarchy_Update(&hierarchy, viewProjection);
+        ++iteration;
+    }
+    g_Sink = (uint64_t)hierarchy.MvpMatrices[count][3][3];
+    state->ItemsProcessed = count;
+    TransformHierarchy_Destroy(&hierarchy);
+}
+
+static void BM_TransformHierarchyUpdate(BenchState* state)
+{
+    UpdateHierarchy(state, false);
+}
+
+static void BM_TransformHierarchyUpdateNaive(BenchState* state)
+{
+    UpdateHierarchy(state, true);
+}
+
+// A scene graph of Argument nodes, every node but the root with a parent eight children wide, so
+// 100000 nodes are 7 levels deep and a million 8. Every frame SecondArgument percent of the
+// nodes move, the update recomputes them with their subtrees under a still camera.
+static void BM_TransformHierarchySparseUpdate(BenchState* state)
+{
+    uint32_t count = (uint32_t)state->Argument;
+    uint32_t stride = (uint32_t)(100 / state->SecondArgument);
+    TransformHierarchy hierarchy;
+    if (!TransformHierarchy_Create(&hierarchy, count))
+    {
+        state->Error = "out of memory";
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        mat4 local;
+        PoseInstance(i, 0, local);
+        if (TransformHierarchy_AddNode(&hierarchy, i > 0 ? (int32_t)((i - 1) / 8) : TRANSFORM_NO_PARENT, local) < 0)
+        {
+            state->Error = "out of memory";
+            TransformHierarchy_Destroy(&hierarchy);
+            return;
+        }
+    }
+    mat4 viewProjection;
+    ComposeViewProjection(viewProjection);
+    TransformHierarchy_Update(&hierarchy, viewProjection);
+
+    uint64_t iteration = 0;
+    size_t updatedCount = 0;
+    while (Bench_KeepRunning(state))
+    {
+        // A different set of nodes every frame
+        for (uint32_t i = (uint32_t)(iteration % stride); i < count; i += stride)
+        {
+            mat4 local;
+            PoseInstance(i, iteration, local);
+            TransformHierarchy_SetLocal(&hierarchy, i, local);
+        }
+        TransformHierarchy_Update(&hierarchy, viewProjection);
+        updatedCount += hierarchy.LastUpdatedCount;
+        ++iteration;
+    }
+    g_Sink = updatedCount;
+    state->ItemsProcessed = count;
+    TransformHierarchy_Destroy(&hierarchy);
+}
+
+// The bounding spheres of the posed instances against the camera of the benchmarks, the rows
+// of the grid pulled closer so they span its depth range
+static void CullSpheres(BenchState* state, bool scalar)
+{
+    uint32_t count = (uint32_t)state->Argument;
+    SphereBounds bounds = { 0 };
+    uint32_t* visible = malloc(count * sizeof(uint32_t));
+    if (visible == NULL || !SphereBounds_Resize(&bounds, count))
+    {
+        state->Error = "out of memory";
+        free(visible);
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        mat4 world;
+        PoseInstance(i, 0, world);
+        bounds.X[i] = world[3][0];
+        bounds.Y[i] = world[3][1];
+        bounds.Z[i] = world[3][2] * 0.1f;
+        bounds.Radius[i] = 1.0f;
+    }
+    mat4 viewProjection;
+    ComposeViewProjection(viewProjection);
+    Frustum frustum;
+    Frustum_FromViewProjection(&frustum, viewProjection);
+
+    size_t visibleCount = 0;
+    while (Bench_KeepRunning(state))
+    {
+        visibleCount = scalar ? FrustumCullSpheresScalar(&frustum, &bounds, visible) :
+                                FrustumCullSpheres(&frustum, &bounds, visible);
+    }
+    g_Sink = visibleCount;
+    state->ItemsProcessed = count;
+    SphereBounds_Release(&bounds);
+    free(visible);
+}
+
+static void BM_FrustumCullSpheres(BenchState* state)
+{
+    CullSpheres(state, false);
+}
+
+static void BM_FrustumCullSpheresScalar(BenchState* state)
+{
+    CullSpheres(state, true);
+}
+
+// Packets of a frame with a few passes and pipelines, many materials and meshes and spread
+// depths, so no radix pass is skipped. Every iteration sorts a copy of the unsorted packets,
+// the copy is timed as well.
+static void SortDrawQueue(BenchState* state, bool scalar)
+{
+    size_t count = (size_t)state->Argument;
+    DrawQueue queue;
+    DrawPacket* unsorted = malloc(count * sizeof(DrawPacket));
+    if (unsorted == NULL || !DrawQueue_Create(&queue, count))
+    {
+        state->Error = "out of memory";
+        free(unsorted);
+        return;
+    }
+    uint32_t random = 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        random = random * 1664525u + 1013904223u;
+        uint32_t bits = random;
+        random = random * 1664525u + 1013904223u;
+        uint64_t key = DrawKey_Pack(bits % 3, (bits >> 2) % 16, (bits >> 6) % 2000, (bits >> 17) % 500, random >> 8);
+        unsorted[i] = (DrawPacket){ .Key = key, .Instance = (uint32_t)i, .Range = bits % 4 };
+    }
+
+    while (Bench_KeepRunning(state))
+    {
+        memcpy(queue.Packets, unsorted, count * sizeof(DrawPacket));
+        queue.Count = count;
+        if (scalar)
+            DrawQueue_SortScalar(&queue);
+        else
+            DrawQueue_Sort(&queue);
+    }
+    g_Sink = queue.Packets[0].Instance;
+    state->ItemsProcessed = count;
+    DrawQueue_Destroy(&queue);
+    free(unsorted);
+}
+
+static void BM_DrawQueueSort(BenchState* state)
+{
+    SortDrawQueue(state, false);
+}
+
+static void BM_DrawQueueSortScalar(BenchState* state)
+{
+    SortDrawQueue(state, true);
+}
+
+#define SCALING_JOB_COUNT 1024
+#define SCALING_JOB_STEPS 4096
+
+static void SpinJob(void* userData)
+{
+    uint64_t* result = userData;
+    uint64_t x = *result | 1;
+    for (int i = 0; i < SCALING_JOB_STEPS; ++i)
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    *result = x;
+}
+
+// The same batch of small jobs run by the main thread and Argument workers. The job system is
+// restarted with them, the other benchmarks get back the one of main.
+static void BM_JobSystemScaling(BenchState* state)
+{
+    Parallel_Shutdown();
+    if (!JobSystem_Initialise((uint32_t)state->Argument) || JobSystem_GetThreadCount() != state->Argument + 1)
+    {
+        state->Error = "couldn't start the workers";
+        JobSystem_Shutdown();
+        Parallel_Initialise(0);
+        return;
+    }
+
+    static uint64_t results[SCALING_JOB_COUNT * 8];
+    JobDecl jobs[SCALING_JOB_COUNT];
+    for (size_t i = 0; i < SCALING_JOB_COUNT; ++i)
+    {
+        // A cache line each, so the workers don't share them
+        results[i * 8] = i;
+        jobs[i] = (JobDecl){ SpinJob, &results[i * 8] };
+    }
+    while (Bench_KeepRunning(state))
+    {
+        JobCounter counter;
+        atomic_init(&counter.Pending, 0);
+        JobSystem_Run(jobs, SCALING_JOB_COUNT, &counter);
+        JobSystem_Wait(&counter);
+    }
+    g_Sink = results[0];
+    state->ItemsProcessed = SCALING_JOB_COUNT;
+
+    JobSystem_Shutdown();
+    if (!Parallel_Initialise(0))
+        exit(EXIT_FAILURE);
+}
+
+#define UPLOAD_REGION_SIZE (4 * 1024 * 1024)
+#define UPLOAD_REGION_COUNT 3
+
+// A frame of writes of Argument bytes each filling the region of the frame, the way the
+// debug lines and the particles are streamed to the upload buffer. The memory is cached here
+// rather than write-combined.
+static void BM_DynamicBufferWrite(BenchState* state)
+{
+    size_t size = (size_t)state->Argument;
+    uint8_t* memory = AlignedAlloc(UPLOAD_REGION_SIZE * UPLOAD_REGION_COUNT, 64);
+    uint8_t* source = AlignedAlloc(size, 64);
+    if (memory == NULL || source == NULL)
+    {
+        state->Error = "out of memory";
+        AlignedFree(memory);
+        AlignedFree(source);
+        return;
+    }
+    memset(source, 0x5a, size);
+    DynamicBuffer buffer;
+    DynamicBuffer_Init(&buffer, memory, 0, UPLOAD_REGION_SIZE, UPLOAD_REGION_COUNT);
+
+    uint32_t frame = 0;
+    while (Bench_KeepRunning(state))
+    {
+        DynamicBuffer_BeginFrame(&buffer, frame++ % UPLOAD_REGION_COUNT);
+        uint64_t gpuAddress;
+        while (DynamicBuffer_Write(&buffer, source, size, 16, &gpuAddress) != NULL)
+            ;
+        StreamFence();
+    }
+    g_Sink = buffer.Offset;
+    state->BytesProcessed = UPLOAD_REGION_SIZE / size * size;
+    AlignedFree(source);
+    AlignedFree(memory);
+}
+
+// A step of Argument particles that all survive it, their billboards streamed out
+static void UpdateParticles(BenchState* state, bool scalar)
+{
+    size_t count = (size_t)state->Argument;
+    ParticleEmitter emitter = {
+        .Position = { 0.0f, 0.0f, 0.0f },
+        .Velocity = { 0.0f, 4.0f, 0.0f },
+        .Spread = 1.0f,
+        .Rate = 0.0f,
+        .MinLifetime = 1e6f,
+        .MaxLifetime = 1e6f,
+        .StartSize = 0.05f,
+        .EndSize = 0.1f,
+        .Color = 0xFFFFFFFFu
+    };
+    ParticleForces forces = { .Gravity = { 0.0f, -9.81f, 0.0f }, .Drag = 0.5f };
+    ParticleSystem system;
+    ParticleInstance* instances = AlignedAlloc(count * sizeof(ParticleInstance), 64);
+    if (instances == NULL || !ParticleSystem_Create(&system, count, &emitter))
+    {
+        state->Error = "out of memory";
+        AlignedFree(instances);
+        return;
+    }
+    ParticleSystem_Emit(&system, count);
+
+    size_t liveCount = 0;
+    while (Bench_KeepRunning(state))
+    {
+        liveCount = scalar ? ParticleSystem_UpdateScalar(&system, &forces, 1.0f / 60.0f, instances) :
+                             ParticleSystem_Update(&system, &forces, 1.0f / 60.0f, instances);
+    }
+    g_Sink = liveCount;
+    state->ItemsProcessed = count;
+    ParticleSystem_Destroy(&system);
+    AlignedFree(instances);
+}
+
+static void BM_ParticleUpdate(BenchState* state)
+{
+    UpdateParticles(state, false);
+}
+
+static void BM_ParticleUpdateScalar(BenchState* state)
+{
+    UpdateParticles(state, true);
+}
+
+// Culling and submitting the instances of a grid to the null backend, without capturing
+static void BM_NullBackendSubmit(BenchState* state)
+{
+    uint32_t count = (uint32_t)state->Argument;
+    mat4* worlds = AlignedAlloc(count * sizeof(mat4), 32);
+    NullBackend backend;
+    if (worlds == NULL || !NullBackend_Create(&backend, NULL))
+    {
+        state->Error = "out of memory";
+        AlignedFree(worlds);
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+        PoseInstance(i, 0, worlds[i]);
+    mat4 viewProjection;
+    ComposeViewProjection(viewProjection);
+
+    uint64_t frame = 0;
+    while (Bench_KeepRunning(state))
+        NullBackend_SubmitFrame(&backend, frame++, viewProjection, (const NullMatrix*)worlds, count);
+    g_Sink = backend.SubmittedDraws;
+    state->ItemsProcessed = count;
+    NullBackend_Destroy(&backend);
+    AlignedFree(worlds);
+}
+
+typedef struct GridMesh
+{
+    float* Positions;
+    uint32_t* Indices;
+    size_t VertexCount;
+    size_t IndexCount;
+} GridMesh;
+
+static void GridMesh_Release(GridMesh* mesh)
+{
+    free(mesh->Positions);
+    free(mesh->Indices);
+    mesh->Positions = NULL;
+    mesh->Indices = NULL;
+}
+
+// A rolling height field of size x size vertices, its triangles shuffled like those of a mesh
+// exported without any optimization
+static bool CreateGrid(GridMesh* mesh, uint32_t size)
+{
+    mesh->VertexCount = (size_t)size * size;
+    mesh->IndexCount = (size_t)(size - 1) * (size - 1) * 6;
+    mesh->Positions = malloc(mesh->VertexCount * 3 * sizeof(float));
+    mesh->Indices = malloc(mesh->IndexCount * sizeof(uint32_t));
+    if (mesh->Positions == NULL || mesh->Indices == NULL)
+    {
+        GridMesh_Release(mesh);
+        return false;
+    }
+
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            float* p = &mesh->Positions[((size_t)y * size + x) * 3];
+            p[0] = (float)x;
+            p[1] = (float)y;
+            p[2] = 4.0f * sinf(x * 0.05f) * cosf(y * 0.07f);
+        }
+    }
+    uint32_t* index = mesh->Indices;
+    for (uint32_t y = 0; y + 1 < size; ++y)
+    {
+        for (uint32_t x = 0; x + 1 < size; ++x)
+        {
+            uint32_t v = y * size + x;
+            uint32_t quad[6] = { v, v + size, v + 1, v + 1, v + size, v + size + 1 };
+            memcpy(index, quad, sizeof(quad));
+            index += 6;
+        }
+    }
+
+    uint32_t random = 1;
+    for (size_t t = mesh->IndexCount / 3 - 1; t > 0; --t)
+    {
+        random = random * 1664525u + 1013904223u;
+        size_t other = random % (t + 1);
+        uint32_t triangle[3];
+        memcpy(triangle, &mesh->Indices[t * 3], sizeof(triangle));
+        memcpy(&mesh->Indices[t * 3], &mesh->Indices[other * 3], sizeof(triangle));
+        memcpy(&mesh->Indices[other * 3], triangle, sizeof(triangle));
+    }
+    return true;
+}
+
+// Forsyth's triangle order of a grid of Argument x Argument vertices
+static void BM_OptimizeVertexCache(BenchState* state)
+{
+    GridMesh mesh;
+    uint32_t* optimized = NULL;
+    if (!CreateGrid(&mesh, (uint32_t)state->Argument) ||
+        (optimized = malloc(mesh.IndexCount * sizeof(uint32_t))) == NULL)
+    {
+        state->Error = "out of memory";
+        GridMesh_Release(&mesh);
+        return;
+    }
+
+    while (Bench_KeepRunning(state))
+        OptimizeVertexCache(optimized, mesh.Indices, mesh.IndexCount, mesh.VertexCount);
+    g_Sink = optimized[0];
+    state->ItemsProcessed = mesh.IndexCount / 3;
+    free(optimized);
+    GridMesh_Release(&mesh);
+}
+
+// The cache, overdraw and fetch passes the app runs on its meshes at startup. They work in
+// place, every iteration restores the grid first
+static void BM_OptimizeMesh(BenchState* state)
+{
+    GridMesh mesh;
+    uint32_t* indices = NULL;
+    float* positions = NULL;
+    if (!CreateGrid(&mesh, (uint32_t)state->Argument) ||
+        (indices = malloc(mesh.IndexCount * sizeof(uint32_t))) == NULL ||
+        (positions = malloc(mesh.VertexCount * 3 * sizeof(float))) == NULL)
+    {
+        state->Error = "out of memory";
+        free(indices);
+        GridMesh_Release(&mesh);
+        return;
+    }
+
+    MeshOptimizationStats stats = { 0 };
+    while (Bench_KeepRunning(state))
+    {
+        memcpy(indices, mesh.Indices, mesh.IndexCount * sizeof(uint32_t));
+        memcpy(positions, mesh.Positions, mesh.VertexCount * 3 * sizeof(float));
+        if (!OptimizeMesh(indices, mesh.IndexCount, positions, mesh.VertexCount, 3 * sizeof(float), 0, &stats))
+            state->Error = "out of memory";
+    }
+    g_Sink = stats.UniqueVertexCount;
+    state->ItemsProcessed = mesh.IndexCount / 3;
+    free(indices);
+    free(positions);
+    GridMesh_Release(&mesh);
+}
+
+// Half the triangles of a grid of Argument x Argument vertices, bounded by the target alone
+static void BM_SimplifyMesh(BenchState* state)
+{
+    GridMesh mesh;
+    uint32_t* simplified = NULL;
+    if (!CreateGrid(&mesh, (uint32_t)state->Argument) ||
+        (simplified = malloc(mesh.IndexCount * sizeof(uint32_t))) == NULL)
+    {
+        state->Error = "out of memory";
+        GridMesh_Release(&mesh);
+        return;
+    }
+
+    size_t count = 0;
+    while (Bench_KeepRunning(state))
+    {
+        float error;
+        count = SimplifyMesh(simplified, mesh.Indices, mesh.IndexCount, mesh.Positions, 3 * sizeof(float),
+                             mesh.VertexCount, mesh.IndexCount / 2, FLT_MAX, &error);
+    }
+    g_Sink = count;
+    state->ItemsProcessed = mesh.IndexCount / 3;
+    free(simplified);
+    GridMesh_Release(&mesh);
+}
+
+// Every level of detail of a grid like the app builds them for its meshes
+static void BM_BuildLodChain(BenchState* state)
+{
+    GridMesh mesh;
+    if (!CreateGrid(&mesh, (uint32_t)state->Argument))
+    {
+        state->Error = "out of memory";
+        return;
+    }
+
+    while (Bench_KeepRunning(state))
+    {
+        LodChain chain;
+        if (!BuildLodChain(mesh.Indices, mesh.IndexCount, mesh.Positions, 3 * sizeof(float), mesh.VertexCount,
+                           LOD_MAX_LEVELS, 0.5f, 1.0f, &chain))
+        {
+            state->Error = "out of memory";
+            continue;
+        }
+        g_Sink = chain.IndexCount;
+        LodChain_Release(&chain);
+    }
+    state->ItemsProcessed = mesh.IndexCount / 3;
+    GridMesh_Release(&mesh);
+}
+
+// RGBA8 image of size x size texels, smooth gradients with a little noise like a photo
+static uint8_t* CreateImage(uint32_t size)
+{
+    uint8_t* rgba = malloc((size_t)size * size * 4);
+    if (rgba == NULL)
+        return NULL;
+    uint32_t random = 1;
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            random = random * 1664525u + 1013904223u;
+            uint8_t* texel = &rgba[((size_t)y * size + x) * 4];
+            texel[0] = (uint8_t)(128.0f + 100.0f * sinf(x * 0.02f) + (random >> 28));
+            texel[1] = (uint8_t)(128.0f + 100.0f * cosf(y * 0.03f) + (random >> 28));
+            texel[2] = (uint8_t)((x + y) * 255 / (2 * size));
+            texel[3] = (uint8_t)(x * 255 / size);
+        }
+    }
+    return rgba;
+}
+
+// The full sRGB box filtered chain of an Argument x Argument image, like the texture compressor
+static void GenerateImageMips(BenchState* state, bool scalar)
+{
+    uint32_t size = (uint32_t)state->Argument;
+    uint8_t* rgba = CreateImage(size);
+    if (rgba == NULL)
+    {
+        state->Error = "out of memory";
+        return;
+    }
+
+    while (Bench_KeepRunning(state))
+    {
+        MipChain chain;
+        bool generated = scalar ? GenerateMipsScalar(rgba, size, size, (size_t)size * 4, true, MIP_FILTER_BOX, 0, &chain) :
+                                  GenerateMips(rgba, size, size, (size_t)size * 4, true, MIP_FILTER_BOX, 0, &chain);
+        if (!generated)
+        {
+            state->Error = "out of memory";
+            continue;
+        }
+        g_Sink = chain.Levels[chain.LevelCount - 1].Rgba[0];
+        MipChain_Release(&chain);
+    }
+    state->BytesProcessed = (uint64_t)size * size * 4;
+    free(rgba);
+}
+
+static void BM_GenerateMips(BenchState* state)
+{
+    GenerateImageMips(state, false);
+}
+
+static void BM_GenerateMipsScalar(BenchState* state)
+{
+    GenerateImageMips(state, true);
+}
+
+// An Argument x Argument image to the blocks of a BC format
+static void CompressImageTo(BenchState* state, TextureFormat format)
+{
+    uint32_t size = (uint32_t)state->Argument;
+    uint8_t* rgba = CreateImage(size);
+    uint8_t* blocks = malloc(TextureFormat_GetRowPitch(format, size) * TextureFormat_GetRowCount(format, size));
+    if (rgba == NULL || blocks == NULL)
+    {
+        state->Error = "out of memory";
+        free(rgba);
+        free(blocks);
+        return;
+    }
+
+    while (Bench_KeepRunning(state))
+    {
+        CompressImage(rgba, size, size, (size_t)size * 4, format, blocks);
+        g_Sink = blocks[0];
+    }
+    state->BytesProcessed = (uint64_t)size * size * 4;
+    free(blocks);
+    free(rgba);
+}
+
+static void BM_CompressBc1(BenchState* state)
+{
+    CompressImageTo(state, TEXTURE_FORMAT_BC1);
+}
+
+static void BM_CompressBc7(BenchState* state)
+{
+    CompressImageTo(state, TEXTURE_FORMAT_BC7);
+}
+
+// Records that repeat with small changes, about as compressible as the meshes and the tables
+// of the asset archive
+static uint8_t* CreateAssetData(size_t size)
+{
+    uint8_t* data = malloc(size);
+    if (data == NULL)
+        return NULL;
+    uint32_t random = 1;
+    for (size_t i = 0; i < size; ++i)
+    {
+        random = random * 1664525u + 1013904223u;
+        data[i] = (random >> 24) < 32 ? (uint8_t)(random >> 16) : (uint8_t)(i / 16 + (i % 16) * 3);
+    }
+    return data;
+}
+
+// Compressing Argument bytes of asset data, like the asset packer
+static void BM_Lz4Compress(BenchState* state)
+{
+    size_t size = (size_t)state->Argument;
+    size_t capacity = Lz4_GetMaxCompressedSize(size);
+    uint8_t* data = CreateAssetData(size);
+    uint8_t* compressed = malloc(capacity);
+    if (data == NULL || compressed == NULL)
+    {
+        state->Error = "out of memory";
+        free(data);
+        free(compressed);
+        return;
+    }
+
+    while (Bench_KeepRunning(state))
+        g_Sink = Lz4_Compress(data, size, compressed, capacity);
+    state->BytesProcessed = size;
+    free(compressed);
+    free(data);
+}
+
+// Decompressing them back, like a decoder of the asset streamer. The rate is of the
+// decompressed bytes.
+static void BM_Lz4Decompress(BenchState* state)
+{
+    size_t size = (size_t)state->Argument;
+    size_t capacity = Lz4_GetMaxCompressedSize(size);
+    uint8_t* data = CreateAssetData(size);
+    uint8_t* compressed = malloc(capacity);
+    uint8_t* decompressed = malloc(size);
+    size_t compressedSize = 0;
+    if (data != NULL && compressed != NULL && decompressed != NULL)
+        compressedSize = Lz4_Compress(data, size, compressed, capacity);
+    if (compressedSize == 0)
+    {
+        state->Error = "out of memory";
+        free(data);
+        free(compressed);
+        free(decompressed);
+        return;
+    }
+
+    while (Bench_KeepRunning(state))
+    {
+        if (!Lz4_Decompress(compressed, compressedSize, decompressed, size))
+            state->Error = "corrupt data";
+        g_Sink = decompressed[size - 1];
+    }
+    state->BytesProcessed = size;
+    free(decompressed);
+    free(compressed);
+    free(data);
+}
+
+static const BenchCase g_Cases[] = {
+    { "BM_SubresourceCopy", BM_SubresourceCopy, 256, 0 },
+    { "BM_SubresourceCopy", BM_SubresourceCopy, 1000, 0 },
+    { "BM_SubresourceCopy", BM_SubresourceCopy, 2048, 0 },
+    { "BM_SubresourceStage", BM_SubresourceStage, 1024, 0 },
+    { "BM_RootSignatureDowngrade", BM_RootSignatureDowngrade, 4, 0 },
+    { "BM_RootSignatureDowngrade", BM_RootSignatureDowngrade, 64, 0 },
+    { "BM_PoseInstances", BM_PoseInstances, 10000, 0 },
+    { "BM_TransformHierarchyUpdate", BM_TransformHierarchyUpdate, 1000, 0 },
+    { "BM_TransformHierarchyUpdate", BM_TransformHierarchyUpdate, 10000, 0 },
+    { "BM_TransformHierarchyUpdateNaive", BM_TransformHierarchyUpdateNaive, 10000, 0 },
+    { "BM_TransformHierarchySparseUpdate", BM_TransformHierarchySparseUpdate, 100000, 1 },
+    { "BM_TransformHierarchySparseUpdate", BM_TransformHierarchySparseUpdate, 100000, 10 },
+    { "BM_TransformHierarchySparseUpdate", BM_TransformHierarchySparseUpdate, 100000, 100 },
+    { "BM_TransformHierarchySparseUpdate", BM_TransformHierarchySparseUpdate, 1000000, 1 },
+    { "BM_TransformHierarchySparseUpdate", BM_TransformHierarchySparseUpdate, 1000000, 10 },
+    { "BM_TransformHierarchySparseUpdate", BM_TransformHierarchySparseUpdate, 1000000, 100 },
+    { "BM_FrustumCullSpheres", BM_FrustumCullSpheres, 100000, 0 },
+    { "BM_FrustumCullSpheresScalar", BM_FrustumCullSpheresScalar, 100000, 0 },
+    { "BM_DrawQueueSort", BM_DrawQueueSort, 100000, 0 },
+    { "BM_DrawQueueSort", BM_DrawQueueSort, 1000000, 0 },
+    { "BM_DrawQueueSortScalar", BM_DrawQueueSortScalar, 1000000, 0 },
+    { "BM_JobSystemScaling", BM_JobSystemScaling, 1, 0 },
+    { "BM_JobSystemScaling", BM_JobSystemScaling, 2, 0 },
+    { "BM_JobSystemScaling", BM_JobSystemScaling, 4, 0 },
+    { "BM_JobSystemScaling", BM_JobSystemScaling, 8, 0 },
+    { "BM_DynamicBufferWrite", BM_DynamicBufferWrite, 64, 0 },
+    { "BM_DynamicBufferWrite", BM_DynamicBufferWrite, 4096, 0 },
+    { "BM_DynamicBufferWrite", BM_DynamicBufferWrite, 65536, 0 },
+    { "BM_ParticleUpdate", BM_ParticleUpdate, 100000, 0 },
+    { "BM_ParticleUpdate", BM_ParticleUpdate, 1000000, 0 },
+    { "BM_ParticleUpdateScalar", BM_ParticleUpdateScalar, 1000000, 0 },
+    { "BM_NullBackendSubmit", BM_NullBackendSubmit, 1000, 0 },
+    { "BM_NullBackendSubmit", BM_NullBackendSubmit, 10000, 0 },
+    { "BM_OptimizeVertexCache", BM_OptimizeVertexCache, 256, 0 },
+    { "BM_OptimizeVertexCache", BM_OptimizeVertexCache, 1024, 0 },
+    { "BM_OptimizeMesh", BM_OptimizeMesh, 512, 0 },
+    { "BM_SimplifyMesh", BM_SimplifyMesh, 256, 0 },
+    { "BM_SimplifyMesh", BM_SimplifyMesh, 512, 0 },
+    { "BM_BuildLodChain", BM_BuildLodChain, 128, 0 },
+    { "BM_GenerateMips", BM_GenerateMips, 1024, 0 },
+    { "BM_GenerateMipsScalar", BM_GenerateMipsScalar, 1024, 0 },
+    { "BM_CompressBc1", BM_CompressBc1, 512, 0 },
+    { "BM_CompressBc7", BM_CompressBc7, 512, 0 },
+    { "BM_Lz4Compress", BM_Lz4Compress, 1 << 20, 0 },
+    { "BM_Lz4Decompress", BM_Lz4Decompress, 1 << 20, 0 },
+};
+
+// Runs with more iterations until a run takes the minimum time, false when the setup failed
+static bool Run(const BenchCase* benchCase, double minTime, BenchState* state)
+{
+    uint64_t iterations = 1;
+    for (;;)
+    {
+        *state = (BenchState){ .Argument = benchCase->Argument, .SecondArgument = benchCase->SecondArgument,
+                               .Iterations = iterations };
+        benchCase->Function(state);
+        if (state->Error != NULL)
+            return false;
+        if (state->WallSeconds >= minTime || iterations >= MAX_ITERATIONS)
+            return true;
+
+        // Aims past the minimum time, at most ten times the iterations at once
+        double multiplier = state->WallSeconds > 0.0 ? minTime * 1.4 / state->WallSeconds : 10.0;
+        multiplier = multiplier > 10.0 ? 10.0 : multiplier;
+        uint64_t next = (uint64_t)(iterations * multiplier);
+        iterations = next > iterations ? next : iterations + 1;
+        iterations = iterations < MAX_ITERATIONS ? iterations : MAX_ITERATIONS;
+    }
+}
+
+static void FormatRate(char* buffer, size_t size, double rate, const char* unit)
+{
+    const char* prefixes[] = { "", "k", "M", "G", "T" };
+    int prefix = 0;
+    while (rate >= 1000.0 && prefix < 4)
+    {
+        rate /= 1000.0;
+        ++prefix;
+    }
+    snprintf(buffer, size, "%.3f%s%s", rate, prefixes[prefix], unit);
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = "";
+    double minTime = DEFAULT_MIN_TIME;
+    bool list = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "--benchmark_filter=", 19) == 0)
+            filter = argv[i] + 19;
+        else if (strncmp(argv[i], "--benchmark_min_time=", 21) == 0 && atof(argv[i] + 21) > 0.0)
+            minTime = atof(argv[i] + 21);
+        else if (strcmp(argv[i], "--benchmark_list_tests") == 0)
+            list = true;
+        else
+        {
+            fprintf(stderr, "usage: bench [--benchmark_filter=TEXT] [--benchmark_min_time=SECONDS] "
+                            "[--benchmark_list_tests]\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!list && !Parallel_Initialise(0))
+    {
+        fprintf(stderr, "Couldn't start the job system\n");
+        return EXIT_FAILURE;
+    }
+    if (!list)
+    {
+        printf("Running on %u threads\n", Parallel_GetThreadCount());
+        printf("%-44s %15s %15s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+    }
+
+    bool failed = false;
+    for (size_t i = 0; i < sizeof(g_Cases) / sizeof(g_Cases[0]); ++i)
+    {
+        char name[128];
+        if (g_Cases[i].SecondArgument != 0)
+            snprintf(name, sizeof(name), "%s/%lld/%lld", g_Cases[i].Name, (long long)g_Cases[i].Argument,
+                     (long long)g_Cases[i].SecondArgument);
+        else
+            snprintf(name, sizeof(name), "%s/%lld", g_Cases[i].Name, (long long)g_Cases[i].Argument);
+        if (strstr(name, filter) == NULL)
+            continue;
+        if (list)
+        {
+            printf("%s\n", name);
+            continue;
+        }
+
+        BenchState state;
+        if (!Run(&g_Cases[i], minTime, &state))
+        {
+            printf("%-44s ERROR: %s\n", name, state.Error);
+            failed = true;
+            continue;
+        }
+        double iterations = (double)state.Iterations;
+        char counters[64] = "";
+        if (state.BytesProcessed > 0)
+            FormatRate(counters, sizeof(counters), state.BytesProcessed * iterations / state.WallSeconds, "B/s");
+        else if (state.ItemsProcessed > 0)
+            FormatRate(counters, sizeof(counters), state.ItemsProcessed * iterations / state.WallSeconds, " items/s");
+        printf("%-44s %12.0f ns %12.0f ns %12llu %s%s\n", name, state.WallSeconds * 1e9 / iterations,
+               state.CpuSeconds * 1e9 / iterations, (unsigned long long)state.Iterations,
+               state.BytesProcessed > 0 ? "bytes_per_second=" : state.ItemsProcessed > 0 ? "items_per_second=" : "",
+               counters);
+    }
+
+    if (!list)
+        Parallel_Shutdown();
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
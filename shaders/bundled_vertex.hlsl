@@ -0,0 +1,39 @@
+// Like textured_vertex.hlsl, but the MVP of the node is read from the buffer of the frame, so
+// the bundles recorded from the draws stay valid while the camera and the nodes move
+
+struct DrawConstants
+{
+    // Index of the node into the matrices
+    uint Node;
+};
+
+struct ModelViewProjection
+{
+    column_major matrix MVP;
+};
+
+ConstantBuffer<DrawConstants> DrawCB : register(b0);
+StructuredBuffer<ModelViewProjection> ModelViewProjections : register(t1);
+
+struct VertexInput
+{
+    float3 Position : POSITION;
+    float3 Color : COLOR;
+};
+
+struct VertexOutput
+{
+    float4 Color : COLOR;
+    // Quantized position in [0, 1], the same for every level of detail
+    float3 MapPosition : TEXCOORD;
+    float4 Position : SV_Position;
+};
+
+VertexOutput main(VertexInput input)
+{
+    VertexOutput output;
+    output.Color = float4(input.Color, 1.0f);
+    output.MapPosition = input.Position;
+    output.Position = mul(ModelViewProjections[DrawCB.Node].MVP, float4(input.Position, 1.0f));
+    return output;
+}
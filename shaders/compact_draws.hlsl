@@ -0,0 +1,31 @@
+// Last culling pass, writes the draws of the visible instances in instance order
+
+#include "gpu_culling.hlsli"
+
+groupshared uint g_Visible[GROUP_SIZE];
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void main(uint3 dispatchThreadId : SV_DispatchThreadID, uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+    uint instance = dispatchThreadId.x;
+    uint visibility = instance < InstanceCount ? Visibility[instance] : 0;
+    g_Visible[groupIndex] = visibility != 0 ? 1 : 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    if (visibility == 0)
+        return;
+
+    uint index = GroupData[GetGroupCount() + groupId.x];
+    for (uint i = 0; i < groupIndex; ++i)
+        index += g_Visible[i];
+
+    LodLevel level = Levels[visibility - 1];
+    DrawCommand command;
+    command.Mvp = Instances[instance].Mvp;
+    command.IndexCountPerInstance = level.IndexCount;
+    command.InstanceCount = 1;
+    command.StartIndexLocation = level.IndexOffset;
+    command.BaseVertexLocation = 0;
+    command.StartInstanceLocation = 0;
+    Commands[index] = command;
+}
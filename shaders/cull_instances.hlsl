@@ -0,0 +1,27 @@
+// First culling pass, decides the visibility of every instance and counts the visible
+// ones of each group
+
+#include "gpu_culling.hlsli"
+
+groupshared uint g_VisibleCount;
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void main(uint3 dispatchThreadId : SV_DispatchThreadID, uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+    if (groupIndex == 0)
+        g_VisibleCount = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    uint instance = dispatchThreadId.x;
+    if (instance < InstanceCount)
+    {
+        uint visibility = CullInstance(Instances[instance].Bounds);
+        Visibility[instance] = visibility;
+        if (visibility != 0)
+            InterlockedAdd(g_VisibleCount, 1);
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (groupIndex == 0)
+        GroupData[groupId.x] = g_VisibleCount;
+}
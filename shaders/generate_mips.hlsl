@@ -0,0 +1,66 @@
+// Box filters one mip level into the next, the GPU side of GenerateMips in src/mip_generator.c.
+// Every destination texel averages the source texels it covers weighted by the overlap, so
+// odd sizes are exact as well. The source view of an sRGB texture decodes on load and the
+// destination is a UNORM view of the same texels, so the color is encoded here.
+
+#define GROUP_SIZE 8
+
+cbuffer MipConstants : register(b0)
+{
+    uint2 SourceSize;
+    uint2 DestinationSize;
+    uint Srgb;
+};
+
+Texture2D<float4> Source : register(t0);
+RWTexture2D<float4> Destination : register(u0);
+
+// Source texels the destination texel covers along one axis, and the overlap of the first
+// and last one
+void GetCoverage(uint destination, uint sourceSize, uint destinationSize,
+                 out uint first, out uint last, out float firstWeight, out float lastWeight)
+{
+    float scale = (float)sourceSize / (float)destinationSize;
+    float begin = destination * scale;
+    float end = (destination + 1) * scale;
+    first = (uint)begin;
+    last = min((uint)ceil(end), sourceSize) - 1;
+    firstWeight = first + 1 - begin;
+    lastWeight = end - last;
+}
+
+float3 EncodeSrgb(float3 value)
+{
+    value = saturate(value);
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+[numthreads(GROUP_SIZE, GROUP_SIZE, 1)]
+void main(uint3 threadId : SV_DispatchThreadID)
+{
+    if (any(threadId.xy >= DestinationSize))
+        return;
+
+    uint firstX, lastX, firstY, lastY;
+    float firstWeightX, lastWeightX, firstWeightY, lastWeightY;
+    GetCoverage(threadId.x, SourceSize.x, DestinationSize.x, firstX, lastX, firstWeightX, lastWeightX);
+    GetCoverage(threadId.y, SourceSize.y, DestinationSize.y, firstY, lastY, firstWeightY, lastWeightY);
+
+    float4 sum = 0.0f;
+    float weightSum = 0.0f;
+    for (uint y = firstY; y <= lastY; ++y)
+    {
+        float weightY = y == firstY ? firstWeightY : y == lastY ? lastWeightY : 1.0f;
+        for (uint x = firstX; x <= lastX; ++x)
+        {
+            float weight = weightY * (x == firstX ? firstWeightX : x == lastX ? lastWeightX : 1.0f);
+            sum += weight * Source.Load(int3(x, y, 0));
+            weightSum += weight;
+        }
+    }
+
+    float4 color = sum / weightSum;
+    if (Srgb != 0)
+        color.rgb = EncodeSrgb(color.rgb);
+    Destination[threadId.xy] = color;
+}
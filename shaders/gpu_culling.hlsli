@@ -0,0 +1,84 @@
+// Shared by the GPU culling passes, keep in sync with src/gpu_culling.h
+
+#define GROUP_SIZE 64
+#define SCAN_THREADS 256
+#define MIN_DEPTH 1e-3f
+
+struct LodLevel
+{
+    uint IndexOffset;
+    uint IndexCount;
+    float ErrorScale;
+    uint Padding;
+};
+
+cbuffer CullConstants : register(b0)
+{
+    float4 Planes[6];
+    float4 ViewDepthRow;
+    float ProjectionScale;
+    float PixelThreshold;
+    uint InstanceCount;
+    uint LevelCount;
+    LodLevel Levels[8];
+};
+
+// The MVP is only copied, rows of floats keep the bytes as the CPU wrote them
+struct Instance
+{
+    float4 Mvp[4];
+    float4 Bounds;
+};
+
+struct DrawCommand
+{
+    float4 Mvp[4];
+    uint IndexCountPerInstance;
+    uint InstanceCount;
+    uint StartIndexLocation;
+    int BaseVertexLocation;
+    uint StartInstanceLocation;
+};
+
+StructuredBuffer<Instance> Instances : register(t0);
+RWStructuredBuffer<DrawCommand> Commands : register(u0);
+RWStructuredBuffer<uint> DrawCount : register(u1);
+// Level of detail plus one per instance, 0 when culled
+RWStructuredBuffer<uint> Visibility : register(u2);
+// Visible instances per group followed by the offset of each group
+RWStructuredBuffer<uint> GroupData : register(u3);
+
+uint GetGroupCount()
+{
+    return (InstanceCount + GROUP_SIZE - 1) / GROUP_SIZE;
+}
+
+// Mirrors CullInstance in src/gpu_culling.c operation for operation, precise keeps the
+// compiler from fusing or reordering so the CPU reference matches bit for bit
+uint CullInstance(float4 bounds)
+{
+    float radius = bounds.w;
+
+    [unroll]
+    for (int p = 0; p < 6; ++p)
+    {
+        precise float distance = ((Planes[p].x * bounds.x + Planes[p].y * bounds.y) + Planes[p].z * bounds.z) + Planes[p].w;
+        if (distance < -radius)
+            return 0;
+    }
+
+    precise float viewDepth = ((ViewDepthRow.x * bounds.x + ViewDepthRow.y * bounds.y) + ViewDepthRow.z * bounds.z) + ViewDepthRow.w;
+    precise float depth = max(viewDepth - radius, MIN_DEPTH);
+    precise float limit = PixelThreshold * depth;
+
+    uint level = 0;
+    for (uint i = 1; i < LevelCount; ++i)
+    {
+        precise float error = (Levels[i].ErrorScale * radius) * ProjectionScale;
+        if (error > limit)
+            break;
+        level = i;
+    }
+
+    return level + 1;
+}
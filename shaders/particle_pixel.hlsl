@@ -0,0 +1,13 @@
+// Round particle with a soft edge, blended additively so the particles need no sorting
+
+struct PixelInput
+{
+    float4 Color : COLOR;
+    float2 Corner : TEXCOORD;
+};
+
+float4 main(PixelInput input) : SV_Target
+{
+    float falloff = saturate(1.0f - dot(input.Corner, input.Corner));
+    return float4(input.Color.rgb * input.Color.a * falloff, 0.0f);
+}
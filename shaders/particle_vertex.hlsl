@@ -0,0 +1,40 @@
+// Expands every particle instance into a camera facing quad, drawn as a 4 vertex strip
+
+struct ParticleConstants
+{
+    matrix ViewProjection;
+    // Projection matrix scale of x and y, turns a view space size into a clip space offset
+    float2 ProjectionScale;
+};
+
+ConstantBuffer<ParticleConstants> Constants : register(b0);
+
+struct VertexInput
+{
+    float3 Position : POSITION;
+    float Size : SIZE;
+    float4 Color : COLOR;
+    uint VertexId : SV_VertexID;
+};
+
+struct VertexOutput
+{
+    float4 Color : COLOR;
+    float2 Corner : TEXCOORD;
+    float4 Position : SV_Position;
+};
+
+VertexOutput main(VertexInput input)
+{
+    float2 corner = float2((input.VertexId >> 1) * 2.0f - 1.0f, (input.VertexId & 1) * 2.0f - 1.0f);
+
+    // Offset in clip space, w is the view depth so the quad keeps its size in the world
+    float4 position = mul(Constants.ViewProjection, float4(input.Position, 1.0f));
+    position.xy += corner * input.Size * Constants.ProjectionScale;
+
+    VertexOutput output;
+    output.Color = input.Color;
+    output.Corner = corner;
+    output.Position = position;
+    return output;
+}
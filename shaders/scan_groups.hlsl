@@ -0,0 +1,42 @@
+// Second culling pass, a single group turning the visible counts of the groups into
+// output offsets and writing the total draw count
+
+#include "gpu_culling.hlsli"
+
+groupshared uint g_Sums[SCAN_THREADS];
+
+[numthreads(SCAN_THREADS, 1, 1)]
+void main(uint groupIndex : SV_GroupIndex)
+{
+    // Every thread sums a contiguous run of groups
+    uint groupCount = GetGroupCount();
+    uint runLength = (groupCount + SCAN_THREADS - 1) / SCAN_THREADS;
+    uint first = groupIndex * runLength;
+    uint last = min(first + runLength, groupCount);
+
+    uint sum = 0;
+    for (uint i = first; i < last; ++i)
+        sum += GroupData[i];
+    g_Sums[groupIndex] = sum;
+    GroupMemoryBarrierWithGroupSync();
+
+    // Inclusive scan of the run sums
+    [unroll]
+    for (uint offset = 1; offset < SCAN_THREADS; offset *= 2)
+    {
+        uint value = groupIndex >= offset ? g_Sums[groupIndex - offset] : 0;
+        GroupMemoryBarrierWithGroupSync();
+        g_Sums[groupIndex] += value;
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    uint groupOffset = g_Sums[groupIndex] - sum;
+    for (uint j = first; j < last; ++j)
+    {
+        GroupData[groupCount + j] = groupOffset;
+        groupOffset += GroupData[j];
+    }
+
+    if (groupIndex == SCAN_THREADS - 1)
+        DrawCount[0] = g_Sums[groupIndex];
+}
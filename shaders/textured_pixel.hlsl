@@ -0,0 +1,20 @@
+// Box maps the texture along the axis the face points to, tinted by the vertex color
+
+Texture2D Albedo : register(t0);
+SamplerState LinearSampler : register(s0);
+
+struct PixelInput
+{
+    float4 Color : COLOR;
+    float3 MapPosition : TEXCOORD;
+};
+
+float4 main(PixelInput input) : SV_Target
+{
+    // Faces are flat, so the derivatives of the position give their normal
+    float3 normal = abs(cross(ddx(input.MapPosition), ddy(input.MapPosition)));
+    float2 uv = normal.x > max(normal.y, normal.z) ? input.MapPosition.yz :
+                normal.y > normal.z ? input.MapPosition.xz : input.MapPosition.xy;
+
+    return Albedo.Sample(LinearSampler, uv) * input.Color;
+}
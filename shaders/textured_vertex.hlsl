@@ -0,0 +1,31 @@
+// Passes the quantized position on to the pixel shader, which maps the texture from it
+
+struct ModelViewProjection
+{
+    matrix MVP;
+};
+
+ConstantBuffer<ModelViewProjection> ModelViewProjectionCB : register(b0);
+
+struct VertexInput
+{
+    float3 Position : POSITION;
+    float3 Color : COLOR;
+};
+
+struct VertexOutput
+{
+    float4 Color : COLOR;
+    // Quantized position in [0, 1], the same for every level of detail
+    float3 MapPosition : TEXCOORD;
+    float4 Position : SV_Position;
+};
+
+VertexOutput main(VertexInput input)
+{
+    VertexOutput output;
+    output.Color = float4(input.Color, 1.0f);
+    output.MapPosition = input.Position;
+    output.Position = mul(ModelViewProjectionCB.MVP, float4(input.Position, 1.0f));
+    return output;
+}
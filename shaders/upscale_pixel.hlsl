@@ -0,0 +1,24 @@
+// Stretches the scene drawn at a lower resolution over the back buffer with a bilinear filter
+
+struct UpscaleConstants
+{
+    // Part of the color target the scene covers, and the last texel centre within it
+    float2 UvScale;
+    float2 UvClamp;
+};
+
+ConstantBuffer<UpscaleConstants> Constants : register(b0);
+Texture2D<float4> Scene : register(t0);
+SamplerState LinearSampler : register(s0);
+
+struct PixelInput
+{
+    float2 Uv : TEXCOORD;
+};
+
+float4 main(PixelInput input) : SV_Target
+{
+    // Clamped so the filter never blends in what's left in the target past the scene
+    float2 uv = min(input.Uv * Constants.UvScale, Constants.UvClamp);
+    return Scene.SampleLevel(LinearSampler, uv, 0);
+}
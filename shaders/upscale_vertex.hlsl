@@ -0,0 +1,18 @@
+// A triangle covering the whole target, generated from the vertex IDs without any vertex buffer
+
+struct VertexOutput
+{
+    float2 Uv : TEXCOORD;
+    float4 Position : SV_Position;
+};
+
+VertexOutput main(uint vertexId : SV_VertexID)
+{
+    // (0, 0), (2, 0) and (0, 2) in texture space, the part past 1 is clipped
+    float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+
+    VertexOutput output;
+    output.Uv = uv;
+    output.Position = float4(uv.x * 2.0f - 1.0f, 1.0f - uv.y * 2.0f, 0.0f, 1.0f);
+    return output;
+}
@@ -0,0 +1,312 @@
+#ifndef _WIN32
+// fseeko with 64-bit offsets
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "asset_archive.h"
+#include "lz4.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FNV_OFFSET_64 0xCBF29CE484222325ull
+#define FNV_PRIME_64 0x100000001B3ull
+#define CHECKSUM_LANES 4
+
+typedef struct AssetArchiveHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t SlotCount;
+    uint32_t EntryCount;
+    uint32_t NamesSize;
+    uint32_t Padding;
+} AssetArchiveHeader;
+
+uint64_t AssetArchive_HashName(const char* name)
+{
+    uint64_t hash = FNV_OFFSET_64;
+    for (; *name != '\0'; ++name)
+        hash = (hash ^ (uint8_t)*name) * FNV_PRIME_64;
+    // 0 marks the empty slots
+    return hash != 0 ? hash : 1;
+}
+
+static uint64_t Read64(const uint8_t* bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static uint64_t Mix(uint64_t hash, uint64_t value)
+{
+    hash = (hash ^ value) * FNV_PRIME_64;
+    return hash ^ (hash >> 29);
+}
+
+uint32_t AssetArchive_Checksum(const void* data, size_t size)
+{
+    // FNV-1a over 8 byte words in 4 independent lanes, a byte at a time it's slower than LZ4.
+    // The shift folds the high bits back, as the multiply only carries upwards.
+    const uint8_t* bytes = data;
+    uint64_t lanes[CHECKSUM_LANES] = { FNV_OFFSET_64, FNV_OFFSET_64 + 1, FNV_OFFSET_64 + 2, FNV_OFFSET_64 + 3 };
+    size_t i = 0;
+    for (; i + CHECKSUM_LANES * sizeof(uint64_t) <= size; i += CHECKSUM_LANES * sizeof(uint64_t))
+    {
+        for (int lane = 0; lane < CHECKSUM_LANES; ++lane)
+            lanes[lane] = Mix(lanes[lane], Read64(bytes + i + lane * sizeof(uint64_t)));
+    }
+
+    uint64_t hash = Mix(FNV_OFFSET_64, size);
+    for (int lane = 0; lane < CHECKSUM_LANES; ++lane)
+        hash = Mix(hash, lanes[lane]);
+    for (; i < size; ++i)
+        hash = Mix(hash, bytes[i]);
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+bool AssetArchive_Seek(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// The size of the file, leaving it at the start, 0 when it can't be told
+static uint64_t GetFileSize(FILE* file)
+{
+#ifdef _WIN32
+    long long size = _fseeki64(file, 0, SEEK_END) == 0 ? _ftelli64(file) : -1;
+#else
+    off_t size = fseeko(file, 0, SEEK_END) == 0 ? ftello(file) : -1;
+#endif
+    return AssetArchive_Seek(file, 0) && size > 0 ? (uint64_t)size : 0;
+}
+
+bool AssetArchive_Open(const char* path, AssetArchive* archive)
+{
+    memset(archive, 0, sizeof(*archive));
+    archive->File = fopen(path, "rb");
+    if (archive->File == NULL)
+        return false;
+
+    uint64_t fileSize = GetFileSize(archive->File);
+    // The table of contents and the names have to fit the file before anything is allocated
+    AssetArchiveHeader header;
+    bool opened = fread(&header, sizeof(header), 1, archive->File) == 1 && header.Magic == ASSET_ARCHIVE_MAGIC &&
+                  header.Version == ASSET_ARCHIVE_VERSION && header.SlotCount > 0 &&
+                  (header.SlotCount & (header.SlotCount - 1)) == 0 && header.EntryCount < header.SlotCount &&
+                  fileSize >= sizeof(header) &&
+                  (uint64_t)header.SlotCount * sizeof(AssetEntry) + header.NamesSize <= fileSize - sizeof(header);
+    if (opened)
+    {
+        archive->SlotCount = header.SlotCount;
+        archive->EntryCount = header.EntryCount;
+        archive->NamesSize = header.NamesSize;
+        archive->Slots = malloc((size_t)header.SlotCount * sizeof(AssetEntry));
+        archive->Names = malloc((size_t)header.NamesSize + 1);
+        archive->Path = malloc(strlen(path) + 1);
+        opened = archive->Slots != NULL && archive->Names != NULL && archive->Path != NULL &&
+                 fread(archive->Slots, sizeof(AssetEntry), header.SlotCount, archive->File) == header.SlotCount &&
+                 fread(archive->Names, 1, header.NamesSize, archive->File) == header.NamesSize;
+    }
+    if (opened)
+    {
+        // A name running past the end still ends there
+        archive->Names[archive->NamesSize] = '\0';
+        strcpy(archive->Path, path);
+        // Lookups rely on an empty slot to stop at
+        uint32_t entryCount = 0;
+        for (uint32_t i = 0; opened && i < archive->SlotCount; ++i)
+        {
+            const AssetEntry* entry = &archive->Slots[i];
+            entryCount += entry->NameHash != 0;
+            // The bytes of an entry lie within the file
+            opened = entry->NameHash == 0 || (entry->NameOffset < archive->NamesSize &&
+                     entry->Offset <= fileSize && entry->CompressedSize <= fileSize - entry->Offset &&
+                     (entry->Codec == ASSET_CODEC_NONE ? entry->CompressedSize == entry->Size : entry->Codec == ASSET_CODEC_LZ4));
+        }
+        opened = opened && entryCount == archive->EntryCount;
+    }
+
+    if (!opened)
+        AssetArchive_Close(archive);
+    return opened;
+}
+
+void AssetArchive_Close(AssetArchive* archive)
+{
+    if (archive->File != NULL)
+        fclose(archive->File);
+    free(archive->Slots);
+    free(archive->Names);
+    free(archive->Path);
+    memset(archive, 0, sizeof(*archive));
+}
+
+const AssetEntry* AssetArchive_Find(const AssetArchive* archive, const char* name)
+{
+    uint64_t hash = AssetArchive_HashName(name);
+    uint32_t mask = archive->SlotCount - 1;
+    // At least one slot is empty, so the probe ends
+    for (uint32_t slot = (uint32_t)hash & mask;; slot = (slot + 1) & mask)
+    {
+        const AssetEntry* entry = &archive->Slots[slot];
+        if (entry->NameHash == 0)
+            return NULL;
+        if (entry->NameHash == hash && strcmp(archive->Names + entry->NameOffset, name) == 0)
+            return entry;
+    }
+}
+
+const char* AssetArchive_GetName(const AssetArchive* archive, const AssetEntry* entry)
+{
+    return archive->Names + entry->NameOffset;
+}
+
+bool AssetArchive_Decode(const AssetEntry* entry, const void* compressed, void* destination)
+{
+    bool decoded = true;
+    if (entry->Codec == ASSET_CODEC_LZ4)
+        decoded = Lz4_Decompress(compressed, entry->CompressedSize, destination, entry->Size);
+    else
+        memcpy(destination, compressed, entry->Size);
+    return decoded && AssetArchive_Checksum(destination, entry->Size) == entry->Checksum;
+}
+
+bool AssetArchive_Read(AssetArchive* archive, const AssetEntry* entry, void* destination)
+{
+    // Stored blobs are read in place
+    void* compressed = entry->Codec == ASSET_CODEC_NONE ? destination : malloc(entry->CompressedSize);
+    bool read = compressed != NULL && AssetArchive_Seek(archive->File, entry->Offset) &&
+                fread(compressed, 1, entry->CompressedSize, archive->File) == entry->CompressedSize;
+    if (read && entry->Codec != ASSET_CODEC_NONE)
+        read = AssetArchive_Decode(entry, compressed, destination);
+    else if (read)
+        read = AssetArchive_Checksum(destination, entry->Size) == entry->Checksum;
+
+    if (compressed != destination)
+        free(compressed);
+    return read;
+}
+
+void AssetArchiveWriter_Create(AssetArchiveWriter* writer)
+{
+    memset(writer, 0, sizeof(*writer));
+}
+
+void AssetArchiveWriter_Destroy(AssetArchiveWriter* writer)
+{
+    free(writer->Entries);
+    free(writer->Names);
+    free(writer->Data);
+    memset(writer, 0, sizeof(*writer));
+}
+
+// Grows a buffer to hold at least size bytes, doubling it
+static bool Reserve(void** buffer, size_t* capacity, size_t size)
+{
+    if (size <= *capacity)
+        return true;
+    size_t newCapacity = *capacity > 0 ? *capacity : 4096;
+    while (newCapacity < size)
+        newCapacity *= 2;
+    void* newBuffer = realloc(*buffer, newCapacity);
+    if (newBuffer == NULL)
+        return false;
+    *buffer = newBuffer;
+    *capacity = newCapacity;
+    return true;
+}
+
+bool AssetArchiveWriter_Add(AssetArchiveWriter* writer, const char* name, const void* data, size_t size,
+                            AssetCodec codec)
+{
+    uint64_t hash = AssetArchive_HashName(name);
+    for (uint32_t i = 0; i < writer->EntryCount; ++i)
+    {
+        if (writer->Entries[i].NameHash == hash && strcmp(writer->Names + writer->Entries[i].NameOffset, name) == 0)
+            return false;
+    }
+
+    size_t nameSize = strlen(name) + 1;
+    size_t entriesSize = ((size_t)writer->EntryCount + 1) * sizeof(AssetEntry);
+    size_t entriesCapacity = (size_t)writer->EntryCapacity * sizeof(AssetEntry);
+    size_t bound = codec == ASSET_CODEC_LZ4 ? Lz4_GetMaxCompressedSize(size) : size;
+    if (size > UINT32_MAX || writer->NamesSize + nameSize > UINT32_MAX ||
+        !Reserve((void**)&writer->Entries, &entriesCapacity, entriesSize) ||
+        !Reserve((void**)&writer->Names, &writer->NamesCapacity, writer->NamesSize + nameSize) ||
+        !Reserve((void**)&writer->Data, &writer->DataCapacity, writer->DataSize + bound))
+        return false;
+    writer->EntryCapacity = (uint32_t)(entriesCapacity / sizeof(AssetEntry));
+
+    uint8_t* blob = writer->Data + writer->DataSize;
+    size_t compressedSize = codec == ASSET_CODEC_LZ4 ? Lz4_Compress(data, size, blob, bound) : 0;
+    if (compressedSize == 0 || compressedSize >= size)
+    {
+        codec = ASSET_CODEC_NONE;
+        compressedSize = size;
+        memcpy(blob, data, size);
+    }
+
+    AssetEntry* entry = &writer->Entries[writer->EntryCount++];
+    *entry = (AssetEntry){
+        .NameHash = hash,
+        // Relative to the first blob until the archive is saved
+        .Offset = writer->DataSize,
+        .CompressedSize = (uint32_t)compressedSize,
+        .Size = (uint32_t)size,
+        .NameOffset = (uint32_t)writer->NamesSize,
+        .Codec = codec,
+        .Checksum = AssetArchive_Checksum(data, size)
+    };
+    memcpy(writer->Names + writer->NamesSize, name, nameSize);
+    writer->NamesSize += nameSize;
+    writer->DataSize += compressedSize;
+    return true;
+}
+
+bool AssetArchiveWriter_Save(const AssetArchiveWriter* writer, const char* path)
+{
+    // At most half full, so probes stay short and always reach an empty slot
+    uint32_t slotCount = 1;
+    while (slotCount < writer->EntryCount * 2 + 1)
+        slotCount *= 2;
+
+    AssetEntry* slots = calloc(slotCount, sizeof(AssetEntry));
+    if (slots == NULL)
+        return false;
+
+    uint64_t dataOffset = sizeof(AssetArchiveHeader) + (uint64_t)slotCount * sizeof(AssetEntry) + writer->NamesSize;
+    for (uint32_t i = 0; i < writer->EntryCount; ++i)
+    {
+        AssetEntry entry = writer->Entries[i];
+        entry.Offset += dataOffset;
+        uint32_t slot = (uint32_t)entry.NameHash & (slotCount - 1);
+        while (slots[slot].NameHash != 0)
+            slot = (slot + 1) & (slotCount - 1);
+        slots[slot] = entry;
+    }
+
+    AssetArchiveHeader header = {
+        .Magic = ASSET_ARCHIVE_MAGIC,
+        .Version = ASSET_ARCHIVE_VERSION,
+        .SlotCount = slotCount,
+        .EntryCount = writer->EntryCount,
+        .NamesSize = (uint32_t)writer->NamesSize
+    };
+
+    FILE* file = fopen(path, "wb");
+    bool written = file != NULL && fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(slots, sizeof(AssetEntry), slotCount, file) == slotCount &&
+                   (writer->NamesSize == 0 || fwrite(writer->Names, 1, writer->NamesSize, file) == writer->NamesSize) &&
+                   (writer->DataSize == 0 || fwrite(writer->Data, 1, writer->DataSize, file) == writer->DataSize);
+    if (file != NULL)
+        written = fclose(file) == 0 && written;
+    free(slots);
+    return written;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Packed asset archive:
+//   header, table of contents, names, blobs
+// The table of contents is an open addressing hash table keyed by the 64-bit FNV-1a hash of
+// the name, with a power of two slot count, so a lookup probes a slot or two and no name is
+// compared until the hashes match. Everything is little endian.
+
+#define ASSET_ARCHIVE_MAGIC 0x4B504448u // "HDPK"
+#define ASSET_ARCHIVE_VERSION 1
+
+typedef enum AssetCodec
+{
+    ASSET_CODEC_NONE,
+    ASSET_CODEC_LZ4
+} AssetCodec;
+
+// A slot of the table of contents, empty when NameHash is 0
+typedef struct AssetEntry
+{
+    uint64_t NameHash;
+    uint64_t Offset;
+    uint32_t CompressedSize;
+    uint32_t Size;
+    // Into the names, which are null terminated
+    uint32_t NameOffset;
+    uint32_t Codec;
+    // AssetArchive_Checksum of the decompressed bytes
+    uint32_t Checksum;
+    uint32_t Padding;
+} AssetEntry;
+
+typedef struct AssetArchive
+{
+    FILE* File;
+    uint32_t SlotCount;
+    uint32_t EntryCount;
+    AssetEntry* Slots;
+    char* Names;
+    uint32_t NamesSize;
+    char* Path;
+} AssetArchive;
+
+// Reads the table of contents and keeps the file open for AssetArchive_Read
+bool AssetArchive_Open(const char* path, AssetArchive* archive);
+void AssetArchive_Close(AssetArchive* archive);
+
+// NULL when the archive doesn't hold the name
+const AssetEntry* AssetArchive_Find(const AssetArchive* archive, const char* name);
+const char* AssetArchive_GetName(const AssetArchive* archive, const AssetEntry* entry);
+
+// Reads and decompresses an entry on the calling thread, destination holds entry->Size bytes.
+// Not safe to call from several threads at once, the streamer opens the file on its own.
+bool AssetArchive_Read(AssetArchive* archive, const AssetEntry* entry, void* destination);
+
+// Decompresses the bytes of an entry as stored in the file and checks them against the checksum
+bool AssetArchive_Decode(const AssetEntry* entry, const void* compressed, void* destination);
+
+uint64_t AssetArchive_HashName(const char* name);
+// 32-bit hash of the decompressed bytes, for catching corrupt or truncated files
+uint32_t AssetArchive_Checksum(const void* data, size_t size);
+
+// Seeks to an absolute offset, past 2GB as well
+bool AssetArchive_Seek(FILE* file, uint64_t offset);
+
+// Builds an archive in memory, the blobs are compressed as they're added
+typedef struct AssetArchiveWriter
+{
+    AssetEntry* Entries;
+    uint32_t EntryCount;
+    uint32_t EntryCapacity;
+    char* Names;
+    size_t NamesSize;
+    size_t NamesCapacity;
+    uint8_t* Data;
+    size_t DataSize;
+    size_t DataCapacity;
+} AssetArchiveWriter;
+
+void AssetArchiveWriter_Create(AssetArchiveWriter* writer);
+void AssetArchiveWriter_Destroy(AssetArchiveWriter* writer);
+
+// Blobs that don't get smaller are stored as they are. Fails on a duplicate name.
+bool AssetArchiveWriter_Add(AssetArchiveWriter* writer, const char* name, const void* data, size_t size,
+                            AssetCodec codec);
+bool AssetArchiveWriter_Save(const AssetArchiveWriter* writer, const char* path);
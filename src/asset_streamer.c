@@ -0,0 +1,252 @@
+#include "asset_streamer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void AssetQueue_Push(AssetQueue* queue, AssetRequest* request)
+{
+    request->Next = NULL;
+    if (queue->Tail != NULL)
+        queue->Tail->Next = request;
+    else
+        queue->Head = request;
+    queue->Tail = request;
+}
+
+static AssetRequest* AssetQueue_Pop(AssetQueue* queue)
+{
+    AssetRequest* request = queue->Head;
+    if (request != NULL)
+    {
+        queue->Head = request->Next;
+        if (queue->Head == NULL)
+            queue->Tail = NULL;
+    }
+    return request;
+}
+
+// Request of the highest priority, NULL when every queue is empty
+static AssetRequest* PopFirst(AssetQueue queues[ASSET_PRIORITY_COUNT])
+{
+    for (int i = 0; i < ASSET_PRIORITY_COUNT; ++i)
+    {
+        AssetRequest* request = AssetQueue_Pop(&queues[i]);
+        if (request != NULL)
+            return request;
+    }
+    return NULL;
+}
+
+static bool IsEmpty(const AssetQueue queues[ASSET_PRIORITY_COUNT])
+{
+    for (int i = 0; i < ASSET_PRIORITY_COUNT; ++i)
+    {
+        if (queues[i].Head != NULL)
+            return false;
+    }
+    return true;
+}
+
+static int ReaderMain(void* argument)
+{
+    AssetStreamer* streamer = argument;
+
+    mtx_lock(&streamer->Mutex);
+    for (;;)
+    {
+        // Something always gets read, however large, once the decoders caught up
+        while (!streamer->Quit && (IsEmpty(streamer->ReadQueues) ||
+               (streamer->BufferedBytes > 0 && streamer->BufferedBytes >= ASSET_STREAMER_MAX_BUFFERED)))
+            cnd_wait(&streamer->ReadCondition, &streamer->Mutex);
+        if (streamer->Quit)
+            break;
+
+        AssetRequest* request = PopFirst(streamer->ReadQueues);
+        mtx_unlock(&streamer->Mutex);
+
+        const AssetEntry* entry = request->Entry;
+        request->Compressed = malloc(entry->CompressedSize > 0 ? entry->CompressedSize : 1);
+        bool read = request->Compressed != NULL && AssetArchive_Seek(streamer->File, entry->Offset) &&
+                    fread(request->Compressed, 1, entry->CompressedSize, streamer->File) == entry->CompressedSize;
+        if (!read)
+        {
+            free(request->Compressed);
+            request->Compressed = NULL;
+        }
+
+        mtx_lock(&streamer->Mutex);
+        if (read)
+        {
+            streamer->BufferedBytes += entry->CompressedSize;
+            AssetQueue_Push(&streamer->DecodeQueues[request->Priority], request);
+            cnd_signal(&streamer->DecodeCondition);
+        }
+        else
+            AssetQueue_Push(&streamer->Completed, request);
+    }
+    mtx_unlock(&streamer->Mutex);
+    return 0;
+}
+
+static int DecoderMain(void* argument)
+{
+    AssetStreamer* streamer = argument;
+
+    mtx_lock(&streamer->Mutex);
+    for (;;)
+    {
+        while (!streamer->ReaderDone && IsEmpty(streamer->DecodeQueues))
+            cnd_wait(&streamer->DecodeCondition, &streamer->Mutex);
+        AssetRequest* request = PopFirst(streamer->DecodeQueues);
+        if (request == NULL)
+            break;
+        mtx_unlock(&streamer->Mutex);
+
+        const AssetEntry* entry = request->Entry;
+        request->Destination = streamer->Stage(streamer->Context, entry, request->RequestData);
+        request->Loaded = request->Destination != NULL &&
+                          AssetArchive_Decode(entry, request->Compressed, request->Destination);
+        free(request->Compressed);
+        request->Compressed = NULL;
+
+        mtx_lock(&streamer->Mutex);
+        streamer->BufferedBytes -= entry->CompressedSize;
+        AssetQueue_Push(&streamer->Completed, request);
+        cnd_signal(&streamer->ReadCondition);
+    }
+    mtx_unlock(&streamer->Mutex);
+    return 0;
+}
+
+bool AssetStreamer_Create(AssetStreamer* streamer, const AssetArchive* archive, uint32_t decoderCount,
+                          AssetStageFunction stage, AssetCompleteFunction complete, void* context)
+{
+    memset(streamer, 0, sizeof(*streamer));
+    streamer->Archive = archive;
+    streamer->Stage = stage;
+    streamer->Complete = complete;
+    streamer->Context = context;
+    streamer->File = fopen(archive->Path, "rb");
+    if (streamer->File == NULL)
+        return false;
+
+    bool created = mtx_init(&streamer->Mutex, mtx_plain) == thrd_success;
+    if (created && cnd_init(&streamer->ReadCondition) != thrd_success)
+    {
+        mtx_destroy(&streamer->Mutex);
+        created = false;
+    }
+    if (created && cnd_init(&streamer->DecodeCondition) != thrd_success)
+    {
+        cnd_destroy(&streamer->ReadCondition);
+        mtx_destroy(&streamer->Mutex);
+        created = false;
+    }
+    if (created && thrd_create(&streamer->Reader, ReaderMain, streamer) != thrd_success)
+    {
+        cnd_destroy(&streamer->DecodeCondition);
+        cnd_destroy(&streamer->ReadCondition);
+        mtx_destroy(&streamer->Mutex);
+        created = false;
+    }
+    if (!created)
+    {
+        fclose(streamer->File);
+        return false;
+    }
+
+    // Fewer decoders only make it slower, like missing job system workers
+    decoderCount = decoderCount < 1 ? 1 : decoderCount > ASSET_STREAMER_MAX_DECODERS ? ASSET_STREAMER_MAX_DECODERS : decoderCount;
+    for (uint32_t i = 0; i < decoderCount; ++i)
+    {
+        if (thrd_create(&streamer->Decoders[streamer->DecoderCount], DecoderMain, streamer) != thrd_success)
+            break;
+        streamer->DecoderCount++;
+    }
+    if (streamer->DecoderCount == 0)
+    {
+        AssetStreamer_Destroy(streamer);
+        return false;
+    }
+    return true;
+}
+
+void AssetStreamer_Destroy(AssetStreamer* streamer)
+{
+    mtx_lock(&streamer->Mutex);
+    streamer->Quit = true;
+    AssetRequest* request;
+    while ((request = PopFirst(streamer->ReadQueues)) != NULL)
+        AssetQueue_Push(&streamer->Completed, request);
+    cnd_broadcast(&streamer->ReadCondition);
+    mtx_unlock(&streamer->Mutex);
+    thrd_join(streamer->Reader, NULL);
+
+    mtx_lock(&streamer->Mutex);
+    streamer->ReaderDone = true;
+    cnd_broadcast(&streamer->DecodeCondition);
+    mtx_unlock(&streamer->Mutex);
+    for (uint32_t i = 0; i < streamer->DecoderCount; ++i)
+        thrd_join(streamer->Decoders[i], NULL);
+
+    AssetStreamer_Poll(streamer);
+    cnd_destroy(&streamer->DecodeCondition);
+    cnd_destroy(&streamer->ReadCondition);
+    mtx_destroy(&streamer->Mutex);
+    fclose(streamer->File);
+}
+
+bool AssetStreamer_Request(AssetStreamer* streamer, const char* name, AssetPriority priority, void* requestData)
+{
+    if ((unsigned)priority >= ASSET_PRIORITY_COUNT)
+        return false;
+
+    const AssetEntry* entry = AssetArchive_Find(streamer->Archive, name);
+    AssetRequest* request = entry != NULL ? calloc(1, sizeof(AssetRequest)) : NULL;
+    if (request == NULL)
+        return false;
+
+    request->Entry = entry;
+    request->RequestData = requestData;
+    request->Priority = priority;
+
+    mtx_lock(&streamer->Mutex);
+    AssetQueue_Push(&streamer->ReadQueues[priority], request);
+    streamer->PendingCount++;
+    cnd_signal(&streamer->ReadCondition);
+    mtx_unlock(&streamer->Mutex);
+    return true;
+}
+
+uint32_t AssetStreamer_Poll(AssetStreamer* streamer)
+{
+    mtx_lock(&streamer->Mutex);
+    AssetRequest* request = streamer->Completed.Head;
+    streamer->Completed.Head = NULL;
+    streamer->Completed.Tail = NULL;
+    mtx_unlock(&streamer->Mutex);
+
+    uint32_t count = 0;
+    while (request != NULL)
+    {
+        AssetRequest* next = request->Next;
+        streamer->Complete(streamer->Context, request->Entry, request->Destination, request->Loaded,
+                           request->RequestData);
+        free(request);
+        request = next;
+        count++;
+    }
+
+    mtx_lock(&streamer->Mutex);
+    streamer->PendingCount -= count;
+    mtx_unlock(&streamer->Mutex);
+    return count;
+}
+
+uint32_t AssetStreamer_GetPendingCount(AssetStreamer* streamer)
+{
+    mtx_lock(&streamer->Mutex);
+    uint32_t count = streamer->PendingCount;
+    mtx_unlock(&streamer->Mutex);
+    return count;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+#include "asset_archive.h"
+
+// Bytes read ahead of the decoders, the reader waits once this much is queued
+#define ASSET_STREAMER_MAX_BUFFERED (32u * 1024u * 1024u)
+#define ASSET_STREAMER_MAX_DECODERS 8
+
+typedef enum AssetPriority
+{
+    ASSET_PRIORITY_HIGH,
+    ASSET_PRIORITY_NORMAL,
+    ASSET_PRIORITY_LOW,
+    ASSET_PRIORITY_COUNT
+} AssetPriority;
+
+// Returns the memory an entry is decompressed to, entry->Size bytes, or NULL to drop the
+// request. Called on a decoder thread, typically handing out upload memory.
+typedef void* (*AssetStageFunction)(void* context, const AssetEntry* entry, void* requestData);
+
+// Called by AssetStreamer_Poll for every finished request. Submitting the staged data is up to
+// it. When loading failed destination holds what was staged, if anything, to be released.
+typedef void (*AssetCompleteFunction)(void* context, const AssetEntry* entry, void* destination, bool loaded,
+                                      void* requestData);
+
+typedef struct AssetRequest
+{
+    const AssetEntry* Entry;
+    void* RequestData;
+    AssetPriority Priority;
+    // Compressed bytes between the reader and a decoder
+    void* Compressed;
+    void* Destination;
+    bool Loaded;
+    struct AssetRequest* Next;
+} AssetRequest;
+
+// FIFO of requests of a priority
+typedef struct AssetQueue
+{
+    AssetRequest* Head;
+    AssetRequest* Tail;
+} AssetQueue;
+
+// Streams entries of an archive in the background. A reader thread takes the requests in
+// priority order, first come first served within one, and reads their compressed bytes one
+// after the other. Decoder threads take the read ones in the same order, stage and decompress
+// them. The thread polling the streamer completes them.
+typedef struct AssetStreamer
+{
+    const AssetArchive* Archive;
+    FILE* File;
+    AssetStageFunction Stage;
+    AssetCompleteFunction Complete;
+    void* Context;
+
+    mtx_t Mutex;
+    cnd_t ReadCondition;
+    cnd_t DecodeCondition;
+    AssetQueue ReadQueues[ASSET_PRIORITY_COUNT];
+    AssetQueue DecodeQueues[ASSET_PRIORITY_COUNT];
+    AssetQueue Completed;
+    size_t BufferedBytes;
+    uint32_t PendingCount;
+    bool Quit;
+    // Set once the reader has exited, the decoders then drain their queues and exit too
+    bool ReaderDone;
+
+    thrd_t Reader;
+    thrd_t Decoders[ASSET_STREAMER_MAX_DECODERS];
+    uint32_t DecoderCount;
+} AssetStreamer;
+
+// Opens the archive file a second time for the reader, so synchronous reads can go on.
+// decoderCount is clamped to [1, ASSET_STREAMER_MAX_DECODERS].
+bool AssetStreamer_Create(AssetStreamer* streamer, const AssetArchive* archive, uint32_t decoderCount,
+                          AssetStageFunction stage, AssetCompleteFunction complete, void* context);
+
+// Drops the requests not read yet, waits for the ones in flight and completes them
+void AssetStreamer_Destroy(AssetStreamer* streamer);
+
+// Queues an entry by name, false when the archive doesn't hold it or the priority is out of range
+bool AssetStreamer_Request(AssetStreamer* streamer, const char* name, AssetPriority priority, void* requestData);
+
+// Completes the finished requests on the calling thread, returns how many
+uint32_t AssetStreamer_Poll(AssetStreamer* streamer);
+
+// Requests not completed yet
+uint32_t AssetStreamer_GetPendingCount(AssetStreamer* streamer);
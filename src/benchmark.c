@@ -0,0 +1,272 @@
+#include "benchmark.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.14159265358979f
+
+static const char* g_MetricNames[BENCHMARK_METRIC_COUNT] = {
+    [BENCHMARK_METRIC_FRAME] = "frame_ms",
+    [BENCHMARK_METRIC_SIMULATION] = "simulation_ms",
+    [BENCHMARK_METRIC_RENDER] = "render_ms",
+    [BENCHMARK_METRIC_GPU] = "gpu_ms"
+};
+
+// The cube alone, turning while the camera circles it from where the app looks at it
+static const BenchmarkPhase g_CubePhases[] = {
+    { "orbit", 1.0f, { 10.0f, -90.0f, 0.0f }, { 10.0f, 270.0f, 4.0f }, true }
+};
+
+// Overview of a thousand cubes, a flight into them and a spin among them
+static const BenchmarkPhase g_GridPhases[] = {
+    { "overview", 1.0f, { 70.0f, -90.0f, 45.0f }, { 70.0f, -45.0f, 45.0f }, false },
+    { "fly-in", 1.0f, { 70.0f, -45.0f, 45.0f }, { 15.0f, 45.0f, 5.0f }, false },
+    { "spin", 1.0f, { 15.0f, 45.0f, 5.0f }, { 15.0f, 405.0f, 5.0f }, true }
+};
+
+// Four thousand cubes all changing every frame, the camera inside the grid so the far plane
+// cuts through them
+static const BenchmarkPhase g_CrowdPhases[] = {
+    { "orbit", 1.0f, { 60.0f, -90.0f, 40.0f }, { 60.0f, 270.0f, 40.0f }, true }
+};
+
+static const BenchmarkWorkload g_Workloads[] = {
+    { "cube", 1, 3.0f, g_CubePhases, sizeof(g_CubePhases) / sizeof(g_CubePhases[0]) },
+    { "grid", 32 * 32, 3.0f, g_GridPhases, sizeof(g_GridPhases) / sizeof(g_GridPhases[0]) },
+    { "crowd", 64 * 64, 3.0f, g_CrowdPhases, sizeof(g_CrowdPhases) / sizeof(g_CrowdPhases[0]) }
+};
+
+const BenchmarkWorkload* Benchmark_FindWorkload(const char* name)
+{
+    for (size_t i = 0; i < sizeof(g_Workloads) / sizeof(g_Workloads[0]); ++i)
+    {
+        if (strcmp(g_Workloads[i].Name, name) == 0)
+            return &g_Workloads[i];
+    }
+    return NULL;
+}
+
+const char* Benchmark_GetWorkloadNames(void)
+{
+    return "cube, grid, crowd";
+}
+
+bool Benchmark_Create(Benchmark* benchmark, const BenchmarkWorkload* workload, uint32_t warmUpFrames,
+                      uint32_t frameCount)
+{
+    memset(benchmark, 0, sizeof(*benchmark));
+    if (workload == NULL || frameCount == 0)
+        return false;
+    benchmark->Workload = workload;
+    benchmark->WarmUpFrames = warmUpFrames;
+    benchmark->FrameCount = frameCount;
+    for (int metric = 0; metric < BENCHMARK_METRIC_COUNT; ++metric)
+    {
+        benchmark->Samples[metric] = malloc(frameCount * sizeof(float));
+        if (benchmark->Samples[metric] == NULL)
+        {
+            Benchmark_Destroy(benchmark);
+            return false;
+        }
+        for (uint32_t i = 0; i < frameCount; ++i)
+            benchmark->Samples[metric][i] = NAN;
+    }
+    return true;
+}
+
+void Benchmark_Destroy(Benchmark* benchmark)
+{
+    for (int metric = 0; metric < BENCHMARK_METRIC_COUNT; ++metric)
+        free(benchmark->Samples[metric]);
+    memset(benchmark, 0, sizeof(*benchmark));
+}
+
+uint32_t Benchmark_GetTotalFrames(const Benchmark* benchmark)
+{
+    return benchmark->WarmUpFrames + benchmark->FrameCount;
+}
+
+static float Lerp(float a, float b, float t)
+{
+    return a + (b - a) * t;
+}
+
+void Benchmark_GetFrame(const Benchmark* benchmark, uint32_t frame, BenchmarkFrame* result)
+{
+    const BenchmarkWorkload* workload = benchmark->Workload;
+    memset(result, 0, sizeof(*result));
+    result->Time = frame * BENCHMARK_TIME_STEP;
+    result->Measured = frame >= benchmark->WarmUpFrames;
+
+    // Where the frame is in the script, the phases get the measured frames by weight
+    float totalWeight = 0.0f;
+    for (uint32_t i = 0; i < workload->PhaseCount; ++i)
+        totalWeight += workload->Phases[i].Weight;
+    float position = result->Measured ?
+        (float)(frame - benchmark->WarmUpFrames) / benchmark->FrameCount * totalWeight : 0.0f;
+    uint32_t phase = 0;
+    while (phase + 1 < workload->PhaseCount && position >= workload->Phases[phase].Weight)
+    {
+        position -= workload->Phases[phase].Weight;
+        phase++;
+    }
+    const BenchmarkPhase* current = &workload->Phases[phase];
+    float t = fminf(position / current->Weight, 1.0f);
+
+    float radius = Lerp(current->Start.Radius, current->End.Radius, t);
+    float angle = Lerp(current->Start.Angle, current->End.Angle, t) * PI / 180.0f;
+    result->Phase = phase;
+    result->Eye[0] = radius * cosf(angle);
+    result->Eye[1] = Lerp(current->Start.Height, current->End.Height, t);
+    result->Eye[2] = radius * sinf(angle);
+    result->AnimateInstances = current->AnimateInstances;
+}
+
+void Benchmark_GetInstance(const Benchmark* benchmark, uint32_t instance, const BenchmarkFrame* frame,
+                           float position[3], float angles[3])
+{
+    const BenchmarkWorkload* workload = benchmark->Workload;
+    uint32_t side = (uint32_t)ceilf(sqrtf((float)workload->InstanceCount));
+    float offset = (side - 1) * 0.5f;
+    position[0] = ((float)(instance % side) - offset) * workload->Spacing;
+    position[1] = 0.0f;
+    position[2] = ((float)(instance / side) - offset) * workload->Spacing;
+
+    // The pose the app shows the cube in, turned about y by time with a phase per instance
+    angles[0] = 1.0f;
+    angles[1] = frame->AnimateInstances ? frame->Time + 0.37f * instance : 0.0f;
+    angles[2] = 1.0f;
+}
+
+void Benchmark_Record(Benchmark* benchmark, BenchmarkMetric metric, uint32_t frame, double milliseconds)
+{
+    if (frame < benchmark->WarmUpFrames || frame - benchmark->WarmUpFrames >= benchmark->FrameCount)
+        return;
+    benchmark->Samples[metric][frame - benchmark->WarmUpFrames] = (float)milliseconds;
+}
+
+void Benchmark_AddStartupPhase(Benchmark* benchmark, const char* name, double milliseconds)
+{
+    if (benchmark->StartupPhaseCount == BENCHMARK_MAX_STARTUP_PHASES)
+        return;
+    benchmark->StartupPhases[benchmark->StartupPhaseCount++] = (BenchmarkStartupPhase){ name, milliseconds };
+}
+
+static int CompareFloats(const void* a, const void* b)
+{
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank
+static float GetPercentile(const float* sorted, uint32_t count, float percentile)
+{
+    uint32_t rank = (uint32_t)ceilf(percentile / 100.0f * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Statistics of the samples recorded in [first, end), null when there are none
+static void WriteMetric(FILE* file, const float* samples, uint32_t first, uint32_t end, float* scratch)
+{
+    uint32_t count = 0;
+    double sum = 0.0;
+    for (uint32_t i = first; i < end; ++i)
+    {
+        if (!isnan(samples[i]))
+        {
+            scratch[count++] = samples[i];
+            sum += samples[i];
+        }
+    }
+    if (count == 0)
+    {
+        fprintf(file, "null");
+        return;
+    }
+
+    double mean = sum / count;
+    double squares = 0.0;
+    for (uint32_t i = 0; i < count; ++i)
+        squares += (scratch[i] - mean) * (scratch[i] - mean);
+    qsort(scratch, count, sizeof(float), CompareFloats);
+    fprintf(file, "{ \"samples\": %u, \"mean\": %.4f, \"stddev\": %.4f, \"min\": %.4f, \"median\": %.4f, "
+            "\"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }", count, mean, sqrt(squares / count), scratch[0],
+            GetPercentile(scratch, count, 50.0f), GetPercentile(scratch, count, 95.0f),
+            GetPercentile(scratch, count, 99.0f), scratch[count - 1]);
+}
+
+bool Benchmark_WriteReport(const Benchmark* benchmark, const char* backend, const char* path)
+{
+    const BenchmarkWorkload* workload = benchmark->Workload;
+    float* scratch = malloc(benchmark->FrameCount * sizeof(float));
+    FILE* file = scratch != NULL ? fopen(path, "w") : NULL;
+    if (file == NULL)
+    {
+        free(scratch);
+        return false;
+    }
+
+    double startupTotal = 0.0;
+    for (uint32_t i = 0; i < benchmark->StartupPhaseCount; ++i)
+        startupTotal += benchmark->StartupPhases[i].Milliseconds;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"workload\": \"%s\",\n", workload->Name);
+    fprintf(file, "  \"backend\": \"%s\",\n", backend);
+    fprintf(file, "  \"instances\": %u,\n", workload->InstanceCount);
+    fprintf(file, "  \"warm_up_frames\": %u,\n", benchmark->WarmUpFrames);
+    fprintf(file, "  \"frames\": %u,\n", benchmark->FrameCount);
+    fprintf(file, "  \"time_step\": %.6f,\n", BENCHMARK_TIME_STEP);
+
+    fprintf(file, "  \"startup\": {\n");
+    fprintf(file, "    \"total_ms\": %.4f,\n", startupTotal);
+    fprintf(file, "    \"phases\": [");
+    for (uint32_t i = 0; i < benchmark->StartupPhaseCount; ++i)
+    {
+        fprintf(file, "%s\n      { \"name\": \"%s\", \"ms\": %.4f }", i > 0 ? "," : "",
+                benchmark->StartupPhases[i].Name, benchmark->StartupPhases[i].Milliseconds);
+    }
+    fprintf(file, "%s]\n  },\n", benchmark->StartupPhaseCount > 0 ? "\n    " : "");
+
+    fprintf(file, "  \"metrics\": {");
+    for (int metric = 0; metric < BENCHMARK_METRIC_COUNT; ++metric)
+    {
+        fprintf(file, "%s\n    \"%s\": ", metric > 0 ? "," : "", g_MetricNames[metric]);
+        WriteMetric(file, benchmark->Samples[metric], 0, benchmark->FrameCount, scratch);
+    }
+    fprintf(file, "\n  },\n");
+
+    // The measured frames of a phase are contiguous
+    fprintf(file, "  \"phases\": [");
+    uint32_t first = 0;
+    for (uint32_t phase = 0; phase < workload->PhaseCount; ++phase)
+    {
+        uint32_t end = first;
+        BenchmarkFrame frame;
+        while (end < benchmark->FrameCount)
+        {
+            Benchmark_GetFrame(benchmark, benchmark->WarmUpFrames + end, &frame);
+            if (frame.Phase != phase)
+                break;
+            end++;
+        }
+        fprintf(file, "%s\n    {\n      \"name\": \"%s\",\n      \"frames\": %u", phase > 0 ? "," : "",
+                workload->Phases[phase].Name, end - first);
+        for (int metric = 0; metric < BENCHMARK_METRIC_COUNT; ++metric)
+        {
+            fprintf(file, ",\n      \"%s\": ", g_MetricNames[metric]);
+            WriteMetric(file, benchmark->Samples[metric], first, end, scratch);
+        }
+        fprintf(file, "\n    }");
+        first = end;
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    bool written = !ferror(file);
+    written = fclose(file) == 0 && written;
+    free(scratch);
+    return written;
+}
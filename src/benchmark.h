@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Simulated time per frame, so every run animates the same whatever its frame rate
+#define BENCHMARK_TIME_STEP (1.0f / 60.0f)
+#define BENCHMARK_MAX_STARTUP_PHASES 16
+#define BENCHMARK_DEFAULT_FRAMES 1000
+#define BENCHMARK_DEFAULT_WARM_UP_FRAMES 120
+
+typedef enum BenchmarkMetric
+{
+    // From the start of a frame on the main thread to the start of the next one
+    BENCHMARK_METRIC_FRAME,
+    BENCHMARK_METRIC_SIMULATION,
+    // Recording and submitting on the render thread
+    BENCHMARK_METRIC_RENDER,
+    // Between timestamps at the start and the end of the frame's command list
+    BENCHMARK_METRIC_GPU,
+    BENCHMARK_METRIC_COUNT
+} BenchmarkMetric;
+
+// Camera on a circle around the origin, looking at it
+typedef struct BenchmarkCamera
+{
+    float Radius;
+    // Degrees, -90 is on the negative z axis
+    float Angle;
+    float Height;
+} BenchmarkCamera;
+
+// Part of a workload, the camera moves from its start to its end over the phase's share of the
+// measured frames
+typedef struct BenchmarkPhase
+{
+    const char* Name;
+    float Weight;
+    BenchmarkCamera Start;
+    BenchmarkCamera End;
+    // Spins every instance, so each frame changes all the world matrices
+    bool AnimateInstances;
+} BenchmarkPhase;
+
+// Instances laid out on a square grid in the xz plane, centred on the origin
+typedef struct BenchmarkWorkload
+{
+    const char* Name;
+    uint32_t InstanceCount;
+    float Spacing;
+    const BenchmarkPhase* Phases;
+    uint32_t PhaseCount;
+} BenchmarkWorkload;
+
+typedef struct BenchmarkFrame
+{
+    uint32_t Phase;
+    float Eye[3];
+    float Target[3];
+    float Time;
+    bool AnimateInstances;
+    // Past the warm-up
+    bool Measured;
+} BenchmarkFrame;
+
+typedef struct BenchmarkStartupPhase
+{
+    const char* Name;
+    double Milliseconds;
+} BenchmarkStartupPhase;
+
+// Scripted run of a fixed number of frames. The warm-up frames hold the first pose of the script
+// and aren't measured. Every thread records its own metrics by frame, so they can record
+// concurrently, and the report summarizes them once the run is over.
+typedef struct Benchmark
+{
+    const BenchmarkWorkload* Workload;
+    uint32_t WarmUpFrames;
+    uint32_t FrameCount;
+    // Milliseconds of every measured frame, NAN where none was recorded
+    float* Samples[BENCHMARK_METRIC_COUNT];
+    BenchmarkStartupPhase StartupPhases[BENCHMARK_MAX_STARTUP_PHASES];
+    uint32_t StartupPhaseCount;
+} Benchmark;
+
+// Returns NULL for an unknown name
+const BenchmarkWorkload* Benchmark_FindWorkload(const char* name);
+// Comma separated, for usage messages
+const char* Benchmark_GetWorkloadNames(void);
+
+bool Benchmark_Create(Benchmark* benchmark, const BenchmarkWorkload* workload, uint32_t warmUpFrames,
+                      uint32_t frameCount);
+void Benchmark_Destroy(Benchmark* benchmark);
+
+// Warm-up and measured frames
+uint32_t Benchmark_GetTotalFrames(const Benchmark* benchmark);
+void Benchmark_GetFrame(const Benchmark* benchmark, uint32_t frame, BenchmarkFrame* result);
+void Benchmark_GetInstance(const Benchmark* benchmark, uint32_t instance, const BenchmarkFrame* frame,
+                           float position[3], float angles[3]);
+
+// Frames are counted from 0 including the warm-up, samples of warm-up frames are dropped
+void Benchmark_Record(Benchmark* benchmark, BenchmarkMetric metric, uint32_t frame, double milliseconds);
+void Benchmark_AddStartupPhase(Benchmark* benchmark, const char* name, double milliseconds);
+
+// Writes the JSON report, the backend names what drew the frames
+bool Benchmark_WriteReport(const Benchmark* benchmark, const char* backend, const char* path);
@@ -0,0 +1,766 @@
+#include "block_compression.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#define BLOCK_TEXELS 16
+// Least squares refinements of the endpoints after the principal axis fit
+#define REFINE_ITERATIONS 2
+#define POWER_ITERATIONS 8
+
+// Texels of a block by channel, in [0, 255]
+typedef struct BlockTexels
+{
+    HD_ALIGN(32) float Channels[4][BLOCK_TEXELS];
+} BlockTexels;
+
+typedef struct CompressTaskData
+{
+    const uint8_t* Rgba;
+    uint32_t Width;
+    uint32_t Height;
+    size_t RowPitch;
+    TextureFormat Format;
+    uint8_t* Blocks;
+    size_t BlockRowPitch;
+} CompressTaskData;
+
+// Position of each index between the endpoints, from the first (0) to the second (1)
+static const float g_Bc1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+static const float g_Bc4Weights[8] = {
+    0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f
+};
+// BC7 4 bit index weights out of 64
+static const int g_Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static const float g_Bc7UnitWeights[16] = {
+    0.0f / 64, 4.0f / 64, 9.0f / 64, 13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64, 30.0f / 64,
+    34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 64.0f / 64
+};
+
+static float Clamp255(float value)
+{
+    return value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+}
+
+static void LoadBlock(const CompressTaskData* data, uint32_t blockX, uint32_t blockY, BlockTexels* texels)
+{
+    for (uint32_t y = 0; y < 4; ++y)
+    {
+        uint32_t sourceY = blockY * 4 + y < data->Height ? blockY * 4 + y : data->Height - 1;
+        const uint8_t* row = data->Rgba + sourceY * data->RowPitch;
+        for (uint32_t x = 0; x < 4; ++x)
+        {
+            uint32_t sourceX = blockX * 4 + x < data->Width ? blockX * 4 + x : data->Width - 1;
+            for (int c = 0; c < 4; ++c)
+                texels->Channels[c][y * 4 + x] = row[sourceX * 4 + c];
+        }
+    }
+}
+
+// Picks the nearest palette entry of every texel over the channels [first, first + count) and
+// returns the summed squared error. Ties go to the lower index.
+static float SelectIndices(const BlockTexels* texels, const float (*palette)[4], int paletteCount,
+                           int firstChannel, int channelCount, uint8_t indices[BLOCK_TEXELS])
+{
+    float error = 0.0f;
+    int t = 0;
+
+#if defined(HD_AVX2)
+    for (; t < BLOCK_TEXELS; t += 8)
+    {
+        __m256 channels[4];
+        for (int c = 0; c < channelCount; ++c)
+            channels[c] = _mm256_load_ps(texels->Channels[firstChannel + c] + t);
+
+        __m256 best = _mm256_set1_ps(FLT_MAX);
+        __m256 bestIndex = _mm256_setzero_ps();
+        for (int e = 0; e < paletteCount; ++e)
+        {
+            __m256 distance = _mm256_setzero_ps();
+            for (int c = 0; c < channelCount; ++c)
+            {
+                __m256 difference = _mm256_sub_ps(channels[c], _mm256_set1_ps(palette[e][firstChannel + c]));
+                distance = _mm256_fmadd_ps(difference, difference, distance);
+            }
+            __m256 closer = _mm256_cmp_ps(distance, best, _CMP_LT_OQ);
+            best = _mm256_blendv_ps(best, distance, closer);
+            bestIndex = _mm256_blendv_ps(bestIndex, _mm256_set1_ps((float)e), closer);
+        }
+
+        HD_ALIGN(32) float lanes[8];
+        HD_ALIGN(32) float errors[8];
+        _mm256_store_ps(lanes, bestIndex);
+        _mm256_store_ps(errors, best);
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            indices[t + lane] = (uint8_t)lanes[lane];
+            error += errors[lane];
+        }
+    }
+#elif defined(HD_SSE2)
+    for (; t < BLOCK_TEXELS; t += 4)
+    {
+        __m128 channels[4];
+        for (int c = 0; c < channelCount; ++c)
+            channels[c] = _mm_load_ps(texels->Channels[firstChannel + c] + t);
+
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128 bestIndex = _mm_setzero_ps();
+        for (int e = 0; e < paletteCount; ++e)
+        {
+            __m128 distance = _mm_setzero_ps();
+            for (int c = 0; c < channelCount; ++c)
+            {
+                __m128 difference = _mm_sub_ps(channels[c], _mm_set1_ps(palette[e][firstChannel + c]));
+                distance = _mm_add_ps(_mm_mul_ps(difference, difference), distance);
+            }
+            __m128 closer = _mm_cmplt_ps(distance, best);
+            best = _mm_or_ps(_mm_and_ps(closer, distance), _mm_andnot_ps(closer, best));
+            bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((float)e)), _mm_andnot_ps(closer, bestIndex));
+        }
+
+        HD_ALIGN(16) float lanes[4];
+        HD_ALIGN(16) float errors[4];
+        _mm_store_ps(lanes, bestIndex);
+        _mm_store_ps(errors, best);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            indices[t + lane] = (uint8_t)lanes[lane];
+            error += errors[lane];
+        }
+    }
+#endif
+
+    for (; t < BLOCK_TEXELS; ++t)
+    {
+        float best = FLT_MAX;
+        for (int e = 0; e < paletteCount; ++e)
+        {
+            float distance = 0.0f;
+            for (int c = firstChannel; c < firstChannel + channelCount; ++c)
+            {
+                float difference = texels->Channels[c][t] - palette[e][c];
+                distance += difference * difference;
+            }
+            if (distance < best)
+            {
+                best = distance;
+                indices[t] = (uint8_t)e;
+            }
+        }
+        error += best;
+    }
+
+    return error;
+}
+
+// Endpoints at the extremes of the texels projected on their principal axis, found by power
+// iteration on the covariance
+static void FitEndpoints(const BlockTexels* texels, int firstChannel, int channelCount, float low[4], float high[4])
+{
+    float mean[4] = { 0 };
+    float minimum[4];
+    float maximum[4];
+    for (int c = 0; c < channelCount; ++c)
+    {
+        const float* values = texels->Channels[firstChannel + c];
+        minimum[c] = maximum[c] = values[0];
+        for (int t = 0; t < BLOCK_TEXELS; ++t)
+        {
+            mean[c] += values[t];
+            minimum[c] = fminf(minimum[c], values[t]);
+            maximum[c] = fmaxf(maximum[c], values[t]);
+        }
+        mean[c] /= BLOCK_TEXELS;
+    }
+
+    float covariance[4][4] = { { 0 } };
+    for (int t = 0; t < BLOCK_TEXELS; ++t)
+    {
+        for (int i = 0; i < channelCount; ++i)
+        {
+            for (int j = i; j < channelCount; ++j)
+                covariance[i][j] += (texels->Channels[firstChannel + i][t] - mean[i]) *
+                                    (texels->Channels[firstChannel + j][t] - mean[j]);
+        }
+    }
+
+    // Starting from the diagonal of the bounding box
+    float axis[4];
+    for (int c = 0; c < channelCount; ++c)
+        axis[c] = maximum[c] - minimum[c];
+    for (int iteration = 0; iteration < POWER_ITERATIONS; ++iteration)
+    {
+        float next[4] = { 0 };
+        float largest = 0.0f;
+        for (int i = 0; i < channelCount; ++i)
+        {
+            for (int j = 0; j < channelCount; ++j)
+                next[i] += (i <= j ? covariance[i][j] : covariance[j][i]) * axis[j];
+            largest = fmaxf(largest, fabsf(next[i]));
+        }
+        if (largest == 0.0f)
+            break;
+        for (int c = 0; c < channelCount; ++c)
+            axis[c] = next[c] / largest;
+    }
+
+    float length = 0.0f;
+    for (int c = 0; c < channelCount; ++c)
+        length += axis[c] * axis[c];
+    length = sqrtf(length);
+    if (length == 0.0f)
+    {
+        // Flat block
+        for (int c = 0; c < channelCount; ++c)
+            low[firstChannel + c] = high[firstChannel + c] = mean[c];
+        return;
+    }
+
+    float lowest = FLT_MAX;
+    float highest = -FLT_MAX;
+    for (int t = 0; t < BLOCK_TEXELS; ++t)
+    {
+        float projection = 0.0f;
+        for (int c = 0; c < channelCount; ++c)
+            projection += (texels->Channels[firstChannel + c][t] - mean[c]) * axis[c] / length;
+        lowest = fminf(lowest, projection);
+        highest = fmaxf(highest, projection);
+    }
+
+    for (int c = 0; c < channelCount; ++c)
+    {
+        low[firstChannel + c] = Clamp255(mean[c] + axis[c] / length * lowest);
+        high[firstChannel + c] = Clamp255(mean[c] + axis[c] / length * highest);
+    }
+}
+
+// Least squares endpoints for the chosen indices, weights places each index between the first
+// (0) and the second endpoint (1). Returns false when the indices don't pin both down.
+static bool RefineEndpoints(const BlockTexels* texels, const uint8_t indices[BLOCK_TEXELS], const float* weights,
+                            int firstChannel, int channelCount, float first[4], float second[4])
+{
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[4] = { 0 };
+    float bx[4] = { 0 };
+    for (int t = 0; t < BLOCK_TEXELS; ++t)
+    {
+        float b = weights[indices[t]];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < channelCount; ++c)
+        {
+            ax[c] += a * texels->Channels[firstChannel + c][t];
+            bx[c] += b * texels->Channels[firstChannel + c][t];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) < 1e-6f)
+        return false;
+
+    float inverse = 1.0f / determinant;
+    for (int c = 0; c < channelCount; ++c)
+    {
+        first[firstChannel + c] = Clamp255((bb * ax[c] - ab * bx[c]) * inverse);
+        second[firstChannel + c] = Clamp255((aa * bx[c] - ab * ax[c]) * inverse);
+    }
+    return true;
+}
+
+static uint16_t QuantizeColor565(const float color[4])
+{
+    int r = (int)(color[0] * (31.0f / 255.0f) + 0.5f);
+    int g = (int)(color[1] * (63.0f / 255.0f) + 0.5f);
+    int b = (int)(color[2] * (31.0f / 255.0f) + 0.5f);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+static void ExpandColor565(uint16_t color, int rgb[3])
+{
+    int r = color >> 11;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    rgb[0] = r << 3 | r >> 2;
+    rgb[1] = g << 2 | g >> 4;
+    rgb[2] = b << 3 | b >> 2;
+}
+
+// Colors of a BC1 block. The first color greater than the second selects 4 colors, otherwise
+// 3 and transparent black unless the block is the color of a BC3 block.
+static void GetBc1Palette(uint16_t color0, uint16_t color1, bool fourColors, int palette[4][4])
+{
+    ExpandColor565(color0, palette[0]);
+    ExpandColor565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c)
+    {
+        if (fourColors || color0 > color1)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    for (int e = 0; e < 4; ++e)
+        palette[e][3] = 255;
+    if (!fourColors && color0 <= color1)
+        palette[3][3] = 0;
+}
+
+static void WriteUint16(uint8_t* data, uint16_t value)
+{
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+}
+
+static void EncodeBc1Block(const BlockTexels* texels, uint8_t* block)
+{
+    float first[4];
+    float second[4];
+    FitEndpoints(texels, 0, 3, second, first);
+
+    float bestError = FLT_MAX;
+    uint16_t bestColors[2] = { 0, 0 };
+    uint8_t bestIndices[BLOCK_TEXELS] = { 0 };
+    for (int iteration = 0; iteration <= REFINE_ITERATIONS; ++iteration)
+    {
+        // Always the 4 color mode, with the greater color first
+        uint16_t color0 = QuantizeColor565(first);
+        uint16_t color1 = QuantizeColor565(second);
+        if (color0 < color1)
+        {
+            uint16_t swap = color0;
+            color0 = color1;
+            color1 = swap;
+        }
+
+        int colors[4][4];
+        GetBc1Palette(color0, color1, true, colors);
+        float palette[4][4];
+        for (int e = 0; e < 4; ++e)
+            for (int c = 0; c < 4; ++c)
+                palette[e][c] = (float)colors[e][c];
+
+        // Equal colors would decode as 3 colors, only the first one is used then
+        uint8_t indices[BLOCK_TEXELS];
+        float error = SelectIndices(texels, (const float (*)[4])palette, color0 == color1 ? 1 : 4, 0, 3, indices);
+        if (error < bestError)
+        {
+            bestError = error;
+            bestColors[0] = color0;
+            bestColors[1] = color1;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+
+        if (error == 0.0f || !RefineEndpoints(texels, indices, g_Bc1Weights, 0, 3, first, second))
+            break;
+    }
+
+    uint32_t packedIndices = 0;
+    for (int t = 0; t < BLOCK_TEXELS; ++t)
+        packedIndices |= (uint32_t)bestIndices[t] << (2 * t);
+    WriteUint16(block + 0, bestColors[0]);
+    WriteUint16(block + 2, bestColors[1]);
+    WriteUint16(block + 4, (uint16_t)packedIndices);
+    WriteUint16(block + 6, (uint16_t)(packedIndices >> 16));
+}
+
+// Values of a BC4 block, 8 when the first is greater, otherwise 6 plus 0 and 255
+static void GetBc4Palette(int value0, int value1, int palette[8])
+{
+    palette[0] = value0;
+    palette[1] = value1;
+    if (value0 > value1)
+    {
+        for (int k = 2; k < 8; ++k)
+            palette[k] = ((8 - k) * value0 + (k - 1) * value1 + 3) / 7;
+    }
+    else
+    {
+        for (int k = 2; k < 6; ++k)
+            palette[k] = ((6 - k) * value0 + (k - 1) * value1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static void EncodeBc4Block(const BlockTexels* texels, int channel, uint8_t* block)
+{
+    float first[4];
+    float second[4];
+    FitEndpoints(texels, channel, 1, second, first);
+
+    float bestError = FLT_MAX;
+    int bestValues[2] = { 0, 0 };
+    uint8_t bestIndices[BLOCK_TEXELS] = { 0 };
+    for (int iteration = 0; iteration <= REFINE_ITERATIONS; ++iteration)
+    {
+        // Always the 8 value mode, with the greater value first
+        int value0 = (int)(first[channel] + 0.5f);
+        int value1 = (int)(second[channel] + 0.5f);
+        if (value0 < value1)
+        {
+            int swap = value0;
+            value0 = value1;
+            value1 = swap;
+        }
+
+        int values[8];
+        GetBc4Palette(value0, value1, values);
+        float palette[8][4];
+        for (int e = 0; e < 8; ++e)
+            palette[e][channel] = (float)values[e];
+
+        uint8_t indices[BLOCK_TEXELS];
+        float error = SelectIndices(texels, (const float (*)[4])palette, value0 == value1 ? 1 : 8, channel, 1, indices);
+        if (error < bestError)
+        {
+            bestError = error;
+            bestValues[0] = value0;
+            bestValues[1] = value1;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+
+        if (error == 0.0f || !RefineEndpoints(texels, indices, g_Bc4Weights, channel, 1, first, second))
+            break;
+    }
+
+    uint64_t packedIndices = 0;
+    for (int t = 0; t < BLOCK_TEXELS; ++t)
+        packedIndices |= (uint64_t)bestIndices[t] << (3 * t);
+    block[0] = (uint8_t)bestValues[0];
+    block[1] = (uint8_t)bestValues[1];
+    for (int i = 0; i < 6; ++i)
+        block[2 + i] = (uint8_t)(packedIndices >> (8 * i));
+}
+
+static void WriteBits(uint8_t* block, uint32_t* position, uint32_t value, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i, ++*position)
+        block[*position >> 3] |= (uint8_t)(((value >> i) & 1) << (*position & 7));
+}
+
+static uint32_t ReadBits(const uint8_t* block, uint32_t* position, uint32_t count)
+{
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; ++i, ++*position)
+        value |= (uint32_t)((block[*position >> 3] >> (*position & 7)) & 1) << i;
+    return value;
+}
+
+// 7 bit channels and the shared lowest bit of a BC7 mode 6 endpoint, the p-bit with the
+// smaller error is kept
+static void QuantizeMode6Endpoint(const float endpoint[4], int quantized[4], int* pBit, int decoded[4])
+{
+    float bestError = FLT_MAX;
+    for (int p = 0; p < 2; ++p)
+    {
+        int candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; ++c)
+        {
+            int value = (int)((endpoint[c] - (float)p) * 0.5f + 0.5f);
+            candidate[c] = value < 0 ? 0 : (value > 127 ? 127 : value);
+            float difference = (float)(candidate[c] << 1 | p) - endpoint[c];
+            error += difference * difference;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            *pBit = p;
+            for (int c = 0; c < 4; ++c)
+            {
+                quantized[c] = candidate[c];
+                decoded[c] = candidate[c] << 1 | p;
+            }
+        }
+    }
+}
+
+static void GetBc7Palette(const int endpoint0[4], const int endpoint1[4], int palette[16][4])
+{
+    for (int e = 0; e < 16; ++e)
+        for (int c = 0; c < 4; ++c)
+            palette[e][c] = ((64 - g_Bc7Weights[e]) * endpoint0[c] + g_Bc7Weights[e] * endpoint1[c] + 32) >> 6;
+}
+
+static void EncodeBc7Block(const BlockTexels* texels, uint8_t* block)
+{
+    float first[4];
+    float second[4];
+    FitEndpoints(texels, 0, 4, first, second);
+
+    float bestError = FLT_MAX;
+    int bestEndpoints[2][4] = { { 0 } };
+    int bestPBits[2] = { 0, 0 };
+    uint8_t bestIndices[BLOCK_TEXELS] = { 0 };
+    for (int iteration = 0; iteration <= REFINE_ITERATIONS; ++iteration)
+    {
+        int quantized[2][4];
+        int pBits[2];
+        int decoded[2][4];
+        QuantizeMode6Endpoint(first, quantized[0], &pBits[0], decoded[0]);
+        QuantizeMode6Endpoint(second, quantized[1], &pBits[1], decoded[1]);
+
+        int colors[16][4];
+        GetBc7Palette(decoded[0], decoded[1], colors);
+        float palette[16][4];
+        for (int e = 0; e < 16; ++e)
+            for (int c = 0; c < 4; ++c)
+                palette[e][c] = (float)colors[e][c];
+
+        uint8_t indices[BLOCK_TEXELS];
+        float error = SelectIndices(texels, (const float (*)[4])palette, 16, 0, 4, indices);
+        if (error < bestError)
+        {
+            bestError = error;
+            memcpy(bestEndpoints, quantized, sizeof(quantized));
+            memcpy(bestPBits, pBits, sizeof(pBits));
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+
+        if (error == 0.0f || !RefineEndpoints(texels, indices, g_Bc7UnitWeights, 0, 4, first, second))
+            break;
+    }
+
+    // The highest bit of the first index is implied 0, swap the endpoints when it's set
+    if (bestIndices[0] & 8)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            int swap = bestEndpoints[0][c];
+            bestEndpoints[0][c] = bestEndpoints[1][c];
+            bestEndpoints[1][c] = swap;
+        }
+        int swap = bestPBits[0];
+        bestPBits[0] = bestPBits[1];
+        bestPBits[1] = swap;
+        for (int t = 0; t < BLOCK_TEXELS; ++t)
+            bestIndices[t] = (uint8_t)(15 - bestIndices[t]);
+    }
+
+    memset(block, 0, 16);
+    uint32_t position = 0;
+    WriteBits(block, &position, 1u << 6, 7);
+    for (int c = 0; c < 4; ++c)
+    {
+        WriteBits(block, &position, (uint32_t)bestEndpoints[0][c], 7);
+        WriteBits(block, &position, (uint32_t)bestEndpoints[1][c], 7);
+    }
+    WriteBits(block, &position, (uint32_t)bestPBits[0], 1);
+    WriteBits(block, &position, (uint32_t)bestPBits[1], 1);
+    for (int t = 0; t < BLOCK_TEXELS; ++t)
+        WriteBits(block, &position, bestIndices[t], t == 0 ? 3 : 4);
+}
+
+static void CompressRowsTask(void* userData, size_t begin, size_t end)
+{
+    const CompressTaskData* data = userData;
+    uint32_t blockCount = (data->Width + 3) / 4;
+    uint32_t blockSize = TextureFormat_GetElementSize(data->Format);
+
+    for (size_t row = begin; row < end; ++row)
+    {
+        uint8_t* blocks = data->Blocks + row * data->BlockRowPitch;
+        for (uint32_t x = 0; x < blockCount; ++x)
+        {
+            BlockTexels texels;
+            LoadBlock(data, x, (uint32_t)row, &texels);
+
+            uint8_t* block = blocks + (size_t)x * blockSize;
+            switch (data->Format)
+            {
+                case TEXTURE_FORMAT_BC1:
+                    EncodeBc1Block(&texels, block);
+                    break;
+                case TEXTURE_FORMAT_BC3:
+                    EncodeBc4Block(&texels, 3, block);
+                    EncodeBc1Block(&texels, block + 8);
+                    break;
+                case TEXTURE_FORMAT_BC5:
+                    EncodeBc4Block(&texels, 0, block);
+                    EncodeBc4Block(&texels, 1, block + 8);
+                    break;
+                case TEXTURE_FORMAT_BC7:
+                    EncodeBc7Block(&texels, block);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+bool CompressImage(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch,
+                   TextureFormat format, void* blocks)
+{
+    if (!TextureFormat_IsCompressed(format) || width == 0 || height == 0)
+        return false;
+
+    CompressTaskData data = {
+        .Rgba = rgba,
+        .Width = width,
+        .Height = height,
+        .RowPitch = rowPitch,
+        .Format = format,
+        .Blocks = blocks,
+        .BlockRowPitch = TextureFormat_GetRowPitch(format, width)
+    };
+    ParallelFor(TextureFormat_GetRowCount(format, height), 1, CompressRowsTask, &data);
+    return true;
+}
+
+static void DecodeBc1Block(const uint8_t* block, bool fourColors, uint8_t texels[BLOCK_TEXELS][4])
+{
+    uint16_t color0 = (uint16_t)(block[0] | block[1] << 8);
+    uint16_t color1 = (uint16_t)(block[2] | block[3] << 8);
+    int palette[4][4];
+    GetBc1Palette(color0, color1, fourColors, palette);
+
+    for (int t = 0; t < BLOCK_TEXELS; ++t)
+    {
+        int index = (block[4 + t / 4] >> (2 * (t % 4))) & 3;
+        for (int c = 0; c < 4; ++c)
+            texels[t][c] = (uint8_t)palette[index][c];
+    }
+}
+
+static void DecodeBc4Block(const uint8_t* block, int channel, uint8_t texels[BLOCK_TEXELS][4])
+{
+    int palette[8];
+    GetBc4Palette(block[0], block[1], palette);
+
+    uint64_t packedIndices = 0;
+    for (int i = 0; i < 6; ++i)
+        packedIndices |= (uint64_t)block[2 + i] << (8 * i);
+    for (int t = 0; t < BLOCK_TEXELS; ++t)
+        texels[t][channel] = (uint8_t)palette[(packedIndices >> (3 * t)) & 7];
+}
+
+static bool DecodeBc7Block(const uint8_t* block, uint8_t texels[BLOCK_TEXELS][4])
+{
+    // Mode 6 is the lowest set bit
+    if ((block[0] & 0x7F) != 1u << 6)
+    {
+        memset(texels, 0, BLOCK_TEXELS * 4);
+        return false;
+    }
+
+    uint32_t position = 7;
+    int endpoints[2][4];
+    for (int c = 0; c < 4; ++c)
+    {
+        endpoints[0][c] = (int)ReadBits(block, &position, 7) << 1;
+        endpoints[1][c] = (int)ReadBits(block, &position, 7) << 1;
+    }
+    int pBit0 = (int)ReadBits(block, &position, 1);
+    int pBit1 = (int)ReadBits(block, &position, 1);
+    for (int c = 0; c < 4; ++c)
+    {
+        endpoints[0][c] |= pBit0;
+        endpoints[1][c] |= pBit1;
+    }
+
+    int palette[16][4];
+    GetBc7Palette(endpoints[0], endpoints[1], palette);
+    for (int t = 0; t < BLOCK_TEXELS; ++t)
+    {
+        uint32_t index = ReadBits(block, &position, t == 0 ? 3 : 4);
+        for (int c = 0; c < 4; ++c)
+            texels[t][c] = (uint8_t)palette[index][c];
+    }
+    return true;
+}
+
+bool DecompressImage(const void* blocks, TextureFormat format, uint32_t width, uint32_t height,
+                     uint8_t* rgba, size_t rowPitch)
+{
+    if (!TextureFormat_IsCompressed(format))
+        return false;
+
+    bool decoded = true;
+    size_t blockRowPitch = TextureFormat_GetRowPitch(format, width);
+    uint32_t blockSize = TextureFormat_GetElementSize(format);
+    for (uint32_t blockY = 0; blockY < (height + 3) / 4; ++blockY)
+    {
+        for (uint32_t blockX = 0; blockX < (width + 3) / 4; ++blockX)
+        {
+            const uint8_t* block = (const uint8_t*)blocks + blockY * blockRowPitch + (size_t)blockX * blockSize;
+            uint8_t texels[BLOCK_TEXELS][4];
+            switch (format)
+            {
+                case TEXTURE_FORMAT_BC1:
+                    DecodeBc1Block(block, false, texels);
+                    break;
+                case TEXTURE_FORMAT_BC3:
+                    DecodeBc1Block(block + 8, true, texels);
+                    DecodeBc4Block(block, 3, texels);
+                    break;
+                case TEXTURE_FORMAT_BC5:
+                    memset(texels, 0, sizeof(texels));
+                    DecodeBc4Block(block, 0, texels);
+                    DecodeBc4Block(block + 8, 1, texels);
+                    for (int t = 0; t < BLOCK_TEXELS; ++t)
+                        texels[t][3] = 255;
+                    break;
+                default:
+                    decoded &= DecodeBc7Block(block, texels);
+                    break;
+            }
+
+            for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; ++y)
+            {
+                uint8_t* row = rgba + (blockY * 4 + y) * rowPitch;
+                for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; ++x)
+                    memcpy(row + (blockX * 4 + x) * 4, texels[y * 4 + x], 4);
+            }
+        }
+    }
+    return decoded;
+}
+
+double ComputePsnr(const uint8_t* reference, const uint8_t* image, uint32_t width, uint32_t height,
+                   size_t rowPitch, uint32_t channelMask)
+{
+    double squaredError = 0.0;
+    size_t sampleCount = 0;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* referenceRow = reference + y * rowPitch;
+        const uint8_t* imageRow = image + y * rowPitch;
+        for (uint32_t x = 0; x < width * 4; ++x)
+        {
+            if (channelMask & (1u << (x % 4)))
+            {
+                double difference = (double)referenceRow[x] - (double)imageRow[x];
+                squaredError += difference * difference;
+                sampleCount++;
+            }
+        }
+    }
+
+    if (squaredError == 0.0 || sampleCount == 0)
+        return INFINITY;
+    return 10.0 * log10(255.0 * 255.0 / (squaredError / sampleCount));
+}
+
+uint32_t GetStoredChannelMask(TextureFormat format)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_BC1: return 0x7;
+        case TEXTURE_FORMAT_BC5: return 0x3;
+        default: return 0xF;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "texture_format.h"
+
+// Compresses an RGBA8 image into the blocks of a BC format, rows of blocks are encoded across
+// the workers. Blocks over the right and bottom edges repeat the last column and row. blocks
+// has to hold TextureFormat_GetRowPitch * TextureFormat_GetRowCount bytes.
+//  BC1 fits the color of each block along its principal axis and drops alpha.
+//  BC3 adds an 8 value BC4 alpha block.
+//  BC5 stores red and green as two BC4 blocks, for normal maps.
+//  BC7 only writes mode 6, a single subset of RGBA endpoints with 16 index values.
+// The endpoints are refined by least squares, the indices picked 8 (AVX) or 4 (SSE) texels at
+// a time.
+bool CompressImage(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch,
+                   TextureFormat format, void* blocks);
+
+// Decodes the blocks back to RGBA8, BC5 leaves blue at 0 and alpha opaque. BC7 blocks of
+// other modes than 6 decode to transparent black and make it return false.
+bool DecompressImage(const void* blocks, TextureFormat format, uint32_t width, uint32_t height,
+                     uint8_t* rgba, size_t rowPitch);
+
+// Peak signal to noise ratio in dB over the channels set in channelMask (bit 0 red to bit 3
+// alpha), infinity for identical images
+double ComputePsnr(const uint8_t* reference, const uint8_t* image, uint32_t width, uint32_t height,
+                   size_t rowPitch, uint32_t channelMask);
+
+// Channels a format stores, as a mask for ComputePsnr
+uint32_t GetStoredChannelMask(TextureFormat format);
@@ -0,0 +1,1245 @@
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COBJMACROS
+    #pragma warning(push)
+    #pragma warning(disable:4115) // named type definition in parentheses
+    #include <d3d12.h>
+    #include <dxgi1_6.h>
+    #pragma warning(pop)
+#undef COBJMACROS
+
+// Redirects the macros of the wrapped methods, the wrappers call through the vtables
+#include "command_capture.h"
+
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+
+// Command allocators a replay tracks the submissions of
+#define REPLAY_MAX_ALLOCATORS 64
+
+CommandStream g_CommandCapture;
+
+bool CommandCapture_Initialise(void)
+{
+    return CommandStream_Create(&g_CommandCapture);
+}
+
+void CommandCapture_Shutdown(void)
+{
+    CommandStream_Destroy(&g_CommandCapture);
+}
+
+bool CommandCapture_Open(const char* path)
+{
+    return CommandStream_Open(&g_CommandCapture, path);
+}
+
+bool CommandCapture_Close(void)
+{
+    return CommandStream_Close(&g_CommandCapture);
+}
+
+static bool IsCapturing(void)
+{
+    return CommandStream_IsCapturing(&g_CommandCapture);
+}
+
+static uint32_t GetId(const void* object)
+{
+    return CommandStream_GetObject(&g_CommandCapture, object);
+}
+
+static CommandAddress Resolve(CommandAddressSpace space, uint64_t address)
+{
+    return CommandStream_Resolve(&g_CommandCapture, space, address);
+}
+
+// Commands of a list follow a SET_LIST of it
+static void WriteListCommand(ID3D12GraphicsCommandList* list, const Command* command)
+{
+    CommandStream_SelectList(&g_CommandCapture, GetId(list));
+    CommandStream_Write(&g_CommandCapture, command);
+}
+
+void CommandCapture_MarkFrame(uint64_t frame)
+{
+    Command command = { .Opcode = COMMAND_FRAME, .Frame = frame };
+    CommandStream_Write(&g_CommandCapture, &command);
+}
+
+void CommandCapture_WriteBuffer(ID3D12Resource* resource, uint64_t offset, const void* data, size_t size)
+{
+    if (!IsCapturing())
+        return;
+    // In pieces the payload of a command can hold
+    const uint8_t* bytes = data;
+    const size_t maxSize = 64 * 1024 * 1024;
+    for (size_t written = 0; written < size; written += maxSize)
+    {
+        Command command = { .Opcode = COMMAND_WRITE_BUFFER };
+        command.WriteBuffer.Resource = GetId(resource);
+        command.WriteBuffer.Offset = offset + written;
+        command.WriteBuffer.Size = (uint32_t)MIN(size - written, maxSize);
+        command.WriteBuffer.Data = bytes + written;
+        CommandStream_Write(&g_CommandCapture, &command);
+    }
+}
+
+HRESULT CommandCapture_ResetList(ID3D12GraphicsCommandList* list, ID3D12CommandAllocator* allocator,
+                                 ID3D12PipelineState* pipelineState)
+{
+    HRESULT result = list->lpVtbl->Reset(list, allocator, pipelineState);
+    if (IsCapturing())
+    {
+        Command command = { .Opcode = COMMAND_RESET };
+        command.Reset.Allocator = GetId(allocator);
+        command.Reset.PipelineState = GetId(pipelineState);
+        WriteListCommand(list, &command);
+    }
+    return result;
+}
+
+HRESULT CommandCapture_CloseList(ID3D12GraphicsCommandList* list)
+{
+    HRESULT result = list->lpVtbl->Close(list);
+    if (IsCapturing())
+    {
+        Command command = { .Opcode = COMMAND_CLOSE };
+        WriteListCommand(list, &command);
+    }
+    return result;
+}
+
+void CommandCapture_ResourceBarrier(ID3D12GraphicsCommandList* list, UINT count, const D3D12_RESOURCE_BARRIER* barriers)
+{
+    list->lpVtbl->ResourceBarrier(list, count, barriers);
+    if (!IsCapturing())
+        return;
+    Command command;
+    command.Opcode = COMMAND_RESOURCE_BARRIER;
+    command.Barriers.Count = 0;
+    for (UINT i = 0; i < count; ++i)
+    {
+        const D3D12_RESOURCE_BARRIER* barrier = &barriers[i];
+        CommandBarrier* recorded = &command.Barriers.Barriers[command.Barriers.Count++];
+        memset(recorded, 0, sizeof(*recorded));
+        recorded->Type = barrier->Type;
+        recorded->Flags = barrier->Flags;
+        if (barrier->Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+        {
+            recorded->Resources[0] = GetId(barrier->Transition.pResource);
+            recorded->Subresource = barrier->Transition.Subresource;
+            recorded->States[0] = barrier->Transition.StateBefore;
+            recorded->States[1] = barrier->Transition.StateAfter;
+        }
+        else if (barrier->Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING)
+        {
+            recorded->Resources[0] = GetId(barrier->Aliasing.pResourceBefore);
+            recorded->Resources[1] = GetId(barrier->Aliasing.pResourceAfter);
+        }
+        else
+            recorded->Resources[0] = GetId(barrier->UAV.pResource);
+
+        if (command.Barriers.Count == COMMAND_STREAM_MAX_ELEMENTS || i + 1 == count)
+        {
+            WriteListCommand(list, &command);
+            command.Barriers.Count = 0;
+        }
+    }
+}
+
+static void WriteObjectCommand(ID3D12GraphicsCommandList* list, CommandOpcode opcode, const void* object)
+{
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = opcode, .Object = GetId(object) };
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_SetPipelineState(ID3D12GraphicsCommandList* list, ID3D12PipelineState* pipelineState)
+{
+    list->lpVtbl->SetPipelineState(list, pipelineState);
+    WriteObjectCommand(list, COMMAND_SET_PIPELINE_STATE, pipelineState);
+}
+
+void CommandCapture_SetGraphicsRootSignature(ID3D12GraphicsCommandList* list, ID3D12RootSignature* rootSignature)
+{
+    list->lpVtbl->SetGraphicsRootSignature(list, rootSignature);
+    WriteObjectCommand(list, COMMAND_SET_GRAPHICS_ROOT_SIGNATURE, rootSignature);
+}
+
+void CommandCapture_SetComputeRootSignature(ID3D12GraphicsCommandList* list, ID3D12RootSignature* rootSignature)
+{
+    list->lpVtbl->SetComputeRootSignature(list, rootSignature);
+    WriteObjectCommand(list, COMMAND_SET_COMPUTE_ROOT_SIGNATURE, rootSignature);
+}
+
+void CommandCapture_SetDescriptorHeaps(ID3D12GraphicsCommandList* list, UINT count, ID3D12DescriptorHeap* const* heaps)
+{
+    list->lpVtbl->SetDescriptorHeaps(list, count, heaps);
+    if (!IsCapturing())
+        return;
+    // There's at most one of each shader visible type
+    Command command = { .Opcode = COMMAND_SET_DESCRIPTOR_HEAPS };
+    command.DescriptorHeaps.Count = count;
+    for (UINT i = 0; i < count && i < COMMAND_STREAM_MAX_ELEMENTS; ++i)
+        command.DescriptorHeaps.Heaps[i] = GetId(heaps[i]);
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_IASetPrimitiveTopology(ID3D12GraphicsCommandList* list, D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    list->lpVtbl->IASetPrimitiveTopology(list, topology);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_SET_PRIMITIVE_TOPOLOGY, .PrimitiveTopology = topology };
+    WriteListCommand(list, &command);
+}
+
+static void WriteRootConstants(ID3D12GraphicsCommandList* list, CommandOpcode opcode, UINT parameter, UINT count,
+                               const void* values, UINT offset)
+{
+    if (!IsCapturing())
+        return;
+    Command command;
+    command.Opcode = opcode;
+    command.RootConstants.Parameter = parameter;
+    command.RootConstants.Offset = offset;
+    command.RootConstants.Count = count;
+    memcpy(command.RootConstants.Values, values, MIN(count, COMMAND_STREAM_MAX_CONSTANTS) * sizeof(uint32_t));
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_SetGraphicsRoot32BitConstants(ID3D12GraphicsCommandList* list, UINT parameter, UINT count,
+                                                  const void* values, UINT offset)
+{
+    list->lpVtbl->SetGraphicsRoot32BitConstants(list, parameter, count, values, offset);
+    WriteRootConstants(list, COMMAND_SET_GRAPHICS_ROOT_CONSTANTS, parameter, count, values, offset);
+}
+
+void CommandCapture_SetComputeRoot32BitConstants(ID3D12GraphicsCommandList* list, UINT parameter, UINT count,
+                                                 const void* values, UINT offset)
+{
+    list->lpVtbl->SetComputeRoot32BitConstants(list, parameter, count, values, offset);
+    WriteRootConstants(list, COMMAND_SET_COMPUTE_ROOT_CONSTANTS, parameter, count, values, offset);
+}
+
+static void WriteRootArgument(ID3D12GraphicsCommandList* list, CommandOpcode opcode, UINT parameter,
+                              CommandAddressSpace space, uint64_t address)
+{
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = opcode };
+    command.RootArgument.Parameter = parameter;
+    command.RootArgument.Address = Resolve(space, address);
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_SetGraphicsRootDescriptorTable(ID3D12GraphicsCommandList* list, UINT parameter,
+                                                   D3D12_GPU_DESCRIPTOR_HANDLE table)
+{
+    list->lpVtbl->SetGraphicsRootDescriptorTable(list, parameter, table);
+    WriteRootArgument(list, COMMAND_SET_GRAPHICS_ROOT_TABLE, parameter, COMMAND_ADDRESS_GPU_DESCRIPTOR, table.ptr);
+}
+
+void CommandCapture_SetComputeRootDescriptorTable(ID3D12GraphicsCommandList* list, UINT parameter,
+                                                  D3D12_GPU_DESCRIPTOR_HANDLE table)
+{
+    list->lpVtbl->SetComputeRootDescriptorTable(list, parameter, table);
+    WriteRootArgument(list, COMMAND_SET_COMPUTE_ROOT_TABLE, parameter, COMMAND_ADDRESS_GPU_DESCRIPTOR, table.ptr);
+}
+
+void CommandCapture_SetComputeRootConstantBufferView(ID3D12GraphicsCommandList* list, UINT parameter,
+                                                     D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    list->lpVtbl->SetComputeRootConstantBufferView(list, parameter, address);
+    WriteRootArgument(list, COMMAND_SET_COMPUTE_ROOT_CBV, parameter, COMMAND_ADDRESS_GPU_VIRTUAL, address);
+}
+
+void CommandCapture_SetComputeRootShaderResourceView(ID3D12GraphicsCommandList* list, UINT parameter,
+                                                     D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    list->lpVtbl->SetComputeRootShaderResourceView(list, parameter, address);
+    WriteRootArgument(list, COMMAND_SET_COMPUTE_ROOT_SRV, parameter, COMMAND_ADDRESS_GPU_VIRTUAL, address);
+}
+
+void CommandCapture_SetComputeRootUnorderedAccessView(ID3D12GraphicsCommandList* list, UINT parameter,
+                                                      D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    list->lpVtbl->SetComputeRootUnorderedAccessView(list, parameter, address);
+    WriteRootArgument(list, COMMAND_SET_COMPUTE_ROOT_UAV, parameter, COMMAND_ADDRESS_GPU_VIRTUAL, address);
+}
+
+void CommandCapture_IASetVertexBuffers(ID3D12GraphicsCommandList* list, UINT startSlot, UINT count,
+                                       const D3D12_VERTEX_BUFFER_VIEW* views)
+{
+    list->lpVtbl->IASetVertexBuffers(list, startSlot, count, views);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_SET_VERTEX_BUFFERS };
+    command.VertexBuffers.StartSlot = startSlot;
+    command.VertexBuffers.Count = count;
+    for (UINT i = 0; i < count && i < COMMAND_STREAM_MAX_ELEMENTS; ++i)
+    {
+        command.VertexBuffers.Views[i].Location = Resolve(COMMAND_ADDRESS_GPU_VIRTUAL, views[i].BufferLocation);
+        command.VertexBuffers.Views[i].Size = views[i].SizeInBytes;
+        command.VertexBuffers.Views[i].Stride = views[i].StrideInBytes;
+    }
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_IASetIndexBuffer(ID3D12GraphicsCommandList* list, const D3D12_INDEX_BUFFER_VIEW* view)
+{
+    list->lpVtbl->IASetIndexBuffer(list, view);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_SET_INDEX_BUFFER };
+    if (view != NULL)
+    {
+        command.IndexBuffer.Bound = true;
+        command.IndexBuffer.Location = Resolve(COMMAND_ADDRESS_GPU_VIRTUAL, view->BufferLocation);
+        command.IndexBuffer.Size = view->SizeInBytes;
+        command.IndexBuffer.Format = view->Format;
+    }
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_RSSetViewports(ID3D12GraphicsCommandList* list, UINT count, const D3D12_VIEWPORT* viewports)
+{
+    list->lpVtbl->RSSetViewports(list, count, viewports);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_SET_VIEWPORTS };
+    command.Viewports.Count = count;
+    for (UINT i = 0; i < count && i < COMMAND_STREAM_MAX_ELEMENTS; ++i)
+    {
+        command.Viewports.Viewports[i] = (CommandViewport){
+            viewports[i].TopLeftX, viewports[i].TopLeftY, viewports[i].Width, viewports[i].Height,
+            viewports[i].MinDepth, viewports[i].MaxDepth
+        };
+    }
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_RSSetScissorRects(ID3D12GraphicsCommandList* list, UINT count, const D3D12_RECT* rects)
+{
+    list->lpVtbl->RSSetScissorRects(list, count, rects);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_SET_SCISSOR_RECTS };
+    command.ScissorRects.Count = count;
+    for (UINT i = 0; i < count && i < COMMAND_STREAM_MAX_ELEMENTS; ++i)
+        command.ScissorRects.Rects[i] = (CommandRect){ rects[i].left, rects[i].top, rects[i].right, rects[i].bottom };
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_OMSetRenderTargets(ID3D12GraphicsCommandList* list, UINT count,
+                                       const D3D12_CPU_DESCRIPTOR_HANDLE* views, BOOL singleHandle,
+                                       const D3D12_CPU_DESCRIPTOR_HANDLE* depthStencil)
+{
+    list->lpVtbl->OMSetRenderTargets(list, count, views, singleHandle, depthStencil);
+    if (!IsCapturing())
+        return;
+    // A single handle is the start of a range of the views
+    Command command = { .Opcode = COMMAND_SET_RENDER_TARGETS };
+    command.RenderTargets.Count = count;
+    command.RenderTargets.SingleHandle = singleHandle;
+    for (UINT i = 0; i < count && i < COMMAND_STREAM_MAX_ELEMENTS; ++i)
+    {
+        if (i == 0 || !singleHandle)
+            command.RenderTargets.Views[i] = Resolve(COMMAND_ADDRESS_CPU_DESCRIPTOR, views[i].ptr);
+    }
+    command.RenderTargets.HasDepthStencil = depthStencil != NULL;
+    if (depthStencil != NULL)
+        command.RenderTargets.DepthStencil = Resolve(COMMAND_ADDRESS_CPU_DESCRIPTOR, depthStencil->ptr);
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_ClearRenderTargetView(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE view,
+                                          const FLOAT color[4], UINT rectCount, const D3D12_RECT* rects)
+{
+    list->lpVtbl->ClearRenderTargetView(list, view, color, rectCount, rects);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_CLEAR_RENDER_TARGET };
+    command.ClearRenderTarget.View = Resolve(COMMAND_ADDRESS_CPU_DESCRIPTOR, view.ptr);
+    memcpy(command.ClearRenderTarget.Color, color, sizeof(command.ClearRenderTarget.Color));
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_ClearDepthStencilView(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE view,
+                                          D3D12_CLEAR_FLAGS flags, FLOAT depth, UINT8 stencil, UINT rectCount,
+                                          const D3D12_RECT* rects)
+{
+    list->lpVtbl->ClearDepthStencilView(list, view, flags, depth, stencil, rectCount, rects);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_CLEAR_DEPTH_STENCIL };
+    command.ClearDepthStencil.View = Resolve(COMMAND_ADDRESS_CPU_DESCRIPTOR, view.ptr);
+    command.ClearDepthStencil.Flags = flags;
+    command.ClearDepthStencil.Depth = depth;
+    command.ClearDepthStencil.Stencil = stencil;
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_DrawInstanced(ID3D12GraphicsCommandList* list, UINT vertexCount, UINT instanceCount,
+                                  UINT startVertex, UINT startInstance)
+{
+    list->lpVtbl->DrawInstanced(list, vertexCount, instanceCount, startVertex, startInstance);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_DRAW, .Draw = { vertexCount, instanceCount, startVertex, startInstance } };
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_DrawIndexedInstanced(ID3D12GraphicsCommandList* list, UINT indexCount, UINT instanceCount,
+                                         UINT startIndex, INT baseVertex, UINT startInstance)
+{
+    list->lpVtbl->DrawIndexedInstanced(list, indexCount, instanceCount, startIndex, baseVertex, startInstance);
+    if (!IsCapturing())
+        return;
+    Command command = {
+        .Opcode = COMMAND_DRAW_INDEXED,
+        .DrawIndexed = { indexCount, instanceCount, startIndex, baseVertex, startInstance }
+    };
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_Dispatch(ID3D12GraphicsCommandList* list, UINT x, UINT y, UINT z)
+{
+    list->lpVtbl->Dispatch(list, x, y, z);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_DISPATCH, .Dispatch = { x, y, z } };
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_ExecuteBundle(ID3D12GraphicsCommandList* list, ID3D12GraphicsCommandList* bundle)
+{
+    list->lpVtbl->ExecuteBundle(list, bundle);
+    WriteObjectCommand(list, COMMAND_EXECUTE_BUNDLE, bundle);
+}
+
+void CommandCapture_ExecuteIndirect(ID3D12GraphicsCommandList* list, ID3D12CommandSignature* signature,
+                                    UINT maxCount, ID3D12Resource* arguments, UINT64 argumentOffset,
+                                    ID3D12Resource* countBuffer, UINT64 countOffset)
+{
+    list->lpVtbl->ExecuteIndirect(list, signature, maxCount, arguments, argumentOffset, countBuffer, countOffset);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_EXECUTE_INDIRECT };
+    command.ExecuteIndirect.Signature = GetId(signature);
+    command.ExecuteIndirect.MaxCount = maxCount;
+    command.ExecuteIndirect.Arguments = GetId(arguments);
+    command.ExecuteIndirect.ArgumentOffset = argumentOffset;
+    command.ExecuteIndirect.CountBuffer = GetId(countBuffer);
+    command.ExecuteIndirect.CountOffset = countOffset;
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_CopyBufferRegion(ID3D12GraphicsCommandList* list, ID3D12Resource* destination,
+                                     UINT64 destinationOffset, ID3D12Resource* source, UINT64 sourceOffset,
+                                     UINT64 size)
+{
+    list->lpVtbl->CopyBufferRegion(list, destination, destinationOffset, source, sourceOffset, size);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_COPY_BUFFER };
+    command.CopyBuffer.Destination = GetId(destination);
+    command.CopyBuffer.DestinationOffset = destinationOffset;
+    command.CopyBuffer.Source = GetId(source);
+    command.CopyBuffer.SourceOffset = sourceOffset;
+    command.CopyBuffer.Size = size;
+    WriteListCommand(list, &command);
+}
+
+static CommandCopyLocation RecordCopyLocation(const D3D12_TEXTURE_COPY_LOCATION* location)
+{
+    CommandCopyLocation recorded = { .Resource = GetId(location->pResource), .Type = location->Type };
+    if (location->Type == D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX)
+        recorded.Subresource = location->SubresourceIndex;
+    else
+    {
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT* footprint = &location->PlacedFootprint;
+        recorded.Offset = footprint->Offset;
+        recorded.Format = footprint->Footprint.Format;
+        recorded.Width = footprint->Footprint.Width;
+        recorded.Height = footprint->Footprint.Height;
+        recorded.Depth = footprint->Footprint.Depth;
+        recorded.RowPitch = footprint->Footprint.RowPitch;
+    }
+    return recorded;
+}
+
+void CommandCapture_CopyTextureRegion(ID3D12GraphicsCommandList* list, const D3D12_TEXTURE_COPY_LOCATION* destination,
+                                      UINT x, UINT y, UINT z, const D3D12_TEXTURE_COPY_LOCATION* source,
+                                      const D3D12_BOX* box)
+{
+    list->lpVtbl->CopyTextureRegion(list, destination, x, y, z, source, box);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_COPY_TEXTURE };
+    command.CopyTexture.Destination = RecordCopyLocation(destination);
+    command.CopyTexture.X = x;
+    command.CopyTexture.Y = y;
+    command.CopyTexture.Z = z;
+    command.CopyTexture.Source = RecordCopyLocation(source);
+    command.CopyTexture.HasBox = box != NULL;
+    if (box != NULL)
+    {
+        uint32_t bounds[6] = { box->left, box->top, box->front, box->right, box->bottom, box->back };
+        memcpy(command.CopyTexture.Box, bounds, sizeof(bounds));
+    }
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_EndQuery(ID3D12GraphicsCommandList* list, ID3D12QueryHeap* heap, D3D12_QUERY_TYPE type, UINT index)
+{
+    list->lpVtbl->EndQuery(list, heap, type, index);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_END_QUERY, .Query = { GetId(heap), type, index } };
+    WriteListCommand(list, &command);
+}
+
+void CommandCapture_ResolveQueryData(ID3D12GraphicsCommandList* list, ID3D12QueryHeap* heap, D3D12_QUERY_TYPE type,
+                                     UINT start, UINT count, ID3D12Resource* destination, UINT64 destinationOffset)
+{
+    list->lpVtbl->ResolveQueryData(list, heap, type, start, count, destination, destinationOffset);
+    if (!IsCapturing())
+        return;
+    Command command = {
+        .Opcode = COMMAND_RESOLVE_QUERY,
+        .ResolveQuery = { GetId(heap), type, start, count, GetId(destination), destinationOffset }
+    };
+    WriteListCommand(list, &command);
+}
+
+HRESULT CommandCapture_ResetAllocator(ID3D12CommandAllocator* allocator)
+{
+    HRESULT result = allocator->lpVtbl->Reset(allocator);
+    if (IsCapturing())
+    {
+        Command command = { .Opcode = COMMAND_RESET_ALLOCATOR, .Object = GetId(allocator) };
+        CommandStream_Write(&g_CommandCapture, &command);
+    }
+    return result;
+}
+
+void CommandCapture_ExecuteCommandLists(ID3D12CommandQueue* queue, UINT count, ID3D12CommandList* const* lists)
+{
+    queue->lpVtbl->ExecuteCommandLists(queue, count, lists);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_EXECUTE_LISTS };
+    command.ExecuteLists.Queue = GetId(queue);
+    command.ExecuteLists.Count = count;
+    for (UINT i = 0; i < count && i < COMMAND_STREAM_MAX_ELEMENTS; ++i)
+        command.ExecuteLists.Lists[i] = GetId(lists[i]);
+    CommandStream_Write(&g_CommandCapture, &command);
+}
+
+HRESULT CommandCapture_GetBuffer(IDXGISwapChain4* swapChain, UINT index, REFIID riid, void** surface)
+{
+    HRESULT result = swapChain->lpVtbl->GetBuffer(swapChain, index, riid, surface);
+    if (SUCCEEDED(result))
+        CommandStream_AddObject(&g_CommandCapture, *surface);
+    return result;
+}
+
+HRESULT CommandCapture_Present(IDXGISwapChain4* swapChain, UINT syncInterval, UINT flags)
+{
+    HRESULT result = swapChain->lpVtbl->Present(swapChain, syncInterval, flags);
+    if (IsCapturing())
+    {
+        Command command = { .Opcode = COMMAND_PRESENT, .Present = { syncInterval, flags } };
+        CommandStream_Write(&g_CommandCapture, &command);
+    }
+    return result;
+}
+
+// Buffers are addressed by their GPU virtual addresses
+static void AddResource(uint32_t id, ID3D12Resource* resource, const D3D12_RESOURCE_DESC* desc)
+{
+    if (desc->Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        CommandStream_AddRange(&g_CommandCapture, COMMAND_ADDRESS_GPU_VIRTUAL, id,
+                               resource->lpVtbl->GetGPUVirtualAddress(resource), desc->Width);
+    }
+}
+
+HRESULT CommandCapture_CreateCommittedResource(ID3D12Device2* device, const D3D12_HEAP_PROPERTIES* heapProperties,
+                                               D3D12_HEAP_FLAGS heapFlags, const D3D12_RESOURCE_DESC* desc,
+                                               D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue,
+                                               REFIID riid, void** resource)
+{
+    HRESULT result = device->lpVtbl->CreateCommittedResource(device, heapProperties, heapFlags, desc, initialState,
+                                                             clearValue, riid, resource);
+    if (FAILED(result) || resource == NULL)
+        return result;
+
+    ID3D12Resource* created = *resource;
+    uint32_t id = CommandStream_AddObject(&g_CommandCapture, created);
+    AddResource(id, created, desc);
+    if (!IsCapturing())
+        return result;
+
+    Command command = { .Opcode = COMMAND_CREATE_RESOURCE };
+    command.CreateResource.Resource = id;
+    command.CreateResource.HeapType = heapProperties->Type;
+    command.CreateResource.HeapFlags = heapFlags;
+    command.CreateResource.Desc = (CommandResourceDesc){
+        .Dimension = desc->Dimension,
+        .Alignment = desc->Alignment,
+        .Width = desc->Width,
+        .Height = desc->Height,
+        .DepthOrArraySize = desc->DepthOrArraySize,
+        .MipLevels = desc->MipLevels,
+        .Format = desc->Format,
+        .SampleCount = desc->SampleDesc.Count,
+        .SampleQuality = desc->SampleDesc.Quality,
+        .Layout = desc->Layout,
+        .Flags = desc->Flags
+    };
+    command.CreateResource.InitialState = initialState;
+    command.CreateResource.HasClearValue = clearValue != NULL;
+    if (clearValue != NULL)
+    {
+        command.CreateResource.ClearFormat = clearValue->Format;
+        if (desc->Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)
+        {
+            command.CreateResource.ClearValue[0] = clearValue->DepthStencil.Depth;
+            command.CreateResource.ClearValue[1] = clearValue->DepthStencil.Stencil;
+        }
+        else
+            memcpy(command.CreateResource.ClearValue, clearValue->Color, sizeof(command.CreateResource.ClearValue));
+    }
+    CommandStream_Write(&g_CommandCapture, &command);
+    return result;
+}
+
+HRESULT CommandCapture_CreateDescriptorHeap(ID3D12Device2* device, const D3D12_DESCRIPTOR_HEAP_DESC* desc, REFIID riid,
+                                            void** heap)
+{
+    HRESULT result = device->lpVtbl->CreateDescriptorHeap(device, desc, riid, heap);
+    if (FAILED(result))
+        return result;
+
+    // Handles are recorded as the index into their heap
+    ID3D12DescriptorHeap* created = *heap;
+    uint32_t id = CommandStream_AddObject(&g_CommandCapture, created);
+    uint64_t size = (uint64_t)desc->NumDescriptors *
+                    device->lpVtbl->GetDescriptorHandleIncrementSize(device, desc->Type);
+    D3D12_CPU_DESCRIPTOR_HANDLE cpuStart;
+    created->lpVtbl->GetCPUDescriptorHandleForHeapStart(created, &cpuStart);
+    CommandStream_AddRange(&g_CommandCapture, COMMAND_ADDRESS_CPU_DESCRIPTOR, id, cpuStart.ptr, size);
+    if (desc->Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE)
+    {
+        D3D12_GPU_DESCRIPTOR_HANDLE gpuStart;
+        created->lpVtbl->GetGPUDescriptorHandleForHeapStart(created, &gpuStart);
+        CommandStream_AddRange(&g_CommandCapture, COMMAND_ADDRESS_GPU_DESCRIPTOR, id, gpuStart.ptr, size);
+    }
+    return result;
+}
+
+void CommandCapture_CreateDepthStencilView(ID3D12Device2* device, ID3D12Resource* resource,
+                                           const D3D12_DEPTH_STENCIL_VIEW_DESC* desc, D3D12_CPU_DESCRIPTOR_HANDLE view)
+{
+    device->lpVtbl->CreateDepthStencilView(device, resource, desc, view);
+    if (!IsCapturing())
+        return;
+    Command command = { .Opcode = COMMAND_CREATE_DEPTH_STENCIL_VIEW };
+    command.CreateDepthStencilView.Resource = GetId(resource);
+    command.CreateDepthStencilView.HasDesc = desc != NULL;
+    if (desc != NULL)
+    {
+        // Only the first mip of 2D textures, the views the app creates
+        command.CreateDepthStencilView.Format = desc->Format;
+        command.CreateDepthStencilView.Dimension = desc->ViewDimension;
+        command.CreateDepthStencilView.MipSlice = desc->Texture2D.MipSlice;
+        command.CreateDepthStencilView.Flags = desc->Flags;
+    }
+    command.CreateDepthStencilView.View = Resolve(COMMAND_ADDRESS_CPU_DESCRIPTOR, view.ptr);
+    CommandStream_Write(&g_CommandCapture, &command);
+}
+
+static HRESULT AddCreated(HRESULT result, void** object)
+{
+    if (SUCCEEDED(result) && object != NULL)
+        CommandStream_AddObject(&g_CommandCapture, *object);
+    return result;
+}
+
+HRESULT CommandCapture_CreateCommandQueue(ID3D12Device2* device, const D3D12_COMMAND_QUEUE_DESC* desc, REFIID riid,
+                                          void** queue)
+{
+    return AddCreated(device->lpVtbl->CreateCommandQueue(device, desc, riid, queue), queue);
+}
+
+HRESULT CommandCapture_CreateCommandAllocator(ID3D12Device2* device, D3D12_COMMAND_LIST_TYPE type, REFIID riid,
+                                              void** allocator)
+{
+    return AddCreated(device->lpVtbl->CreateCommandAllocator(device, type, riid, allocator), allocator);
+}
+
+HRESULT CommandCapture_CreateCommandList(ID3D12Device2* device, UINT nodeMask, D3D12_COMMAND_LIST_TYPE type,
+                                         ID3D12CommandAllocator* allocator, ID3D12PipelineState* pipelineState,
+                                         REFIID riid, void** list)
+{
+    return AddCreated(device->lpVtbl->CreateCommandList(device, nodeMask, type, allocator, pipelineState, riid, list),
+                      list);
+}
+
+HRESULT CommandCapture_CreateRootSignature(ID3D12Device2* device, UINT nodeMask, const void* blob, SIZE_T size,
+                                           REFIID riid, void** rootSignature)
+{
+    return AddCreated(device->lpVtbl->CreateRootSignature(device, nodeMask, blob, size, riid, rootSignature),
+                      rootSignature);
+}
+
+HRESULT CommandCapture_CreateGraphicsPipelineState(ID3D12Device2* device, const D3D12_GRAPHICS_PIPELINE_STATE_DESC* desc,
+                                                   REFIID riid, void** pipelineState)
+{
+    return AddCreated(device->lpVtbl->CreateGraphicsPipelineState(device, desc, riid, pipelineState), pipelineState);
+}
+
+HRESULT CommandCapture_CreateComputePipelineState(ID3D12Device2* device, const D3D12_COMPUTE_PIPELINE_STATE_DESC* desc,
+                                                  REFIID riid, void** pipelineState)
+{
+    return AddCreated(device->lpVtbl->CreateComputePipelineState(device, desc, riid, pipelineState), pipelineState);
+}
+
+HRESULT CommandCapture_CreateCommandSignature(ID3D12Device2* device, const D3D12_COMMAND_SIGNATURE_DESC* desc,
+                                              ID3D12RootSignature* rootSignature, REFIID riid, void** signature)
+{
+    return AddCreated(device->lpVtbl->CreateCommandSignature(device, desc, rootSignature, riid, signature), signature);
+}
+
+HRESULT CommandCapture_CreateQueryHeap(ID3D12Device2* device, const D3D12_QUERY_HEAP_DESC* desc, REFIID riid,
+                                       void** heap)
+{
+    return AddCreated(device->lpVtbl->CreateQueryHeap(device, desc, riid, heap), heap);
+}
+
+typedef struct ReplayAllocator
+{
+    uint32_t Id;
+    // Of the last submission of a list recorded with it
+    uint64_t FenceValue;
+    // Reset since the last submission
+    bool Pending;
+} ReplayAllocator;
+
+typedef struct CommandReplay
+{
+    const CommandReplayTarget* Target;
+    CommandReplayStats* Stats;
+    ID3D12GraphicsCommandList* List;
+    // The commands before the first frame were the loading
+    bool Started;
+    ReplayAllocator Allocators[REPLAY_MAX_ALLOCATORS];
+    uint32_t AllocatorCount;
+    // Created by the replay, released after it
+    ID3D12Resource** Resources;
+    uint32_t ResourceCount;
+    uint32_t ResourceCapacity;
+    LARGE_INTEGER WaitTicks;
+} CommandReplay;
+
+// False for an id without an object, 0 is NULL
+static bool Find(uint32_t id, void** object)
+{
+    *object = (void*)CommandStream_FindObject(&g_CommandCapture, id);
+    return id == COMMAND_STREAM_NO_OBJECT || *object != NULL;
+}
+
+static bool Unresolve(CommandAddressSpace space, CommandAddress address, uint64_t* value)
+{
+    void* object;
+    *value = CommandStream_Unresolve(&g_CommandCapture, space, address);
+    return Find(address.Object, &object);
+}
+
+static ReplayAllocator* FindAllocator(CommandReplay* replay, uint32_t id)
+{
+    for (uint32_t i = 0; i < replay->AllocatorCount; ++i)
+    {
+        if (replay->Allocators[i].Id == id)
+            return &replay->Allocators[i];
+    }
+    if (replay->AllocatorCount == REPLAY_MAX_ALLOCATORS)
+        return NULL;
+    ReplayAllocator* allocator = &replay->Allocators[replay->AllocatorCount++];
+    *allocator = (ReplayAllocator){ .Id = id };
+    return allocator;
+}
+
+static void WaitForFence(CommandReplay* replay, uint64_t value)
+{
+    ID3D12Fence* fence = replay->Target->Fence;
+    if (fence->lpVtbl->GetCompletedValue(fence) >= value)
+        return;
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+    fence->lpVtbl->SetEventOnCompletion(fence, value, replay->Target->FenceEvent);
+    WaitForSingleObject(replay->Target->FenceEvent, INFINITE);
+    QueryPerformanceCounter(&end);
+    replay->WaitTicks.QuadPart += end.QuadPart - start.QuadPart;
+}
+
+static D3D12_TEXTURE_COPY_LOCATION ReplayCopyLocation(const CommandCopyLocation* location, ID3D12Resource* resource)
+{
+    D3D12_TEXTURE_COPY_LOCATION replayed = { .pResource = resource, .Type = location->Type };
+    if (location->Type == D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX)
+        replayed.SubresourceIndex = location->Subresource;
+    else
+    {
+        replayed.PlacedFootprint.Offset = location->Offset;
+        replayed.PlacedFootprint.Footprint = (D3D12_SUBRESOURCE_FOOTPRINT){
+            location->Format, location->Width, location->Height, location->Depth, location->RowPitch
+        };
+    }
+    return replayed;
+}
+
+static bool ReplayCreateResource(CommandReplay* replay, const Command* command)
+{
+    // The startup of this process created it already
+    void* existing;
+    if (Find(command->CreateResource.Resource, &existing) && existing != NULL)
+        return true;
+
+    if (replay->ResourceCount == replay->ResourceCapacity)
+    {
+        uint32_t capacity = replay->ResourceCapacity ? 2 * replay->ResourceCapacity : 64;
+        ID3D12Resource** resources = realloc(replay->Resources, capacity * sizeof(ID3D12Resource*));
+        if (resources == NULL)
+            return false;
+        replay->Resources = resources;
+        replay->ResourceCapacity = capacity;
+    }
+
+    const CommandResourceDesc* recorded = &command->CreateResource.Desc;
+    D3D12_HEAP_PROPERTIES heapProperties = {
+        .Type = command->CreateResource.HeapType,
+        .CreationNodeMask = 1,
+        .VisibleNodeMask = 1
+    };
+    D3D12_RESOURCE_DESC desc = {
+        .Dimension = recorded->Dimension,
+        .Alignment = recorded->Alignment,
+        .Width = recorded->Width,
+        .Height = recorded->Height,
+        .DepthOrArraySize = (UINT16)recorded->DepthOrArraySize,
+        .MipLevels = (UINT16)recorded->MipLevels,
+        .Format = recorded->Format,
+        .SampleDesc = { recorded->SampleCount, recorded->SampleQuality },
+        .Layout = recorded->Layout,
+        .Flags = recorded->Flags
+    };
+    D3D12_CLEAR_VALUE clearValue = { .Format = command->CreateResource.ClearFormat };
+    if (desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)
+    {
+        clearValue.DepthStencil.Depth = command->CreateResource.ClearValue[0];
+        clearValue.DepthStencil.Stencil = (UINT8)command->CreateResource.ClearValue[1];
+    }
+    else
+        memcpy(clearValue.Color, command->CreateResource.ClearValue, sizeof(clearValue.Color));
+
+    ID3D12Device2* device = replay->Target->Device;
+    ID3D12Resource* resource;
+    if (FAILED(device->lpVtbl->CreateCommittedResource(device, &heapProperties, command->CreateResource.HeapFlags,
+                                                       &desc, command->CreateResource.InitialState,
+                                                       command->CreateResource.HasClearValue ? &clearValue : NULL,
+                                                       &IID_ID3D12Resource, (void**)&resource)))
+        return false;
+    replay->Resources[replay->ResourceCount++] = resource;
+    CommandStream_BindObject(&g_CommandCapture, command->CreateResource.Resource, resource);
+    AddResource(command->CreateResource.Resource, resource, &desc);
+    return true;
+}
+
+// Submits the command, false when it's on objects the replay doesn't have
+static bool ReplayCommand(CommandReplay* replay, const Command* command)
+{
+    ID3D12GraphicsCommandList* list = replay->List;
+    void* objects[COMMAND_STREAM_MAX_ELEMENTS];
+    void* object;
+    void* other;
+    uint64_t address;
+
+    switch (command->Opcode)
+    {
+    case COMMAND_FRAME:
+        replay->Stats->Frames++;
+        return true;
+    case COMMAND_SET_LIST:
+        replay->List = Find(command->Object, &object) ? object : NULL;
+        return replay->List != NULL;
+    case COMMAND_RESET_ALLOCATOR:
+    {
+        ReplayAllocator* allocator = FindAllocator(replay, command->Object);
+        if (!Find(command->Object, &object) || object == NULL || allocator == NULL)
+            return false;
+        WaitForFence(replay, allocator->FenceValue);
+        ID3D12CommandAllocator* commandAllocator = object;
+        commandAllocator->lpVtbl->Reset(commandAllocator);
+        allocator->Pending = true;
+        return true;
+    }
+    case COMMAND_EXECUTE_LISTS:
+    {
+        ID3D12CommandQueue* queue;
+        if (!Find(command->ExecuteLists.Queue, (void**)&queue) || queue == NULL)
+            return false;
+        for (uint32_t i = 0; i < command->ExecuteLists.Count; ++i)
+        {
+            if (!Find(command->ExecuteLists.Lists[i], &objects[i]) || objects[i] == NULL)
+                return false;
+        }
+        queue->lpVtbl->ExecuteCommandLists(queue, command->ExecuteLists.Count, (ID3D12CommandList* const*)objects);
+
+        // Every allocator reset since the previous submission is in use until this one is done
+        uint64_t fenceValue = ++*replay->Target->FenceValue;
+        queue->lpVtbl->Signal(queue, replay->Target->Fence, fenceValue);
+        for (uint32_t i = 0; i < replay->AllocatorCount; ++i)
+        {
+            if (replay->Allocators[i].Pending)
+            {
+                replay->Allocators[i].FenceValue = fenceValue;
+                replay->Allocators[i].Pending = false;
+            }
+        }
+        return true;
+    }
+    case COMMAND_PRESENT:
+        replay->Target->SwapChain->lpVtbl->Present(replay->Target->SwapChain, command->Present.SyncInterval,
+                                                   command->Present.Flags);
+        return true;
+    case COMMAND_CREATE_RESOURCE:
+        return ReplayCreateResource(replay, command);
+    case COMMAND_CREATE_DEPTH_STENCIL_VIEW:
+    {
+        D3D12_DEPTH_STENCIL_VIEW_DESC desc = {
+            .Format = command->CreateDepthStencilView.Format,
+            .ViewDimension = command->CreateDepthStencilView.Dimension,
+            .Flags = command->CreateDepthStencilView.Flags,
+            .Texture2D = { command->CreateDepthStencilView.MipSlice }
+        };
+        D3D12_CPU_DESCRIPTOR_HANDLE view;
+        if (!Find(command->CreateDepthStencilView.Resource, &object) ||
+            !Unresolve(COMMAND_ADDRESS_CPU_DESCRIPTOR, command->CreateDepthStencilView.View, &view.ptr))
+            return false;
+        ID3D12Device2* device = replay->Target->Device;
+        device->lpVtbl->CreateDepthStencilView(device, object, command->CreateDepthStencilView.HasDesc ? &desc : NULL,
+                                               view);
+        return true;
+    }
+    case COMMAND_WRITE_BUFFER:
+    {
+        ID3D12Resource* resource;
+        if (!Find(command->WriteBuffer.Resource, (void**)&resource) || resource == NULL)
+            return false;
+        D3D12_RANGE readRange = { 0, 0 };
+        D3D12_RANGE writtenRange = { command->WriteBuffer.Offset, command->WriteBuffer.Offset + command->WriteBuffer.Size };
+        uint8_t* data;
+        if (FAILED(resource->lpVtbl->Map(resource, 0, &readRange, (void**)&data)))
+            return false;
+        memcpy(data + command->WriteBuffer.Offset, command->WriteBuffer.Data, command->WriteBuffer.Size);
+        resource->lpVtbl->Unmap(resource, 0, &writtenRange);
+        return true;
+    }
+    default:
+        break;
+    }
+
+    // The rest are recorded into the current list
+    if (list == NULL)
+        return false;
+    switch (command->Opcode)
+    {
+    case COMMAND_RESET:
+    {
+        ReplayAllocator* allocator = FindAllocator(replay, command->Reset.Allocator);
+        if (!Find(command->Reset.Allocator, &object) || !Find(command->Reset.PipelineState, &other) ||
+            allocator == NULL)
+            return false;
+        list->lpVtbl->Reset(list, object, other);
+        allocator->Pending = true;
+        break;
+    }
+    case COMMAND_CLOSE:
+        list->lpVtbl->Close(list);
+        break;
+    case COMMAND_RESOURCE_BARRIER:
+    {
+        D3D12_RESOURCE_BARRIER barriers[COMMAND_STREAM_MAX_ELEMENTS];
+        for (uint32_t i = 0; i < command->Barriers.Count; ++i)
+        {
+            const CommandBarrier* recorded = &command->Barriers.Barriers[i];
+            if (!Find(recorded->Resources[0], &object) || !Find(recorded->Resources[1], &other))
+                return false;
+            barriers[i] = (D3D12_RESOURCE_BARRIER){ .Type = recorded->Type, .Flags = recorded->Flags };
+            if (recorded->Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+            {
+                barriers[i].Transition = (D3D12_RESOURCE_TRANSITION_BARRIER){
+                    object, recorded->Subresource, recorded->States[0], recorded->States[1]
+                };
+            }
+            else if (recorded->Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING)
+                barriers[i].Aliasing = (D3D12_RESOURCE_ALIASING_BARRIER){ object, other };
+            else
+                barriers[i].UAV.pResource = object;
+        }
+        list->lpVtbl->ResourceBarrier(list, command->Barriers.Count, barriers);
+        break;
+    }
+    case COMMAND_SET_PIPELINE_STATE:
+        if (!Find(command->Object, &object))
+            return false;
+        list->lpVtbl->SetPipelineState(list, object);
+        break;
+    case COMMAND_SET_GRAPHICS_ROOT_SIGNATURE:
+        if (!Find(command->Object, &object))
+            return false;
+        list->lpVtbl->SetGraphicsRootSignature(list, object);
+        break;
+    case COMMAND_SET_COMPUTE_ROOT_SIGNATURE:
+        if (!Find(command->Object, &object))
+            return false;
+        list->lpVtbl->SetComputeRootSignature(list, object);
+        break;
+    case COMMAND_SET_DESCRIPTOR_HEAPS:
+        for (uint32_t i = 0; i < command->DescriptorHeaps.Count; ++i)
+        {
+            if (!Find(command->DescriptorHeaps.Heaps[i], &objects[i]))
+                return false;
+        }
+        list->lpVtbl->SetDescriptorHeaps(list, command->DescriptorHeaps.Count, (ID3D12DescriptorHeap* const*)objects);
+        break;
+    case COMMAND_SET_PRIMITIVE_TOPOLOGY:
+        list->lpVtbl->IASetPrimitiveTopology(list, command->PrimitiveTopology);
+        break;
+    case COMMAND_SET_GRAPHICS_ROOT_CONSTANTS:
+        list->lpVtbl->SetGraphicsRoot32BitConstants(list, command->RootConstants.Parameter, command->RootConstants.Count,
+                                                    command->RootConstants.Values, command->RootConstants.Offset);
+        break;
+    case COMMAND_SET_COMPUTE_ROOT_CONSTANTS:
+        list->lpVtbl->SetComputeRoot32BitConstants(list, command->RootConstants.Parameter, command->RootConstants.Count,
+                                                   command->RootConstants.Values, command->RootConstants.Offset);
+        break;
+    case COMMAND_SET_GRAPHICS_ROOT_TABLE:
+    case COMMAND_SET_COMPUTE_ROOT_TABLE:
+    {
+        D3D12_GPU_DESCRIPTOR_HANDLE table;
+        if (!Unresolve(COMMAND_ADDRESS_GPU_DESCRIPTOR, command->RootArgument.Address, &table.ptr))
+            return false;
+        if (command->Opcode == COMMAND_SET_GRAPHICS_ROOT_TABLE)
+            list->lpVtbl->SetGraphicsRootDescriptorTable(list, command->RootArgument.Parameter, table);
+        else
+            list->lpVtbl->SetComputeRootDescriptorTable(list, command->RootArgument.Parameter, table);
+        break;
+    }
+    case COMMAND_SET_COMPUTE_ROOT_CBV:
+    case COMMAND_SET_COMPUTE_ROOT_SRV:
+    case COMMAND_SET_COMPUTE_ROOT_UAV:
+        if (!Unresolve(COMMAND_ADDRESS_GPU_VIRTUAL, command->RootArgument.Address, &address))
+            return false;
+        if (command->Opcode == COMMAND_SET_COMPUTE_ROOT_CBV)
+            list->lpVtbl->SetComputeRootConstantBufferView(list, command->RootArgument.Parameter, address);
+        else if (command->Opcode == COMMAND_SET_COMPUTE_ROOT_SRV)
+            list->lpVtbl->SetComputeRootShaderResourceView(list, command->RootArgument.Parameter, address);
+        else
+            list->lpVtbl->SetComputeRootUnorderedAccessView(list, command->RootArgument.Parameter, address);
+        break;
+    case COMMAND_SET_VERTEX_BUFFERS:
+    {
+        D3D12_VERTEX_BUFFER_VIEW views[COMMAND_STREAM_MAX_ELEMENTS];
+        for (uint32_t i = 0; i < command->VertexBuffers.Count; ++i)
+        {
+            const CommandVertexBuffer* recorded = &command->VertexBuffers.Views[i];
+            if (!Unresolve(COMMAND_ADDRESS_GPU_VIRTUAL, recorded->Location, &views[i].BufferLocation))
+                return false;
+            views[i].SizeInBytes = recorded->Size;
+            views[i].StrideInBytes = recorded->Stride;
+        }
+        list->lpVtbl->IASetVertexBuffers(list, command->VertexBuffers.StartSlot, command->VertexBuffers.Count, views);
+        break;
+    }
+    case COMMAND_SET_INDEX_BUFFER:
+    {
+        D3D12_INDEX_BUFFER_VIEW view = {
+            .SizeInBytes = command->IndexBuffer.Size,
+            .Format = command->IndexBuffer.Format
+        };
+        if (!Unresolve(COMMAND_ADDRESS_GPU_VIRTUAL, command->IndexBuffer.Location, &view.BufferLocation))
+            return false;
+        list->lpVtbl->IASetIndexBuffer(list, command->IndexBuffer.Bound ? &view : NULL);
+        break;
+    }
+    case COMMAND_SET_VIEWPORTS:
+    {
+        D3D12_VIEWPORT viewports[COMMAND_STREAM_MAX_ELEMENTS];
+        for (uint32_t i = 0; i < command->Viewports.Count; ++i)
+        {
+            const CommandViewport* recorded = &command->Viewports.Viewports[i];
+            viewports[i] = (D3D12_VIEWPORT){
+                recorded->X, recorded->Y, recorded->Width, recorded->Height, recorded->MinDepth, recorded->MaxDepth
+            };
+        }
+        list->lpVtbl->RSSetViewports(list, command->Viewports.Count, viewports);
+        break;
+    }
+    case COMMAND_SET_SCISSOR_RECTS:
+    {
+        D3D12_RECT rects[COMMAND_STREAM_MAX_ELEMENTS];
+        for (uint32_t i = 0; i < command->ScissorRects.Count; ++i)
+        {
+            const CommandRect* recorded = &command->ScissorRects.Rects[i];
+            rects[i] = (D3D12_RECT){ recorded->Left, recorded->Top, recorded->Right, recorded->Bottom };
+        }
+        list->lpVtbl->RSSetScissorRects(list, command->ScissorRects.Count, rects);
+        break;
+    }
+    case COMMAND_SET_RENDER_TARGETS:
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE views[COMMAND_STREAM_MAX_ELEMENTS];
+        D3D12_CPU_DESCRIPTOR_HANDLE depthStencil;
+        uint32_t viewCount = command->RenderTargets.SingleHandle ? MIN(command->RenderTargets.Count, 1) :
+                                                                   command->RenderTargets.Count;
+        for (uint32_t i = 0; i < viewCount; ++i)
+        {
+            if (!Unresolve(COMMAND_ADDRESS_CPU_DESCRIPTOR, command->RenderTargets.Views[i], &views[i].ptr))
+                return false;
+        }
+        if (!Unresolve(COMMAND_ADDRESS_CPU_DESCRIPTOR, command->RenderTargets.DepthStencil, &depthStencil.ptr))
+            return false;
+        list->lpVtbl->OMSetRenderTargets(list, command->RenderTargets.Count, views, command->RenderTargets.SingleHandle,
+                                         command->RenderTargets.HasDepthStencil ? &depthStencil : NULL);
+        break;
+    }
+    case COMMAND_CLEAR_RENDER_TARGET:
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE view;
+        if (!Unresolve(COMMAND_ADDRESS_CPU_DESCRIPTOR, command->ClearRenderTarget.View, &view.ptr))
+            return false;
+        list->lpVtbl->ClearRenderTargetView(list, view, command->ClearRenderTarget.Color, 0, NULL);
+        break;
+    }
+    case COMMAND_CLEAR_DEPTH_STENCIL:
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE view;
+        if (!Unresolve(COMMAND_ADDRESS_CPU_DESCRIPTOR, command->ClearDepthStencil.View, &view.ptr))
+            return false;
+        list->lpVtbl->ClearDepthStencilView(list, view, command->ClearDepthStencil.Flags, command->ClearDepthStencil.Depth,
+                                            (UINT8)command->ClearDepthStencil.Stencil, 0, NULL);
+        break;
+    }
+    case COMMAND_DRAW:
+        list->lpVtbl->DrawInstanced(list, command->Draw.VertexCount, command->Draw.InstanceCount,
+                                    command->Draw.StartVertex, command->Draw.StartInstance);
+        break;
+    case COMMAND_DRAW_INDEXED:
+        list->lpVtbl->DrawIndexedInstanced(list, command->DrawIndexed.IndexCount, command->DrawIndexed.InstanceCount,
+                                           command->DrawIndexed.StartIndex, command->DrawIndexed.BaseVertex,
+                                           command->DrawIndexed.StartInstance);
+        break;
+    case COMMAND_DISPATCH:
+        list->lpVtbl->Dispatch(list, command->Dispatch.X, command->Dispatch.Y, command->Dispatch.Z);
+        break;
+    case COMMAND_EXECUTE_BUNDLE:
+        if (!Find(command->Object, &object) || object == NULL)
+            return false;
+        list->lpVtbl->ExecuteBundle(list, object);
+        break;
+    case COMMAND_EXECUTE_INDIRECT:
+    {
+        void* arguments;
+        if (!Find(command->ExecuteIndirect.Signature, &object) || object == NULL ||
+            !Find(command->ExecuteIndirect.Arguments, &arguments) || arguments == NULL ||
+            !Find(command->ExecuteIndirect.CountBuffer, &other))
+            return false;
+        list->lpVtbl->ExecuteIndirect(list, object, command->ExecuteIndirect.MaxCount, arguments,
+                                      command->ExecuteIndirect.ArgumentOffset, other,
+                                      command->ExecuteIndirect.CountOffset);
+        break;
+    }
+    case COMMAND_COPY_BUFFER:
+        if (!Find(command->CopyBuffer.Destination, &object) || object == NULL ||
+            !Find(command->CopyBuffer.Source, &other) || other == NULL)
+            return false;
+        list->lpVtbl->CopyBufferRegion(list, object, command->CopyBuffer.DestinationOffset, other,
+                                       command->CopyBuffer.SourceOffset, command->CopyBuffer.Size);
+        break;
+    case COMMAND_COPY_TEXTURE:
+    {
+        if (!Find(command->CopyTexture.Destination.Resource, &object) || object == NULL ||
+            !Find(command->CopyTexture.Source.Resource, &other) || other == NULL)
+            return false;
+        D3D12_TEXTURE_COPY_LOCATION destination = ReplayCopyLocation(&command->CopyTexture.Destination, object);
+        D3D12_TEXTURE_COPY_LOCATION source = ReplayCopyLocation(&command->CopyTexture.Source, other);
+        const uint32_t* bounds = command->CopyTexture.Box;
+        D3D12_BOX box = { bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5] };
+        list->lpVtbl->CopyTextureRegion(list, &destination, command->CopyTexture.X, command->CopyTexture.Y,
+                                        command->CopyTexture.Z, &source, command->CopyTexture.HasBox ? &box : NULL);
+        break;
+    }
+    case COMMAND_END_QUERY:
+        if (!Find(command->Query.Heap, &object) || object == NULL)
+            return false;
+        list->lpVtbl->EndQuery(list, object, command->Query.Type, command->Query.Index);
+        break;
+    case COMMAND_RESOLVE_QUERY:
+        if (!Find(command->ResolveQuery.Heap, &object) || object == NULL ||
+            !Find(command->ResolveQuery.Destination, &other) || other == NULL)
+            return false;
+        list->lpVtbl->ResolveQueryData(list, object, command->ResolveQuery.Type, command->ResolveQuery.Start,
+                                       command->ResolveQuery.Count, other, command->ResolveQuery.DestinationOffset);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+static void ReplaySink(void* context, const Command* command)
+{
+    CommandReplay* replay = context;
+    replay->Started = replay->Started || command->Opcode == COMMAND_FRAME;
+    if (!replay->Started)
+        return;
+    replay->Stats->Commands++;
+    if (!ReplayCommand(replay, command))
+        replay->Stats->Skipped++;
+}
+
+bool CommandCapture_Replay(const char* path, const CommandReplayTarget* target, CommandReplayStats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    CommandReader reader;
+    if (!CommandReader_Open(&reader, path))
+        return false;
+
+    CommandReplay replay = { .Target = target, .Stats = stats };
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    bool replayed = CommandReader_Replay(&reader, ReplaySink, &replay);
+    QueryPerformanceCounter(&end);
+    stats->CpuMilliseconds = (end.QuadPart - start.QuadPart - replay.WaitTicks.QuadPart) * 1000.0 / frequency.QuadPart;
+    CommandReader_Close(&reader);
+
+    // The resources the replay created are released once the GPU is done with them
+    uint64_t fenceValue = ++*target->FenceValue;
+    target->CommandQueue->lpVtbl->Signal(target->CommandQueue, target->Fence, fenceValue);
+    WaitForFence(&replay, fenceValue);
+    for (uint32_t i = 0; i < replay.ResourceCount; ++i)
+    {
+        replay.Resources[i]->lpVtbl->Release(replay.Resources[i]);
+    }
+    free(replay.Resources);
+    return replayed;
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+// Include after d3d12.h and dxgi1_6.h were included with COBJMACROS, the macros of the wrapped
+// methods are redirected to the wrappers below
+#include <d3d12.h>
+#include <dxgi1_6.h>
+
+#include "command_stream.h"
+
+// Objects of the capture, numbered in the order they're created also while not capturing, so a
+// process going through the same startup gives its objects the ids of the capture
+extern CommandStream g_CommandCapture;
+
+// What a replay submits to, the fence is signaled after every ExecuteCommandLists
+typedef struct CommandReplayTarget
+{
+    ID3D12Device2* Device;
+    ID3D12CommandQueue* CommandQueue;
+    IDXGISwapChain4* SwapChain;
+    ID3D12Fence* Fence;
+    uint64_t* FenceValue;
+    HANDLE FenceEvent;
+} CommandReplayTarget;
+
+typedef struct CommandReplayStats
+{
+    uint64_t Frames;
+    uint64_t Commands;
+    // On objects the replay doesn't have, like views created while capturing
+    uint64_t Skipped;
+    // Submitting the commands, without the waits on the fence
+    double CpuMilliseconds;
+} CommandReplayStats;
+
+bool CommandCapture_Initialise(void);
+void CommandCapture_Shutdown(void);
+bool CommandCapture_Open(const char* path);
+// False when the capture couldn't be written completely
+bool CommandCapture_Close(void);
+
+void CommandCapture_MarkFrame(uint64_t frame);
+// Data the CPU wrote into an upload buffer the commands copy from
+void CommandCapture_WriteBuffer(ID3D12Resource* resource, uint64_t offset, const void* data, size_t size);
+
+// Replays the frames of the capture on the objects the startup of this process created. The
+// loading the capture recorded before its first frame is skipped.
+bool CommandCapture_Replay(const char* path, const CommandReplayTarget* target, CommandReplayStats* stats);
+
+// Call the method and record it while capturing
+HRESULT CommandCapture_ResetList(ID3D12GraphicsCommandList* list, ID3D12CommandAllocator* allocator,
+                                 ID3D12PipelineState* pipelineState);
+HRESULT CommandCapture_CloseList(ID3D12GraphicsCommandList* list);
+void CommandCapture_ResourceBarrier(ID3D12GraphicsCommandList* list, UINT count, const D3D12_RESOURCE_BARRIER* barriers);
+void CommandCapture_SetPipelineState(ID3D12GraphicsCommandList* list, ID3D12PipelineState* pipelineState);
+void CommandCapture_SetGraphicsRootSignature(ID3D12GraphicsCommandList* list, ID3D12RootSignature* rootSignature);
+void CommandCapture_SetComputeRootSignature(ID3D12GraphicsCommandList* list, ID3D12RootSignature* rootSignature);
+void CommandCapture_SetDescriptorHeaps(ID3D12GraphicsCommandList* list, UINT count, ID3D12DescriptorHeap* const* heaps);
+void CommandCapture_IASetPrimitiveTopology(ID3D12GraphicsCommandList* list, D3D12_PRIMITIVE_TOPOLOGY topology);
+void CommandCapture_SetGraphicsRoot32BitConstants(ID3D12GraphicsCommandList* list, UINT parameter, UINT count,
+                                                  const void* values, UINT offset);
+void CommandCapture_SetComputeRoot32BitConstants(ID3D12GraphicsCommandList* list, UINT parameter, UINT count,
+                                                 const void* values, UINT offset);
+void CommandCapture_SetGraphicsRootDescriptorTable(ID3D12GraphicsCommandList* list, UINT parameter,
+                                                   D3D12_GPU_DESCRIPTOR_HANDLE table);
+void CommandCapture_SetComputeRootDescriptorTable(ID3D12GraphicsCommandList* list, UINT parameter,
+                                                  D3D12_GPU_DESCRIPTOR_HANDLE table);
+void CommandCapture_SetComputeRootConstantBufferView(ID3D12GraphicsCommandList* list, UINT parameter,
+                                                     D3D12_GPU_VIRTUAL_ADDRESS address);
+void CommandCapture_SetComputeRootShaderResourceView(ID3D12GraphicsCommandList* list, UINT parameter,
+                                                     D3D12_GPU_VIRTUAL_ADDRESS address);
+void CommandCapture_SetComputeRootUnorderedAccessView(ID3D12GraphicsCommandList* list, UINT parameter,
+                                                      D3D12_GPU_VIRTUAL_ADDRESS address);
+void CommandCapture_IASetVertexBuffers(ID3D12GraphicsCommandList* list, UINT startSlot, UINT count,
+                                       const D3D12_VERTEX_BUFFER_VIEW* views);
+void CommandCapture_IASetIndexBuffer(ID3D12GraphicsCommandList* list, const D3D12_INDEX_BUFFER_VIEW* view);
+void CommandCapture_RSSetViewports(ID3D12GraphicsCommandList* list, UINT count, const D3D12_VIEWPORT* viewports);
+void CommandCapture_RSSetScissorRects(ID3D12GraphicsCommandList* list, UINT count, const D3D12_RECT* rects);
+void CommandCapture_OMSetRenderTargets(ID3D12GraphicsCommandList* list, UINT count,
+                                       const D3D12_CPU_DESCRIPTOR_HANDLE* views, BOOL singleHandle,
+                                       const D3D12_CPU_DESCRIPTOR_HANDLE* depthStencil);
+void CommandCapture_ClearRenderTargetView(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE view,
+                                          const FLOAT color[4], UINT rectCount, const D3D12_RECT* rects);
+void CommandCapture_ClearDepthStencilView(ID3D12GraphicsCommandList* list, D3D12_CPU_DESCRIPTOR_HANDLE view,
+                                          D3D12_CLEAR_FLAGS flags, FLOAT depth, UINT8 stencil, UINT rectCount,
+                                          const D3D12_RECT* rects);
+void CommandCapture_DrawInstanced(ID3D12GraphicsCommandList* list, UINT vertexCount, UINT instanceCount,
+                                  UINT startVertex, UINT startInstance);
+void CommandCapture_DrawIndexedInstanced(ID3D12GraphicsCommandList* list, UINT indexCount, UINT instanceCount,
+                                         UINT startIndex, INT baseVertex, UINT startInstance);
+void CommandCapture_Dispatch(ID3D12GraphicsCommandList* list, UINT x, UINT y, UINT z);
+void CommandCapture_ExecuteBundle(ID3D12GraphicsCommandList* list, ID3D12GraphicsCommandList* bundle);
+void CommandCapture_ExecuteIndirect(ID3D12GraphicsCommandList* list, ID3D12CommandSignature* signature,
+                                    UINT maxCount, ID3D12Resource* arguments, UINT64 argumentOffset,
+                                    ID3D12Resource* countBuffer, UINT64 countOffset);
+void CommandCapture_CopyBufferRegion(ID3D12GraphicsCommandList* list, ID3D12Resource* destination,
+                                     UINT64 destinationOffset, ID3D12Resource* source, UINT64 sourceOffset,
+                                     UINT64 size);
+void CommandCapture_CopyTextureRegion(ID3D12GraphicsCommandList* list, const D3D12_TEXTURE_COPY_LOCATION* destination,
+                                      UINT x, UINT y, UINT z, const D3D12_TEXTURE_COPY_LOCATION* source,
+                                      const D3D12_BOX* box);
+void CommandCapture_EndQuery(ID3D12GraphicsCommandList* list, ID3D12QueryHeap* heap, D3D12_QUERY_TYPE type, UINT index);
+void CommandCapture_ResolveQueryData(ID3D12GraphicsCommandList* list, ID3D12QueryHeap* heap, D3D12_QUERY_TYPE type,
+                                     UINT start, UINT count, ID3D12Resource* destination, UINT64 destinationOffset);
+
+HRESULT CommandCapture_ResetAllocator(ID3D12CommandAllocator* allocator);
+void CommandCapture_ExecuteCommandLists(ID3D12CommandQueue* queue, UINT count, ID3D12CommandList* const* lists);
+HRESULT CommandCapture_GetBuffer(IDXGISwapChain4* swapChain, UINT index, REFIID riid, void** surface);
+HRESULT CommandCapture_Present(IDXGISwapChain4* swapChain, UINT syncInterval, UINT flags);
+
+// Number the objects they create
+HRESULT CommandCapture_CreateCommittedResource(ID3D12Device2* device, const D3D12_HEAP_PROPERTIES* heapProperties,
+                                               D3D12_HEAP_FLAGS heapFlags, const D3D12_RESOURCE_DESC* desc,
+                                               D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue,
+                                               REFIID riid, void** resource);
+HRESULT CommandCapture_CreateDescriptorHeap(ID3D12Device2* device, const D3D12_DESCRIPTOR_HEAP_DESC* desc, REFIID riid,
+                                            void** heap);
+void CommandCapture_CreateDepthStencilView(ID3D12Device2* device, ID3D12Resource* resource,
+                                           const D3D12_DEPTH_STENCIL_VIEW_DESC* desc, D3D12_CPU_DESCRIPTOR_HANDLE view);
+HRESULT CommandCapture_CreateCommandQueue(ID3D12Device2* device, const D3D12_COMMAND_QUEUE_DESC* desc, REFIID riid,
+                                          void** queue);
+HRESULT CommandCapture_CreateCommandAllocator(ID3D12Device2* device, D3D12_COMMAND_LIST_TYPE type, REFIID riid,
+                                              void** allocator);
+HRESULT CommandCapture_CreateCommandList(ID3D12Device2* device, UINT nodeMask, D3D12_COMMAND_LIST_TYPE type,
+                                         ID3D12CommandAllocator* allocator, ID3D12PipelineState* pipelineState,
+                                         REFIID riid, void** list);
+HRESULT CommandCapture_CreateRootSignature(ID3D12Device2* device, UINT nodeMask, const void* blob, SIZE_T size,
+                                           REFIID riid, void** rootSignature);
+HRESULT CommandCapture_CreateGraphicsPipelineState(ID3D12Device2* device, const D3D12_GRAPHICS_PIPELINE_STATE_DESC* desc,
+                                                   REFIID riid, void** pipelineState);
+HRESULT CommandCapture_CreateComputePipelineState(ID3D12Device2* device, const D3D12_COMPUTE_PIPELINE_STATE_DESC* desc,
+                                                  REFIID riid, void** pipelineState);
+HRESULT CommandCapture_CreateCommandSignature(ID3D12Device2* device, const D3D12_COMMAND_SIGNATURE_DESC* desc,
+                                              ID3D12RootSignature* rootSignature, REFIID riid, void** signature);
+HRESULT CommandCapture_CreateQueryHeap(ID3D12Device2* device, const D3D12_QUERY_HEAP_DESC* desc, REFIID riid,
+                                       void** heap);
+
+#undef ID3D12GraphicsCommandList_Reset
+#undef ID3D12GraphicsCommandList_Close
+#undef ID3D12GraphicsCommandList_ResourceBarrier
+#undef ID3D12GraphicsCommandList_SetPipelineState
+#undef ID3D12GraphicsCommandList_SetGraphicsRootSignature
+#undef ID3D12GraphicsCommandList_SetComputeRootSignature
+#undef ID3D12GraphicsCommandList_SetDescriptorHeaps
+#undef ID3D12GraphicsCommandList_IASetPrimitiveTopology
+#undef ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstants
+#undef ID3D12GraphicsCommandList_SetComputeRoot32BitConstants
+#undef ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable
+#undef ID3D12GraphicsCommandList_SetComputeRootDescriptorTable
+#undef ID3D12GraphicsCommandList_SetComputeRootConstantBufferView
+#undef ID3D12GraphicsCommandList_SetComputeRootShaderResourceView
+#undef ID3D12GraphicsCommandList_SetComputeRootUnorderedAccessView
+#undef ID3D12GraphicsCommandList_IASetVertexBuffers
+#undef ID3D12GraphicsCommandList_IASetIndexBuffer
+#undef ID3D12GraphicsCommandList_RSSetViewports
+#undef ID3D12GraphicsCommandList_RSSetScissorRects
+#undef ID3D12GraphicsCommandList_OMSetRenderTargets
+#undef ID3D12GraphicsCommandList_ClearRenderTargetView
+#undef ID3D12GraphicsCommandList_ClearDepthStencilView
+#undef ID3D12GraphicsCommandList_DrawInstanced
+#undef ID3D12GraphicsCommandList_DrawIndexedInstanced
+#undef ID3D12GraphicsCommandList_Dispatch
+#undef ID3D12GraphicsCommandList_ExecuteBundle
+#undef ID3D12GraphicsCommandList_ExecuteIndirect
+#undef ID3D12GraphicsCommandList_CopyBufferRegion
+#undef ID3D12GraphicsCommandList_CopyTextureRegion
+#undef ID3D12GraphicsCommandList_EndQuery
+#undef ID3D12GraphicsCommandList_ResolveQueryData
+#undef ID3D12CommandAllocator_Reset
+#undef ID3D12CommandQueue_ExecuteCommandLists
+#undef IDXGISwapChain4_GetBuffer
+#undef IDXGISwapChain4_Present
+#undef ID3D12Device2_CreateCommittedResource
+#undef ID3D12Device2_CreateDescriptorHeap
+#undef ID3D12Device2_CreateDepthStencilView
+#undef ID3D12Device2_CreateCommandQueue
+#undef ID3D12Device2_CreateCommandAllocator
+#undef ID3D12Device2_CreateCommandList
+#undef ID3D12Device2_CreateRootSignature
+#undef ID3D12Device2_CreateGraphicsPipelineState
+#undef ID3D12Device2_CreateComputePipelineState
+#undef ID3D12Device2_CreateCommandSignature
+#undef ID3D12Device2_CreateQueryHeap
+
+#define ID3D12GraphicsCommandList_Reset CommandCapture_ResetList
+#define ID3D12GraphicsCommandList_Close CommandCapture_CloseList
+#define ID3D12GraphicsCommandList_ResourceBarrier CommandCapture_ResourceBarrier
+#define ID3D12GraphicsCommandList_SetPipelineState CommandCapture_SetPipelineState
+#define ID3D12GraphicsCommandList_SetGraphicsRootSignature CommandCapture_SetGraphicsRootSignature
+#define ID3D12GraphicsCommandList_SetComputeRootSignature CommandCapture_SetComputeRootSignature
+#define ID3D12GraphicsCommandList_SetDescriptorHeaps CommandCapture_SetDescriptorHeaps
+#define ID3D12GraphicsCommandList_IASetPrimitiveTopology CommandCapture_IASetPrimitiveTopology
+#define ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstants CommandCapture_SetGraphicsRoot32BitConstants
+#define ID3D12GraphicsCommandList_SetComputeRoot32BitConstants CommandCapture_SetComputeRoot32BitConstants
+#define ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable CommandCapture_SetGraphicsRootDescriptorTable
+#define ID3D12GraphicsCommandList_SetComputeRootDescriptorTable CommandCapture_SetComputeRootDescriptorTable
+#define ID3D12GraphicsCommandList_SetComputeRootConstantBufferView CommandCapture_SetComputeRootConstantBufferView
+#define ID3D12GraphicsCommandList_SetComputeRootShaderResourceView CommandCapture_SetComputeRootShaderResourceView
+#define ID3D12GraphicsCommandList_SetComputeRootUnorderedAccessView CommandCapture_SetComputeRootUnorderedAccessView
+#define ID3D12GraphicsCommandList_IASetVertexBuffers CommandCapture_IASetVertexBuffers
+#define ID3D12GraphicsCommandList_IASetIndexBuffer CommandCapture_IASetIndexBuffer
+#define ID3D12GraphicsCommandList_RSSetViewports CommandCapture_RSSetViewports
+#define ID3D12GraphicsCommandList_RSSetScissorRects CommandCapture_RSSetScissorRects
+#define ID3D12GraphicsCommandList_OMSetRenderTargets CommandCapture_OMSetRenderTargets
+#define ID3D12GraphicsCommandList_ClearRenderTargetView CommandCapture_ClearRenderTargetView
+#define ID3D12GraphicsCommandList_ClearDepthStencilView CommandCapture_ClearDepthStencilView
+#define ID3D12GraphicsCommandList_DrawInstanced CommandCapture_DrawInstanced
+#define ID3D12GraphicsCommandList_DrawIndexedInstanced CommandCapture_DrawIndexedInstanced
+#define ID3D12GraphicsCommandList_Dispatch CommandCapture_Dispatch
+#define ID3D12GraphicsCommandList_ExecuteBundle CommandCapture_ExecuteBundle
+#define ID3D12GraphicsCommandList_ExecuteIndirect CommandCapture_ExecuteIndirect
+#define ID3D12GraphicsCommandList_CopyBufferRegion CommandCapture_CopyBufferRegion
+#define ID3D12GraphicsCommandList_CopyTextureRegion CommandCapture_CopyTextureRegion
+#define ID3D12GraphicsCommandList_EndQuery CommandCapture_EndQuery
+#define ID3D12GraphicsCommandList_ResolveQueryData CommandCapture_ResolveQueryData
+#define ID3D12CommandAllocator_Reset CommandCapture_ResetAllocator
+#define ID3D12CommandQueue_ExecuteCommandLists CommandCapture_ExecuteCommandLists
+#define IDXGISwapChain4_GetBuffer CommandCapture_GetBuffer
+#define IDXGISwapChain4_Present CommandCapture_Present
+#define ID3D12Device2_CreateCommittedResource CommandCapture_CreateCommittedResource
+#define ID3D12Device2_CreateDescriptorHeap CommandCapture_CreateDescriptorHeap
+#define ID3D12Device2_CreateDepthStencilView CommandCapture_CreateDepthStencilView
+#define ID3D12Device2_CreateCommandQueue CommandCapture_CreateCommandQueue
+#define ID3D12Device2_CreateCommandAllocator CommandCapture_CreateCommandAllocator
+#define ID3D12Device2_CreateCommandList CommandCapture_CreateCommandList
+#define ID3D12Device2_CreateRootSignature CommandCapture_CreateRootSignature
+#define ID3D12Device2_CreateGraphicsPipelineState CommandCapture_CreateGraphicsPipelineState
+#define ID3D12Device2_CreateComputePipelineState CommandCapture_CreateComputePipelineState
+#define ID3D12Device2_CreateCommandSignature CommandCapture_CreateCommandSignature
+#define ID3D12Device2_CreateQueryHeap CommandCapture_CreateQueryHeap
@@ -0,0 +1,829 @@
+#include "command_stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define OPCODE_BITS 8
+#define MAX_PAYLOAD_WORDS ((1u << (32 - OPCODE_BITS)) - 1)
+#define READ_SIZE (1024 * 1024)
+
+static const char* g_CommandNames[COMMAND_OPCODE_COUNT] = {
+    [COMMAND_FRAME] = "Frame",
+    [COMMAND_SET_LIST] = "SetList",
+    [COMMAND_RESET_ALLOCATOR] = "ResetAllocator",
+    [COMMAND_RESET] = "Reset",
+    [COMMAND_CLOSE] = "Close",
+    [COMMAND_RESOURCE_BARRIER] = "ResourceBarrier",
+    [COMMAND_SET_PIPELINE_STATE] = "SetPipelineState",
+    [COMMAND_SET_GRAPHICS_ROOT_SIGNATURE] = "SetGraphicsRootSignature",
+    [COMMAND_SET_COMPUTE_ROOT_SIGNATURE] = "SetComputeRootSignature",
+    [COMMAND_SET_DESCRIPTOR_HEAPS] = "SetDescriptorHeaps",
+    [COMMAND_SET_PRIMITIVE_TOPOLOGY] = "IASetPrimitiveTopology",
+    [COMMAND_SET_GRAPHICS_ROOT_CONSTANTS] = "SetGraphicsRoot32BitConstants",
+    [COMMAND_SET_COMPUTE_ROOT_CONSTANTS] = "SetComputeRoot32BitConstants",
+    [COMMAND_SET_GRAPHICS_ROOT_TABLE] = "SetGraphicsRootDescriptorTable",
+    [COMMAND_SET_COMPUTE_ROOT_TABLE] = "SetComputeRootDescriptorTable",
+    [COMMAND_SET_COMPUTE_ROOT_CBV] = "SetComputeRootConstantBufferView",
+    [COMMAND_SET_COMPUTE_ROOT_SRV] = "SetComputeRootShaderResourceView",
+    [COMMAND_SET_COMPUTE_ROOT_UAV] = "SetComputeRootUnorderedAccessView",
+    [COMMAND_SET_VERTEX_BUFFERS] = "IASetVertexBuffers",
+    [COMMAND_SET_INDEX_BUFFER] = "IASetIndexBuffer",
+    [COMMAND_SET_VIEWPORTS] = "RSSetViewports",
+    [COMMAND_SET_SCISSOR_RECTS] = "RSSetScissorRects",
+    [COMMAND_SET_RENDER_TARGETS] = "OMSetRenderTargets",
+    [COMMAND_CLEAR_RENDER_TARGET] = "ClearRenderTargetView",
+    [COMMAND_CLEAR_DEPTH_STENCIL] = "ClearDepthStencilView",
+    [COMMAND_DRAW] = "DrawInstanced",
+    [COMMAND_DRAW_INDEXED] = "DrawIndexedInstanced",
+    [COMMAND_DISPATCH] = "Dispatch",
+    [COMMAND_EXECUTE_BUNDLE] = "ExecuteBundle",
+    [COMMAND_EXECUTE_INDIRECT] = "ExecuteIndirect",
+    [COMMAND_COPY_BUFFER] = "CopyBufferRegion",
+    [COMMAND_COPY_TEXTURE] = "CopyTextureRegion",
+    [COMMAND_END_QUERY] = "EndQuery",
+    [COMMAND_RESOLVE_QUERY] = "ResolveQueryData",
+    [COMMAND_CREATE_RESOURCE] = "CreateCommittedResource",
+    [COMMAND_CREATE_DEPTH_STENCIL_VIEW] = "CreateDepthStencilView",
+    [COMMAND_WRITE_BUFFER] = "WriteBuffer",
+    [COMMAND_EXECUTE_LISTS] = "ExecuteCommandLists",
+    [COMMAND_PRESENT] = "Present"
+};
+
+// Encodes a command into the stream, or decodes one from a payload, with the same code so the
+// two can't disagree about the layout
+typedef struct CommandCursor
+{
+    // Set when encoding
+    CommandStream* Stream;
+    const uint32_t* Words;
+    uint32_t WordCount;
+    uint32_t Position;
+    bool Failed;
+} CommandCursor;
+
+static bool Reserve(CommandStream* stream, size_t size)
+{
+    if (stream->Size + size <= stream->Capacity)
+        return true;
+    size_t capacity = stream->Capacity ? stream->Capacity : COMMAND_STREAM_FLUSH_SIZE;
+    while (capacity < stream->Size + size)
+        capacity *= 2;
+    uint8_t* buffer = realloc(stream->Buffer, capacity);
+    if (buffer == NULL)
+        return false;
+    stream->Buffer = buffer;
+    stream->Capacity = capacity;
+    return true;
+}
+
+static void TransferU32(CommandCursor* cursor, uint32_t* value)
+{
+    if (cursor->Stream != NULL)
+    {
+        if (!Reserve(cursor->Stream, sizeof(uint32_t)))
+        {
+            cursor->Failed = true;
+            return;
+        }
+        memcpy(cursor->Stream->Buffer + cursor->Stream->Size, value, sizeof(uint32_t));
+        cursor->Stream->Size += sizeof(uint32_t);
+        return;
+    }
+    if (cursor->Position == cursor->WordCount)
+    {
+        cursor->Failed = true;
+        *value = 0;
+        return;
+    }
+    *value = cursor->Words[cursor->Position++];
+}
+
+static void TransferU64(CommandCursor* cursor, uint64_t* value)
+{
+    uint32_t low = (uint32_t)*value;
+    uint32_t high = (uint32_t)(*value >> 32);
+    TransferU32(cursor, &low);
+    TransferU32(cursor, &high);
+    *value = (uint64_t)high << 32 | low;
+}
+
+static void TransferI32(CommandCursor* cursor, int32_t* value)
+{
+    uint32_t word;
+    memcpy(&word, value, sizeof(word));
+    TransferU32(cursor, &word);
+    memcpy(value, &word, sizeof(word));
+}
+
+static void TransferFloat(CommandCursor* cursor, float* value)
+{
+    uint32_t word;
+    memcpy(&word, value, sizeof(word));
+    TransferU32(cursor, &word);
+    memcpy(value, &word, sizeof(word));
+}
+
+static void TransferBool(CommandCursor* cursor, bool* value)
+{
+    uint32_t word = *value;
+    TransferU32(cursor, &word);
+    *value = word != 0;
+}
+
+// Number of elements to transfer, none when there are more than the array holds
+static uint32_t TransferCount(CommandCursor* cursor, uint32_t* count, uint32_t max)
+{
+    TransferU32(cursor, count);
+    if (*count <= max)
+        return *count;
+    cursor->Failed = true;
+    return 0;
+}
+
+static void TransferAddress(CommandCursor* cursor, CommandAddress* address)
+{
+    TransferU32(cursor, &address->Object);
+    TransferU64(cursor, &address->Offset);
+}
+
+// Padded to whole words, decoding points the data into the payload
+static void TransferBytes(CommandCursor* cursor, const void** data, uint32_t size)
+{
+    uint32_t words = (size + 3) / 4;
+    if (cursor->Stream != NULL)
+    {
+        if (!Reserve(cursor->Stream, words * sizeof(uint32_t)))
+        {
+            cursor->Failed = true;
+            return;
+        }
+        uint8_t* destination = cursor->Stream->Buffer + cursor->Stream->Size;
+        memcpy(destination, *data, size);
+        memset(destination + size, 0, words * sizeof(uint32_t) - size);
+        cursor->Stream->Size += words * sizeof(uint32_t);
+        return;
+    }
+    if (cursor->WordCount - cursor->Position < words)
+    {
+        cursor->Failed = true;
+        *data = NULL;
+        return;
+    }
+    *data = cursor->Words + cursor->Position;
+    cursor->Position += words;
+}
+
+static void TransferCopyLocation(CommandCursor* cursor, CommandCopyLocation* location)
+{
+    TransferU32(cursor, &location->Resource);
+    TransferU32(cursor, &location->Type);
+    TransferU32(cursor, &location->Subresource);
+    TransferU64(cursor, &location->Offset);
+    TransferU32(cursor, &location->Format);
+    TransferU32(cursor, &location->Width);
+    TransferU32(cursor, &location->Height);
+    TransferU32(cursor, &location->Depth);
+    TransferU32(cursor, &location->RowPitch);
+}
+
+static void TransferResourceDesc(CommandCursor* cursor, CommandResourceDesc* desc)
+{
+    TransferU32(cursor, &desc->Dimension);
+    TransferU64(cursor, &desc->Alignment);
+    TransferU64(cursor, &desc->Width);
+    TransferU32(cursor, &desc->Height);
+    TransferU32(cursor, &desc->DepthOrArraySize);
+    TransferU32(cursor, &desc->MipLevels);
+    TransferU32(cursor, &desc->Format);
+    TransferU32(cursor, &desc->SampleCount);
+    TransferU32(cursor, &desc->SampleQuality);
+    TransferU32(cursor, &desc->Layout);
+    TransferU32(cursor, &desc->Flags);
+}
+
+// The payload of every opcode. Encoding stores back the values it reads, so it leaves the
+// command as it was.
+static void Transfer(CommandCursor* cursor, Command* command)
+{
+    uint32_t count;
+    switch (command->Opcode)
+    {
+    case COMMAND_FRAME:
+        TransferU64(cursor, &command->Frame);
+        break;
+    case COMMAND_SET_LIST:
+    case COMMAND_RESET_ALLOCATOR:
+    case COMMAND_SET_PIPELINE_STATE:
+    case COMMAND_SET_GRAPHICS_ROOT_SIGNATURE:
+    case COMMAND_SET_COMPUTE_ROOT_SIGNATURE:
+    case COMMAND_EXECUTE_BUNDLE:
+        TransferU32(cursor, &command->Object);
+        break;
+    case COMMAND_RESET:
+        TransferU32(cursor, &command->Reset.Allocator);
+        TransferU32(cursor, &command->Reset.PipelineState);
+        break;
+    case COMMAND_CLOSE:
+        break;
+    case COMMAND_RESOURCE_BARRIER:
+        count = TransferCount(cursor, &command->Barriers.Count, COMMAND_STREAM_MAX_ELEMENTS);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            CommandBarrier* barrier = &command->Barriers.Barriers[i];
+            TransferU32(cursor, &barrier->Type);
+            TransferU32(cursor, &barrier->Flags);
+            TransferU32(cursor, &barrier->Resources[0]);
+            TransferU32(cursor, &barrier->Resources[1]);
+            TransferU32(cursor, &barrier->Subresource);
+            TransferU32(cursor, &barrier->States[0]);
+            TransferU32(cursor, &barrier->States[1]);
+        }
+        break;
+    case COMMAND_SET_DESCRIPTOR_HEAPS:
+        count = TransferCount(cursor, &command->DescriptorHeaps.Count, COMMAND_STREAM_MAX_ELEMENTS);
+        for (uint32_t i = 0; i < count; ++i)
+            TransferU32(cursor, &command->DescriptorHeaps.Heaps[i]);
+        break;
+    case COMMAND_SET_PRIMITIVE_TOPOLOGY:
+        TransferU32(cursor, &command->PrimitiveTopology);
+        break;
+    case COMMAND_SET_GRAPHICS_ROOT_CONSTANTS:
+    case COMMAND_SET_COMPUTE_ROOT_CONSTANTS:
+        TransferU32(cursor, &command->RootConstants.Parameter);
+        TransferU32(cursor, &command->RootConstants.Offset);
+        count = TransferCount(cursor, &command->RootConstants.Count, COMMAND_STREAM_MAX_CONSTANTS);
+        for (uint32_t i = 0; i < count; ++i)
+            TransferU32(cursor, &command->RootConstants.Values[i]);
+        break;
+    case COMMAND_SET_GRAPHICS_ROOT_TABLE:
+    case COMMAND_SET_COMPUTE_ROOT_TABLE:
+    case COMMAND_SET_COMPUTE_ROOT_CBV:
+    case COMMAND_SET_COMPUTE_ROOT_SRV:
+    case COMMAND_SET_COMPUTE_ROOT_UAV:
+        TransferU32(cursor, &command->RootArgument.Parameter);
+        TransferAddress(cursor, &command->RootArgument.Address);
+        break;
+    case COMMAND_SET_VERTEX_BUFFERS:
+        TransferU32(cursor, &command->VertexBuffers.StartSlot);
+        count = TransferCount(cursor, &command->VertexBuffers.Count, COMMAND_STREAM_MAX_ELEMENTS);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            TransferAddress(cursor, &command->VertexBuffers.Views[i].Location);
+            TransferU32(cursor, &command->VertexBuffers.Views[i].Size);
+            TransferU32(cursor, &command->VertexBuffers.Views[i].Stride);
+        }
+        break;
+    case COMMAND_SET_INDEX_BUFFER:
+        TransferBool(cursor, &command->IndexBuffer.Bound);
+        TransferAddress(cursor, &command->IndexBuffer.Location);
+        TransferU32(cursor, &command->IndexBuffer.Size);
+        TransferU32(cursor, &command->IndexBuffer.Format);
+        break;
+    case COMMAND_SET_VIEWPORTS:
+        count = TransferCount(cursor, &command->Viewports.Count, COMMAND_STREAM_MAX_ELEMENTS);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            CommandViewport* viewport = &command->Viewports.Viewports[i];
+            TransferFloat(cursor, &viewport->X);
+            TransferFloat(cursor, &viewport->Y);
+            TransferFloat(cursor, &viewport->Width);
+            TransferFloat(cursor, &viewport->Height);
+            TransferFloat(cursor, &viewport->MinDepth);
+            TransferFloat(cursor, &viewport->MaxDepth);
+        }
+        break;
+    case COMMAND_SET_SCISSOR_RECTS:
+        count = TransferCount(cursor, &command->ScissorRects.Count, COMMAND_STREAM_MAX_ELEMENTS);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            CommandRect* rect = &command->ScissorRects.Rects[i];
+            TransferI32(cursor, &rect->Left);
+            TransferI32(cursor, &rect->Top);
+            TransferI32(cursor, &rect->Right);
+            TransferI32(cursor, &rect->Bottom);
+        }
+        break;
+    case COMMAND_SET_RENDER_TARGETS:
+        count = TransferCount(cursor, &command->RenderTargets.Count, COMMAND_STREAM_MAX_ELEMENTS);
+        TransferBool(cursor, &command->RenderTargets.SingleHandle);
+        for (uint32_t i = 0; i < count; ++i)
+            TransferAddress(cursor, &command->RenderTargets.Views[i]);
+        TransferBool(cursor, &command->RenderTargets.HasDepthStencil);
+        TransferAddress(cursor, &command->RenderTargets.DepthStencil);
+        break;
+    case COMMAND_CLEAR_RENDER_TARGET:
+        TransferAddress(cursor, &command->ClearRenderTarget.View);
+        for (int i = 0; i < 4; ++i)
+            TransferFloat(cursor, &command->ClearRenderTarget.Color[i]);
+        break;
+    case COMMAND_CLEAR_DEPTH_STENCIL:
+        TransferAddress(cursor, &command->ClearDepthStencil.View);
+        TransferU32(cursor, &command->ClearDepthStencil.Flags);
+        TransferFloat(cursor, &command->ClearDepthStencil.Depth);
+        TransferU32(cursor, &command->ClearDepthStencil.Stencil);
+        break;
+    case COMMAND_DRAW:
+        TransferU32(cursor, &command->Draw.VertexCount);
+        TransferU32(cursor, &command->Draw.InstanceCount);
+        TransferU32(cursor, &command->Draw.StartVertex);
+        TransferU32(cursor, &command->Draw.StartInstance);
+        break;
+    case COMMAND_DRAW_INDEXED:
+        TransferU32(cursor, &command->DrawIndexed.IndexCount);
+        TransferU32(cursor, &command->DrawIndexed.InstanceCount);
+        TransferU32(cursor, &command->DrawIndexed.StartIndex);
+        TransferI32(cursor, &command->DrawIndexed.BaseVertex);
+        TransferU32(cursor, &command->DrawIndexed.StartInstance);
+        break;
+    case COMMAND_DISPATCH:
+        TransferU32(cursor, &command->Dispatch.X);
+        TransferU32(cursor, &command->Dispatch.Y);
+        TransferU32(cursor, &command->Dispatch.Z);
+        break;
+    case COMMAND_EXECUTE_INDIRECT:
+        TransferU32(cursor, &command->ExecuteIndirect.Signature);
+        TransferU32(cursor, &command->ExecuteIndirect.MaxCount);
+        TransferU32(cursor, &command->ExecuteIndirect.Arguments);
+        TransferU64(cursor, &command->ExecuteIndirect.ArgumentOffset);
+        TransferU32(cursor, &command->ExecuteIndirect.CountBuffer);
+        TransferU64(cursor, &command->ExecuteIndirect.CountOffset);
+        break;
+    case COMMAND_COPY_BUFFER:
+        TransferU32(cursor, &command->CopyBuffer.Destination);
+        TransferU64(cursor, &command->CopyBuffer.DestinationOffset);
+        TransferU32(cursor, &command->CopyBuffer.Source);
+        TransferU64(cursor, &command->CopyBuffer.SourceOffset);
+        TransferU64(cursor, &command->CopyBuffer.Size);
+        break;
+    case COMMAND_COPY_TEXTURE:
+        TransferCopyLocation(cursor, &command->CopyTexture.Destination);
+        TransferU32(cursor, &command->CopyTexture.X);
+        TransferU32(cursor, &command->CopyTexture.Y);
+        TransferU32(cursor, &command->CopyTexture.Z);
+        TransferCopyLocation(cursor, &command->CopyTexture.Source);
+        TransferBool(cursor, &command->CopyTexture.HasBox);
+        for (int i = 0; i < 6 && command->CopyTexture.HasBox; ++i)
+            TransferU32(cursor, &command->CopyTexture.Box[i]);
+        break;
+    case COMMAND_END_QUERY:
+        TransferU32(cursor, &command->Query.Heap);
+        TransferU32(cursor, &command->Query.Type);
+        TransferU32(cursor, &command->Query.Index);
+        break;
+    case COMMAND_RESOLVE_QUERY:
+        TransferU32(cursor, &command->ResolveQuery.Heap);
+        TransferU32(cursor, &command->ResolveQuery.Type);
+        TransferU32(cursor, &command->ResolveQuery.Start);
+        TransferU32(cursor, &command->ResolveQuery.Count);
+        TransferU32(cursor, &command->ResolveQuery.Destination);
+        TransferU64(cursor, &command->ResolveQuery.DestinationOffset);
+        break;
+    case COMMAND_CREATE_RESOURCE:
+        TransferU32(cursor, &command->CreateResource.Resource);
+        TransferU32(cursor, &command->CreateResource.HeapType);
+        TransferU32(cursor, &command->CreateResource.HeapFlags);
+        TransferResourceDesc(cursor, &command->CreateResource.Desc);
+        TransferU32(cursor, &command->CreateResource.InitialState);
+        TransferBool(cursor, &command->CreateResource.HasClearValue);
+        TransferU32(cursor, &command->CreateResource.ClearFormat);
+        for (int i = 0; i < 4; ++i)
+            TransferFloat(cursor, &command->CreateResource.ClearValue[i]);
+        break;
+    case COMMAND_CREATE_DEPTH_STENCIL_VIEW:
+        TransferU32(cursor, &command->CreateDepthStencilView.Resource);
+        TransferBool(cursor, &command->CreateDepthStencilView.HasDesc);
+        TransferU32(cursor, &command->CreateDepthStencilView.Format);
+        TransferU32(cursor, &command->CreateDepthStencilView.Dimension);
+        TransferU32(cursor, &command->CreateDepthStencilView.MipSlice);
+        TransferU32(cursor, &command->CreateDepthStencilView.Flags);
+        TransferAddress(cursor, &command->CreateDepthStencilView.View);
+        break;
+    case COMMAND_WRITE_BUFFER:
+        TransferU32(cursor, &command->WriteBuffer.Resource);
+        TransferU64(cursor, &command->WriteBuffer.Offset);
+        TransferU32(cursor, &command->WriteBuffer.Size);
+        TransferBytes(cursor, &command->WriteBuffer.Data, command->WriteBuffer.Size);
+        break;
+    case COMMAND_EXECUTE_LISTS:
+        TransferU32(cursor, &command->ExecuteLists.Queue);
+        count = TransferCount(cursor, &command->ExecuteLists.Count, COMMAND_STREAM_MAX_ELEMENTS);
+        for (uint32_t i = 0; i < count; ++i)
+            TransferU32(cursor, &command->ExecuteLists.Lists[i]);
+        break;
+    case COMMAND_PRESENT:
+        TransferU32(cursor, &command->Present.SyncInterval);
+        TransferU32(cursor, &command->Present.Flags);
+        break;
+    default:
+        cursor->Failed = true;
+        break;
+    }
+}
+
+bool CommandStream_Create(CommandStream* stream)
+{
+    memset(stream, 0, sizeof(*stream));
+    // Id 0 is no object
+    stream->ObjectCount = 1;
+    return true;
+}
+
+void CommandStream_Destroy(CommandStream* stream)
+{
+    if (stream->File != NULL)
+        fclose(stream->File);
+    free(stream->Buffer);
+    free(stream->Objects);
+    free(stream->SlotObjects);
+    free(stream->SlotIds);
+    for (int space = 0; space < COMMAND_ADDRESS_SPACE_COUNT; ++space)
+        free(stream->Ranges[space]);
+    memset(stream, 0, sizeof(*stream));
+}
+
+static bool Flush(CommandStream* stream)
+{
+    if (stream->Size > 0 && fwrite(stream->Buffer, 1, stream->Size, stream->File) != stream->Size)
+        stream->Failed = true;
+    stream->WrittenBytes += stream->Size;
+    stream->Size = 0;
+    return !stream->Failed;
+}
+
+bool CommandStream_Open(CommandStream* stream, const char* path)
+{
+    if (stream->File != NULL)
+        return false;
+    stream->File = fopen(path, "wb");
+    if (stream->File == NULL)
+        return false;
+    uint32_t header[2] = { COMMAND_STREAM_MAGIC, COMMAND_STREAM_VERSION };
+    stream->Size = 0;
+    stream->WrittenBytes = 0;
+    stream->CommandCount = 0;
+    stream->CurrentList = COMMAND_STREAM_NO_OBJECT;
+    stream->Failed = !Reserve(stream, sizeof(header));
+    if (!stream->Failed)
+    {
+        memcpy(stream->Buffer, header, sizeof(header));
+        stream->Size = sizeof(header);
+    }
+    return !stream->Failed;
+}
+
+bool CommandStream_Close(CommandStream* stream)
+{
+    if (stream->File == NULL)
+        return false;
+    bool written = !stream->Failed && Flush(stream);
+    written = fclose(stream->File) == 0 && written;
+    stream->File = NULL;
+    return written;
+}
+
+bool CommandStream_IsCapturing(const CommandStream* stream)
+{
+    return stream->File != NULL && !stream->Failed;
+}
+
+static uint32_t HashObject(const void* object)
+{
+    uint64_t key = (uint64_t)(uintptr_t)object;
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+// Slot holding the object, or the empty one it would go to
+static uint32_t FindSlot(const CommandStream* stream, const void* object)
+{
+    uint32_t mask = stream->SlotCount - 1;
+    uint32_t slot = HashObject(object) & mask;
+    while (stream->SlotObjects[slot] != NULL && stream->SlotObjects[slot] != object)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static bool SetSlot(CommandStream* stream, const void* object, uint32_t id)
+{
+    // Kept at most half full
+    if (2 * (stream->UsedSlots + 1) > stream->SlotCount)
+    {
+        uint32_t slotCount = stream->SlotCount ? 2 * stream->SlotCount : 256;
+        const void** objects = calloc(slotCount, sizeof(void*));
+        uint32_t* ids = calloc(slotCount, sizeof(uint32_t));
+        if (objects == NULL || ids == NULL)
+        {
+            free(objects);
+            free(ids);
+            return false;
+        }
+        const void** oldObjects = stream->SlotObjects;
+        uint32_t* oldIds = stream->SlotIds;
+        uint32_t oldCount = stream->SlotCount;
+        stream->SlotObjects = objects;
+        stream->SlotIds = ids;
+        stream->SlotCount = slotCount;
+        for (uint32_t i = 0; i < oldCount; ++i)
+        {
+            if (oldObjects[i] == NULL)
+                continue;
+            uint32_t slot = FindSlot(stream, oldObjects[i]);
+            stream->SlotObjects[slot] = oldObjects[i];
+            stream->SlotIds[slot] = oldIds[i];
+        }
+        free(oldObjects);
+        free(oldIds);
+    }
+
+    uint32_t slot = FindSlot(stream, object);
+    if (stream->SlotObjects[slot] == NULL)
+        stream->UsedSlots++;
+    stream->SlotObjects[slot] = object;
+    stream->SlotIds[slot] = id;
+    return true;
+}
+
+void CommandStream_BindObject(CommandStream* stream, uint32_t id, const void* object)
+{
+    if (id == COMMAND_STREAM_NO_OBJECT || object == NULL)
+        return;
+    if (id >= stream->ObjectCapacity)
+    {
+        uint32_t capacity = stream->ObjectCapacity ? stream->ObjectCapacity : 256;
+        while (capacity <= id)
+            capacity *= 2;
+        const void** objects = realloc(stream->Objects, capacity * sizeof(void*));
+        if (objects == NULL)
+        {
+            stream->Failed = true;
+            return;
+        }
+        memset(objects + stream->ObjectCapacity, 0, (capacity - stream->ObjectCapacity) * sizeof(void*));
+        stream->Objects = objects;
+        stream->ObjectCapacity = capacity;
+    }
+    stream->Objects[id] = object;
+    if (id >= stream->ObjectCount)
+        stream->ObjectCount = id + 1;
+    if (!SetSlot(stream, object, id))
+        stream->Failed = true;
+}
+
+uint32_t CommandStream_AddObject(CommandStream* stream, const void* object)
+{
+    if (object == NULL)
+        return COMMAND_STREAM_NO_OBJECT;
+    uint32_t id = stream->ObjectCount;
+    CommandStream_BindObject(stream, id, object);
+    return id;
+}
+
+uint32_t CommandStream_GetObject(CommandStream* stream, const void* object)
+{
+    if (object == NULL)
+        return COMMAND_STREAM_NO_OBJECT;
+    if (stream->SlotCount > 0)
+    {
+        uint32_t slot = FindSlot(stream, object);
+        if (stream->SlotObjects[slot] != NULL)
+            return stream->SlotIds[slot];
+    }
+    return CommandStream_AddObject(stream, object);
+}
+
+const void* CommandStream_FindObject(const CommandStream* stream, uint32_t id)
+{
+    return id < stream->ObjectCapacity ? stream->Objects[id] : NULL;
+}
+
+// Index of the first range starting after the address
+static uint32_t UpperBound(const CommandRange* ranges, uint32_t count, uint64_t address)
+{
+    uint32_t first = 0;
+    while (count > 0)
+    {
+        uint32_t half = count / 2;
+        if (ranges[first + half].Start <= address)
+        {
+            first += half + 1;
+            count -= half + 1;
+        }
+        else
+            count = half;
+    }
+    return first;
+}
+
+void CommandStream_AddRange(CommandStream* stream, CommandAddressSpace space, uint32_t object, uint64_t start,
+                            uint64_t size)
+{
+    if (size == 0)
+        return;
+    CommandRange* ranges = stream->Ranges[space];
+    uint32_t count = stream->RangeCounts[space];
+
+    // Ranges overlapping the new one belonged to released objects
+    uint32_t first = UpperBound(ranges, count, start);
+    if (first > 0 && ranges[first - 1].Start + ranges[first - 1].Size > start)
+        first--;
+    uint32_t end = first;
+    while (end < count && ranges[end].Start < start + size)
+        end++;
+    if (end > first)
+    {
+        memmove(ranges + first, ranges + end, (count - end) * sizeof(CommandRange));
+        count -= end - first;
+    }
+
+    if (count == stream->RangeCapacities[space])
+    {
+        uint32_t capacity = count ? 2 * count : 64;
+        ranges = realloc(ranges, capacity * sizeof(CommandRange));
+        if (ranges == NULL)
+        {
+            stream->Failed = true;
+            return;
+        }
+        stream->Ranges[space] = ranges;
+        stream->RangeCapacities[space] = capacity;
+    }
+    memmove(ranges + first + 1, ranges + first, (count - first) * sizeof(CommandRange));
+    ranges[first] = (CommandRange){ start, size, object };
+    stream->RangeCounts[space] = count + 1;
+}
+
+CommandAddress CommandStream_Resolve(const CommandStream* stream, CommandAddressSpace space, uint64_t address)
+{
+    const CommandRange* ranges = stream->Ranges[space];
+    uint32_t index = UpperBound(ranges, stream->RangeCounts[space], address);
+    if (index > 0 && address - ranges[index - 1].Start < ranges[index - 1].Size)
+        return (CommandAddress){ ranges[index - 1].Object, address - ranges[index - 1].Start };
+    return (CommandAddress){ COMMAND_STREAM_NO_OBJECT, address };
+}
+
+uint64_t CommandStream_Unresolve(const CommandStream* stream, CommandAddressSpace space, CommandAddress address)
+{
+    if (address.Object == COMMAND_STREAM_NO_OBJECT)
+        return address.Offset;
+    const CommandRange* ranges = stream->Ranges[space];
+    for (uint32_t i = 0; i < stream->RangeCounts[space]; ++i)
+    {
+        if (ranges[i].Object == address.Object)
+            return ranges[i].Start + address.Offset;
+    }
+    return address.Offset;
+}
+
+void CommandStream_SelectList(CommandStream* stream, uint32_t list)
+{
+    if (list == stream->CurrentList || !CommandStream_IsCapturing(stream))
+        return;
+    stream->CurrentList = list;
+    Command command = { .Opcode = COMMAND_SET_LIST, .Object = list };
+    CommandStream_Write(stream, &command);
+}
+
+void CommandStream_Write(CommandStream* stream, const Command* command)
+{
+    if (!CommandStream_IsCapturing(stream))
+        return;
+
+    size_t start = stream->Size;
+    uint32_t header = 0;
+    CommandCursor cursor = { .Stream = stream };
+    TransferU32(&cursor, &header);
+    Transfer(&cursor, (Command*)command);
+    size_t words = (stream->Size - start) / sizeof(uint32_t) - 1;
+    if (cursor.Failed || words > MAX_PAYLOAD_WORDS)
+    {
+        stream->Failed = true;
+        return;
+    }
+    header = (uint32_t)command->Opcode | (uint32_t)words << OPCODE_BITS;
+    memcpy(stream->Buffer + start, &header, sizeof(header));
+    stream->CommandCount++;
+
+    if (stream->Size >= COMMAND_STREAM_FLUSH_SIZE)
+        Flush(stream);
+}
+
+// Makes at least the size available from Begin, false at the end of the file
+static bool Fill(CommandReader* reader, size_t size)
+{
+    if (reader->End - reader->Begin >= size)
+        return true;
+    memmove(reader->Buffer, reader->Buffer + reader->Begin, reader->End - reader->Begin);
+    reader->End -= reader->Begin;
+    reader->Begin = 0;
+    if (size > reader->Capacity)
+    {
+        size_t capacity = reader->Capacity;
+        while (capacity < size)
+            capacity *= 2;
+        uint8_t* buffer = realloc(reader->Buffer, capacity);
+        if (buffer == NULL)
+        {
+            reader->Failed = true;
+            return false;
+        }
+        reader->Buffer = buffer;
+        reader->Capacity = capacity;
+    }
+    reader->End += fread(reader->Buffer + reader->End, 1, reader->Capacity - reader->End, reader->File);
+    return reader->End >= size;
+}
+
+bool CommandReader_Open(CommandReader* reader, const char* path)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->File = fopen(path, "rb");
+    reader->Buffer = malloc(READ_SIZE);
+    reader->Capacity = READ_SIZE;
+    uint32_t header[2];
+    if (reader->File == NULL || reader->Buffer == NULL || !Fill(reader, sizeof(header)))
+    {
+        CommandReader_Close(reader);
+        return false;
+    }
+    memcpy(header, reader->Buffer, sizeof(header));
+    reader->Begin = sizeof(header);
+    if (header[0] != COMMAND_STREAM_MAGIC || header[1] != COMMAND_STREAM_VERSION)
+    {
+        CommandReader_Close(reader);
+        return false;
+    }
+    return true;
+}
+
+void CommandReader_Close(CommandReader* reader)
+{
+    if (reader->File != NULL)
+        fclose(reader->File);
+    free(reader->Buffer);
+    memset(reader, 0, sizeof(*reader));
+}
+
+bool CommandReader_Next(CommandReader* reader, Command* command)
+{
+    if (reader->Failed || !Fill(reader, sizeof(uint32_t)))
+    {
+        // A partial header is a truncated capture
+        reader->Failed = reader->Failed || reader->End != reader->Begin;
+        return false;
+    }
+    uint32_t header;
+    memcpy(&header, reader->Buffer + reader->Begin, sizeof(header));
+    uint32_t words = header >> OPCODE_BITS;
+    size_t size = sizeof(uint32_t) * ((size_t)words + 1);
+    if (!Fill(reader, size))
+    {
+        reader->Failed = true;
+        return false;
+    }
+
+    // Begin stays a multiple of the word size, so the payload is aligned
+    reader->Payload = (const uint32_t*)(reader->Buffer + reader->Begin) + 1;
+    reader->PayloadWords = words;
+    reader->Begin += size;
+
+    command->Opcode = (CommandOpcode)(header & ((1u << OPCODE_BITS) - 1));
+    CommandCursor cursor = { .Words = reader->Payload, .WordCount = words };
+    Transfer(&cursor, command);
+    if (cursor.Failed || cursor.Position != words)
+    {
+        reader->Failed = true;
+        return false;
+    }
+    reader->CommandCount++;
+    return true;
+}
+
+bool CommandReader_Replay(CommandReader* reader, CommandSinkFunction sink, void* context)
+{
+    Command command;
+    while (CommandReader_Next(reader, &command))
+        sink(context, &command);
+    return !reader->Failed;
+}
+
+void CommandCounts_Add(void* context, const Command* command)
+{
+    CommandCounts* counts = context;
+    counts->Commands++;
+    counts->Opcodes[command->Opcode]++;
+    if (command->Opcode == COMMAND_FRAME)
+        counts->Frames++;
+    else if (command->Opcode == COMMAND_DRAW)
+        counts->Draws += command->Draw.InstanceCount;
+    else if (command->Opcode == COMMAND_DRAW_INDEXED)
+        counts->Draws += command->DrawIndexed.InstanceCount;
+}
+
+const char* Command_GetName(CommandOpcode opcode)
+{
+    if (opcode <= 0 || opcode >= COMMAND_OPCODE_COUNT)
+        return "Unknown";
+    return g_CommandNames[opcode];
+}
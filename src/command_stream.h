@@ -0,0 +1,445 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define COMMAND_STREAM_MAGIC 0x53434448u
+#define COMMAND_STREAM_VERSION 1
+// Ids start at 1, 0 references no object
+#define COMMAND_STREAM_NO_OBJECT 0
+// Longest array a command carries, like the barriers of one ResourceBarrier
+#define COMMAND_STREAM_MAX_ELEMENTS 16
+#define COMMAND_STREAM_MAX_CONSTANTS 64
+// Buffered commands are written out once they exceed this
+#define COMMAND_STREAM_FLUSH_SIZE (1024 * 1024)
+
+// The commands of ID3D12GraphicsCommandList the app records with, and the device and queue
+// calls a replay needs to follow them. Values of D3D12 enums and flags are kept as they are.
+typedef enum CommandOpcode
+{
+    // Start of a frame, the commands before the first one are the loading
+    COMMAND_FRAME = 1,
+    // The list the following list commands are recorded into
+    COMMAND_SET_LIST,
+    COMMAND_RESET_ALLOCATOR,
+    COMMAND_RESET,
+    COMMAND_CLOSE,
+    COMMAND_RESOURCE_BARRIER,
+    COMMAND_SET_PIPELINE_STATE,
+    COMMAND_SET_GRAPHICS_ROOT_SIGNATURE,
+    COMMAND_SET_COMPUTE_ROOT_SIGNATURE,
+    COMMAND_SET_DESCRIPTOR_HEAPS,
+    COMMAND_SET_PRIMITIVE_TOPOLOGY,
+    COMMAND_SET_GRAPHICS_ROOT_CONSTANTS,
+    COMMAND_SET_COMPUTE_ROOT_CONSTANTS,
+    COMMAND_SET_GRAPHICS_ROOT_TABLE,
+    COMMAND_SET_COMPUTE_ROOT_TABLE,
+    COMMAND_SET_COMPUTE_ROOT_CBV,
+    COMMAND_SET_COMPUTE_ROOT_SRV,
+    COMMAND_SET_COMPUTE_ROOT_UAV,
+    COMMAND_SET_VERTEX_BUFFERS,
+    COMMAND_SET_INDEX_BUFFER,
+    COMMAND_SET_VIEWPORTS,
+    COMMAND_SET_SCISSOR_RECTS,
+    COMMAND_SET_RENDER_TARGETS,
+    COMMAND_CLEAR_RENDER_TARGET,
+    COMMAND_CLEAR_DEPTH_STENCIL,
+    COMMAND_DRAW,
+    COMMAND_DRAW_INDEXED,
+    COMMAND_DISPATCH,
+    COMMAND_EXECUTE_BUNDLE,
+    COMMAND_EXECUTE_INDIRECT,
+    COMMAND_COPY_BUFFER,
+    COMMAND_COPY_TEXTURE,
+    COMMAND_END_QUERY,
+    COMMAND_RESOLVE_QUERY,
+    COMMAND_CREATE_RESOURCE,
+    COMMAND_CREATE_DEPTH_STENCIL_VIEW,
+    // Data the CPU staged in an upload buffer
+    COMMAND_WRITE_BUFFER,
+    COMMAND_EXECUTE_LISTS,
+    COMMAND_PRESENT,
+    COMMAND_OPCODE_COUNT
+} CommandOpcode;
+
+// GPU virtual addresses and descriptor handles are recorded relative to the object they're in
+typedef enum CommandAddressSpace
+{
+    COMMAND_ADDRESS_GPU_VIRTUAL,
+    COMMAND_ADDRESS_CPU_DESCRIPTOR,
+    COMMAND_ADDRESS_GPU_DESCRIPTOR,
+    COMMAND_ADDRESS_SPACE_COUNT
+} CommandAddressSpace;
+
+// Offset into an object, the raw address when it's in none the stream knows
+typedef struct CommandAddress
+{
+    uint32_t Object;
+    uint64_t Offset;
+} CommandAddress;
+
+// Transition: Resources[0] and Subresource go from States[0] to States[1]. UAV: Resources[0].
+// Aliasing: from Resources[0] to Resources[1].
+typedef struct CommandBarrier
+{
+    uint32_t Type;
+    uint32_t Flags;
+    uint32_t Resources[2];
+    uint32_t Subresource;
+    uint32_t States[2];
+} CommandBarrier;
+
+typedef struct CommandVertexBuffer
+{
+    CommandAddress Location;
+    uint32_t Size;
+    uint32_t Stride;
+} CommandVertexBuffer;
+
+typedef struct CommandViewport
+{
+    float X;
+    float Y;
+    float Width;
+    float Height;
+    float MinDepth;
+    float MaxDepth;
+} CommandViewport;
+
+typedef struct CommandRect
+{
+    int32_t Left;
+    int32_t Top;
+    int32_t Right;
+    int32_t Bottom;
+} CommandRect;
+
+// A subresource, or a placed footprint in a buffer
+typedef struct CommandCopyLocation
+{
+    uint32_t Resource;
+    uint32_t Type;
+    uint32_t Subresource;
+    uint64_t Offset;
+    uint32_t Format;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Depth;
+    uint32_t RowPitch;
+} CommandCopyLocation;
+
+typedef struct CommandResourceDesc
+{
+    uint32_t Dimension;
+    uint64_t Alignment;
+    uint64_t Width;
+    uint32_t Height;
+    uint32_t DepthOrArraySize;
+    uint32_t MipLevels;
+    uint32_t Format;
+    uint32_t SampleCount;
+    uint32_t SampleQuality;
+    uint32_t Layout;
+    uint32_t Flags;
+} CommandResourceDesc;
+
+// A decoded command, the member of the union is picked by the opcode. Objects are the ids the
+// stream gave them.
+typedef struct Command
+{
+    CommandOpcode Opcode;
+    union
+    {
+        uint64_t Frame;
+        // SET_LIST, RESET_ALLOCATOR, SET_PIPELINE_STATE, the root signatures and EXECUTE_BUNDLE
+        uint32_t Object;
+        struct
+        {
+            uint32_t Allocator;
+            uint32_t PipelineState;
+        } Reset;
+        struct
+        {
+            uint32_t Count;
+            CommandBarrier Barriers[COMMAND_STREAM_MAX_ELEMENTS];
+        } Barriers;
+        struct
+        {
+            uint32_t Count;
+            uint32_t Heaps[COMMAND_STREAM_MAX_ELEMENTS];
+        } DescriptorHeaps;
+        uint32_t PrimitiveTopology;
+        struct
+        {
+            uint32_t Parameter;
+            uint32_t Offset;
+            uint32_t Count;
+            uint32_t Values[COMMAND_STREAM_MAX_CONSTANTS];
+        } RootConstants;
+        // Descriptor tables and root views
+        struct
+        {
+            uint32_t Parameter;
+            CommandAddress Address;
+        } RootArgument;
+        struct
+        {
+            uint32_t StartSlot;
+            uint32_t Count;
+            CommandVertexBuffer Views[COMMAND_STREAM_MAX_ELEMENTS];
+        } VertexBuffers;
+        struct
+        {
+            // False unbinds the index buffer
+            bool Bound;
+            CommandAddress Location;
+            uint32_t Size;
+            uint32_t Format;
+        } IndexBuffer;
+        struct
+        {
+            uint32_t Count;
+            CommandViewport Viewports[COMMAND_STREAM_MAX_ELEMENTS];
+        } Viewports;
+        struct
+        {
+            uint32_t Count;
+            CommandRect Rects[COMMAND_STREAM_MAX_ELEMENTS];
+        } ScissorRects;
+        struct
+        {
+            uint32_t Count;
+            bool SingleHandle;
+            CommandAddress Views[COMMAND_STREAM_MAX_ELEMENTS];
+            bool HasDepthStencil;
+            CommandAddress DepthStencil;
+        } RenderTargets;
+        // Whole views, the app never clears rectangles
+        struct
+        {
+            CommandAddress View;
+            float Color[4];
+        } ClearRenderTarget;
+        struct
+        {
+            CommandAddress View;
+            uint32_t Flags;
+            float Depth;
+            uint32_t Stencil;
+        } ClearDepthStencil;
+        struct
+        {
+            uint32_t VertexCount;
+            uint32_t InstanceCount;
+            uint32_t StartVertex;
+            uint32_t StartInstance;
+        } Draw;
+        struct
+        {
+            uint32_t IndexCount;
+            uint32_t InstanceCount;
+            uint32_t StartIndex;
+            int32_t BaseVertex;
+            uint32_t StartInstance;
+        } DrawIndexed;
+        struct
+        {
+            uint32_t X;
+            uint32_t Y;
+            uint32_t Z;
+        } Dispatch;
+        struct
+        {
+            uint32_t Signature;
+            uint32_t MaxCount;
+            uint32_t Arguments;
+            uint64_t ArgumentOffset;
+            uint32_t CountBuffer;
+            uint64_t CountOffset;
+        } ExecuteIndirect;
+        struct
+        {
+            uint32_t Destination;
+            uint64_t DestinationOffset;
+            uint32_t Source;
+            uint64_t SourceOffset;
+            uint64_t Size;
+        } CopyBuffer;
+        struct
+        {
+            CommandCopyLocation Destination;
+            uint32_t X;
+            uint32_t Y;
+            uint32_t Z;
+            CommandCopyLocation Source;
+            // Left, top, front, right, bottom, back
+            bool HasBox;
+            uint32_t Box[6];
+        } CopyTexture;
+        struct
+        {
+            uint32_t Heap;
+            uint32_t Type;
+            uint32_t Index;
+        } Query;
+        struct
+        {
+            uint32_t Heap;
+            uint32_t Type;
+            uint32_t Start;
+            uint32_t Count;
+            uint32_t Destination;
+            uint64_t DestinationOffset;
+        } ResolveQuery;
+        struct
+        {
+            uint32_t Resource;
+            uint32_t HeapType;
+            uint32_t HeapFlags;
+            CommandResourceDesc Desc;
+            uint32_t InitialState;
+            bool HasClearValue;
+            uint32_t ClearFormat;
+            // The color, or the depth and the stencil
+            float ClearValue[4];
+        } CreateResource;
+        struct
+        {
+            uint32_t Resource;
+            // Without a desc the view takes the format of the resource
+            bool HasDesc;
+            uint32_t Format;
+            uint32_t Dimension;
+            uint32_t MipSlice;
+            uint32_t Flags;
+            CommandAddress View;
+        } CreateDepthStencilView;
+        struct
+        {
+            uint32_t Resource;
+            uint64_t Offset;
+            uint32_t Size;
+            // Into the buffer of the stream or the reader
+            const void* Data;
+        } WriteBuffer;
+        struct
+        {
+            uint32_t Queue;
+            uint32_t Count;
+            uint32_t Lists[COMMAND_STREAM_MAX_ELEMENTS];
+        } ExecuteLists;
+        struct
+        {
+            uint32_t SyncInterval;
+            uint32_t Flags;
+        } Present;
+    };
+} Command;
+
+typedef struct CommandRange
+{
+    uint64_t Start;
+    uint64_t Size;
+    uint32_t Object;
+} CommandRange;
+
+// Records commands into a compact binary capture. Every command is a word holding the opcode
+// in its low byte and the number of payload words above it, then the payload of 32-bit little
+// endian words. Objects are numbered as they're added, so a process creating the same objects
+// in the same order numbers them the same. It's written from one thread at a time.
+typedef struct CommandStream
+{
+    // NULL while not capturing, the objects are still numbered then
+    FILE* File;
+    uint8_t* Buffer;
+    size_t Size;
+    size_t Capacity;
+    uint64_t CommandCount;
+    uint64_t WrittenBytes;
+    uint32_t CurrentList;
+    bool Failed;
+
+    // Objects by id, and a map from the objects to their ids with linear probing
+    const void** Objects;
+    uint32_t ObjectCount;
+    uint32_t ObjectCapacity;
+    const void** SlotObjects;
+    uint32_t* SlotIds;
+    uint32_t SlotCount;
+    uint32_t UsedSlots;
+
+    // Sorted by start, they don't overlap
+    CommandRange* Ranges[COMMAND_ADDRESS_SPACE_COUNT];
+    uint32_t RangeCounts[COMMAND_ADDRESS_SPACE_COUNT];
+    uint32_t RangeCapacities[COMMAND_ADDRESS_SPACE_COUNT];
+} CommandStream;
+
+bool CommandStream_Create(CommandStream* stream);
+void CommandStream_Destroy(CommandStream* stream);
+
+// Starts writing the commands to the file
+bool CommandStream_Open(CommandStream* stream, const char* path);
+// Writes out what's buffered and closes the file, false when anything failed to be written
+bool CommandStream_Close(CommandStream* stream);
+bool CommandStream_IsCapturing(const CommandStream* stream);
+
+// Gives the object a new id, also when it had one, the memory of a released object is reused
+uint32_t CommandStream_AddObject(CommandStream* stream, const void* object);
+// Id of the object, a new one when the stream doesn't know it, and 0 for NULL
+uint32_t CommandStream_GetObject(CommandStream* stream, const void* object);
+// Makes the object the one of the id, a replay binds what it creates to the ids of the capture
+void CommandStream_BindObject(CommandStream* stream, uint32_t id, const void* object);
+// NULL for ids without an object
+const void* CommandStream_FindObject(const CommandStream* stream, uint32_t id);
+
+// Addresses in [start, start + size) become offsets into the object, replacing the ranges it overlaps
+void CommandStream_AddRange(CommandStream* stream, CommandAddressSpace space, uint32_t object, uint64_t start,
+                            uint64_t size);
+CommandAddress CommandStream_Resolve(const CommandStream* stream, CommandAddressSpace space, uint64_t address);
+// The address in this process, the raw offset when the object has no range in the space
+uint64_t CommandStream_Unresolve(const CommandStream* stream, CommandAddressSpace space, CommandAddress address);
+
+// Writes a SET_LIST when the list differs from the one of the previous list command
+void CommandStream_SelectList(CommandStream* stream, uint32_t list);
+// Does nothing while not capturing
+void CommandStream_Write(CommandStream* stream, const Command* command);
+
+typedef struct CommandReader
+{
+    FILE* File;
+    uint8_t* Buffer;
+    size_t Begin;
+    size_t End;
+    size_t Capacity;
+    // Words of the command returned last, valid until the next one
+    const uint32_t* Payload;
+    uint32_t PayloadWords;
+    uint64_t CommandCount;
+    bool Failed;
+} CommandReader;
+
+bool CommandReader_Open(CommandReader* reader, const char* path);
+void CommandReader_Close(CommandReader* reader);
+// Decodes the next command. False at the end of the capture, or on a malformed command, which
+// sets Failed.
+bool CommandReader_Next(CommandReader* reader, Command* command);
+
+typedef void (*CommandSinkFunction)(void* context, const Command* command);
+
+// Feeds the rest of the capture to the sink, false when it's malformed
+bool CommandReader_Replay(CommandReader* reader, CommandSinkFunction sink, void* context);
+
+typedef struct CommandCounts
+{
+    uint64_t Commands;
+    uint64_t Frames;
+    uint64_t Draws;
+    uint64_t Opcodes[COMMAND_OPCODE_COUNT];
+} CommandCounts;
+
+// The null sink, counting the commands the context gets
+void CommandCounts_Add(void* context, const Command* command);
+
+const char* Command_GetName(CommandOpcode opcode);
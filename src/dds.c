@@ -0,0 +1,268 @@
+#include "dds.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DDS_MAGIC 0x20534444u // "DDS "
+#define DDS_HEADER_SIZE 124
+#define DDS_PIXEL_FORMAT_SIZE 32
+#define DDS_DX10_HEADER_SIZE 20
+
+// Header fields as offsets in 32-bit words, after the magic
+#define DDS_SIZE 0
+#define DDS_FLAGS 1
+#define DDS_HEIGHT 2
+#define DDS_WIDTH 3
+#define DDS_PITCH_OR_LINEAR_SIZE 4
+#define DDS_DEPTH 5
+#define DDS_MIP_MAP_COUNT 6
+#define DDS_PF_SIZE 18
+#define DDS_PF_FLAGS 19
+#define DDS_PF_FOURCC 20
+#define DDS_PF_RGB_BIT_COUNT 21
+#define DDS_PF_R_MASK 22
+#define DDS_PF_G_MASK 23
+#define DDS_PF_B_MASK 24
+#define DDS_PF_A_MASK 25
+#define DDS_CAPS 26
+#define DDS_CAPS2 27
+
+#define DDSD_CAPS 0x1u
+#define DDSD_HEIGHT 0x2u
+#define DDSD_WIDTH 0x4u
+#define DDSD_PIXELFORMAT 0x1000u
+#define DDSD_MIPMAPCOUNT 0x20000u
+#define DDSD_LINEARSIZE 0x80000u
+#define DDSD_DEPTH 0x800000u
+#define DDPF_FOURCC 0x4u
+#define DDPF_RGB 0x40u
+#define DDSCAPS_COMPLEX 0x8u
+#define DDSCAPS_TEXTURE 0x1000u
+#define DDSCAPS_MIPMAP 0x400000u
+#define DDSCAPS2_CUBEMAP 0x200u
+#define DDSCAPS2_VOLUME 0x200000u
+
+#define DDS_DIMENSION_TEXTURE2D 3u
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4u
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+
+// The DXGI_FORMAT values the formats are stored with
+typedef struct DxgiFormat
+{
+    uint32_t Value;
+    TextureFormat Format;
+    bool Srgb;
+} DxgiFormat;
+
+static const DxgiFormat g_DxgiFormats[] = {
+    { 28, TEXTURE_FORMAT_RGBA8, false },
+    { 29, TEXTURE_FORMAT_RGBA8, true },
+    { 71, TEXTURE_FORMAT_BC1, false },
+    { 72, TEXTURE_FORMAT_BC1, true },
+    { 77, TEXTURE_FORMAT_BC3, false },
+    { 78, TEXTURE_FORMAT_BC3, true },
+    { 83, TEXTURE_FORMAT_BC5, false },
+    { 98, TEXTURE_FORMAT_BC7, false },
+    { 99, TEXTURE_FORMAT_BC7, true },
+};
+
+static uint32_t ReadWord(const uint8_t* data, size_t word)
+{
+    // DDS files are little-endian, like every target of the renderer
+    uint32_t value;
+    memcpy(&value, data + word * sizeof(uint32_t), sizeof(value));
+    return value;
+}
+
+static bool FromDxgiFormat(uint32_t value, TextureFormat* format, bool* srgb)
+{
+    for (size_t i = 0; i < sizeof(g_DxgiFormats) / sizeof(g_DxgiFormats[0]); ++i)
+    {
+        if (g_DxgiFormats[i].Value == value)
+        {
+            *format = g_DxgiFormats[i].Format;
+            *srgb = g_DxgiFormats[i].Srgb;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t ToDxgiFormat(TextureFormat format, bool srgb)
+{
+    for (size_t i = 0; i < sizeof(g_DxgiFormats) / sizeof(g_DxgiFormats[0]); ++i)
+    {
+        if (g_DxgiFormats[i].Format == format && g_DxgiFormats[i].Srgb == srgb)
+            return g_DxgiFormats[i].Value;
+    }
+    // BC5 has no sRGB variant
+    return srgb ? ToDxgiFormat(format, false) : 0;
+}
+
+static TextureFormat FromLegacyPixelFormat(const uint8_t* header)
+{
+    uint32_t flags = ReadWord(header, DDS_PF_FLAGS);
+    if (flags & DDPF_FOURCC)
+    {
+        switch (ReadWord(header, DDS_PF_FOURCC))
+        {
+            case FOURCC('D', 'X', 'T', '1'): return TEXTURE_FORMAT_BC1;
+            case FOURCC('D', 'X', 'T', '5'): return TEXTURE_FORMAT_BC3;
+            case FOURCC('A', 'T', 'I', '2'): return TEXTURE_FORMAT_BC5;
+            case FOURCC('B', 'C', '5', 'U'): return TEXTURE_FORMAT_BC5;
+            default: return TEXTURE_FORMAT_UNKNOWN;
+        }
+    }
+
+    if ((flags & DDPF_RGB) && ReadWord(header, DDS_PF_RGB_BIT_COUNT) == 32 &&
+        ReadWord(header, DDS_PF_R_MASK) == 0x000000FFu && ReadWord(header, DDS_PF_G_MASK) == 0x0000FF00u &&
+        ReadWord(header, DDS_PF_B_MASK) == 0x00FF0000u)
+        return TEXTURE_FORMAT_RGBA8;
+
+    return TEXTURE_FORMAT_UNKNOWN;
+}
+
+// Levels down to 1x1, log2 of the larger side plus one
+static uint32_t GetFullMipCount(uint32_t width, uint32_t height)
+{
+    uint32_t count = 1;
+    for (uint32_t size = width > height ? width : height; size > 1; size >>= 1)
+        ++count;
+    return count;
+}
+
+bool Dds_Parse(const void* data, size_t size, DdsTexture* texture)
+{
+    memset(texture, 0, sizeof(*texture));
+
+    const uint8_t* bytes = data;
+    if (size < sizeof(uint32_t) + DDS_HEADER_SIZE || ReadWord(bytes, 0) != DDS_MAGIC)
+        return false;
+
+    const uint8_t* header = bytes + sizeof(uint32_t);
+    size_t offset = sizeof(uint32_t) + DDS_HEADER_SIZE;
+    if (ReadWord(header, DDS_SIZE) != DDS_HEADER_SIZE || ReadWord(header, DDS_PF_SIZE) != DDS_PIXEL_FORMAT_SIZE)
+        return false;
+    if ((ReadWord(header, DDS_FLAGS) & DDSD_DEPTH) ||
+        (ReadWord(header, DDS_CAPS2) & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)))
+        return false;
+
+    if ((ReadWord(header, DDS_PF_FLAGS) & DDPF_FOURCC) && ReadWord(header, DDS_PF_FOURCC) == FOURCC('D', 'X', '1', '0'))
+    {
+        if (size < offset + DDS_DX10_HEADER_SIZE)
+            return false;
+
+        const uint8_t* extension = bytes + offset;
+        offset += DDS_DX10_HEADER_SIZE;
+        if (!FromDxgiFormat(ReadWord(extension, 0), &texture->Format, &texture->Srgb) ||
+            ReadWord(extension, 1) != DDS_DIMENSION_TEXTURE2D ||
+            (ReadWord(extension, 2) & DDS_RESOURCE_MISC_TEXTURECUBE) || ReadWord(extension, 3) > 1)
+            return false;
+    }
+    else
+    {
+        texture->Format = FromLegacyPixelFormat(header);
+        if (texture->Format == TEXTURE_FORMAT_UNKNOWN)
+            return false;
+    }
+
+    texture->Width = ReadWord(header, DDS_WIDTH);
+    texture->Height = ReadWord(header, DDS_HEIGHT);
+    uint32_t mipCount = (ReadWord(header, DDS_FLAGS) & DDSD_MIPMAPCOUNT) ? ReadWord(header, DDS_MIP_MAP_COUNT) : 1;
+    if (texture->Width == 0 || texture->Height == 0 || texture->Width > DDS_MAX_DIMENSION ||
+        texture->Height > DDS_MAX_DIMENSION || mipCount > GetFullMipCount(texture->Width, texture->Height))
+        return false;
+    texture->MipCount = mipCount > 0 ? mipCount : 1;
+
+    for (uint32_t i = 0; i < texture->MipCount; ++i)
+    {
+        DdsMip* mip = &texture->Mips[i];
+        mip->Width = texture->Width >> i > 0 ? texture->Width >> i : 1;
+        mip->Height = texture->Height >> i > 0 ? texture->Height >> i : 1;
+        // In 64 bits so the product can't wrap where size_t is 32 bits
+        uint64_t rowPitch = TextureFormat_GetRowPitch(texture->Format, mip->Width);
+        uint64_t slicePitch = rowPitch * TextureFormat_GetRowCount(texture->Format, mip->Height);
+        if (slicePitch > size - offset)
+            return false;
+
+        mip->RowPitch = (size_t)rowPitch;
+        mip->SlicePitch = (size_t)slicePitch;
+
+        mip->Data = bytes + offset;
+        offset += mip->SlicePitch;
+    }
+
+    return true;
+}
+
+bool Dds_Load(const char* path, DdsTexture* texture)
+{
+    memset(texture, 0, sizeof(*texture));
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    void* data = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        data = malloc((size_t)size);
+        if (data != NULL && fread(data, 1, (size_t)size, file) != (size_t)size)
+        {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+
+    if (data == NULL || !Dds_Parse(data, (size_t)size, texture))
+    {
+        free(data);
+        return false;
+    }
+
+    texture->FileData = data;
+    return true;
+}
+
+void Dds_Release(DdsTexture* texture)
+{
+    free(texture->FileData);
+    memset(texture, 0, sizeof(*texture));
+}
+
+bool Dds_Save(const char* path, const DdsTexture* texture)
+{
+    uint32_t dxgiFormat = ToDxgiFormat(texture->Format, texture->Srgb);
+    if (dxgiFormat == 0 || texture->MipCount == 0 || texture->MipCount > DDS_MAX_MIPS)
+        return false;
+
+    uint32_t header[1 + DDS_HEADER_SIZE / sizeof(uint32_t)] = { 0 };
+    uint32_t* fields = header + 1;
+    header[0] = DDS_MAGIC;
+    fields[DDS_SIZE] = DDS_HEADER_SIZE;
+    fields[DDS_FLAGS] = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    fields[DDS_HEIGHT] = texture->Height;
+    fields[DDS_WIDTH] = texture->Width;
+    fields[DDS_PITCH_OR_LINEAR_SIZE] = (uint32_t)texture->Mips[0].SlicePitch;
+    fields[DDS_MIP_MAP_COUNT] = texture->MipCount;
+    fields[DDS_PF_SIZE] = DDS_PIXEL_FORMAT_SIZE;
+    fields[DDS_PF_FLAGS] = DDPF_FOURCC;
+    fields[DDS_PF_FOURCC] = FOURCC('D', 'X', '1', '0');
+    fields[DDS_CAPS] = DDSCAPS_TEXTURE | (texture->MipCount > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+    uint32_t extension[DDS_DX10_HEADER_SIZE / sizeof(uint32_t)] = { dxgiFormat, DDS_DIMENSION_TEXTURE2D, 0, 1, 0 };
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    bool written = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(extension, sizeof(extension), 1, file) == 1;
+    for (uint32_t i = 0; written && i < texture->MipCount; ++i)
+        written = fwrite(texture->Mips[i].Data, 1, texture->Mips[i].SlicePitch, file) == texture->Mips[i].SlicePitch;
+
+    return fclose(file) == 0 && written;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "texture_format.h"
+
+#define DDS_MAX_MIPS 16
+// D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, larger textures are rejected
+#define DDS_MAX_DIMENSION 16384
+
+typedef struct DdsMip
+{
+    const uint8_t* Data;
+    uint32_t Width;
+    uint32_t Height;
+    // Bytes of a row of texels or blocks, and of the whole level
+    size_t RowPitch;
+    size_t SlicePitch;
+} DdsMip;
+
+// A 2D texture with its mip chain, largest level first
+typedef struct DdsTexture
+{
+    TextureFormat Format;
+    bool Srgb;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t MipCount;
+    DdsMip Mips[DDS_MAX_MIPS];
+    // Contents of the file read by Dds_Load, the mips point into it
+    void* FileData;
+} DdsTexture;
+
+// Parses a DDS file in memory, the mips point into data. Legacy headers and the DX10
+// extension are both read, cube maps, volumes and arrays are rejected. So are sizes above
+// DDS_MAX_DIMENSION, more mips than the chain of the size has, and mips past the end.
+bool Dds_Parse(const void* data, size_t size, DdsTexture* texture);
+
+bool Dds_Load(const char* path, DdsTexture* texture);
+void Dds_Release(DdsTexture* texture);
+
+// Writes the texture with the DX10 extension, which every format has a DXGI format for
+bool Dds_Save(const char* path, const DdsTexture* texture);
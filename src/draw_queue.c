@@ -0,0 +1,337 @@
+#include "draw_queue.h"
+#include "parallel.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+// Packets per histogram and scatter chunk
+#define RADIX_CHUNK_SIZE 16384
+
+#define FIELD_MASK(bits) ((1ull << (bits)) - 1)
+
+typedef struct RadixTaskData
+{
+    const DrawPacket* Source;
+    DrawPacket* Destination;
+    size_t Count;
+    uint32_t Shift;
+    // RADIX_BUCKETS counters per chunk, turned into the chunk's scatter offsets
+    uint32_t* Histograms;
+    // Bits set in any and in every key of each chunk
+    uint64_t* AnyBits;
+    uint64_t* AllBits;
+} RadixTaskData;
+
+uint64_t DrawKey_Pack(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth)
+{
+    return ((uint64_t)pass & FIELD_MASK(DRAW_KEY_PASS_BITS)) << DRAW_KEY_PASS_SHIFT |
+           ((uint64_t)pipeline & FIELD_MASK(DRAW_KEY_PIPELINE_BITS)) << DRAW_KEY_PIPELINE_SHIFT |
+           ((uint64_t)material & FIELD_MASK(DRAW_KEY_MATERIAL_BITS)) << DRAW_KEY_MATERIAL_SHIFT |
+           ((uint64_t)mesh & FIELD_MASK(DRAW_KEY_MESH_BITS)) << DRAW_KEY_MESH_SHIFT |
+           ((uint64_t)depth & FIELD_MASK(DRAW_KEY_DEPTH_BITS)) << DRAW_KEY_DEPTH_SHIFT;
+}
+
+uint32_t DrawKey_QuantizeDepth(float depth, bool backToFront)
+{
+    const uint32_t maxDepth = (uint32_t)FIELD_MASK(DRAW_KEY_DEPTH_BITS);
+
+    // Written so NaN ends up at 0 as well
+    float clamped = depth > 0.0f ? (depth < 1.0f ? depth : 1.0f) : 0.0f;
+    uint32_t quantized = (uint32_t)(clamped * (float)maxDepth + 0.5f);
+    if (quantized > maxDepth)
+        quantized = maxDepth;
+
+    return backToFront ? maxDepth - quantized : quantized;
+}
+
+uint32_t DrawKey_GetPass(uint64_t key)
+{
+    return (uint32_t)((key >> DRAW_KEY_PASS_SHIFT) & FIELD_MASK(DRAW_KEY_PASS_BITS));
+}
+
+uint32_t DrawKey_GetPipeline(uint64_t key)
+{
+    return (uint32_t)((key >> DRAW_KEY_PIPELINE_SHIFT) & FIELD_MASK(DRAW_KEY_PIPELINE_BITS));
+}
+
+uint32_t DrawKey_GetMaterial(uint64_t key)
+{
+    return (uint32_t)((key >> DRAW_KEY_MATERIAL_SHIFT) & FIELD_MASK(DRAW_KEY_MATERIAL_BITS));
+}
+
+uint32_t DrawKey_GetMesh(uint64_t key)
+{
+    return (uint32_t)((key >> DRAW_KEY_MESH_SHIFT) & FIELD_MASK(DRAW_KEY_MESH_BITS));
+}
+
+static bool Reserve(DrawQueue* queue, size_t capacity)
+{
+    if (capacity <= queue->Capacity)
+        return true;
+
+    DrawPacket* packets = malloc(capacity * sizeof(DrawPacket));
+    DrawPacket* scratch = malloc(capacity * sizeof(DrawPacket));
+    if (!packets || !scratch)
+    {
+        free(packets);
+        free(scratch);
+        return false;
+    }
+
+    if (queue->Count > 0)
+        memcpy(packets, queue->Packets, queue->Count * sizeof(DrawPacket));
+
+    free(queue->Packets);
+    free(queue->Scratch);
+
+    queue->Packets = packets;
+    queue->Scratch = scratch;
+    queue->Capacity = capacity;
+    return true;
+}
+
+bool DrawQueue_Create(DrawQueue* queue, size_t capacity)
+{
+    memset(queue, 0, sizeof(*queue));
+    return Reserve(queue, capacity > 0 ? capacity : 1);
+}
+
+void DrawQueue_Destroy(DrawQueue* queue)
+{
+    free(queue->Packets);
+    free(queue->Scratch);
+    free(queue->Histograms);
+    memset(queue, 0, sizeof(*queue));
+}
+
+void DrawQueue_Clear(DrawQueue* queue)
+{
+    queue->Count = 0;
+}
+
+bool DrawQueue_Push(DrawQueue* queue, uint64_t key, uint32_t instance, uint32_t range)
+{
+    if (queue->Count == queue->Capacity && !Reserve(queue, queue->Capacity * 2))
+        return false;
+
+    queue->Packets[queue->Count++] = (DrawPacket){
+        .Key = key,
+        .Instance = instance,
+        .Range = range
+    };
+    return true;
+}
+
+static void GetChunk(size_t count, size_t chunk, size_t* begin, size_t* end)
+{
+    *begin = chunk * RADIX_CHUNK_SIZE;
+    *end = *begin + RADIX_CHUNK_SIZE < count ? *begin + RADIX_CHUNK_SIZE : count;
+}
+
+static void KeyBitsTask(void* userData, size_t begin, size_t end)
+{
+    RadixTaskData* data = userData;
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+        size_t first, last;
+        GetChunk(data->Count, chunk, &first, &last);
+
+        uint64_t anyBits = 0;
+        uint64_t allBits = ~0ull;
+        for (size_t i = first; i < last; ++i)
+        {
+            anyBits |= data->Source[i].Key;
+            allBits &= data->Source[i].Key;
+        }
+        data->AnyBits[chunk] = anyBits;
+        data->AllBits[chunk] = allBits;
+    }
+}
+
+static void HistogramTask(void* userData, size_t begin, size_t end)
+{
+    RadixTaskData* data = userData;
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+        size_t first, last;
+        GetChunk(data->Count, chunk, &first, &last);
+
+        uint32_t* histogram = data->Histograms + chunk * RADIX_BUCKETS;
+        memset(histogram, 0, RADIX_BUCKETS * sizeof(uint32_t));
+        for (size_t i = first; i < last; ++i)
+            ++histogram[(data->Source[i].Key >> data->Shift) & (RADIX_BUCKETS - 1)];
+    }
+}
+
+static void ScatterTask(void* userData, size_t begin, size_t end)
+{
+    RadixTaskData* data = userData;
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+        size_t first, last;
+        GetChunk(data->Count, chunk, &first, &last);
+
+        // The offsets are private to the chunk, so the copy in the task data is updated in place
+        uint32_t* offsets = data->Histograms + chunk * RADIX_BUCKETS;
+        for (size_t i = first; i < last; ++i)
+        {
+            const DrawPacket* packet = &data->Source[i];
+            data->Destination[offsets[(packet->Key >> data->Shift) & (RADIX_BUCKETS - 1)]++] = *packet;
+        }
+    }
+}
+
+// Turns the chunk histograms into the offsets each chunk scatters its digits to. Chunks fill
+// a bucket in order, which keeps the sort stable.
+static void ComputeOffsets(uint32_t* histograms, size_t chunkCount)
+{
+    uint32_t offset = 0;
+    for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket)
+    {
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            uint32_t count = histograms[chunk * RADIX_BUCKETS + bucket];
+            histograms[chunk * RADIX_BUCKETS + bucket] = offset;
+            offset += count;
+        }
+    }
+}
+
+static void SwapPackets(DrawQueue* queue)
+{
+    DrawPacket* packets = queue->Packets;
+    queue->Packets = queue->Scratch;
+    queue->Scratch = packets;
+}
+
+static bool ReserveHistograms(DrawQueue* queue, size_t chunkCount)
+{
+    // Counters for every chunk followed by the key bits of each chunk
+    size_t size = chunkCount * (RADIX_BUCKETS * sizeof(uint32_t) + 2 * sizeof(uint64_t));
+    if (size <= queue->HistogramCapacity)
+        return true;
+
+    uint32_t* histograms = malloc(size);
+    if (histograms == NULL)
+        return false;
+
+    free(queue->Histograms);
+    queue->Histograms = histograms;
+    queue->HistogramCapacity = size;
+    return true;
+}
+
+void DrawQueue_Sort(DrawQueue* queue)
+{
+    size_t count = queue->Count;
+    size_t chunkCount = (count + RADIX_CHUNK_SIZE - 1) / RADIX_CHUNK_SIZE;
+    if (count < 2)
+        return;
+    if (!ReserveHistograms(queue, chunkCount))
+    {
+        DrawQueue_SortScalar(queue);
+        return;
+    }
+
+    RadixTaskData data = {
+        .Count = count,
+        .Histograms = queue->Histograms,
+        .AnyBits = (uint64_t*)(queue->Histograms + chunkCount * RADIX_BUCKETS),
+    };
+    data.AllBits = data.AnyBits + chunkCount;
+
+    // A digit can only be skipped when no key differs from the others in it
+    data.Source = queue->Packets;
+    ParallelFor(chunkCount, 1, KeyBitsTask, &data);
+    uint64_t anyBits = 0;
+    uint64_t allBits = ~0ull;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        anyBits |= data.AnyBits[chunk];
+        allBits &= data.AllBits[chunk];
+    }
+    uint64_t differingBits = anyBits ^ allBits;
+
+    for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+    {
+        data.Shift = pass * RADIX_BITS;
+        if (((differingBits >> data.Shift) & (RADIX_BUCKETS - 1)) == 0)
+            continue;
+
+        data.Source = queue->Packets;
+        data.Destination = queue->Scratch;
+        ParallelFor(chunkCount, 1, HistogramTask, &data);
+        ComputeOffsets(data.Histograms, chunkCount);
+        ParallelFor(chunkCount, 1, ScatterTask, &data);
+        SwapPackets(queue);
+    }
+}
+
+void DrawQueue_SortScalar(DrawQueue* queue)
+{
+    uint32_t histogram[RADIX_BUCKETS];
+    for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass)
+    {
+        uint32_t shift = pass * RADIX_BITS;
+
+        memset(histogram, 0, sizeof(histogram));
+        for (size_t i = 0; i < queue->Count; ++i)
+            ++histogram[(queue->Packets[i].Key >> shift) & (RADIX_BUCKETS - 1)];
+
+        uint32_t offset = 0;
+        for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket)
+        {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < queue->Count; ++i)
+        {
+            const DrawPacket* packet = &queue->Packets[i];
+            queue->Scratch[histogram[(packet->Key >> shift) & (RADIX_BUCKETS - 1)]++] = *packet;
+        }
+        SwapPackets(queue);
+    }
+}
+
+void DrawStateFilter_Reset(DrawStateFilter* filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+uint32_t DrawStateFilter_Next(DrawStateFilter* filter, uint64_t key)
+{
+    static const uint64_t passMask = FIELD_MASK(DRAW_KEY_PASS_BITS) << DRAW_KEY_PASS_SHIFT;
+    static const uint64_t pipelineMask = FIELD_MASK(DRAW_KEY_PIPELINE_BITS) << DRAW_KEY_PIPELINE_SHIFT;
+    static const uint64_t materialMask = FIELD_MASK(DRAW_KEY_MATERIAL_BITS) << DRAW_KEY_MATERIAL_SHIFT;
+    static const uint64_t meshMask = FIELD_MASK(DRAW_KEY_MESH_BITS) << DRAW_KEY_MESH_SHIFT;
+
+    uint64_t changedBits = filter->Bound ? filter->CurrentKey ^ key : ~0ull;
+    filter->CurrentKey = key;
+    filter->Bound = true;
+
+    uint32_t changes = 0;
+    if (changedBits & passMask)
+        changes |= DRAW_STATE_PASS;
+    if (changedBits & pipelineMask)
+    {
+        changes |= DRAW_STATE_PIPELINE;
+        ++filter->PipelineChanges;
+    }
+    if (changedBits & materialMask)
+    {
+        changes |= DRAW_STATE_MATERIAL;
+        ++filter->MaterialChanges;
+    }
+    if (changedBits & meshMask)
+    {
+        changes |= DRAW_STATE_MESH;
+        ++filter->MeshChanges;
+    }
+
+    return changes;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fields of the 64-bit sort key from the most to the least significant bits. Sorting the keys
+// groups the draws by pass, then pipeline state, material and mesh, and orders them by depth
+// within the same state.
+#define DRAW_KEY_PASS_BITS 4
+#define DRAW_KEY_PIPELINE_BITS 10
+#define DRAW_KEY_MATERIAL_BITS 14
+#define DRAW_KEY_MESH_BITS 12
+#define DRAW_KEY_DEPTH_BITS 24
+
+#define DRAW_KEY_DEPTH_SHIFT 0
+#define DRAW_KEY_MESH_SHIFT (DRAW_KEY_DEPTH_SHIFT + DRAW_KEY_DEPTH_BITS)
+#define DRAW_KEY_MATERIAL_SHIFT (DRAW_KEY_MESH_SHIFT + DRAW_KEY_MESH_BITS)
+#define DRAW_KEY_PIPELINE_SHIFT (DRAW_KEY_MATERIAL_SHIFT + DRAW_KEY_MATERIAL_BITS)
+#define DRAW_KEY_PASS_SHIFT (DRAW_KEY_PIPELINE_SHIFT + DRAW_KEY_PIPELINE_BITS)
+
+// State a draw needs bound, returned by DrawStateFilter_Next for the fields that changed
+typedef enum DrawStateChange
+{
+    DRAW_STATE_PASS = 1 << 0,
+    DRAW_STATE_PIPELINE = 1 << 1,
+    DRAW_STATE_MATERIAL = 1 << 2,
+    DRAW_STATE_MESH = 1 << 3
+} DrawStateChange;
+
+// Instance is what is drawn, a node for example, and Range the index range of the mesh
+typedef struct DrawPacket
+{
+    uint64_t Key;
+    uint32_t Instance;
+    uint32_t Range;
+} DrawPacket;
+
+typedef struct DrawQueue
+{
+    DrawPacket* Packets;
+    size_t Count;
+    size_t Capacity;
+
+    // Sort scratch, the packets are scattered back and forth between both arrays
+    DrawPacket* Scratch;
+    uint32_t* Histograms;
+    size_t HistogramCapacity;
+} DrawQueue;
+
+// Skips the state sets of a sorted queue that would rebind what is already bound
+typedef struct DrawStateFilter
+{
+    uint64_t CurrentKey;
+    bool Bound;
+
+    // Binds counted since the last reset
+    size_t PipelineChanges;
+    size_t MaterialChanges;
+    size_t MeshChanges;
+} DrawStateFilter;
+
+// Fields wider than their bits are truncated. depth is the view depth normalized to [0, 1],
+// pass backToFront for blended passes.
+uint64_t DrawKey_Pack(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth);
+uint32_t DrawKey_QuantizeDepth(float depth, bool backToFront);
+
+uint32_t DrawKey_GetPass(uint64_t key);
+uint32_t DrawKey_GetPipeline(uint64_t key);
+uint32_t DrawKey_GetMaterial(uint64_t key);
+uint32_t DrawKey_GetMesh(uint64_t key);
+
+bool DrawQueue_Create(DrawQueue* queue, size_t capacity);
+void DrawQueue_Destroy(DrawQueue* queue);
+void DrawQueue_Clear(DrawQueue* queue);
+
+// Returns false on allocation failure
+bool DrawQueue_Push(DrawQueue* queue, uint64_t key, uint32_t instance, uint32_t range);
+
+// Stable LSD radix sort of the packets by key, 8 bits per pass. Every pass histograms chunks of
+// the packets across the workers, then scatters each chunk to the offsets of its digits. Passes
+// whose digit is the same for every key are skipped.
+void DrawQueue_Sort(DrawQueue* queue);
+
+// Single threaded reference running every pass
+void DrawQueue_SortScalar(DrawQueue* queue);
+
+void DrawStateFilter_Reset(DrawStateFilter* filter);
+
+// Returns the DrawStateChange flags of the state to bind before drawing the key. Everything is
+// reported for the first key after a reset.
+uint32_t DrawStateFilter_Next(DrawStateFilter* filter, uint64_t key);
@@ -0,0 +1,88 @@
+#include "dynamic_buffer.h"
+#include "simd.h"
+
+#include <string.h>
+
+void DynamicBuffer_Init(DynamicBuffer* buffer, void* data, uint64_t gpuAddress,
+                        size_t regionSize, uint32_t regionCount)
+{
+    buffer->Data = data;
+    buffer->GpuAddress = gpuAddress;
+    buffer->RegionSize = regionSize;
+    buffer->RegionCount = regionCount;
+    buffer->Region = 0;
+    buffer->Offset = 0;
+    buffer->Requested = 0;
+}
+
+void DynamicBuffer_BeginFrame(DynamicBuffer* buffer, uint32_t frameIndex)
+{
+    buffer->Region = frameIndex % buffer->RegionCount;
+    buffer->Offset = 0;
+    buffer->Requested = 0;
+}
+
+void* DynamicBuffer_Allocate(DynamicBuffer* buffer, size_t size, size_t alignment, uint64_t* gpuAddress)
+{
+    buffer->Requested += size;
+
+    // Regions and alignments are relative to the start of the buffer, which the GPU aligns
+    size_t start = (buffer->Offset + alignment - 1) & ~(alignment - 1);
+    if (start > buffer->RegionSize || size > buffer->RegionSize - start)
+        return NULL;
+
+    buffer->Offset = start + size;
+    size_t offset = (size_t)buffer->Region * buffer->RegionSize + start;
+    if (gpuAddress != NULL)
+        *gpuAddress = buffer->GpuAddress + offset;
+    return buffer->Data + offset;
+}
+
+void* DynamicBuffer_Write(DynamicBuffer* buffer, const void* data, size_t size, size_t alignment,
+                          uint64_t* gpuAddress)
+{
+    void* destination = DynamicBuffer_Allocate(buffer, size, alignment, gpuAddress);
+    if (destination != NULL)
+        StreamCopy(destination, data, size);
+    return destination;
+}
+
+void StreamCopy(void* destination, const void* source, size_t size)
+{
+    uint8_t* dst = destination;
+    const uint8_t* src = source;
+
+#if defined(HD_SSE2)
+    // Head up to the first 16 byte boundary of the destination
+    size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    head = head < size ? head : size;
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    size -= head;
+
+    // Full cache lines at a time, so the write-combining buffers are flushed whole
+    for (; size >= 64; size -= 64, dst += 64, src += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + 0));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+        _mm_stream_si128((__m128i*)(dst + 0), a);
+        _mm_stream_si128((__m128i*)(dst + 16), b);
+        _mm_stream_si128((__m128i*)(dst + 32), c);
+        _mm_stream_si128((__m128i*)(dst + 48), d);
+    }
+    for (; size >= 16; size -= 16, dst += 16, src += 16)
+        _mm_stream_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)src));
+#endif
+
+    memcpy(dst, src, size);
+}
+
+void StreamFence(void)
+{
+#if defined(HD_SSE2)
+    _mm_sfence();
+#endif
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-frame sub-allocation of memory that stays mapped for its whole lifetime, such as an
+// upload heap buffer the GPU reads in place. It's split into one region per frame in flight
+// and a frame only writes to its own, which the frame fence guards from the GPU still
+// reading it.
+typedef struct DynamicBuffer
+{
+    uint8_t* Data;
+    uint64_t GpuAddress;
+    size_t RegionSize;
+    uint32_t RegionCount;
+    uint32_t Region;
+    size_t Offset;
+    // Bytes asked for this frame, the requests that didn't fit included
+    size_t Requested;
+} DynamicBuffer;
+
+// data spans regionSize * regionCount bytes, gpuAddress is its address on the GPU
+void DynamicBuffer_Init(DynamicBuffer* buffer, void* data, uint64_t gpuAddress,
+                        size_t regionSize, uint32_t regionCount);
+
+// Starts filling the region of the frame, once its fence completed
+void DynamicBuffer_BeginFrame(DynamicBuffer* buffer, uint32_t frameIndex);
+
+// Returns where to write size bytes and their GPU address, NULL once the region is full.
+// Alignment is a power of two.
+void* DynamicBuffer_Allocate(DynamicBuffer* buffer, size_t size, size_t alignment, uint64_t* gpuAddress);
+
+// Allocates and copies the data in, see StreamCopy and StreamFence
+void* DynamicBuffer_Write(DynamicBuffer* buffer, const void* data, size_t size, size_t alignment,
+                          uint64_t* gpuAddress);
+
+// Copies with non-temporal stores. Mapped upload memory is write-combined, it's written
+// once front to back and never read, and caching it would only evict the source.
+void StreamCopy(void* destination, const void* source, size_t size);
+
+// Orders the streamed stores before whatever follows. Fencing after every copy would stall
+// on each one, call it once the frame's writes are done and before they're submitted.
+void StreamFence(void);
@@ -0,0 +1,89 @@
+#include "dynamic_resolution.h"
+
+#include <math.h>
+#include <string.h>
+
+void DynamicResolution_GetDefaultSettings(DynamicResolutionSettings* settings, float targetMilliseconds)
+{
+    *settings = (DynamicResolutionSettings){
+        .TargetMilliseconds = targetMilliseconds,
+        .MinScale = 0.5f,
+        .MaxScale = 1.0f,
+        .ProportionalGain = 0.1f,
+        .IntegralGain = 0.1f,
+        .DerivativeGain = 0.0f,
+        .Smoothing = 0.05f,
+        .Deadband = 0.01f,
+        .MinScaleStep = 0.015f
+    };
+}
+
+static float GetMedian(const float values[DYNAMIC_RESOLUTION_MEDIAN_FRAMES], uint32_t count)
+{
+    float sorted[DYNAMIC_RESOLUTION_MEDIAN_FRAMES];
+    memcpy(sorted, values, count * sizeof(float));
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        float value = sorted[i];
+        uint32_t j = i;
+        for (; j > 0 && sorted[j - 1] > value; --j)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = value;
+    }
+    return sorted[count / 2];
+}
+
+void DynamicResolution_Init(DynamicResolution* controller, const DynamicResolutionSettings* settings)
+{
+    memset(controller, 0, sizeof(*controller));
+    controller->Settings = *settings;
+    controller->Scale = settings->MaxScale;
+    controller->LogPixels = 2.0f * logf(settings->MaxScale);
+}
+
+float DynamicResolution_Update(DynamicResolution* controller, float gpuMilliseconds, float frameScale)
+{
+    const DynamicResolutionSettings* settings = &controller->Settings;
+    if (!(gpuMilliseconds > 0.0f) || !(frameScale > 0.0f))
+        return controller->Scale;
+
+    // Pixel count the frame suggests, the same whatever scale it was rendered at
+    controller->Suggested[controller->UpdateCount % DYNAMIC_RESOLUTION_MEDIAN_FRAMES] =
+        2.0f * logf(frameScale) + logf(settings->TargetMilliseconds / gpuMilliseconds);
+    controller->UpdateCount++;
+    uint32_t count = controller->UpdateCount < DYNAMIC_RESOLUTION_MEDIAN_FRAMES ?
+        controller->UpdateCount : DYNAMIC_RESOLUTION_MEDIAN_FRAMES;
+    float error = GetMedian(controller->Suggested, count) - controller->LogPixels;
+    controller->SmoothedError = controller->UpdateCount > 1 ?
+        controller->SmoothedError + settings->Smoothing * (error - controller->SmoothedError) : error;
+    error = fabsf(controller->SmoothedError) > settings->Deadband ? controller->SmoothedError : 0.0f;
+
+    // Velocity form, the log pixel count is the integral
+    controller->LogPixels += settings->ProportionalGain * (error - controller->Errors[0]) +
+                             settings->IntegralGain * error +
+                             settings->DerivativeGain * (error - 2.0f * controller->Errors[0] + controller->Errors[1]);
+    controller->Errors[1] = controller->Errors[0];
+    controller->Errors[0] = error;
+
+    float minLogPixels = 2.0f * logf(settings->MinScale);
+    float maxLogPixels = 2.0f * logf(settings->MaxScale);
+    float requested;
+    if (controller->LogPixels <= minLogPixels)
+    {
+        controller->LogPixels = minLogPixels;
+        requested = settings->MinScale;
+    }
+    else if (controller->LogPixels >= maxLogPixels)
+    {
+        controller->LogPixels = maxLogPixels;
+        requested = settings->MaxScale;
+    }
+    else
+        requested = expf(0.5f * controller->LogPixels);
+
+    // Hysteresis, the scale isn't dragged back and forth by every small correction
+    if (fabsf(requested - controller->Scale) >= settings->MinScaleStep ||
+        requested == settings->MinScale || requested == settings->MaxScale)
+        controller->Scale = requested;
+    return controller->Scale;
+}
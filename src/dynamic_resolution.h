@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DYNAMIC_RESOLUTION_MEDIAN_FRAMES 5
+
+typedef struct DynamicResolutionSettings
+{
+    // GPU time per frame to hold
+    float TargetMilliseconds;
+    // Bounds of the scale applied to the width and the height
+    float MinScale;
+    float MaxScale;
+    // Gains of the PID controller, acting on the log of the pixel count
+    float ProportionalGain;
+    float IntegralGain;
+    float DerivativeGain;
+    // Weight of a new error in the smoothed one, lower rejects more noise but reacts later
+    float Smoothing;
+    // Relative errors within it count as none, so noise around the target doesn't move the scale
+    float Deadband;
+    // Smallest change of the applied scale, the requested one moves freely until it's that far
+    float MinScaleStep;
+} DynamicResolutionSettings;
+
+// Picks the scale of the frames from their GPU times. GPU time is taken to be roughly
+// proportional to the pixel count, so the controller works on the log of it and the error is
+// the log of the ratio of the target to the frame time, filtered through a median and an
+// exponential moving average. Frame times arrive a few frames late, every one comes with the
+// scale it was rendered at and the error is taken relative to it rather than to the latest
+// scale, so the delay doesn't make it overshoot.
+typedef struct DynamicResolution
+{
+    DynamicResolutionSettings Settings;
+    // Log of the pixel count relative to the full resolution the controller asks for
+    float LogPixels;
+    // Scale applied to the frames, it only moves in steps of MinScaleStep or onto the bounds
+    float Scale;
+    // Pixel counts the last frames suggested, the median of them rejects single frame spikes
+    float Suggested[DYNAMIC_RESOLUTION_MEDIAN_FRAMES];
+    float SmoothedError;
+    // Of the two previous updates, for the proportional and derivative terms
+    float Errors[2];
+    uint32_t UpdateCount;
+} DynamicResolution;
+
+// Gains tuned with tools/resolution_sim.c for a couple of frames of latency
+void DynamicResolution_GetDefaultSettings(DynamicResolutionSettings* settings, float targetMilliseconds);
+
+// Starts at the largest scale
+void DynamicResolution_Init(DynamicResolution* controller, const DynamicResolutionSettings* settings);
+
+// Feeds the GPU time of a finished frame and the scale it was rendered at, returns the scale
+// of the next frame
+float DynamicResolution_Update(DynamicResolution* controller, float gpuMilliseconds, float frameScale);
@@ -0,0 +1,216 @@
+#include "frame_arena.h"
+#include "job_system.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#define SCRATCH_BLOCK_SIZE (64 * 1024)
+
+struct ArenaBlock
+{
+    ArenaBlock* Next;
+    size_t Capacity;
+    size_t Offset;
+};
+
+static ArenaBlock* CreateBlock(size_t capacity)
+{
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + capacity);
+    if (block == NULL)
+        return NULL;
+
+    block->Next = NULL;
+    block->Capacity = capacity;
+    block->Offset = 0;
+    return block;
+}
+
+static void DestroyBlocks(ArenaBlock* block)
+{
+    while (block != NULL)
+    {
+        ArenaBlock* next = block->Next;
+        free(block);
+        block = next;
+    }
+}
+
+static uint8_t* GetBlockData(ArenaBlock* block)
+{
+    return (uint8_t*)(block + 1);
+}
+
+// Offset the allocation ends at within the block, or SIZE_MAX when it doesn't fit
+static size_t FitAllocation(ArenaBlock* block, size_t size, size_t alignment, size_t* start)
+{
+    uintptr_t data = (uintptr_t)GetBlockData(block);
+    uintptr_t aligned = (data + block->Offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    *start = (size_t)(aligned - data);
+    if (*start > block->Capacity || size > block->Capacity - *start)
+        return SIZE_MAX;
+    return *start + size;
+}
+
+bool LinearArena_Create(LinearArena* arena, size_t blockSize)
+{
+    memset(arena, 0, sizeof(*arena));
+    arena->BlockSize = blockSize;
+    arena->First = CreateBlock(blockSize);
+    arena->Current = arena->First;
+    return arena->First != NULL;
+}
+
+void LinearArena_Destroy(LinearArena* arena)
+{
+    DestroyBlocks(arena->First);
+    memset(arena, 0, sizeof(*arena));
+}
+
+void* LinearArena_Alloc(LinearArena* arena, size_t size, size_t alignment)
+{
+    ArenaBlock* block = arena->Current;
+    size_t start;
+    size_t end = FitAllocation(block, size, alignment, &start);
+    if (end == SIZE_MAX)
+    {
+        // Move on to the block left over from before a rollback or reset, or add one
+        ArenaBlock* next = block->Next;
+        if (next != NULL)
+            next->Offset = 0;
+        if (next == NULL || (end = FitAllocation(next, size, alignment, &start)) == SIZE_MAX)
+        {
+            size_t capacity = size + alignment > arena->BlockSize ? size + alignment : arena->BlockSize;
+            next = CreateBlock(capacity);
+            if (next == NULL)
+                return NULL;
+
+            next->Next = block->Next;
+            block->Next = next;
+            end = FitAllocation(next, size, alignment, &start);
+        }
+        arena->Used += block->Capacity - block->Offset;
+        arena->Current = next;
+        block = next;
+    }
+
+    arena->Used += end - block->Offset;
+    arena->Peak = arena->Used > arena->Peak ? arena->Used : arena->Peak;
+    block->Offset = end;
+    return GetBlockData(block) + start;
+}
+
+void LinearArena_Reset(LinearArena* arena)
+{
+    // A frame that needed several blocks gets a single one from now on
+    if (arena->First->Next != NULL)
+    {
+        ArenaBlock* merged = CreateBlock(arena->Peak > arena->BlockSize ? arena->Peak : arena->BlockSize);
+        if (merged != NULL)
+        {
+            DestroyBlocks(arena->First);
+            arena->First = merged;
+        }
+    }
+
+    arena->First->Offset = 0;
+    arena->Current = arena->First;
+    arena->Used = 0;
+}
+
+ArenaMarker LinearArena_GetMarker(const LinearArena* arena)
+{
+    ArenaMarker marker = { arena->Current, arena->Current->Offset, arena->Used };
+    return marker;
+}
+
+void LinearArena_Rollback(LinearArena* arena, ArenaMarker marker)
+{
+    arena->Current = marker.Block;
+    arena->Current->Offset = marker.Offset;
+    arena->Used = marker.Used;
+}
+
+bool FrameArenas_Create(FrameArenas* arenas, uint32_t frameCount, size_t blockSize)
+{
+    arenas->FrameCount = frameCount;
+    arenas->ThreadCount = JobSystem_GetThreadIndexCount();
+    arenas->Arenas = calloc((size_t)frameCount * arenas->ThreadCount, sizeof(LinearArena));
+    if (arenas->Arenas == NULL)
+        return false;
+
+    for (uint32_t i = 0; i < frameCount * arenas->ThreadCount; ++i)
+    {
+        if (!LinearArena_Create(&arenas->Arenas[i], blockSize))
+        {
+            FrameArenas_Destroy(arenas);
+            return false;
+        }
+    }
+    return true;
+}
+
+void FrameArenas_Destroy(FrameArenas* arenas)
+{
+    if (arenas->Arenas != NULL)
+    {
+        for (uint32_t i = 0; i < arenas->FrameCount * arenas->ThreadCount; ++i)
+            LinearArena_Destroy(&arenas->Arenas[i]);
+    }
+    free(arenas->Arenas);
+    memset(arenas, 0, sizeof(*arenas));
+}
+
+LinearArena* FrameArenas_Get(FrameArenas* arenas, uint32_t frame)
+{
+    uint32_t threadIndex = JobSystem_GetThreadIndex();
+    if (threadIndex >= arenas->ThreadCount)
+        return NULL;
+    return &arenas->Arenas[frame * arenas->ThreadCount + threadIndex];
+}
+
+void FrameArenas_Reset(FrameArenas* arenas, uint32_t frame)
+{
+    for (uint32_t i = 0; i < arenas->ThreadCount; ++i)
+        LinearArena_Reset(&arenas->Arenas[frame * arenas->ThreadCount + i]);
+}
+
+static _Thread_local LinearArena* t_ScratchArena;
+static tss_t g_ScratchKey;
+static bool g_ScratchKeyCreated;
+static once_flag g_ScratchOnce = ONCE_FLAG_INIT;
+
+static void DestroyScratchArena(void* value)
+{
+    LinearArena* arena = value;
+    LinearArena_Destroy(arena);
+    free(arena);
+}
+
+static void CreateScratchKey(void)
+{
+    g_ScratchKeyCreated = tss_create(&g_ScratchKey, DestroyScratchArena) == thrd_success;
+}
+
+LinearArena* ScratchArena_Get(void)
+{
+    if (t_ScratchArena != NULL)
+        return t_ScratchArena;
+
+    call_once(&g_ScratchOnce, CreateScratchKey);
+
+    LinearArena* arena = malloc(sizeof(LinearArena));
+    if (arena == NULL)
+        return NULL;
+    if (!LinearArena_Create(arena, SCRATCH_BLOCK_SIZE))
+    {
+        free(arena);
+        return NULL;
+    }
+
+    // Without the key the arena stays alive until the process exits
+    if (g_ScratchKeyCreated)
+        tss_set(g_ScratchKey, arena);
+    t_ScratchArena = arena;
+    return arena;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator over a chain of blocks. Nothing is freed on its own, a reset or a rollback
+// to a marker releases everything allocated after it at once. Not thread-safe, every thread
+// allocates from arenas of its own.
+typedef struct LinearArena
+{
+    ArenaBlock* First;
+    ArenaBlock* Current;
+    size_t BlockSize;
+    // Bytes handed out since the last reset and the most ever, a reset merges the blocks
+    // into one that fits the most
+    size_t Used;
+    size_t Peak;
+} LinearArena;
+
+typedef struct ArenaMarker
+{
+    ArenaBlock* Block;
+    size_t Offset;
+    size_t Used;
+} ArenaMarker;
+
+bool LinearArena_Create(LinearArena* arena, size_t blockSize);
+void LinearArena_Destroy(LinearArena* arena);
+
+// Alignment is a power of two. Returns NULL only when a new block can't be allocated.
+void* LinearArena_Alloc(LinearArena* arena, size_t size, size_t alignment);
+void LinearArena_Reset(LinearArena* arena);
+
+ArenaMarker LinearArena_GetMarker(const LinearArena* arena);
+void LinearArena_Rollback(LinearArena* arena, ArenaMarker marker);
+
+#define LinearArena_AllocArray(arena, type, count) \
+    ((type*)LinearArena_Alloc((arena), (count) * sizeof(type), _Alignof(type)))
+
+// Arenas for data living until the GPU is done with a frame, one per frame in flight and
+// job system thread. The frame's arenas are reset once its fence completed, while nothing
+// allocates from them.
+typedef struct FrameArenas
+{
+    LinearArena* Arenas;
+    uint32_t FrameCount;
+    uint32_t ThreadCount;
+} FrameArenas;
+
+// Call after the job system started, its threads are the ones getting arenas
+bool FrameArenas_Create(FrameArenas* arenas, uint32_t frameCount, size_t blockSize);
+void FrameArenas_Destroy(FrameArenas* arenas);
+
+// Arena of the calling thread for the frame, NULL on threads outside the job system
+LinearArena* FrameArenas_Get(FrameArenas* arenas, uint32_t frame);
+void FrameArenas_Reset(FrameArenas* arenas, uint32_t frame);
+
+// Arena of the calling thread for temporaries of a single call, created on first use and
+// released when the thread exits. Take a marker first and roll back to it before returning.
+LinearArena* ScratchArena_Get(void);
@@ -0,0 +1,154 @@
+#include "frame_limiter.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <Windows.h>
+    // Windows 10 1803 and later, older SDKs don't define it
+    #ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+        #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+    #endif
+#else
+    #include <time.h>
+#endif
+
+int64_t FrameLimiter_GetSystemTime(void* context)
+{
+    (void)context;
+#if defined(_WIN32)
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    // Split so the multiplication doesn't overflow
+    int64_t seconds = counter.QuadPart / frequency.QuadPart;
+    int64_t remainder = counter.QuadPart % frequency.QuadPart;
+    return seconds * 1000000000 + remainder * 1000000000 / frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+#endif
+}
+
+static void SleepSystem(void* context, int64_t nanoseconds)
+{
+    FrameLimiter* limiter = context;
+#if defined(_WIN32)
+    if (limiter->Timer != NULL)
+    {
+        // Relative due times are negative, in 100 ns units
+        LARGE_INTEGER dueTime = { .QuadPart = -(nanoseconds / 100) };
+        if (SetWaitableTimer(limiter->Timer, &dueTime, 0, NULL, NULL, FALSE))
+        {
+            WaitForSingleObject(limiter->Timer, INFINITE);
+            return;
+        }
+    }
+    Sleep((DWORD)((nanoseconds + 999999) / 1000000));
+#else
+    (void)limiter;
+    struct timespec duration = {
+        .tv_sec = (time_t)(nanoseconds / 1000000000),
+        .tv_nsec = (long)(nanoseconds % 1000000000)
+    };
+    nanosleep(&duration, NULL);
+#endif
+}
+
+bool FrameLimiter_Create(FrameLimiter* limiter, double rate, FrameLimiterClockFunction clock,
+                         FrameLimiterSleepFunction sleep, void* context)
+{
+    memset(limiter, 0, sizeof(*limiter));
+    limiter->Clock = clock != NULL ? clock : FrameLimiter_GetSystemTime;
+    limiter->Sleep = sleep != NULL ? sleep : SleepSystem;
+    limiter->ClockContext = context;
+    limiter->SleepContext = sleep != NULL ? context : limiter;
+#if defined(_WIN32)
+    // Without it the sleeps are only as fine as the system timer, 1 to 15.6 ms
+    if (sleep == NULL)
+        limiter->Timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+    FrameLimiter_SetRate(limiter, rate);
+
+    // Pessimistic until the first sleeps were measured, a slice is expected to take twice as long
+    limiter->SliceMean = FRAME_LIMITER_SLEEP_SLICE;
+    limiter->SliceVariance = 0.25 * FRAME_LIMITER_SLEEP_SLICE * FRAME_LIMITER_SLEEP_SLICE;
+    return limiter->Period > 0;
+}
+
+void FrameLimiter_Destroy(FrameLimiter* limiter)
+{
+#if defined(_WIN32)
+    if (limiter->Timer != NULL)
+        CloseHandle(limiter->Timer);
+#endif
+    memset(limiter, 0, sizeof(*limiter));
+}
+
+void FrameLimiter_SetRate(FrameLimiter* limiter, double rate)
+{
+    limiter->Period = rate > 0.0 ? (int64_t)(1000000000.0 / rate + 0.5) : 0;
+}
+
+void FrameLimiter_Reset(FrameLimiter* limiter)
+{
+    limiter->Deadline = 0;
+}
+
+// Exponentially weighted, the weight of a new slice starts at 1 and settles at
+// 1 / FRAME_LIMITER_ESTIMATE_SLEEPS, so the first ones replace the initial guess
+static void AddSlice(FrameLimiter* limiter, int64_t duration)
+{
+    if (limiter->SliceCount < FRAME_LIMITER_ESTIMATE_SLEEPS)
+        limiter->SliceCount++;
+    double weight = 1.0 / limiter->SliceCount;
+    double deviation = (double)duration - limiter->SliceMean;
+    limiter->SliceMean += weight * deviation;
+    limiter->SliceVariance = (1.0 - weight) * (limiter->SliceVariance + weight * deviation * deviation);
+}
+
+int64_t FrameLimiter_Wait(FrameLimiter* limiter)
+{
+    FrameLimiterCounters* counters = &limiter->Counters;
+    int64_t now = limiter->Clock(limiter->ClockContext);
+    counters->FrameCount++;
+    if (limiter->Deadline == 0)
+    {
+        limiter->Deadline = now + limiter->Period;
+        return now;
+    }
+
+    int64_t deadline = limiter->Deadline;
+    if (now >= deadline)
+        counters->LateCount++;
+    else
+    {
+        int64_t sleepStart = now;
+        for (;;)
+        {
+            double expected = limiter->SliceMean + 2.0 * sqrt(limiter->SliceVariance);
+            if ((double)(deadline - now) <= expected)
+                break;
+            limiter->Sleep(limiter->SleepContext, FRAME_LIMITER_SLEEP_SLICE);
+            int64_t woken = limiter->Clock(limiter->ClockContext);
+            AddSlice(limiter, woken - now);
+            counters->SleepCount++;
+            now = woken;
+        }
+        counters->SleptTime += now - sleepStart;
+        counters->OversleptCount += now > deadline;
+
+        int64_t spinStart = now;
+        while (now < deadline)
+            now = limiter->Clock(limiter->ClockContext);
+        counters->SpunTime += now - spinStart;
+    }
+
+    limiter->Deadline = now - deadline > limiter->Period / 4 ? now + limiter->Period : deadline + limiter->Period;
+    return now;
+}
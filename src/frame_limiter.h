@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sleeps are asked for in slices of this length, their overshoot is what gets estimated
+#define FRAME_LIMITER_SLEEP_SLICE 1000000
+// Sleeps the overshoot estimate is averaged over, older ones fade out
+#define FRAME_LIMITER_ESTIMATE_SLEEPS 256
+
+// Monotonic time in nanoseconds
+typedef int64_t (*FrameLimiterClockFunction)(void* context);
+// Sleeps for at least about the given nanoseconds
+typedef void (*FrameLimiterSleepFunction)(void* context, int64_t nanoseconds);
+
+typedef struct FrameLimiterCounters
+{
+    uint64_t FrameCount;
+    // Frames that only started waiting once their deadline had passed
+    uint64_t LateCount;
+    // Frames the sleeps overshot the deadline for, the estimate was too low
+    uint64_t OversleptCount;
+    uint64_t SleepCount;
+    int64_t SleptTime;
+    int64_t SpunTime;
+} FrameLimiterCounters;
+
+// Caps the frame rate by ending every frame on a deadline one period after the previous one.
+// The OS wakes sleeping threads late by a varying amount, so it sleeps in short slices while
+// the time left exceeds how long one of them is expected to take, and spins the rest. The
+// expected slice is the mean of the recent ones plus two standard deviations.
+typedef struct FrameLimiter
+{
+    FrameLimiterClockFunction Clock;
+    FrameLimiterSleepFunction Sleep;
+    // The caller's context for the functions it gave, the system sleep takes the limiter
+    void* ClockContext;
+    void* SleepContext;
+    // A high resolution waitable timer on Windows, NULL elsewhere or where it isn't supported
+    void* Timer;
+    int64_t Period;
+    // End of the current frame, 0 before the first one
+    int64_t Deadline;
+    // Mean and variance of the slice durations, weighted towards the recent ones
+    double SliceMean;
+    double SliceVariance;
+    uint32_t SliceCount;
+    FrameLimiterCounters Counters;
+} FrameLimiter;
+
+// Takes the clock and the sleep of the system when they're NULL, either one given gets the context
+bool FrameLimiter_Create(FrameLimiter* limiter, double rate, FrameLimiterClockFunction clock,
+                         FrameLimiterSleepFunction sleep, void* context);
+void FrameLimiter_Destroy(FrameLimiter* limiter);
+
+// Takes effect from the next frame on
+void FrameLimiter_SetRate(FrameLimiter* limiter, double rate);
+
+// Waits for the deadline of the frame and returns the time it ended at. The next deadline is a
+// period later, so the next wait makes up for a frame that ended slightly late, but one more
+// than a quarter of a period late starts the cadence over rather than shortening the next ones.
+int64_t FrameLimiter_Wait(FrameLimiter* limiter);
+
+// Forgets the deadline, after a pause the next frame doesn't wait
+void FrameLimiter_Reset(FrameLimiter* limiter);
+
+int64_t FrameLimiter_GetSystemTime(void* context);
@@ -0,0 +1,153 @@
+#include "frame_pipeline.h"
+
+#include <string.h>
+
+#define TRIPLE_BUFFER_FRESH 0x4u
+#define TRIPLE_BUFFER_INDEX_MASK 0x3u
+// Yields before a waiting side goes to sleep
+#define FRAME_PIPELINE_SPIN_COUNT 64
+
+void TripleBuffer_Init(TripleBuffer* buffer, void* slots[TRIPLE_BUFFER_SLOTS])
+{
+    memcpy(buffer->Slots, slots, sizeof(buffer->Slots));
+    buffer->WriteIndex = 0;
+    atomic_init(&buffer->Shared, 1);
+    buffer->ReadIndex = 2;
+}
+
+void* TripleBuffer_GetWriteSlot(TripleBuffer* buffer)
+{
+    return buffer->Slots[buffer->WriteIndex];
+}
+
+void TripleBuffer_Publish(TripleBuffer* buffer)
+{
+    // Releases the writes to the slot and takes back whichever slot was shared
+    unsigned previous = atomic_exchange_explicit(&buffer->Shared, buffer->WriteIndex | TRIPLE_BUFFER_FRESH,
+                                                 memory_order_acq_rel);
+    buffer->WriteIndex = previous & TRIPLE_BUFFER_INDEX_MASK;
+}
+
+bool TripleBuffer_Acquire(TripleBuffer* buffer)
+{
+    if ((atomic_load_explicit(&buffer->Shared, memory_order_relaxed) & TRIPLE_BUFFER_FRESH) == 0)
+        return false;
+
+    unsigned previous = atomic_exchange_explicit(&buffer->Shared, buffer->ReadIndex, memory_order_acq_rel);
+    buffer->ReadIndex = previous & TRIPLE_BUFFER_INDEX_MASK;
+    return true;
+}
+
+void* TripleBuffer_GetReadSlot(TripleBuffer* buffer)
+{
+    return buffer->Slots[buffer->ReadIndex];
+}
+
+bool FramePipeline_Create(FramePipeline* pipeline, void* snapshots[TRIPLE_BUFFER_SLOTS])
+{
+    TripleBuffer_Init(&pipeline->Buffer, snapshots);
+    atomic_init(&pipeline->PublishedFrames, 0);
+    atomic_init(&pipeline->AcquiredFrames, 0);
+    atomic_init(&pipeline->Closed, false);
+    atomic_init(&pipeline->Waiters, 0);
+
+    if (mtx_init(&pipeline->Mutex, mtx_plain) != thrd_success)
+        return false;
+    if (cnd_init(&pipeline->Condition) != thrd_success)
+    {
+        mtx_destroy(&pipeline->Mutex);
+        return false;
+    }
+    return true;
+}
+
+void FramePipeline_Destroy(FramePipeline* pipeline)
+{
+    cnd_destroy(&pipeline->Condition);
+    mtx_destroy(&pipeline->Mutex);
+}
+
+static void Notify(FramePipeline* pipeline)
+{
+    if (atomic_load(&pipeline->Waiters) > 0)
+    {
+        mtx_lock(&pipeline->Mutex);
+        cnd_broadcast(&pipeline->Condition);
+        mtx_unlock(&pipeline->Mutex);
+    }
+}
+
+// The waiter is counted before the condition is checked again under the lock, so the other
+// side either sees it and wakes it or changed the state before the check
+static void SleepUntil(FramePipeline* pipeline, bool (*isReady)(FramePipeline*))
+{
+    mtx_lock(&pipeline->Mutex);
+    atomic_fetch_add(&pipeline->Waiters, 1);
+    if (!isReady(pipeline))
+        cnd_wait(&pipeline->Condition, &pipeline->Mutex);
+    atomic_fetch_sub(&pipeline->Waiters, 1);
+    mtx_unlock(&pipeline->Mutex);
+}
+
+static bool IsPreviousFrameTaken(FramePipeline* pipeline)
+{
+    return atomic_load(&pipeline->Closed) ||
+           atomic_load(&pipeline->AcquiredFrames) == atomic_load(&pipeline->PublishedFrames);
+}
+
+static bool IsFrameAvailable(FramePipeline* pipeline)
+{
+    return atomic_load(&pipeline->Closed) ||
+           atomic_load(&pipeline->AcquiredFrames) != atomic_load(&pipeline->PublishedFrames);
+}
+
+void* FramePipeline_BeginFrame(FramePipeline* pipeline)
+{
+    return TripleBuffer_GetWriteSlot(&pipeline->Buffer);
+}
+
+bool FramePipeline_Publish(FramePipeline* pipeline)
+{
+    for (int spin = 0; !IsPreviousFrameTaken(pipeline); ++spin)
+    {
+        if (spin < FRAME_PIPELINE_SPIN_COUNT)
+            thrd_yield();
+        else
+            SleepUntil(pipeline, IsPreviousFrameTaken);
+    }
+
+    if (atomic_load(&pipeline->Closed))
+        return false;
+
+    TripleBuffer_Publish(&pipeline->Buffer);
+    atomic_fetch_add(&pipeline->PublishedFrames, 1);
+    Notify(pipeline);
+    return true;
+}
+
+void* FramePipeline_Acquire(FramePipeline* pipeline)
+{
+    for (int spin = 0; !IsFrameAvailable(pipeline); ++spin)
+    {
+        if (spin < FRAME_PIPELINE_SPIN_COUNT)
+            thrd_yield();
+        else
+            SleepUntil(pipeline, IsFrameAvailable);
+    }
+
+    // A frame published before the close is still rendered
+    if (!TripleBuffer_Acquire(&pipeline->Buffer))
+        return NULL;
+
+    atomic_fetch_add(&pipeline->AcquiredFrames, 1);
+    Notify(pipeline);
+    return TripleBuffer_GetReadSlot(&pipeline->Buffer);
+}
+
+void FramePipeline_Close(FramePipeline* pipeline)
+{
+    mtx_lock(&pipeline->Mutex);
+    atomic_store(&pipeline->Closed, true);
+    cnd_broadcast(&pipeline->Condition);
+    mtx_unlock(&pipeline->Mutex);
+}
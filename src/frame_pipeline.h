@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+#define TRIPLE_BUFFER_SLOTS 3
+
+// Lock-free single producer, single consumer triple buffer. The producer fills its slot and
+// swaps it with the shared one, the consumer swaps its slot with the shared one when that holds
+// something newer. Neither side ever waits for the other or sees a slot being written.
+typedef struct TripleBuffer
+{
+    void* Slots[TRIPLE_BUFFER_SLOTS];
+    // Only touched by their own side
+    uint32_t WriteIndex;
+    uint32_t ReadIndex;
+    // Index of the shared slot, with TRIPLE_BUFFER_FRESH set while the consumer hasn't taken it
+    atomic_uint Shared;
+} TripleBuffer;
+
+void TripleBuffer_Init(TripleBuffer* buffer, void* slots[TRIPLE_BUFFER_SLOTS]);
+
+void* TripleBuffer_GetWriteSlot(TripleBuffer* buffer);
+void TripleBuffer_Publish(TripleBuffer* buffer);
+
+// Returns true when a newer slot was published since the last call, it becomes the read slot
+bool TripleBuffer_Acquire(TripleBuffer* buffer);
+void* TripleBuffer_GetReadSlot(TripleBuffer* buffer);
+
+// Hands frame snapshots from a simulation thread to a render thread through a triple buffer.
+// The simulation runs at most one frame ahead: it fills the next snapshot while the previous
+// one is rendered, and publishes it once the render thread has taken the previous one, so no
+// frame is skipped. Waits spin briefly, then sleep.
+typedef struct FramePipeline
+{
+    TripleBuffer Buffer;
+    atomic_ullong PublishedFrames;
+    atomic_ullong AcquiredFrames;
+    atomic_bool Closed;
+
+    mtx_t Mutex;
+    cnd_t Condition;
+    atomic_uint Waiters;
+} FramePipeline;
+
+bool FramePipeline_Create(FramePipeline* pipeline, void* snapshots[TRIPLE_BUFFER_SLOTS]);
+void FramePipeline_Destroy(FramePipeline* pipeline);
+
+// Snapshot for the simulation to fill, only valid until the next publish
+void* FramePipeline_BeginFrame(FramePipeline* pipeline);
+
+// Waits until the render thread took the previous snapshot, then publishes the filled one.
+// Returns false once the pipeline is closed.
+bool FramePipeline_Publish(FramePipeline* pipeline);
+
+// Waits for the next snapshot, which stays valid and unchanged until the next acquire.
+// Returns NULL once the pipeline is closed.
+void* FramePipeline_Acquire(FramePipeline* pipeline);
+
+// Wakes both sides, the pending publish and acquire return right away
+void FramePipeline_Close(FramePipeline* pipeline);
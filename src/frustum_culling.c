@@ -0,0 +1,428 @@
+#include "frustum_culling.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <math.h>
+#include <string.h>
+
+// Bounds per culling chunk, a chunk compacts its results in place
+#define CULLING_CHUNK_SIZE 4096
+#define CULLING_MAX_CHUNKS 1024
+#define TRANSFORM_GRAIN 1024
+#define BOUNDS_ALIGNMENT 32
+
+typedef struct CullingTaskData
+{
+    const Frustum* Frustum;
+    const void* Bounds;
+    uint32_t* Visible;
+    size_t ChunkSize;
+    size_t Count;
+    size_t ChunkCounts[CULLING_MAX_CHUNKS];
+} CullingTaskData;
+
+typedef struct TransformTaskData
+{
+    SphereBounds* Bounds;
+    mat4* WorldMatrices;
+    float* Center;
+    float Radius;
+} TransformTaskData;
+
+void Frustum_FromViewProjection(Frustum* frustum, mat4 viewProjection)
+{
+    // Rows of the column-major matrix
+    vec4 rows[4];
+    for (int r = 0; r < 4; ++r)
+    {
+        for (int c = 0; c < 4; ++c)
+            rows[r][c] = viewProjection[c][r];
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            frustum->Planes[i * 2 + 0][c] = rows[3][c] + rows[i][c];
+            frustum->Planes[i * 2 + 1][c] = rows[3][c] - rows[i][c];
+        }
+    }
+
+    for (int i = 0; i < 6; ++i)
+    {
+        float* plane = frustum->Planes[i];
+        float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f)
+        {
+            for (int c = 0; c < 4; ++c)
+                plane[c] /= length;
+        }
+    }
+}
+
+// One aligned block split into arrayCount arrays
+static float* AllocateArrays(size_t capacity, size_t arrayCount, float** arrays)
+{
+    float* block = AlignedAlloc(capacity * arrayCount * sizeof(float), BOUNDS_ALIGNMENT);
+    if (block == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < arrayCount; ++i)
+        arrays[i] = block + capacity * i;
+    return block;
+}
+
+static size_t RoundCapacity(size_t count)
+{
+    return (count + 7) & ~(size_t)7;
+}
+
+bool SphereBounds_Resize(SphereBounds* bounds, size_t count)
+{
+    if (count > bounds->Capacity)
+    {
+        size_t capacity = RoundCapacity(count);
+        float* arrays[4];
+        if (AllocateArrays(capacity, 4, arrays) == NULL)
+            return false;
+
+        SphereBounds_Release(bounds);
+        bounds->X = arrays[0];
+        bounds->Y = arrays[1];
+        bounds->Z = arrays[2];
+        bounds->Radius = arrays[3];
+        bounds->Capacity = capacity;
+    }
+
+    bounds->Count = count;
+    return true;
+}
+
+void SphereBounds_Release(SphereBounds* bounds)
+{
+    AlignedFree(bounds->X);
+    memset(bounds, 0, sizeof(*bounds));
+}
+
+bool AabbBounds_Resize(AabbBounds* bounds, size_t count)
+{
+    if (count > bounds->Capacity)
+    {
+        size_t capacity = RoundCapacity(count);
+        float* arrays[6];
+        if (AllocateArrays(capacity, 6, arrays) == NULL)
+            return false;
+
+        AabbBounds_Release(bounds);
+        bounds->CenterX = arrays[0];
+        bounds->CenterY = arrays[1];
+        bounds->CenterZ = arrays[2];
+        bounds->ExtentX = arrays[3];
+        bounds->ExtentY = arrays[4];
+        bounds->ExtentZ = arrays[5];
+        bounds->Capacity = capacity;
+    }
+
+    bounds->Count = count;
+    return true;
+}
+
+void AabbBounds_Release(AabbBounds* bounds)
+{
+    AlignedFree(bounds->CenterX);
+    memset(bounds, 0, sizeof(*bounds));
+}
+
+static void TransformSpheresTask(void* userData, size_t begin, size_t end)
+{
+    TransformTaskData* data = userData;
+    SphereBounds* bounds = data->Bounds;
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        vec4* world = data->WorldMatrices[i];
+        vec3 center;
+        glm_mat4_mulv3(world, data->Center, 1.0f, center);
+
+        float scale = fmaxf(glm_vec3_norm(world[0]), fmaxf(glm_vec3_norm(world[1]), glm_vec3_norm(world[2])));
+        bounds->X[i] = center[0];
+        bounds->Y[i] = center[1];
+        bounds->Z[i] = center[2];
+        bounds->Radius[i] = data->Radius * scale;
+    }
+}
+
+void TransformSphereBounds(SphereBounds* bounds, mat4* worldMatrices, size_t count, vec3 center, float radius)
+{
+    TransformTaskData data = { bounds, worldMatrices, center, radius };
+    ParallelFor(count < bounds->Count ? count : bounds->Count, TRANSFORM_GRAIN, TransformSpheresTask, &data);
+}
+
+static bool IsSphereVisible(const Frustum* frustum, float x, float y, float z, float radius)
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = frustum->Planes[p];
+        if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius)
+            return false;
+    }
+    return true;
+}
+
+static bool IsAabbVisible(const Frustum* frustum, float cx, float cy, float cz, float ex, float ey, float ez)
+{
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = frustum->Planes[p];
+        float distance = plane[0] * cx + plane[1] * cy + plane[2] * cz + plane[3];
+        float projectedExtent = fabsf(plane[0]) * ex + fabsf(plane[1]) * ey + fabsf(plane[2]) * ez;
+        if (distance < -projectedExtent)
+            return false;
+    }
+    return true;
+}
+
+// The indices are written unconditionally and the cursor only advances for visible lanes.
+// A lane never writes past its own element index, so chunks compact in place without racing.
+#define APPEND_VISIBLE_LANES(visible, n, base, mask, laneCount) \
+    for (int lane = 0; lane < (laneCount); ++lane)              \
+    {                                                           \
+        (visible)[n] = (uint32_t)((base) + lane);               \
+        (n) += ((mask) >> lane) & 1;                            \
+    }
+
+static size_t CullSpheresRange(const Frustum* frustum, const SphereBounds* bounds,
+                               size_t begin, size_t end, uint32_t* visible)
+{
+    size_t n = 0;
+    size_t i = begin;
+
+#if defined(HD_AVX2)
+    __m256 planes[6][4];
+    for (int p = 0; p < 6; ++p)
+        for (int c = 0; c < 4; ++c)
+            planes[p][c] = _mm256_set1_ps(frustum->Planes[p][c]);
+
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(bounds->X + i);
+        __m256 y = _mm256_loadu_ps(bounds->Y + i);
+        __m256 z = _mm256_loadu_ps(bounds->Z + i);
+        __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(bounds->Radius + i));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 distance = _mm256_fmadd_ps(planes[p][0], x,
+                              _mm256_fmadd_ps(planes[p][1], y,
+                              _mm256_fmadd_ps(planes[p][2], z, planes[p][3])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        APPEND_VISIBLE_LANES(visible, n, i, mask, 8);
+    }
+#endif
+
+#if defined(HD_SSE2)
+    __m128 planes4[6][4];
+    for (int p = 0; p < 6; ++p)
+        for (int c = 0; c < 4; ++c)
+            planes4[p][c] = _mm_set1_ps(frustum->Planes[p][c]);
+
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(bounds->X + i);
+        __m128 y = _mm_loadu_ps(bounds->Y + i);
+        __m128 z = _mm_loadu_ps(bounds->Z + i);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(bounds->Radius + i));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes4[p][0], x), _mm_mul_ps(planes4[p][1], y)),
+                                         _mm_add_ps(_mm_mul_ps(planes4[p][2], z), planes4[p][3]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        APPEND_VISIBLE_LANES(visible, n, i, mask, 4);
+    }
+#endif
+
+    for (; i < end; ++i)
+    {
+        if (IsSphereVisible(frustum, bounds->X[i], bounds->Y[i], bounds->Z[i], bounds->Radius[i]))
+            visible[n++] = (uint32_t)i;
+    }
+
+    return n;
+}
+
+static size_t CullAabbsRange(const Frustum* frustum, const AabbBounds* bounds,
+                             size_t begin, size_t end, uint32_t* visible)
+{
+    size_t n = 0;
+    size_t i = begin;
+
+#if defined(HD_AVX2)
+    __m256 planes[6][4];
+    __m256 absoluteNormals[6][3];
+    for (int p = 0; p < 6; ++p)
+    {
+        for (int c = 0; c < 4; ++c)
+            planes[p][c] = _mm256_set1_ps(frustum->Planes[p][c]);
+        for (int c = 0; c < 3; ++c)
+            absoluteNormals[p][c] = _mm256_set1_ps(fabsf(frustum->Planes[p][c]));
+    }
+
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(bounds->CenterX + i);
+        __m256 cy = _mm256_loadu_ps(bounds->CenterY + i);
+        __m256 cz = _mm256_loadu_ps(bounds->CenterZ + i);
+        __m256 ex = _mm256_loadu_ps(bounds->ExtentX + i);
+        __m256 ey = _mm256_loadu_ps(bounds->ExtentY + i);
+        __m256 ez = _mm256_loadu_ps(bounds->ExtentZ + i);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 distance = _mm256_fmadd_ps(planes[p][0], cx,
+                              _mm256_fmadd_ps(planes[p][1], cy,
+                              _mm256_fmadd_ps(planes[p][2], cz, planes[p][3])));
+            __m256 projectedExtent = _mm256_fmadd_ps(absoluteNormals[p][0], ex,
+                                     _mm256_fmadd_ps(absoluteNormals[p][1], ey,
+                                     _mm256_mul_ps(absoluteNormals[p][2], ez)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, projectedExtent),
+                                                         _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        APPEND_VISIBLE_LANES(visible, n, i, mask, 8);
+    }
+#endif
+
+#if defined(HD_SSE2)
+    __m128 planes4[6][4];
+    __m128 absoluteNormals4[6][3];
+    for (int p = 0; p < 6; ++p)
+    {
+        for (int c = 0; c < 4; ++c)
+            planes4[p][c] = _mm_set1_ps(frustum->Planes[p][c]);
+        for (int c = 0; c < 3; ++c)
+            absoluteNormals4[p][c] = _mm_set1_ps(fabsf(frustum->Planes[p][c]));
+    }
+
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(bounds->CenterX + i);
+        __m128 cy = _mm_loadu_ps(bounds->CenterY + i);
+        __m128 cz = _mm_loadu_ps(bounds->CenterZ + i);
+        __m128 ex = _mm_loadu_ps(bounds->ExtentX + i);
+        __m128 ey = _mm_loadu_ps(bounds->ExtentY + i);
+        __m128 ez = _mm_loadu_ps(bounds->ExtentZ + i);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes4[p][0], cx), _mm_mul_ps(planes4[p][1], cy)),
+                                         _mm_add_ps(_mm_mul_ps(planes4[p][2], cz), planes4[p][3]));
+            __m128 projectedExtent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absoluteNormals4[p][0], ex),
+                                                           _mm_mul_ps(absoluteNormals4[p][1], ey)),
+                                                _mm_mul_ps(absoluteNormals4[p][2], ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, projectedExtent), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        APPEND_VISIBLE_LANES(visible, n, i, mask, 4);
+    }
+#endif
+
+    for (; i < end; ++i)
+    {
+        if (IsAabbVisible(frustum, bounds->CenterX[i], bounds->CenterY[i], bounds->CenterZ[i],
+                          bounds->ExtentX[i], bounds->ExtentY[i], bounds->ExtentZ[i]))
+            visible[n++] = (uint32_t)i;
+    }
+
+    return n;
+}
+
+static void CullSpheresTask(void* userData, size_t begin, size_t end)
+{
+    CullingTaskData* data = userData;
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+        size_t first = chunk * data->ChunkSize;
+        size_t last = first + data->ChunkSize < data->Count ? first + data->ChunkSize : data->Count;
+        data->ChunkCounts[chunk] = CullSpheresRange(data->Frustum, data->Bounds, first, last, data->Visible + first);
+    }
+}
+
+static void CullAabbsTask(void* userData, size_t begin, size_t end)
+{
+    CullingTaskData* data = userData;
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+        size_t first = chunk * data->ChunkSize;
+        size_t last = first + data->ChunkSize < data->Count ? first + data->ChunkSize : data->Count;
+        data->ChunkCounts[chunk] = CullAabbsRange(data->Frustum, data->Bounds, first, last, data->Visible + first);
+    }
+}
+
+static size_t CullParallel(CullingTaskData* data, ParallelForTask task)
+{
+    size_t chunkSize = (data->Count + CULLING_MAX_CHUNKS - 1) / CULLING_MAX_CHUNKS;
+    data->ChunkSize = chunkSize > CULLING_CHUNK_SIZE ? chunkSize : CULLING_CHUNK_SIZE;
+    size_t chunkCount = (data->Count + data->ChunkSize - 1) / data->ChunkSize;
+
+    ParallelFor(chunkCount, 1, task, data);
+
+    // Every chunk compacted into its own region, close the gaps in order
+    size_t visibleCount = 0;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        uint32_t* source = data->Visible + chunk * data->ChunkSize;
+        if (source != data->Visible + visibleCount)
+            memmove(data->Visible + visibleCount, source, data->ChunkCounts[chunk] * sizeof(uint32_t));
+        visibleCount += data->ChunkCounts[chunk];
+    }
+
+    return visibleCount;
+}
+
+size_t FrustumCullSpheres(const Frustum* frustum, const SphereBounds* bounds, uint32_t* visible)
+{
+    CullingTaskData data = { .Frustum = frustum, .Bounds = bounds, .Visible = visible, .Count = bounds->Count };
+    return CullParallel(&data, CullSpheresTask);
+}
+
+size_t FrustumCullAabbs(const Frustum* frustum, const AabbBounds* bounds, uint32_t* visible)
+{
+    CullingTaskData data = { .Frustum = frustum, .Bounds = bounds, .Visible = visible, .Count = bounds->Count };
+    return CullParallel(&data, CullAabbsTask);
+}
+
+size_t FrustumCullSpheresScalar(const Frustum* frustum, const SphereBounds* bounds, uint32_t* visible)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < bounds->Count; ++i)
+    {
+        if (IsSphereVisible(frustum, bounds->X[i], bounds->Y[i], bounds->Z[i], bounds->Radius[i]))
+            visible[n++] = (uint32_t)i;
+    }
+    return n;
+}
+
+size_t FrustumCullAabbsScalar(const Frustum* frustum, const AabbBounds* bounds, uint32_t* visible)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < bounds->Count; ++i)
+    {
+        if (IsAabbVisible(frustum, bounds->CenterX[i], bounds->CenterY[i], bounds->CenterZ[i],
+                          bounds->ExtentX[i], bounds->ExtentY[i], bounds->ExtentZ[i]))
+            visible[n++] = (uint32_t)i;
+    }
+    return n;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+// Planes as (normal, distance), a point is inside when dot(normal, p) + distance >= 0
+typedef struct Frustum
+{
+    vec4 Planes[6];
+} Frustum;
+
+// Bounding spheres in structure-of-arrays form
+typedef struct SphereBounds
+{
+    float* X;
+    float* Y;
+    float* Z;
+    float* Radius;
+    size_t Count;
+    size_t Capacity;
+} SphereBounds;
+
+// Axis aligned boxes as center and half extent, structure-of-arrays
+typedef struct AabbBounds
+{
+    float* CenterX;
+    float* CenterY;
+    float* CenterZ;
+    float* ExtentX;
+    float* ExtentY;
+    float* ExtentZ;
+    size_t Count;
+    size_t Capacity;
+} AabbBounds;
+
+// Gribb-Hartmann extraction, assumes cglm's default [-1, 1] clip depth. For a [0, 1]
+// projection the near plane ends up slightly behind the real one, which stays conservative.
+void Frustum_FromViewProjection(Frustum* frustum, mat4 viewProjection);
+
+bool SphereBounds_Resize(SphereBounds* bounds, size_t count);
+void SphereBounds_Release(SphereBounds* bounds);
+bool AabbBounds_Resize(AabbBounds* bounds, size_t count);
+void AabbBounds_Release(AabbBounds* bounds);
+
+// Moves one object space sphere by each world matrix, the radius follows the largest axis scale
+void TransformSphereBounds(SphereBounds* bounds, mat4* worldMatrices, size_t count, vec3 center, float radius);
+
+// Write the indices of the intersecting bounds to visible in ascending order and return their
+// number. visible must hold bounds->Count entries. The work is split across the workers,
+// each chunk is tested 8 (AVX) or 4 (SSE) bounds at a time.
+size_t FrustumCullSpheres(const Frustum* frustum, const SphereBounds* bounds, uint32_t* visible);
+size_t FrustumCullAabbs(const Frustum* frustum, const AabbBounds* bounds, uint32_t* visible);
+
+// Single threaded scalar references
+size_t FrustumCullSpheresScalar(const Frustum* frustum, const SphereBounds* bounds, uint32_t* visible);
+size_t FrustumCullAabbsScalar(const Frustum* frustum, const AabbBounds* bounds, uint32_t* visible);
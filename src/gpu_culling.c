@@ -0,0 +1,98 @@
+#include "gpu_culling.h"
+
+#include <math.h>
+#include <string.h>
+
+// The shaders evaluate the same expressions as precise, fused multiply-adds would round
+// differently and break the bit for bit comparison
+#if defined(__clang__)
+    #pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+    #pragma GCC optimize("fp-contract=off")
+#endif
+
+void GpuCullConstants_Init(GpuCullConstants* constants, const Frustum* frustum, mat4 view,
+                           float projectionScale, float pixelThreshold, const LodChain* lods,
+                           uint32_t instanceCount)
+{
+    memset(constants, 0, sizeof(*constants));
+    memcpy(constants->Planes, frustum->Planes, sizeof(constants->Planes));
+    for (int c = 0; c < 4; ++c)
+        constants->ViewDepthRow[c] = view[c][2];
+
+    constants->ProjectionScale = projectionScale;
+    constants->PixelThreshold = pixelThreshold;
+    constants->InstanceCount = instanceCount;
+    constants->LevelCount = lods->LevelCount;
+    for (uint32_t i = 0; i < lods->LevelCount; ++i)
+    {
+        constants->Levels[i].IndexOffset = lods->Levels[i].IndexOffset;
+        constants->Levels[i].IndexCount = lods->Levels[i].IndexCount;
+        constants->Levels[i].ErrorScale = lods->Radius > 0.0f ? lods->Levels[i].Error / lods->Radius : 0.0f;
+    }
+}
+
+uint32_t GpuCulling_GetGroupCount(uint32_t instanceCount)
+{
+    return (instanceCount + GPU_CULLING_GROUP_SIZE - 1) / GPU_CULLING_GROUP_SIZE;
+}
+
+// Mirrors CullInstance in shaders/gpu_culling.hlsli, returns the level of detail plus one
+// or 0 when the instance is outside the frustum
+static uint32_t CullInstance(const GpuCullConstants* constants, const float* bounds)
+{
+    float x = bounds[0];
+    float y = bounds[1];
+    float z = bounds[2];
+    float radius = bounds[3];
+
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = constants->Planes[p];
+        float distance = ((plane[0] * x + plane[1] * y) + plane[2] * z) + plane[3];
+        if (distance < -radius)
+            return 0;
+    }
+
+    // Same selection as SelectLod, with the division moved to the other side
+    const float* row = constants->ViewDepthRow;
+    float viewDepth = ((row[0] * x + row[1] * y) + row[2] * z) + row[3];
+    float depth = fmaxf(viewDepth - radius, GPU_CULLING_MIN_DEPTH);
+    float limit = constants->PixelThreshold * depth;
+
+    uint32_t level = 0;
+    for (uint32_t i = 1; i < constants->LevelCount; ++i)
+    {
+        if ((constants->Levels[i].ErrorScale * radius) * constants->ProjectionScale > limit)
+            break;
+        level = i;
+    }
+
+    return level + 1;
+}
+
+uint32_t GpuCullReference(const GpuCullConstants* constants, const GpuCullInstance* instances,
+                          GpuDrawCommand* commands)
+{
+    // The shaders compact through per group prefix sums, which keeps the instance order
+    uint32_t drawCount = 0;
+    for (uint32_t i = 0; i < constants->InstanceCount; ++i)
+    {
+        uint32_t visibility = CullInstance(constants, instances[i].Bounds);
+        if (visibility == 0)
+            continue;
+
+        const GpuLodLevel* level = &constants->Levels[visibility - 1];
+        GpuDrawCommand* command = &commands[drawCount++];
+        memcpy(command->Mvp, instances[i].Mvp, sizeof(command->Mvp));
+        command->Draw = (DrawIndexedArguments){
+            .IndexCountPerInstance = level->IndexCount,
+            .InstanceCount = 1,
+            .StartIndexLocation = level->IndexOffset,
+            .BaseVertexLocation = 0,
+            .StartInstanceLocation = 0
+        };
+    }
+
+    return drawCount;
+}
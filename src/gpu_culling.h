@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+#include "frustum_culling.h"
+#include "mesh_simplifier.h"
+
+// Keep in sync with shaders/gpu_culling.hlsli
+#define GPU_CULLING_GROUP_SIZE 64
+#define GPU_CULLING_SCAN_THREADS 256
+#define GPU_CULLING_MIN_DEPTH 1e-3f
+
+// Layout of D3D12_DRAW_INDEXED_ARGUMENTS
+typedef struct DrawIndexedArguments
+{
+    uint32_t IndexCountPerInstance;
+    uint32_t InstanceCount;
+    uint32_t StartIndexLocation;
+    int32_t BaseVertexLocation;
+    uint32_t StartInstanceLocation;
+} DrawIndexedArguments;
+
+// One ExecuteIndirect command, the MVP root constants followed by the draw
+typedef struct GpuDrawCommand
+{
+    float Mvp[16];
+    DrawIndexedArguments Draw;
+} GpuDrawCommand;
+
+typedef struct GpuCullInstance
+{
+    float Mvp[16];
+    // World space bounding sphere as center and radius
+    float Bounds[4];
+} GpuCullInstance;
+
+typedef struct GpuLodLevel
+{
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    // Error of the level relative to the bounding sphere radius
+    float ErrorScale;
+    uint32_t Padding;
+} GpuLodLevel;
+
+// Constant buffer of the culling passes, laid out in 16 byte rows like HLSL packs it
+typedef struct GpuCullConstants
+{
+    float Planes[6][4];
+    // Third row of the view matrix, its dot product with a point gives the view depth
+    float ViewDepthRow[4];
+    float ProjectionScale;
+    float PixelThreshold;
+    uint32_t InstanceCount;
+    uint32_t LevelCount;
+    GpuLodLevel Levels[LOD_MAX_LEVELS];
+} GpuCullConstants;
+
+// projectionScale is projection[1][1] * viewport height / 2 as in SelectLod
+void GpuCullConstants_Init(GpuCullConstants* constants, const Frustum* frustum, mat4 view,
+                           float projectionScale, float pixelThreshold, const LodChain* lods,
+                           uint32_t instanceCount);
+
+// Thread groups dispatched by the culling and compaction passes
+uint32_t GpuCulling_GetGroupCount(uint32_t instanceCount);
+
+// CPU reference of the three compute passes. Culls the instances against the frustum, picks
+// their level of detail and writes the draws of the visible ones in instance order, returning
+// their number. Rounds like the shaders do so both outputs can be compared bit for bit.
+uint32_t GpuCullReference(const GpuCullConstants* constants, const GpuCullInstance* instances,
+                          GpuDrawCommand* commands);
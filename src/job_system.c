@@ -0,0 +1,452 @@
+#include "job_system.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <string.h>
+#include <threads.h>
+
+#define JOB_MAX_THREADS 65
+// Threads created elsewhere that can take part, such as the render thread
+#define JOB_MAX_ATTACHED_THREADS 4
+// Jobs a thread can have queued at once, a power of two
+#define JOB_DEQUE_CAPACITY 4096
+// Rounds over the other deques before an idle worker goes to sleep
+#define JOB_IDLE_ROUNDS 64
+#define CACHE_LINE_SIZE 64
+
+typedef struct Job
+{
+    JobFunction Function;
+    void* UserData;
+    JobCounter* Counter;
+} Job;
+
+// A thief reads the slot before it knows whether it won it, while the owner may already be
+// refilling it. The fields are atomics so that read is merely discarded.
+typedef struct JobSlot
+{
+    _Atomic(JobFunction) Function;
+    _Atomic(void*) UserData;
+    _Atomic(JobCounter*) Counter;
+} JobSlot;
+
+// Chase-Lev deque, the owner pushes and takes at the bottom and the other threads steal from
+// the top. Le et al. order it with fences, sequentially consistent accesses to the indices give
+// the same guarantees and are what thread sanitizers understand.
+typedef struct JobDeque
+{
+    atomic_llong Top;
+    char TopPadding[CACHE_LINE_SIZE - sizeof(atomic_llong)];
+    atomic_llong Bottom;
+    char BottomPadding[CACHE_LINE_SIZE - sizeof(atomic_llong)];
+    JobSlot Slots[JOB_DEQUE_CAPACITY];
+
+    // Only touched by the owner
+    uint32_t RandomState;
+} JobDeque;
+
+typedef struct PinnedQueue
+{
+    mtx_t Mutex;
+    Job* Jobs;
+    size_t Count;
+    size_t Capacity;
+} PinnedQueue;
+
+typedef struct JobSystem
+{
+    thrd_t Workers[JOB_MAX_THREADS];
+    uint32_t WorkerCount;
+    // Deques, one per worker, the main thread's and the ones reserved for attached threads
+    uint32_t ThreadCount;
+    uint32_t FirstAttachedIndex;
+    // Bit per reserved deque in use by an attached thread
+    atomic_uint AttachedMask;
+    JobDeque* Deques;
+    PinnedQueue Pinned;
+
+    // Idle workers sleep until a push bumps the generation
+    mtx_t SleepMutex;
+    cnd_t WakeCondition;
+    atomic_uint Generation;
+    atomic_uint SleepingWorkers;
+    atomic_bool Quit;
+} JobSystem;
+
+static JobSystem g_Jobs;
+static _Thread_local uint32_t t_ThreadIndex = UINT32_MAX;
+
+static void WriteSlot(JobSlot* slot, const Job* job)
+{
+    atomic_store_explicit(&slot->Function, job->Function, memory_order_relaxed);
+    atomic_store_explicit(&slot->UserData, job->UserData, memory_order_relaxed);
+    atomic_store_explicit(&slot->Counter, job->Counter, memory_order_relaxed);
+}
+
+static void ReadSlot(JobSlot* slot, Job* job)
+{
+    job->Function = atomic_load_explicit(&slot->Function, memory_order_relaxed);
+    job->UserData = atomic_load_explicit(&slot->UserData, memory_order_relaxed);
+    job->Counter = atomic_load_explicit(&slot->Counter, memory_order_relaxed);
+}
+
+static bool Deque_Push(JobDeque* deque, const Job* job)
+{
+    long long bottom = atomic_load_explicit(&deque->Bottom, memory_order_relaxed);
+    long long top = atomic_load_explicit(&deque->Top, memory_order_acquire);
+    if (bottom - top >= JOB_DEQUE_CAPACITY)
+        return false;
+
+    WriteSlot(&deque->Slots[bottom & (JOB_DEQUE_CAPACITY - 1)], job);
+    atomic_store_explicit(&deque->Bottom, bottom + 1, memory_order_release);
+    return true;
+}
+
+static bool Deque_Take(JobDeque* deque, Job* job)
+{
+    // The store of the claimed bottom must be visible before top is read
+    long long bottom = atomic_load_explicit(&deque->Bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->Bottom, bottom, memory_order_seq_cst);
+    long long top = atomic_load_explicit(&deque->Top, memory_order_seq_cst);
+
+    if (top > bottom)
+    {
+        atomic_store_explicit(&deque->Bottom, bottom + 1, memory_order_relaxed);
+        return false;
+    }
+
+    ReadSlot(&deque->Slots[bottom & (JOB_DEQUE_CAPACITY - 1)], job);
+    if (top == bottom)
+    {
+        // Last job, race the thieves for it
+        bool won = atomic_compare_exchange_strong_explicit(&deque->Top, &top, top + 1,
+                                                           memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&deque->Bottom, bottom + 1, memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+static bool Deque_Steal(JobDeque* deque, Job* job)
+{
+    long long top = atomic_load_explicit(&deque->Top, memory_order_seq_cst);
+    long long bottom = atomic_load_explicit(&deque->Bottom, memory_order_seq_cst);
+    if (top >= bottom)
+        return false;
+
+    ReadSlot(&deque->Slots[top & (JOB_DEQUE_CAPACITY - 1)], job);
+    return atomic_compare_exchange_strong_explicit(&deque->Top, &top, top + 1,
+                                                   memory_order_seq_cst, memory_order_relaxed);
+}
+
+static void Execute(const Job* job)
+{
+    job->Function(job->UserData);
+    if (job->Counter != NULL)
+        atomic_fetch_sub_explicit(&job->Counter->Pending, 1, memory_order_release);
+}
+
+static uint32_t NextRandom(JobDeque* deque)
+{
+    // xorshift32
+    uint32_t x = deque->RandomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    deque->RandomState = x;
+    return x;
+}
+
+static bool RunPinnedJob(void)
+{
+    Job job;
+    mtx_lock(&g_Jobs.Pinned.Mutex);
+    bool found = g_Jobs.Pinned.Count > 0;
+    if (found)
+    {
+        // Oldest first, the queue is short
+        job = g_Jobs.Pinned.Jobs[0];
+        memmove(g_Jobs.Pinned.Jobs, g_Jobs.Pinned.Jobs + 1, --g_Jobs.Pinned.Count * sizeof(Job));
+    }
+    mtx_unlock(&g_Jobs.Pinned.Mutex);
+
+    if (found)
+        Execute(&job);
+    return found;
+}
+
+// Runs a job of the own deque or one stolen from a random other thread
+static bool RunOneJob(uint32_t threadIndex)
+{
+    JobDeque* deque = &g_Jobs.Deques[threadIndex];
+    Job job;
+    bool found = Deque_Take(deque, &job);
+    if (!found && g_Jobs.ThreadCount > 1)
+    {
+        uint32_t first = NextRandom(deque) % g_Jobs.ThreadCount;
+        for (uint32_t i = 0; i < g_Jobs.ThreadCount && !found; ++i)
+        {
+            uint32_t victim = (first + i) % g_Jobs.ThreadCount;
+            if (victim != threadIndex)
+                found = Deque_Steal(&g_Jobs.Deques[victim], &job);
+        }
+    }
+
+    if (!found)
+        return false;
+
+    Execute(&job);
+    return true;
+}
+
+static void WakeWorkers(void)
+{
+    atomic_fetch_add(&g_Jobs.Generation, 1);
+    if (atomic_load(&g_Jobs.SleepingWorkers) > 0)
+    {
+        mtx_lock(&g_Jobs.SleepMutex);
+        cnd_broadcast(&g_Jobs.WakeCondition);
+        mtx_unlock(&g_Jobs.SleepMutex);
+    }
+}
+
+static int WorkerMain(void* argument)
+{
+    uint32_t threadIndex = (uint32_t)(uintptr_t)argument;
+    t_ThreadIndex = threadIndex;
+
+    while (!atomic_load(&g_Jobs.Quit))
+    {
+        unsigned generation = atomic_load(&g_Jobs.Generation);
+
+        bool ranJob = false;
+        for (int round = 0; round < JOB_IDLE_ROUNDS && !ranJob; ++round)
+        {
+            ranJob = RunOneJob(threadIndex);
+            if (!ranJob)
+                thrd_yield();
+        }
+        if (ranJob)
+            continue;
+
+        // Announced before the generation is checked again, so a push either sees the sleeper
+        // or the sleeper sees the push
+        mtx_lock(&g_Jobs.SleepMutex);
+        atomic_fetch_add(&g_Jobs.SleepingWorkers, 1);
+        if (atomic_load(&g_Jobs.Generation) == generation && !atomic_load(&g_Jobs.Quit))
+            cnd_wait(&g_Jobs.WakeCondition, &g_Jobs.SleepMutex);
+        atomic_fetch_sub(&g_Jobs.SleepingWorkers, 1);
+        mtx_unlock(&g_Jobs.SleepMutex);
+    }
+
+    return 0;
+}
+
+bool JobSystem_Initialise(uint32_t workerCount)
+{
+    if (workerCount == 0)
+    {
+        uint32_t hardwareThreads = Parallel_GetHardwareThreadCount();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+    workerCount = workerCount < JOB_MAX_THREADS - 1 ? workerCount : JOB_MAX_THREADS - 1;
+
+    memset(&g_Jobs, 0, sizeof(g_Jobs));
+    uint32_t threadCount = workerCount + 1 + JOB_MAX_ATTACHED_THREADS;
+    g_Jobs.Deques = AlignedAlloc(threadCount * sizeof(JobDeque), CACHE_LINE_SIZE);
+    if (g_Jobs.Deques == NULL)
+        return false;
+
+    if (mtx_init(&g_Jobs.Pinned.Mutex, mtx_plain) != thrd_success ||
+        mtx_init(&g_Jobs.SleepMutex, mtx_plain) != thrd_success ||
+        cnd_init(&g_Jobs.WakeCondition) != thrd_success)
+    {
+        AlignedFree(g_Jobs.Deques);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        JobDeque* deque = &g_Jobs.Deques[i];
+        atomic_init(&deque->Top, 0);
+        atomic_init(&deque->Bottom, 0);
+        deque->RandomState = 0x9E3779B9u * (i + 1);
+    }
+    atomic_init(&g_Jobs.Generation, 0);
+    atomic_init(&g_Jobs.SleepingWorkers, 0);
+    atomic_init(&g_Jobs.Quit, false);
+    atomic_init(&g_Jobs.AttachedMask, 0);
+
+    // Set before the workers start as they read it, the deque of a worker that failed to
+    // start merely stays empty
+    t_ThreadIndex = 0;
+    g_Jobs.ThreadCount = threadCount;
+    g_Jobs.FirstAttachedIndex = workerCount + 1;
+    for (uint32_t i = 1; i <= workerCount; ++i)
+    {
+        if (thrd_create(&g_Jobs.Workers[g_Jobs.WorkerCount], WorkerMain, (void*)(uintptr_t)i) != thrd_success)
+            break;
+        g_Jobs.WorkerCount++;
+    }
+
+    return true;
+}
+
+void JobSystem_Shutdown(void)
+{
+    mtx_lock(&g_Jobs.SleepMutex);
+    atomic_store(&g_Jobs.Quit, true);
+    cnd_broadcast(&g_Jobs.WakeCondition);
+    mtx_unlock(&g_Jobs.SleepMutex);
+
+    for (uint32_t i = 0; i < g_Jobs.WorkerCount; ++i)
+        thrd_join(g_Jobs.Workers[i], NULL);
+
+    // Whatever was pinned after the last frame still runs
+    while (RunPinnedJob())
+        ;
+
+    free(g_Jobs.Pinned.Jobs);
+    cnd_destroy(&g_Jobs.WakeCondition);
+    mtx_destroy(&g_Jobs.SleepMutex);
+    mtx_destroy(&g_Jobs.Pinned.Mutex);
+    AlignedFree(g_Jobs.Deques);
+    g_Jobs.Deques = NULL;
+    g_Jobs.WorkerCount = 0;
+    g_Jobs.ThreadCount = 0;
+    t_ThreadIndex = UINT32_MAX;
+}
+
+uint32_t JobSystem_GetThreadCount(void)
+{
+    return g_Jobs.WorkerCount + 1;
+}
+
+uint32_t JobSystem_GetThreadIndex(void)
+{
+    return t_ThreadIndex;
+}
+
+uint32_t JobSystem_GetThreadIndexCount(void)
+{
+    return g_Jobs.ThreadCount;
+}
+
+bool JobSystem_AttachThread(void)
+{
+    if (t_ThreadIndex != UINT32_MAX)
+        return true;
+    if (g_Jobs.Deques == NULL)
+        return false;
+
+    unsigned mask = atomic_load(&g_Jobs.AttachedMask);
+    for (;;)
+    {
+        uint32_t slot = 0;
+        while (slot < JOB_MAX_ATTACHED_THREADS && (mask & (1u << slot)) != 0)
+            ++slot;
+        if (slot == JOB_MAX_ATTACHED_THREADS)
+            return false;
+
+        if (atomic_compare_exchange_weak(&g_Jobs.AttachedMask, &mask, mask | (1u << slot)))
+        {
+            t_ThreadIndex = g_Jobs.FirstAttachedIndex + slot;
+            return true;
+        }
+    }
+}
+
+void JobSystem_DetachThread(void)
+{
+    uint32_t threadIndex = t_ThreadIndex;
+    if (threadIndex == UINT32_MAX || threadIndex == 0)
+        return;
+
+    // The deque is handed out again empty, thieves only ever find nothing in it meanwhile
+    Job job;
+    while (Deque_Take(&g_Jobs.Deques[threadIndex], &job))
+        Execute(&job);
+    t_ThreadIndex = UINT32_MAX;
+    atomic_fetch_and(&g_Jobs.AttachedMask, ~(1u << (threadIndex - g_Jobs.FirstAttachedIndex)));
+}
+
+void JobSystem_Run(const JobDecl* jobs, size_t count, JobCounter* counter)
+{
+    if (counter != NULL)
+        atomic_fetch_add_explicit(&counter->Pending, count, memory_order_relaxed);
+
+    uint32_t threadIndex = t_ThreadIndex;
+    if (threadIndex == UINT32_MAX || g_Jobs.Deques == NULL)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            Job job = { jobs[i].Function, jobs[i].UserData, counter };
+            Execute(&job);
+        }
+        return;
+    }
+
+    JobDeque* deque = &g_Jobs.Deques[threadIndex];
+    for (size_t i = 0; i < count; ++i)
+    {
+        Job job = { jobs[i].Function, jobs[i].UserData, counter };
+        if (!Deque_Push(deque, &job))
+            Execute(&job);
+    }
+
+    if (g_Jobs.WorkerCount > 0)
+        WakeWorkers();
+}
+
+bool JobSystem_RunPinned(JobDecl job, JobCounter* counter)
+{
+    Job pinned = { job.Function, job.UserData, counter };
+    mtx_lock(&g_Jobs.Pinned.Mutex);
+    if (g_Jobs.Pinned.Count == g_Jobs.Pinned.Capacity)
+    {
+        // Nothing is queued and the counter is left alone, running it here would break the pin
+        size_t capacity = g_Jobs.Pinned.Capacity > 0 ? g_Jobs.Pinned.Capacity * 2 : 16;
+        Job* jobs = realloc(g_Jobs.Pinned.Jobs, capacity * sizeof(Job));
+        if (jobs == NULL)
+        {
+            mtx_unlock(&g_Jobs.Pinned.Mutex);
+            return false;
+        }
+        g_Jobs.Pinned.Jobs = jobs;
+        g_Jobs.Pinned.Capacity = capacity;
+    }
+
+    // Counted before the main thread can take it
+    if (counter != NULL)
+        atomic_fetch_add_explicit(&counter->Pending, 1, memory_order_relaxed);
+    g_Jobs.Pinned.Jobs[g_Jobs.Pinned.Count++] = pinned;
+    mtx_unlock(&g_Jobs.Pinned.Mutex);
+    return true;
+}
+
+void JobSystem_Wait(JobCounter* counter)
+{
+    uint32_t threadIndex = t_ThreadIndex;
+    while (!JobCounter_IsDone(counter))
+    {
+        if (threadIndex == 0 && RunPinnedJob())
+            continue;
+        if (threadIndex != UINT32_MAX && RunOneJob(threadIndex))
+            continue;
+        thrd_yield();
+    }
+}
+
+void JobSystem_RunPinnedJobs(void)
+{
+    if (t_ThreadIndex != 0)
+        return;
+
+    while (RunPinnedJob())
+        ;
+}
+
+bool JobCounter_IsDone(JobCounter* counter)
+{
+    return atomic_load_explicit(&counter->Pending, memory_order_acquire) == 0;
+}
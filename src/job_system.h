@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*JobFunction)(void* userData);
+
+typedef struct JobDecl
+{
+    JobFunction Function;
+    void* UserData;
+} JobDecl;
+
+// Jobs still to finish of everything run with the counter. Zero it before the first run,
+// the same counter can be shared by several runs and waited on once.
+typedef struct JobCounter
+{
+    atomic_size_t Pending;
+} JobCounter;
+
+// Starts the workers, 0 picks one worker per hardware thread minus the calling thread. The
+// calling thread becomes the main thread, the only one running pinned jobs.
+bool JobSystem_Initialise(uint32_t workerCount);
+void JobSystem_Shutdown(void);
+
+// Number of threads running jobs, including the main thread
+uint32_t JobSystem_GetThreadCount(void);
+
+// 0 on the main thread, 1 to the worker count on the workers, above that on attached threads
+// and UINT32_MAX on other threads
+uint32_t JobSystem_GetThreadIndex(void);
+
+// Upper bound of the thread indices, attached threads included, for sizing per-thread data
+uint32_t JobSystem_GetThreadIndexCount(void);
+
+// Gives a thread created elsewhere its own deque, so the jobs it runs are spread over the
+// workers rather than run inline. Only a few threads can be attached at once, returns false
+// when they're all taken. Detach before the thread exits.
+bool JobSystem_AttachThread(void);
+void JobSystem_DetachThread(void);
+
+// Pushes the jobs to the deque of the calling thread, where idle threads steal them from.
+// Threads outside the job system, or a full deque, run them right away instead.
+void JobSystem_Run(const JobDecl* jobs, size_t count, JobCounter* counter);
+
+// Queues a job only the main thread runs, for the window and swap chain calls that must stay
+// on the thread that created them. False when the queue can't grow, the job isn't run then
+// and the counter is untouched.
+bool JobSystem_RunPinned(JobDecl job, JobCounter* counter);
+
+// Runs other jobs until the counter drops to zero instead of blocking the thread, the main
+// thread also runs its pinned jobs meanwhile
+void JobSystem_Wait(JobCounter* counter);
+
+// Runs the pinned jobs queued so far, called by the main thread between frames
+void JobSystem_RunPinnedJobs(void);
+
+bool JobCounter_IsDone(JobCounter* counter);
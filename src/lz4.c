@@ -0,0 +1,235 @@
+#include "lz4.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LZ4_MIN_MATCH 4
+// The last 5 bytes are always literals, and the last match starts 12 bytes before the end
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MATCH_FIND_LIMIT 12
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 14
+// Every 64 misses in a row the search skips one more byte, incompressible data goes fast
+#define LZ4_SKIP_TRIGGER 6
+// Lengths in a token, longer ones continue in bytes of 255
+#define LZ4_TOKEN_MASK 15
+
+static uint32_t Read32(const uint8_t* bytes)
+{
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static uint64_t Read64(const uint8_t* bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static uint32_t Hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+// Bytes a length takes after the token
+static size_t GetLengthSize(size_t length)
+{
+    return length >= LZ4_TOKEN_MASK ? (length - LZ4_TOKEN_MASK) / 255 + 1 : 0;
+}
+
+static uint8_t* WriteLength(uint8_t* output, size_t length)
+{
+    if (length < LZ4_TOKEN_MASK)
+        return output;
+    for (length -= LZ4_TOKEN_MASK; length >= 255; length -= 255)
+        *output++ = 255;
+    *output++ = (uint8_t)length;
+    return output;
+}
+
+// Writes the literals and the match after them, matchLength 0 for the last sequence.
+// Returns NULL when it doesn't fit.
+static uint8_t* WriteSequence(uint8_t* output, const uint8_t* outputEnd, const uint8_t* literals,
+                              size_t literalLength, size_t offset, size_t matchLength)
+{
+    size_t matchCode = matchLength > 0 ? matchLength - LZ4_MIN_MATCH : 0;
+    size_t size = 1 + GetLengthSize(literalLength) + literalLength +
+                  (matchLength > 0 ? 2 + GetLengthSize(matchCode) : 0);
+    if (size > (size_t)(outputEnd - output))
+        return NULL;
+
+    *output++ = (uint8_t)((literalLength < LZ4_TOKEN_MASK ? literalLength : LZ4_TOKEN_MASK) << 4 |
+                          (matchCode < LZ4_TOKEN_MASK ? matchCode : LZ4_TOKEN_MASK));
+    output = WriteLength(output, literalLength);
+    memcpy(output, literals, literalLength);
+    output += literalLength;
+    if (matchLength > 0)
+    {
+        *output++ = (uint8_t)(offset & 0xFF);
+        *output++ = (uint8_t)(offset >> 8);
+        output = WriteLength(output, matchCode);
+    }
+    return output;
+}
+
+// Length of the common run of a and b, stopping at limit
+static size_t GetMatchLength(const uint8_t* a, const uint8_t* b, const uint8_t* limit)
+{
+    const uint8_t* start = a;
+    while (a + sizeof(uint64_t) <= limit && Read64(a) == Read64(b))
+    {
+        a += sizeof(uint64_t);
+        b += sizeof(uint64_t);
+    }
+    while (a < limit && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return (size_t)(a - start);
+}
+
+size_t Lz4_GetMaxCompressedSize(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t Lz4_Compress(const void* source, size_t size, void* destination, size_t capacity)
+{
+    // Positions are kept in 32 bits
+    if (size > UINT32_MAX)
+        return 0;
+
+    const uint8_t* input = source;
+    const uint8_t* inputEnd = input + size;
+    uint8_t* output = destination;
+    const uint8_t* outputEnd = output + capacity;
+    const uint8_t* anchor = input;
+
+    if (size > LZ4_MATCH_FIND_LIMIT)
+    {
+        uint32_t* table = calloc((size_t)1 << LZ4_HASH_BITS, sizeof(uint32_t));
+        if (table == NULL)
+            return 0;
+
+        const uint8_t* matchLimit = inputEnd - LZ4_LAST_LITERALS;
+        const uint8_t* searchLimit = inputEnd - LZ4_MATCH_FIND_LIMIT;
+        const uint8_t* position = input + 1;
+        uint32_t misses = 0;
+        while (position < searchLimit)
+        {
+            uint32_t sequence = Read32(position);
+            uint32_t hash = Hash(sequence);
+            const uint8_t* match = input + table[hash];
+            table[hash] = (uint32_t)(position - input);
+            if (position - match > LZ4_MAX_OFFSET || Read32(match) != sequence)
+            {
+                position += 1 + (misses++ >> LZ4_SKIP_TRIGGER);
+                continue;
+            }
+            misses = 0;
+
+            // Earlier bytes may match as well
+            while (position > anchor && match > input && position[-1] == match[-1])
+            {
+                position--;
+                match--;
+            }
+
+            size_t matchLength = LZ4_MIN_MATCH +
+                GetMatchLength(position + LZ4_MIN_MATCH, match + LZ4_MIN_MATCH, matchLimit);
+            output = WriteSequence(output, outputEnd, anchor, (size_t)(position - anchor),
+                                   (size_t)(position - match), matchLength);
+            if (output == NULL)
+            {
+                free(table);
+                return 0;
+            }
+
+            position += matchLength;
+            anchor = position;
+            // The bytes the match skipped are found again by later ones
+            if (position - 2 > input)
+                table[Hash(Read32(position - 2))] = (uint32_t)(position - 2 - input);
+        }
+        free(table);
+    }
+
+    output = WriteSequence(output, outputEnd, anchor, (size_t)(inputEnd - anchor), 0, 0);
+    return output != NULL ? (size_t)(output - (uint8_t*)destination) : 0;
+}
+
+// Adds the bytes of a length after the token, false when the block ends first
+static bool ReadLength(const uint8_t** input, const uint8_t* inputEnd, size_t* length)
+{
+    if (*length != LZ4_TOKEN_MASK)
+        return true;
+
+    uint8_t value;
+    do
+    {
+        if (*input >= inputEnd)
+            return false;
+        value = *(*input)++;
+        *length += value;
+    } while (value == 255);
+    return true;
+}
+
+bool Lz4_Decompress(const void* source, size_t compressedSize, void* destination, size_t size)
+{
+    const uint8_t* input = source;
+    const uint8_t* inputEnd = input + compressedSize;
+    uint8_t* output = destination;
+    uint8_t* outputEnd = output + size;
+
+    for (;;)
+    {
+        if (input >= inputEnd)
+            return false;
+        uint8_t token = *input++;
+
+        size_t literalLength = token >> 4;
+        if (!ReadLength(&input, inputEnd, &literalLength) ||
+            literalLength > (size_t)(inputEnd - input) || literalLength > (size_t)(outputEnd - output))
+            return false;
+        memcpy(output, input, literalLength);
+        input += literalLength;
+        output += literalLength;
+
+        // The last sequence has no match
+        if (input == inputEnd)
+            return output == outputEnd;
+
+        if (inputEnd - input < 2)
+            return false;
+        size_t offset = (size_t)input[0] | (size_t)input[1] << 8;
+        input += 2;
+        size_t matchLength = token & LZ4_TOKEN_MASK;
+        if (offset == 0 || offset > (size_t)(output - (uint8_t*)destination) ||
+            !ReadLength(&input, inputEnd, &matchLength))
+            return false;
+        matchLength += LZ4_MIN_MATCH;
+        if (matchLength > (size_t)(outputEnd - output))
+            return false;
+
+        // Far enough apart to copy 8 bytes at a time, the last copy may spill past the match
+        // as long as it stays in the block. Closer ones repeat a short pattern byte by byte.
+        const uint8_t* match = output - offset;
+        uint8_t* matchEnd = output + matchLength;
+        if (offset >= sizeof(uint64_t) && (size_t)(outputEnd - matchEnd) >= sizeof(uint64_t))
+        {
+            for (; output < matchEnd; output += sizeof(uint64_t), match += sizeof(uint64_t))
+                memcpy(output, match, sizeof(uint64_t));
+        }
+        else
+        {
+            while (output < matchEnd)
+                *output++ = *match++;
+        }
+        output = matchEnd;
+    }
+}
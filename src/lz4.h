@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// LZ4 block format, without the frame around it. Blocks written here decode with any LZ4
+// implementation and the other way around.
+
+// Largest size a block of size bytes compresses to, when nothing matches
+size_t Lz4_GetMaxCompressedSize(size_t size);
+
+// Greedy compression with a single hash table of the last position of each 4 byte sequence.
+// Returns the compressed size, 0 when it doesn't fit in capacity.
+size_t Lz4_Compress(const void* source, size_t size, void* destination, size_t capacity);
+
+// Decodes a whole block, which has to expand to exactly size bytes. Malformed blocks are
+// rejected without reading or writing out of bounds.
+bool Lz4_Decompress(const void* source, size_t compressedSize, void* destination, size_t size);
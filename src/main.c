@@ -2,6 +2,7 @@
 #define NOMINMAX
 #include <Windows.h>
 #include <assert.h>
+#include <float.h>
 #include <time.h>
 #include <signal.h>
 #define GLFW_EXPOSE_NATIVE_WIN32
@@ -10,6 +11,34 @@
 #define CGLM_FORCE_LEFT_HANDED
 #include <cglm/cglm.h>
 
+#include "asset_archive.h"
+#include "asset_streamer.h"
+#include "benchmark.h"
+#include "block_compression.h"
+#include "dds.h"
+#include "draw_queue.h"
+#include "dynamic_buffer.h"
+#include "dynamic_resolution.h"
+#include "frame_arena.h"
+#include "frame_limiter.h"
+#include "frame_pipeline.h"
+#include "frustum_culling.h"
+#include "gpu_culling.h"
+#include "job_system.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "mip_generator.h"
+#include "occlusion_culling.h"
+#include "parallel.h"
+#include "particle_system.h"
+#include "residency_manager.h"
+#include "root_signature.h"
+#include "simd.h"
+#include "subresource_copy.h"
+#include "texture_format.h"
+#include "transform_hierarchy.h"
+#include "vertex_format.h"
+
 #define COBJMACROS
     #pragma warning(push)
     #pragma warning(disable:4115) // named type definition in parentheses
@@ -21,6 +50,9 @@
     #pragma warning(pop)
 #undef COBJMACROS
 
+// After the D3D12 headers, it redirects the methods it records
+#include "command_capture.h"
+
 #define HD_EXIT_FAILURE -1
 #define HD_EXIT_SUCCESS 0
 
@@ -31,6 +63,40 @@
 #define ID3DBlob_Release(self) ID3D10Blob_Release(self)
 #define ID3DBlob_GetBufferSize(self) ID3D10Blob_GetBufferSize(self)
 
+// Largest error in pixels a level of detail may project to
+#define LOD_PIXEL_THRESHOLD 1.0f
+// Resolution of the software occlusion buffer
+#define OCCLUSION_WIDTH 320
+#define OCCLUSION_HEIGHT 180
+// Offset of the instances in the culling upload buffers and of the commands in the readback
+// buffer, the constants or the draw count come first
+#define CULLING_DATA_OFFSET D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT
+// Recordings timed per draw count by the bundle benchmark, the fastest one is reported
+#define BUNDLE_BENCHMARK_RUNS 5
+// Initial size of the per-thread frame arenas, they grow to what a frame needs
+#define FRAME_ARENA_BLOCK_SIZE (256 * 1024)
+// Debug line vertices a frame can stream, and the segments of each circle of a bounding sphere
+#define DEBUG_LINE_REGION_SIZE (1024 * 1024)
+#define BOUNDS_CIRCLE_SEGMENTS 24
+// Particles simulated and drawn at most, and the longest step they're integrated over
+#define PARTICLE_CAPACITY (1024 * 1024)
+#define PARTICLE_MAX_TIME_STEP 0.1f
+// Texture of the cube, replaced by an image compressed at startup when the file is missing
+#define SCENE_TEXTURE_PATH "textures/cube.dds"
+#define FALLBACK_TEXTURE_SIZE 256
+// Packed assets streamed in after the first frame, the files are loaded directly without it
+#define ASSET_ARCHIVE_PATH "assets.pak"
+#define ASSET_DECODER_COUNT 2
+// Threads per side of a mip generation group, keep in sync with shaders/generate_mips.hlsl
+#define MIP_GROUP_SIZE 8
+
+// GPU time per frame the scene resolution is scaled to hold, a little under the 16.7 ms of 60 Hz
+#define DYNAMIC_RESOLUTION_TARGET_MS 14.0f
+#define DYNAMIC_RESOLUTION_REPORT_FRAMES 120
+
+// Rate of the capped present mode unless one is given with --present
+#define DEFAULT_FRAME_RATE_CAP 144.0
+
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 
@@ -41,13 +107,297 @@
 #define GEN_REPORT_STRING() "Reporting Live objects at " __FUNCTION__ ", L:" S__LINE__ "\n"
 #define REPORT_LIVE_OBJ() ReportLiveObjects(GEN_REPORT_STRING())
 
+// Transform node of the cube
+#define CUBE_NODE 0
+// Sort key fields of the cube, the only pipeline state, material and mesh so far
+#define OPAQUE_PASS 0
+#define CUBE_PIPELINE 0
+#define CUBE_MATERIAL 0
+#define CUBE_MESH 0
+
+// How the frames are presented, cycled with M
+typedef enum PresentMode
+{
+    // Synchronized to the vertical blank, never faster than the refresh rate
+    PRESENT_MODE_VSYNC,
+    // As soon as the frame is done, tearing where the display allows it
+    PRESENT_MODE_IMMEDIATE,
+    // Immediate, with the main thread held to a frame rate by the frame limiter
+    PRESENT_MODE_CAPPED,
+    PRESENT_MODE_COUNT
+} PresentMode;
+
 struct Context
 {
-    mat4 ModelMatrix;
+    // Owned by the simulation, which runs on the main thread with the window callbacks
+    TransformHierarchy Transforms;
+    // Cull and draw through the compute passes and ExecuteIndirect, toggled with G.
+    // V compares the next frame of the compute passes with the CPU reference.
+    bool GpuDrivenCulling;
+    bool ValidateGpuCulling;
+    // B times recording the draws with and without bundles after the next frame
+    bool BenchmarkBundles;
+    // L draws the bounding spheres of the nodes
+    bool DrawBounds;
+    // P simulates and draws the particles
+    bool DrawParticles;
+    // R scales the resolution of the scene to hold DYNAMIC_RESOLUTION_TARGET_MS of GPU time
+    bool DynamicResolution;
+    PresentMode PresentMode;
+    double FrameRateCap;
+    // Set for a --benchmark run, which scripts the camera and the instances and ignores the keys.
+    // Every thread records its own metrics into it.
+    Benchmark* Benchmark;
     mat4 ViewMatrix;
     mat4 ProjectionMatrix;
+    int WindowWidth;
+    int WindowHeight;
+    // Their billboards are written into the snapshot, paused while they're hidden
+    ParticleSystem Particles;
+
+    // Owned by the render thread
+    // Transient data of the frames in flight, reset once the frame's fence completed
+    FrameArenas FrameArenas;
+    // World space bounds of the nodes
+    SphereBounds NodeBounds;
+    // Nodes rasterize their coarsest level of detail as occluders
+    OcclusionBuffer Occlusion;
+    OccluderMesh Occluder;
+    // Draws of the visible nodes sorted by state and depth before recording
+    DrawQueue DrawQueue;
+
+    // Maps the quantized positions of the mesh back to object space, set before the threads start
+    mat4 DequantizeMatrix;
 } g_Context;
 
+// Resources of the GPU culling passes and the indirect draws they produce
+typedef struct GpuCulling
+{
+    ID3D12RootSignature* RootSignature;
+    ID3D12PipelineState* CullPipelineState;
+    ID3D12PipelineState* ScanPipelineState;
+    ID3D12PipelineState* CompactPipelineState;
+    ID3D12CommandSignature* CommandSignature;
+    ID3D12Resource* Commands;
+    ID3D12Resource* DrawCount;
+    ID3D12Resource* Visibility;
+    ID3D12Resource* GroupData;
+    ID3D12Resource* Readback;
+    // Constants followed by the instances, one buffer per frame in flight
+    ID3D12Resource* UploadBuffers[FRAMES_NUM];
+    uint8_t* UploadData[FRAMES_NUM];
+    uint32_t InstanceCapacity;
+} GpuCulling;
+
+// State the static draws are recorded with. Zeroed before filling, so two of them can be
+// compared with memcmp. The matrices aren't part of it, the draws read them from a buffer.
+typedef struct StaticDrawInputs
+{
+    ID3D12PipelineState* PipelineState;
+    ID3D12RootSignature* RootSignature;
+    D3D12_VERTEX_BUFFER_VIEW VertexBufferView;
+    D3D12_INDEX_BUFFER_VIEW IndexBufferView;
+    ID3D12DescriptorHeap* DescriptorHeap;
+    D3D12_GPU_DESCRIPTOR_HANDLE Texture;
+    const LodChain* Lods;
+} StaticDrawInputs;
+
+// Draws of the CPU culling path recorded into bundles. There's one per frame in flight, as a
+// bundle can't be reset while the GPU may still execute it. The draws pass only their node,
+// the vertex shader reads its MVP from the buffer of the frame, so a bundle is re-recorded
+// when the state or the visible draws change and not when the camera or a node moves.
+typedef struct DrawBundles
+{
+    ID3D12PipelineState* PipelineState;
+    ID3D12CommandAllocator* Allocators[FRAMES_NUM];
+    ID3D12GraphicsCommandList* Bundles[FRAMES_NUM];
+    // MVPs of the nodes by index, bound as a root SRV by the direct command list
+    ID3D12Resource* MvpBuffers[FRAMES_NUM];
+    mat4* MvpData[FRAMES_NUM];
+    StaticDrawInputs Inputs[FRAMES_NUM];
+    // Node and level of detail of every recorded draw, in order
+    DrawPacket* Packets[FRAMES_NUM];
+    size_t PacketCounts[FRAMES_NUM];
+    size_t Capacity;
+    bool Recorded[FRAMES_NUM];
+} DrawBundles;
+
+// Lines drawn over the scene, streamed every frame into an upload buffer the GPU reads them
+// from in place
+typedef struct DebugLines
+{
+    ID3D12PipelineState* PipelineState;
+    ID3D12Resource* Resource;
+    DynamicBuffer Vertices;
+} DebugLines;
+
+typedef struct DebugVertex
+{
+    vec3 Position;
+    // R8G8B8A8
+    uint32_t Color;
+} DebugVertex;
+
+// Camera facing quads, one instance per particle streamed every frame into an upload buffer
+typedef struct ParticleBillboards
+{
+    ID3D12RootSignature* RootSignature;
+    ID3D12PipelineState* PipelineState;
+    ID3D12Resource* Resource;
+    DynamicBuffer Instances;
+} ParticleBillboards;
+
+// Root constants of the particle vertex shader
+typedef struct ParticleConstants
+{
+    mat4 ViewProjection;
+    float ProjectionScale[2];
+} ParticleConstants;
+
+// Texture the scene is drawn with and the shader visible heap holding its view
+typedef struct SceneTexture
+{
+    ID3D12Resource* Resource;
+    ID3D12DescriptorHeap* DescriptorHeap;
+    D3D12_GPU_DESCRIPTOR_HANDLE View;
+} SceneTexture;
+
+// Compute pass filling the mips of RGBA8 textures from their top level on the GPU
+typedef struct MipGenerator
+{
+    ID3D12RootSignature* RootSignature;
+    ID3D12PipelineState* PipelineState;
+} MipGenerator;
+
+// Root constants of shaders/generate_mips.hlsl
+typedef struct MipConstants
+{
+    uint32_t SourceSize[2];
+    uint32_t DestinationSize[2];
+    uint32_t Srgb;
+} MipConstants;
+
+// Default heap resources the frames draw with, kept within the video memory budget of the
+// adapter. Upload and readback heaps live in system memory and aren't tracked.
+typedef struct SceneResidency
+{
+    ResidencyManager Manager;
+    IDXGIAdapter4* Adapter;
+    ID3D12Device2* Device;
+    ResidencyObject VertexBuffer;
+    ResidencyObject IndexBuffer;
+    ResidencyObject Texture;
+    ResidencyObject DepthBuffer;
+    ResidencyObject SceneColor;
+    // Commands, draw count, visibility and group data, only used by the GPU culling path
+    ResidencyObject CullingBuffers[4];
+    // Counters as they were last reported
+    ResidencyCounters Reported;
+} SceneResidency;
+
+// Color target the scene is drawn into at a scale of the window size, then stretched onto the
+// back buffer. It's allocated at the full size, a smaller scale only draws into a corner of it,
+// so changing the scale never recreates it.
+typedef struct ScaledScene
+{
+    ID3D12Resource* ColorBuffer;
+    ID3D12DescriptorHeap* RenderTargetHeap;
+    ID3D12DescriptorHeap* DescriptorHeap;
+    D3D12_GPU_DESCRIPTOR_HANDLE View;
+    ID3D12RootSignature* RootSignature;
+    ID3D12PipelineState* PipelineState;
+    // Timestamps at the start and the end of every frame in flight, read back once the frame's
+    // fence completed
+    ID3D12QueryHeap* QueryHeap;
+    ID3D12Resource* Readback;
+    uint64_t TimestampFrequency;
+    bool Measured[FRAMES_NUM];
+    // Scale each frame in flight was drawn at, the controller gets it with the frame's time
+    float Scales[FRAMES_NUM];
+    // Frame each frame in flight was simulated as, a benchmark gets its GPU time by it
+    uint64_t Frames[FRAMES_NUM];
+    DynamicResolution Controller;
+    float Scale;
+} ScaledScene;
+
+// Root constants of shaders/upscale_pixel.hlsl
+typedef struct UpscaleConstants
+{
+    // Part of the color target the scene covers, and the last texel centre within it so the
+    // filter doesn't reach past it
+    float UvScale[2];
+    float UvClamp[2];
+} UpscaleConstants;
+
+// State of a simulated frame the render thread draws from. The simulation fills one while
+// the render thread draws the previous one, they're handed over through a FramePipeline.
+typedef struct FrameSnapshot
+{
+    uint64_t Frame;
+    mat4 ViewMatrix;
+    mat4 ProjectionMatrix;
+    size_t NodeCount;
+    mat4* WorldMatrices;
+    mat4* MvpMatrices;
+    // Billboards of the live particles, sized for the capacity of the particle system
+    ParticleInstance* Particles;
+    size_t ParticleCount;
+    // Window size the frame was simulated for, the render thread resizes to it
+    int Width;
+    int Height;
+    bool GpuDrivenCulling;
+    bool ValidateGpuCulling;
+    bool BenchmarkBundles;
+    bool DrawBounds;
+    bool DrawParticles;
+    bool DynamicResolution;
+    PresentMode PresentMode;
+    double SimulationMilliseconds;
+} FrameSnapshot;
+
+// What the render thread submits the frames with, its own until it's joined
+typedef struct RenderThreadData
+{
+    FramePipeline* Pipeline;
+    ID3D12Device2* Device;
+    IDXGISwapChain4* SwapChain;
+    ID3D12CommandQueue* CommandQueue;
+    ID3D12GraphicsCommandList* CommandList;
+    ID3D12PipelineState* PipelineState;
+    ID3D12RootSignature* RootSignature;
+    D3D12_VERTEX_BUFFER_VIEW* VertexBufferView;
+    D3D12_INDEX_BUFFER_VIEW* IndexBufferView;
+    LodChain* Lods;
+    GpuCulling* Culling;
+    DrawBundles* Bundles;
+    DebugLines* DebugLines;
+    ParticleBillboards* Particles;
+    SceneTexture* Texture;
+    ID3D12Resource** DepthBuffer;
+    ScaledScene* Scene;
+    D3D12_VIEWPORT* Viewport;
+    D3D12_RECT* ScissorRect;
+    // Polled before every frame, NULL without an archive
+    AssetStreamer* Streamer;
+    SceneResidency* Residency;
+    // Only handed to the jobs pinned to the main thread, GLFW calls must come from it
+    GLFWwindow* Window;
+} RenderThreadData;
+
+// What the streamed assets are submitted with. The render thread completes them, as it
+// owns the command queue.
+typedef struct StreamedAssets
+{
+    ID3D12Device2* Device;
+    ID3D12CommandQueue* CommandQueue;
+    ID3D12GraphicsCommandList* CommandList;
+    const MipGenerator* MipGenerator;
+    SceneResidency* Residency;
+    LARGE_INTEGER RequestTime;
+    // Set before the streamer is destroyed, the requests still finishing are only released
+    bool ShuttingDown;
+} StreamedAssets;
+
 typedef struct Vertex
 {
     vec3 Position;
@@ -65,6 +415,20 @@ static Vertex g_Vertices[8] = {
     { {1.0f, -1.0f,  1.0f}, {1.0f, 0.0f, 1.0f} }  // 7
 };
 
+// Layout the vertices are stored with on the GPU, --position-format picks the position
+static VertexLayout g_VertexLayout = {
+    .Position = POSITION_FORMAT_UNORM16,
+    .Color = COLOR_FORMAT_UNORM8,
+    .Normal = NORMAL_FORMAT_NONE
+};
+
+// World space positions, the same shaders draw them with the view projection matrix as MVP
+static const VertexLayout g_DebugVertexLayout = {
+    .Position = POSITION_FORMAT_FLOAT32,
+    .Color = COLOR_FORMAT_UNORM8,
+    .Normal = NORMAL_FORMAT_NONE
+};
+
 static WORD g_Indicies[36] =
 {
     0, 1, 2, 0, 2, 3,
@@ -87,6 +451,10 @@ ID3D12DescriptorHeap* g_RTVDescriptorHeap;
 ID3D12DescriptorHeap* g_DSVDescriptorHeap;
 ID3D12Fence* g_Fence;
 HANDLE g_FenceEvent;
+// The swap chain was created with DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING
+bool g_TearingSupported;
+// The scene's color target is created with it as the optimized clear value
+const FLOAT g_ClearColor[] = { 0.635f, 0.415f, 0.905f, 1.0f };
 
 void EnableDebuggingLayer()
 {
@@ -200,9 +568,24 @@ ID3D12CommandQueue* CreateCommandQueue(ID3D12Device2* device, D3D12_COMMAND_LIST
     return d3d12CommandQueue;
 }
 
+// Variable refresh displays need tearing allowed to show frames between the vertical blanks
+bool CheckTearingSupport()
+{
+    BOOL allowTearing = FALSE;
+    IDXGIFactory5* dxgiFactory5;
+    if (SUCCEEDED(CreateDXGIFactory1(&IID_IDXGIFactory5, &dxgiFactory5)))
+    {
+        if (FAILED(IDXGIFactory5_CheckFeatureSupport(dxgiFactory5, DXGI_FEATURE_PRESENT_ALLOW_TEARING,
+                                                     &allowTearing, sizeof(allowTearing))))
+            allowTearing = FALSE;
+        IDXGIFactory5_Release(dxgiFactory5);
+    }
+    return allowTearing == TRUE;
+}
+
 IDXGISwapChain4* CreateSwapChain(HWND hWnd,
                                  ID3D12CommandQueue* commandQueue,
-                                 uint32_t width, uint32_t height, uint32_t bufferCount )
+                                 uint32_t width, uint32_t height, uint32_t bufferCount, bool allowTearing)
 {
     IDXGISwapChain4* dxgiSwapChain4;
     IDXGIFactory4* dxgiFactory4;
@@ -227,7 +610,7 @@ IDXGISwapChain4* CreateSwapChain(HWND hWnd,
             .Scaling = DXGI_SCALING_STRETCH,
             .SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD,
             .AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED,
-            .Flags = 0
+            .Flags = allowTearing ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0
         };
 
 
@@ -251,13 +634,15 @@ IDXGISwapChain4* CreateSwapChain(HWND hWnd,
 
 ID3D12DescriptorHeap* CreateDescriptorHeap(ID3D12Device2* device,
                                            D3D12_DESCRIPTOR_HEAP_TYPE type,
-                                           uint32_t numDescriptors)
+                                           uint32_t numDescriptors,
+                                           D3D12_DESCRIPTOR_HEAP_FLAGS flags)
 {
     ID3D12DescriptorHeap* descriptorHeap;
 
     D3D12_DESCRIPTOR_HEAP_DESC desc = {0};
     desc.NumDescriptors = numDescriptors;
     desc.Type = type;
+    desc.Flags = flags;
 
     ExitOnFailure(ID3D12Device2_CreateDescriptorHeap(device, &desc, &IID_ID3D12DescriptorHeap, &descriptorHeap));
 
@@ -320,27 +705,13 @@ ID3D12Fence* CreateFence(ID3D12Device2* device)
     return fence;
 }
 
-// Row-by-row memcpy
-// Taken form d3dx12.h, rewritten for C
-inline void MemcpySubresource(
-    const D3D12_MEMCPY_DEST* pDest,
-    const D3D12_SUBRESOURCE_DATA* pSrc,
-    SIZE_T RowSizeInBytes,
-    UINT NumRows,
-    UINT NumSlices)
-{
-    for (UINT z = 0; z < NumSlices; ++z)
-    {
-        BYTE* pDestSlice = (BYTE*)(pDest->pData) + pDest->SlicePitch * z;
-        const BYTE* pSrcSlice = (const BYTE*)(pSrc->pData) + pSrc->SlicePitch * z;
-        for (UINT y = 0; y < NumRows; ++y)
-        {
-            memcpy(pDestSlice + pDest->RowPitch * y,
-                   pSrcSlice + pSrc->RowPitch * y,
-                   RowSizeInBytes);
-        }
-    }
-}
+// The staging is done by subresource_copy.c, on its mirrors of the D3D12 structs
+_Static_assert(sizeof(SubresourceData) == sizeof(D3D12_SUBRESOURCE_DATA) &&
+               offsetof(SubresourceData, SlicePitch) == offsetof(D3D12_SUBRESOURCE_DATA, SlicePitch),
+               "SubresourceData isn't laid out like D3D12_SUBRESOURCE_DATA");
+_Static_assert(sizeof(SubresourceFootprint) == sizeof(D3D12_PLACED_SUBRESOURCE_FOOTPRINT) &&
+               offsetof(SubresourceFootprint, RowPitch) == offsetof(D3D12_PLACED_SUBRESOURCE_FOOTPRINT, Footprint.RowPitch),
+               "SubresourceFootprint isn't laid out like D3D12_PLACED_SUBRESOURCE_FOOTPRINT");
 
 // Taken form d3dx12.h, rewritten for C
 inline UINT64 UpdateSubresourcesImpl(
@@ -376,12 +747,13 @@ inline UINT64 UpdateSubresourcesImpl(
         return 0;
     }
 
-    for (UINT i = 0; i < NumSubresources; ++i)
+    if (!Subresource_Stage(pData, (const SubresourceFootprint*)pLayouts, pNumRows, pRowSizesInBytes,
+                           (const SubresourceData*)pSrcData, NumSubresources))
     {
-        if (pRowSizesInBytes[i] > (SIZE_T)-1) return 0;
-        D3D12_MEMCPY_DEST DestData = { pData + pLayouts[i].Offset, pLayouts[i].Footprint.RowPitch, pLayouts[i].Footprint.RowPitch * pNumRows[i] };
-        MemcpySubresource(&DestData, &pSrcData[i], (SIZE_T)pRowSizesInBytes[i], pNumRows[i], pLayouts[i].Footprint.Depth);
+        ID3D12Resource_Unmap(pIntermediate, 0, NULL);
+        return 0;
     }
+    CommandCapture_WriteBuffer(pIntermediate, pLayouts[0].Offset, pData + pLayouts[0].Offset, (size_t)RequiredSize);
     ID3D12Resource_Unmap(pIntermediate, 0, NULL);
 
     if (DestinationDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
@@ -410,7 +782,7 @@ inline UINT64 UpdateSubresourcesImpl(
     return RequiredSize;
 }
 
-// Heap-allocating UpdateSubresources implementation
+// UpdateSubresources implementation taking the footprints from the scratch arena
 // Taken form d3dx12.h, rewritten for C
 inline UINT64 UpdateSubresources(
     ID3D12GraphicsCommandList* pCmdList,
@@ -427,7 +799,13 @@ inline UINT64 UpdateSubresources(
     {
        return 0;
     }
-    void* pMem = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)MemToAlloc);
+    LinearArena* pScratch = ScratchArena_Get();
+    if (pScratch == NULL)
+    {
+       return 0;
+    }
+    ArenaMarker Marker = LinearArena_GetMarker(pScratch);
+    void* pMem = LinearArena_Alloc(pScratch, (SIZE_T)MemToAlloc, _Alignof(D3D12_PLACED_SUBRESOURCE_FOOTPRINT));
     if (pMem == NULL)
     {
        return 0;
@@ -446,7 +824,7 @@ inline UINT64 UpdateSubresources(
     ID3D12Device_Release(pDevice);
 
     UINT64 Result = UpdateSubresourcesImpl(pCmdList, pDestinationResource, pIntermediate, FirstSubresource, NumSubresources, RequiredSize, pLayouts, pNumRows, pRowSizesInBytes, pSrcData);
-    HeapFree(GetProcessHeap(), 0, pMem);
+    LinearArena_Rollback(pScratch, Marker);
     return Result;
 }
 
@@ -616,6 +994,20 @@ ID3DBlob* LoadShader(LPCWSTR path, LPCSTR target)
     return shaderBlob;
 }
 
+// The down-conversion is done by root_signature.c, on its mirrors of the D3D12 structs
+_Static_assert(sizeof(RootParameter) == sizeof(D3D12_ROOT_PARAMETER) &&
+               offsetof(RootParameter, ShaderVisibility) == offsetof(D3D12_ROOT_PARAMETER, ShaderVisibility),
+               "RootParameter isn't laid out like D3D12_ROOT_PARAMETER");
+_Static_assert(sizeof(RootParameter1) == sizeof(D3D12_ROOT_PARAMETER1) &&
+               offsetof(RootParameter1, ShaderVisibility) == offsetof(D3D12_ROOT_PARAMETER1, ShaderVisibility),
+               "RootParameter1 isn't laid out like D3D12_ROOT_PARAMETER1");
+_Static_assert(sizeof(RootDescriptorRange1) == sizeof(D3D12_DESCRIPTOR_RANGE1) &&
+               sizeof(RootDescriptorRange) == sizeof(D3D12_DESCRIPTOR_RANGE),
+               "RootDescriptorRange isn't laid out like D3D12_DESCRIPTOR_RANGE");
+_Static_assert(sizeof(RootSignatureDesc) == sizeof(D3D12_ROOT_SIGNATURE_DESC) &&
+               sizeof(RootSignatureDesc1) == sizeof(D3D12_ROOT_SIGNATURE_DESC1),
+               "RootSignatureDesc isn't laid out like D3D12_ROOT_SIGNATURE_DESC");
+
 // From d3dx12.h, converted to C
 //------------------------------------------------------------------------------------------------
 // D3D12 exports a new method for serializing root signatures in the Windows 10 Anniversary Update.
@@ -643,91 +1035,23 @@ inline HRESULT D3DX12SerializeVersionedRootSignature(
 
                 case D3D_ROOT_SIGNATURE_VERSION_1_1:
                 {
-                    HRESULT hr = S_OK;
-                    const D3D12_ROOT_SIGNATURE_DESC1* desc_1_1 = &pRootSignatureDesc->Desc_1_1;
-
-                    const SIZE_T ParametersSize = sizeof(D3D12_ROOT_PARAMETER) * desc_1_1->NumParameters;
-                    void* pParameters = (ParametersSize > 0) ? HeapAlloc(GetProcessHeap(), 0, ParametersSize) : NULL;
-                    if (ParametersSize > 0 && pParameters == NULL)
-                    {
-                        hr = E_OUTOFMEMORY;
-                    }
-                    D3D12_ROOT_PARAMETER* pParameters_1_0 = (D3D12_ROOT_PARAMETER*)pParameters;
-
-                    if (SUCCEEDED(hr))
+                    // The converted parameters and ranges are dropped at once after serializing
+                    LinearArena* pScratch = ScratchArena_Get();
+                    if (pScratch == NULL)
                     {
-                        for (UINT n = 0; n < desc_1_1->NumParameters; n++)
-                        {
-                            pParameters_1_0[n].ParameterType = desc_1_1->pParameters[n].ParameterType;
-                            pParameters_1_0[n].ShaderVisibility = desc_1_1->pParameters[n].ShaderVisibility;
-
-                            switch (desc_1_1->pParameters[n].ParameterType)
-                            {
-                            case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
-                                pParameters_1_0[n].Constants.Num32BitValues = desc_1_1->pParameters[n].Constants.Num32BitValues;
-                                pParameters_1_0[n].Constants.RegisterSpace = desc_1_1->pParameters[n].Constants.RegisterSpace;
-                                pParameters_1_0[n].Constants.ShaderRegister = desc_1_1->pParameters[n].Constants.ShaderRegister;
-                                break;
-
-                            case D3D12_ROOT_PARAMETER_TYPE_CBV:
-                            case D3D12_ROOT_PARAMETER_TYPE_SRV:
-                            case D3D12_ROOT_PARAMETER_TYPE_UAV:
-                                pParameters_1_0[n].Descriptor.RegisterSpace = desc_1_1->pParameters[n].Descriptor.RegisterSpace;
-                                pParameters_1_0[n].Descriptor.ShaderRegister = desc_1_1->pParameters[n].Descriptor.ShaderRegister;
-                                break;
-
-                            case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
-                                const D3D12_ROOT_DESCRIPTOR_TABLE1* table_1_1 = &desc_1_1->pParameters[n].DescriptorTable;
-
-                                const SIZE_T DescriptorRangesSize = sizeof(D3D12_DESCRIPTOR_RANGE) * table_1_1->NumDescriptorRanges;
-                                void* pDescriptorRanges = (DescriptorRangesSize > 0 && SUCCEEDED(hr)) ? HeapAlloc(GetProcessHeap(), 0, DescriptorRangesSize) : NULL;
-                                if (DescriptorRangesSize > 0 && pDescriptorRanges == NULL)
-                                {
-                                    hr = E_OUTOFMEMORY;
-                                }
-                                D3D12_DESCRIPTOR_RANGE* pDescriptorRanges_1_0 = (D3D12_DESCRIPTOR_RANGE*)pDescriptorRanges;
-
-                                if (SUCCEEDED(hr))
-                                {
-                                    for (UINT x = 0; x < table_1_1->NumDescriptorRanges; x++)
-                                    {
-                                        pDescriptorRanges_1_0[x].BaseShaderRegister = table_1_1->pDescriptorRanges[x].BaseShaderRegister;
-                                        pDescriptorRanges_1_0[x].NumDescriptors = table_1_1->pDescriptorRanges[x].NumDescriptors;
-                                        pDescriptorRanges_1_0[x].OffsetInDescriptorsFromTableStart = table_1_1->pDescriptorRanges[x].OffsetInDescriptorsFromTableStart;
-                                        pDescriptorRanges_1_0[x].RangeType = table_1_1->pDescriptorRanges[x].RangeType;
-                                        pDescriptorRanges_1_0[x].RegisterSpace = table_1_1->pDescriptorRanges[x].RegisterSpace;
-                                    }
-                                }
-
-                                D3D12_ROOT_DESCRIPTOR_TABLE* table_1_0 = &pParameters_1_0[n].DescriptorTable;
-                                table_1_0->NumDescriptorRanges = table_1_1->NumDescriptorRanges;
-                                table_1_0->pDescriptorRanges = pDescriptorRanges_1_0;
-                            }
-                        }
+                        return E_OUTOFMEMORY;
                     }
+                    ArenaMarker Marker = LinearArena_GetMarker(pScratch);
 
-                    if (SUCCEEDED(hr))
+                    D3D12_ROOT_SIGNATURE_DESC desc_1_0;
+                    HRESULT hr = E_OUTOFMEMORY;
+                    if (RootSignature_Downgrade((const RootSignatureDesc1*)&pRootSignatureDesc->Desc_1_1, pScratch,
+                                                (RootSignatureDesc*)&desc_1_0))
                     {
-                        D3D12_ROOT_SIGNATURE_DESC desc_1_0;
-                        desc_1_0.NumParameters = desc_1_1->NumParameters;
-                        desc_1_0.pParameters = pParameters_1_0;
-                        desc_1_0.NumStaticSamplers = desc_1_1->NumStaticSamplers;
-                        desc_1_0.pStaticSamplers = desc_1_1->pStaticSamplers;
-                        desc_1_0.Flags = desc_1_1->Flags;
                         hr = D3D12SerializeRootSignature(&desc_1_0, D3D_ROOT_SIGNATURE_VERSION_1, ppBlob, ppErrorBlob);
                     }
 
-                    if (pParameters)
-                    {
-                        for (UINT n = 0; n < desc_1_1->NumParameters; n++)
-                        {
-                            if (desc_1_1->pParameters[n].ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
-                            {
-                                HeapFree(GetProcessHeap(), 0, (void*)((D3D12_DESCRIPTOR_RANGE*)(pParameters_1_0[n].DescriptorTable.pDescriptorRanges)));
-                            }
-                        }
-                        HeapFree(GetProcessHeap(), 0, pParameters);
-                    }
+                    LinearArena_Rollback(pScratch, Marker);
                     return hr;
                 }
             }
@@ -740,7 +1064,10 @@ inline HRESULT D3DX12SerializeVersionedRootSignature(
     return E_INVALIDARG;
 }
 
-ID3D12RootSignature* CreateRootSignature(ID3D12Device2* device)
+// constantCount 32-bit root constants for the vertex shader at b0. Textured ones add a table
+// with a texture at t0 and a linear sampler at s0 for the pixel shader, and a root SRV at t1
+// for the vertex shader.
+ID3D12RootSignature* CreateRootSignature(ID3D12Device2* device, UINT constantCount, bool textured)
 {
     // Create a root signature.
     D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {0};
@@ -756,24 +1083,60 @@ ID3D12RootSignature* CreateRootSignature(ID3D12Device2* device)
         D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
         D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
         D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
-        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS |
-        D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS;
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+    if (!textured)
+        rootSignatureFlags |= D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS;
 
-    // A single 32-bit constant root parameter that is used by the vertex shader.
+    // A 32-bit constant root parameter that is used by the vertex shader. It stays first, the
+    // indirect draws of the GPU culling set it by index.
     // D3D12_ROOT_PARAMETER1
-    D3D12_ROOT_PARAMETER1 rootParameters[1];
+    D3D12_ROOT_PARAMETER1 rootParameters[3];
     rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
     rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
-    rootParameters[0].Constants.Num32BitValues = sizeof(mat4) / sizeof(float);
+    rootParameters[0].Constants.Num32BitValues = constantCount;
     rootParameters[0].Constants.ShaderRegister = 0;
     rootParameters[0].Constants.RegisterSpace = 0;
 
+    // The texture is uploaded before any draw, so its descriptor and data never change
+    D3D12_DESCRIPTOR_RANGE1 textureRange = {
+        .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
+        .NumDescriptors = 1,
+        .BaseShaderRegister = 0,
+        .RegisterSpace = 0,
+        .Flags = D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC,
+        .OffsetInDescriptorsFromTableStart = 0
+    };
+    rootParameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    rootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+    rootParameters[1].DescriptorTable.NumDescriptorRanges = 1;
+    rootParameters[1].DescriptorTable.pDescriptorRanges = &textureRange;
+
+    // The MVPs of the bundled draws, written before the frame is submitted
+    rootParameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+    rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+    rootParameters[2].Descriptor.ShaderRegister = 1;
+    rootParameters[2].Descriptor.RegisterSpace = 0;
+    rootParameters[2].Descriptor.Flags = D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE;
+
+    D3D12_STATIC_SAMPLER_DESC sampler = {
+        .Filter = D3D12_FILTER_ANISOTROPIC,
+        .AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP,
+        .AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP,
+        .AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP,
+        .MaxAnisotropy = 8,
+        .ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER,
+        .MaxLOD = D3D12_FLOAT32_MAX,
+        .ShaderRegister = 0,
+        .RegisterSpace = 0,
+        .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL
+    };
+
     D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
     rootSignatureDescription.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
-    rootSignatureDescription.Desc_1_1.NumParameters = _countof(rootParameters);
+    rootSignatureDescription.Desc_1_1.NumParameters = textured ? 3 : 1;
     rootSignatureDescription.Desc_1_1.pParameters = rootParameters;
-    rootSignatureDescription.Desc_1_1.NumStaticSamplers = 0;
-    rootSignatureDescription.Desc_1_1.pStaticSamplers = NULL;
+    rootSignatureDescription.Desc_1_1.NumStaticSamplers = textured ? 1 : 0;
+    rootSignatureDescription.Desc_1_1.pStaticSamplers = textured ? &sampler : NULL;
     rootSignatureDescription.Desc_1_1.Flags = rootSignatureFlags;
 
     // Serialize the root signature.
@@ -799,22 +1162,55 @@ D3D12_SHADER_BYTECODE D3D12_SHADER_BYTECODE_Init(ID3DBlob* blob)
     return bytecode;
 }
 
+// Fills the input layout matching the vertex layout, returns the number of elements.
+// The elements follow the interleaving order produced by QuantizeMesh.
+UINT CreateInputLayout(const VertexLayout* vertexLayout, D3D12_INPUT_ELEMENT_DESC inputLayout[3])
+{
+    static const DXGI_FORMAT positionFormats[] = {
+        [POSITION_FORMAT_FLOAT32] = DXGI_FORMAT_R32G32B32_FLOAT,
+        [POSITION_FORMAT_UNORM16] = DXGI_FORMAT_R16G16B16A16_UNORM,
+        [POSITION_FORMAT_FLOAT16] = DXGI_FORMAT_R16G16B16A16_FLOAT,
+    };
+    static const DXGI_FORMAT colorFormats[] = {
+        [COLOR_FORMAT_FLOAT32] = DXGI_FORMAT_R32G32B32_FLOAT,
+        [COLOR_FORMAT_UNORM8] = DXGI_FORMAT_R8G8B8A8_UNORM,
+    };
+    static const DXGI_FORMAT normalFormats[] = {
+        [NORMAL_FORMAT_NONE] = DXGI_FORMAT_UNKNOWN,
+        [NORMAL_FORMAT_FLOAT32] = DXGI_FORMAT_R32G32B32_FLOAT,
+        [NORMAL_FORMAT_OCT16] = DXGI_FORMAT_R16G16_SNORM,
+    };
+
+    UINT count = 0;
+    inputLayout[count++] = (D3D12_INPUT_ELEMENT_DESC){ "POSITION", 0, positionFormats[vertexLayout->Position], 0,
+        D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+    inputLayout[count++] = (D3D12_INPUT_ELEMENT_DESC){ "COLOR", 0, colorFormats[vertexLayout->Color], 0,
+        D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+    if (vertexLayout->Normal != NORMAL_FORMAT_NONE)
+    {
+        // Octahedral normals have to be decoded by the vertex shader
+        inputLayout[count++] = (D3D12_INPUT_ELEMENT_DESC){ "NORMAL", 0, normalFormats[vertexLayout->Normal], 0,
+            D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+    }
+
+    return count;
+}
+
 ID3D12PipelineState* CreatePipelineState(ID3D12Device2* device,
-    ID3D12RootSignature* rootSignature, ID3DBlob* vertexShaderBlob, ID3DBlob* pixelShaderBlob)
+    ID3D12RootSignature* rootSignature, ID3DBlob* vertexShaderBlob, ID3DBlob* pixelShaderBlob,
+    const VertexLayout* vertexLayout, D3D12_PRIMITIVE_TOPOLOGY_TYPE topologyType)
 {
     // Create the vertex input layout
-    D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-    };
+    D3D12_INPUT_ELEMENT_DESC inputLayout[3];
+    UINT inputLayoutCount = CreateInputLayout(vertexLayout, inputLayout);
 
     D3D12_SHADER_BYTECODE vertexShaderBytecode = D3D12_SHADER_BYTECODE_Init(vertexShaderBlob);
     D3D12_SHADER_BYTECODE pixelShaderBytecode = D3D12_SHADER_BYTECODE_Init(pixelShaderBlob);
 
     D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineStateStream = {
         .pRootSignature = rootSignature,
-        .InputLayout = { inputLayout, _countof(inputLayout) },
-        .PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE,
+        .InputLayout = { inputLayout, inputLayoutCount },
+        .PrimitiveTopologyType = topologyType,
         .RasterizerState = {
             .DepthClipEnable = TRUE,
             .FillMode = D3D12_FILL_MODE_SOLID,
@@ -849,26 +1245,143 @@ ID3D12PipelineState* CreatePipelineState(ID3D12Device2* device,
     return pipelineState;
 }
 
-void ResizeDepthBuffer(ID3D12Device2* device, int width, int height, ID3D12Resource** depthBuffer)
+// Billboards expanded from one instance each, drawn as 4 vertex strips. They're blended
+// additively and tested against the depth of the scene without writing it, so their order
+// doesn't matter.
+ID3D12PipelineState* CreateParticlePipelineState(ID3D12Device2* device,
+    ID3D12RootSignature* rootSignature, ID3DBlob* vertexShaderBlob, ID3DBlob* pixelShaderBlob)
 {
-    WaitForFenceValue(g_Fence, g_FenceValue, g_FenceEvent, 0);
-
-    width = MAX(1, width);
-    height = MAX(1, height);
+    // Laid out like ParticleInstance
+    D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT,
+          D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "SIZE", 0, DXGI_FORMAT_R32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT,
+          D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT,
+          D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+    };
 
-    // Resize screen dependent resources.
-    // Create a depth buffer.
-    D3D12_CLEAR_VALUE optimizedClearValue = {
-        .Color = { 0.0f, 0.0f, 0.0f, 0.0f },
-        .Format = DXGI_FORMAT_D32_FLOAT,
-        .DepthStencil = {
-            .Depth = 1.0f,
-            .Stencil = 0.0f
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineStateStream = {
+        .pRootSignature = rootSignature,
+        .InputLayout = { inputLayout, _countof(inputLayout) },
+        .PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE,
+        .RasterizerState = {
+            .DepthClipEnable = TRUE,
+            .FillMode = D3D12_FILL_MODE_SOLID,
+            .CullMode = D3D12_CULL_MODE_NONE
+        },
+        .VS = D3D12_SHADER_BYTECODE_Init(vertexShaderBlob),
+        .PS = D3D12_SHADER_BYTECODE_Init(pixelShaderBlob),
+        .DSVFormat = DXGI_FORMAT_D32_FLOAT,
+        .RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM,
+        .NumRenderTargets = 1,
+        .SampleDesc = {
+            .Count = 1,
+            .Quality = 0
+        },
+        .DepthStencilState = {
+            .DepthEnable = TRUE,
+            .DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO,
+            .DepthFunc = D3D12_COMPARISON_FUNC_LESS,
+            .StencilEnable = FALSE
+        },
+        .SampleMask = UINT_MAX,
+        .BlendState = {
+            .RenderTarget[0] = {
+                .BlendEnable = TRUE,
+                .SrcBlend = D3D12_BLEND_ONE,
+                .DestBlend = D3D12_BLEND_ONE,
+                .BlendOp = D3D12_BLEND_OP_ADD,
+                .SrcBlendAlpha = D3D12_BLEND_ZERO,
+                .DestBlendAlpha = D3D12_BLEND_ONE,
+                .BlendOpAlpha = D3D12_BLEND_OP_ADD,
+                .RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL
+            }
         }
     };
 
+    ID3D12PipelineState* pipelineState;
+    ExitOnFailure(ID3D12Device2_CreateGraphicsPipelineState(device, &pipelineStateStream,
+        &IID_ID3D12PipelineState, &pipelineState));
+
+    return pipelineState;
+}
+
+ID3D12RootSignature* CreateCullingRootSignature(ID3D12Device2* device)
+{
+    D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {0};
+    featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    if (FAILED(ID3D12Device2_CheckFeatureSupport(device,
+        D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
+    {
+        featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    }
+
+    // Constants, instances and the four UAVs of the culling passes as root descriptors,
+    // so no descriptor heap is needed
+    static const D3D12_ROOT_PARAMETER_TYPE parameterTypes[] = {
+        D3D12_ROOT_PARAMETER_TYPE_CBV,
+        D3D12_ROOT_PARAMETER_TYPE_SRV,
+        D3D12_ROOT_PARAMETER_TYPE_UAV,
+        D3D12_ROOT_PARAMETER_TYPE_UAV,
+        D3D12_ROOT_PARAMETER_TYPE_UAV,
+        D3D12_ROOT_PARAMETER_TYPE_UAV,
+    };
+    static const UINT shaderRegisters[] = { 0, 0, 0, 1, 2, 3 };
+
+    D3D12_ROOT_PARAMETER1 rootParameters[_countof(parameterTypes)];
+    for (int i = 0; i < _countof(parameterTypes); ++i)
+    {
+        rootParameters[i].ParameterType = parameterTypes[i];
+        rootParameters[i].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+        rootParameters[i].Descriptor.ShaderRegister = shaderRegisters[i];
+        rootParameters[i].Descriptor.RegisterSpace = 0;
+        rootParameters[i].Descriptor.Flags = D3D12_ROOT_DESCRIPTOR_FLAG_NONE;
+    }
+
+    D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+    rootSignatureDescription.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    rootSignatureDescription.Desc_1_1.NumParameters = _countof(rootParameters);
+    rootSignatureDescription.Desc_1_1.pParameters = rootParameters;
+    rootSignatureDescription.Desc_1_1.NumStaticSamplers = 0;
+    rootSignatureDescription.Desc_1_1.pStaticSamplers = NULL;
+    rootSignatureDescription.Desc_1_1.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+
+    ID3DBlob* rootSignatureBlob;
+    ID3DBlob* errorBlob;
+    ExitOnFailure(D3DX12SerializeVersionedRootSignature(&rootSignatureDescription,
+        featureData.HighestVersion, &rootSignatureBlob, &errorBlob));
+    ID3D12RootSignature* rootSignature;
+    ExitOnFailure(ID3D12Device2_CreateRootSignature(device, 0, ID3DBlob_GetBufferPointer(rootSignatureBlob),
+        ID3DBlob_GetBufferSize(rootSignatureBlob), &IID_ID3D12RootSignature, &rootSignature));
+    ID3DBlob_Release(rootSignatureBlob);
+
+    return rootSignature;
+}
+
+ID3D12PipelineState* CreateComputePipelineState(ID3D12Device2* device,
+    ID3D12RootSignature* rootSignature, LPCWSTR path)
+{
+    ID3DBlob* shaderBlob = LoadShader(path, "cs_5_1");
+
+    D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineStateDesc = {
+        .pRootSignature = rootSignature,
+        .CS = D3D12_SHADER_BYTECODE_Init(shaderBlob)
+    };
+
+    ID3D12PipelineState* pipelineState;
+    ExitOnFailure(ID3D12Device2_CreateComputePipelineState(device, &pipelineStateDesc,
+        &IID_ID3D12PipelineState, &pipelineState));
+    ID3DBlob_Release(shaderBlob);
+
+    return pipelineState;
+}
+
+ID3D12Resource* CreateBuffer(ID3D12Device2* device, D3D12_HEAP_TYPE heapType, UINT64 size,
+    D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initialState)
+{
     D3D12_HEAP_PROPERTIES heapProperties = {
-        .Type = D3D12_HEAP_TYPE_DEFAULT,
+        .Type = heapType,
         .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
         .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
         .CreationNodeMask = 1,
@@ -876,136 +1389,1598 @@ void ResizeDepthBuffer(ID3D12Device2* device, int width, int height, ID3D12Resou
     };
 
     D3D12_RESOURCE_DESC resourceDesc = {
-        .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+        .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
         .Alignment = 0,
-        .Width = width,
-        .Height = height,
+        .Width = size,
+        .Height = 1,
         .DepthOrArraySize = 1,
-        .MipLevels = 0,
-        .Format = DXGI_FORMAT_D32_FLOAT,
+        .MipLevels = 1,
+        .Format = DXGI_FORMAT_UNKNOWN,
         .SampleDesc = {
             .Count = 1,
             .Quality = 0
         },
-        .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
-        .Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL
+        .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+        .Flags = flags,
     };
 
-    if (*depthBuffer != NULL) ID3D12Resource_Release(*depthBuffer);
-    ExitOnFailure(ID3D12Device2_CreateCommittedResource(
-        device,
-        &heapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &resourceDesc,
-        D3D12_RESOURCE_STATE_DEPTH_WRITE,
-        &optimizedClearValue,
-        &IID_ID3D12Resource,
-        depthBuffer
-    ));
-
-    // Update the depth-stencil view.
-    D3D12_DEPTH_STENCIL_VIEW_DESC dsv = {
-        .Format = DXGI_FORMAT_D32_FLOAT,
-        .ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D,
-        .Texture2D.MipSlice = 0,
-        .Flags = D3D12_DSV_FLAG_NONE
-    };
+    ID3D12Resource* buffer;
+    ExitOnFailure(ID3D12Device2_CreateCommittedResource(device, &heapProperties,
+        D3D12_HEAP_FLAG_NONE, &resourceDesc, initialState,
+        NULL, &IID_ID3D12Resource, (void**)&buffer));
 
-    D3D12_CPU_DESCRIPTOR_HANDLE descHandle = {0};
-    ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(g_DSVDescriptorHeap, &descHandle);
-    ID3D12Device2_CreateDepthStencilView(device, *depthBuffer, &dsv, descHandle);
+    return buffer;
 }
 
-void UpdateModelViewMatrices()
+void CreateGpuCulling(ID3D12Device2* device, ID3D12RootSignature* graphicsRootSignature,
+    uint32_t instanceCapacity, GpuCulling* culling)
 {
-    // Update the model matrix.
-    vec3 angles = {1.0f, 0.0f, 1.0f};
-    glm_euler(angles, g_Context.ModelMatrix);
-
-    // Update the view matrix.
-    const vec3 eyePosition = {0, 0, -10};
-    const vec3 focusPoint = {0, 0, 0};
-    const vec3 upDirection = {0, 1, 0};
-    glm_lookat(eyePosition, focusPoint, upDirection, g_Context.ViewMatrix);
+    culling->InstanceCapacity = instanceCapacity;
+    culling->RootSignature = CreateCullingRootSignature(device);
+    culling->CullPipelineState = CreateComputePipelineState(device, culling->RootSignature, L"shaders/cull_instances.hlsl");
+    culling->ScanPipelineState = CreateComputePipelineState(device, culling->RootSignature, L"shaders/scan_groups.hlsl");
+    culling->CompactPipelineState = CreateComputePipelineState(device, culling->RootSignature, L"shaders/compact_draws.hlsl");
+
+    // Every command sets the MVP root constants of the graphics root signature, then draws
+    D3D12_INDIRECT_ARGUMENT_DESC arguments[2] = {
+        {
+            .Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT,
+            .Constant = {
+                .RootParameterIndex = 0,
+                .DestOffsetIn32BitValues = 0,
+                .Num32BitValuesToSet = sizeof(mat4) / sizeof(float)
+            }
+        },
+        { .Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED }
+    };
+    D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc = {
+        .ByteStride = sizeof(GpuDrawCommand),
+        .NumArgumentDescs = _countof(arguments),
+        .pArgumentDescs = arguments,
+        .NodeMask = 0
+    };
+    ExitOnFailure(ID3D12Device2_CreateCommandSignature(device, &commandSignatureDesc, graphicsRootSignature,
+        &IID_ID3D12CommandSignature, &culling->CommandSignature));
+
+    uint32_t groupCount = GpuCulling_GetGroupCount(instanceCapacity);
+    D3D12_RESOURCE_FLAGS uavFlags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    culling->Commands = CreateBuffer(device, D3D12_HEAP_TYPE_DEFAULT, (UINT64)instanceCapacity * sizeof(GpuDrawCommand),
+        uavFlags, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    culling->DrawCount = CreateBuffer(device, D3D12_HEAP_TYPE_DEFAULT, sizeof(uint32_t),
+        uavFlags, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    culling->Visibility = CreateBuffer(device, D3D12_HEAP_TYPE_DEFAULT, (UINT64)instanceCapacity * sizeof(uint32_t),
+        uavFlags, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    culling->GroupData = CreateBuffer(device, D3D12_HEAP_TYPE_DEFAULT, (UINT64)groupCount * 2 * sizeof(uint32_t),
+        uavFlags, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    culling->Readback = CreateBuffer(device, D3D12_HEAP_TYPE_READBACK,
+        CULLING_DATA_OFFSET + (UINT64)instanceCapacity * sizeof(GpuDrawCommand),
+        D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+
+    ID3D12Object_SetName(culling->Commands, L"IndirectCommands");
+    ID3D12Object_SetName(culling->DrawCount, L"IndirectDrawCount");
+
+    // The upload buffers stay mapped, the frame fence guards each one before it's rewritten
+    for (int i = 0; i < FRAMES_NUM; ++i)
+    {
+        culling->UploadBuffers[i] = CreateBuffer(device, D3D12_HEAP_TYPE_UPLOAD,
+            CULLING_DATA_OFFSET + (UINT64)instanceCapacity * sizeof(GpuCullInstance),
+            D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
+        D3D12_RANGE readRange = { 0, 0 };
+        ExitOnFailure(ID3D12Resource_Map(culling->UploadBuffers[i], 0, &readRange, (void**)&culling->UploadData[i]));
+    }
 }
 
-void Update()
+void ReleaseGpuCulling(GpuCulling* culling)
 {
-    static uint64_t frameCounter = 0;
-    static double elapsedSeconds = 0.0;
-    static clock_t t0;
-
-    frameCounter++;
-    clock_t t1 = clock();
-    clock_t deltaTime = t1 - t0;
-    t0 = t1;
+    for (int i = 0; i < FRAMES_NUM; ++i)
+    {
+        ID3D12Resource_Unmap(culling->UploadBuffers[i], 0, NULL);
+        ID3D12Resource_Release(culling->UploadBuffers[i]);
+    }
+    ID3D12Resource_Release(culling->Readback);
+    ID3D12Resource_Release(culling->GroupData);
+    ID3D12Resource_Release(culling->Visibility);
+    ID3D12Resource_Release(culling->DrawCount);
+    ID3D12Resource_Release(culling->Commands);
+    ID3D12CommandSignature_Release(culling->CommandSignature);
+    ID3D12PipelineState_Release(culling->CompactPipelineState);
+    ID3D12PipelineState_Release(culling->ScanPipelineState);
+    ID3D12PipelineState_Release(culling->CullPipelineState);
+    ID3D12RootSignature_Release(culling->RootSignature);
+}
 
-    elapsedSeconds += (double)deltaTime / CLOCKS_PER_SEC;
-    if (elapsedSeconds > 1.0)
+void CreateDrawBundles(ID3D12Device2* device, ID3D12RootSignature* rootSignature,
+    ID3DBlob* vertexShaderBlob, ID3DBlob* pixelShaderBlob, size_t capacity, DrawBundles* bundles)
+{
+    bundles->PipelineState = CreatePipelineState(device, rootSignature, vertexShaderBlob, pixelShaderBlob,
+        &g_VertexLayout, D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
+    bundles->Capacity = MAX(capacity, 1);
+    for (int i = 0; i < FRAMES_NUM; ++i)
     {
-        char buffer[500];
-        double fps = frameCounter / elapsedSeconds;
-        sprintf_s(buffer, 500, "FPS: %f\n", fps);
-        OutputDebugString(buffer);
+        bundles->Allocators[i] = CreateCommandAllocator(device, D3D12_COMMAND_LIST_TYPE_BUNDLE);
+        bundles->Bundles[i] = CreateCommandList(device, bundles->Allocators[i], D3D12_COMMAND_LIST_TYPE_BUNDLE);
+        ID3D12Object_SetName(bundles->Bundles[i], L"DrawBundle");
+
+        // The buffers stay mapped, the frame fence guards each one before it's rewritten
+        bundles->MvpBuffers[i] = CreateBuffer(device, D3D12_HEAP_TYPE_UPLOAD, (UINT64)bundles->Capacity * sizeof(mat4),
+            D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
+        ID3D12Object_SetName(bundles->MvpBuffers[i], L"BundleMvps");
+        D3D12_RANGE readRange = { 0, 0 };
+        ExitOnFailure(ID3D12Resource_Map(bundles->MvpBuffers[i], 0, &readRange, (void**)&bundles->MvpData[i]));
+
+        bundles->Packets[i] = malloc(bundles->Capacity * sizeof(DrawPacket));
+        if (bundles->Packets[i] == NULL)
+            exit(HD_EXIT_FAILURE);
+        bundles->PacketCounts[i] = 0;
+        bundles->Recorded[i] = false;
+    }
+}
 
-        frameCounter = 0;
-        elapsedSeconds = 0.0;
+void ReleaseDrawBundles(DrawBundles* bundles)
+{
+    for (int i = 0; i < FRAMES_NUM; ++i)
+    {
+        free(bundles->Packets[i]);
+        ID3D12Resource_Unmap(bundles->MvpBuffers[i], 0, NULL);
+        ID3D12Resource_Release(bundles->MvpBuffers[i]);
+        ID3D12GraphicsCommandList_Release(bundles->Bundles[i]);
+        ID3D12CommandAllocator_Release(bundles->Allocators[i]);
     }
+    ID3D12PipelineState_Release(bundles->PipelineState);
 }
 
-void Render(IDXGISwapChain4* swapChain, ID3D12CommandQueue* g_CommandQueue,
-            ID3D12GraphicsCommandList* commandList, ID3D12PipelineState* pipelineState,
-            ID3D12RootSignature* rootSignature, D3D12_VERTEX_BUFFER_VIEW* vertexBufferView,
-            D3D12_INDEX_BUFFER_VIEW* indexBufferView, D3D12_VIEWPORT* viewport,
-            D3D12_RECT* scisssorRect)
+void CreateDebugLines(ID3D12Device2* device, ID3D12RootSignature* rootSignature,
+    ID3DBlob* vertexShaderBlob, ID3DBlob* pixelShaderBlob, DebugLines* lines)
 {
-    ID3D12CommandAllocator* commandAllocator = g_CommandAllocators[g_CurrentBackBufferIndex];
-    ID3D12Resource* backBuffer = g_BackBuffers[g_CurrentBackBufferIndex];
+    lines->PipelineState = CreatePipelineState(device, rootSignature, vertexShaderBlob, pixelShaderBlob,
+        &g_DebugVertexLayout, D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE);
+
+    // Mapped for its whole lifetime, a region per frame in flight
+    lines->Resource = CreateBuffer(device, D3D12_HEAP_TYPE_UPLOAD, (UINT64)DEBUG_LINE_REGION_SIZE * FRAMES_NUM,
+        D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
+    ID3D12Object_SetName(lines->Resource, L"DebugLineVertices");
+
+    void* data;
+    D3D12_RANGE readRange = { 0, 0 };
+    ExitOnFailure(ID3D12Resource_Map(lines->Resource, 0, &readRange, &data));
+    DynamicBuffer_Init(&lines->Vertices, data, ID3D12Resource_GetGPUVirtualAddress(lines->Resource),
+        DEBUG_LINE_REGION_SIZE, FRAMES_NUM);
+}
 
-    ID3D12CommandAllocator_Reset(commandAllocator);
-    ID3D12GraphicsCommandList_Reset(commandList, commandAllocator, NULL);
+void ReleaseDebugLines(DebugLines* lines)
+{
+    ID3D12Resource_Unmap(lines->Resource, 0, NULL);
+    ID3D12Resource_Release(lines->Resource);
+    ID3D12PipelineState_Release(lines->PipelineState);
+}
+
+void CreateParticleBillboards(ID3D12Device2* device, ParticleBillboards* billboards)
+{
+    ID3DBlob* vertexShaderBlob = LoadShader(L"shaders/particle_vertex.hlsl", "vs_5_1");
+    ID3DBlob* pixelShaderBlob = LoadShader(L"shaders/particle_pixel.hlsl", "ps_5_1");
+    billboards->RootSignature = CreateRootSignature(device, sizeof(ParticleConstants) / sizeof(float), false);
+    billboards->PipelineState = CreateParticlePipelineState(device, billboards->RootSignature,
+        vertexShaderBlob, pixelShaderBlob);
+    ID3DBlob_Release(vertexShaderBlob);
+    ID3DBlob_Release(pixelShaderBlob);
+
+    // Mapped for its whole lifetime, a region of instances per frame in flight
+    size_t regionSize = PARTICLE_CAPACITY * sizeof(ParticleInstance);
+    billboards->Resource = CreateBuffer(device, D3D12_HEAP_TYPE_UPLOAD, (UINT64)regionSize * FRAMES_NUM,
+        D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
+    ID3D12Object_SetName(billboards->Resource, L"ParticleInstances");
+
+    void* data;
+    D3D12_RANGE readRange = { 0, 0 };
+    ExitOnFailure(ID3D12Resource_Map(billboards->Resource, 0, &readRange, &data));
+    DynamicBuffer_Init(&billboards->Instances, data, ID3D12Resource_GetGPUVirtualAddress(billboards->Resource),
+        regionSize, FRAMES_NUM);
+}
+
+void ReleaseParticleBillboards(ParticleBillboards* billboards)
+{
+    ID3D12Resource_Unmap(billboards->Resource, 0, NULL);
+    ID3D12Resource_Release(billboards->Resource);
+    ID3D12PipelineState_Release(billboards->PipelineState);
+    ID3D12RootSignature_Release(billboards->RootSignature);
+}
+
+double GetElapsedMilliseconds(LARGE_INTEGER start, LARGE_INTEGER end)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+}
+
+DXGI_FORMAT GetDxgiFormat(TextureFormat format, bool srgb)
+{
+    static const DXGI_FORMAT formats[][2] = {
+        [TEXTURE_FORMAT_UNKNOWN] = { DXGI_FORMAT_UNKNOWN, DXGI_FORMAT_UNKNOWN },
+        [TEXTURE_FORMAT_RGBA8] = { DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB },
+        [TEXTURE_FORMAT_BC1] = { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC1_UNORM_SRGB },
+        [TEXTURE_FORMAT_BC3] = { DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC3_UNORM_SRGB },
+        // Normals and other data, never sRGB
+        [TEXTURE_FORMAT_BC5] = { DXGI_FORMAT_BC5_UNORM, DXGI_FORMAT_BC5_UNORM },
+        [TEXTURE_FORMAT_BC7] = { DXGI_FORMAT_BC7_UNORM, DXGI_FORMAT_BC7_UNORM_SRGB },
+    };
+    return formats[format][srgb ? 1 : 0];
+}
+
+void CreateMipGenerator(ID3D12Device2* device, MipGenerator* generator)
+{
+    D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {0};
+    featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    if (FAILED(ID3D12Device2_CheckFeatureSupport(device,
+        D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
+    {
+        featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    }
+
+    // The sizes as constants, then the source level and the destination level next to each
+    // other in the heap
+    D3D12_DESCRIPTOR_RANGE1 ranges[2] = {
+        {
+            .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
+            .NumDescriptors = 1,
+            .BaseShaderRegister = 0,
+            .RegisterSpace = 0,
+            .Flags = D3D12_DESCRIPTOR_RANGE_FLAG_NONE,
+            .OffsetInDescriptorsFromTableStart = 0
+        },
+        {
+            .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV,
+            .NumDescriptors = 1,
+            .BaseShaderRegister = 0,
+            .RegisterSpace = 0,
+            .Flags = D3D12_DESCRIPTOR_RANGE_FLAG_NONE,
+            .OffsetInDescriptorsFromTableStart = 1
+        }
+    };
+    D3D12_ROOT_PARAMETER1 rootParameters[2];
+    rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    rootParameters[0].Constants.Num32BitValues = sizeof(MipConstants) / sizeof(uint32_t);
+    rootParameters[0].Constants.ShaderRegister = 0;
+    rootParameters[0].Constants.RegisterSpace = 0;
+    rootParameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    rootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    rootParameters[1].DescriptorTable.NumDescriptorRanges = _countof(ranges);
+    rootParameters[1].DescriptorTable.pDescriptorRanges = ranges;
+
+    D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+    rootSignatureDescription.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    rootSignatureDescription.Desc_1_1.NumParameters = _countof(rootParameters);
+    rootSignatureDescription.Desc_1_1.pParameters = rootParameters;
+    rootSignatureDescription.Desc_1_1.NumStaticSamplers = 0;
+    rootSignatureDescription.Desc_1_1.pStaticSamplers = NULL;
+    rootSignatureDescription.Desc_1_1.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+
+    ID3DBlob* rootSignatureBlob;
+    ID3DBlob* errorBlob;
+    ExitOnFailure(D3DX12SerializeVersionedRootSignature(&rootSignatureDescription,
+        featureData.HighestVersion, &rootSignatureBlob, &errorBlob));
+    ExitOnFailure(ID3D12Device2_CreateRootSignature(device, 0, ID3DBlob_GetBufferPointer(rootSignatureBlob),
+        ID3DBlob_GetBufferSize(rootSignatureBlob), &IID_ID3D12RootSignature, &generator->RootSignature));
+    ID3DBlob_Release(rootSignatureBlob);
+
+    generator->PipelineState = CreateComputePipelineState(device, generator->RootSignature, L"shaders/generate_mips.hlsl");
+}
+
+void ReleaseMipGenerator(MipGenerator* generator)
+{
+    ID3D12PipelineState_Release(generator->PipelineState);
+    ID3D12RootSignature_Release(generator->RootSignature);
+}
+
+// Records a dispatch per level, each filtering the level above. The resource has to be
+// R8G8B8A8_TYPELESS with unordered access, level 0 in NON_PIXEL_SHADER_RESOURCE and the others
+// in UNORDERED_ACCESS. Every level ends in NON_PIXEL_SHADER_RESOURCE. The shader visible heap
+// needs 2 descriptors for each level below the first.
+void RecordMipGeneration(ID3D12Device2* device, ID3D12GraphicsCommandList* commandList,
+    const MipGenerator* generator, ID3D12DescriptorHeap* descriptorHeap, ID3D12Resource* resource,
+    uint32_t width, uint32_t height, uint32_t levelCount, bool srgb)
+{
+    UINT descriptorSize = ID3D12Device2_GetDescriptorHandleIncrementSize(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle;
+    D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle;
+    ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(descriptorHeap, &cpuHandle);
+    ID3D12DescriptorHeap_GetGPUDescriptorHandleForHeapStart(descriptorHeap, &gpuHandle);
+
+    ID3D12GraphicsCommandList_SetComputeRootSignature(commandList, generator->RootSignature);
+    ID3D12GraphicsCommandList_SetPipelineState(commandList, generator->PipelineState);
+    ID3D12DescriptorHeap* const heaps[] = { descriptorHeap };
+    ID3D12GraphicsCommandList_SetDescriptorHeaps(commandList, _countof(heaps), heaps);
+
+    for (uint32_t level = 1; level < levelCount; ++level)
+    {
+        // The sRGB view decodes before the shader filters, UAVs can't be sRGB so it encodes
+        D3D12_SHADER_RESOURCE_VIEW_DESC sourceDesc = {
+            .Format = srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM,
+            .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
+            .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+            .Texture2D = {
+                .MostDetailedMip = level - 1,
+                .MipLevels = 1
+            }
+        };
+        D3D12_UNORDERED_ACCESS_VIEW_DESC destinationDesc = {
+            .Format = DXGI_FORMAT_R8G8B8A8_UNORM,
+            .ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D,
+            .Texture2D = {
+                .MipSlice = level
+            }
+        };
+        INT first = (INT)(level - 1) * 2;
+        ID3D12Device2_CreateShaderResourceView(device, resource, &sourceDesc,
+            D3D12_CPU_DESCRIPTOR_HANDLE_Offset(cpuHandle, first, descriptorSize));
+        ID3D12Device2_CreateUnorderedAccessView(device, resource, NULL, &destinationDesc,
+            D3D12_CPU_DESCRIPTOR_HANDLE_Offset(cpuHandle, first + 1, descriptorSize));
+
+        MipConstants constants = {
+            .SourceSize = { MAX(width >> (level - 1), 1), MAX(height >> (level - 1), 1) },
+            .DestinationSize = { MAX(width >> level, 1), MAX(height >> level, 1) },
+            .Srgb = srgb ? 1 : 0
+        };
+        D3D12_GPU_DESCRIPTOR_HANDLE table = { gpuHandle.ptr + (UINT64)first * descriptorSize };
+        ID3D12GraphicsCommandList_SetComputeRoot32BitConstants(commandList, 0,
+            sizeof(constants) / sizeof(uint32_t), &constants, 0);
+        ID3D12GraphicsCommandList_SetComputeRootDescriptorTable(commandList, 1, table);
+        ID3D12GraphicsCommandList_Dispatch(commandList,
+            (constants.DestinationSize[0] + MIP_GROUP_SIZE - 1) / MIP_GROUP_SIZE,
+            (constants.DestinationSize[1] + MIP_GROUP_SIZE - 1) / MIP_GROUP_SIZE, 1);
+
+        // The next level reads this one
+        D3D12_RESOURCE_BARRIER barrier = D3D12_RESOURCE_BARRIER_Transition(resource,
+                                                    D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                                                    D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                                                    level, D3D12_RESOURCE_BARRIER_FLAG_NONE);
+        ID3D12GraphicsCommandList_ResourceBarrier(commandList, 1, &barrier);
+    }
+}
+
+// Uploads every mip of the texture through a single intermediate buffer and waits for the
+// copy, then creates its view in a shader visible heap of its own. An RGBA8 texture without
+// mips gets its full chain generated on the GPU when a mip generator is given.
+void CreateSceneTexture(ID3D12Device2* device, ID3D12CommandQueue* commandQueue,
+    ID3D12CommandAllocator* commandAllocator, ID3D12GraphicsCommandList* commandList,
+    const MipGenerator* mipGenerator, const DdsTexture* source, SceneTexture* texture)
+{
+    bool generateMips = mipGenerator != NULL && source->Format == TEXTURE_FORMAT_RGBA8 && source->MipCount == 1;
+    uint32_t mipCount = generateMips ? GetMipLevelCount(source->Width, source->Height) : source->MipCount;
+    DXGI_FORMAT viewFormat = GetDxgiFormat(source->Format, source->Srgb);
+
+    D3D12_HEAP_PROPERTIES heapProperties = {
+        .Type = D3D12_HEAP_TYPE_DEFAULT,
+        .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+        .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
+        .CreationNodeMask = 1,
+        .VisibleNodeMask = 1
+    };
+
+    D3D12_RESOURCE_DESC resourceDesc = {
+        .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+        .Alignment = 0,
+        .Width = source->Width,
+        .Height = source->Height,
+        .DepthOrArraySize = 1,
+        .MipLevels = (UINT16)mipCount,
+        // The generated levels are written through a UNORM view of the same texels
+        .Format = generateMips ? DXGI_FORMAT_R8G8B8A8_TYPELESS : viewFormat,
+        .SampleDesc = {
+            .Count = 1,
+            .Quality = 0
+        },
+        .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+        .Flags = generateMips ? D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS : D3D12_RESOURCE_FLAG_NONE,
+    };
+
+    ExitOnFailure(ID3D12Device2_CreateCommittedResource(device, &heapProperties,
+        D3D12_HEAP_FLAG_NONE, &resourceDesc, D3D12_RESOURCE_STATE_COPY_DEST,
+        NULL, &IID_ID3D12Resource, (void**)&texture->Resource));
+    ID3D12Object_SetName(texture->Resource, L"SceneTexture");
+
+    UINT64 intermediateSize = 0;
+    ID3D12Device2_GetCopyableFootprints(device, &resourceDesc, 0, source->MipCount, 0,
+        NULL, NULL, NULL, &intermediateSize);
+    ID3D12Resource* intermediate = CreateBuffer(device, D3D12_HEAP_TYPE_UPLOAD, intermediateSize,
+        D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    // Rows of blocks for the compressed formats, the footprints count them the same way
+    D3D12_SUBRESOURCE_DATA subresources[DDS_MAX_MIPS];
+    for (uint32_t i = 0; i < source->MipCount; ++i)
+    {
+        subresources[i].pData = source->Mips[i].Data;
+        subresources[i].RowPitch = (LONG_PTR)source->Mips[i].RowPitch;
+        subresources[i].SlicePitch = (LONG_PTR)source->Mips[i].SlicePitch;
+    }
+
+    ID3D12CommandAllocator_Reset(commandAllocator);
+    ID3D12GraphicsCommandList_Reset(commandList, commandAllocator, NULL);
+    UpdateSubresources(commandList, texture->Resource, intermediate, 0, 0, source->MipCount, subresources);
+
+    ID3D12DescriptorHeap* mipHeap = NULL;
+    D3D12_RESOURCE_STATES uploadedState = D3D12_RESOURCE_STATE_COPY_DEST;
+    if (generateMips)
+    {
+        D3D12_RESOURCE_BARRIER mipBarriers[MIP_MAX_LEVELS];
+        for (uint32_t i = 0; i < mipCount; ++i)
+        {
+            mipBarriers[i] = D3D12_RESOURCE_BARRIER_Transition(texture->Resource, D3D12_RESOURCE_STATE_COPY_DEST,
+                i == 0 ? D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE : D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                i, D3D12_RESOURCE_BARRIER_FLAG_NONE);
+        }
+        ID3D12GraphicsCommandList_ResourceBarrier(commandList, mipCount, mipBarriers);
+
+        mipHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, MAX(2 * (mipCount - 1), 1),
+                                       D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE);
+        RecordMipGeneration(device, commandList, mipGenerator, mipHeap, texture->Resource,
+            source->Width, source->Height, mipCount, source->Srgb);
+        uploadedState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+    }
+
+    D3D12_RESOURCE_BARRIER barrier = D3D12_RESOURCE_BARRIER_Transition(texture->Resource,
+                                                uploadedState,
+                                                D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+                                                D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+                                                D3D12_RESOURCE_BARRIER_FLAG_NONE);
+    ID3D12GraphicsCommandList_ResourceBarrier(commandList, 1, &barrier);
+    ExitOnFailure(ID3D12GraphicsCommandList_Close(commandList));
+
+    ID3D12CommandList* const commandLists[] = { (ID3D12CommandList* const)commandList };
+    ID3D12CommandQueue_ExecuteCommandLists(commandQueue, _countof(commandLists), commandLists);
+
+    uint64_t fenceValue = Signal(commandQueue, g_Fence, &g_FenceValue);
+    WaitForFenceValue(g_Fence, fenceValue, g_FenceEvent, 0);
+    ID3D12Resource_Release(intermediate);
+    if (mipHeap != NULL)
+        ID3D12DescriptorHeap_Release(mipHeap);
+
+    texture->DescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1,
+                                                   D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE);
+    D3D12_SHADER_RESOURCE_VIEW_DESC viewDesc = {
+        .Format = viewFormat,
+        .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
+        .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+        .Texture2D = {
+            .MostDetailedMip = 0,
+            .MipLevels = mipCount
+        }
+    };
+    D3D12_CPU_DESCRIPTOR_HANDLE viewHandle;
+    ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(texture->DescriptorHeap, &viewHandle);
+    ID3D12Device2_CreateShaderResourceView(device, texture->Resource, &viewDesc, viewHandle);
+    ID3D12DescriptorHeap_GetGPUDescriptorHandleForHeapStart(texture->DescriptorHeap, &texture->View);
+}
+
+void ReleaseSceneTexture(SceneTexture* texture)
+{
+    ID3D12DescriptorHeap_Release(texture->DescriptorHeap);
+    ID3D12Resource_Release(texture->Resource);
+}
+
+// Tiles with a bevelled edge, filtered down to 1x1 and every level compressed to BC7 the way
+// the texture compressor would. The blocks are handed over as the file data, so Dds_Release
+// frees them.
+bool CreateFallbackTexture(DdsTexture* texture)
+{
+    const uint32_t size = FALLBACK_TEXTURE_SIZE;
+    uint8_t* rgba = malloc((size_t)size * size * 4);
+    if (rgba == NULL)
+        return false;
+
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            uint32_t tileX = x % (size / 4);
+            uint32_t tileY = y % (size / 4);
+            uint32_t edge = MIN(MIN(tileX, size / 4 - 1 - tileX), MIN(tileY, size / 4 - 1 - tileY));
+            uint8_t shade = (uint8_t)(edge < 4 ? 96 + edge * 32 : 224 - ((x / (size / 4) + y / (size / 4)) & 1) * 32);
+
+            uint8_t* pixel = rgba + ((size_t)y * size + x) * 4;
+            pixel[0] = shade;
+            pixel[1] = shade;
+            pixel[2] = shade;
+            pixel[3] = 255;
+        }
+    }
+
+    // Stored as it's displayed, the back buffer isn't sRGB either
+    LARGE_INTEGER start, filtered, end;
+    QueryPerformanceCounter(&start);
+    MipChain mips;
+    bool generated = GenerateMips(rgba, size, size, (size_t)size * 4, false, MIP_FILTER_BOX, 0, &mips);
+    free(rgba);
+    QueryPerformanceCounter(&filtered);
+    if (!generated)
+        return false;
+
+    memset(texture, 0, sizeof(*texture));
+    size_t blocksSize = 0;
+    for (uint32_t i = 0; i < mips.LevelCount; ++i)
+    {
+        blocksSize += TextureFormat_GetRowPitch(TEXTURE_FORMAT_BC7, mips.Levels[i].Width) *
+                      TextureFormat_GetRowCount(TEXTURE_FORMAT_BC7, mips.Levels[i].Height);
+    }
+    uint8_t* blocks = malloc(blocksSize);
+    bool compressed = blocks != NULL;
+
+    size_t offset = 0;
+    for (uint32_t i = 0; compressed && i < mips.LevelCount; ++i)
+    {
+        const MipLevel* level = &mips.Levels[i];
+        size_t rowPitch = TextureFormat_GetRowPitch(TEXTURE_FORMAT_BC7, level->Width);
+        size_t slicePitch = rowPitch * TextureFormat_GetRowCount(TEXTURE_FORMAT_BC7, level->Height);
+        compressed = CompressImage(level->Rgba, level->Width, level->Height, level->RowPitch,
+                                   TEXTURE_FORMAT_BC7, blocks + offset);
+        texture->Mips[i] = (DdsMip){ blocks + offset, level->Width, level->Height, rowPitch, slicePitch };
+        offset += slicePitch;
+    }
+    QueryPerformanceCounter(&end);
+    uint32_t levelCount = mips.LevelCount;
+    MipChain_Release(&mips);
+    if (!compressed)
+    {
+        free(blocks);
+        return false;
+    }
+
+    char buffer[500];
+    sprintf_s(buffer, 500, "Filtered the fallback texture in %.2f ms, compressed it in %.2f ms\n",
+              GetElapsedMilliseconds(start, filtered), GetElapsedMilliseconds(filtered, end));
+    OutputDebugString(buffer);
+
+    texture->Format = TEXTURE_FORMAT_BC7;
+    texture->Srgb = false;
+    texture->Width = size;
+    texture->Height = size;
+    texture->MipCount = levelCount;
+    texture->FileData = blocks;
+    return true;
+}
+
+void ResizeDepthBuffer(ID3D12Device2* device, int width, int height, ID3D12Resource** depthBuffer)
+{
+    WaitForFenceValue(g_Fence, g_FenceValue, g_FenceEvent, 0);
+
+    width = MAX(1, width);
+    height = MAX(1, height);
+
+    // Resize screen dependent resources.
+    // Create a depth buffer.
+    D3D12_CLEAR_VALUE optimizedClearValue = {
+        .Color = { 0.0f, 0.0f, 0.0f, 0.0f },
+        .Format = DXGI_FORMAT_D32_FLOAT,
+        .DepthStencil = {
+            .Depth = 1.0f,
+            .Stencil = 0.0f
+        }
+    };
+
+    D3D12_HEAP_PROPERTIES heapProperties = {
+        .Type = D3D12_HEAP_TYPE_DEFAULT,
+        .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+        .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
+        .CreationNodeMask = 1,
+        .VisibleNodeMask = 1
+    };
+
+    D3D12_RESOURCE_DESC resourceDesc = {
+        .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+        .Alignment = 0,
+        .Width = width,
+        .Height = height,
+        .DepthOrArraySize = 1,
+        .MipLevels = 0,
+        .Format = DXGI_FORMAT_D32_FLOAT,
+        .SampleDesc = {
+            .Count = 1,
+            .Quality = 0
+        },
+        .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+        .Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL
+    };
+
+    if (*depthBuffer != NULL) ID3D12Resource_Release(*depthBuffer);
+    ExitOnFailure(ID3D12Device2_CreateCommittedResource(
+        device,
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &resourceDesc,
+        D3D12_RESOURCE_STATE_DEPTH_WRITE,
+        &optimizedClearValue,
+        &IID_ID3D12Resource,
+        depthBuffer
+    ));
+
+    // Update the depth-stencil view.
+    D3D12_DEPTH_STENCIL_VIEW_DESC dsv = {
+        .Format = DXGI_FORMAT_D32_FLOAT,
+        .ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D,
+        .Texture2D.MipSlice = 0,
+        .Flags = D3D12_DSV_FLAG_NONE
+    };
+
+    D3D12_CPU_DESCRIPTOR_HANDLE descHandle = {0};
+    ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(g_DSVDescriptorHeap, &descHandle);
+    ID3D12Device2_CreateDepthStencilView(device, *depthBuffer, &dsv, descHandle);
+}
+
+// Root signature and pipeline of the pass stretching the scene onto the back buffer, the
+// timestamp queries timing the frames and the controller picking the scale from them. The
+// color target is created by ResizeScaledScene.
+void CreateScaledScene(ID3D12Device2* device, ID3D12CommandQueue* commandQueue, ScaledScene* scene)
+{
+    memset(scene, 0, sizeof(*scene));
+
+    D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {0};
+    featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    if (FAILED(ID3D12Device2_CheckFeatureSupport(device,
+        D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
+    {
+        featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    }
+
+    // The constants, then the color target. It's drawn to every frame, so its data isn't static.
+    D3D12_DESCRIPTOR_RANGE1 sceneRange = {
+        .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
+        .NumDescriptors = 1,
+        .BaseShaderRegister = 0,
+        .RegisterSpace = 0,
+        .Flags = D3D12_DESCRIPTOR_RANGE_FLAG_NONE,
+        .OffsetInDescriptorsFromTableStart = 0
+    };
+    D3D12_ROOT_PARAMETER1 rootParameters[2];
+    rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+    rootParameters[0].Constants.Num32BitValues = sizeof(UpscaleConstants) / sizeof(float);
+    rootParameters[0].Constants.ShaderRegister = 0;
+    rootParameters[0].Constants.RegisterSpace = 0;
+    rootParameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    rootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+    rootParameters[1].DescriptorTable.NumDescriptorRanges = 1;
+    rootParameters[1].DescriptorTable.pDescriptorRanges = &sceneRange;
+
+    D3D12_STATIC_SAMPLER_DESC sampler = {
+        .Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR,
+        .AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+        .AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+        .AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+        .ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER,
+        .MaxLOD = D3D12_FLOAT32_MAX,
+        .ShaderRegister = 0,
+        .RegisterSpace = 0,
+        .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL
+    };
+
+    D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDescription;
+    rootSignatureDescription.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    rootSignatureDescription.Desc_1_1.NumParameters = _countof(rootParameters);
+    rootSignatureDescription.Desc_1_1.pParameters = rootParameters;
+    rootSignatureDescription.Desc_1_1.NumStaticSamplers = 1;
+    rootSignatureDescription.Desc_1_1.pStaticSamplers = &sampler;
+    rootSignatureDescription.Desc_1_1.Flags =
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+
+    ID3DBlob* rootSignatureBlob;
+    ID3DBlob* errorBlob;
+    ExitOnFailure(D3DX12SerializeVersionedRootSignature(&rootSignatureDescription,
+        featureData.HighestVersion, &rootSignatureBlob, &errorBlob));
+    ExitOnFailure(ID3D12Device2_CreateRootSignature(device, 0, ID3DBlob_GetBufferPointer(rootSignatureBlob),
+        ID3DBlob_GetBufferSize(rootSignatureBlob), &IID_ID3D12RootSignature, &scene->RootSignature));
+    ID3DBlob_Release(rootSignatureBlob);
+
+    // A triangle covering the back buffer, generated from the vertex IDs without any input
+    ID3DBlob* vertexShaderBlob = LoadShader(L"shaders/upscale_vertex.hlsl", "vs_5_1");
+    ID3DBlob* pixelShaderBlob = LoadShader(L"shaders/upscale_pixel.hlsl", "ps_5_1");
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineStateStream = {
+        .pRootSignature = scene->RootSignature,
+        .PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE,
+        .RasterizerState = {
+            .DepthClipEnable = TRUE,
+            .FillMode = D3D12_FILL_MODE_SOLID,
+            .CullMode = D3D12_CULL_MODE_NONE
+        },
+        .VS = D3D12_SHADER_BYTECODE_Init(vertexShaderBlob),
+        .PS = D3D12_SHADER_BYTECODE_Init(pixelShaderBlob),
+        .RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM,
+        .NumRenderTargets = 1,
+        .SampleDesc = {
+            .Count = 1,
+            .Quality = 0
+        },
+        .SampleMask = UINT_MAX,
+        .BlendState = {
+            .RenderTarget[0] = {
+                .RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL
+            }
+        }
+    };
+    ExitOnFailure(ID3D12Device2_CreateGraphicsPipelineState(device, &pipelineStateStream,
+        &IID_ID3D12PipelineState, &scene->PipelineState));
+    ID3DBlob_Release(vertexShaderBlob);
+    ID3DBlob_Release(pixelShaderBlob);
+
+    scene->RenderTargetHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 1,
+                                                   D3D12_DESCRIPTOR_HEAP_FLAG_NONE);
+    scene->DescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1,
+                                                 D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE);
+    ID3D12DescriptorHeap_GetGPUDescriptorHandleForHeapStart(scene->DescriptorHeap, &scene->View);
+
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {
+        .Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP,
+        .Count = 2 * FRAMES_NUM,
+        .NodeMask = 0
+    };
+    ExitOnFailure(ID3D12Device2_CreateQueryHeap(device, &queryHeapDesc, &IID_ID3D12QueryHeap, &scene->QueryHeap));
+    scene->Readback = CreateBuffer(device, D3D12_HEAP_TYPE_READBACK, 2 * FRAMES_NUM * sizeof(uint64_t),
+        D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+    ExitOnFailure(ID3D12CommandQueue_GetTimestampFrequency(commandQueue, &scene->TimestampFrequency));
+
+    DynamicResolutionSettings settings;
+    DynamicResolution_GetDefaultSettings(&settings, DYNAMIC_RESOLUTION_TARGET_MS);
+    DynamicResolution_Init(&scene->Controller, &settings);
+    scene->Scale = scene->Controller.Scale;
+}
+
+// Recreates the color target at the window size once the GPU is done with it. It's left in
+// PIXEL_SHADER_RESOURCE, the state every frame ends with.
+void ResizeScaledScene(ID3D12Device2* device, int width, int height, ScaledScene* scene)
+{
+    WaitForFenceValue(g_Fence, g_FenceValue, g_FenceEvent, 0);
+
+    width = MAX(1, width);
+    height = MAX(1, height);
+
+    D3D12_CLEAR_VALUE optimizedClearValue = {
+        .Format = DXGI_FORMAT_R8G8B8A8_UNORM,
+        .Color = { g_ClearColor[0], g_ClearColor[1], g_ClearColor[2], g_ClearColor[3] }
+    };
+
+    D3D12_HEAP_PROPERTIES heapProperties = {
+        .Type = D3D12_HEAP_TYPE_DEFAULT,
+        .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+        .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
+        .CreationNodeMask = 1,
+        .VisibleNodeMask = 1
+    };
+
+    D3D12_RESOURCE_DESC resourceDesc = {
+        .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+        .Alignment = 0,
+        .Width = width,
+        .Height = height,
+        .DepthOrArraySize = 1,
+        .MipLevels = 1,
+        .Format = DXGI_FORMAT_R8G8B8A8_UNORM,
+        .SampleDesc = {
+            .Count = 1,
+            .Quality = 0
+        },
+        .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+        .Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET
+    };
+
+    if (scene->ColorBuffer != NULL) ID3D12Resource_Release(scene->ColorBuffer);
+    ExitOnFailure(ID3D12Device2_CreateCommittedResource(device, &heapProperties,
+        D3D12_HEAP_FLAG_NONE, &resourceDesc, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+        &optimizedClearValue, &IID_ID3D12Resource, (void**)&scene->ColorBuffer));
+    ID3D12Object_SetName(scene->ColorBuffer, L"SceneColor");
+
+    D3D12_CPU_DESCRIPTOR_HANDLE descHandle;
+    ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(scene->RenderTargetHeap, &descHandle);
+    ID3D12Device2_CreateRenderTargetView(device, scene->ColorBuffer, NULL, descHandle);
+    ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(scene->DescriptorHeap, &descHandle);
+    ID3D12Device2_CreateShaderResourceView(device, scene->ColorBuffer, NULL, descHandle);
+}
+
+void ReleaseScaledScene(ScaledScene* scene)
+{
+    ID3D12Resource_Release(scene->Readback);
+    ID3D12QueryHeap_Release(scene->QueryHeap);
+    ID3D12DescriptorHeap_Release(scene->DescriptorHeap);
+    ID3D12DescriptorHeap_Release(scene->RenderTargetHeap);
+    ID3D12Resource_Release(scene->ColorBuffer);
+    ID3D12PipelineState_Release(scene->PipelineState);
+    ID3D12RootSignature_Release(scene->RootSignature);
+}
+
+void UpdateDequantizeMatrix(QuantizedMesh* mesh)
+{
+    glm_translate_make(g_Context.DequantizeMatrix, mesh->DequantizeOffset);
+    glm_scale(g_Context.DequantizeMatrix, mesh->DequantizeScale);
+}
+
+void ReportQuantizationStats(const char* name, const QuantizedMesh* mesh)
+{
+    const QuantizationStats* stats = &mesh->Stats;
+    char buffer[500];
+    sprintf_s(buffer, 500,
+        "%s: %zu vertices, stride %u B, %zu B -> %zu B (%.1f%% saved per full vertex fetch), "
+        "position error max %g rms %g, color error max %g, normal error max %g deg\n",
+        name, mesh->VertexCount, mesh->Stride, stats->SourceBytes, stats->QuantizedBytes,
+        stats->SourceBytes ? 100.0 * (1.0 - (double)stats->QuantizedBytes / stats->SourceBytes) : 0.0,
+        stats->MaxPositionError, stats->RmsPositionError, stats->MaxColorError,
+        stats->MaxNormalErrorDegrees);
+    OutputDebugString(buffer);
+}
+
+void ReportOptimizationStats(const char* name, const MeshOptimizationStats* stats)
+{
+    char buffer[500];
+    sprintf_s(buffer, 500,
+        "%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %zu vertices, %u-bit indices\n",
+        name, stats->AcmrBefore, stats->AcmrAfter, stats->AtvrBefore, stats->AtvrAfter,
+        stats->UniqueVertexCount, stats->IndexSize * 8);
+    OutputDebugString(buffer);
+}
+
+void ReportLodChain(const char* name, const LodChain* lods)
+{
+    char buffer[500];
+    for (uint32_t i = 0; i < lods->LevelCount; ++i)
+    {
+        const LodLevel* level = &lods->Levels[i];
+        sprintf_s(buffer, 500, "%s LOD%u: %u triangles (%.1f%% of LOD0), error bound %g (%.2f%% of radius)\n",
+            name, i, level->IndexCount / 3, 100.0 * level->IndexCount / lods->Levels[0].IndexCount,
+            level->Error, lods->Radius > 0.0f ? 100.0f * level->Error / lods->Radius : 0.0f);
+        OutputDebugString(buffer);
+    }
+}
+
+void ReportTexture(const char* name, const DdsTexture* texture)
+{
+    size_t size = 0;
+    for (uint32_t i = 0; i < texture->MipCount; ++i)
+        size += texture->Mips[i].SlicePitch;
+
+    char buffer[500];
+    sprintf_s(buffer, 500, "%s: %s%s %ux%u, %u mips, %zu bytes\n", name, TextureFormat_GetName(texture->Format),
+              texture->Srgb ? " sRGB" : "", texture->Width, texture->Height, texture->MipCount, size);
+    OutputDebugString(buffer);
+}
+
+void UpdateModelViewMatrices()
+{
+    // Update the model matrix.
+    vec3 angles = {1.0f, 0.0f, 1.0f};
+    mat4 modelMatrix;
+    glm_euler(angles, modelMatrix);
+    TransformHierarchy_SetLocal(&g_Context.Transforms, CUBE_NODE, modelMatrix);
+
+    // Update the view matrix.
+    const vec3 eyePosition = {0, 0, -10};
+    const vec3 focusPoint = {0, 0, 0};
+    const vec3 upDirection = {0, 1, 0};
+    glm_lookat(eyePosition, focusPoint, upDirection, g_Context.ViewMatrix);
+}
+
+void Update()
+{
+    static uint64_t frameCounter = 0;
+    static double elapsedSeconds = 0.0;
+    static clock_t t0;
+
+    frameCounter++;
+    clock_t t1 = clock();
+    clock_t deltaTime = t1 - t0;
+    t0 = t1;
+
+    elapsedSeconds += (double)deltaTime / CLOCKS_PER_SEC;
+    if (elapsedSeconds > 1.0)
+    {
+        char buffer[500];
+        double fps = frameCounter / elapsedSeconds;
+        sprintf_s(buffer, 500, "FPS: %f\n", fps);
+        OutputDebugString(buffer);
+
+        frameCounter = 0;
+        elapsedSeconds = 0.0;
+    }
+}
+
+// Poses the camera and the instances the way the script of the benchmark has them on the frame,
+// counted from 1. Instances the script doesn't animate keep the pose they had.
+void UpdateBenchmarkMatrices(const Benchmark* benchmark, uint64_t frame)
+{
+    BenchmarkFrame script;
+    Benchmark_GetFrame(benchmark, (uint32_t)(frame - 1), &script);
+    const vec3 upDirection = {0, 1, 0};
+    glm_lookat(script.Eye, script.Target, upDirection, g_Context.ViewMatrix);
+    if (!script.AnimateInstances && frame != 1)
+        return;
+
+    for (uint32_t i = 0; i < benchmark->Workload->InstanceCount; ++i)
+    {
+        vec3 position, angles;
+        mat4 modelMatrix;
+        Benchmark_GetInstance(benchmark, i, &script, position, angles);
+        glm_euler(angles, modelMatrix);
+        glm_vec3_copy(position, modelMatrix[3]);
+        TransformHierarchy_SetLocal(&g_Context.Transforms, CUBE_NODE + i, modelMatrix);
+    }
+}
+
+// Updates the world and MVP matrices of the scene and the particles, and copies what the
+// render thread draws from into the snapshot. The requests made with the keys are handed
+// over once.
+void Simulate(FrameSnapshot* snapshot, uint64_t frame, float deltaSeconds)
+{
+    static const ParticleForces forces = {
+        .Gravity = { 0.0f, -9.81f, 0.0f },
+        .Drag = 0.5f
+    };
+
+    if (g_Context.Benchmark != NULL)
+        UpdateBenchmarkMatrices(g_Context.Benchmark, frame);
+
+    mat4 viewProjectionMatrix;
+    glm_mat4_mul(g_Context.ProjectionMatrix, g_Context.ViewMatrix, viewProjectionMatrix);
+    TransformHierarchy_Update(&g_Context.Transforms, viewProjectionMatrix);
+
+    snapshot->Frame = frame;
+    glm_mat4_copy(g_Context.ViewMatrix, snapshot->ViewMatrix);
+    glm_mat4_copy(g_Context.ProjectionMatrix, snapshot->ProjectionMatrix);
+
+    // The snapshots were sized for the whole hierarchy
+    snapshot->NodeCount = g_Context.Transforms.Count;
+    memcpy(snapshot->WorldMatrices, g_Context.Transforms.WorldMatrices, snapshot->NodeCount * sizeof(mat4));
+    memcpy(snapshot->MvpMatrices, g_Context.Transforms.MvpMatrices, snapshot->NodeCount * sizeof(mat4));
+
+    // The billboards are streamed straight into the snapshot, the render thread only copies
+    // them to the GPU
+    snapshot->ParticleCount = 0;
+    if (g_Context.DrawParticles)
+    {
+        float dt = MIN(deltaSeconds, PARTICLE_MAX_TIME_STEP);
+        snapshot->ParticleCount = ParticleSystem_Update(&g_Context.Particles, &forces, dt, snapshot->Particles);
+    }
+
+    snapshot->Width = g_Context.WindowWidth;
+    snapshot->Height = g_Context.WindowHeight;
+    snapshot->GpuDrivenCulling = g_Context.GpuDrivenCulling;
+    snapshot->ValidateGpuCulling = g_Context.ValidateGpuCulling;
+    snapshot->BenchmarkBundles = g_Context.BenchmarkBundles;
+    snapshot->DrawBounds = g_Context.DrawBounds;
+    snapshot->DrawParticles = g_Context.DrawParticles;
+    snapshot->DynamicResolution = g_Context.DynamicResolution;
+    snapshot->PresentMode = g_Context.PresentMode;
+    g_Context.ValidateGpuCulling = false;
+    g_Context.BenchmarkBundles = false;
+}
+
+bool CreateFrameSnapshots(FrameSnapshot snapshots[TRIPLE_BUFFER_SLOTS], size_t nodeCount, size_t particleCount)
+{
+    memset(snapshots, 0, TRIPLE_BUFFER_SLOTS * sizeof(FrameSnapshot));
+    for (int i = 0; i < TRIPLE_BUFFER_SLOTS; ++i)
+    {
+        snapshots[i].WorldMatrices = AlignedAlloc(MAX(nodeCount, 1) * sizeof(mat4), 32);
+        snapshots[i].MvpMatrices = AlignedAlloc(MAX(nodeCount, 1) * sizeof(mat4), 32);
+        // The streamed stores of the particle system write 16 bytes at once
+        snapshots[i].Particles = AlignedAlloc(MAX(particleCount, 1) * sizeof(ParticleInstance), 16);
+        if (snapshots[i].WorldMatrices == NULL || snapshots[i].MvpMatrices == NULL || snapshots[i].Particles == NULL)
+            return false;
+    }
+    return true;
+}
+
+void ReleaseFrameSnapshots(FrameSnapshot snapshots[TRIPLE_BUFFER_SLOTS])
+{
+    for (int i = 0; i < TRIPLE_BUFFER_SLOTS; ++i)
+    {
+        AlignedFree(snapshots[i].WorldMatrices);
+        AlignedFree(snapshots[i].MvpMatrices);
+        AlignedFree(snapshots[i].Particles);
+    }
+}
+
+// Picks the level of detail from the projected size of the node
+uint32_t SelectNodeLod(FrameSnapshot* frame, LodChain* lods, uint32_t node, const D3D12_VIEWPORT* viewport)
+{
+    vec4* worldMatrix = frame->WorldMatrices[node];
+    mat4 modelViewMatrix;
+    glm_mat4_mul(frame->ViewMatrix, worldMatrix, modelViewMatrix);
+
+    vec3 viewCenter;
+    glm_mat4_mulv3(modelViewMatrix, lods->Center, 1.0f, viewCenter);
+
+    float worldScale = MAX(glm_vec3_norm(worldMatrix[0]),
+                           MAX(glm_vec3_norm(worldMatrix[1]), glm_vec3_norm(worldMatrix[2])));
+    float projectionScale = frame->ProjectionMatrix[1][1] * viewport->Height * 0.5f;
+
+    return SelectLod(lods, viewCenter[2], worldScale, projectionScale, LOD_PIXEL_THRESHOLD);
+}
+
+// Pipeline state, texture and geometry shared by every draw of the scene
+void SetStaticState(ID3D12GraphicsCommandList* commandList, const StaticDrawInputs* inputs)
+{
+    ID3D12GraphicsCommandList_SetPipelineState(commandList, inputs->PipelineState);
+    ID3D12GraphicsCommandList_SetGraphicsRootSignature(commandList, inputs->RootSignature);
+    ID3D12GraphicsCommandList_SetDescriptorHeaps(commandList, 1, &inputs->DescriptorHeap);
+    ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(commandList, 1, inputs->Texture);
+
+    ID3D12GraphicsCommandList_IASetPrimitiveTopology(commandList, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    ID3D12GraphicsCommandList_IASetVertexBuffers(commandList, 0, 1, &inputs->VertexBufferView);
+    ID3D12GraphicsCommandList_IASetIndexBuffer(commandList, &inputs->IndexBufferView);
+}
+
+// Queues a draw of each node with its level of detail, then sorts them
+void BuildDrawQueue(DrawQueue* queue, FrameSnapshot* frame, LodChain* lods, const D3D12_VIEWPORT* viewport,
+                    const uint32_t* nodes, size_t nodeCount)
+{
+    DrawQueue_Clear(queue);
+    for (size_t i = 0; i < nodeCount; ++i)
+    {
+        uint32_t node = nodes[i];
+
+        // Normalized depth of the bounds center, opaque draws go front to back
+        vec4 clipCenter;
+        glm_mat4_mulv(frame->MvpMatrices[node], (vec4){ lods->Center[0], lods->Center[1], lods->Center[2], 1.0f }, clipCenter);
+        float depth = clipCenter[3] > 0.0f ? (clipCenter[2] / clipCenter[3]) * 0.5f + 0.5f : 0.0f;
+
+        uint64_t key = DrawKey_Pack(OPAQUE_PASS, CUBE_PIPELINE, CUBE_MATERIAL, CUBE_MESH,
+                                    DrawKey_QuantizeDepth(depth, false));
+        if (!DrawQueue_Push(queue, key, node, SelectNodeLod(frame, lods, node, viewport)))
+            break;
+    }
+    DrawQueue_Sort(queue);
+}
+
+// Records sorted draws, binding the state only where the key says it changed. Each draw sets
+// its node as a root constant, the vertex shader reads the MVP of the node from the buffer
+// the executing command list binds.
+void RecordDrawPackets(ID3D12GraphicsCommandList* commandList, const StaticDrawInputs* inputs,
+                       const DrawPacket* packets, size_t packetCount)
+{
+    ID3D12GraphicsCommandList_SetGraphicsRootSignature(commandList, inputs->RootSignature);
+    // A bundle may only set the heap the executing command list has set
+    ID3D12GraphicsCommandList_SetDescriptorHeaps(commandList, 1, &inputs->DescriptorHeap);
+    ID3D12GraphicsCommandList_IASetPrimitiveTopology(commandList, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    DrawStateFilter filter;
+    DrawStateFilter_Reset(&filter);
+    for (size_t i = 0; i < packetCount; ++i)
+    {
+        const DrawPacket* packet = &packets[i];
+
+        // Every key maps to the one pipeline state, texture and mesh for now
+        uint32_t changes = DrawStateFilter_Next(&filter, packet->Key);
+        if (changes & DRAW_STATE_PIPELINE)
+            ID3D12GraphicsCommandList_SetPipelineState(commandList, inputs->PipelineState);
+        if (changes & DRAW_STATE_MATERIAL)
+            ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(commandList, 1, inputs->Texture);
+        if (changes & DRAW_STATE_MESH)
+        {
+            ID3D12GraphicsCommandList_IASetVertexBuffers(commandList, 0, 1, &inputs->VertexBufferView);
+            ID3D12GraphicsCommandList_IASetIndexBuffer(commandList, &inputs->IndexBufferView);
+        }
+
+        ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstant(commandList, 0, packet->Instance, 0);
+
+        const LodLevel* level = &inputs->Lods->Levels[packet->Range];
+        ID3D12GraphicsCommandList_DrawIndexedInstanced(commandList, level->IndexCount, 1, level->IndexOffset, 0, 0);
+    }
+}
+
+// Compares the CPU time of recording a frame of node draws directly with executing the same
+// draws from a bundle, and the time of re-recording that bundle. Nothing is submitted.
+void BenchmarkBundles(ID3D12Device2* device, const StaticDrawInputs* inputs, FrameSnapshot* frame,
+                      LodChain* lods, const D3D12_VIEWPORT* viewport)
+{
+    static const uint32_t drawCounts[] = { 1000, 10000, 100000 };
+    const uint32_t maxDrawCount = drawCounts[_countof(drawCounts) - 1];
+
+    // The scene is small, so the draws cycle through its nodes. Only the recording is timed,
+    // the queue is built and sorted once up front.
+    LinearArena* scratch = ScratchArena_Get();
+    if (scratch == NULL)
+        return;
+    ArenaMarker marker = LinearArena_GetMarker(scratch);
+    uint32_t* nodes = LinearArena_AllocArray(scratch, uint32_t, maxDrawCount);
+    DrawQueue queue;
+    if (nodes == NULL || !DrawQueue_Create(&queue, maxDrawCount))
+    {
+        LinearArena_Rollback(scratch, marker);
+        return;
+    }
+    for (uint32_t i = 0; i < maxDrawCount; ++i)
+    {
+        nodes[i] = i % (uint32_t)frame->NodeCount;
+    }
+    BuildDrawQueue(&queue, frame, lods, viewport, nodes, maxDrawCount);
+
+    ID3D12CommandAllocator* allocator = CreateCommandAllocator(device, D3D12_COMMAND_LIST_TYPE_DIRECT);
+    ID3D12GraphicsCommandList* commandList = CreateCommandList(device, allocator, D3D12_COMMAND_LIST_TYPE_DIRECT);
+    ID3D12CommandAllocator* bundleAllocator = CreateCommandAllocator(device, D3D12_COMMAND_LIST_TYPE_BUNDLE);
+    ID3D12GraphicsCommandList* bundle = CreateCommandList(device, bundleAllocator, D3D12_COMMAND_LIST_TYPE_BUNDLE);
+
+    for (int i = 0; i < _countof(drawCounts); ++i)
+    {
+        double directTime = DBL_MAX;
+        double bundledTime = DBL_MAX;
+        double recordTime = DBL_MAX;
+        for (int run = 0; run < BUNDLE_BENCHMARK_RUNS; ++run)
+        {
+            LARGE_INTEGER start, end;
+
+            // Every frame without bundles
+            ExitOnFailure(ID3D12CommandAllocator_Reset(allocator));
+            ExitOnFailure(ID3D12GraphicsCommandList_Reset(commandList, allocator, NULL));
+            QueryPerformanceCounter(&start);
+            RecordDrawPackets(commandList, inputs, queue.Packets, drawCounts[i]);
+            ExitOnFailure(ID3D12GraphicsCommandList_Close(commandList));
+            QueryPerformanceCounter(&end);
+            directTime = MIN(directTime, GetElapsedMilliseconds(start, end));
+
+            // Only when the inputs change
+            ExitOnFailure(ID3D12CommandAllocator_Reset(bundleAllocator));
+            ExitOnFailure(ID3D12GraphicsCommandList_Reset(bundle, bundleAllocator, inputs->PipelineState));
+            QueryPerformanceCounter(&start);
+            RecordDrawPackets(bundle, inputs, queue.Packets, drawCounts[i]);
+            ExitOnFailure(ID3D12GraphicsCommandList_Close(bundle));
+            QueryPerformanceCounter(&end);
+            recordTime = MIN(recordTime, GetElapsedMilliseconds(start, end));
+
+            // Every frame with bundles
+            ExitOnFailure(ID3D12CommandAllocator_Reset(allocator));
+            ExitOnFailure(ID3D12GraphicsCommandList_Reset(commandList, allocator, NULL));
+            QueryPerformanceCounter(&start);
+            ID3D12GraphicsCommandList_SetGraphicsRootSignature(commandList, inputs->RootSignature);
+            ID3D12GraphicsCommandList_SetDescriptorHeaps(commandList, 1, &inputs->DescriptorHeap);
+            ID3D12GraphicsCommandList_ExecuteBundle(commandList, bundle);
+            ExitOnFailure(ID3D12GraphicsCommandList_Close(commandList));
+            QueryPerformanceCounter(&end);
+            bundledTime = MIN(bundledTime, GetElapsedMilliseconds(start, end));
+        }
+
+        char buffer[500];
+        sprintf_s(buffer, 500, "Bundles, %u draws: %.3f ms recorded directly, %.3f ms executing a bundle, "
+                  "%.3f ms re-recording the bundle\n", drawCounts[i], directTime, bundledTime, recordTime);
+        OutputDebugString(buffer);
+    }
+
+    ID3D12GraphicsCommandList_Release(bundle);
+    ID3D12CommandAllocator_Release(bundleAllocator);
+    ID3D12GraphicsCommandList_Release(commandList);
+    ID3D12CommandAllocator_Release(allocator);
+    DrawQueue_Destroy(&queue);
+    LinearArena_Rollback(scratch, marker);
+}
+
+D3D12_RESOURCE_BARRIER D3D12_RESOURCE_BARRIER_UAV(ID3D12Resource* pResource)
+{
+    D3D12_RESOURCE_BARRIER barrier;
+    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+    barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrier.UAV.pResource = pResource;
+    return barrier;
+}
+
+// Uploads the instances and records the culling passes, leaving the commands and the
+// draw count ready for ExecuteIndirect
+void DispatchGpuCulling(ID3D12GraphicsCommandList* commandList, GpuCulling* culling, FrameSnapshot* frame,
+                        const Frustum* frustum, LodChain* lods, const D3D12_VIEWPORT* viewport)
+{
+    uint32_t instanceCount = (uint32_t)MIN(frame->NodeCount, culling->InstanceCapacity);
+    uint8_t* upload = culling->UploadData[g_CurrentBackBufferIndex];
+
+    // Built on the stack, the upload heap is write-combined
+    GpuCullConstants constants;
+    float projectionScale = frame->ProjectionMatrix[1][1] * viewport->Height * 0.5f;
+    GpuCullConstants_Init(&constants, frustum, frame->ViewMatrix, projectionScale,
+                          LOD_PIXEL_THRESHOLD, lods, instanceCount);
+    memcpy(upload, &constants, sizeof(constants));
+
+    GpuCullInstance* instances = (GpuCullInstance*)(upload + CULLING_DATA_OFFSET);
+    for (uint32_t i = 0; i < instanceCount; ++i)
+    {
+        GpuCullInstance instance;
+        mat4 mvpMatrix;
+        glm_mat4_mul(frame->MvpMatrices[i], g_Context.DequantizeMatrix, mvpMatrix);
+        memcpy(instance.Mvp, mvpMatrix, sizeof(mvpMatrix));
+        instance.Bounds[0] = g_Context.NodeBounds.X[i];
+        instance.Bounds[1] = g_Context.NodeBounds.Y[i];
+        instance.Bounds[2] = g_Context.NodeBounds.Z[i];
+        instance.Bounds[3] = g_Context.NodeBounds.Radius[i];
+        memcpy(&instances[i], &instance, sizeof(instance));
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS uploadAddress = ID3D12Resource_GetGPUVirtualAddress(culling->UploadBuffers[g_CurrentBackBufferIndex]);
+    ID3D12GraphicsCommandList_SetComputeRootSignature(commandList, culling->RootSignature);
+    ID3D12GraphicsCommandList_SetComputeRootConstantBufferView(commandList, 0, uploadAddress);
+    ID3D12GraphicsCommandList_SetComputeRootShaderResourceView(commandList, 1, uploadAddress + CULLING_DATA_OFFSET);
+    ID3D12GraphicsCommandList_SetComputeRootUnorderedAccessView(commandList, 2, ID3D12Resource_GetGPUVirtualAddress(culling->Commands));
+    ID3D12GraphicsCommandList_SetComputeRootUnorderedAccessView(commandList, 3, ID3D12Resource_GetGPUVirtualAddress(culling->DrawCount));
+    ID3D12GraphicsCommandList_SetComputeRootUnorderedAccessView(commandList, 4, ID3D12Resource_GetGPUVirtualAddress(culling->Visibility));
+    ID3D12GraphicsCommandList_SetComputeRootUnorderedAccessView(commandList, 5, ID3D12Resource_GetGPUVirtualAddress(culling->GroupData));
+
+    // Each pass reads what the previous one wrote
+    uint32_t groupCount = GpuCulling_GetGroupCount(instanceCount);
+    D3D12_RESOURCE_BARRIER uavBarrier = D3D12_RESOURCE_BARRIER_UAV(NULL);
+
+    ID3D12GraphicsCommandList_SetPipelineState(commandList, culling->CullPipelineState);
+    ID3D12GraphicsCommandList_Dispatch(commandList, groupCount, 1, 1);
+    ID3D12GraphicsCommandList_ResourceBarrier(commandList, 1, &uavBarrier);
+
+    ID3D12GraphicsCommandList_SetPipelineState(commandList, culling->ScanPipelineState);
+    ID3D12GraphicsCommandList_Dispatch(commandList, 1, 1, 1);
+    ID3D12GraphicsCommandList_ResourceBarrier(commandList, 1, &uavBarrier);
+
+    ID3D12GraphicsCommandList_SetPipelineState(commandList, culling->CompactPipelineState);
+    ID3D12GraphicsCommandList_Dispatch(commandList, groupCount, 1, 1);
+
+    D3D12_RESOURCE_BARRIER barriers[2] = {
+        D3D12_RESOURCE_BARRIER_Transition(culling->Commands,
+                                          D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                                          D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT,
+                                          D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+                                          D3D12_RESOURCE_BARRIER_FLAG_NONE),
+        D3D12_RESOURCE_BARRIER_Transition(culling->DrawCount,
+                                          D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                                          D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT,
+                                          D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+                                          D3D12_RESOURCE_BARRIER_FLAG_NONE)
+    };
+    ID3D12GraphicsCommandList_ResourceBarrier(commandList, _countof(barriers), barriers);
+}
+
+// Returns the indirect arguments to unordered access for the next frame, copying them to
+// the readback buffer first when a validation was requested
+void FinishGpuCulling(ID3D12GraphicsCommandList* commandList, GpuCulling* culling, bool validate)
+{
+    ID3D12Resource* resources[2] = { culling->Commands, culling->DrawCount };
+    D3D12_RESOURCE_STATES state = validate ?
+        D3D12_RESOURCE_STATE_COPY_SOURCE : D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+
+    D3D12_RESOURCE_BARRIER barriers[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        barriers[i] = D3D12_RESOURCE_BARRIER_Transition(resources[i], D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT,
+                                                        state, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+                                                        D3D12_RESOURCE_BARRIER_FLAG_NONE);
+    }
+    ID3D12GraphicsCommandList_ResourceBarrier(commandList, _countof(barriers), barriers);
+
+    if (!validate)
+        return;
+
+    ID3D12GraphicsCommandList_CopyBufferRegion(commandList, culling->Readback, 0,
+        culling->DrawCount, 0, sizeof(uint32_t));
+    ID3D12GraphicsCommandList_CopyBufferRegion(commandList, culling->Readback, CULLING_DATA_OFFSET,
+        culling->Commands, 0, (UINT64)culling->InstanceCapacity * sizeof(GpuDrawCommand));
+
+    for (int i = 0; i < 2; ++i)
+    {
+        barriers[i] = D3D12_RESOURCE_BARRIER_Transition(resources[i], D3D12_RESOURCE_STATE_COPY_SOURCE,
+                                                        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                                                        D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+                                                        D3D12_RESOURCE_BARRIER_FLAG_NONE);
+    }
+    ID3D12GraphicsCommandList_ResourceBarrier(commandList, _countof(barriers), barriers);
+}
+
+// Compares the commands read back from the GPU with the CPU reference over the same upload
+void ValidateGpuCulling(GpuCulling* culling, UINT frameIndex)
+{
+    const uint8_t* upload = culling->UploadData[frameIndex];
+    GpuCullConstants constants;
+    memcpy(&constants, upload, sizeof(constants));
+
+    LinearArena* frameArena = FrameArenas_Get(&g_Context.FrameArenas, frameIndex);
+    GpuDrawCommand* expected = LinearArena_AllocArray(frameArena, GpuDrawCommand, MAX(constants.InstanceCount, 1));
+    if (expected == NULL)
+        return;
+    uint32_t expectedCount = GpuCullReference(&constants, (const GpuCullInstance*)(upload + CULLING_DATA_OFFSET), expected);
+
+    uint8_t* readback;
+    D3D12_RANGE readRange = { 0, CULLING_DATA_OFFSET + (SIZE_T)constants.InstanceCount * sizeof(GpuDrawCommand) };
+    ExitOnFailure(ID3D12Resource_Map(culling->Readback, 0, &readRange, (void**)&readback));
+
+    uint32_t drawCount;
+    memcpy(&drawCount, readback, sizeof(drawCount));
+    bool match = drawCount == expectedCount &&
+        memcmp(readback + CULLING_DATA_OFFSET, expected, expectedCount * sizeof(GpuDrawCommand)) == 0;
+
+    D3D12_RANGE writeRange = { 0, 0 };
+    ID3D12Resource_Unmap(culling->Readback, 0, &writeRange);
+
+    char buffer[500];
+    sprintf_s(buffer, 500, "GPU culling: %u of %u instances drawn, %s the CPU reference (%u draws)\n",
+              drawCount, constants.InstanceCount, match ? "matches" : "differs from", expectedCount);
+    OutputDebugString(buffer);
+}
+
+// Streams three circles around the world space bounds of every node into this frame's
+// region of the debug lines and draws them as a line list
+void RecordNodeBounds(ID3D12GraphicsCommandList* commandList, DebugLines* lines, size_t nodeCount,
+                      mat4 viewProjectionMatrix)
+{
+    enum { VERTICES_PER_NODE = 3 * BOUNDS_CIRCLE_SEGMENTS * 2 };
+    static const uint32_t colors[3] = { 0xFF0000FFu, 0xFF00FF00u, 0xFFFF0000u };
+
+    DynamicBuffer_BeginFrame(&lines->Vertices, g_CurrentBackBufferIndex);
+    size_t maxNodes = lines->Vertices.RegionSize / (VERTICES_PER_NODE * sizeof(DebugVertex));
+    nodeCount = MIN(nodeCount, maxNodes);
+    if (nodeCount == 0)
+        return;
+
+    UINT64 gpuAddress;
+    size_t size = nodeCount * VERTICES_PER_NODE * sizeof(DebugVertex);
+    DebugVertex* vertices = DynamicBuffer_Allocate(&lines->Vertices, size, sizeof(DebugVertex), &gpuAddress);
+    if (vertices == NULL)
+        return;
+
+    // Built on the stack a node at a time and streamed over, the upload heap is write-combined
+    DebugVertex nodeVertices[VERTICES_PER_NODE];
+    const SphereBounds* bounds = &g_Context.NodeBounds;
+    for (size_t node = 0; node < nodeCount; ++node)
+    {
+        vec3 center = { bounds->X[node], bounds->Y[node], bounds->Z[node] };
+        float radius = bounds->Radius[node];
+
+        DebugVertex* vertex = nodeVertices;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            for (int segment = 0; segment < BOUNDS_CIRCLE_SEGMENTS; ++segment)
+            {
+                for (int end = 0; end < 2; ++end)
+                {
+                    float angle = (segment + end) * (2.0f * GLM_PIf / BOUNDS_CIRCLE_SEGMENTS);
+                    float c = cosf(angle) * radius;
+                    float s = sinf(angle) * radius;
+
+                    // Circle in the plane across the axis
+                    glm_vec3_copy(center, vertex->Position);
+                    vertex->Position[(axis + 1) % 3] += c;
+                    vertex->Position[(axis + 2) % 3] += s;
+                    vertex->Color = colors[axis];
+                    vertex++;
+                }
+            }
+        }
+        StreamCopy(vertices + node * VERTICES_PER_NODE, nodeVertices, sizeof(nodeVertices));
+    }
+    StreamFence();
+
+    D3D12_VERTEX_BUFFER_VIEW vertexBufferView = {
+        .BufferLocation = gpuAddress,
+        .SizeInBytes = (UINT)size,
+        .StrideInBytes = sizeof(DebugVertex)
+    };
+    ID3D12GraphicsCommandList_SetPipelineState(commandList, lines->PipelineState);
+    ID3D12GraphicsCommandList_IASetPrimitiveTopology(commandList, D3D_PRIMITIVE_TOPOLOGY_LINELIST);
+    ID3D12GraphicsCommandList_IASetVertexBuffers(commandList, 0, 1, &vertexBufferView);
+    ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstants(commandList, 0, sizeof(mat4) / sizeof(float), viewProjectionMatrix, 0);
+    ID3D12GraphicsCommandList_DrawInstanced(commandList, (UINT)(nodeCount * VERTICES_PER_NODE), 1, 0, 0);
+}
+
+// Advances the particles over the frame, streaming their billboards into this frame's region
+// of the instances, and draws them
+void RecordParticles(ID3D12GraphicsCommandList* commandList, ParticleBillboards* billboards,
+                     FrameSnapshot* frame, mat4 viewProjectionMatrix)
+{
+    size_t count = frame->ParticleCount;
+    if (count == 0)
+        return;
+
+    DynamicBuffer_BeginFrame(&billboards->Instances, g_CurrentBackBufferIndex);
+    UINT64 gpuAddress;
+    if (DynamicBuffer_Write(&billboards->Instances, frame->Particles, count * sizeof(ParticleInstance),
+                            sizeof(float), &gpuAddress) == NULL)
+        return;
+    StreamFence();
+
+    ParticleConstants constants;
+    glm_mat4_copy(viewProjectionMatrix, constants.ViewProjection);
+    constants.ProjectionScale[0] = frame->ProjectionMatrix[0][0];
+    constants.ProjectionScale[1] = frame->ProjectionMatrix[1][1];
+
+    D3D12_VERTEX_BUFFER_VIEW instanceBufferView = {
+        .BufferLocation = gpuAddress,
+        .SizeInBytes = (UINT)(count * sizeof(ParticleInstance)),
+        .StrideInBytes = sizeof(ParticleInstance)
+    };
+    ID3D12GraphicsCommandList_SetPipelineState(commandList, billboards->PipelineState);
+    ID3D12GraphicsCommandList_SetGraphicsRootSignature(commandList, billboards->RootSignature);
+    ID3D12GraphicsCommandList_IASetPrimitiveTopology(commandList, D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    ID3D12GraphicsCommandList_IASetVertexBuffers(commandList, 0, 1, &instanceBufferView);
+    ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstants(commandList, 0, sizeof(constants) / sizeof(float), &constants, 0);
+    ID3D12GraphicsCommandList_DrawInstanced(commandList, 4, (UINT)count, 0, 0);
+}
+
+void Render(IDXGISwapChain4* swapChain, ID3D12CommandQueue* g_CommandQueue,
+            ID3D12GraphicsCommandList* commandList, ID3D12PipelineState* pipelineState,
+            ID3D12RootSignature* rootSignature, D3D12_VERTEX_BUFFER_VIEW* vertexBufferView,
+            D3D12_INDEX_BUFFER_VIEW* indexBufferView, LodChain* lods, GpuCulling* gpuCulling,
+            DrawBundles* drawBundles, DebugLines* debugLines, ParticleBillboards* particles,
+            SceneTexture* texture, ScaledScene* scene, FrameSnapshot* frame, D3D12_VIEWPORT* viewport,
+            D3D12_RECT* scisssorRect)
+{
+    ID3D12CommandAllocator* commandAllocator = g_CommandAllocators[g_CurrentBackBufferIndex];
+    ID3D12Resource* backBuffer = g_BackBuffers[g_CurrentBackBufferIndex];
+
+    CommandCapture_MarkFrame(frame->Frame);
+    ID3D12CommandAllocator_Reset(commandAllocator);
+    ID3D12GraphicsCommandList_Reset(commandList, commandAllocator, NULL);
+    ID3D12GraphicsCommandList_EndQuery(commandList, scene->QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP,
+                                       2 * g_CurrentBackBufferIndex);
+
+    // The scene is drawn into the top left of its color target, everything sized by the
+    // viewport follows the scale
+    D3D12_VIEWPORT sceneViewport = *viewport;
+    sceneViewport.Width = MAX(1.0f, roundf(viewport->Width * scene->Scale));
+    sceneViewport.Height = MAX(1.0f, roundf(viewport->Height * scene->Scale));
 
     D3D12_CPU_DESCRIPTOR_HANDLE rtv;
     D3D12_CPU_DESCRIPTOR_HANDLE dsv;
     ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(g_DSVDescriptorHeap, &dsv);
     // Clear the render target.
     {
-        D3D12_RESOURCE_BARRIER barrier = D3D12_RESOURCE_BARRIER_Transition(backBuffer,
-                                                    D3D12_RESOURCE_STATE_PRESENT,
+        D3D12_RESOURCE_BARRIER barrier = D3D12_RESOURCE_BARRIER_Transition(scene->ColorBuffer,
+                                                    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
                                                     D3D12_RESOURCE_STATE_RENDER_TARGET,
                                                     D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
                                                     D3D12_RESOURCE_BARRIER_FLAG_NONE);
         ID3D12GraphicsCommandList_ResourceBarrier(commandList, 1, &barrier);
 
-        FLOAT clearColor[] = { 0.635f, 0.415f, 0.905f, 1.0f };
-
-        ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(g_RTVDescriptorHeap, &rtv);
-        rtv = D3D12_CPU_DESCRIPTOR_HANDLE_Offset(rtv, g_CurrentBackBufferIndex, g_RTVDescriptorSize);
+        ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(scene->RenderTargetHeap, &rtv);
 
-        ID3D12GraphicsCommandList_ClearRenderTargetView(commandList, rtv, clearColor, 0, NULL);
+        ID3D12GraphicsCommandList_ClearRenderTargetView(commandList, rtv, g_ClearColor, 0, NULL);
         ID3D12GraphicsCommandList_ClearDepthStencilView(commandList, dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, NULL);
     }
 
-    ID3D12GraphicsCommandList_SetPipelineState(commandList, pipelineState);
+    // Bundles inherit the root arguments only when the root signature matches the caller's,
+    // and the descriptor heap has to be the one they set
     ID3D12GraphicsCommandList_SetGraphicsRootSignature(commandList, rootSignature);
+    ID3D12GraphicsCommandList_SetDescriptorHeaps(commandList, 1, &texture->DescriptorHeap);
 
-    ID3D12GraphicsCommandList_IASetPrimitiveTopology(commandList, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    ID3D12GraphicsCommandList_IASetVertexBuffers(commandList, 0, 1, vertexBufferView);
-    ID3D12GraphicsCommandList_IASetIndexBuffer(commandList, indexBufferView);
-
-    ID3D12GraphicsCommandList_RSSetViewports(commandList, 1, viewport);
+    ID3D12GraphicsCommandList_RSSetViewports(commandList, 1, &sceneViewport);
     ID3D12GraphicsCommandList_RSSetScissorRects(commandList, 1, scisssorRect);
 
     ID3D12GraphicsCommandList_OMSetRenderTargets(commandList, 1, &rtv, FALSE, &dsv);
 
-    // Update the MVP matrix
-    mat4 mvpMatrix;
-    glm_mat4_mul(g_Context.ViewMatrix, g_Context.ModelMatrix, mvpMatrix);
-    glm_mat4_mul(g_Context.ProjectionMatrix, mvpMatrix, mvpMatrix);
+    mat4 viewProjectionMatrix;
+    glm_mat4_mul(frame->ProjectionMatrix, frame->ViewMatrix, viewProjectionMatrix);
+
+    StaticDrawInputs inputs;
+    memset(&inputs, 0, sizeof(inputs));
+    inputs.PipelineState = pipelineState;
+    inputs.RootSignature = rootSignature;
+    inputs.VertexBufferView = *vertexBufferView;
+    inputs.IndexBufferView = *indexBufferView;
+    inputs.DescriptorHeap = texture->DescriptorHeap;
+    inputs.Texture = texture->View;
+    inputs.Lods = lods;
+
+    // World space bounds of the nodes, shared by both culling paths
+    Frustum frustum;
+    Frustum_FromViewProjection(&frustum, viewProjectionMatrix);
+    TransformSphereBounds(&g_Context.NodeBounds, frame->WorldMatrices, frame->NodeCount,
+                          lods->Center, lods->Radius);
+
+    if (frame->GpuDrivenCulling)
+    {
+        // The compute passes replaced the pipeline state, the graphics root signature is untouched
+        DispatchGpuCulling(commandList, gpuCulling, frame, &frustum, lods, &sceneViewport);
+        SetStaticState(commandList, &inputs);
+        ID3D12GraphicsCommandList_ExecuteIndirect(commandList, gpuCulling->CommandSignature,
+                                                  gpuCulling->InstanceCapacity, gpuCulling->Commands, 0,
+                                                  gpuCulling->DrawCount, 0);
+        FinishGpuCulling(commandList, gpuCulling, frame->ValidateGpuCulling);
+    }
+    else
+    {
+        // The nodes that passed culling this frame
+        UINT frameIndex = g_CurrentBackBufferIndex;
+        LinearArena* frameArena = FrameArenas_Get(&g_Context.FrameArenas, frameIndex);
+        uint32_t* visibleNodes = LinearArena_AllocArray(frameArena, uint32_t, MAX(frame->NodeCount, 1));
+        if (visibleNodes == NULL)
+            exit(HD_EXIT_FAILURE);
+
+        size_t visibleCount = FrustumCullSpheres(&frustum, &g_Context.NodeBounds, visibleNodes);
+
+        // Drop the nodes hidden behind the others. The occluders lie within the bounds of their
+        // node, so a node never hides itself.
+        OcclusionBuffer_Clear(&g_Context.Occlusion);
+        for (size_t i = 0; i < visibleCount; ++i)
+        {
+            if (!OcclusionBuffer_AddOccluder(&g_Context.Occlusion, frame->MvpMatrices[visibleNodes[i]],
+                                             &g_Context.Occluder))
+                break;
+        }
+        OcclusionBuffer_Rasterize(&g_Context.Occlusion);
+        OcclusionBuffer_BuildHiZ(&g_Context.Occlusion);
+        visibleCount = OcclusionCullSpheres(&g_Context.Occlusion, viewProjectionMatrix, &g_Context.NodeBounds,
+                                            visibleNodes, visibleCount);
+        BuildDrawQueue(&g_Context.DrawQueue, frame, lods, &sceneViewport, visibleNodes, visibleCount);
+
+        // Only the drawn nodes need their MVP. The frame fence was waited on before this frame,
+        // so neither its buffer nor its bundle is still in use.
+        const DrawPacket* packets = g_Context.DrawQueue.Packets;
+        size_t packetCount = MIN(g_Context.DrawQueue.Count, drawBundles->Capacity);
+        mat4* mvpMatrices = drawBundles->MvpData[frameIndex];
+        for (size_t i = 0; i < packetCount; ++i)
+        {
+            uint32_t node = packets[i].Instance;
+            glm_mat4_mul(frame->MvpMatrices[node], g_Context.DequantizeMatrix, mvpMatrices[node]);
+        }
+        ID3D12GraphicsCommandList_SetGraphicsRootShaderResourceView(commandList, 2,
+            ID3D12Resource_GetGPUVirtualAddress(drawBundles->MvpBuffers[frameIndex]));
+
+        // The bundle of this frame is re-recorded once the state or the draws differ from the
+        // ones it was recorded with. The sort keys hold the depth, only the node and the level
+        // of every draw are compared.
+        inputs.PipelineState = drawBundles->PipelineState;
+        ID3D12GraphicsCommandList* bundle = drawBundles->Bundles[frameIndex];
+        DrawPacket* recorded = drawBundles->Packets[frameIndex];
+        bool changed = !drawBundles->Recorded[frameIndex] ||
+                       memcmp(&drawBundles->Inputs[frameIndex], &inputs, sizeof(inputs)) != 0 ||
+                       drawBundles->PacketCounts[frameIndex] != packetCount;
+        for (size_t i = 0; i < packetCount && !changed; ++i)
+        {
+            changed = recorded[i].Instance != packets[i].Instance || recorded[i].Range != packets[i].Range;
+        }
+        if (changed)
+        {
+            ExitOnFailure(ID3D12CommandAllocator_Reset(drawBundles->Allocators[frameIndex]));
+            ExitOnFailure(ID3D12GraphicsCommandList_Reset(bundle, drawBundles->Allocators[frameIndex],
+                                                          inputs.PipelineState));
+            RecordDrawPackets(bundle, &inputs, packets, packetCount);
+            ExitOnFailure(ID3D12GraphicsCommandList_Close(bundle));
+
+            memcpy(&drawBundles->Inputs[frameIndex], &inputs, sizeof(inputs));
+            memcpy(recorded, packets, packetCount * sizeof(DrawPacket));
+            drawBundles->PacketCounts[frameIndex] = packetCount;
+            drawBundles->Recorded[frameIndex] = true;
+        }
+
+        ID3D12GraphicsCommandList_ExecuteBundle(commandList, bundle);
+    }
+
+    if (frame->DrawBounds)
+        RecordNodeBounds(commandList, debugLines, frame->NodeCount, viewProjectionMatrix);
+
+    // Last, as the particles change the root signature
+    if (frame->DrawParticles)
+        RecordParticles(commandList, particles, frame, viewProjectionMatrix);
 
-    ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstants(commandList, 0, sizeof(mat4) / sizeof(float), mvpMatrix, 0);
+    // Stretch the scene over the back buffer, every pixel of it is written
+    {
+        D3D12_RESOURCE_BARRIER barriers[2] = {
+            D3D12_RESOURCE_BARRIER_Transition(scene->ColorBuffer,
+                                              D3D12_RESOURCE_STATE_RENDER_TARGET,
+                                              D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+                                              D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+                                              D3D12_RESOURCE_BARRIER_FLAG_NONE),
+            D3D12_RESOURCE_BARRIER_Transition(backBuffer,
+                                              D3D12_RESOURCE_STATE_PRESENT,
+                                              D3D12_RESOURCE_STATE_RENDER_TARGET,
+                                              D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+                                              D3D12_RESOURCE_BARRIER_FLAG_NONE)
+        };
+        ID3D12GraphicsCommandList_ResourceBarrier(commandList, _countof(barriers), barriers);
 
-    ID3D12GraphicsCommandList_DrawIndexedInstanced(commandList, _countof(g_Indicies), 1, 0, 0, 0);
+        ID3D12DescriptorHeap_GetCPUDescriptorHandleForHeapStart(g_RTVDescriptorHeap, &rtv);
+        rtv = D3D12_CPU_DESCRIPTOR_HANDLE_Offset(rtv, g_CurrentBackBufferIndex, g_RTVDescriptorSize);
+        ID3D12GraphicsCommandList_OMSetRenderTargets(commandList, 1, &rtv, FALSE, NULL);
+        ID3D12GraphicsCommandList_RSSetViewports(commandList, 1, viewport);
+
+        D3D12_RESOURCE_DESC sceneDesc;
+        ID3D12Resource_GetDesc(scene->ColorBuffer, &sceneDesc);
+        UpscaleConstants constants = {
+            .UvScale = { sceneViewport.Width / sceneDesc.Width, sceneViewport.Height / sceneDesc.Height },
+            .UvClamp = { (sceneViewport.Width - 0.5f) / sceneDesc.Width, (sceneViewport.Height - 0.5f) / sceneDesc.Height }
+        };
+        ID3D12GraphicsCommandList_SetPipelineState(commandList, scene->PipelineState);
+        ID3D12GraphicsCommandList_SetGraphicsRootSignature(commandList, scene->RootSignature);
+        ID3D12GraphicsCommandList_SetDescriptorHeaps(commandList, 1, &scene->DescriptorHeap);
+        ID3D12GraphicsCommandList_SetGraphicsRoot32BitConstants(commandList, 0, sizeof(constants) / sizeof(float), &constants, 0);
+        ID3D12GraphicsCommandList_SetGraphicsRootDescriptorTable(commandList, 1, scene->View);
+        ID3D12GraphicsCommandList_IASetPrimitiveTopology(commandList, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        ID3D12GraphicsCommandList_DrawInstanced(commandList, 3, 1, 0, 0);
+    }
 
     // Present
     {
@@ -1016,6 +2991,15 @@ void Render(IDXGISwapChain4* swapChain, ID3D12CommandQueue* g_CommandQueue,
                                                     D3D12_RESOURCE_BARRIER_FLAG_NONE);
         ID3D12GraphicsCommandList_ResourceBarrier(commandList, 1, &barrier);
 
+        // Read back by UpdateDynamicResolution once this back buffer comes around again
+        UINT firstQuery = 2 * g_CurrentBackBufferIndex;
+        ID3D12GraphicsCommandList_EndQuery(commandList, scene->QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, firstQuery + 1);
+        ID3D12GraphicsCommandList_ResolveQueryData(commandList, scene->QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP,
+                                                   firstQuery, 2, scene->Readback, firstQuery * sizeof(uint64_t));
+        scene->Scales[g_CurrentBackBufferIndex] = scene->Scale;
+        scene->Frames[g_CurrentBackBufferIndex] = frame->Frame;
+        scene->Measured[g_CurrentBackBufferIndex] = true;
+
         ExitOnFailure(ID3D12GraphicsCommandList_Close(commandList));
 
         ID3D12CommandList* const commandLists[] = { (ID3D12CommandList* const)commandList };
@@ -1023,13 +3007,22 @@ void Render(IDXGISwapChain4* swapChain, ID3D12CommandQueue* g_CommandQueue,
 
         g_FrameFenceValues[g_CurrentBackBufferIndex] = Signal(g_CommandQueue, g_Fence, &g_FenceValue);
 
-        UINT syncInterval = 1;
-        UINT presentFlags = 0;
+        if (frame->GpuDrivenCulling && frame->ValidateGpuCulling)
+        {
+            WaitForFenceValue(g_Fence, g_FrameFenceValues[g_CurrentBackBufferIndex], g_FenceEvent, 0);
+            ValidateGpuCulling(gpuCulling, g_CurrentBackBufferIndex);
+        }
+
+        // Tearing needs the flag on the swap chain, without it the frames are still presented
+        // without waiting but only shown on the vertical blanks
+        UINT syncInterval = frame->PresentMode == PRESENT_MODE_VSYNC ? 1 : 0;
+        UINT presentFlags = syncInterval == 0 && g_TearingSupported ? DXGI_PRESENT_ALLOW_TEARING : 0;
         ExitOnFailure(IDXGISwapChain4_Present(swapChain, syncInterval, presentFlags));
 
         g_CurrentBackBufferIndex = IDXGISwapChain4_GetCurrentBackBufferIndex(swapChain);
 
         WaitForFenceValue(g_Fence, g_FrameFenceValues[g_CurrentBackBufferIndex], g_FenceEvent, 0);
+        FrameArenas_Reset(&g_Context.FrameArenas, g_CurrentBackBufferIndex);
     }
 }
 
@@ -1049,32 +3042,526 @@ void UpdatePerspective(int width, int height, float fov)
 
 typedef struct ResizeData
 {
-    D3D12_VIEWPORT* viewport;
-    ID3D12Device2* device;
-    ID3D12Resource** depthBuffer;
     float fov;
 } ResizeData;
 
+// Compares the time the frames took with the time the two stages took, which is what they
+// would take running back to back on one thread, once a second
+// The frame times in the title of the window, set by a job pinned to the main thread
+typedef struct WindowTitle
+{
+    GLFWwindow* Window;
+    char Text[200];
+    JobCounter Counter;
+} WindowTitle;
+
+void SetWindowTitle(void* userData)
+{
+    WindowTitle* title = userData;
+    glfwSetWindowTitle(title->Window, title->Text);
+}
+
+void ReportPipelining(GLFWwindow* window, double simulationMilliseconds, double renderMilliseconds,
+                      double frameMilliseconds)
+{
+    static WindowTitle title = { 0 };
+    static uint64_t frameCounter = 0;
+    static double simulationTime = 0.0;
+    static double renderTime = 0.0;
+    static double frameTime = 0.0;
+
+    frameCounter++;
+    simulationTime += simulationMilliseconds;
+    renderTime += renderMilliseconds;
+    frameTime += frameMilliseconds;
+    if (frameTime > 1000.0)
+    {
+        double serialTime = simulationTime + renderTime;
+        double recovered = serialTime > 0.0 ? 100.0 * (serialTime - frameTime) / serialTime : 0.0;
+
+        char buffer[500];
+        sprintf_s(buffer, 500, "Pipelining: %.3f ms simulating, %.3f ms rendering, %.3f ms per frame, "
+                  "%.1f%% of the serial frame time recovered\n", simulationTime / frameCounter,
+                  renderTime / frameCounter, frameTime / frameCounter, recovered);
+        OutputDebugString(buffer);
+
+        // Skipped while the main thread hasn't set the previous title yet, a title that can't be
+        // queued is merely dropped
+        if (JobCounter_IsDone(&title.Counter))
+        {
+            title.Window = window;
+            sprintf_s(title.Text, sizeof(title.Text), "Hello D3D12! %.2f ms per frame, %.2f ms simulating, "
+                      "%.2f ms rendering", frameTime / frameCounter, simulationTime / frameCounter,
+                      renderTime / frameCounter);
+            JobSystem_RunPinned((JobDecl){ SetWindowTitle, &title }, &title.Counter);
+        }
+
+        frameCounter = 0;
+        simulationTime = 0.0;
+        renderTime = 0.0;
+        frameTime = 0.0;
+    }
+}
+
+void EvictPageables(void* context, void* const* pageables, uint32_t count)
+{
+    SceneResidency* residency = context;
+    ExitOnFailure(ID3D12Device2_Evict(residency->Device, count, (ID3D12Pageable* const*)pageables));
+}
+
+// Blocks until the heaps are resident again
+void MakePageablesResident(void* context, void* const* pageables, uint32_t count)
+{
+    SceneResidency* residency = context;
+    ExitOnFailure(ID3D12Device2_MakeResident(residency->Device, count, (ID3D12Pageable* const*)pageables));
+}
+
+void WaitForPageables(void* context, uint64_t fence)
+{
+    WaitForFenceValue(g_Fence, fence, g_FenceEvent, 0);
+}
+
+// Tracks a resource with the size of its heap, the GPU may not use it at the moment
+void TrackResource(SceneResidency* residency, ResidencyObject* object, ID3D12Resource* resource)
+{
+    D3D12_RESOURCE_DESC desc;
+    ID3D12Resource_GetDesc(resource, &desc);
+    D3D12_RESOURCE_ALLOCATION_INFO allocationInfo;
+    ID3D12Device2_GetResourceAllocationInfo(residency->Device, &allocationInfo, 0, 1, &desc);
+    if (!ResidencyManager_Track(&residency->Manager, object, (ID3D12Pageable*)resource, allocationInfo.SizeInBytes))
+        exit(HD_EXIT_FAILURE);
+}
+
+// Reports whenever heaps were paged or a frame didn't fit the budget, which the OS otherwise
+// handles silently with a hitch
+void ReportResidency(SceneResidency* residency)
+{
+    const ResidencyCounters* counters = &residency->Manager.Counters;
+    ResidencyCounters* reported = &residency->Reported;
+    if (counters->EvictionCount == reported->EvictionCount && counters->MadeResidentCount == reported->MadeResidentCount &&
+        counters->OverBudgetCount == reported->OverBudgetCount)
+        return;
+
+    char buffer[500];
+    sprintf_s(buffer, 500, "Residency: %u heaps evicted (%.1f MB), %u made resident (%.1f MB), %u waits, "
+              "%u frames over budget, %.1f of %.1f MB used, %.1f MB tracked resident\n",
+              counters->EvictionCount - reported->EvictionCount,
+              (counters->EvictedSize - reported->EvictedSize) / (1024.0 * 1024.0),
+              counters->MadeResidentCount - reported->MadeResidentCount,
+              (counters->MadeResidentSize - reported->MadeResidentSize) / (1024.0 * 1024.0),
+              counters->WaitCount - reported->WaitCount, counters->OverBudgetCount - reported->OverBudgetCount,
+              counters->Usage / (1024.0 * 1024.0), counters->Budget / (1024.0 * 1024.0),
+              counters->ResidentSize / (1024.0 * 1024.0));
+    OutputDebugString(buffer);
+    *reported = *counters;
+}
+
+// Polls the budget and pages for the frame about to be submitted, which signals the next
+// fence value
+void UpdateResidency(SceneResidency* residency, const FrameSnapshot* frame)
+{
+    DXGI_QUERY_VIDEO_MEMORY_INFO memoryInfo;
+    ExitOnFailure(IDXGIAdapter4_QueryVideoMemoryInfo(residency->Adapter, 0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &memoryInfo));
+
+    ResidencyManager* manager = &residency->Manager;
+    ResidencyManager_SetBudget(manager, memoryInfo.Budget, memoryInfo.CurrentUsage);
+    bool used = ResidencyManager_Use(manager, &residency->VertexBuffer) &&
+                ResidencyManager_Use(manager, &residency->IndexBuffer) &&
+                ResidencyManager_Use(manager, &residency->Texture) &&
+                ResidencyManager_Use(manager, &residency->DepthBuffer) &&
+                ResidencyManager_Use(manager, &residency->SceneColor);
+    for (int i = 0; i < _countof(residency->CullingBuffers) && frame->GpuDrivenCulling; ++i)
+        used = used && ResidencyManager_Use(manager, &residency->CullingBuffers[i]);
+    if (!used)
+        exit(HD_EXIT_FAILURE);
+
+    ResidencyManager_Submit(manager, ID3D12Fence_GetCompletedValue(g_Fence), g_FenceValue + 1);
+    ReportResidency(residency);
+}
+
+// Averages the GPU time and the scale of the scene over a couple of seconds
+void ReportDynamicResolution(float gpuMilliseconds, float scale)
+{
+    static uint32_t frameCounter = 0;
+    static double gpuTime = 0.0;
+    static double scaleSum = 0.0;
+
+    frameCounter++;
+    gpuTime += gpuMilliseconds;
+    scaleSum += scale;
+    if (frameCounter == DYNAMIC_RESOLUTION_REPORT_FRAMES)
+    {
+        char buffer[500];
+        sprintf_s(buffer, 500, "Dynamic resolution: %.3f ms on the GPU for a target of %.3f ms, scale %.3f\n",
+                  gpuTime / frameCounter, DYNAMIC_RESOLUTION_TARGET_MS, scaleSum / frameCounter);
+        OutputDebugString(buffer);
+
+        frameCounter = 0;
+        gpuTime = 0.0;
+        scaleSum = 0.0;
+    }
+}
+
+// GPU time of the last frame drawn into the back buffer, once its fence has completed
+float ReadGpuMilliseconds(ScaledScene* scene, UINT frameIndex)
+{
+    uint64_t* timestamps;
+    D3D12_RANGE readRange = { 2 * frameIndex * sizeof(uint64_t), 2 * (frameIndex + 1) * sizeof(uint64_t) };
+    ExitOnFailure(ID3D12Resource_Map(scene->Readback, 0, &readRange, (void**)&timestamps));
+    uint64_t ticks = timestamps[2 * frameIndex + 1] - timestamps[2 * frameIndex];
+    D3D12_RANGE writeRange = { 0, 0 };
+    ID3D12Resource_Unmap(scene->Readback, 0, &writeRange);
+    return (float)(ticks * 1000.0 / scene->TimestampFrequency);
+}
+
+// Hands the GPU time of the last frame drawn into the back buffer to the benchmark
+void RecordGpuTime(ScaledScene* scene, UINT frameIndex)
+{
+    if (g_Context.Benchmark != NULL && scene->Measured[frameIndex])
+    {
+        Benchmark_Record(g_Context.Benchmark, BENCHMARK_METRIC_GPU, (uint32_t)(scene->Frames[frameIndex] - 1),
+                         ReadGpuMilliseconds(scene, frameIndex));
+    }
+}
+
+// Picks the scale of the frame about to be drawn. The timestamps of the last frame drawn into
+// this back buffer are complete, its fence was waited on before it was handed out again.
+void UpdateDynamicResolution(ScaledScene* scene, const FrameSnapshot* frame)
+{
+    UINT frameIndex = g_CurrentBackBufferIndex;
+    if (!frame->DynamicResolution)
+    {
+        // Starts over from the full resolution once it's enabled again
+        DynamicResolution_Init(&scene->Controller, &scene->Controller.Settings);
+        scene->Scale = scene->Controller.Scale;
+        return;
+    }
+    if (!scene->Measured[frameIndex])
+        return;
+
+    float gpuMilliseconds = ReadGpuMilliseconds(scene, frameIndex);
+    scene->Scale = DynamicResolution_Update(&scene->Controller, gpuMilliseconds, scene->Scales[frameIndex]);
+    ReportDynamicResolution(gpuMilliseconds, scene->Scale);
+}
+
+// Decompresses on a streamer thread into memory of its own, a DDS has to be parsed before
+// its levels can be laid out in an upload buffer
+void* StageAsset(void* context, const AssetEntry* entry, void* requestData)
+{
+    return malloc(entry->Size > 0 ? entry->Size : 1);
+}
+
+// Replaces the scene texture it was requested for. The queue is flushed first, so neither the
+// texture nor the command allocator are in use, a one-off stall once the texture arrives.
+void CompleteAsset(void* context, const AssetEntry* entry, void* destination, bool loaded, void* requestData)
+{
+    StreamedAssets* assets = context;
+    SceneTexture* texture = requestData;
+    DdsTexture dds;
+    if (loaded && !assets->ShuttingDown && Dds_Parse(destination, entry->Size, &dds) &&
+        (!TextureFormat_IsCompressed(dds.Format) || (dds.Width % 4 == 0 && dds.Height % 4 == 0)))
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        char buffer[500];
+        sprintf_s(buffer, 500, "Streamed %u bytes in %.2f ms\n", entry->Size, GetElapsedMilliseconds(assets->RequestTime, now));
+        OutputDebugString(buffer);
+        ReportTexture("Cube", &dds);
+
+        Flush(assets->CommandQueue, g_Fence, &g_FenceValue, g_FenceEvent);
+        ResidencyManager_Untrack(&assets->Residency->Manager, &assets->Residency->Texture);
+        ReleaseSceneTexture(texture);
+        CreateSceneTexture(assets->Device, assets->CommandQueue, g_CommandAllocators[g_CurrentBackBufferIndex],
+            assets->CommandList, assets->MipGenerator, &dds, texture);
+        TrackResource(assets->Residency, &assets->Residency->Texture, texture->Resource);
+    }
+    free(destination);
+}
+
+// Draws the snapshots the simulation publishes until the pipeline is closed. Everything
+// touching the command queue and the swap chain after loading happens on this thread.
+int RenderThreadMain(void* argument)
+{
+    RenderThreadData* data = argument;
+
+    // Keeps the culling and draw sorting of this thread spread over the workers, and gives
+    // it frame arenas
+    if (!JobSystem_AttachThread())
+        exit(HD_EXIT_FAILURE);
+
+    LARGE_INTEGER previousStart = { 0 };
+    FrameSnapshot* frame;
+    while ((frame = FramePipeline_Acquire(data->Pipeline)) != NULL)
+    {
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+
+        if (data->Streamer != NULL)
+            AssetStreamer_Poll(data->Streamer);
+
+        if (frame->Width != (int)data->Viewport->Width || frame->Height != (int)data->Viewport->Height)
+        {
+            data->Viewport->Width = (float)frame->Width;
+            data->Viewport->Height = (float)frame->Height;
+            ResidencyManager_Untrack(&data->Residency->Manager, &data->Residency->DepthBuffer);
+            ResizeDepthBuffer(data->Device, frame->Width, frame->Height, data->DepthBuffer);
+            TrackResource(data->Residency, &data->Residency->DepthBuffer, *data->DepthBuffer);
+            ResidencyManager_Untrack(&data->Residency->Manager, &data->Residency->SceneColor);
+            ResizeScaledScene(data->Device, frame->Width, frame->Height, data->Scene);
+            TrackResource(data->Residency, &data->Residency->SceneColor, data->Scene->ColorBuffer);
+        }
+
+        // Nothing else is signaled before the frame is submitted
+        UpdateResidency(data->Residency, frame);
+        RecordGpuTime(data->Scene, g_CurrentBackBufferIndex);
+        UpdateDynamicResolution(data->Scene, frame);
+
+        Render(data->SwapChain, data->CommandQueue, data->CommandList, data->PipelineState,
+               data->RootSignature, data->VertexBufferView, data->IndexBufferView, data->Lods,
+               data->Culling, data->Bundles, data->DebugLines, data->Particles, data->Texture, data->Scene,
+               frame, data->Viewport, data->ScissorRect);
+        QueryPerformanceCounter(&end);
+        if (g_Context.Benchmark != NULL)
+        {
+            Benchmark_Record(g_Context.Benchmark, BENCHMARK_METRIC_RENDER, (uint32_t)(frame->Frame - 1),
+                             GetElapsedMilliseconds(start, end));
+        }
+
+        if (previousStart.QuadPart != 0)
+        {
+            ReportPipelining(data->Window, frame->SimulationMilliseconds, GetElapsedMilliseconds(start, end),
+                             GetElapsedMilliseconds(previousStart, start));
+        }
+        previousStart = start;
+
+        if (frame->BenchmarkBundles)
+        {
+            StaticDrawInputs inputs = {
+                .PipelineState = data->Bundles->PipelineState,
+                .RootSignature = data->RootSignature,
+                .VertexBufferView = *data->VertexBufferView,
+                .IndexBufferView = *data->IndexBufferView,
+                .DescriptorHeap = data->Texture->DescriptorHeap,
+                .Texture = data->Texture->View,
+                .Lods = data->Lods
+            };
+            BenchmarkBundles(data->Device, &inputs, frame, data->Lods, data->Viewport);
+        }
+    }
+
+    JobSystem_DetachThread();
+    return 0;
+}
+
+void ReportPresentMode()
+{
+    char buffer[500];
+    const char* tearing = g_TearingSupported ? " with tearing" : "";
+    if (g_Context.PresentMode == PRESENT_MODE_VSYNC)
+        sprintf_s(buffer, 500, "Present mode: vsync\n");
+    else if (g_Context.PresentMode == PRESENT_MODE_IMMEDIATE)
+        sprintf_s(buffer, 500, "Present mode: immediate%s\n", tearing);
+    else
+        sprintf_s(buffer, 500, "Present mode: immediate%s, capped at %.1f Hz\n", tearing, g_Context.FrameRateCap);
+    OutputDebugString(buffer);
+}
+
+// Picks the present mode from vsync, immediate or a rate in Hz to cap it at
+bool ParsePresentMode(const char* value)
+{
+    if (strcmp(value, "vsync") == 0)
+        g_Context.PresentMode = PRESENT_MODE_VSYNC;
+    else if (strcmp(value, "immediate") == 0)
+        g_Context.PresentMode = PRESENT_MODE_IMMEDIATE;
+    else if (atof(value) > 0.0)
+    {
+        g_Context.PresentMode = PRESENT_MODE_CAPPED;
+        g_Context.FrameRateCap = atof(value);
+    }
+    else
+        return false;
+    return true;
+}
+
+// Picks the storage format of the mesh positions from float32, unorm16 or float16
+bool ParsePositionFormat(const char* value)
+{
+    if (strcmp(value, "float32") == 0)
+        g_VertexLayout.Position = POSITION_FORMAT_FLOAT32;
+    else if (strcmp(value, "unorm16") == 0)
+        g_VertexLayout.Position = POSITION_FORMAT_UNORM16;
+    else if (strcmp(value, "float16") == 0)
+        g_VertexLayout.Position = POSITION_FORMAT_FLOAT16;
+    else
+        return false;
+    return true;
+}
+
+// Every option takes a value. --benchmark creates the benchmark of the workload, presented
+// immediately unless --present says otherwise. --capture records the commands of the run into
+// a file, --replay draws the frames of one instead of simulating any.
+bool ParseArguments(int argc, char** argv, Benchmark* benchmark, const char** reportPath, const char** capturePath,
+                    const char** replayPath)
+{
+    g_Context.PresentMode = PRESENT_MODE_VSYNC;
+    g_Context.FrameRateCap = DEFAULT_FRAME_RATE_CAP;
+    const char* workload = NULL;
+    uint32_t frameCount = BENCHMARK_DEFAULT_FRAMES;
+    uint32_t warmUpFrames = BENCHMARK_DEFAULT_WARM_UP_FRAMES;
+    bool presentModeSet = false;
+    *reportPath = "benchmark.json";
+    *capturePath = NULL;
+    *replayPath = NULL;
+    if (argc % 2 == 0)
+        return false;
+    for (int i = 1; i < argc; i += 2)
+    {
+        const char* option = argv[i];
+        const char* value = argv[i + 1];
+        if (strcmp(option, "--present") == 0 && ParsePresentMode(value))
+            presentModeSet = true;
+        else if (strcmp(option, "--position-format") == 0 && ParsePositionFormat(value))
+            continue;
+        else if (strcmp(option, "--benchmark") == 0)
+            workload = value;
+        else if (strcmp(option, "--frames") == 0)
+            frameCount = (uint32_t)atoi(value);
+        else if (strcmp(option, "--warm-up") == 0)
+            warmUpFrames = (uint32_t)atoi(value);
+        else if (strcmp(option, "--report") == 0)
+            *reportPath = value;
+        else if (strcmp(option, "--capture") == 0)
+            *capturePath = value;
+        else if (strcmp(option, "--replay") == 0)
+            *replayPath = value;
+        else
+            return false;
+    }
+
+    if (workload == NULL)
+        return true;
+    if (!Benchmark_Create(benchmark, Benchmark_FindWorkload(workload), warmUpFrames, frameCount))
+        return false;
+    if (!presentModeSet)
+        g_Context.PresentMode = PRESENT_MODE_IMMEDIATE;
+    g_Context.Benchmark = benchmark;
+    return true;
+}
+
+// Adds the time since the previous phase of the startup to the benchmark
+void MarkStartupPhase(const char* name, LARGE_INTEGER* previous)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    if (g_Context.Benchmark != NULL)
+        Benchmark_AddStartupPhase(g_Context.Benchmark, name, GetElapsedMilliseconds(*previous, now));
+    *previous = now;
+}
+
+void KeyPressed(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (action != GLFW_PRESS || g_Context.Benchmark != NULL)
+        return;
+
+    if (key == GLFW_KEY_G)
+        g_Context.GpuDrivenCulling = !g_Context.GpuDrivenCulling;
+    else if (key == GLFW_KEY_V)
+        g_Context.ValidateGpuCulling = true;
+    else if (key == GLFW_KEY_B)
+        g_Context.BenchmarkBundles = true;
+    else if (key == GLFW_KEY_L)
+        g_Context.DrawBounds = !g_Context.DrawBounds;
+    else if (key == GLFW_KEY_P)
+        g_Context.DrawParticles = !g_Context.DrawParticles;
+    else if (key == GLFW_KEY_R)
+        g_Context.DynamicResolution = !g_Context.DynamicResolution;
+    else if (key == GLFW_KEY_M)
+    {
+        g_Context.PresentMode = (g_Context.PresentMode + 1) % PRESENT_MODE_COUNT;
+        ReportPresentMode();
+    }
+}
+
+// The render thread resizes the depth buffer once it draws a frame simulated for the new size
 void Resize(GLFWwindow* window, int width, int height)
 {
     ResizeData* resizeData = glfwGetWindowUserPointer(window);
-    resizeData->viewport->Width = (float)width;
-    resizeData->viewport->Height = (float)height;
+    g_Context.WindowWidth = width;
+    g_Context.WindowHeight = height;
 
-    ResizeDepthBuffer(resizeData->device, width, height, resizeData->depthBuffer);
     UpdatePerspective(width, height, resizeData->fov);
 }
 
-int main()
+int main(int argc, char** argv)
 {
 #ifdef _DEBUG
     EnableDebuggingLayer();
 #endif
 
+    LARGE_INTEGER startupPhaseStart;
+    QueryPerformanceCounter(&startupPhaseStart);
+
+    Benchmark benchmark;
+    const char* benchmarkReportPath;
+    const char* capturePath;
+    const char* replayPath;
+    if (!ParseArguments(argc, argv, &benchmark, &benchmarkReportPath, &capturePath, &replayPath))
+    {
+        char buffer[500];
+        sprintf_s(buffer, 500, "Usage: hello-d3d12 [--present vsync|immediate|HZ] "
+                  "[--position-format float32|unorm16|float16] "
+                  "[--benchmark WORKLOAD [--frames N] [--warm-up N] [--report PATH]] "
+                  "[--capture PATH | --replay PATH]\n"
+                  "The workloads are %s\n", Benchmark_GetWorkloadNames());
+        OutputDebugString(buffer);
+        exit(HD_EXIT_FAILURE);
+    }
+
+    // The objects are numbered from the first one on, a replay needs the startup of the capture
+    if (!CommandCapture_Initialise() || (capturePath != NULL && !CommandCapture_Open(capturePath)))
+        exit(HD_EXIT_FAILURE);
+
     GLFWwindow* window;
     if (!glfwInit())
         exit(HD_EXIT_FAILURE);
 
+    // Job system workers, this thread becomes the main thread running the pinned jobs
+    if (!Parallel_Initialise(0))
+        exit(HD_EXIT_FAILURE);
+
+    // The scene graph, only holding the cube for now. A benchmark adds its instances after it,
+    // they're all drawn with the cube's mesh.
+    mat4 identity = GLM_MAT4_IDENTITY_INIT;
+    if (!TransformHierarchy_Create(&g_Context.Transforms, 1) ||
+        TransformHierarchy_AddNode(&g_Context.Transforms, TRANSFORM_NO_PARENT, identity) != CUBE_NODE)
+        exit(HD_EXIT_FAILURE);
+    for (uint32_t i = 1; g_Context.Benchmark != NULL && i < g_Context.Benchmark->Workload->InstanceCount; ++i)
+    {
+        if (TransformHierarchy_AddNode(&g_Context.Transforms, TRANSFORM_NO_PARENT, identity) < 0)
+            exit(HD_EXIT_FAILURE);
+    }
+
+    if (!FrameArenas_Create(&g_Context.FrameArenas, FRAMES_NUM, FRAME_ARENA_BLOCK_SIZE) ||
+        !SphereBounds_Resize(&g_Context.NodeBounds, g_Context.Transforms.Count) ||
+        !DrawQueue_Create(&g_Context.DrawQueue, g_Context.Transforms.Count))
+        exit(HD_EXIT_FAILURE);
+
+    // A fountain above the cube
+    ParticleEmitter fountain = {
+        .Position = { 0.0f, 1.5f, 0.0f },
+        .Velocity = { 0.0f, 6.0f, 0.0f },
+        .Spread = 1.5f,
+        .Rate = 200000.0f,
+        .MinLifetime = 1.5f,
+        .MaxLifetime = 3.0f,
+        .StartSize = 0.02f,
+        .EndSize = 0.06f,
+        .Color = 0x0040A0FFu
+    };
+    if (!ParticleSystem_Create(&g_Context.Particles, PARTICLE_CAPACITY, &fountain))
+        exit(HD_EXIT_FAILURE);
+    MarkStartupPhase("scene", &startupPhaseStart);
+
     const uint32_t width = 1280;
     const uint32_t height = 720;
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -1084,24 +3571,26 @@ int main()
         glfwTerminate();
         exit(HD_EXIT_FAILURE);
     }
-    glfwSwapInterval(1);
     HWND hWnd = glfwGetWin32Window(window);
     ResizeData resizeData;
     glfwSetWindowUserPointer(window, (void*)&resizeData);
     glfwSetWindowSizeCallback(window, &Resize);
+    glfwSetKeyCallback(window, &KeyPressed);
+    MarkStartupPhase("window", &startupPhaseStart);
 
     IDXGIAdapter4* dxgiAdapter4 = GetAdapter();
     ID3D12Device2* device = CreateDevice(dxgiAdapter4);
     ID3D12CommandQueue* g_CommandQueue = CreateCommandQueue(device, D3D12_COMMAND_LIST_TYPE_DIRECT);
+    g_TearingSupported = CheckTearingSupport();
     IDXGISwapChain4* swapChain = CreateSwapChain(hWnd, g_CommandQueue,
-                                                 width, height, FRAMES_NUM);
-
-    resizeData.device = device;
+                                                 width, height, FRAMES_NUM, g_TearingSupported);
+    ReportPresentMode();
 
     g_CurrentBackBufferIndex = IDXGISwapChain4_GetCurrentBackBufferIndex(swapChain);
 
-    g_RTVDescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, FRAMES_NUM);
-    g_DSVDescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 1);
+    g_RTVDescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, FRAMES_NUM,
+                                              D3D12_DESCRIPTOR_HEAP_FLAG_NONE);
+    g_DSVDescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 1, D3D12_DESCRIPTOR_HEAP_FLAG_NONE);
     g_RTVDescriptorSize = ID3D12Device2_GetDescriptorHandleIncrementSize(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 
     UpdateRenderTargetViews(device, swapChain, g_RTVDescriptorHeap);
@@ -1116,15 +3605,64 @@ int main()
 
     g_Fence = CreateFence(device);
     g_FenceEvent = CreateEventHandle();
+    MarkStartupPhase("device", &startupPhaseStart);
 
     // Vertex buffer for the cube.
     ID3D12Resource* vertexBuffer = NULL;
     ID3D12Resource* intermediateVertexBuffer = NULL;
 
+    // Reorder the cube for the vertex cache, overdraw and vertex fetch
+    Vertex cubeVertices[_countof(g_Vertices)];
+    uint32_t cubeIndices[_countof(g_Indicies)];
+    memcpy(cubeVertices, g_Vertices, sizeof(g_Vertices));
+    for (int i = 0; i < _countof(g_Indicies); ++i)
+    {
+        cubeIndices[i] = g_Indicies[i];
+    }
+
+    MeshOptimizationStats optimizationStats;
+    if (!OptimizeMesh(cubeIndices, _countof(cubeIndices), cubeVertices, _countof(cubeVertices),
+                      sizeof(Vertex), offsetof(Vertex, Position), &optimizationStats))
+        exit(HD_EXIT_FAILURE);
+    ReportOptimizationStats("Cube", &optimizationStats);
+
+    // Build the levels of detail over the optimized vertices
+    LodChain cubeLods;
+    if (!BuildLodChain(cubeIndices, _countof(cubeIndices), cubeVertices[0].Position, sizeof(Vertex),
+                       optimizationStats.UniqueVertexCount, LOD_MAX_LEVELS, 0.5f, 1.0f, &cubeLods))
+        exit(HD_EXIT_FAILURE);
+    ReportLodChain("Cube", &cubeLods);
+
+    // The coarsest level only keeps original vertices, so it stays inside the bounds
+    const LodLevel* coarsestLevel = &cubeLods.Levels[cubeLods.LevelCount - 1];
+    g_Context.Occluder = (OccluderMesh){
+        .Positions = cubeVertices[0].Position,
+        .Stride = sizeof(Vertex),
+        .VertexCount = optimizationStats.UniqueVertexCount,
+        .Indices = cubeLods.Indices + coarsestLevel->IndexOffset,
+        .IndexCount = coarsestLevel->IndexCount
+    };
+    if (!OcclusionBuffer_Create(&g_Context.Occlusion, OCCLUSION_WIDTH, OCCLUSION_HEIGHT))
+        exit(HD_EXIT_FAILURE);
+
+    // Convert the vertices to the selected layout
+    MeshStreams cubeStreams = {
+        .Positions = cubeVertices[0].Position,
+        .PositionStride = sizeof(Vertex),
+        .Colors = cubeVertices[0].Color,
+        .ColorStride = sizeof(Vertex),
+        .VertexCount = optimizationStats.UniqueVertexCount
+    };
+    QuantizedMesh cubeMesh;
+    if (!QuantizeMesh(&cubeStreams, &g_VertexLayout, &cubeMesh))
+        exit(HD_EXIT_FAILURE);
+    ReportQuantizationStats("Cube", &cubeMesh);
+    UpdateDequantizeMatrix(&cubeMesh);
+
     // Initialise the vertex buffer
     LoadBuffer(device, g_CommandQueue, g_CommandAllocators[g_CurrentBackBufferIndex],
         g_CommandList, &vertexBuffer, &intermediateVertexBuffer,
-        _countof(g_Vertices), sizeof(Vertex), g_Vertices);
+        cubeMesh.VertexCount, cubeMesh.Stride, cubeMesh.Data);
 
     ID3D12Object_SetName(vertexBuffer, L"VertexBuffer");
     ID3D12Object_SetName(intermediateVertexBuffer, L"IntermediateVertexBuffer");
@@ -1132,56 +3670,280 @@ int main()
     D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
 
     vertexBufferView.BufferLocation = ID3D12Resource_GetGPUVirtualAddress(vertexBuffer);
-    vertexBufferView.SizeInBytes = sizeof(g_Vertices);
-    vertexBufferView.StrideInBytes = sizeof(Vertex);
+    vertexBufferView.SizeInBytes = (UINT)cubeMesh.Stats.QuantizedBytes;
+    vertexBufferView.StrideInBytes = cubeMesh.Stride;
+
+    // The upload has completed, only the dequantization transform is needed from now on
+    QuantizedMesh_Release(&cubeMesh);
+
+    // Index buffer holding every level of the cube, 16-bit whenever the vertex count allows it.
+    void* packedIndices = malloc(cubeLods.IndexCount * optimizationStats.IndexSize);
+    PackIndices(packedIndices, cubeLods.Indices, cubeLods.IndexCount, optimizationStats.IndexSize);
 
-    // Index buffer for the cube.
     ID3D12Resource* indexBuffer;
     ID3D12Resource* intermediateIndexBuffer;
     LoadBuffer(device, g_CommandQueue, g_CommandAllocators[g_CurrentBackBufferIndex],
         g_CommandList, &indexBuffer, &intermediateIndexBuffer,
-        _countof(g_Indicies), sizeof(WORD), g_Indicies);
+        cubeLods.IndexCount, optimizationStats.IndexSize, packedIndices);
+    free(packedIndices);
 
     ID3D12Object_SetName(indexBuffer, L"indexBuffer");
     ID3D12Object_SetName(intermediateIndexBuffer, L"intermediateIndexBuffer");
 
     D3D12_INDEX_BUFFER_VIEW indexBufferView;
     indexBufferView.BufferLocation = ID3D12Resource_GetGPUVirtualAddress(indexBuffer);
-    indexBufferView.Format = DXGI_FORMAT_R16_UINT;
-    indexBufferView.SizeInBytes = sizeof(g_Indicies);
+    indexBufferView.Format = optimizationStats.IndexSize == sizeof(WORD) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    indexBufferView.SizeInBytes = (UINT)cubeLods.IndexCount * optimizationStats.IndexSize;
+    MarkStartupPhase("meshes", &startupPhaseStart);
+
+    // Texture of the cube. Block compressed textures need whole blocks on the top level. One in
+    // the archive is streamed in later, the fallback is drawn until then.
+    AssetArchive assetArchive;
+    bool streamTexture = AssetArchive_Open(ASSET_ARCHIVE_PATH, &assetArchive) &&
+                         AssetArchive_Find(&assetArchive, SCENE_TEXTURE_PATH) != NULL;
+    if (!streamTexture)
+        AssetArchive_Close(&assetArchive);
+    DdsTexture cubeTexture = { 0 };
+    if (streamTexture || !Dds_Load(SCENE_TEXTURE_PATH, &cubeTexture) ||
+        (TextureFormat_IsCompressed(cubeTexture.Format) && (cubeTexture.Width % 4 != 0 || cubeTexture.Height % 4 != 0)))
+    {
+        Dds_Release(&cubeTexture);
+        if (!CreateFallbackTexture(&cubeTexture))
+            exit(HD_EXIT_FAILURE);
+    }
+    ReportTexture("Cube", &cubeTexture);
+
+    // Textures without mips get them on the GPU
+    MipGenerator mipGenerator;
+    CreateMipGenerator(device, &mipGenerator);
+
+    SceneTexture sceneTexture;
+    CreateSceneTexture(device, g_CommandQueue, g_CommandAllocators[g_CurrentBackBufferIndex], g_CommandList,
+        &mipGenerator, &cubeTexture, &sceneTexture);
+    Dds_Release(&cubeTexture);
+
+    // The default heaps are kept within the budget of the adapter from the first frame on
+    SceneResidency sceneResidency = {
+        .Adapter = dxgiAdapter4,
+        .Device = device
+    };
+    ResidencyManager_Create(&sceneResidency.Manager, EvictPageables, MakePageablesResident, WaitForPageables,
+                            &sceneResidency);
+    TrackResource(&sceneResidency, &sceneResidency.VertexBuffer, vertexBuffer);
+    TrackResource(&sceneResidency, &sceneResidency.IndexBuffer, indexBuffer);
+    TrackResource(&sceneResidency, &sceneResidency.Texture, sceneTexture.Resource);
+
+    StreamedAssets streamedAssets = {
+        .Device = device,
+        .CommandQueue = g_CommandQueue,
+        .CommandList = g_CommandList,
+        .MipGenerator = &mipGenerator,
+        .Residency = &sceneResidency
+    };
+    AssetStreamer assetStreamer;
+    bool streaming = streamTexture && AssetStreamer_Create(&assetStreamer, &assetArchive, ASSET_DECODER_COUNT,
+                                                           StageAsset, CompleteAsset, &streamedAssets);
+    if (streaming)
+    {
+        QueryPerformanceCounter(&streamedAssets.RequestTime);
+        AssetStreamer_Request(&assetStreamer, SCENE_TEXTURE_PATH, ASSET_PRIORITY_HIGH, &sceneTexture);
+    }
+    MarkStartupPhase("textures", &startupPhaseStart);
 
     // Load the vertex shader.
     ID3DBlob* vertexShaderBlob = LoadShader(L"shaders/vertex.hlsl", "vs_5_1");
     // Load the pixel shader.
     ID3DBlob* pixelShaderBlob = LoadShader(L"shaders/pixel.hlsl", "ps_5_1");
+    // The cube samples the texture, the debug lines keep the vertex colors
+    ID3DBlob* texturedVertexShaderBlob = LoadShader(L"shaders/textured_vertex.hlsl", "vs_5_1");
+    // The bundled draws of the cube read their MVP from a buffer instead of the root constants
+    ID3DBlob* bundledVertexShaderBlob = LoadShader(L"shaders/bundled_vertex.hlsl", "vs_5_1");
+    ID3DBlob* texturedPixelShaderBlob = LoadShader(L"shaders/textured_pixel.hlsl", "ps_5_1");
 
     // Create depth buffer
     ID3D12Resource* depthBuffer = NULL;
     ResizeDepthBuffer(device, width, height, &depthBuffer);
-    resizeData.depthBuffer = &depthBuffer;
+    TrackResource(&sceneResidency, &sceneResidency.DepthBuffer, depthBuffer);
+
+    // The scene is drawn at a scale of the window picked from the GPU time and stretched onto
+    // the back buffer
+    ScaledScene scaledScene;
+    CreateScaledScene(device, g_CommandQueue, &scaledScene);
+    ResizeScaledScene(device, width, height, &scaledScene);
+    TrackResource(&sceneResidency, &sceneResidency.SceneColor, scaledScene.ColorBuffer);
+    // A benchmark measures the scene at the full resolution
+    g_Context.DynamicResolution = g_Context.Benchmark == NULL;
 
     // Root signature
-    ID3D12RootSignature* rootSignature = CreateRootSignature(device);
+    ID3D12RootSignature* rootSignature = CreateRootSignature(device, sizeof(mat4) / sizeof(float), true);
 
     // Pipeline state object.
-    ID3D12PipelineState* pipelineState = CreatePipelineState(device, rootSignature, vertexShaderBlob, pixelShaderBlob);
+    ID3D12PipelineState* pipelineState = CreatePipelineState(device, rootSignature, texturedVertexShaderBlob,
+        texturedPixelShaderBlob, &g_VertexLayout, D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
+
+    // Culling passes and the command signature of the indirect draws
+    GpuCulling gpuCulling;
+    CreateGpuCulling(device, rootSignature, (uint32_t)g_Context.Transforms.Count, &gpuCulling);
+    ID3D12Resource* cullingBuffers[] = { gpuCulling.Commands, gpuCulling.DrawCount, gpuCulling.Visibility, gpuCulling.GroupData };
+    for (int i = 0; i < _countof(cullingBuffers); ++i)
+    {
+        TrackResource(&sceneResidency, &sceneResidency.CullingBuffers[i], cullingBuffers[i]);
+    }
+    g_Context.GpuDrivenCulling = true;
+
+    // Static draws of the CPU culling path
+    DrawBundles drawBundles;
+    CreateDrawBundles(device, rootSignature, bundledVertexShaderBlob, texturedPixelShaderBlob,
+        g_Context.Transforms.Count, &drawBundles);
+
+    // Bounding spheres drawn over the scene
+    DebugLines debugLines;
+    CreateDebugLines(device, rootSignature, vertexShaderBlob, pixelShaderBlob, &debugLines);
+
+    // Instanced billboards of the particles
+    ParticleBillboards particleBillboards;
+    CreateParticleBillboards(device, &particleBillboards);
+    MarkStartupPhase("pipelines", &startupPhaseStart);
 
     D3D12_VIEWPORT viewport = { 0.0f, 0.0f, (float)width, (float)height, D3D12_MIN_DEPTH, D3D12_MAX_DEPTH };
     D3D12_RECT scissorRect = { 0, 0, LONG_MAX, LONG_MAX };
 
-    resizeData.viewport = &viewport;
     resizeData.fov = 45.0f;
+    g_Context.WindowWidth = width;
+    g_Context.WindowHeight = height;
 
     UpdatePerspective(width, height, resizeData.fov);
     UpdateModelViewMatrices();
+
+    // The simulation of the next frame overlaps the submission of the previous one
+    FrameSnapshot snapshots[TRIPLE_BUFFER_SLOTS];
+    void* snapshotSlots[TRIPLE_BUFFER_SLOTS] = { &snapshots[0], &snapshots[1], &snapshots[2] };
+    FramePipeline framePipeline;
+    if (!CreateFrameSnapshots(snapshots, g_Context.Transforms.Count, g_Context.Particles.Capacity) ||
+        !FramePipeline_Create(&framePipeline, snapshotSlots))
+        exit(HD_EXIT_FAILURE);
+
+    // A replay draws the frames of the capture instead of the render thread, with the objects
+    // the same options created
+    if (replayPath != NULL)
+    {
+        CommandReplayTarget replayTarget = {
+            .Device = device,
+            .CommandQueue = g_CommandQueue,
+            .SwapChain = swapChain,
+            .Fence = g_Fence,
+            .FenceValue = &g_FenceValue,
+            .FenceEvent = g_FenceEvent
+        };
+        CommandReplayStats replayStats;
+        bool replayed = CommandCapture_Replay(replayPath, &replayTarget, &replayStats);
+        char buffer[500];
+        sprintf_s(buffer, 500, "Replay of %s %s: %llu frames, %llu commands, %llu skipped, %.2f ms on the CPU, "
+                  "%.0f commands/s\n", replayPath, replayed ? "complete" : "failed",
+                  replayStats.Frames, replayStats.Commands, replayStats.Skipped, replayStats.CpuMilliseconds,
+                  replayStats.CpuMilliseconds > 0.0 ? replayStats.Commands * 1000.0 / replayStats.CpuMilliseconds : 0.0);
+        OutputDebugString(buffer);
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+
+    RenderThreadData renderThreadData = {
+        .Pipeline = &framePipeline,
+        .Device = device,
+        .SwapChain = swapChain,
+        .CommandQueue = g_CommandQueue,
+        .CommandList = g_CommandList,
+        .PipelineState = pipelineState,
+        .RootSignature = rootSignature,
+        .VertexBufferView = &vertexBufferView,
+        .IndexBufferView = &indexBufferView,
+        .Lods = &cubeLods,
+        .Culling = &gpuCulling,
+        .Bundles = &drawBundles,
+        .DebugLines = &debugLines,
+        .Particles = &particleBillboards,
+        .Texture = &sceneTexture,
+        .DepthBuffer = &depthBuffer,
+        .Scene = &scaledScene,
+        .Viewport = &viewport,
+        .ScissorRect = &scissorRect,
+        .Streamer = streaming ? &assetStreamer : NULL,
+        .Residency = &sceneResidency,
+        .Window = window
+    };
+    thrd_t renderThread;
+    if (thrd_create(&renderThread, RenderThreadMain, &renderThreadData) != thrd_success)
+        exit(HD_EXIT_FAILURE);
+    MarkStartupPhase("threads", &startupPhaseStart);
+
+    // Holds the main thread to the capped rate, the render thread follows it through the frame
+    // pipeline. Waiting before the input is polled keeps the latency of the frame short.
+    FrameLimiter frameLimiter;
+    if (!FrameLimiter_Create(&frameLimiter, g_Context.FrameRateCap, NULL, NULL, NULL))
+        exit(HD_EXIT_FAILURE);
+
+    uint64_t frame = 0;
+    LARGE_INTEGER previousStart = { 0 };
     while (!glfwWindowShouldClose(window))
     {
-        Update();
-        Render(swapChain, g_CommandQueue, g_CommandList, pipelineState,
-               rootSignature, &vertexBufferView, &indexBufferView, &viewport,
-               &scissorRect);
+        if (g_Context.PresentMode == PRESENT_MODE_CAPPED)
+            FrameLimiter_Wait(&frameLimiter);
+        else
+            FrameLimiter_Reset(&frameLimiter);
+
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+
+        // The frame of a benchmark ends where the next one starts, the run once the last one did
+        if (g_Context.Benchmark != NULL)
+        {
+            if (previousStart.QuadPart != 0)
+            {
+                Benchmark_Record(g_Context.Benchmark, BENCHMARK_METRIC_FRAME, (uint32_t)(frame - 1),
+                                 GetElapsedMilliseconds(previousStart, start));
+            }
+            if (frame == Benchmark_GetTotalFrames(g_Context.Benchmark))
+                break;
+        }
+
         glfwPollEvents();
+        // Window and swap chain calls the jobs handed back to this thread
+        JobSystem_RunPinnedJobs();
+        Update();
+
+        // A benchmark steps by the same time every frame
+        float deltaSeconds = previousStart.QuadPart != 0 ?
+            (float)(GetElapsedMilliseconds(previousStart, start) / 1000.0) : 0.0f;
+        if (g_Context.Benchmark != NULL)
+            deltaSeconds = BENCHMARK_TIME_STEP;
+        previousStart = start;
+
+        FrameSnapshot* snapshot = FramePipeline_BeginFrame(&framePipeline);
+        Simulate(snapshot, ++frame, deltaSeconds);
+        QueryPerformanceCounter(&end);
+        snapshot->SimulationMilliseconds = GetElapsedMilliseconds(start, end);
+        if (g_Context.Benchmark != NULL)
+        {
+            Benchmark_Record(g_Context.Benchmark, BENCHMARK_METRIC_SIMULATION, (uint32_t)(frame - 1),
+                             snapshot->SimulationMilliseconds);
+        }
+
+        FramePipeline_Publish(&framePipeline);
+    }
+
+    // The frame published last is still drawn
+    FramePipeline_Close(&framePipeline);
+    thrd_join(renderThread, NULL);
+    // The window is still there for what the render thread pinned last
+    JobSystem_RunPinnedJobs();
+    FramePipeline_Destroy(&framePipeline);
+    if (streaming)
+    {
+        streamedAssets.ShuttingDown = true;
+        AssetStreamer_Destroy(&assetStreamer);
     }
+    AssetArchive_Close(&assetArchive);
+    ReleaseFrameSnapshots(snapshots);
+    FrameLimiter_Destroy(&frameLimiter);
 
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -1189,11 +3951,53 @@ int main()
     // Make sure the command queue has finished all commands before closing.
     Flush(g_CommandQueue, g_Fence, &g_FenceValue, g_FenceEvent);
 
+    if (capturePath != NULL && !CommandCapture_Close())
+    {
+        char buffer[500];
+        sprintf_s(buffer, 500, "The capture couldn't be written to %s\n", capturePath);
+        OutputDebugString(buffer);
+    }
+
+    // The GPU times of the frames still in flight at the end of the run are complete now
+    bool reportWritten = true;
+    if (g_Context.Benchmark != NULL)
+    {
+        for (UINT i = 0; i < FRAMES_NUM; ++i)
+        {
+            RecordGpuTime(&scaledScene, i);
+        }
+        reportWritten = Benchmark_WriteReport(&benchmark, "d3d12", benchmarkReportPath);
+        char buffer[500];
+        sprintf_s(buffer, 500, "Benchmark %s: %u frames after %u of warm-up, report %s %s\n",
+                  benchmark.Workload->Name, benchmark.FrameCount, benchmark.WarmUpFrames,
+                  reportWritten ? "written to" : "couldn't be written to", benchmarkReportPath);
+        OutputDebugString(buffer);
+        Benchmark_Destroy(&benchmark);
+    }
+
     CloseHandle(g_FenceEvent);
 
+    ResidencyManager_Destroy(&sceneResidency.Manager);
+    LodChain_Release(&cubeLods);
+    OcclusionBuffer_Destroy(&g_Context.Occlusion);
+    DrawQueue_Destroy(&g_Context.DrawQueue);
+    FrameArenas_Destroy(&g_Context.FrameArenas);
+    SphereBounds_Release(&g_Context.NodeBounds);
+    ParticleSystem_Destroy(&g_Context.Particles);
+    TransformHierarchy_Destroy(&g_Context.Transforms);
+    ReleaseDrawBundles(&drawBundles);
+    ReleaseDebugLines(&debugLines);
+    ReleaseParticleBillboards(&particleBillboards);
+    ReleaseGpuCulling(&gpuCulling);
+    ReleaseSceneTexture(&sceneTexture);
+    ReleaseMipGenerator(&mipGenerator);
+    ReleaseScaledScene(&scaledScene);
     ID3D12Resource_Release(depthBuffer);
     ID3D12PipelineState_Release(pipelineState);
     ID3D12RootSignature_Release(rootSignature);
+    ID3DBlob_Release(texturedVertexShaderBlob);
+    ID3DBlob_Release(bundledVertexShaderBlob);
+    ID3DBlob_Release(texturedPixelShaderBlob);
     ID3DBlob_Release(vertexShaderBlob);
     ID3DBlob_Release(pixelShaderBlob);
     ID3D12Resource_Release(indexBuffer);
@@ -1221,5 +4025,8 @@ int main()
     REPORT_LIVE_OBJ();
 #endif
 
-    return 0;
+    CommandCapture_Shutdown();
+    Parallel_Shutdown();
+
+    return reportWritten ? HD_EXIT_SUCCESS : HD_EXIT_FAILURE;
 }
\ No newline at end of file
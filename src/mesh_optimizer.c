@@ -0,0 +1,486 @@
+#include "mesh_optimizer.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+#define INVALID_INDEX (~0u)
+
+static float g_CachePositionScores[FORSYTH_CACHE_SIZE];
+static float g_ValenceScores[FORSYTH_MAX_VALENCE];
+static bool g_ScoreTablesInitialised = false;
+
+static void InitialiseScoreTables()
+{
+    if (g_ScoreTablesInitialised)
+        return;
+
+    for (int i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+    {
+        if (i < 3)
+        {
+            // The last triangle's vertices get a fixed score, so that it isn't
+            // beneficial to pick the same triangle twice in a row
+            g_CachePositionScores[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+        }
+        else
+        {
+            float scaler = 1.0f - (float)(i - 3) / (FORSYTH_CACHE_SIZE - 3);
+            g_CachePositionScores[i] = powf(scaler, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+
+    g_ValenceScores[0] = 0.0f;
+    for (int i = 1; i < FORSYTH_MAX_VALENCE; ++i)
+    {
+        // Boost vertices with few triangles left, so lone triangles don't get stranded
+        g_ValenceScores[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+    }
+
+    g_ScoreTablesInitialised = true;
+}
+
+static float GetVertexScore(int cachePosition, uint32_t liveValence)
+{
+    if (liveValence == 0)
+        return -1.0f;
+
+    float score = cachePosition >= 0 ? g_CachePositionScores[cachePosition] : 0.0f;
+    return score + g_ValenceScores[liveValence < FORSYTH_MAX_VALENCE ? liveValence : FORSYTH_MAX_VALENCE - 1];
+}
+
+void OptimizeVertexCache(uint32_t* dst, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    InitialiseScoreTables();
+
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    uint32_t* adjacencyOffsets = calloc(vertexCount + 1, sizeof(uint32_t));
+    uint32_t* liveValence = calloc(vertexCount, sizeof(uint32_t));
+    uint32_t* adjacency = malloc(indexCount * sizeof(uint32_t));
+    int* cachePositions = malloc(vertexCount * sizeof(int));
+    float* vertexScores = malloc(vertexCount * sizeof(float));
+    float* triangleScores = malloc(triangleCount * sizeof(float));
+    bool* emitted = calloc(triangleCount, sizeof(bool));
+
+    if (!adjacencyOffsets || !liveValence || !adjacency || !cachePositions ||
+        !vertexScores || !triangleScores || !emitted)
+    {
+        // Keep the authoring order
+        memcpy(dst, indices, indexCount * sizeof(uint32_t));
+        goto cleanup;
+    }
+
+    // Build the vertex -> triangle adjacency in CSR form
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        liveValence[indices[i]]++;
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveValence[v];
+        liveValence[v] = 0;
+    }
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t v = indices[t * 3 + k];
+            adjacency[adjacencyOffsets[v] + liveValence[v]++] = (uint32_t)t;
+        }
+    }
+
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        cachePositions[v] = -1;
+        vertexScores[v] = GetVertexScore(-1, liveValence[v]);
+    }
+
+    size_t bestTriangle = 0;
+    float bestScore = -1.0f;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32_t* tri = &indices[t * 3];
+        triangleScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+        if (triangleScores[t] > bestScore)
+        {
+            bestScore = triangleScores[t];
+            bestTriangle = t;
+        }
+    }
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+    size_t scanCursor = 0;
+
+    for (size_t out = 0; out < triangleCount; ++out)
+    {
+        if (bestScore < 0.0f)
+        {
+            // Nothing in the cache has live triangles left, restart from the next unemitted one
+            while (emitted[scanCursor])
+                scanCursor++;
+            bestTriangle = scanCursor;
+        }
+
+        const uint32_t* tri = &indices[bestTriangle * 3];
+        memcpy(&dst[out * 3], tri, 3 * sizeof(uint32_t));
+        emitted[bestTriangle] = true;
+
+        // Remove the triangle from the live adjacency of its vertices
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t v = tri[k];
+            uint32_t* list = &adjacency[adjacencyOffsets[v]];
+            for (uint32_t i = 0; i < liveValence[v]; ++i)
+            {
+                if (list[i] == bestTriangle)
+                {
+                    list[i] = list[liveValence[v] - 1];
+                    break;
+                }
+            }
+            liveValence[v]--;
+        }
+
+        // Push the triangle vertices to the front of the LRU cache
+        uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+        uint32_t newCacheCount = 0;
+        newCache[newCacheCount++] = tri[0];
+        newCache[newCacheCount++] = tri[1];
+        newCache[newCacheCount++] = tri[2];
+        for (uint32_t i = 0; i < cacheCount; ++i)
+        {
+            uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache[newCacheCount++] = v;
+        }
+
+        // Rescore the cached vertices, evicted ones drop their cache bonus
+        for (uint32_t i = 0; i < newCacheCount; ++i)
+        {
+            uint32_t v = newCache[i];
+            cachePositions[v] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+            vertexScores[v] = GetVertexScore(cachePositions[v], liveValence[v]);
+        }
+
+        // Only triangles touching the cache changed their score
+        bestScore = -1.0f;
+        for (uint32_t i = 0; i < newCacheCount; ++i)
+        {
+            uint32_t v = newCache[i];
+            const uint32_t* list = &adjacency[adjacencyOffsets[v]];
+            for (uint32_t j = 0; j < liveValence[v]; ++j)
+            {
+                uint32_t t = list[j];
+                const uint32_t* adjacent = &indices[t * 3];
+                float score = vertexScores[adjacent[0]] + vertexScores[adjacent[1]] + vertexScores[adjacent[2]];
+                triangleScores[t] = score;
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        cacheCount = newCacheCount < FORSYTH_CACHE_SIZE ? newCacheCount : FORSYTH_CACHE_SIZE;
+        memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+    }
+
+cleanup:
+    free(adjacencyOffsets);
+    free(liveValence);
+    free(adjacency);
+    free(cachePositions);
+    free(vertexScores);
+    free(triangleScores);
+    free(emitted);
+}
+
+// FIFO cache simulation through timestamps, returns the number of misses
+static size_t SimulateFifo(const uint32_t* indices, size_t indexCount, uint32_t* timestamps,
+                           uint32_t* timestamp, uint32_t cacheSize)
+{
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t v = indices[i];
+        if (*timestamp - timestamps[v] > cacheSize)
+        {
+            timestamps[v] = (*timestamp)++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+float ComputeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    if (indexCount < 3)
+        return 0.0f;
+
+    uint32_t* timestamps = calloc(vertexCount, sizeof(uint32_t));
+    if (timestamps == NULL)
+        return 0.0f;
+
+    uint32_t timestamp = cacheSize + 1;
+    size_t misses = SimulateFifo(indices, indexCount, timestamps, &timestamp, cacheSize);
+    free(timestamps);
+
+    return (float)misses / (float)(indexCount / 3);
+}
+
+float ComputeATVR(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    if (vertexCount == 0)
+        return 0.0f;
+
+    return ComputeACMR(indices, indexCount, vertexCount, cacheSize) * (float)(indexCount / 3) / (float)vertexCount;
+}
+
+typedef struct ClusterSortEntry
+{
+    float Key;
+    uint32_t Cluster;
+} ClusterSortEntry;
+
+static int CompareClusters(const void* a, const void* b)
+{
+    const ClusterSortEntry* lhs = a;
+    const ClusterSortEntry* rhs = b;
+    if (lhs->Key != rhs->Key)
+        return lhs->Key > rhs->Key ? -1 : 1;
+    return lhs->Cluster < rhs->Cluster ? -1 : (lhs->Cluster > rhs->Cluster);
+}
+
+static void GetTriangleCentroidAndNormal(const uint32_t* tri, const float* positions, size_t positionStride,
+                                         float centroid[3], float normal[3])
+{
+    const float* p0 = (const float*)((const uint8_t*)positions + positionStride * tri[0]);
+    const float* p1 = (const float*)((const uint8_t*)positions + positionStride * tri[1]);
+    const float* p2 = (const float*)((const uint8_t*)positions + positionStride * tri[2]);
+
+    float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+    // Unnormalized, so the length carries twice the triangle area
+    normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+    for (int c = 0; c < 3; ++c)
+        centroid[c] = (p0[c] + p1[c] + p2[c]) / 3.0f;
+}
+
+void OptimizeOverdraw(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                      const float* positions, size_t positionStride, size_t vertexCount, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    uint32_t* clusterStarts = malloc((triangleCount + 1) * sizeof(uint32_t));
+    uint32_t* timestamps = calloc(vertexCount, sizeof(uint32_t));
+    uint32_t* coldTimestamps = calloc(vertexCount, sizeof(uint32_t));
+    ClusterSortEntry* entries = malloc(triangleCount * sizeof(ClusterSortEntry));
+
+    if (!clusterStarts || !timestamps || !coldTimestamps || !entries || triangleCount == 0)
+    {
+        memcpy(dst, indices, indexCount * sizeof(uint32_t));
+        goto cleanup;
+    }
+
+    const uint32_t cacheSize = MESH_OPTIMIZER_FIFO_SIZE;
+    float meshAcmr = ComputeACMR(indices, indexCount, vertexCount, cacheSize);
+
+    // Hard boundaries are triangles missing on every vertex, the cache is effectively
+    // flushed there and reordering costs nothing. Within a hard cluster, soft boundaries
+    // are placed once the cold-cache ACMR of the segment drops below the threshold.
+    uint32_t clusterCount = 0;
+    uint32_t timestamp = cacheSize + 1;
+    uint32_t coldTimestamp = cacheSize + 1;
+    size_t segmentStart = 0;
+    size_t segmentMisses = 0;
+    bool softBoundary = false;
+
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        size_t misses = SimulateFifo(&indices[t * 3], 3, timestamps, &timestamp, cacheSize);
+
+        if (t == 0 || misses == 3 || softBoundary)
+        {
+            clusterStarts[clusterCount++] = (uint32_t)t;
+            segmentStart = t;
+            segmentMisses = 0;
+            softBoundary = false;
+            // Skipping the timestamps ahead empties the cold cache
+            coldTimestamp += cacheSize + 1;
+        }
+
+        segmentMisses += SimulateFifo(&indices[t * 3], 3, coldTimestamps, &coldTimestamp, cacheSize);
+        size_t segmentLength = t - segmentStart + 1;
+        softBoundary = segmentLength >= 4 && (float)segmentMisses / (float)segmentLength <= meshAcmr * threshold;
+    }
+    clusterStarts[clusterCount] = (uint32_t)triangleCount;
+
+    // Area weighted mesh centroid
+    float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        float centroid[3], normal[3];
+        GetTriangleCentroidAndNormal(&indices[t * 3], positions, positionStride, centroid, normal);
+        float area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        for (int c = 0; c < 3; ++c)
+            meshCentroid[c] += centroid[c] * area;
+        meshArea += area;
+    }
+    for (int c = 0; c < 3; ++c)
+        meshCentroid[c] = meshArea > 0.0f ? meshCentroid[c] / meshArea : 0.0f;
+
+    // Clusters facing away from the mesh center are likely to occlude the rest, draw them first
+    for (uint32_t i = 0; i < clusterCount; ++i)
+    {
+        float clusterCentroid[3] = { 0.0f, 0.0f, 0.0f };
+        float clusterNormal[3] = { 0.0f, 0.0f, 0.0f };
+        float clusterArea = 0.0f;
+
+        for (uint32_t t = clusterStarts[i]; t < clusterStarts[i + 1]; ++t)
+        {
+            float centroid[3], normal[3];
+            GetTriangleCentroidAndNormal(&indices[t * 3], positions, positionStride, centroid, normal);
+            float area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (int c = 0; c < 3; ++c)
+            {
+                clusterCentroid[c] += centroid[c] * area;
+                clusterNormal[c] += normal[c];
+            }
+            clusterArea += area;
+        }
+
+        float normalLength = sqrtf(clusterNormal[0] * clusterNormal[0] +
+                                   clusterNormal[1] * clusterNormal[1] +
+                                   clusterNormal[2] * clusterNormal[2]);
+        float key = 0.0f;
+        if (clusterArea > 0.0f && normalLength > 0.0f)
+        {
+            for (int c = 0; c < 3; ++c)
+                key += (clusterCentroid[c] / clusterArea - meshCentroid[c]) * clusterNormal[c] / normalLength;
+        }
+
+        entries[i].Key = key;
+        entries[i].Cluster = i;
+    }
+
+    qsort(entries, clusterCount, sizeof(ClusterSortEntry), CompareClusters);
+
+    size_t out = 0;
+    for (uint32_t i = 0; i < clusterCount; ++i)
+    {
+        uint32_t cluster = entries[i].Cluster;
+        size_t count = (size_t)(clusterStarts[cluster + 1] - clusterStarts[cluster]) * 3;
+        memcpy(&dst[out], &indices[(size_t)clusterStarts[cluster] * 3], count * sizeof(uint32_t));
+        out += count;
+    }
+
+cleanup:
+    free(clusterStarts);
+    free(timestamps);
+    free(coldTimestamps);
+    free(entries);
+}
+
+size_t OptimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    memset(remap, 0xFF, vertexCount * sizeof(uint32_t));
+
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t v = indices[i];
+        if (remap[v] == INVALID_INDEX)
+            remap[v] = next++;
+    }
+
+    return next;
+}
+
+void RemapIndexBuffer(uint32_t* indices, size_t indexCount, const uint32_t* remap)
+{
+    for (size_t i = 0; i < indexCount; ++i)
+        indices[i] = remap[indices[i]];
+}
+
+void RemapVertexBuffer(void* dst, const void* vertices, size_t vertexCount, size_t vertexSize, const uint32_t* remap)
+{
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        if (remap[i] != INVALID_INDEX)
+        {
+            memcpy((uint8_t*)dst + remap[i] * vertexSize, (const uint8_t*)vertices + i * vertexSize, vertexSize);
+        }
+    }
+}
+
+uint32_t SelectIndexSize(size_t vertexCount)
+{
+    // 0xFFFF is reserved as the strip cut value
+    return vertexCount < 0xFFFF ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void PackIndices(void* dst, const uint32_t* indices, size_t indexCount, uint32_t indexSize)
+{
+    if (indexSize == sizeof(uint32_t))
+    {
+        memcpy(dst, indices, indexCount * sizeof(uint32_t));
+        return;
+    }
+
+    uint16_t* dst16 = dst;
+    for (size_t i = 0; i < indexCount; ++i)
+        dst16[i] = (uint16_t)indices[i];
+}
+
+bool OptimizeMesh(uint32_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize,
+                  size_t positionOffset, MeshOptimizationStats* stats)
+{
+    uint32_t* scratch = malloc(indexCount * sizeof(uint32_t));
+    uint32_t* remap = malloc(vertexCount * sizeof(uint32_t));
+    void* remappedVertices = malloc(vertexCount * vertexSize);
+    if (!scratch || !remap || !remappedVertices)
+    {
+        free(scratch);
+        free(remap);
+        free(remappedVertices);
+        return false;
+    }
+
+    stats->AcmrBefore = ComputeACMR(indices, indexCount, vertexCount, MESH_OPTIMIZER_FIFO_SIZE);
+    stats->AtvrBefore = ComputeATVR(indices, indexCount, vertexCount, MESH_OPTIMIZER_FIFO_SIZE);
+
+    OptimizeVertexCache(scratch, indices, indexCount, vertexCount);
+    OptimizeOverdraw(indices, scratch, indexCount, (const float*)((const uint8_t*)vertices + positionOffset),
+                     vertexSize, vertexCount, 1.05f);
+
+    size_t uniqueVertexCount = OptimizeVertexFetchRemap(remap, indices, indexCount, vertexCount);
+    RemapIndexBuffer(indices, indexCount, remap);
+    RemapVertexBuffer(remappedVertices, vertices, vertexCount, vertexSize, remap);
+    memcpy(vertices, remappedVertices, uniqueVertexCount * vertexSize);
+
+    stats->AcmrAfter = ComputeACMR(indices, indexCount, uniqueVertexCount, MESH_OPTIMIZER_FIFO_SIZE);
+    stats->AtvrAfter = ComputeATVR(indices, indexCount, uniqueVertexCount, MESH_OPTIMIZER_FIFO_SIZE);
+    stats->UniqueVertexCount = uniqueVertexCount;
+    stats->IndexSize = SelectIndexSize(uniqueVertexCount);
+
+    free(scratch);
+    free(remap);
+    free(remappedVertices);
+    return true;
+}
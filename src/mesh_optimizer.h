@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Cache size used for the ACMR reports, matches a typical post-transform FIFO
+#define MESH_OPTIMIZER_FIFO_SIZE 16
+
+typedef struct MeshOptimizationStats
+{
+    // Average cache miss ratio (transformed vertices per triangle) and
+    // average transform to vertex ratio, before and after optimization
+    float AcmrBefore;
+    float AcmrAfter;
+    float AtvrBefore;
+    float AtvrAfter;
+    size_t UniqueVertexCount;
+    uint32_t IndexSize;
+} MeshOptimizationStats;
+
+// Triangle list optimization. All index buffers hold indexCount indices, dst must not alias indices.
+
+// Reorders triangles for the post-transform vertex cache (T. Forsyth, "Linear-Speed Vertex Cache Optimisation")
+void OptimizeVertexCache(uint32_t* dst, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Splits a cache-optimized list into clusters and sorts them front-to-back from the outside in
+// (P. Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+// threshold bounds the ACMR cost of the extra cluster boundaries, 1.05 allows 5%.
+void OptimizeOverdraw(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                      const float* positions, size_t positionStride, size_t vertexCount, float threshold);
+
+// Fills remap[vertexCount] so vertices are stored in first-use order, unused vertices get ~0u.
+// Returns the number of referenced vertices.
+size_t OptimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+void RemapIndexBuffer(uint32_t* indices, size_t indexCount, const uint32_t* remap);
+void RemapVertexBuffer(void* dst, const void* vertices, size_t vertexCount, size_t vertexSize, const uint32_t* remap);
+
+float ComputeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize);
+float ComputeATVR(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize);
+
+// 2 when every index fits DXGI_FORMAT_R16_UINT, 4 otherwise
+uint32_t SelectIndexSize(size_t vertexCount);
+void PackIndices(void* dst, const uint32_t* indices, size_t indexCount, uint32_t indexSize);
+
+// Runs cache, overdraw and fetch optimization in place. vertices are remapped in place as well,
+// positions point into them. Returns false on allocation failure.
+bool OptimizeMesh(uint32_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize,
+                  size_t positionOffset, MeshOptimizationStats* stats);
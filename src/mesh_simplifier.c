@@ -0,0 +1,454 @@
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Boundary edges get a perpendicular plane with this weight so open borders don't shrink
+#define BOUNDARY_WEIGHT 10.0
+// A collapse may turn the triangles around it by up to about 75 degrees
+#define MIN_NORMAL_COSINE 0.25
+// Below this view depth the error projection is clamped
+#define MIN_VIEW_DEPTH 1e-3f
+
+// Symmetric 4x4 error quadric, error(p) = p^T A p + 2 b.p + c
+typedef struct Quadric
+{
+    double A00, A01, A02, A11, A12, A22;
+    double B0, B1, B2;
+    double C;
+} Quadric;
+
+typedef struct Collapse
+{
+    float Cost;
+    uint32_t From;
+    uint32_t To;
+} Collapse;
+
+static const float* GetPosition(const float* positions, size_t stride, uint32_t index)
+{
+    return (const float*)((const uint8_t*)positions + stride * index);
+}
+
+static void Quadric_AddPlane(Quadric* q, const double n[3], double d, double weight)
+{
+    q->A00 += weight * n[0] * n[0];
+    q->A01 += weight * n[0] * n[1];
+    q->A02 += weight * n[0] * n[2];
+    q->A11 += weight * n[1] * n[1];
+    q->A12 += weight * n[1] * n[2];
+    q->A22 += weight * n[2] * n[2];
+    q->B0 += weight * d * n[0];
+    q->B1 += weight * d * n[1];
+    q->B2 += weight * d * n[2];
+    q->C += weight * d * d;
+}
+
+static void Quadric_Add(Quadric* q, const Quadric* other)
+{
+    q->A00 += other->A00; q->A01 += other->A01; q->A02 += other->A02;
+    q->A11 += other->A11; q->A12 += other->A12; q->A22 += other->A22;
+    q->B0 += other->B0; q->B1 += other->B1; q->B2 += other->B2;
+    q->C += other->C;
+}
+
+static double Quadric_Evaluate(const Quadric* q, const float p[3])
+{
+    double x = p[0], y = p[1], z = p[2];
+    double error = q->A00 * x * x + q->A11 * y * y + q->A22 * z * z +
+                   2.0 * (q->A01 * x * y + q->A02 * x * z + q->A12 * y * z) +
+                   2.0 * (q->B0 * x + q->B1 * y + q->B2 * z) + q->C;
+    return error > 0.0 ? error : 0.0;
+}
+
+static void Cross(const double a[3], const double b[3], double out[3])
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static double Normalize(double v[3])
+{
+    double length = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0.0)
+    {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+    return length;
+}
+
+static void GetTriangleNormal(const float* p0, const float* p1, const float* p2, double normal[3])
+{
+    double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    Cross(e1, e2, normal);
+}
+
+static uint64_t MakeEdgeKey(uint32_t a, uint32_t b)
+{
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+static int CompareEdgeKeys(const void* a, const void* b)
+{
+    uint64_t lhs = *(const uint64_t*)a;
+    uint64_t rhs = *(const uint64_t*)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static int CompareCollapses(const void* a, const void* b)
+{
+    const Collapse* lhs = a;
+    const Collapse* rhs = b;
+    if (lhs->Cost != rhs->Cost)
+        return lhs->Cost < rhs->Cost ? -1 : 1;
+    return lhs->From < rhs->From ? -1 : (lhs->From > rhs->From);
+}
+
+// Moving from onto to must not flip any of the remaining triangles around from
+static bool IsCollapseValid(uint32_t from, uint32_t to, const uint32_t* indices,
+                            const uint32_t* adjacencyOffsets, const uint32_t* adjacency,
+                            const float* positions, size_t stride)
+{
+    const float* target = GetPosition(positions, stride, to);
+
+    for (uint32_t i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; ++i)
+    {
+        const uint32_t* tri = &indices[adjacency[i] * 3];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+            continue;
+
+        const float* p[3];
+        const float* moved[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            p[k] = GetPosition(positions, stride, tri[k]);
+            moved[k] = tri[k] == from ? target : p[k];
+        }
+
+        // Turning a triangle on its edge is as bad as flipping it, it leaves a sliver standing
+        // on a border
+        double before[3], after[3];
+        GetTriangleNormal(p[0], p[1], p[2], before);
+        GetTriangleNormal(moved[0], moved[1], moved[2], after);
+        Normalize(before);
+        if (Normalize(after) == 0.0 ||
+            before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= MIN_NORMAL_COSINE)
+            return false;
+    }
+
+    return true;
+}
+
+size_t SimplifyMesh(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                    const float* positions, size_t positionStride, size_t vertexCount,
+                    size_t targetIndexCount, float maxError, float* resultError)
+{
+    memcpy(dst, indices, indexCount * sizeof(uint32_t));
+    *resultError = 0.0f;
+
+    Quadric* quadrics = calloc(vertexCount, sizeof(Quadric));
+    bool* boundary = calloc(vertexCount, sizeof(bool));
+    bool* locked = malloc(vertexCount * sizeof(bool));
+    uint32_t* collapseTarget = malloc(vertexCount * sizeof(uint32_t));
+    uint32_t* adjacencyOffsets = malloc((vertexCount + 1) * sizeof(uint32_t));
+    uint32_t* adjacency = malloc(indexCount * sizeof(uint32_t));
+    uint64_t* edges = malloc(indexCount * sizeof(uint64_t));
+    Collapse* collapses = malloc(indexCount * sizeof(Collapse));
+
+    if (!quadrics || !boundary || !locked || !collapseTarget || !adjacencyOffsets ||
+        !adjacency || !edges || !collapses)
+    {
+        goto cleanup;
+    }
+
+    // Face quadrics
+    for (size_t t = 0; t < indexCount / 3; ++t)
+    {
+        const uint32_t* tri = &dst[t * 3];
+        const float* p0 = GetPosition(positions, positionStride, tri[0]);
+        double normal[3];
+        GetTriangleNormal(p0, GetPosition(positions, positionStride, tri[1]),
+                          GetPosition(positions, positionStride, tri[2]), normal);
+        if (Normalize(normal) == 0.0)
+            continue;
+
+        double d = -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]);
+        for (int k = 0; k < 3; ++k)
+            Quadric_AddPlane(&quadrics[tri[k]], normal, d, 1.0);
+    }
+
+    // Boundary edges are the ones used by a single triangle
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        size_t t = i / 3;
+        edges[i] = MakeEdgeKey(dst[i], dst[t * 3 + (i + 1) % 3]);
+    }
+    qsort(edges, indexCount, sizeof(uint64_t), CompareEdgeKeys);
+
+    for (size_t t = 0; t < indexCount / 3; ++t)
+    {
+        const uint32_t* tri = &dst[t * 3];
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t a = tri[k];
+            uint32_t b = tri[(k + 1) % 3];
+            uint64_t key = MakeEdgeKey(a, b);
+            const uint64_t* found = bsearch(&key, edges, indexCount, sizeof(uint64_t), CompareEdgeKeys);
+            bool shared = (found > edges && found[-1] == key) ||
+                          (found + 1 < edges + indexCount && found[1] == key);
+            if (shared)
+                continue;
+
+            boundary[a] = boundary[b] = true;
+
+            const float* pa = GetPosition(positions, positionStride, a);
+            const float* pb = GetPosition(positions, positionStride, b);
+            double edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+            double faceNormal[3], planeNormal[3];
+            GetTriangleNormal(pa, pb, GetPosition(positions, positionStride, tri[(k + 2) % 3]), faceNormal);
+            Cross(edge, faceNormal, planeNormal);
+            if (Normalize(planeNormal) == 0.0)
+                continue;
+
+            double d = -(planeNormal[0] * pa[0] + planeNormal[1] * pa[1] + planeNormal[2] * pa[2]);
+            Quadric_AddPlane(&quadrics[a], planeNormal, d, BOUNDARY_WEIGHT);
+            Quadric_AddPlane(&quadrics[b], planeNormal, d, BOUNDARY_WEIGHT);
+        }
+    }
+
+    const double maxCost = (double)maxError * (double)maxError;
+    double reachedCost = 0.0;
+
+    // Each pass collapses a set of independent edges in cost order
+    while (indexCount > targetIndexCount)
+    {
+        // Vertex -> triangle adjacency of the current mesh
+        memset(adjacencyOffsets, 0, (vertexCount + 1) * sizeof(uint32_t));
+        for (size_t i = 0; i < indexCount; ++i)
+            adjacencyOffsets[dst[i] + 1]++;
+        for (size_t v = 0; v < vertexCount; ++v)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            uint32_t v = dst[i];
+            adjacency[adjacencyOffsets[v]++] = (uint32_t)(i / 3);
+        }
+        for (size_t v = vertexCount; v > 0; --v)
+            adjacencyOffsets[v] = adjacencyOffsets[v - 1];
+        adjacencyOffsets[0] = 0;
+
+        // Unique edges of the current mesh
+        for (size_t i = 0; i < indexCount; ++i)
+            edges[i] = MakeEdgeKey(dst[i], dst[(i / 3) * 3 + (i + 1) % 3]);
+        qsort(edges, indexCount, sizeof(uint64_t), CompareEdgeKeys);
+
+        size_t collapseCount = 0;
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            if (i > 0 && edges[i] == edges[i - 1])
+                continue;
+
+            uint32_t a = (uint32_t)(edges[i] >> 32);
+            uint32_t b = (uint32_t)edges[i];
+            bool edgeOnBoundary = i + 1 >= indexCount || edges[i + 1] != edges[i];
+
+            Quadric q = quadrics[a];
+            Quadric_Add(&q, &quadrics[b]);
+
+            // Boundary vertices may only slide along the boundary
+            Collapse best = { FLT_MAX, a, b };
+            if (!boundary[a] || (boundary[b] && edgeOnBoundary))
+                best.Cost = (float)Quadric_Evaluate(&q, GetPosition(positions, positionStride, b));
+            if (!boundary[b] || (boundary[a] && edgeOnBoundary))
+            {
+                float cost = (float)Quadric_Evaluate(&q, GetPosition(positions, positionStride, a));
+                if (cost < best.Cost)
+                {
+                    best.Cost = cost;
+                    best.From = b;
+                    best.To = a;
+                }
+            }
+
+            if (best.Cost <= maxCost)
+                collapses[collapseCount++] = best;
+        }
+
+        if (collapseCount == 0)
+            break;
+
+        qsort(collapses, collapseCount, sizeof(Collapse), CompareCollapses);
+
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            collapseTarget[v] = (uint32_t)v;
+            locked[v] = false;
+        }
+
+        size_t remainingIndexCount = indexCount;
+        size_t applied = 0;
+        for (size_t i = 0; i < collapseCount && remainingIndexCount > targetIndexCount; ++i)
+        {
+            const Collapse* collapse = &collapses[i];
+            if (locked[collapse->From] || locked[collapse->To])
+                continue;
+
+            if (!IsCollapseValid(collapse->From, collapse->To, dst, adjacencyOffsets, adjacency,
+                                 positions, positionStride))
+                continue;
+
+            collapseTarget[collapse->From] = collapse->To;
+            Quadric_Add(&quadrics[collapse->To], &quadrics[collapse->From]);
+            reachedCost = reachedCost > collapse->Cost ? reachedCost : collapse->Cost;
+            applied++;
+
+            // Lock the one-ring so later flip tests in this pass see up to date triangles
+            for (uint32_t j = adjacencyOffsets[collapse->From]; j < adjacencyOffsets[collapse->From + 1]; ++j)
+            {
+                const uint32_t* tri = &dst[adjacency[j] * 3];
+                locked[tri[0]] = locked[tri[1]] = locked[tri[2]] = true;
+                if (tri[0] == collapse->To || tri[1] == collapse->To || tri[2] == collapse->To)
+                    remainingIndexCount -= 3;
+            }
+        }
+
+        if (applied == 0)
+            break;
+
+        // Apply the collapses and drop the triangles that became degenerate
+        size_t writeIndex = 0;
+        for (size_t t = 0; t < indexCount / 3; ++t)
+        {
+            uint32_t a = collapseTarget[dst[t * 3 + 0]];
+            uint32_t b = collapseTarget[dst[t * 3 + 1]];
+            uint32_t c = collapseTarget[dst[t * 3 + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+
+            dst[writeIndex++] = a;
+            dst[writeIndex++] = b;
+            dst[writeIndex++] = c;
+        }
+        indexCount = writeIndex;
+    }
+
+    *resultError = (float)sqrt(reachedCost);
+
+cleanup:
+    free(quadrics);
+    free(boundary);
+    free(locked);
+    free(collapseTarget);
+    free(adjacencyOffsets);
+    free(adjacency);
+    free(edges);
+    free(collapses);
+    return indexCount;
+}
+
+bool BuildLodChain(const uint32_t* indices, size_t indexCount,
+                   const float* positions, size_t positionStride, size_t vertexCount,
+                   uint32_t maxLevels, float reduction, float maxError, LodChain* chain)
+{
+    memset(chain, 0, sizeof(*chain));
+    maxLevels = maxLevels < LOD_MAX_LEVELS ? maxLevels : LOD_MAX_LEVELS;
+
+    // Bounding sphere around the box center
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const float* p = GetPosition(positions, positionStride, indices[i]);
+        for (int c = 0; c < 3; ++c)
+        {
+            minimum[c] = fminf(minimum[c], p[c]);
+            maximum[c] = fmaxf(maximum[c], p[c]);
+        }
+    }
+    for (int c = 0; c < 3; ++c)
+        chain->Center[c] = indexCount ? 0.5f * (minimum[c] + maximum[c]) : 0.0f;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const float* p = GetPosition(positions, positionStride, indices[i]);
+        float dx = p[0] - chain->Center[0];
+        float dy = p[1] - chain->Center[1];
+        float dz = p[2] - chain->Center[2];
+        chain->Radius = fmaxf(chain->Radius, sqrtf(dx * dx + dy * dy + dz * dz));
+    }
+
+    // Every level is at most as large as the source, so this bounds the whole chain
+    uint32_t* levelIndices = malloc(indexCount * sizeof(uint32_t) * maxLevels);
+    uint32_t* scratch = malloc(indexCount * sizeof(uint32_t));
+    if (levelIndices == NULL || scratch == NULL)
+    {
+        free(levelIndices);
+        free(scratch);
+        return false;
+    }
+
+    memcpy(levelIndices, indices, indexCount * sizeof(uint32_t));
+    chain->Levels[0] = (LodLevel){ 0, (uint32_t)indexCount, 0.0f };
+    chain->LevelCount = maxLevels > 0 ? 1 : 0;
+    size_t totalIndexCount = indexCount;
+
+    while (chain->LevelCount < maxLevels)
+    {
+        const LodLevel* previous = &chain->Levels[chain->LevelCount - 1];
+        size_t target = (size_t)(previous->IndexCount / 3 * reduction) * 3;
+        float error;
+
+        // Simplify from the source mesh so errors don't accumulate across levels
+        size_t count = SimplifyMesh(scratch, indices, indexCount, positions, positionStride, vertexCount,
+                                    target, maxError * chain->Radius, &error);
+
+        // Stop once simplification stalls
+        if (count == 0 || count >= previous->IndexCount ||
+            count > previous->IndexCount - previous->IndexCount / 20)
+            break;
+
+        OptimizeVertexCache(&levelIndices[totalIndexCount], scratch, count, vertexCount);
+        chain->Levels[chain->LevelCount++] = (LodLevel){ (uint32_t)totalIndexCount, (uint32_t)count, error };
+        totalIndexCount += count;
+    }
+
+    free(scratch);
+    chain->Indices = levelIndices;
+    chain->IndexCount = totalIndexCount;
+    return true;
+}
+
+void LodChain_Release(LodChain* chain)
+{
+    free(chain->Indices);
+    chain->Indices = NULL;
+    chain->IndexCount = 0;
+}
+
+uint32_t SelectLod(const LodChain* chain, float viewDepth, float worldScale,
+                   float projectionScale, float pixelThreshold)
+{
+    float depth = fmaxf(viewDepth - chain->Radius * worldScale, MIN_VIEW_DEPTH);
+    float pixelsPerUnit = projectionScale * worldScale / depth;
+
+    uint32_t selected = 0;
+    for (uint32_t i = 1; i < chain->LevelCount; ++i)
+    {
+        if (chain->Levels[i].Error * pixelsPerUnit > pixelThreshold)
+            break;
+        selected = i;
+    }
+
+    return selected;
+}
+
+float GetProjectedSize(const LodChain* chain, float viewDepth, float worldScale, float projectionScale)
+{
+    return 2.0f * chain->Radius * worldScale * projectionScale / fmaxf(viewDepth, MIN_VIEW_DEPTH);
+}
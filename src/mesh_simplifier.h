@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOD_MAX_LEVELS 8
+
+typedef struct LodLevel
+{
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    // Object space geometric error bound of the level relative to the source mesh
+    float Error;
+} LodLevel;
+
+// All levels share one vertex buffer and are stored back to back in Indices,
+// level 0 being the source mesh.
+typedef struct LodChain
+{
+    LodLevel Levels[LOD_MAX_LEVELS];
+    uint32_t LevelCount;
+    uint32_t* Indices;
+    size_t IndexCount;
+    // Object space bounding sphere
+    float Center[3];
+    float Radius;
+} LodChain;
+
+// Edge-collapse simplification driven by quadric error metrics (M. Garland, P. Heckbert,
+// "Surface Simplification Using Quadric Error Metrics"). Vertices are collapsed onto
+// existing vertices so the vertex buffer stays shared between levels. Stops at
+// targetIndexCount or when the next collapse would exceed maxError.
+// Returns the resulting index count, the reached error is written to resultError.
+size_t SimplifyMesh(uint32_t* dst, const uint32_t* indices, size_t indexCount,
+                    const float* positions, size_t positionStride, size_t vertexCount,
+                    size_t targetIndexCount, float maxError, float* resultError);
+
+// Builds up to maxLevels levels, each one aiming for reduction times the triangles of the
+// previous one. maxError is relative to the bounding sphere radius.
+bool BuildLodChain(const uint32_t* indices, size_t indexCount,
+                   const float* positions, size_t positionStride, size_t vertexCount,
+                   uint32_t maxLevels, float reduction, float maxError, LodChain* chain);
+void LodChain_Release(LodChain* chain);
+
+// Picks the coarsest level whose error projects to less than pixelThreshold pixels.
+// viewDepth is the view space depth of the bounding sphere center, worldScale the largest
+// scale of the model matrix and projectionScale is projection[1][1] * viewport height / 2.
+uint32_t SelectLod(const LodChain* chain, float viewDepth, float worldScale,
+                   float projectionScale, float pixelThreshold);
+
+// Projected bounding sphere diameter in pixels, used for reporting
+float GetProjectedSize(const LodChain* chain, float viewDepth, float worldScale, float projectionScale);
@@ -0,0 +1,495 @@
+#include "mip_generator.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+// Half width of the Kaiser window in destination texels, and its shape
+#define KAISER_RADIUS 3.0
+#define KAISER_ALPHA 4.0
+#define PI 3.14159265358979323846
+// Taps a destination texel reads at most, a 3:1 reduction with the Kaiser window needs 18
+#define MAX_TAPS 64
+// Rows of a level are split into at most this many tasks, each with its own row of scratch
+#define MIP_MAX_CHUNKS 64
+#define MIP_ALIGNMENT 32
+
+// Taps of every destination texel along one axis. The source indices are clamped to the
+// edge, so the kernels need no bounds checks.
+typedef struct FilterAxis
+{
+    uint32_t TapCount;
+    uint32_t* Indices;
+    float* Weights;
+} FilterAxis;
+
+typedef struct MipTaskData
+{
+    const uint8_t* Rgba;
+    size_t RowPitch;
+    const float* Source;
+    uint32_t SourceWidth;
+    float* Destination;
+    uint32_t DestinationWidth;
+    uint32_t DestinationHeight;
+    const FilterAxis* Horizontal;
+    const FilterAxis* Vertical;
+    MipLevel* Level;
+    bool Srgb;
+    bool Scalar;
+    size_t ChunkSize;
+    // A row of vertically filtered texels per chunk
+    float* Scratch;
+} MipTaskData;
+
+// Values below it encode to sRGB 0, the first threshold is about 2^-13
+#define SRGB_MIN_EXPONENT -16
+#define SRGB_MIN_VALUE 1.52587890625e-5f
+// Largest float below 1
+#define SRGB_MAX_VALUE 0.99999994f
+#define SRGB_BUCKET_BITS 8
+#define SRGB_BUCKET_COUNT (-SRGB_MIN_EXPONENT << SRGB_BUCKET_BITS)
+
+static float g_SrgbToLinear[256];
+static float g_UnormToFloat[256];
+// Linear value halfway between each sRGB code and the next, encoding rounds to nearest with
+// it. The last one is never reached.
+static float g_SrgbThresholds[256];
+// Code of the start of each bucket of linear values, by exponent and the top mantissa bits.
+// A bucket spans less than a code, so the code is either that one or the next.
+static uint8_t g_SrgbBucketCodes[SRGB_BUCKET_COUNT];
+static once_flag g_SrgbTablesOnce = ONCE_FLAG_INIT;
+
+static double SrgbToLinear(double value)
+{
+    return value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+}
+
+static uint32_t GetFloatBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float GetBitsFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint32_t GetSrgbBucket(float value)
+{
+    return (GetFloatBits(value) >> (23 - SRGB_BUCKET_BITS)) - ((uint32_t)(127 + SRGB_MIN_EXPONENT) << SRGB_BUCKET_BITS);
+}
+
+static void BuildSrgbTables(void)
+{
+    for (int i = 0; i < 256; ++i)
+    {
+        g_SrgbToLinear[i] = (float)SrgbToLinear(i / 255.0);
+        g_UnormToFloat[i] = i / 255.0f;
+    }
+    for (int i = 0; i < 255; ++i)
+        g_SrgbThresholds[i] = (float)SrgbToLinear((i + 0.5) / 255.0);
+    g_SrgbThresholds[255] = 2.0f;
+
+    uint32_t code = 0;
+    for (uint32_t bucket = 0; bucket < SRGB_BUCKET_COUNT; ++bucket)
+    {
+        float start = GetBitsFloat((bucket + ((uint32_t)(127 + SRGB_MIN_EXPONENT) << SRGB_BUCKET_BITS)) << (23 - SRGB_BUCKET_BITS));
+        while (start >= g_SrgbThresholds[code])
+            code++;
+        g_SrgbBucketCodes[bucket] = (uint8_t)code;
+    }
+}
+
+static uint8_t EncodeUnorm(float value)
+{
+    return value <= 0.0f ? 0 : (value >= 1.0f ? 255 : (uint8_t)(value * 255.0f + 0.5f));
+}
+
+static uint8_t EncodeSrgb(float value)
+{
+    // Clamped into the buckets, just below 1 still encodes to 255
+    value = value < SRGB_MAX_VALUE ? value : SRGB_MAX_VALUE;
+    value = value > SRGB_MIN_VALUE ? value : SRGB_MIN_VALUE;
+    uint32_t code = g_SrgbBucketCodes[GetSrgbBucket(value)];
+    return (uint8_t)(code + (value >= g_SrgbThresholds[code]));
+}
+
+static double BesselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32 && term > sum * 1e-12; ++k)
+    {
+        term *= (x * 0.5 / k) * (x * 0.5 / k);
+        sum += term;
+    }
+    return sum;
+}
+
+// Weight of a source texel distance texels from the center, scale source texels per
+// destination texel
+static double GetFilterWeight(MipFilter filter, double distance, double scale)
+{
+    if (filter == MIP_FILTER_BOX)
+    {
+        // Coverage of the source texel by the destination one
+        double radius = scale * 0.5;
+        double overlap = fmin(distance + 0.5, radius) - fmax(distance - 0.5, -radius);
+        return overlap > 0.0 ? overlap : 0.0;
+    }
+
+    double x = fabs(distance / scale);
+    if (x >= KAISER_RADIUS)
+        return 0.0;
+    double sinc = x > 1e-9 ? sin(PI * x) / (PI * x) : 1.0;
+    double window = x / KAISER_RADIUS;
+    return sinc * BesselI0(KAISER_ALPHA * sqrt(1.0 - window * window)) / BesselI0(KAISER_ALPHA);
+}
+
+static bool FilterAxis_Create(FilterAxis* axis, MipFilter filter, uint32_t sourceSize, uint32_t destinationSize)
+{
+    double scale = (double)sourceSize / destinationSize;
+    // Distance from the center within which a source texel can have weight
+    double support = filter == MIP_FILTER_BOX ? scale * 0.5 + 0.5 : KAISER_RADIUS * scale;
+
+    axis->TapCount = 0;
+    for (uint32_t x = 0; x < destinationSize; ++x)
+    {
+        double center = (x + 0.5) * scale - 0.5;
+        int64_t first = (int64_t)floor(center - support) + 1;
+        int64_t last = (int64_t)ceil(center + support) - 1;
+        if (last - first + 1 > (int64_t)axis->TapCount)
+            axis->TapCount = (uint32_t)(last - first + 1);
+    }
+
+    if (axis->TapCount > MAX_TAPS)
+        return false;
+
+    axis->Indices = malloc((size_t)destinationSize * axis->TapCount * sizeof(uint32_t));
+    axis->Weights = malloc((size_t)destinationSize * axis->TapCount * sizeof(float));
+    if (axis->Indices == NULL || axis->Weights == NULL)
+        return false;
+
+    for (uint32_t x = 0; x < destinationSize; ++x)
+    {
+        double center = (x + 0.5) * scale - 0.5;
+        int64_t first = (int64_t)floor(center - support) + 1;
+        uint32_t* indices = axis->Indices + (size_t)x * axis->TapCount;
+        float* weights = axis->Weights + (size_t)x * axis->TapCount;
+
+        double weightSum = 0.0;
+        double unnormalized[MAX_TAPS];
+        for (uint32_t t = 0; t < axis->TapCount; ++t)
+        {
+            int64_t index = first + t;
+            unnormalized[t] = GetFilterWeight(filter, (double)index - center, scale);
+            weightSum += unnormalized[t];
+            indices[t] = (uint32_t)(index < 0 ? 0 : (index >= sourceSize ? sourceSize - 1 : index));
+        }
+        for (uint32_t t = 0; t < axis->TapCount; ++t)
+            weights[t] = (float)(unnormalized[t] / weightSum);
+    }
+    return true;
+}
+
+static void FilterAxis_Release(FilterAxis* axis)
+{
+    free(axis->Indices);
+    free(axis->Weights);
+}
+
+// Sums whole source rows, count floats of each
+static void FilterVerticalScalar(const float* source, size_t sourceStride, const uint32_t* indices,
+                                 const float* weights, uint32_t tapCount, size_t begin, size_t count, float* row)
+{
+    for (size_t i = begin; i < count; ++i)
+    {
+        float sum = 0.0f;
+        for (uint32_t t = 0; t < tapCount; ++t)
+            sum += weights[t] * source[indices[t] * sourceStride + i];
+        row[i] = sum;
+    }
+}
+
+static void FilterVertical(const float* source, size_t sourceStride, const uint32_t* indices,
+                           const float* weights, uint32_t tapCount, size_t count, float* row)
+{
+    size_t i = 0;
+#if HD_AVX2
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        for (uint32_t t = 0; t < tapCount; ++t)
+            sum = _mm256_fmadd_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(source + indices[t] * sourceStride + i), sum);
+        _mm256_storeu_ps(row + i, sum);
+    }
+#endif
+#if HD_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 sum = _mm_setzero_ps();
+        for (uint32_t t = 0; t < tapCount; ++t)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(source + indices[t] * sourceStride + i)));
+        _mm_storeu_ps(row + i, sum);
+    }
+#endif
+    FilterVerticalScalar(source, sourceStride, indices, weights, tapCount, i, count, row);
+}
+
+// Filters the texels of a row into width destination texels
+static void FilterHorizontalScalar(const float* row, const FilterAxis* axis, uint32_t begin, uint32_t width,
+                                   float* destination)
+{
+    for (uint32_t x = begin; x < width; ++x)
+    {
+        const uint32_t* indices = axis->Indices + (size_t)x * axis->TapCount;
+        const float* weights = axis->Weights + (size_t)x * axis->TapCount;
+        for (int c = 0; c < 4; ++c)
+        {
+            float sum = 0.0f;
+            for (uint32_t t = 0; t < axis->TapCount; ++t)
+                sum += weights[t] * row[indices[t] * 4 + c];
+            destination[x * 4 + c] = sum;
+        }
+    }
+}
+
+static void FilterHorizontal(const float* row, const FilterAxis* axis, uint32_t width, float* destination)
+{
+    uint32_t x = 0;
+    uint32_t tapCount = axis->TapCount;
+#if HD_AVX2
+    // Two destination texels per register, each half with its own taps
+    for (; x + 2 <= width; x += 2)
+    {
+        const uint32_t* indices = axis->Indices + (size_t)x * tapCount;
+        const float* weights = axis->Weights + (size_t)x * tapCount;
+        __m256 sum = _mm256_setzero_ps();
+        for (uint32_t t = 0; t < tapCount; ++t)
+        {
+            __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(row + indices[t] * 4)),
+                                                 _mm_loadu_ps(row + indices[tapCount + t] * 4), 1);
+            __m256 weight = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weights[t])),
+                                                 _mm_set1_ps(weights[tapCount + t]), 1);
+            sum = _mm256_fmadd_ps(weight, texels, sum);
+        }
+        _mm256_storeu_ps(destination + x * 4, sum);
+    }
+#elif HD_SSE2
+    for (; x < width; ++x)
+    {
+        const uint32_t* indices = axis->Indices + (size_t)x * tapCount;
+        const float* weights = axis->Weights + (size_t)x * tapCount;
+        __m128 sum = _mm_setzero_ps();
+        for (uint32_t t = 0; t < tapCount; ++t)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(row + indices[t] * 4)));
+        _mm_storeu_ps(destination + x * 4, sum);
+    }
+#endif
+    FilterHorizontalScalar(row, axis, x, width, destination);
+}
+
+static void EncodeRow(const float* texels, uint32_t width, bool srgb, uint8_t* rgba)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        for (int c = 0; c < 3; ++c)
+            rgba[x * 4 + c] = srgb ? EncodeSrgb(texels[x * 4 + c]) : EncodeUnorm(texels[x * 4 + c]);
+        rgba[x * 4 + 3] = EncodeUnorm(texels[x * 4 + 3]);
+    }
+}
+
+static void DecodeRows(const MipTaskData* data, size_t begin, size_t end)
+{
+    uint32_t width = data->DestinationWidth;
+    for (size_t y = begin; y < end; ++y)
+    {
+        const uint8_t* source = data->Rgba + y * data->RowPitch;
+        uint8_t* copy = data->Level->Rgba + y * data->Level->RowPitch;
+        float* texels = data->Destination + y * width * 4;
+        const float* colorTable = data->Srgb ? g_SrgbToLinear : g_UnormToFloat;
+        memcpy(copy, source, (size_t)width * 4);
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            for (int c = 0; c < 3; ++c)
+                texels[x * 4 + c] = colorTable[source[x * 4 + c]];
+            texels[x * 4 + 3] = g_UnormToFloat[source[x * 4 + 3]];
+        }
+    }
+}
+
+static void FilterRows(const MipTaskData* data, size_t begin, size_t end, float* row)
+{
+    const FilterAxis* vertical = data->Vertical;
+    size_t sourceStride = (size_t)data->SourceWidth * 4;
+    for (size_t y = begin; y < end; ++y)
+    {
+        const uint32_t* indices = vertical->Indices + y * vertical->TapCount;
+        const float* weights = vertical->Weights + y * vertical->TapCount;
+        float* destination = data->Destination + y * data->DestinationWidth * 4;
+        if (data->Scalar)
+        {
+            FilterVerticalScalar(data->Source, sourceStride, indices, weights, vertical->TapCount, 0, sourceStride, row);
+            FilterHorizontalScalar(row, data->Horizontal, 0, data->DestinationWidth, destination);
+        }
+        else
+        {
+            FilterVertical(data->Source, sourceStride, indices, weights, vertical->TapCount, sourceStride, row);
+            FilterHorizontal(row, data->Horizontal, data->DestinationWidth, destination);
+        }
+        EncodeRow(destination, data->DestinationWidth, data->Srgb, data->Level->Rgba + y * data->Level->RowPitch);
+    }
+}
+
+static void DecodeTask(void* userData, size_t begin, size_t end)
+{
+    MipTaskData* data = userData;
+    size_t first = begin * data->ChunkSize;
+    size_t last = end * data->ChunkSize < data->DestinationHeight ? end * data->ChunkSize : data->DestinationHeight;
+    DecodeRows(data, first, last);
+}
+
+static void FilterTask(void* userData, size_t begin, size_t end)
+{
+    MipTaskData* data = userData;
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+        size_t first = chunk * data->ChunkSize;
+        size_t last = first + data->ChunkSize < data->DestinationHeight ? first + data->ChunkSize : data->DestinationHeight;
+        FilterRows(data, first, last, data->Scratch + chunk * data->SourceWidth * 4);
+    }
+}
+
+// Splits the rows of a level into chunks, returns the chunk count
+static size_t SetChunks(MipTaskData* data, uint32_t height)
+{
+    data->DestinationHeight = height;
+    data->ChunkSize = data->Scalar ? height : (height + MIP_MAX_CHUNKS - 1) / MIP_MAX_CHUNKS;
+    return (height + data->ChunkSize - 1) / data->ChunkSize;
+}
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t count = 1;
+    while ((width > 1 || height > 1) && count < MIP_MAX_LEVELS)
+    {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        count++;
+    }
+    return count;
+}
+
+static bool Generate(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, bool srgb,
+                     MipFilter filter, uint32_t levelCount, bool scalar, MipChain* chain)
+{
+    memset(chain, 0, sizeof(*chain));
+    if (width == 0 || height == 0)
+        return false;
+
+    call_once(&g_SrgbTablesOnce, BuildSrgbTables);
+
+    uint32_t maxLevelCount = GetMipLevelCount(width, height);
+    chain->LevelCount = levelCount == 0 || levelCount > maxLevelCount ? maxLevelCount : levelCount;
+
+    size_t dataSize = 0;
+    for (uint32_t i = 0; i < chain->LevelCount; ++i)
+    {
+        MipLevel* level = &chain->Levels[i];
+        level->Width = width >> i > 0 ? width >> i : 1;
+        level->Height = height >> i > 0 ? height >> i : 1;
+        level->RowPitch = (size_t)level->Width * 4;
+        dataSize += level->RowPitch * level->Height;
+    }
+
+    // Linear texels of a level and the next, the second is reused for every other level
+    size_t firstSize = (size_t)width * height * 4 * sizeof(float);
+    size_t secondSize = chain->LevelCount > 1 ?
+        (size_t)chain->Levels[1].Width * chain->Levels[1].Height * 4 * sizeof(float) : sizeof(float);
+    size_t scratchSize = (size_t)(scalar ? 1 : MIP_MAX_CHUNKS) * width * 4 * sizeof(float);
+    chain->Data = malloc(dataSize);
+    float* buffers[2] = { AlignedAlloc(firstSize, MIP_ALIGNMENT), AlignedAlloc(secondSize, MIP_ALIGNMENT) };
+    float* scratch = AlignedAlloc(scratchSize, MIP_ALIGNMENT);
+    bool generated = chain->Data != NULL && buffers[0] != NULL && buffers[1] != NULL && scratch != NULL;
+
+    MipTaskData data = {
+        .Rgba = rgba,
+        .RowPitch = rowPitch,
+        .Srgb = srgb,
+        .Scalar = scalar,
+        .Scratch = scratch
+    };
+
+    if (generated)
+    {
+        uint8_t* levelData = chain->Data;
+        for (uint32_t i = 0; i < chain->LevelCount; ++i)
+        {
+            chain->Levels[i].Rgba = levelData;
+            levelData += chain->Levels[i].RowPitch * chain->Levels[i].Height;
+        }
+
+        data.Destination = buffers[0];
+        data.DestinationWidth = width;
+        data.Level = &chain->Levels[0];
+        size_t chunkCount = SetChunks(&data, height);
+        ParallelFor(chunkCount, 1, DecodeTask, &data);
+    }
+
+    for (uint32_t i = 1; generated && i < chain->LevelCount; ++i)
+    {
+        MipLevel* source = &chain->Levels[i - 1];
+        MipLevel* level = &chain->Levels[i];
+        FilterAxis horizontal = { 0 };
+        FilterAxis vertical = { 0 };
+        generated = FilterAxis_Create(&horizontal, filter, source->Width, level->Width) &&
+                    FilterAxis_Create(&vertical, filter, source->Height, level->Height);
+        if (generated)
+        {
+            data.Source = buffers[(i - 1) % 2];
+            data.SourceWidth = source->Width;
+            data.Destination = buffers[i % 2];
+            data.DestinationWidth = level->Width;
+            data.Horizontal = &horizontal;
+            data.Vertical = &vertical;
+            data.Level = level;
+            size_t chunkCount = SetChunks(&data, level->Height);
+            ParallelFor(chunkCount, 1, FilterTask, &data);
+        }
+        FilterAxis_Release(&horizontal);
+        FilterAxis_Release(&vertical);
+    }
+
+    AlignedFree(scratch);
+    AlignedFree(buffers[0]);
+    AlignedFree(buffers[1]);
+    if (!generated)
+        MipChain_Release(chain);
+    return generated;
+}
+
+bool GenerateMips(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, bool srgb,
+                  MipFilter filter, uint32_t levelCount, MipChain* chain)
+{
+    return Generate(rgba, width, height, rowPitch, srgb, filter, levelCount, false, chain);
+}
+
+bool GenerateMipsScalar(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, bool srgb,
+                        MipFilter filter, uint32_t levelCount, MipChain* chain)
+{
+    return Generate(rgba, width, height, rowPitch, srgb, filter, levelCount, true, chain);
+}
+
+void MipChain_Release(MipChain* chain)
+{
+    free(chain->Data);
+    memset(chain, 0, sizeof(*chain));
+}
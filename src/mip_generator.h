@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MIP_MAX_LEVELS 16
+
+typedef enum MipFilter
+{
+    // Average of the texels each one covers, exact for odd sizes as well
+    MIP_FILTER_BOX,
+    // Kaiser windowed sinc, sharper but rings a little around hard edges
+    MIP_FILTER_KAISER
+} MipFilter;
+
+typedef struct MipLevel
+{
+    uint8_t* Rgba;
+    uint32_t Width;
+    uint32_t Height;
+    size_t RowPitch;
+} MipLevel;
+
+// RGBA8 levels of an image, largest first. Each level halves the previous one rounding
+// down, like the mips of a D3D12 texture or a DDS file.
+typedef struct MipChain
+{
+    uint32_t LevelCount;
+    MipLevel Levels[MIP_MAX_LEVELS];
+    // The levels are carved from it
+    uint8_t* Data;
+} MipChain;
+
+// Levels of the full chain down to 1x1, capped at MIP_MAX_LEVELS
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+// Builds levelCount levels from an RGBA8 image, 0 for the full chain. The first level is a
+// copy of the image. Every level is filtered from the previous one in linear float, so sRGB
+// colors are decoded before filtering and encoded again after. Alpha is always linear. The
+// rows of a level are split across the workers and filtered 8 (AVX) or 4 (SSE) floats at a
+// time, vertically first and then horizontally.
+bool GenerateMips(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, bool srgb,
+                  MipFilter filter, uint32_t levelCount, MipChain* chain);
+// Single threaded scalar reference. The results differ by at most 1 from GenerateMips, as the
+// SIMD paths round the sums differently.
+bool GenerateMipsScalar(const uint8_t* rgba, uint32_t width, uint32_t height, size_t rowPitch, bool srgb,
+                        MipFilter filter, uint32_t levelCount, MipChain* chain);
+void MipChain_Release(MipChain* chain);
@@ -0,0 +1,260 @@
+#include "null_backend.h"
+
+#include <math.h>
+#include <string.h>
+
+// Of the unit cube, centred on its origin
+#define INSTANCE_RADIUS 1.7320508f
+
+// Of the app's cube
+#define INDEX_COUNT 36
+// Increment of the descriptors of the stand-in heaps
+#define DESCRIPTOR_SIZE 32
+// Values of the D3D12 enums the capture keeps as they are
+#define STATE_PRESENT 0
+#define STATE_RENDER_TARGET 4
+#define CLEAR_FLAG_DEPTH 1
+#define TOPOLOGY_TRIANGLE_LIST 4
+#define FORMAT_R16_UINT 57
+
+// Where the stand-ins would be, in the GPU virtual and the descriptor address spaces
+#define VERTEX_BUFFER_ADDRESS 0x100000
+#define INDEX_BUFFER_ADDRESS 0x200000
+#define BUFFER_SIZE 4096
+#define RTV_HEAP_ADDRESS 0x1000
+#define DSV_HEAP_ADDRESS 0x2000
+#define SRV_HEAP_ADDRESS 0x3000
+
+void NullMatrix_Multiply(const NullMatrix a, const NullMatrix b, NullMatrix result)
+{
+    NullMatrix product;
+    for (int column = 0; column < 4; ++column)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            product[column][row] = a[0][row] * b[column][0] + a[1][row] * b[column][1] +
+                                   a[2][row] * b[column][2] + a[3][row] * b[column][3];
+        }
+    }
+    memcpy(result, product, sizeof(product));
+}
+
+bool NullBackend_Create(NullBackend* backend, const char* capturePath)
+{
+    memset(backend, 0, sizeof(*backend));
+    if (!CommandStream_Create(&backend->Capture))
+        return false;
+    if (capturePath != NULL && !CommandStream_Open(&backend->Capture, capturePath))
+    {
+        CommandStream_Destroy(&backend->Capture);
+        return false;
+    }
+
+    // In the order the app creates them
+    NullObjects* objects = &backend->Objects;
+    CommandStream* capture = &backend->Capture;
+    CommandStream_AddObject(capture, &objects->Queue);
+    for (int i = 0; i < NULL_BACKEND_FRAME_COUNT; ++i)
+        CommandStream_AddObject(capture, &objects->BackBuffers[i]);
+    uint32_t rtvHeap = CommandStream_AddObject(capture, &objects->RtvHeap);
+    CommandStream_AddRange(capture, COMMAND_ADDRESS_CPU_DESCRIPTOR, rtvHeap, RTV_HEAP_ADDRESS,
+                           NULL_BACKEND_FRAME_COUNT * DESCRIPTOR_SIZE);
+    for (int i = 0; i < NULL_BACKEND_FRAME_COUNT; ++i)
+        CommandStream_AddObject(capture, &objects->Allocators[i]);
+    CommandStream_AddObject(capture, &objects->List);
+    uint32_t dsvHeap = CommandStream_AddObject(capture, &objects->DsvHeap);
+    CommandStream_AddRange(capture, COMMAND_ADDRESS_CPU_DESCRIPTOR, dsvHeap, DSV_HEAP_ADDRESS, DESCRIPTOR_SIZE);
+    uint32_t srvHeap = CommandStream_AddObject(capture, &objects->SrvHeap);
+    CommandStream_AddRange(capture, COMMAND_ADDRESS_GPU_DESCRIPTOR, srvHeap, SRV_HEAP_ADDRESS, DESCRIPTOR_SIZE);
+    CommandStream_AddObject(capture, &objects->RootSignature);
+    CommandStream_AddObject(capture, &objects->PipelineState);
+    uint32_t vertexBuffer = CommandStream_AddObject(capture, &objects->VertexBuffer);
+    CommandStream_AddRange(capture, COMMAND_ADDRESS_GPU_VIRTUAL, vertexBuffer, VERTEX_BUFFER_ADDRESS, BUFFER_SIZE);
+    uint32_t indexBuffer = CommandStream_AddObject(capture, &objects->IndexBuffer);
+    CommandStream_AddRange(capture, COMMAND_ADDRESS_GPU_VIRTUAL, indexBuffer, INDEX_BUFFER_ADDRESS, BUFFER_SIZE);
+    return true;
+}
+
+bool NullBackend_Destroy(NullBackend* backend)
+{
+    bool written = !CommandStream_IsCapturing(&backend->Capture) || CommandStream_Close(&backend->Capture);
+    CommandStream_Destroy(&backend->Capture);
+    return written;
+}
+
+static uint32_t GetId(NullBackend* backend, const void* object)
+{
+    return CommandStream_GetObject(&backend->Capture, object);
+}
+
+static void WriteListCommand(NullBackend* backend, const Command* command)
+{
+    CommandStream_SelectList(&backend->Capture, GetId(backend, &backend->Objects.List));
+    CommandStream_Write(&backend->Capture, command);
+}
+
+static void WriteTransition(NullBackend* backend, uint32_t backBuffer, uint32_t before, uint32_t after)
+{
+    Command command = { .Opcode = COMMAND_RESOURCE_BARRIER };
+    command.Barriers.Count = 1;
+    command.Barriers.Barriers[0].Resources[0] = GetId(backend, &backend->Objects.BackBuffers[backBuffer]);
+    // All subresources
+    command.Barriers.Barriers[0].Subresource = 0xffffffff;
+    command.Barriers.Barriers[0].States[0] = before;
+    command.Barriers.Barriers[0].States[1] = after;
+    WriteListCommand(backend, &command);
+}
+
+// What Render records before its draws, up to the state of the pipeline
+static void WriteFrameStart(NullBackend* backend, uint64_t frame)
+{
+    NullObjects* objects = &backend->Objects;
+    CommandStream* capture = &backend->Capture;
+    uint32_t backBuffer = (uint32_t)(frame % NULL_BACKEND_FRAME_COUNT);
+    Command command = { .Opcode = COMMAND_FRAME, .Frame = frame };
+    CommandStream_Write(capture, &command);
+    command = (Command){ .Opcode = COMMAND_RESET_ALLOCATOR, .Object = GetId(backend, &objects->Allocators[backBuffer]) };
+    CommandStream_Write(capture, &command);
+    command = (Command){ .Opcode = COMMAND_RESET };
+    command.Reset.Allocator = GetId(backend, &objects->Allocators[backBuffer]);
+    WriteListCommand(backend, &command);
+    WriteTransition(backend, backBuffer, STATE_PRESENT, STATE_RENDER_TARGET);
+
+    CommandAddress rtv = CommandStream_Resolve(capture, COMMAND_ADDRESS_CPU_DESCRIPTOR,
+                                               RTV_HEAP_ADDRESS + backBuffer * DESCRIPTOR_SIZE);
+    CommandAddress dsv = CommandStream_Resolve(capture, COMMAND_ADDRESS_CPU_DESCRIPTOR, DSV_HEAP_ADDRESS);
+    command = (Command){ .Opcode = COMMAND_CLEAR_RENDER_TARGET };
+    command.ClearRenderTarget.View = rtv;
+    // g_ClearColor
+    command.ClearRenderTarget.Color[0] = 0.635f;
+    command.ClearRenderTarget.Color[1] = 0.415f;
+    command.ClearRenderTarget.Color[2] = 0.905f;
+    command.ClearRenderTarget.Color[3] = 1.0f;
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_CLEAR_DEPTH_STENCIL };
+    command.ClearDepthStencil.View = dsv;
+    command.ClearDepthStencil.Flags = CLEAR_FLAG_DEPTH;
+    command.ClearDepthStencil.Depth = 1.0f;
+    WriteListCommand(backend, &command);
+
+    command = (Command){ .Opcode = COMMAND_SET_GRAPHICS_ROOT_SIGNATURE, .Object = GetId(backend, &objects->RootSignature) };
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_SET_DESCRIPTOR_HEAPS };
+    command.DescriptorHeaps.Count = 1;
+    command.DescriptorHeaps.Heaps[0] = GetId(backend, &objects->SrvHeap);
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_SET_GRAPHICS_ROOT_TABLE };
+    command.RootArgument.Parameter = 1;
+    command.RootArgument.Address = CommandStream_Resolve(capture, COMMAND_ADDRESS_GPU_DESCRIPTOR, SRV_HEAP_ADDRESS);
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_SET_VIEWPORTS };
+    command.Viewports.Count = 1;
+    command.Viewports.Viewports[0] = (CommandViewport){ 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_SET_SCISSOR_RECTS };
+    command.ScissorRects.Count = 1;
+    command.ScissorRects.Rects[0] = (CommandRect){ 0, 0, 1280, 720 };
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_SET_RENDER_TARGETS };
+    command.RenderTargets.Count = 1;
+    command.RenderTargets.Views[0] = rtv;
+    command.RenderTargets.HasDepthStencil = true;
+    command.RenderTargets.DepthStencil = dsv;
+    WriteListCommand(backend, &command);
+
+    command = (Command){ .Opcode = COMMAND_SET_PIPELINE_STATE, .Object = GetId(backend, &objects->PipelineState) };
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_SET_PRIMITIVE_TOPOLOGY, .PrimitiveTopology = TOPOLOGY_TRIANGLE_LIST };
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_SET_VERTEX_BUFFERS };
+    command.VertexBuffers.Count = 1;
+    command.VertexBuffers.Views[0].Location = CommandStream_Resolve(capture, COMMAND_ADDRESS_GPU_VIRTUAL,
+                                                                    VERTEX_BUFFER_ADDRESS);
+    command.VertexBuffers.Views[0].Size = BUFFER_SIZE;
+    command.VertexBuffers.Views[0].Stride = 6 * sizeof(float);
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_SET_INDEX_BUFFER };
+    command.IndexBuffer.Bound = true;
+    command.IndexBuffer.Location = CommandStream_Resolve(capture, COMMAND_ADDRESS_GPU_VIRTUAL, INDEX_BUFFER_ADDRESS);
+    command.IndexBuffer.Size = BUFFER_SIZE;
+    command.IndexBuffer.Format = FORMAT_R16_UINT;
+    WriteListCommand(backend, &command);
+}
+
+// The constants and the draw of a cube
+static void WriteDraw(NullBackend* backend, const NullMatrix viewProjection, const NullMatrix world)
+{
+    NullMatrix mvp;
+    NullMatrix_Multiply(viewProjection, world, mvp);
+    Command command = { .Opcode = COMMAND_SET_GRAPHICS_ROOT_CONSTANTS };
+    command.RootConstants.Count = sizeof(NullMatrix) / sizeof(uint32_t);
+    memcpy(command.RootConstants.Values, mvp, sizeof(mvp));
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_DRAW_INDEXED };
+    command.DrawIndexed.IndexCount = INDEX_COUNT;
+    command.DrawIndexed.InstanceCount = 1;
+    WriteListCommand(backend, &command);
+}
+
+static void WriteFrameEnd(NullBackend* backend, uint64_t frame)
+{
+    NullObjects* objects = &backend->Objects;
+    WriteTransition(backend, (uint32_t)(frame % NULL_BACKEND_FRAME_COUNT), STATE_RENDER_TARGET, STATE_PRESENT);
+    Command command = { .Opcode = COMMAND_CLOSE };
+    WriteListCommand(backend, &command);
+    command = (Command){ .Opcode = COMMAND_EXECUTE_LISTS };
+    command.ExecuteLists.Queue = GetId(backend, &objects->Queue);
+    command.ExecuteLists.Count = 1;
+    command.ExecuteLists.Lists[0] = GetId(backend, &objects->List);
+    CommandStream_Write(&backend->Capture, &command);
+    command = (Command){ .Opcode = COMMAND_PRESENT, .Present = { 1, 0 } };
+    CommandStream_Write(&backend->Capture, &command);
+}
+
+void NullBackend_SubmitFrame(NullBackend* backend, uint64_t frame, const NullMatrix viewProjection,
+                             const NullMatrix* worlds, uint32_t count)
+{
+    bool capturing = CommandStream_IsCapturing(&backend->Capture);
+    if (capturing)
+        WriteFrameStart(backend, frame);
+
+    float planes[6][4];
+    for (int i = 0; i < 4; ++i)
+    {
+        float rowX = viewProjection[i][0], rowY = viewProjection[i][1];
+        float rowZ = viewProjection[i][2], rowW = viewProjection[i][3];
+        planes[0][i] = rowW + rowX;
+        planes[1][i] = rowW - rowX;
+        planes[2][i] = rowW + rowY;
+        planes[3][i] = rowW - rowY;
+        planes[4][i] = rowZ;
+        planes[5][i] = rowW - rowZ;
+    }
+    for (int p = 0; p < 6; ++p)
+    {
+        float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        for (int i = 0; i < 4; ++i)
+            planes[p][i] /= length;
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float* center = worlds[i][3];
+        bool visible = true;
+        for (int p = 0; p < 6 && visible; ++p)
+        {
+            visible = planes[p][0] * center[0] + planes[p][1] * center[1] + planes[p][2] * center[2] +
+                      planes[p][3] >= -INSTANCE_RADIUS;
+        }
+        if (!visible)
+        {
+            backend->CulledInstances++;
+            continue;
+        }
+        backend->SubmittedDraws++;
+        if (capturing)
+            WriteDraw(backend, viewProjection, worlds[i]);
+    }
+    if (capturing)
+        WriteFrameEnd(backend, frame);
+}
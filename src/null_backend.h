@@ -0,0 +1,50 @@
+#pragma once
+
+#include "command_stream.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NULL_BACKEND_FRAME_COUNT 3
+
+// Column major like cglm, m[column][row]
+typedef float NullMatrix[4][4];
+
+// Stand-ins for the objects of the app, the capture only numbers their addresses
+typedef struct NullObjects
+{
+    uint8_t Queue;
+    uint8_t List;
+    uint8_t Allocators[NULL_BACKEND_FRAME_COUNT];
+    uint8_t BackBuffers[NULL_BACKEND_FRAME_COUNT];
+    uint8_t RtvHeap;
+    uint8_t DsvHeap;
+    uint8_t SrvHeap;
+    uint8_t RootSignature;
+    uint8_t PipelineState;
+    uint8_t VertexBuffer;
+    uint8_t IndexBuffer;
+} NullObjects;
+
+// Graphics backend without a GPU. It culls the instances of a frame against the frustum the way
+// the app does and counts the draws it would submit, and while capturing records the commands
+// the app's direct draws would into a command stream.
+typedef struct NullBackend
+{
+    uint64_t SubmittedDraws;
+    uint64_t CulledInstances;
+    CommandStream Capture;
+    NullObjects Objects;
+} NullBackend;
+
+// Captures the frames to the file when the path isn't NULL
+bool NullBackend_Create(NullBackend* backend, const char* capturePath);
+// False when the capture failed to be written
+bool NullBackend_Destroy(NullBackend* backend);
+
+// Tests the bounds of the instances against the planes of the view projection, x, y and z in
+// [0, w], and counts a draw for every instance in view
+void NullBackend_SubmitFrame(NullBackend* backend, uint64_t frame, const NullMatrix viewProjection,
+                             const NullMatrix* worlds, uint32_t count);
+
+void NullMatrix_Multiply(const NullMatrix a, const NullMatrix b, NullMatrix result);
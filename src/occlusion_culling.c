@@ -0,0 +1,645 @@
+#include "occlusion_culling.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#define DEPTH_ALIGNMENT 32
+#define FAR_DEPTH 1.0f
+// Rasterizer bands per thread, more than one evens out occluders clustered on the screen
+#define BANDS_PER_THREAD 4
+#define TEST_CHUNK_SIZE 1024
+#define TEST_MAX_CHUNKS 1024
+
+typedef struct RasterTaskData
+{
+    OcclusionBuffer* Buffer;
+    uint32_t BandHeight;
+} RasterTaskData;
+
+typedef struct TestTaskData
+{
+    const OcclusionBuffer* Buffer;
+    const float* ViewProjection;
+    const void* Bounds;
+    uint32_t* Visible;
+    size_t ChunkSize;
+    size_t Count;
+    size_t ChunkCounts[TEST_MAX_CHUNKS];
+} TestTaskData;
+
+// Edge functions and depth as planes over the screen, value = A * x + B * y + C.
+// The edge functions stay unscaled so a shared edge evaluates to exactly opposite values
+// in both triangles, and with inclusive tests no pixel center falls between them.
+typedef struct TriangleSetup
+{
+    float A[4];
+    float B[4];
+    float C[4];
+    int32_t MinX;
+    int32_t MaxX;
+    int32_t MinY;
+    int32_t MaxY;
+} TriangleSetup;
+
+static uint32_t RoundStride(uint32_t width)
+{
+    return (width + 7) & ~7u;
+}
+
+bool OcclusionBuffer_Create(OcclusionBuffer* buffer, uint32_t width, uint32_t height)
+{
+    memset(buffer, 0, sizeof(*buffer));
+    if (width == 0 || height == 0)
+        return false;
+
+    buffer->Width = width;
+    buffer->Height = height;
+
+    // Halve down to a single texel, odd sizes round up so every pixel stays covered
+    size_t total = 0;
+    uint32_t levelWidth = width;
+    uint32_t levelHeight = height;
+    while (buffer->LevelCount < OCCLUSION_MAX_LEVELS)
+    {
+        uint32_t level = buffer->LevelCount++;
+        buffer->LevelWidths[level] = levelWidth;
+        buffer->LevelHeights[level] = levelHeight;
+        buffer->LevelStrides[level] = RoundStride(levelWidth);
+        total += (size_t)buffer->LevelStrides[level] * levelHeight;
+
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+
+    float* block = AlignedAlloc(total * sizeof(float), DEPTH_ALIGNMENT);
+    if (block == NULL)
+        return false;
+
+    for (uint32_t level = 0; level < buffer->LevelCount; ++level)
+    {
+        buffer->Levels[level] = block;
+        block += (size_t)buffer->LevelStrides[level] * buffer->LevelHeights[level];
+    }
+
+    OcclusionBuffer_Clear(buffer);
+    return true;
+}
+
+void OcclusionBuffer_Destroy(OcclusionBuffer* buffer)
+{
+    AlignedFree(buffer->Levels[0]);
+    free(buffer->Triangles);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+void OcclusionBuffer_Clear(OcclusionBuffer* buffer)
+{
+    float* depth = buffer->Levels[0];
+    size_t count = (size_t)buffer->LevelStrides[0] * buffer->Height;
+    for (size_t i = 0; i < count; ++i)
+        depth[i] = FAR_DEPTH;
+
+    buffer->TriangleCount = 0;
+}
+
+bool OcclusionBuffer_AddOccluder(OcclusionBuffer* buffer, mat4 mvp, const OccluderMesh* mesh)
+{
+    size_t triangleCount = mesh->IndexCount / 3;
+    if (buffer->TriangleCount + triangleCount > buffer->TriangleCapacity)
+    {
+        size_t capacity = buffer->TriangleCapacity ? buffer->TriangleCapacity * 2 : 256;
+        while (capacity < buffer->TriangleCount + triangleCount)
+            capacity *= 2;
+
+        OccluderTriangle* triangles = realloc(buffer->Triangles, capacity * sizeof(OccluderTriangle));
+        if (triangles == NULL)
+            return false;
+        buffer->Triangles = triangles;
+        buffer->TriangleCapacity = capacity;
+    }
+
+    float halfWidth = buffer->Width * 0.5f;
+    float halfHeight = buffer->Height * 0.5f;
+    const uint8_t* positions = (const uint8_t*)mesh->Positions;
+
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        OccluderTriangle* triangle = &buffer->Triangles[buffer->TriangleCount];
+        bool clipped = false;
+
+        for (int v = 0; v < 3; ++v)
+        {
+            const float* position = (const float*)(positions + mesh->Indices[t * 3 + v] * mesh->Stride);
+            vec4 clip;
+            glm_mat4_mulv(mvp, (vec4){ position[0], position[1], position[2], 1.0f }, clip);
+
+            if (clip[3] <= 0.0f || clip[2] < -clip[3])
+            {
+                clipped = true;
+                break;
+            }
+
+            // Pixel coordinates with y pointing down like the viewport
+            float inverseW = 1.0f / clip[3];
+            triangle->X[v] = (clip[0] * inverseW + 1.0f) * halfWidth;
+            triangle->Y[v] = (1.0f - clip[1] * inverseW) * halfHeight;
+            triangle->Z[v] = clip[2] * inverseW;
+        }
+
+        if (clipped)
+            continue;
+
+        // Clockwise on the screen is a positive area with y down
+        float area = (triangle->X[1] - triangle->X[0]) * (triangle->Y[2] - triangle->Y[0]) -
+                     (triangle->X[2] - triangle->X[0]) * (triangle->Y[1] - triangle->Y[0]);
+        if (area > 0.0f)
+            buffer->TriangleCount++;
+    }
+
+    return true;
+}
+
+// Returns false when the triangle covers no pixel center of the rows [minY, maxY]
+static bool SetupTriangle(const OccluderTriangle* triangle, int32_t width, int32_t minY, int32_t maxY,
+                          TriangleSetup* setup)
+{
+    const float* x = triangle->X;
+    const float* y = triangle->Y;
+
+    // Pixel i is covered when its center i + 0.5 is inside
+    float left = fminf(x[0], fminf(x[1], x[2]));
+    float right = fmaxf(x[0], fmaxf(x[1], x[2]));
+    float top = fminf(y[0], fminf(y[1], y[2]));
+    float bottom = fmaxf(y[0], fmaxf(y[1], y[2]));
+    if (right < 0.5f || bottom < minY + 0.5f || left > width - 0.5f || top > maxY + 0.5f)
+        return false;
+
+    setup->MinX = left > 0.5f ? (int32_t)ceilf(left - 0.5f) : 0;
+    setup->MaxX = right < width - 0.5f ? (int32_t)floorf(right - 0.5f) : width - 1;
+    setup->MinY = top > minY + 0.5f ? (int32_t)ceilf(top - 0.5f) : minY;
+    setup->MaxY = bottom < maxY + 0.5f ? (int32_t)floorf(bottom - 0.5f) : maxY;
+    if (setup->MinX > setup->MaxX || setup->MinY > setup->MaxY)
+        return false;
+
+    // The edge function opposite a vertex is its barycentric weight times the area
+    for (int v = 0; v < 3; ++v)
+    {
+        int a = (v + 1) % 3;
+        int b = (v + 2) % 3;
+        setup->A[v] = y[a] - y[b];
+        setup->B[v] = x[b] - x[a];
+        // x[a] * y[b] - x[b] * y[a] rearranged so that swapping a and b negates the result
+        // exactly, even when the compiler fuses the multiply and subtract
+        setup->C[v] = ((x[a] + x[b]) * (y[b] - y[a]) - (x[b] - x[a]) * (y[a] + y[b])) * 0.5f;
+    }
+
+    // Screen space depth is linear, combine the weights into one plane
+    const float* z = triangle->Z;
+    float inverseArea = 1.0f / ((x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]));
+    setup->A[3] = (z[0] * setup->A[0] + z[1] * setup->A[1] + z[2] * setup->A[2]) * inverseArea;
+    setup->B[3] = (z[0] * setup->B[0] + z[1] * setup->B[1] + z[2] * setup->B[2]) * inverseArea;
+    setup->C[3] = (z[0] * setup->C[0] + z[1] * setup->C[1] + z[2] * setup->C[2]) * inverseArea;
+    return true;
+}
+
+static void RasterizeTriangleScalar(float* depth, uint32_t stride, const TriangleSetup* setup)
+{
+    for (int32_t py = setup->MinY; py <= setup->MaxY; ++py)
+    {
+        float* row = depth + (size_t)py * stride;
+        float y = py + 0.5f;
+        float rows[4];
+        for (int i = 0; i < 4; ++i)
+            rows[i] = setup->B[i] * y + setup->C[i];
+
+        for (int32_t px = setup->MinX; px <= setup->MaxX; ++px)
+        {
+            float x = px + 0.5f;
+            float w0 = setup->A[0] * x + rows[0];
+            float w1 = setup->A[1] * x + rows[1];
+            float w2 = setup->A[2] * x + rows[2];
+            float z = setup->A[3] * x + rows[3];
+            if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f && z < row[px])
+                row[px] = z;
+        }
+    }
+}
+
+// Lanes outside the bounding box but inside the triangle still belong to it, and the padded
+// stride keeps lanes past the last column inside the row, so whole vectors are written.
+static void RasterizeTriangle(float* depth, uint32_t stride, const TriangleSetup* setup)
+{
+#if defined(HD_AVX2)
+    __m256 a[4];
+    for (int i = 0; i < 4; ++i)
+        a[i] = _mm256_set1_ps(setup->A[i]);
+    const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    int32_t startX = setup->MinX & ~7;
+
+    for (int32_t py = setup->MinY; py <= setup->MaxY; ++py)
+    {
+        float* row = depth + (size_t)py * stride;
+        float y = py + 0.5f;
+        __m256 rows[4];
+        for (int i = 0; i < 4; ++i)
+            rows[i] = _mm256_set1_ps(setup->B[i] * y + setup->C[i]);
+
+        for (int32_t px = startX; px <= setup->MaxX; px += 8)
+        {
+            __m256 x = _mm256_add_ps(_mm256_set1_ps((float)px), laneOffsets);
+            __m256 w0 = _mm256_add_ps(_mm256_mul_ps(a[0], x), rows[0]);
+            __m256 w1 = _mm256_add_ps(_mm256_mul_ps(a[1], x), rows[1]);
+            __m256 w2 = _mm256_add_ps(_mm256_mul_ps(a[2], x), rows[2]);
+            __m256 z = _mm256_add_ps(_mm256_mul_ps(a[3], x), rows[3]);
+
+            __m256 inside = _mm256_and_ps(_mm256_cmp_ps(w0, zero, _CMP_GE_OQ),
+                            _mm256_and_ps(_mm256_cmp_ps(w1, zero, _CMP_GE_OQ),
+                                          _mm256_cmp_ps(w2, zero, _CMP_GE_OQ)));
+            if (_mm256_movemask_ps(inside) == 0)
+                continue;
+
+            __m256 current = _mm256_load_ps(row + px);
+            _mm256_store_ps(row + px, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+        }
+    }
+#elif defined(HD_SSE2)
+    __m128 a[4];
+    for (int i = 0; i < 4; ++i)
+        a[i] = _mm_set1_ps(setup->A[i]);
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    int32_t startX = setup->MinX & ~3;
+
+    for (int32_t py = setup->MinY; py <= setup->MaxY; ++py)
+    {
+        float* row = depth + (size_t)py * stride;
+        float y = py + 0.5f;
+        __m128 rows[4];
+        for (int i = 0; i < 4; ++i)
+            rows[i] = _mm_set1_ps(setup->B[i] * y + setup->C[i]);
+
+        for (int32_t px = startX; px <= setup->MaxX; px += 4)
+        {
+            __m128 x = _mm_add_ps(_mm_set1_ps((float)px), laneOffsets);
+            __m128 w0 = _mm_add_ps(_mm_mul_ps(a[0], x), rows[0]);
+            __m128 w1 = _mm_add_ps(_mm_mul_ps(a[1], x), rows[1]);
+            __m128 w2 = _mm_add_ps(_mm_mul_ps(a[2], x), rows[2]);
+            __m128 z = _mm_add_ps(_mm_mul_ps(a[3], x), rows[3]);
+
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_and_ps(_mm_cmpge_ps(w1, zero), _mm_cmpge_ps(w2, zero)));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+
+            // SSE2 has no blend, select with the mask
+            __m128 current = _mm_load_ps(row + px);
+            __m128 nearest = _mm_min_ps(current, z);
+            _mm_store_ps(row + px, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+        }
+    }
+#else
+    RasterizeTriangleScalar(depth, stride, setup);
+#endif
+}
+
+static void RasterizeBandTask(void* userData, size_t begin, size_t end)
+{
+    RasterTaskData* data = userData;
+    OcclusionBuffer* buffer = data->Buffer;
+
+    for (size_t band = begin; band < end; ++band)
+    {
+        int32_t minY = (int32_t)(band * data->BandHeight);
+        int32_t maxY = (int32_t)((band + 1) * data->BandHeight) - 1;
+        if (maxY >= (int32_t)buffer->Height)
+            maxY = (int32_t)buffer->Height - 1;
+
+        for (size_t t = 0; t < buffer->TriangleCount; ++t)
+        {
+            TriangleSetup setup;
+            if (SetupTriangle(&buffer->Triangles[t], (int32_t)buffer->Width, minY, maxY, &setup))
+                RasterizeTriangle(buffer->Levels[0], buffer->LevelStrides[0], &setup);
+        }
+    }
+}
+
+void OcclusionBuffer_Rasterize(OcclusionBuffer* buffer)
+{
+    if (buffer->TriangleCount == 0)
+        return;
+
+    uint32_t bandCount = Parallel_GetThreadCount() * BANDS_PER_THREAD;
+    bandCount = bandCount < buffer->Height ? bandCount : buffer->Height;
+
+    RasterTaskData data = { buffer, (buffer->Height + bandCount - 1) / bandCount };
+    bandCount = (buffer->Height + data.BandHeight - 1) / data.BandHeight;
+    ParallelFor(bandCount, 1, RasterizeBandTask, &data);
+}
+
+void OcclusionBuffer_RasterizeScalar(OcclusionBuffer* buffer)
+{
+    for (size_t t = 0; t < buffer->TriangleCount; ++t)
+    {
+        TriangleSetup setup;
+        if (SetupTriangle(&buffer->Triangles[t], (int32_t)buffer->Width, 0, (int32_t)buffer->Height - 1, &setup))
+            RasterizeTriangleScalar(buffer->Levels[0], buffer->LevelStrides[0], &setup);
+    }
+}
+
+void OcclusionBuffer_BuildHiZ(OcclusionBuffer* buffer)
+{
+    for (uint32_t level = 1; level < buffer->LevelCount; ++level)
+    {
+        const float* source = buffer->Levels[level - 1];
+        uint32_t sourceWidth = buffer->LevelWidths[level - 1];
+        uint32_t sourceHeight = buffer->LevelHeights[level - 1];
+        uint32_t sourceStride = buffer->LevelStrides[level - 1];
+        float* destination = buffer->Levels[level];
+
+        for (uint32_t y = 0; y < buffer->LevelHeights[level]; ++y)
+        {
+            // The last row and column repeat for odd sizes
+            const float* row0 = source + (size_t)(y * 2) * sourceStride;
+            const float* row1 = y * 2 + 1 < sourceHeight ? row0 + sourceStride : row0;
+            float* output = destination + (size_t)y * buffer->LevelStrides[level];
+
+            uint32_t x = 0;
+#if defined(HD_SSE2)
+            for (; x * 2 + 8 <= sourceWidth; x += 4)
+            {
+                __m128 low = _mm_max_ps(_mm_load_ps(row0 + x * 2), _mm_load_ps(row1 + x * 2));
+                __m128 high = _mm_max_ps(_mm_load_ps(row0 + x * 2 + 4), _mm_load_ps(row1 + x * 2 + 4));
+                __m128 even = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+                __m128 odd = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1));
+                _mm_store_ps(output + x, _mm_max_ps(even, odd));
+            }
+#endif
+            for (; x < buffer->LevelWidths[level]; ++x)
+            {
+                uint32_t x0 = x * 2;
+                uint32_t x1 = x0 + 1 < sourceWidth ? x0 + 1 : x0;
+                output[x] = fmaxf(fmaxf(row0[x0], row0[x1]), fmaxf(row1[x0], row1[x1]));
+            }
+        }
+    }
+}
+
+// Projects the box corners and fills the covered pixel rectangle and the nearest depth.
+// Returns false when the box crosses the near plane or misses the screen, such boxes stay visible.
+static bool ProjectAabb(const OcclusionBuffer* buffer, const float* viewProjection,
+                        float cx, float cy, float cz, float ex, float ey, float ez,
+                        int32_t rectangle[4], float* nearestDepth)
+{
+    const float* m = viewProjection;
+    float minX, minY, maxX, maxY, minZ;
+
+#if defined(HD_SSE2)
+    // Corners 0-3 and 4-7 side by side, lanes pick the x and y side of the box
+    const __m128 signX = _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+    const __m128 signY = _mm_setr_ps(-1.0f, -1.0f, 1.0f, 1.0f);
+    __m128 clip[2][4];
+    for (int r = 0; r < 4; ++r)
+    {
+        float center = m[r] * cx + m[4 + r] * cy + m[8 + r] * cz + m[12 + r];
+        __m128 side = _mm_add_ps(_mm_set1_ps(center),
+                      _mm_add_ps(_mm_mul_ps(signX, _mm_set1_ps(m[r] * ex)),
+                                 _mm_mul_ps(signY, _mm_set1_ps(m[4 + r] * ey))));
+        __m128 axisZ = _mm_set1_ps(m[8 + r] * ez);
+        clip[0][r] = _mm_sub_ps(side, axisZ);
+        clip[1][r] = _mm_add_ps(side, axisZ);
+    }
+
+    __m128 behind = _mm_or_ps(_mm_or_ps(_mm_cmple_ps(clip[0][3], _mm_setzero_ps()),
+                                        _mm_cmple_ps(clip[1][3], _mm_setzero_ps())),
+                              _mm_or_ps(_mm_cmplt_ps(_mm_add_ps(clip[0][2], clip[0][3]), _mm_setzero_ps()),
+                                        _mm_cmplt_ps(_mm_add_ps(clip[1][2], clip[1][3]), _mm_setzero_ps())));
+    if (_mm_movemask_ps(behind) != 0)
+        return false;
+
+    __m128 inverseW0 = _mm_div_ps(_mm_set1_ps(1.0f), clip[0][3]);
+    __m128 inverseW1 = _mm_div_ps(_mm_set1_ps(1.0f), clip[1][3]);
+    __m128 x0 = _mm_mul_ps(clip[0][0], inverseW0), x1 = _mm_mul_ps(clip[1][0], inverseW1);
+    __m128 y0 = _mm_mul_ps(clip[0][1], inverseW0), y1 = _mm_mul_ps(clip[1][1], inverseW1);
+    __m128 z0 = _mm_mul_ps(clip[0][2], inverseW0), z1 = _mm_mul_ps(clip[1][2], inverseW1);
+
+    // Reduce the eight corners to (min x, min y, -max x, -max y) and the nearest depth
+    __m128 low = _mm_min_ps(_mm_unpacklo_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)),
+                            _mm_unpackhi_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)));
+    __m128 high = _mm_max_ps(_mm_unpacklo_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)),
+                             _mm_unpackhi_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)));
+    low = _mm_min_ps(low, _mm_movehl_ps(low, low));
+    high = _mm_max_ps(high, _mm_movehl_ps(high, high));
+    __m128 bounds = _mm_movelh_ps(low, _mm_sub_ps(_mm_setzero_ps(), high));
+    __m128 depth = _mm_min_ps(z0, z1);
+    depth = _mm_min_ps(depth, _mm_movehl_ps(depth, depth));
+    depth = _mm_min_ss(depth, _mm_shuffle_ps(depth, depth, _MM_SHUFFLE(1, 1, 1, 1)));
+
+    HD_ALIGN(16) float reduced[4];
+    _mm_store_ps(reduced, bounds);
+    minX = reduced[0];
+    minY = reduced[1];
+    maxX = -reduced[2];
+    maxY = -reduced[3];
+    minZ = _mm_cvtss_f32(depth);
+#else
+    float center[4];
+    float axes[3][4];
+    for (int r = 0; r < 4; ++r)
+    {
+        center[r] = m[r] * cx + m[4 + r] * cy + m[8 + r] * cz + m[12 + r];
+        axes[0][r] = m[r] * ex;
+        axes[1][r] = m[4 + r] * ey;
+        axes[2][r] = m[8 + r] * ez;
+    }
+
+    minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        float clip[4];
+        for (int r = 0; r < 4; ++r)
+        {
+            clip[r] = center[r] + (corner & 1 ? axes[0][r] : -axes[0][r]) +
+                                  (corner & 2 ? axes[1][r] : -axes[1][r]) +
+                                  (corner & 4 ? axes[2][r] : -axes[2][r]);
+        }
+
+        if (clip[3] <= 0.0f || clip[2] < -clip[3])
+            return false;
+
+        float inverseW = 1.0f / clip[3];
+        minX = fminf(minX, clip[0] * inverseW);
+        maxX = fmaxf(maxX, clip[0] * inverseW);
+        minY = fminf(minY, clip[1] * inverseW);
+        maxY = fmaxf(maxY, clip[1] * inverseW);
+        minZ = fminf(minZ, clip[2] * inverseW);
+    }
+#endif
+
+    float left = (minX + 1.0f) * buffer->Width * 0.5f;
+    float right = (maxX + 1.0f) * buffer->Width * 0.5f;
+    float top = (1.0f - maxY) * buffer->Height * 0.5f;
+    float bottom = (1.0f - minY) * buffer->Height * 0.5f;
+    if (right < 0.0f || bottom < 0.0f || left >= buffer->Width || top >= buffer->Height)
+        return false;
+
+    // Every pixel the rectangle touches, not only the covered centers, to stay conservative
+    rectangle[0] = left > 0.0f ? (int32_t)left : 0;
+    rectangle[1] = top > 0.0f ? (int32_t)top : 0;
+    rectangle[2] = right < buffer->Width - 1 ? (int32_t)right : (int32_t)buffer->Width - 1;
+    rectangle[3] = bottom < buffer->Height - 1 ? (int32_t)bottom : (int32_t)buffer->Height - 1;
+    *nearestDepth = minZ;
+    return true;
+}
+
+static uint32_t FindLevel(uint32_t extent)
+{
+    uint32_t level = 0;
+    while (extent >> level)
+        level++;
+    return level;
+}
+
+static bool IsRectangleVisible(const OcclusionBuffer* buffer, uint32_t level, const int32_t rectangle[4],
+                               float nearestDepth)
+{
+    const float* depth = buffer->Levels[level];
+    uint32_t stride = buffer->LevelStrides[level];
+    for (int32_t y = rectangle[1] >> level; y <= rectangle[3] >> level; ++y)
+    {
+        for (int32_t x = rectangle[0] >> level; x <= rectangle[2] >> level; ++x)
+        {
+            if (nearestDepth <= depth[(size_t)y * stride + x])
+                return true;
+        }
+    }
+    return false;
+}
+
+static bool IsAabbVisible(const OcclusionBuffer* buffer, const float* viewProjection, bool hierarchical,
+                          float cx, float cy, float cz, float ex, float ey, float ez)
+{
+    int32_t rectangle[4];
+    float nearestDepth;
+    if (!ProjectAabb(buffer, viewProjection, cx, cy, cz, ex, ey, ez, rectangle, &nearestDepth))
+        return true;
+
+    uint32_t level = 0;
+    if (hierarchical)
+    {
+        // The rectangle spans at most two texels per axis on this level
+        int32_t extent = rectangle[2] - rectangle[0] > rectangle[3] - rectangle[1] ?
+            rectangle[2] - rectangle[0] : rectangle[3] - rectangle[1];
+        level = FindLevel((uint32_t)extent);
+        level = level < buffer->LevelCount ? level : buffer->LevelCount - 1;
+    }
+
+    return IsRectangleVisible(buffer, level, rectangle, nearestDepth);
+}
+
+// Filters visible[0, count) in place, the output never overtakes the input
+static size_t TestSpheresRange(const OcclusionBuffer* buffer, const float* viewProjection, bool hierarchical,
+                               const SphereBounds* bounds, uint32_t* visible, size_t count)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t index = visible[i];
+        float radius = bounds->Radius[index];
+        if (IsAabbVisible(buffer, viewProjection, hierarchical,
+                          bounds->X[index], bounds->Y[index], bounds->Z[index], radius, radius, radius))
+            visible[n++] = index;
+    }
+    return n;
+}
+
+static size_t TestAabbsRange(const OcclusionBuffer* buffer, const float* viewProjection, bool hierarchical,
+                             const AabbBounds* bounds, uint32_t* visible, size_t count)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t index = visible[i];
+        if (IsAabbVisible(buffer, viewProjection, hierarchical,
+                          bounds->CenterX[index], bounds->CenterY[index], bounds->CenterZ[index],
+                          bounds->ExtentX[index], bounds->ExtentY[index], bounds->ExtentZ[index]))
+            visible[n++] = index;
+    }
+    return n;
+}
+
+static void TestSpheresTask(void* userData, size_t begin, size_t end)
+{
+    TestTaskData* data = userData;
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+        size_t first = chunk * data->ChunkSize;
+        size_t last = first + data->ChunkSize < data->Count ? first + data->ChunkSize : data->Count;
+        data->ChunkCounts[chunk] = TestSpheresRange(data->Buffer, data->ViewProjection, true, data->Bounds,
+                                                    data->Visible + first, last - first);
+    }
+}
+
+static void TestAabbsTask(void* userData, size_t begin, size_t end)
+{
+    TestTaskData* data = userData;
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+        size_t first = chunk * data->ChunkSize;
+        size_t last = first + data->ChunkSize < data->Count ? first + data->ChunkSize : data->Count;
+        data->ChunkCounts[chunk] = TestAabbsRange(data->Buffer, data->ViewProjection, true, data->Bounds,
+                                                  data->Visible + first, last - first);
+    }
+}
+
+static size_t TestParallel(TestTaskData* data, ParallelForTask task)
+{
+    size_t chunkSize = (data->Count + TEST_MAX_CHUNKS - 1) / TEST_MAX_CHUNKS;
+    data->ChunkSize = chunkSize > TEST_CHUNK_SIZE ? chunkSize : TEST_CHUNK_SIZE;
+    size_t chunkCount = (data->Count + data->ChunkSize - 1) / data->ChunkSize;
+
+    ParallelFor(chunkCount, 1, task, data);
+
+    size_t visibleCount = 0;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        uint32_t* source = data->Visible + chunk * data->ChunkSize;
+        if (source != data->Visible + visibleCount)
+            memmove(data->Visible + visibleCount, source, data->ChunkCounts[chunk] * sizeof(uint32_t));
+        visibleCount += data->ChunkCounts[chunk];
+    }
+
+    return visibleCount;
+}
+
+size_t OcclusionCullSpheres(const OcclusionBuffer* buffer, mat4 viewProjection, const SphereBounds* bounds,
+                            uint32_t* visible, size_t visibleCount)
+{
+    TestTaskData data = { .Buffer = buffer, .ViewProjection = viewProjection[0], .Bounds = bounds,
+                          .Visible = visible, .Count = visibleCount };
+    return TestParallel(&data, TestSpheresTask);
+}
+
+size_t OcclusionCullAabbs(const OcclusionBuffer* buffer, mat4 viewProjection, const AabbBounds* bounds,
+                          uint32_t* visible, size_t visibleCount)
+{
+    TestTaskData data = { .Buffer = buffer, .ViewProjection = viewProjection[0], .Bounds = bounds,
+                          .Visible = visible, .Count = visibleCount };
+    return TestParallel(&data, TestAabbsTask);
+}
+
+size_t OcclusionCullSpheresScalar(const OcclusionBuffer* buffer, mat4 viewProjection, const SphereBounds* bounds,
+                                  uint32_t* visible, size_t visibleCount)
+{
+    return TestSpheresRange(buffer, viewProjection[0], false, bounds, visible, visibleCount);
+}
+
+size_t OcclusionCullAabbsScalar(const OcclusionBuffer* buffer, mat4 viewProjection, const AabbBounds* bounds,
+                                uint32_t* visible, size_t visibleCount)
+{
+    return TestAabbsRange(buffer, viewProjection[0], false, bounds, visible, visibleCount);
+}
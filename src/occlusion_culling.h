@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+#include "frustum_culling.h"
+
+#define OCCLUSION_MAX_LEVELS 16
+
+// Triangle list rasterized into the occlusion buffer, positions are float3
+typedef struct OccluderMesh
+{
+    const float* Positions;
+    size_t Stride;
+    size_t VertexCount;
+    const uint32_t* Indices;
+    size_t IndexCount;
+} OccluderMesh;
+
+// Screen space triangle, x and y in pixels and z as NDC depth
+typedef struct OccluderTriangle
+{
+    float X[3];
+    float Y[3];
+    float Z[3];
+} OccluderTriangle;
+
+// Low resolution depth buffer with its hierarchical-Z pyramid. Level 0 keeps the nearest
+// occluder depth per pixel, each level above the farthest depth of 2x2 texels below it.
+typedef struct OcclusionBuffer
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t LevelCount;
+    uint32_t LevelWidths[OCCLUSION_MAX_LEVELS];
+    uint32_t LevelHeights[OCCLUSION_MAX_LEVELS];
+    // Rows are padded to 8 floats so the SIMD loops never need a tail
+    uint32_t LevelStrides[OCCLUSION_MAX_LEVELS];
+    float* Levels[OCCLUSION_MAX_LEVELS];
+
+    // Occluder triangles added since the last clear
+    OccluderTriangle* Triangles;
+    size_t TriangleCount;
+    size_t TriangleCapacity;
+} OcclusionBuffer;
+
+bool OcclusionBuffer_Create(OcclusionBuffer* buffer, uint32_t width, uint32_t height);
+void OcclusionBuffer_Destroy(OcclusionBuffer* buffer);
+
+// Resets the depth to the far plane and drops the queued occluders
+void OcclusionBuffer_Clear(OcclusionBuffer* buffer);
+
+// Transforms an occluder to the screen and queues its triangles. Back faces are dropped using
+// the clockwise front faces of the pipeline state, triangles crossing the near plane are dropped
+// as well, which only makes the occluder smaller. Assumes cglm's default [-1, 1] clip depth.
+bool OcclusionBuffer_AddOccluder(OcclusionBuffer* buffer, mat4 mvp, const OccluderMesh* mesh);
+
+// Rasterizes the queued occluders into level 0, the rows are split into bands across the
+// workers and each band is filled 8 (AVX) or 4 (SSE) pixels at a time.
+void OcclusionBuffer_Rasterize(OcclusionBuffer* buffer);
+
+// Builds the pyramid levels from the rasterized depth
+void OcclusionBuffer_BuildHiZ(OcclusionBuffer* buffer);
+
+// Removes the bounds hidden behind the occluders from the visible indices, keeping their order,
+// and returns the remaining count. Each bound is projected to a screen rectangle which is tested
+// against the pyramid level where it covers at most 2x2 texels.
+size_t OcclusionCullSpheres(const OcclusionBuffer* buffer, mat4 viewProjection, const SphereBounds* bounds,
+                            uint32_t* visible, size_t visibleCount);
+size_t OcclusionCullAabbs(const OcclusionBuffer* buffer, mat4 viewProjection, const AabbBounds* bounds,
+                          uint32_t* visible, size_t visibleCount);
+
+// Single threaded scalar references. The bounds test reads every level 0 pixel under the
+// rectangle, so it culls at least everything the pyramid test does.
+void OcclusionBuffer_RasterizeScalar(OcclusionBuffer* buffer);
+size_t OcclusionCullSpheresScalar(const OcclusionBuffer* buffer, mat4 viewProjection, const SphereBounds* bounds,
+                                  uint32_t* visible, size_t visibleCount);
+size_t OcclusionCullAabbsScalar(const OcclusionBuffer* buffer, mat4 viewProjection, const AabbBounds* bounds,
+                                uint32_t* visible, size_t visibleCount);
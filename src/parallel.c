@@ -0,0 +1,109 @@
+#include "parallel.h"
+#include "job_system.h"
+
+#include <stdatomic.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <Windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+#define PARALLEL_MAX_WORKERS 64
+#define MIN_SIZE(x, y) ((x) < (y) ? (x) : (y))
+
+typedef struct ParallelJob
+{
+    ParallelForTask Task;
+    void* UserData;
+    size_t Count;
+    size_t Grain;
+    atomic_size_t NextChunk;
+} ParallelJob;
+
+uint32_t Parallel_GetHardwareThreadCount(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    return systemInfo.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t)count : 1;
+#endif
+}
+
+// Grabs chunks until the range is exhausted
+static void RunChunks(ParallelJob* job)
+{
+    size_t chunkCount = (job->Count + job->Grain - 1) / job->Grain;
+    for (;;)
+    {
+        size_t chunk = atomic_fetch_add_explicit(&job->NextChunk, 1, memory_order_relaxed);
+        if (chunk >= chunkCount)
+            break;
+
+        size_t begin = chunk * job->Grain;
+        size_t end = begin + job->Grain < job->Count ? begin + job->Grain : job->Count;
+        job->Task(job->UserData, begin, end);
+    }
+}
+
+static void RunChunksJob(void* userData)
+{
+    RunChunks(userData);
+}
+
+bool Parallel_Initialise(uint32_t workerCount)
+{
+    workerCount = workerCount < PARALLEL_MAX_WORKERS ? workerCount : PARALLEL_MAX_WORKERS;
+    return JobSystem_Initialise(workerCount);
+}
+
+void Parallel_Shutdown(void)
+{
+    JobSystem_Shutdown();
+}
+
+uint32_t Parallel_GetThreadCount(void)
+{
+    return JobSystem_GetThreadCount();
+}
+
+void ParallelFor(size_t count, size_t grain, ParallelForTask task, void* userData)
+{
+    if (count == 0)
+        return;
+
+    grain = grain > 0 ? grain : 1;
+    size_t chunkCount = (count + grain - 1) / grain;
+    uint32_t threadCount = JobSystem_GetThreadCount();
+    if (threadCount == 1 || chunkCount == 1 || JobSystem_GetThreadIndex() == UINT32_MAX)
+    {
+        task(userData, 0, count);
+        return;
+    }
+
+    ParallelJob job = {
+        .Task = task,
+        .UserData = userData,
+        .Count = count,
+        .Grain = grain
+    };
+    atomic_init(&job.NextChunk, 0);
+
+    // Helpers that find no chunk left return right away, the caller takes chunks as well
+    JobDecl helpers[PARALLEL_MAX_WORKERS];
+    size_t helperCount = MIN_SIZE(threadCount - 1, chunkCount - 1);
+    helperCount = MIN_SIZE(helperCount, PARALLEL_MAX_WORKERS);
+    for (size_t i = 0; i < helperCount; ++i)
+        helpers[i] = (JobDecl){ RunChunksJob, &job };
+
+    JobCounter counter;
+    atomic_init(&counter.Pending, 0);
+    JobSystem_Run(helpers, helperCount, &counter);
+    RunChunks(&job);
+    JobSystem_Wait(&counter);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Processes [begin, end) of the range handed to ParallelFor
+typedef void (*ParallelForTask)(void* userData, size_t begin, size_t end);
+
+// Starts the job system workers, 0 picks one worker per hardware thread minus the caller
+bool Parallel_Initialise(uint32_t workerCount);
+void Parallel_Shutdown(void);
+
+// Number of threads taking part in a ParallelFor, including the calling one
+uint32_t Parallel_GetThreadCount(void);
+uint32_t Parallel_GetHardwareThreadCount(void);
+
+// Splits [0, count) into chunks of grain elements and runs them as jobs on the workers and
+// the calling thread, returns once every chunk has been processed. The caller runs other jobs
+// while it waits, so nested calls spread over the workers as well. Threads outside the job
+// system run the whole range serially.
+void ParallelFor(size_t count, size_t grain, ParallelForTask task, void* userData);
@@ -0,0 +1,420 @@
+#include "particle_system.h"
+#include "dynamic_buffer.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <string.h>
+#include <threads.h>
+
+// Particles per chunk, a chunk compacts its survivors in place before they're gathered
+#define PARTICLE_CHUNK_SIZE 16384
+#define PARTICLE_MAX_CHUNKS 1024
+#define PARTICLE_ALIGNMENT 32
+// Billboards built on the stack before they're streamed to the instances
+#define INSTANCE_BATCH_SIZE 64
+
+enum
+{
+    POSITION_X,
+    POSITION_Y,
+    POSITION_Z,
+    VELOCITY_X,
+    VELOCITY_Y,
+    VELOCITY_Z,
+    AGE,
+    LIFETIME,
+    PARTICLE_ARRAY_COUNT
+};
+
+typedef struct IntegrationConstants
+{
+    float Dt;
+    // Velocity kept over the step and the velocity gravity adds
+    float Damping;
+    float GravityDt[3];
+} IntegrationConstants;
+
+typedef struct ParticleTaskData
+{
+    ParticleSystem* System;
+    IntegrationConstants Constants;
+    ParticleInstance* Instances;
+    size_t ChunkSize;
+    size_t Count;
+    size_t ChunkCounts[PARTICLE_MAX_CHUNKS];
+    size_t ChunkOffsets[PARTICLE_MAX_CHUNKS];
+} ParticleTaskData;
+
+#if defined(HD_AVX2)
+// Lane permutations moving the set lanes of an 8 bit mask to the front, 3 bits per lane, with
+// the number of set lanes above them
+static uint32_t g_CompactionTable[256];
+static once_flag g_CompactionTableOnce = ONCE_FLAG_INIT;
+
+static void BuildCompactionTable(void)
+{
+    for (uint32_t mask = 0; mask < 256; ++mask)
+    {
+        uint32_t entry = 0;
+        uint32_t count = 0;
+        for (uint32_t lane = 0; lane < 8; ++lane)
+        {
+            if (mask & (1u << lane))
+                entry |= lane << (3 * count++);
+        }
+        g_CompactionTable[mask] = entry | count << 24;
+    }
+}
+#endif
+
+static void GetArrays(const ParticleArrays* particles, float* arrays[PARTICLE_ARRAY_COUNT])
+{
+    arrays[POSITION_X] = particles->PositionX;
+    arrays[POSITION_Y] = particles->PositionY;
+    arrays[POSITION_Z] = particles->PositionZ;
+    arrays[VELOCITY_X] = particles->VelocityX;
+    arrays[VELOCITY_Y] = particles->VelocityY;
+    arrays[VELOCITY_Z] = particles->VelocityZ;
+    arrays[AGE] = particles->Age;
+    arrays[LIFETIME] = particles->Lifetime;
+}
+
+static void SetArrays(ParticleArrays* particles, float* arrays[PARTICLE_ARRAY_COUNT])
+{
+    particles->PositionX = arrays[POSITION_X];
+    particles->PositionY = arrays[POSITION_Y];
+    particles->PositionZ = arrays[POSITION_Z];
+    particles->VelocityX = arrays[VELOCITY_X];
+    particles->VelocityY = arrays[VELOCITY_Y];
+    particles->VelocityZ = arrays[VELOCITY_Z];
+    particles->Age = arrays[AGE];
+    particles->Lifetime = arrays[LIFETIME];
+}
+
+bool ParticleSystem_Create(ParticleSystem* system, size_t capacity, const ParticleEmitter* emitter)
+{
+    memset(system, 0, sizeof(*system));
+
+#if defined(HD_AVX2)
+    call_once(&g_CompactionTableOnce, BuildCompactionTable);
+#endif
+
+    // Both sets of arrays in one aligned block
+    capacity = (capacity + 7) & ~(size_t)7;
+    system->Block = AlignedAlloc(capacity * PARTICLE_ARRAY_COUNT * 2 * sizeof(float), PARTICLE_ALIGNMENT);
+    if (system->Block == NULL)
+        return false;
+
+    float* arrays[PARTICLE_ARRAY_COUNT];
+    for (int i = 0; i < PARTICLE_ARRAY_COUNT; ++i)
+        arrays[i] = system->Block + capacity * i;
+    SetArrays(&system->Particles, arrays);
+    for (int i = 0; i < PARTICLE_ARRAY_COUNT; ++i)
+        arrays[i] = system->Block + capacity * (PARTICLE_ARRAY_COUNT + i);
+    SetArrays(&system->Next, arrays);
+
+    system->Capacity = capacity;
+    system->Emitter = *emitter;
+    system->RandomState = 0x9E3779B9u;
+    return true;
+}
+
+void ParticleSystem_Destroy(ParticleSystem* system)
+{
+    AlignedFree(system->Block);
+    memset(system, 0, sizeof(*system));
+}
+
+// Xorshift, uniform in [0, 1)
+static float RandomFloat(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+size_t ParticleSystem_Emit(ParticleSystem* system, size_t count)
+{
+    const ParticleEmitter* emitter = &system->Emitter;
+    ParticleArrays* particles = &system->Particles;
+
+    count = count < system->Capacity - system->Count ? count : system->Capacity - system->Count;
+    for (size_t i = system->Count; i < system->Count + count; ++i)
+    {
+        particles->PositionX[i] = emitter->Position[0];
+        particles->PositionY[i] = emitter->Position[1];
+        particles->PositionZ[i] = emitter->Position[2];
+        particles->VelocityX[i] = emitter->Velocity[0] + (RandomFloat(&system->RandomState) * 2.0f - 1.0f) * emitter->Spread;
+        particles->VelocityY[i] = emitter->Velocity[1] + (RandomFloat(&system->RandomState) * 2.0f - 1.0f) * emitter->Spread;
+        particles->VelocityZ[i] = emitter->Velocity[2] + (RandomFloat(&system->RandomState) * 2.0f - 1.0f) * emitter->Spread;
+        particles->Age[i] = 0.0f;
+        particles->Lifetime[i] = emitter->MinLifetime +
+            (emitter->MaxLifetime - emitter->MinLifetime) * RandomFloat(&system->RandomState);
+    }
+
+    system->Count += count;
+    return count;
+}
+
+static void EmitForTimeStep(ParticleSystem* system, float dt)
+{
+    float particles = system->Emitter.Rate * dt + system->EmitRemainder;
+    size_t count = (size_t)particles;
+    system->EmitRemainder = particles - (float)count;
+    ParticleSystem_Emit(system, count);
+}
+
+static IntegrationConstants GetIntegrationConstants(const ParticleForces* forces, float dt)
+{
+    float damping = 1.0f - forces->Drag * dt;
+    IntegrationConstants constants = {
+        .Dt = dt,
+        .Damping = damping > 0.0f ? damping : 0.0f,
+        .GravityDt = { forces->Gravity[0] * dt, forces->Gravity[1] * dt, forces->Gravity[2] * dt }
+    };
+    return constants;
+}
+
+// Semi-implicit Euler step of particle i into values, in the order of the arrays. Returns
+// whether the particle is still alive.
+static bool IntegrateParticle(float* const arrays[PARTICLE_ARRAY_COUNT], size_t i,
+                              const IntegrationConstants* constants, float values[PARTICLE_ARRAY_COUNT])
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float velocity = arrays[VELOCITY_X + axis][i] * constants->Damping + constants->GravityDt[axis];
+        values[VELOCITY_X + axis] = velocity;
+        values[POSITION_X + axis] = arrays[POSITION_X + axis][i] + velocity * constants->Dt;
+    }
+    values[AGE] = arrays[AGE][i] + constants->Dt;
+    values[LIFETIME] = arrays[LIFETIME][i];
+    return values[AGE] < values[LIFETIME];
+}
+
+// Integrates [begin, end) and packs the survivors to the front of the range. A survivor never
+// moves past its own index, so the range compacts in place.
+static size_t IntegrateRange(float* const arrays[PARTICLE_ARRAY_COUNT], const IntegrationConstants* constants,
+                             size_t begin, size_t end)
+{
+    size_t n = begin;
+    size_t i = begin;
+
+#if defined(HD_AVX2)
+    __m256 dt = _mm256_set1_ps(constants->Dt);
+    __m256 damping = _mm256_set1_ps(constants->Damping);
+    __m256 gravityDt[3];
+    for (int axis = 0; axis < 3; ++axis)
+        gravityDt[axis] = _mm256_set1_ps(constants->GravityDt[axis]);
+    const __m256i laneShifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i laneMask = _mm256_set1_epi32(7);
+
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 values[PARTICLE_ARRAY_COUNT];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            values[VELOCITY_X + axis] = _mm256_fmadd_ps(_mm256_loadu_ps(arrays[VELOCITY_X + axis] + i), damping,
+                                                        gravityDt[axis]);
+            values[POSITION_X + axis] = _mm256_fmadd_ps(values[VELOCITY_X + axis], dt,
+                                                        _mm256_loadu_ps(arrays[POSITION_X + axis] + i));
+        }
+        values[AGE] = _mm256_add_ps(_mm256_loadu_ps(arrays[AGE] + i), dt);
+        values[LIFETIME] = _mm256_loadu_ps(arrays[LIFETIME] + i);
+
+        // The survivors are permuted to the front and all 8 lanes stored, the lanes past them
+        // only overwrite particles of this block that were already loaded
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(values[AGE], values[LIFETIME], _CMP_LT_OQ));
+        uint32_t entry = g_CompactionTable[mask];
+        __m256i permutation = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)entry), laneShifts), laneMask);
+        for (int k = 0; k < PARTICLE_ARRAY_COUNT; ++k)
+            _mm256_storeu_ps(arrays[k] + n, _mm256_permutevar8x32_ps(values[k], permutation));
+        n += entry >> 24;
+    }
+#endif
+
+#if defined(HD_SSE2)
+    __m128 dt4 = _mm_set1_ps(constants->Dt);
+    __m128 damping4 = _mm_set1_ps(constants->Damping);
+    __m128 gravityDt4[3];
+    for (int axis = 0; axis < 3; ++axis)
+        gravityDt4[axis] = _mm_set1_ps(constants->GravityDt[axis]);
+
+    for (; i + 4 <= end; i += 4)
+    {
+        HD_ALIGN(16) float lanes[PARTICLE_ARRAY_COUNT][4];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            __m128 velocity = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(arrays[VELOCITY_X + axis] + i), damping4),
+                                         gravityDt4[axis]);
+            __m128 position = _mm_add_ps(_mm_loadu_ps(arrays[POSITION_X + axis] + i), _mm_mul_ps(velocity, dt4));
+            _mm_store_ps(lanes[VELOCITY_X + axis], velocity);
+            _mm_store_ps(lanes[POSITION_X + axis], position);
+        }
+        __m128 age = _mm_add_ps(_mm_loadu_ps(arrays[AGE] + i), dt4);
+        __m128 lifetime = _mm_loadu_ps(arrays[LIFETIME] + i);
+        _mm_store_ps(lanes[AGE], age);
+        _mm_store_ps(lanes[LIFETIME], lifetime);
+
+        // Written unconditionally, the cursor only advances for the survivors
+        int mask = _mm_movemask_ps(_mm_cmplt_ps(age, lifetime));
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            for (int k = 0; k < PARTICLE_ARRAY_COUNT; ++k)
+                arrays[k][n] = lanes[k][lane];
+            n += (mask >> lane) & 1;
+        }
+    }
+#endif
+
+    for (; i < end; ++i)
+    {
+        float values[PARTICLE_ARRAY_COUNT];
+        bool alive = IntegrateParticle(arrays, i, constants, values);
+        for (int k = 0; k < PARTICLE_ARRAY_COUNT; ++k)
+            arrays[k][n] = values[k];
+        n += alive;
+    }
+
+    return n - begin;
+}
+
+// Streams the billboards of [begin, end) to the same range of the instances
+static void WriteInstances(const ParticleEmitter* emitter, const ParticleArrays* particles,
+                           size_t begin, size_t end, ParticleInstance* instances)
+{
+    float sizeRange = emitter->EndSize - emitter->StartSize;
+    uint32_t rgb = emitter->Color & 0x00FFFFFFu;
+
+    ParticleInstance batch[INSTANCE_BATCH_SIZE];
+    for (size_t first = begin; first < end; first += INSTANCE_BATCH_SIZE)
+    {
+        size_t count = end - first < INSTANCE_BATCH_SIZE ? end - first : INSTANCE_BATCH_SIZE;
+        for (size_t j = 0; j < count; ++j)
+        {
+            size_t i = first + j;
+            float t = particles->Age[i] / particles->Lifetime[i];
+            batch[j].Position[0] = particles->PositionX[i];
+            batch[j].Position[1] = particles->PositionY[i];
+            batch[j].Position[2] = particles->PositionZ[i];
+            batch[j].Size = emitter->StartSize + sizeRange * t;
+            batch[j].Color = rgb | (uint32_t)((1.0f - t) * 255.0f) << 24;
+        }
+        StreamCopy(instances + first, batch, count * sizeof(ParticleInstance));
+    }
+}
+
+static void IntegrateTask(void* userData, size_t begin, size_t end)
+{
+    ParticleTaskData* data = userData;
+    float* arrays[PARTICLE_ARRAY_COUNT];
+    GetArrays(&data->System->Particles, arrays);
+
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+        size_t first = chunk * data->ChunkSize;
+        size_t last = first + data->ChunkSize < data->Count ? first + data->ChunkSize : data->Count;
+        data->ChunkCounts[chunk] = IntegrateRange(arrays, &data->Constants, first, last);
+    }
+}
+
+static void GatherTask(void* userData, size_t begin, size_t end)
+{
+    ParticleTaskData* data = userData;
+    ParticleSystem* system = data->System;
+    float* source[PARTICLE_ARRAY_COUNT];
+    float* destination[PARTICLE_ARRAY_COUNT];
+    GetArrays(&system->Particles, source);
+    GetArrays(&system->Next, destination);
+
+    for (size_t chunk = begin; chunk < end; ++chunk)
+    {
+        size_t first = chunk * data->ChunkSize;
+        size_t offset = data->ChunkOffsets[chunk];
+        size_t count = data->ChunkCounts[chunk];
+        for (int k = 0; k < PARTICLE_ARRAY_COUNT; ++k)
+            memcpy(destination[k] + offset, source[k] + first, count * sizeof(float));
+
+        if (data->Instances != NULL)
+            WriteInstances(&system->Emitter, &system->Next, offset, offset + count, data->Instances);
+    }
+
+    // Streamed stores are only ordered by the thread that made them, before the job completes
+    if (data->Instances != NULL)
+        StreamFence();
+}
+
+static void SwapArrays(ParticleSystem* system, size_t count)
+{
+    ParticleArrays particles = system->Particles;
+    system->Particles = system->Next;
+    system->Next = particles;
+    system->Count = count;
+}
+
+size_t ParticleSystem_Update(ParticleSystem* system, const ParticleForces* forces, float dt,
+                             ParticleInstance* instances)
+{
+    EmitForTimeStep(system, dt);
+
+    ParticleTaskData data = {
+        .System = system,
+        .Constants = GetIntegrationConstants(forces, dt),
+        .Instances = instances,
+        .Count = system->Count
+    };
+
+    // Whole AVX blocks per chunk
+    size_t chunkSize = (data.Count + PARTICLE_MAX_CHUNKS - 1) / PARTICLE_MAX_CHUNKS;
+    chunkSize = chunkSize > PARTICLE_CHUNK_SIZE ? (chunkSize + 7) & ~(size_t)7 : PARTICLE_CHUNK_SIZE;
+    data.ChunkSize = chunkSize;
+    size_t chunkCount = (data.Count + chunkSize - 1) / chunkSize;
+
+    ParallelFor(chunkCount, 1, IntegrateTask, &data);
+
+    // Every chunk packed its survivors at its start, gather them into the other arrays in order
+    size_t aliveCount = 0;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        data.ChunkOffsets[chunk] = aliveCount;
+        aliveCount += data.ChunkCounts[chunk];
+    }
+
+    ParallelFor(chunkCount, 1, GatherTask, &data);
+
+    SwapArrays(system, aliveCount);
+    return aliveCount;
+}
+
+size_t ParticleSystem_UpdateScalar(ParticleSystem* system, const ParticleForces* forces, float dt,
+                                   ParticleInstance* instances)
+{
+    EmitForTimeStep(system, dt);
+
+    IntegrationConstants constants = GetIntegrationConstants(forces, dt);
+    float* source[PARTICLE_ARRAY_COUNT];
+    float* destination[PARTICLE_ARRAY_COUNT];
+    GetArrays(&system->Particles, source);
+    GetArrays(&system->Next, destination);
+
+    size_t n = 0;
+    for (size_t i = 0; i < system->Count; ++i)
+    {
+        float values[PARTICLE_ARRAY_COUNT];
+        bool alive = IntegrateParticle(source, i, &constants, values);
+        for (int k = 0; k < PARTICLE_ARRAY_COUNT; ++k)
+            destination[k][n] = values[k];
+        n += alive;
+    }
+
+    if (instances != NULL)
+    {
+        WriteInstances(&system->Emitter, &system->Next, 0, n, instances);
+        StreamFence();
+    }
+
+    SwapArrays(system, n);
+    return n;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+// Billboard of a particle as the particle pipeline state reads it, one per instance
+typedef struct ParticleInstance
+{
+    float Position[3];
+    float Size;
+    // R8G8B8A8
+    uint32_t Color;
+} ParticleInstance;
+
+typedef struct ParticleEmitter
+{
+    vec3 Position;
+    vec3 Velocity;
+    // Added to every axis of the velocity, uniform in [-Spread, Spread]
+    float Spread;
+    // Particles per second
+    float Rate;
+    float MinLifetime;
+    float MaxLifetime;
+    // Billboard size at birth and at the end of the lifetime, the alpha of the color fades out
+    // over the same time
+    float StartSize;
+    float EndSize;
+    uint32_t Color;
+} ParticleEmitter;
+
+typedef struct ParticleForces
+{
+    vec3 Gravity;
+    // Fraction of the velocity lost per second
+    float Drag;
+} ParticleForces;
+
+// Particle state in structure-of-arrays form, all arrays come from one aligned block
+typedef struct ParticleArrays
+{
+    float* PositionX;
+    float* PositionY;
+    float* PositionZ;
+    float* VelocityX;
+    float* VelocityY;
+    float* VelocityZ;
+    float* Age;
+    float* Lifetime;
+} ParticleArrays;
+
+// The live particles are packed at the front of the arrays. Every update compacts the
+// survivors into the second set and swaps the two.
+typedef struct ParticleSystem
+{
+    ParticleArrays Particles;
+    ParticleArrays Next;
+    // Both sets are carved from it, the swaps don't change it
+    float* Block;
+    size_t Count;
+    size_t Capacity;
+    ParticleEmitter Emitter;
+    // Fraction of a particle the rate left over from the previous update
+    float EmitRemainder;
+    uint32_t RandomState;
+} ParticleSystem;
+
+bool ParticleSystem_Create(ParticleSystem* system, size_t capacity, const ParticleEmitter* emitter);
+void ParticleSystem_Destroy(ParticleSystem* system);
+
+// Spawns up to count particles at the emitter, fewer once the capacity is reached. Returns
+// the number spawned.
+size_t ParticleSystem_Emit(ParticleSystem* system, size_t count);
+
+// Emits for dt seconds, integrates the forces and drops the particles that outlived their
+// lifetime. The chunks are integrated across the workers 8 (AVX) or 4 (SSE) particles at a
+// time and compacted in parallel. When instances isn't NULL the billboards of the survivors
+// are streamed to it in order, it has to hold Capacity entries and may be write-combined
+// upload memory. Returns the number of live particles.
+size_t ParticleSystem_Update(ParticleSystem* system, const ParticleForces* forces, float dt,
+                             ParticleInstance* instances);
+
+// Single threaded scalar reference
+size_t ParticleSystem_UpdateScalar(ParticleSystem* system, const ParticleForces* forces, float dt,
+                                   ParticleInstance* instances);
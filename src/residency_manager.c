@@ -0,0 +1,208 @@
+#include "residency_manager.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Grows an array of pointers to hold at least count of them, doubling it
+static bool Reserve(void** array, uint32_t* capacity, uint32_t count)
+{
+    if (count <= *capacity)
+        return true;
+    uint32_t newCapacity = *capacity > 0 ? *capacity : 64;
+    while (newCapacity < count)
+        newCapacity *= 2;
+    void* newArray = realloc(*array, (size_t)newCapacity * sizeof(void*));
+    if (newArray == NULL)
+        return false;
+    *array = newArray;
+    *capacity = newCapacity;
+    return true;
+}
+
+static void Unlink(ResidencyManager* manager, ResidencyObject* object)
+{
+    if (object->Previous != NULL)
+        object->Previous->Next = object->Next;
+    else
+        manager->LeastRecent = object->Next;
+    if (object->Next != NULL)
+        object->Next->Previous = object->Previous;
+    else
+        manager->MostRecent = object->Previous;
+    object->Previous = NULL;
+    object->Next = NULL;
+}
+
+static void LinkMostRecent(ResidencyManager* manager, ResidencyObject* object)
+{
+    object->Previous = manager->MostRecent;
+    object->Next = NULL;
+    if (manager->MostRecent != NULL)
+        manager->MostRecent->Next = object;
+    else
+        manager->LeastRecent = object;
+    manager->MostRecent = object;
+}
+
+void ResidencyManager_Create(ResidencyManager* manager, ResidencyPagingFunction evict,
+                             ResidencyPagingFunction makeResident, ResidencyWaitFunction wait, void* context)
+{
+    memset(manager, 0, sizeof(*manager));
+    manager->Evict = evict;
+    manager->MakeResident = makeResident;
+    manager->Wait = wait;
+    manager->Context = context;
+    // Nothing is evicted until the OS reported a budget
+    manager->Counters.Budget = UINT64_MAX;
+    // Tracked objects start out of any set
+    manager->Submission = 1;
+}
+
+void ResidencyManager_Destroy(ResidencyManager* manager)
+{
+    free(manager->Set);
+    free(manager->Batch);
+    memset(manager, 0, sizeof(*manager));
+}
+
+bool ResidencyManager_Track(ResidencyManager* manager, ResidencyObject* object, void* pageable, uint64_t size)
+{
+    if (!Reserve((void**)&manager->Batch, &manager->BatchCapacity, manager->Counters.TrackedCount + 1))
+        return false;
+
+    memset(object, 0, sizeof(*object));
+    object->Pageable = pageable;
+    object->Size = size;
+    // Keeps the list ordered by fence value, the submissions so far may use it already
+    object->LastUsedFence = manager->LastSubmittedFence;
+    object->Resident = true;
+    LinkMostRecent(manager, object);
+
+    ResidencyCounters* counters = &manager->Counters;
+    counters->TrackedCount++;
+    counters->TrackedSize += size;
+    counters->ResidentCount++;
+    counters->ResidentSize += size;
+    return true;
+}
+
+void ResidencyManager_Untrack(ResidencyManager* manager, ResidencyObject* object)
+{
+    ResidencyCounters* counters = &manager->Counters;
+    if (object->Resident)
+    {
+        Unlink(manager, object);
+        counters->ResidentCount--;
+        counters->ResidentSize -= object->Size;
+    }
+    counters->TrackedCount--;
+    counters->TrackedSize -= object->Size;
+
+    if (object->Submission == manager->Submission)
+    {
+        for (uint32_t i = 0; i < manager->SetCount; ++i)
+        {
+            if (manager->Set[i] == object)
+            {
+                manager->Set[i] = manager->Set[--manager->SetCount];
+                break;
+            }
+        }
+    }
+    memset(object, 0, sizeof(*object));
+}
+
+void ResidencyManager_SetBudget(ResidencyManager* manager, uint64_t budget, uint64_t usage)
+{
+    ResidencyCounters* counters = &manager->Counters;
+    counters->Budget = budget;
+    counters->Usage = usage;
+    manager->ExternalUsage = usage > counters->ResidentSize ? usage - counters->ResidentSize : 0;
+}
+
+bool ResidencyManager_Use(ResidencyManager* manager, ResidencyObject* object)
+{
+    if (object->Submission == manager->Submission)
+        return true;
+    if (!Reserve((void**)&manager->Set, &manager->SetCapacity, manager->SetCount + 1))
+        return false;
+    object->Submission = manager->Submission;
+    manager->Set[manager->SetCount++] = object;
+    return true;
+}
+
+bool ResidencyManager_Submit(ResidencyManager* manager, uint64_t completedFence, uint64_t submitFence)
+{
+    ResidencyCounters* counters = &manager->Counters;
+    uint64_t available = counters->Budget > manager->ExternalUsage ? counters->Budget - manager->ExternalUsage : 0;
+    uint64_t incoming = 0;
+    for (uint32_t i = 0; i < manager->SetCount; ++i)
+    {
+        if (!manager->Set[i]->Resident)
+            incoming += manager->Set[i]->Size;
+    }
+
+    // Least recently used first. The list is ordered by fence value, so once an object is idle
+    // every one before it is too.
+    uint32_t evictCount = 0;
+    ResidencyObject* object = manager->LeastRecent;
+    while (object != NULL && counters->ResidentSize + incoming > available)
+    {
+        ResidencyObject* next = object->Next;
+        if (object->Submission != manager->Submission && object->LastUsedFence > completedFence)
+        {
+            if (manager->Wait == NULL)
+                break;
+            manager->Wait(manager->Context, object->LastUsedFence);
+            completedFence = object->LastUsedFence;
+            counters->WaitCount++;
+        }
+        if (object->Submission != manager->Submission)
+        {
+            Unlink(manager, object);
+            object->Resident = false;
+            counters->ResidentCount--;
+            counters->ResidentSize -= object->Size;
+            counters->EvictionCount++;
+            counters->EvictedSize += object->Size;
+            manager->Batch[evictCount++] = object->Pageable;
+        }
+        object = next;
+    }
+    if (evictCount > 0)
+        manager->Evict(manager->Context, manager->Batch, evictCount);
+
+    // The set becomes the most recently used, in the order it was listed
+    uint32_t residentCount = 0;
+    for (uint32_t i = 0; i < manager->SetCount; ++i)
+    {
+        object = manager->Set[i];
+        if (object->Resident)
+            Unlink(manager, object);
+        else
+        {
+            object->Resident = true;
+            counters->ResidentCount++;
+            counters->ResidentSize += object->Size;
+            counters->MadeResidentCount++;
+            counters->MadeResidentSize += object->Size;
+            manager->Batch[residentCount++] = object->Pageable;
+        }
+        object->LastUsedFence = submitFence;
+        LinkMostRecent(manager, object);
+    }
+    if (residentCount > 0)
+        manager->MakeResident(manager->Context, manager->Batch, residentCount);
+
+    manager->LastSubmittedFence = submitFence;
+    manager->SetCount = 0;
+    manager->Submission++;
+
+    bool fits = counters->ResidentSize <= available;
+    if (!fits)
+    {
+        counters->OverBudgetCount++;
+        counters->OverBudgetSize = counters->ResidentSize - available;
+    }
+    return fits;
+}
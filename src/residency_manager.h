@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Evicts or makes resident a batch of pageable objects, ID3D12Pageable on D3D12
+typedef void (*ResidencyPagingFunction)(void* context, void* const* pageables, uint32_t count);
+// Waits until the submission signaling the fence value completed
+typedef void (*ResidencyWaitFunction)(void* context, uint64_t fence);
+
+// A heap or committed resource, embedded by its owner and linked into the manager
+typedef struct ResidencyObject
+{
+    void* Pageable;
+    uint64_t Size;
+    // Fence value of the last submission using it, it can't be evicted before that completed
+    uint64_t LastUsedFence;
+    // Submission whose set it was added to last
+    uint64_t Submission;
+    bool Resident;
+    // Resident objects, least recently used first
+    struct ResidencyObject* Previous;
+    struct ResidencyObject* Next;
+} ResidencyObject;
+
+typedef struct ResidencyCounters
+{
+    // Local video memory as last reported by the OS, usage counts the untracked objects too
+    uint64_t Budget;
+    uint64_t Usage;
+    uint64_t TrackedSize;
+    uint64_t ResidentSize;
+    uint32_t TrackedCount;
+    uint32_t ResidentCount;
+    // Since the manager was created
+    uint64_t EvictedSize;
+    uint64_t MadeResidentSize;
+    uint32_t EvictionCount;
+    uint32_t MadeResidentCount;
+    // Waits for submissions in flight to evict what they use
+    uint32_t WaitCount;
+    // Submissions that didn't fit the budget with every idle object evicted, and how far the
+    // last one was over. The OS pages behind them.
+    uint32_t OverBudgetCount;
+    uint64_t OverBudgetSize;
+} ResidencyCounters;
+
+// Keeps the objects used by the submissions within the video memory budget. Every submission
+// lists the objects it uses, the ones evicted earlier are made resident again in one batch and
+// the least recently used ones no submission in flight uses are evicted in another, until the
+// set fits. When those aren't enough it waits for the submissions using the next ones, a
+// stall, but a shorter one than the OS paging behind the submission. Not thread safe, it's
+// meant for the thread submitting the work.
+typedef struct ResidencyManager
+{
+    ResidencyPagingFunction Evict;
+    ResidencyPagingFunction MakeResident;
+    ResidencyWaitFunction Wait;
+    void* Context;
+
+    ResidencyObject* LeastRecent;
+    ResidencyObject* MostRecent;
+    // Usage of everything but the tracked objects when the budget was set
+    uint64_t ExternalUsage;
+    // Fence value of the last submission
+    uint64_t LastSubmittedFence;
+    uint64_t Submission;
+
+    // Objects of the next submission
+    ResidencyObject** Set;
+    uint32_t SetCount;
+    uint32_t SetCapacity;
+    // Pageables handed to the paging functions, large enough for every tracked object
+    void** Batch;
+    uint32_t BatchCapacity;
+
+    ResidencyCounters Counters;
+} ResidencyManager;
+
+// Without a wait function the objects in flight are never evicted
+void ResidencyManager_Create(ResidencyManager* manager, ResidencyPagingFunction evict,
+                             ResidencyPagingFunction makeResident, ResidencyWaitFunction wait, void* context);
+void ResidencyManager_Destroy(ResidencyManager* manager);
+
+// Starts tracking an object, resident like a freshly created one and not evicted before the
+// submissions so far complete. False when out of memory.
+bool ResidencyManager_Track(ResidencyManager* manager, ResidencyObject* object, void* pageable, uint64_t size);
+// Stops tracking it, before it's released
+void ResidencyManager_Untrack(ResidencyManager* manager, ResidencyObject* object);
+
+// Budget and current usage of the process reported by the OS, polled every frame
+void ResidencyManager_SetBudget(ResidencyManager* manager, uint64_t budget, uint64_t usage);
+
+// Adds an object to the set of the next submission, false when out of memory
+bool ResidencyManager_Use(ResidencyManager* manager, ResidencyObject* object);
+
+// Pages for the set before it's submitted: evicts the least recently used objects outside of it
+// while the set doesn't fit the budget, then makes the set resident.
+// The set is stamped with the fence value the submission signals and cleared. Returns false
+// when the set still didn't fit, the OS pages behind it then.
+bool ResidencyManager_Submit(ResidencyManager* manager, uint64_t completedFence, uint64_t submitFence);
@@ -0,0 +1,69 @@
+#include "root_signature.h"
+
+bool RootSignature_Downgrade(const RootSignatureDesc1* desc, LinearArena* arena, RootSignatureDesc* result)
+{
+    // The ranges of every table follow the parameters
+    size_t rangeCount = 0;
+    for (uint32_t n = 0; n < desc->NumParameters; ++n)
+    {
+        if (desc->Parameters[n].ParameterType == ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+            rangeCount += desc->Parameters[n].DescriptorTable.NumDescriptorRanges;
+    }
+    size_t size = desc->NumParameters * sizeof(RootParameter) + rangeCount * sizeof(RootDescriptorRange);
+    RootParameter* parameters = NULL;
+    if (size > 0)
+    {
+        parameters = LinearArena_Alloc(arena, size, _Alignof(RootParameter));
+        if (parameters == NULL)
+            return false;
+    }
+    RootDescriptorRange* ranges = parameters != NULL ? (RootDescriptorRange*)(parameters + desc->NumParameters) : NULL;
+
+    for (uint32_t n = 0; n < desc->NumParameters; ++n)
+    {
+        const RootParameter1* source = &desc->Parameters[n];
+        RootParameter* parameter = &parameters[n];
+        parameter->ParameterType = source->ParameterType;
+        parameter->ShaderVisibility = source->ShaderVisibility;
+        switch (source->ParameterType)
+        {
+        case ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+            parameter->Constants = source->Constants;
+            break;
+
+        case ROOT_PARAMETER_TYPE_CBV:
+        case ROOT_PARAMETER_TYPE_SRV:
+        case ROOT_PARAMETER_TYPE_UAV:
+            parameter->Descriptor.ShaderRegister = source->Descriptor.ShaderRegister;
+            parameter->Descriptor.RegisterSpace = source->Descriptor.RegisterSpace;
+            break;
+
+        case ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+        {
+            uint32_t count = source->DescriptorTable.NumDescriptorRanges;
+            for (uint32_t x = 0; x < count; ++x)
+            {
+                const RootDescriptorRange1* range = &source->DescriptorTable.DescriptorRanges[x];
+                ranges[x] = (RootDescriptorRange){
+                    .RangeType = range->RangeType,
+                    .NumDescriptors = range->NumDescriptors,
+                    .BaseShaderRegister = range->BaseShaderRegister,
+                    .RegisterSpace = range->RegisterSpace,
+                    .OffsetInDescriptorsFromTableStart = range->OffsetInDescriptorsFromTableStart
+                };
+            }
+            parameter->DescriptorTable.NumDescriptorRanges = count;
+            parameter->DescriptorTable.DescriptorRanges = count > 0 ? ranges : NULL;
+            ranges += count;
+            break;
+        }
+        }
+    }
+
+    result->NumParameters = desc->NumParameters;
+    result->Parameters = parameters;
+    result->NumStaticSamplers = desc->NumStaticSamplers;
+    result->StaticSamplers = desc->StaticSamplers;
+    result->Flags = desc->Flags;
+    return true;
+}
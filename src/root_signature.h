@@ -0,0 +1,110 @@
+#pragma once
+
+#include "frame_arena.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Mirrors of the D3D12 root signature descs of versions 1.0 and 1.1, laid out like them, with
+// the values of the D3D12 enums and flags kept as they are
+
+#define ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE 0
+#define ROOT_PARAMETER_TYPE_32BIT_CONSTANTS 1
+#define ROOT_PARAMETER_TYPE_CBV 2
+#define ROOT_PARAMETER_TYPE_SRV 3
+#define ROOT_PARAMETER_TYPE_UAV 4
+
+typedef struct RootDescriptorRange
+{
+    uint32_t RangeType;
+    uint32_t NumDescriptors;
+    uint32_t BaseShaderRegister;
+    uint32_t RegisterSpace;
+    uint32_t OffsetInDescriptorsFromTableStart;
+} RootDescriptorRange;
+
+typedef struct RootDescriptorRange1
+{
+    uint32_t RangeType;
+    uint32_t NumDescriptors;
+    uint32_t BaseShaderRegister;
+    uint32_t RegisterSpace;
+    uint32_t Flags;
+    uint32_t OffsetInDescriptorsFromTableStart;
+} RootDescriptorRange1;
+
+typedef struct RootConstants
+{
+    uint32_t ShaderRegister;
+    uint32_t RegisterSpace;
+    uint32_t Num32BitValues;
+} RootConstants;
+
+typedef struct RootDescriptor
+{
+    uint32_t ShaderRegister;
+    uint32_t RegisterSpace;
+} RootDescriptor;
+
+typedef struct RootDescriptor1
+{
+    uint32_t ShaderRegister;
+    uint32_t RegisterSpace;
+    uint32_t Flags;
+} RootDescriptor1;
+
+typedef struct RootParameter
+{
+    uint32_t ParameterType;
+    union
+    {
+        struct
+        {
+            uint32_t NumDescriptorRanges;
+            const RootDescriptorRange* DescriptorRanges;
+        } DescriptorTable;
+        RootConstants Constants;
+        RootDescriptor Descriptor;
+    };
+    uint32_t ShaderVisibility;
+} RootParameter;
+
+typedef struct RootParameter1
+{
+    uint32_t ParameterType;
+    union
+    {
+        struct
+        {
+            uint32_t NumDescriptorRanges;
+            const RootDescriptorRange1* DescriptorRanges;
+        } DescriptorTable;
+        RootConstants Constants;
+        RootDescriptor1 Descriptor;
+    };
+    uint32_t ShaderVisibility;
+} RootParameter1;
+
+// The static samplers are the same in both versions, they're passed through
+typedef struct RootSignatureDesc
+{
+    uint32_t NumParameters;
+    const RootParameter* Parameters;
+    uint32_t NumStaticSamplers;
+    const void* StaticSamplers;
+    uint32_t Flags;
+} RootSignatureDesc;
+
+typedef struct RootSignatureDesc1
+{
+    uint32_t NumParameters;
+    const RootParameter1* Parameters;
+    uint32_t NumStaticSamplers;
+    const void* StaticSamplers;
+    uint32_t Flags;
+} RootSignatureDesc1;
+
+// Reconstructs a 1.0 desc of the 1.1 one for devices without 1.1, dropping the flags of the
+// ranges and the root descriptors. The parameters and the ranges are allocated from the arena
+// in one block. False when it's out of memory.
+bool RootSignature_Downgrade(const RootSignatureDesc1* desc, LinearArena* arena, RootSignatureDesc* result);
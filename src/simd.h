@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// Instruction set selection shared by the CPU kernels.
+// SSE2 is the baseline on x64, wider paths are picked when the compiler targets them
+// (/arch:AVX2 on MSVC, -mavx2 -mfma -mf16c on GCC and Clang, both set by HD_ENABLE_AVX2).
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define HD_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+    #define HD_AVX2 1
+    #include <immintrin.h>
+#endif
+
+// MSVC has no F16C macro, /arch:AVX2 implies it
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+    #define HD_F16C 1
+    #include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+    #define HD_ALIGN(x) __declspec(align(x))
+#else
+    #define HD_ALIGN(x) __attribute__((aligned(x)))
+#endif
+
+// SIMD loads and cglm's aligned mat4 need aligned heap blocks
+#if defined(_MSC_VER)
+    #include <malloc.h>
+    static inline void* AlignedAlloc(size_t size, size_t alignment) { return _aligned_malloc(size, alignment); }
+    static inline void AlignedFree(void* block) { _aligned_free(block); }
+#else
+    static inline void* AlignedAlloc(size_t size, size_t alignment)
+    {
+        // C11 aligned_alloc wants the size to be a multiple of the alignment
+        return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+    static inline void AlignedFree(void* block) { free(block); }
+#endif
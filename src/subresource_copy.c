@@ -0,0 +1,36 @@
+#include "subresource_copy.h"
+
+#include <string.h>
+
+void Subresource_Copy(void* destination, size_t destinationRowPitch, size_t destinationSlicePitch,
+                      const SubresourceData* source, size_t rowSize, uint32_t rowCount, uint32_t sliceCount)
+{
+    // Tightly packed on both sides, the rows of every slice are one copy
+    bool packed = (size_t)source->RowPitch == rowSize && destinationRowPitch == rowSize;
+    for (uint32_t z = 0; z < sliceCount; ++z)
+    {
+        uint8_t* destinationSlice = (uint8_t*)destination + destinationSlicePitch * z;
+        const uint8_t* sourceSlice = (const uint8_t*)source->Data + source->SlicePitch * z;
+        if (packed)
+        {
+            memcpy(destinationSlice, sourceSlice, rowSize * rowCount);
+            continue;
+        }
+        for (uint32_t y = 0; y < rowCount; ++y)
+            memcpy(destinationSlice + destinationRowPitch * y, sourceSlice + source->RowPitch * y, rowSize);
+    }
+}
+
+bool Subresource_Stage(uint8_t* mapped, const SubresourceFootprint* layouts, const uint32_t* rowCounts,
+                       const uint64_t* rowSizes, const SubresourceData* sources, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (rowSizes[i] > (size_t)-1)
+            return false;
+        size_t rowPitch = layouts[i].RowPitch;
+        Subresource_Copy(mapped + layouts[i].Offset, rowPitch, rowPitch * rowCounts[i], &sources[i],
+                         (size_t)rowSizes[i], rowCounts[i], layouts[i].Depth);
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Laid out like D3D12_SUBRESOURCE_DATA
+typedef struct SubresourceData
+{
+    const void* Data;
+    intptr_t RowPitch;
+    intptr_t SlicePitch;
+} SubresourceData;
+
+// Laid out like D3D12_PLACED_SUBRESOURCE_FOOTPRINT
+typedef struct SubresourceFootprint
+{
+    uint64_t Offset;
+    uint32_t Format;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Depth;
+    uint32_t RowPitch;
+} SubresourceFootprint;
+
+// Copies the rows of every slice, where the pitches of the source and the destination differ
+void Subresource_Copy(void* destination, size_t destinationRowPitch, size_t destinationSlicePitch,
+                      const SubresourceData* source, size_t rowSize, uint32_t rowCount, uint32_t sliceCount);
+
+// Copies the subresources into the mapped upload buffer at the offsets and pitches of their
+// footprints, the staging of UpdateSubresources. False when a row doesn't fit in a size_t.
+bool Subresource_Stage(uint8_t* mapped, const SubresourceFootprint* layouts, const uint32_t* rowCounts,
+                       const uint64_t* rowSizes, const SubresourceData* sources, uint32_t count);
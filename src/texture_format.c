@@ -0,0 +1,45 @@
+#include "texture_format.h"
+
+bool TextureFormat_IsCompressed(TextureFormat format)
+{
+    return format == TEXTURE_FORMAT_BC1 || format == TEXTURE_FORMAT_BC3 ||
+           format == TEXTURE_FORMAT_BC5 || format == TEXTURE_FORMAT_BC7;
+}
+
+uint32_t TextureFormat_GetElementSize(TextureFormat format)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_RGBA8: return 4;
+        case TEXTURE_FORMAT_BC1: return 8;
+        case TEXTURE_FORMAT_BC3: return 16;
+        case TEXTURE_FORMAT_BC5: return 16;
+        case TEXTURE_FORMAT_BC7: return 16;
+        default: return 0;
+    }
+}
+
+size_t TextureFormat_GetRowPitch(TextureFormat format, uint32_t width)
+{
+    // Rounded up without adding, which would wrap for the largest widths
+    uint32_t elements = TextureFormat_IsCompressed(format) ? width / 4 + (width % 4 != 0) : width;
+    return (size_t)elements * TextureFormat_GetElementSize(format);
+}
+
+uint32_t TextureFormat_GetRowCount(TextureFormat format, uint32_t height)
+{
+    return TextureFormat_IsCompressed(format) ? height / 4 + (height % 4 != 0) : height;
+}
+
+const char* TextureFormat_GetName(TextureFormat format)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_RGBA8: return "RGBA8";
+        case TEXTURE_FORMAT_BC1: return "BC1";
+        case TEXTURE_FORMAT_BC3: return "BC3";
+        case TEXTURE_FORMAT_BC5: return "BC5";
+        case TEXTURE_FORMAT_BC7: return "BC7";
+        default: return "unknown";
+    }
+}
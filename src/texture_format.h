@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Storage format of a texture
+typedef enum TextureFormat
+{
+    TEXTURE_FORMAT_UNKNOWN,
+    TEXTURE_FORMAT_RGBA8, // R8G8B8A8, 4 bytes per texel
+    TEXTURE_FORMAT_BC1,   // RGB, 8 bytes per 4x4 block
+    TEXTURE_FORMAT_BC3,   // RGBA, 16 bytes per block, BC1 color and BC4 alpha
+    TEXTURE_FORMAT_BC5,   // RG, 16 bytes per block, two BC4 channels
+    TEXTURE_FORMAT_BC7,   // RGBA, 16 bytes per block
+} TextureFormat;
+
+bool TextureFormat_IsCompressed(TextureFormat format);
+
+// Bytes of a texel, or of a 4x4 block for the compressed formats
+uint32_t TextureFormat_GetElementSize(TextureFormat format);
+
+// Bytes of a row of texels or blocks, and the number of those rows in a surface
+size_t TextureFormat_GetRowPitch(TextureFormat format, uint32_t width);
+uint32_t TextureFormat_GetRowCount(TextureFormat format, uint32_t height);
+
+const char* TextureFormat_GetName(TextureFormat format);
@@ -0,0 +1,287 @@
+#include "transform_hierarchy.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <string.h>
+
+// Matrices per ParallelFor chunk
+#define TRANSFORM_GRAIN 256
+#define MATRIX_ALIGNMENT 32
+
+typedef struct TransformTaskData
+{
+    TransformHierarchy* Hierarchy;
+    const uint32_t* Nodes;
+} TransformTaskData;
+
+static bool Reserve(TransformHierarchy* hierarchy, size_t capacity)
+{
+    if (capacity <= hierarchy->Capacity)
+        return true;
+
+    size_t count = hierarchy->Count;
+    int32_t* parents = malloc(capacity * sizeof(int32_t));
+    uint32_t* depths = malloc(capacity * sizeof(uint32_t));
+    mat4* localMatrices = AlignedAlloc(capacity * sizeof(mat4), MATRIX_ALIGNMENT);
+    mat4* worldMatrices = AlignedAlloc(capacity * sizeof(mat4), MATRIX_ALIGNMENT);
+    mat4* mvpMatrices = AlignedAlloc(capacity * sizeof(mat4), MATRIX_ALIGNMENT);
+    uint8_t* localDirty = malloc(capacity);
+    int32_t* firstChild = malloc(capacity * sizeof(int32_t));
+    int32_t* nextSibling = malloc(capacity * sizeof(int32_t));
+    uint32_t* dirtyQueue = malloc(capacity * sizeof(uint32_t));
+    uint8_t* worldDirty = malloc(capacity);
+    uint32_t* dirtyNodes = malloc(capacity * sizeof(uint32_t));
+
+    if (!parents || !depths || !localMatrices || !worldMatrices || !mvpMatrices ||
+        !localDirty || !firstChild || !nextSibling || !dirtyQueue || !worldDirty || !dirtyNodes)
+    {
+        free(parents);
+        free(depths);
+        AlignedFree(localMatrices);
+        AlignedFree(worldMatrices);
+        AlignedFree(mvpMatrices);
+        free(localDirty);
+        free(firstChild);
+        free(nextSibling);
+        free(dirtyQueue);
+        free(worldDirty);
+        free(dirtyNodes);
+        return false;
+    }
+
+    if (count > 0)
+    {
+        memcpy(parents, hierarchy->Parents, count * sizeof(int32_t));
+        memcpy(depths, hierarchy->Depths, count * sizeof(uint32_t));
+        memcpy(localMatrices, hierarchy->LocalMatrices, count * sizeof(mat4));
+        memcpy(worldMatrices, hierarchy->WorldMatrices, count * sizeof(mat4));
+        memcpy(mvpMatrices, hierarchy->MvpMatrices, count * sizeof(mat4));
+        memcpy(localDirty, hierarchy->LocalDirty, count);
+        memcpy(firstChild, hierarchy->FirstChild, count * sizeof(int32_t));
+        memcpy(nextSibling, hierarchy->NextSibling, count * sizeof(int32_t));
+        memcpy(dirtyQueue, hierarchy->DirtyQueue, hierarchy->DirtyRootCount * sizeof(uint32_t));
+    }
+    // Nothing is dirty between the updates, the update clears what it marks
+    memset(worldDirty, 0, capacity);
+
+    free(hierarchy->Parents);
+    free(hierarchy->Depths);
+    AlignedFree(hierarchy->LocalMatrices);
+    AlignedFree(hierarchy->WorldMatrices);
+    AlignedFree(hierarchy->MvpMatrices);
+    free(hierarchy->LocalDirty);
+    free(hierarchy->FirstChild);
+    free(hierarchy->NextSibling);
+    free(hierarchy->DirtyQueue);
+    free(hierarchy->WorldDirty);
+    free(hierarchy->DirtyNodes);
+
+    hierarchy->Capacity = capacity;
+    hierarchy->Parents = parents;
+    hierarchy->Depths = depths;
+    hierarchy->LocalMatrices = localMatrices;
+    hierarchy->WorldMatrices = worldMatrices;
+    hierarchy->MvpMatrices = mvpMatrices;
+    hierarchy->LocalDirty = localDirty;
+    hierarchy->FirstChild = firstChild;
+    hierarchy->NextSibling = nextSibling;
+    hierarchy->DirtyQueue = dirtyQueue;
+    hierarchy->WorldDirty = worldDirty;
+    hierarchy->DirtyNodes = dirtyNodes;
+    return true;
+}
+
+bool TransformHierarchy_Create(TransformHierarchy* hierarchy, size_t capacity)
+{
+    memset(hierarchy, 0, sizeof(*hierarchy));
+    return Reserve(hierarchy, capacity > 0 ? capacity : 1);
+}
+
+void TransformHierarchy_Destroy(TransformHierarchy* hierarchy)
+{
+    free(hierarchy->Parents);
+    free(hierarchy->Depths);
+    AlignedFree(hierarchy->LocalMatrices);
+    AlignedFree(hierarchy->WorldMatrices);
+    AlignedFree(hierarchy->MvpMatrices);
+    free(hierarchy->LocalDirty);
+    free(hierarchy->FirstChild);
+    free(hierarchy->NextSibling);
+    free(hierarchy->DirtyQueue);
+    free(hierarchy->WorldDirty);
+    free(hierarchy->DirtyNodes);
+    free(hierarchy->DepthOffsets);
+
+    memset(hierarchy, 0, sizeof(*hierarchy));
+}
+
+int32_t TransformHierarchy_AddNode(TransformHierarchy* hierarchy, int32_t parent, mat4 local)
+{
+    if (parent >= (int32_t)hierarchy->Count)
+        return -1;
+
+    if (hierarchy->Count == hierarchy->Capacity && !Reserve(hierarchy, hierarchy->Capacity * 2))
+        return -1;
+
+    uint32_t depth = parent == TRANSFORM_NO_PARENT ? 0 : hierarchy->Depths[parent] + 1;
+    if (depth + 2 > hierarchy->DepthCapacity)
+    {
+        uint32_t depthCapacity = hierarchy->DepthCapacity ? hierarchy->DepthCapacity * 2 : 16;
+        uint32_t* depthOffsets = realloc(hierarchy->DepthOffsets, depthCapacity * sizeof(uint32_t));
+        if (depthOffsets == NULL)
+            return -1;
+        hierarchy->DepthOffsets = depthOffsets;
+        hierarchy->DepthCapacity = depthCapacity;
+    }
+
+    size_t node = hierarchy->Count++;
+    hierarchy->Parents[node] = parent;
+    hierarchy->Depths[node] = depth;
+    hierarchy->MaxDepth = depth > hierarchy->MaxDepth ? depth : hierarchy->MaxDepth;
+    hierarchy->FirstChild[node] = -1;
+    hierarchy->NextSibling[node] = -1;
+    if (parent != TRANSFORM_NO_PARENT)
+    {
+        hierarchy->NextSibling[node] = hierarchy->FirstChild[parent];
+        hierarchy->FirstChild[parent] = (int32_t)node;
+    }
+    glm_mat4_copy(local, hierarchy->LocalMatrices[node]);
+    hierarchy->LocalDirty[node] = 1;
+    hierarchy->DirtyQueue[hierarchy->DirtyRootCount++] = (uint32_t)node;
+
+    return (int32_t)node;
+}
+
+void TransformHierarchy_SetLocal(TransformHierarchy* hierarchy, uint32_t node, mat4 local)
+{
+    glm_mat4_copy(local, hierarchy->LocalMatrices[node]);
+    if (hierarchy->LocalDirty[node])
+        return;
+    hierarchy->LocalDirty[node] = 1;
+    hierarchy->DirtyQueue[hierarchy->DirtyRootCount++] = node;
+}
+
+static void UpdateWorldTask(void* userData, size_t begin, size_t end)
+{
+    TransformTaskData* data = userData;
+    TransformHierarchy* hierarchy = data->Hierarchy;
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        uint32_t node = data->Nodes[i];
+        int32_t parent = hierarchy->Parents[node];
+        if (parent == TRANSFORM_NO_PARENT)
+        {
+            glm_mat4_copy(hierarchy->LocalMatrices[node], hierarchy->WorldMatrices[node]);
+        }
+        else
+        {
+            glm_mat4_mul(hierarchy->WorldMatrices[parent], hierarchy->LocalMatrices[node],
+                         hierarchy->WorldMatrices[node]);
+        }
+    }
+}
+
+static void UpdateMvpTask(void* userData, size_t begin, size_t end)
+{
+    TransformTaskData* data = userData;
+    TransformHierarchy* hierarchy = data->Hierarchy;
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        size_t node = data->Nodes ? data->Nodes[i] : i;
+        glm_mat4_mul(hierarchy->ViewProjection, hierarchy->WorldMatrices[node], hierarchy->MvpMatrices[node]);
+    }
+}
+
+void TransformHierarchy_Update(TransformHierarchy* hierarchy, mat4 viewProjection)
+{
+    size_t count = hierarchy->Count;
+    if (count == 0)
+        return;
+
+    uint32_t levelCount = hierarchy->MaxDepth + 1;
+    uint32_t* depthOffsets = hierarchy->DepthOffsets;
+    uint32_t* queue = hierarchy->DirtyQueue;
+
+    // Extend the queue with the subtrees of the changed nodes. Marking a node as it's queued
+    // keeps it in the queue once, when an ancestor of it changed as well.
+    size_t dirtyCount = hierarchy->DirtyRootCount;
+    for (size_t i = 0; i < dirtyCount; ++i)
+        hierarchy->WorldDirty[queue[i]] = 1;
+    memset(depthOffsets, 0, (levelCount + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < dirtyCount; ++i)
+    {
+        uint32_t node = queue[i];
+        hierarchy->LocalDirty[node] = 0;
+        depthOffsets[hierarchy->Depths[node] + 1]++;
+        for (int32_t child = hierarchy->FirstChild[node]; child >= 0; child = hierarchy->NextSibling[child])
+        {
+            if (hierarchy->WorldDirty[child])
+                continue;
+            hierarchy->WorldDirty[child] = 1;
+            queue[dirtyCount++] = (uint32_t)child;
+        }
+    }
+    hierarchy->DirtyRootCount = 0;
+
+    for (uint32_t d = 0; d < levelCount; ++d)
+        depthOffsets[d + 1] += depthOffsets[d];
+
+    // Bucket the dirty nodes by depth, reusing the offsets as write cursors
+    for (size_t i = 0; i < dirtyCount; ++i)
+    {
+        uint32_t node = queue[i];
+        hierarchy->WorldDirty[node] = 0;
+        hierarchy->DirtyNodes[depthOffsets[hierarchy->Depths[node]]++] = node;
+    }
+    for (uint32_t d = levelCount; d > 0; --d)
+        depthOffsets[d] = depthOffsets[d - 1];
+    depthOffsets[0] = 0;
+
+    // A level only depends on the previous ones
+    TransformTaskData data = { hierarchy, NULL };
+    for (uint32_t d = 0; d < levelCount; ++d)
+    {
+        data.Nodes = &hierarchy->DirtyNodes[depthOffsets[d]];
+        ParallelFor(depthOffsets[d + 1] - depthOffsets[d], TRANSFORM_GRAIN, UpdateWorldTask, &data);
+    }
+
+    bool viewProjectionChanged = !hierarchy->ViewProjectionValid ||
+        memcmp(hierarchy->ViewProjection, viewProjection, sizeof(mat4)) != 0;
+    if (viewProjectionChanged)
+    {
+        glm_mat4_copy(viewProjection, hierarchy->ViewProjection);
+        hierarchy->ViewProjectionValid = true;
+
+        data.Nodes = NULL;
+        ParallelFor(count, TRANSFORM_GRAIN, UpdateMvpTask, &data);
+    }
+    else
+    {
+        data.Nodes = hierarchy->DirtyNodes;
+        ParallelFor(dirtyCount, TRANSFORM_GRAIN, UpdateMvpTask, &data);
+    }
+
+    hierarchy->LastUpdatedCount = dirtyCount;
+}
+
+void TransformHierarchy_UpdateNaive(TransformHierarchy* hierarchy, mat4 viewProjection)
+{
+    for (size_t i = 0; i < hierarchy->Count; ++i)
+    {
+        int32_t parent = hierarchy->Parents[i];
+        if (parent == TRANSFORM_NO_PARENT)
+            glm_mat4_copy(hierarchy->LocalMatrices[i], hierarchy->WorldMatrices[i]);
+        else
+            glm_mat4_mul(hierarchy->WorldMatrices[parent], hierarchy->LocalMatrices[i], hierarchy->WorldMatrices[i]);
+
+        glm_mat4_mul(viewProjection, hierarchy->WorldMatrices[i], hierarchy->MvpMatrices[i]);
+        hierarchy->LocalDirty[i] = 0;
+    }
+    hierarchy->DirtyRootCount = 0;
+
+    glm_mat4_copy(viewProjection, hierarchy->ViewProjection);
+    hierarchy->ViewProjectionValid = true;
+    hierarchy->LastUpdatedCount = hierarchy->Count;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+#define TRANSFORM_NO_PARENT (-1)
+
+// Structure-of-arrays transform hierarchy. Nodes are stored in topological order,
+// a parent always has a lower index than its children.
+typedef struct TransformHierarchy
+{
+    size_t Count;
+    size_t Capacity;
+    int32_t* Parents;
+    uint32_t* Depths;
+    mat4* LocalMatrices;
+    mat4* WorldMatrices;
+    mat4* MvpMatrices;
+    uint8_t* LocalDirty;
+    // Children of every node as a linked list, -1 ends it
+    int32_t* FirstChild;
+    int32_t* NextSibling;
+
+    // Nodes whose local matrix changed since the last update, the update extends the queue
+    // with their subtrees so it only visits the dirty nodes
+    uint32_t* DirtyQueue;
+    size_t DirtyRootCount;
+
+    // Update scratch, dirty nodes bucketed by depth
+    uint8_t* WorldDirty;
+    uint32_t* DirtyNodes;
+    uint32_t* DepthOffsets;
+    uint32_t DepthCapacity;
+    uint32_t MaxDepth;
+
+    mat4 ViewProjection;
+    bool ViewProjectionValid;
+
+    // Number of world matrices recomputed by the last update
+    size_t LastUpdatedCount;
+} TransformHierarchy;
+
+bool TransformHierarchy_Create(TransformHierarchy* hierarchy, size_t capacity);
+void TransformHierarchy_Destroy(TransformHierarchy* hierarchy);
+
+// Returns the node index or -1 on allocation failure. The parent must already exist.
+int32_t TransformHierarchy_AddNode(TransformHierarchy* hierarchy, int32_t parent, mat4 local);
+void TransformHierarchy_SetLocal(TransformHierarchy* hierarchy, uint32_t node, mat4 local);
+
+// Recomputes the world matrices of the dirty subtrees level by level across the workers,
+// then the MVP matrices of the changed nodes, or of every node when the view-projection changed.
+// With the same view-projection the cost follows the number of dirty nodes, not of all nodes.
+void TransformHierarchy_Update(TransformHierarchy* hierarchy, mat4 viewProjection);
+
+// Reference update recomputing every node with one glm_mat4_mul per matrix, serially
+void TransformHierarchy_UpdateNaive(TransformHierarchy* hierarchy, mat4 viewProjection);
@@ -0,0 +1,506 @@
+#include "vertex_format.h"
+#include "simd.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNORM16_MAX 65535.0f
+#define SNORM16_MAX 32767.0f
+#define HALF_ONE 0x3C00
+
+#define STREAM_AT(type, base, stride, i) ((type*)((const uint8_t*)(base) + (stride) * (i)))
+
+static uint32_t GetPositionSize(PositionFormat format)
+{
+    return format == POSITION_FORMAT_FLOAT32 ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
+}
+
+static uint32_t GetColorSize(ColorFormat format)
+{
+    return format == COLOR_FORMAT_FLOAT32 ? 3 * sizeof(float) : 4 * sizeof(uint8_t);
+}
+
+static uint32_t GetNormalSize(NormalFormat format)
+{
+    switch (format)
+    {
+        case NORMAL_FORMAT_FLOAT32: return 3 * sizeof(float);
+        case NORMAL_FORMAT_OCT16: return 2 * sizeof(int16_t);
+        default: return 0;
+    }
+}
+
+uint32_t VertexLayout_GetStride(const VertexLayout* layout)
+{
+    return GetPositionSize(layout->Position) +
+           GetColorSize(layout->Color) +
+           GetNormalSize(layout->Normal);
+}
+
+// Round-to-nearest-even conversion, see F. Giesen "half_float.cpp"
+uint16_t FloatToHalf(float value)
+{
+    const uint32_t f32Infinity = 255u << 23;
+    const uint32_t f16Max = (127u + 16u) << 23;
+    const uint32_t denormMagicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint16_t result;
+    if (bits >= f16Max)
+    {
+        // Infinity or NaN
+        result = bits > f32Infinity ? 0x7E00 : 0x7C00;
+    }
+    else if (bits < (113u << 23))
+    {
+        // Denormal or zero, let the FPU do the rounding
+        float denormMagic;
+        float f;
+        memcpy(&denormMagic, &denormMagicBits, sizeof(float));
+        memcpy(&f, &bits, sizeof(float));
+        f += denormMagic;
+        memcpy(&bits, &f, sizeof(float));
+        result = (uint16_t)(bits - denormMagicBits);
+    }
+    else
+    {
+        uint32_t mantissaOdd = (bits >> 13) & 1;
+        bits += ((uint32_t)(15 - 127) << 23) + 0xFFF;
+        bits += mantissaOdd;
+        result = (uint16_t)(bits >> 13);
+    }
+
+    return result | (uint16_t)(sign >> 16);
+}
+
+float HalfToFloat(uint16_t value)
+{
+    const uint32_t shiftedExponent = 0x7C00u << 13;
+    const uint32_t magicBits = 113u << 23;
+
+    uint32_t bits = (value & 0x7FFFu) << 13;
+    uint32_t exponent = shiftedExponent & bits;
+    bits += (127u - 15u) << 23;
+
+    float result;
+    if (exponent == shiftedExponent)
+    {
+        // Infinity or NaN
+        bits += (128u - 16u) << 23;
+        memcpy(&result, &bits, sizeof(float));
+    }
+    else if (exponent == 0)
+    {
+        // Denormal or zero
+        float magic;
+        memcpy(&magic, &magicBits, sizeof(float));
+        bits += 1u << 23;
+        memcpy(&result, &bits, sizeof(float));
+        result -= magic;
+    }
+    else
+    {
+        memcpy(&result, &bits, sizeof(float));
+    }
+
+    return (value & 0x8000) ? -result : result;
+}
+
+static float SignNotZero(float value)
+{
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+static int16_t ToSnorm16(float value)
+{
+    value = fminf(fmaxf(value, -1.0f), 1.0f);
+    return (int16_t)lrintf(value * SNORM16_MAX);
+}
+
+void EncodeOctahedral(const float normal[3], int16_t encoded[2])
+{
+    float l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    l1 = l1 > 0.0f ? l1 : 1.0f;
+    float x = normal[0] / l1;
+    float y = normal[1] / l1;
+
+    // Fold the lower hemisphere over the diagonals
+    if (normal[2] < 0.0f)
+    {
+        float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+        float foldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    encoded[0] = ToSnorm16(x);
+    encoded[1] = ToSnorm16(y);
+}
+
+void DecodeOctahedral(const int16_t encoded[2], float normal[3])
+{
+    float x = fmaxf(encoded[0] / SNORM16_MAX, -1.0f);
+    float y = fmaxf(encoded[1] / SNORM16_MAX, -1.0f);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    float t = fmaxf(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+
+    float length = sqrtf(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+void QuantizePositionsUnorm16(const float* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                              size_t count, const float offset[3], const float invScale[3])
+{
+#if defined(HD_SSE2)
+    // The fourth lane carries w = 1.0
+    const __m128 vOffset = _mm_setr_ps(offset[0], offset[1], offset[2], 0.0f);
+    const __m128 vScale = _mm_setr_ps(invScale[0] * UNORM16_MAX, invScale[1] * UNORM16_MAX,
+                                      invScale[2] * UNORM16_MAX, UNORM16_MAX);
+    const __m128 vZero = _mm_setzero_ps();
+    const __m128 vMax = _mm_set1_ps(UNORM16_MAX);
+    const __m128i vBias = _mm_set1_epi32(32768);
+    const __m128i vSignFlip = _mm_set1_epi16((short)0x8000);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* p = STREAM_AT(const float, src, srcStride, i);
+        __m128 v = _mm_setr_ps(p[0], p[1], p[2], 1.0f);
+        v = _mm_mul_ps(_mm_sub_ps(v, vOffset), vScale);
+        v = _mm_min_ps(_mm_max_ps(v, vZero), vMax);
+
+        // SSE2 has no unsigned 32->16 pack, go through the signed one with a bias
+        __m128i q = _mm_sub_epi32(_mm_cvtps_epi32(v), vBias);
+        q = _mm_xor_si128(_mm_packs_epi32(q, q), vSignFlip);
+        _mm_storel_epi64((__m128i*)(dst + dstStride * i), q);
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* p = STREAM_AT(const float, src, srcStride, i);
+        uint16_t* q = (uint16_t*)(dst + dstStride * i);
+        for (int c = 0; c < 3; ++c)
+        {
+            float v = (p[c] - offset[c]) * invScale[c];
+            v = fminf(fmaxf(v, 0.0f), 1.0f);
+            q[c] = (uint16_t)lrintf(v * UNORM16_MAX);
+        }
+        q[3] = (uint16_t)UNORM16_MAX;
+    }
+#endif
+}
+
+void QuantizePositionsFloat16(const float* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                              size_t count, const float offset[3], const float invScale[3])
+{
+#if defined(HD_F16C)
+    const __m128 vOffset = _mm_setr_ps(offset[0], offset[1], offset[2], 0.0f);
+    const __m128 vScale = _mm_setr_ps(invScale[0], invScale[1], invScale[2], 1.0f);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* p = STREAM_AT(const float, src, srcStride, i);
+        __m128 v = _mm_setr_ps(p[0], p[1], p[2], 1.0f);
+        v = _mm_mul_ps(_mm_sub_ps(v, vOffset), vScale);
+        _mm_storel_epi64((__m128i*)(dst + dstStride * i), _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* p = STREAM_AT(const float, src, srcStride, i);
+        uint16_t* q = (uint16_t*)(dst + dstStride * i);
+        for (int c = 0; c < 3; ++c)
+        {
+            q[c] = FloatToHalf((p[c] - offset[c]) * invScale[c]);
+        }
+        q[3] = HALF_ONE;
+    }
+#endif
+}
+
+void QuantizeColorsUnorm8(const float* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                          size_t count)
+{
+#if defined(HD_SSE2)
+    const __m128 vZero = _mm_setzero_ps();
+    const __m128 vOne = _mm_set1_ps(1.0f);
+    const __m128 vScale = _mm_set1_ps(255.0f);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* c = STREAM_AT(const float, src, srcStride, i);
+        __m128 v = _mm_setr_ps(c[0], c[1], c[2], 1.0f);
+        v = _mm_mul_ps(_mm_min_ps(_mm_max_ps(v, vZero), vOne), vScale);
+
+        __m128i q = _mm_cvtps_epi32(v);
+        q = _mm_packs_epi32(q, q);
+        q = _mm_packus_epi16(q, q);
+        uint32_t packed = (uint32_t)_mm_cvtsi128_si32(q);
+        memcpy(dst + dstStride * i, &packed, sizeof(packed));
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* c = STREAM_AT(const float, src, srcStride, i);
+        uint8_t* q = dst + dstStride * i;
+        for (int k = 0; k < 3; ++k)
+        {
+            q[k] = (uint8_t)lrintf(fminf(fmaxf(c[k], 0.0f), 1.0f) * 255.0f);
+        }
+        q[3] = 255;
+    }
+#endif
+}
+
+void EncodeNormalsOct16(const float* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                        size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        int16_t encoded[2];
+        EncodeOctahedral(STREAM_AT(const float, src, srcStride, i), encoded);
+        memcpy(dst + dstStride * i, encoded, sizeof(encoded));
+    }
+}
+
+static void DecodePosition(const QuantizedMesh* mesh, const uint8_t* vertex, float position[3])
+{
+    switch (mesh->Layout.Position)
+    {
+        case POSITION_FORMAT_FLOAT32:
+            memcpy(position, vertex, 3 * sizeof(float));
+            return;
+        case POSITION_FORMAT_UNORM16:
+        {
+            uint16_t q[3];
+            memcpy(q, vertex, sizeof(q));
+            for (int c = 0; c < 3; ++c)
+            {
+                position[c] = mesh->DequantizeOffset[c] + mesh->DequantizeScale[c] * (q[c] / UNORM16_MAX);
+            }
+            return;
+        }
+        case POSITION_FORMAT_FLOAT16:
+        {
+            uint16_t q[3];
+            memcpy(q, vertex, sizeof(q));
+            for (int c = 0; c < 3; ++c)
+            {
+                position[c] = mesh->DequantizeOffset[c] + mesh->DequantizeScale[c] * HalfToFloat(q[c]);
+            }
+            return;
+        }
+        default:
+            position[0] = position[1] = position[2] = 0.0f;
+            return;
+    }
+}
+
+static void DecodeColor(const QuantizedMesh* mesh, const uint8_t* vertex, float color[3])
+{
+    if (mesh->Layout.Color == COLOR_FORMAT_FLOAT32)
+    {
+        memcpy(color, vertex, 3 * sizeof(float));
+        return;
+    }
+
+    for (int c = 0; c < 3; ++c)
+    {
+        color[c] = vertex[c] / 255.0f;
+    }
+}
+
+static void MeasureErrors(const MeshStreams* streams, QuantizedMesh* mesh)
+{
+    uint32_t colorOffset = GetPositionSize(mesh->Layout.Position);
+    uint32_t normalOffset = colorOffset + GetColorSize(mesh->Layout.Color);
+
+    double squaredErrorSum = 0.0;
+    float maxPositionError = 0.0f;
+    float maxColorError = 0.0f;
+    float maxNormalAngle = 0.0f;
+
+    for (size_t i = 0; i < mesh->VertexCount; ++i)
+    {
+        const uint8_t* vertex = mesh->Data + (size_t)mesh->Stride * i;
+
+        float position[3];
+        DecodePosition(mesh, vertex, position);
+        const float* sourcePosition = STREAM_AT(const float, streams->Positions, streams->PositionStride, i);
+        float dx = position[0] - sourcePosition[0];
+        float dy = position[1] - sourcePosition[1];
+        float dz = position[2] - sourcePosition[2];
+        float squaredError = dx * dx + dy * dy + dz * dz;
+        squaredErrorSum += squaredError;
+        maxPositionError = fmaxf(maxPositionError, sqrtf(squaredError));
+
+        float color[3];
+        DecodeColor(mesh, vertex + colorOffset, color);
+        const float* sourceColor = STREAM_AT(const float, streams->Colors, streams->ColorStride, i);
+        for (int c = 0; c < 3; ++c)
+        {
+            float clamped = fminf(fmaxf(sourceColor[c], 0.0f), 1.0f);
+            maxColorError = fmaxf(maxColorError, fabsf(color[c] - clamped));
+        }
+
+        if (mesh->Layout.Normal == NORMAL_FORMAT_OCT16)
+        {
+            int16_t encoded[2];
+            float normal[3];
+            memcpy(encoded, vertex + normalOffset, sizeof(encoded));
+            DecodeOctahedral(encoded, normal);
+
+            const float* n = STREAM_AT(const float, streams->Normals, streams->NormalStride, i);
+            float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length > 0.0f)
+            {
+                // The acos of the dot loses the small angles to the rounding, the cross keeps them
+                float cx = normal[1] * n[2] - normal[2] * n[1];
+                float cy = normal[2] * n[0] - normal[0] * n[2];
+                float cz = normal[0] * n[1] - normal[1] * n[0];
+                float dot = normal[0] * n[0] + normal[1] * n[1] + normal[2] * n[2];
+                maxNormalAngle = fmaxf(maxNormalAngle, atan2f(sqrtf(cx * cx + cy * cy + cz * cz), dot));
+            }
+        }
+    }
+
+    mesh->Stats.MaxPositionError = maxPositionError;
+    mesh->Stats.RmsPositionError = mesh->VertexCount ? (float)sqrt(squaredErrorSum / mesh->VertexCount) : 0.0f;
+    mesh->Stats.MaxColorError = maxColorError;
+    mesh->Stats.MaxNormalErrorDegrees = maxNormalAngle * (180.0f / 3.14159265f);
+}
+
+bool QuantizeMesh(const MeshStreams* streams, const VertexLayout* layout, QuantizedMesh* mesh)
+{
+    memset(mesh, 0, sizeof(*mesh));
+    if (streams->Positions == NULL || streams->Colors == NULL ||
+        (layout->Normal != NORMAL_FORMAT_NONE && streams->Normals == NULL))
+    {
+        return false;
+    }
+
+    mesh->Layout = *layout;
+    mesh->Stride = VertexLayout_GetStride(layout);
+    mesh->VertexCount = streams->VertexCount;
+    mesh->Data = malloc((size_t)mesh->Stride * streams->VertexCount);
+    if (mesh->Data == NULL)
+    {
+        return false;
+    }
+
+    // Bounding box of the positions drives the dequantization transform
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t i = 0; i < streams->VertexCount; ++i)
+    {
+        const float* p = STREAM_AT(const float, streams->Positions, streams->PositionStride, i);
+        for (int c = 0; c < 3; ++c)
+        {
+            minimum[c] = fminf(minimum[c], p[c]);
+            maximum[c] = fmaxf(maximum[c], p[c]);
+        }
+    }
+
+    float invScale[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        float extent = streams->VertexCount ? maximum[c] - minimum[c] : 0.0f;
+        extent = extent > 0.0f ? extent : 1.0f;
+
+        switch (layout->Position)
+        {
+            case POSITION_FORMAT_FLOAT32:
+                mesh->DequantizeOffset[c] = 0.0f;
+                mesh->DequantizeScale[c] = 1.0f;
+                break;
+            case POSITION_FORMAT_UNORM16:
+                // [min, max] -> [0, 1]
+                mesh->DequantizeOffset[c] = streams->VertexCount ? minimum[c] : 0.0f;
+                mesh->DequantizeScale[c] = extent;
+                break;
+            case POSITION_FORMAT_FLOAT16:
+                // [min, max] -> [-1, 1], keeps the half precision centered on the mesh
+                mesh->DequantizeOffset[c] = streams->VertexCount ? 0.5f * (minimum[c] + maximum[c]) : 0.0f;
+                mesh->DequantizeScale[c] = 0.5f * extent;
+                break;
+        }
+        invScale[c] = 1.0f / mesh->DequantizeScale[c];
+    }
+
+    uint8_t* positions = mesh->Data;
+    switch (layout->Position)
+    {
+        case POSITION_FORMAT_FLOAT32:
+            for (size_t i = 0; i < streams->VertexCount; ++i)
+            {
+                memcpy(positions + (size_t)mesh->Stride * i,
+                       STREAM_AT(const float, streams->Positions, streams->PositionStride, i),
+                       3 * sizeof(float));
+            }
+            break;
+        case POSITION_FORMAT_UNORM16:
+            QuantizePositionsUnorm16(streams->Positions, streams->PositionStride, positions, mesh->Stride,
+                                     streams->VertexCount, mesh->DequantizeOffset, invScale);
+            break;
+        case POSITION_FORMAT_FLOAT16:
+            QuantizePositionsFloat16(streams->Positions, streams->PositionStride, positions, mesh->Stride,
+                                     streams->VertexCount, mesh->DequantizeOffset, invScale);
+            break;
+    }
+
+    uint8_t* colors = positions + GetPositionSize(layout->Position);
+    if (layout->Color == COLOR_FORMAT_FLOAT32)
+    {
+        for (size_t i = 0; i < streams->VertexCount; ++i)
+        {
+            memcpy(colors + (size_t)mesh->Stride * i,
+                   STREAM_AT(const float, streams->Colors, streams->ColorStride, i),
+                   3 * sizeof(float));
+        }
+    }
+    else
+    {
+        QuantizeColorsUnorm8(streams->Colors, streams->ColorStride, colors, mesh->Stride,
+                             streams->VertexCount);
+    }
+
+    uint8_t* normals = colors + GetColorSize(layout->Color);
+    if (layout->Normal == NORMAL_FORMAT_FLOAT32)
+    {
+        for (size_t i = 0; i < streams->VertexCount; ++i)
+        {
+            memcpy(normals + (size_t)mesh->Stride * i,
+                   STREAM_AT(const float, streams->Normals, streams->NormalStride, i),
+                   3 * sizeof(float));
+        }
+    }
+    else if (layout->Normal == NORMAL_FORMAT_OCT16)
+    {
+        EncodeNormalsOct16(streams->Normals, streams->NormalStride, normals, mesh->Stride,
+                           streams->VertexCount);
+    }
+
+    VertexLayout sourceLayout = { POSITION_FORMAT_FLOAT32, COLOR_FORMAT_FLOAT32,
+        layout->Normal == NORMAL_FORMAT_NONE ? NORMAL_FORMAT_NONE : NORMAL_FORMAT_FLOAT32 };
+    mesh->Stats.SourceBytes = (size_t)VertexLayout_GetStride(&sourceLayout) * streams->VertexCount;
+    mesh->Stats.QuantizedBytes = (size_t)mesh->Stride * streams->VertexCount;
+    MeasureErrors(streams, mesh);
+
+    return true;
+}
+
+void QuantizedMesh_Release(QuantizedMesh* mesh)
+{
+    free(mesh->Data);
+    mesh->Data = NULL;
+    mesh->VertexCount = 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Storage format of the vertex position
+typedef enum PositionFormat
+{
+    POSITION_FORMAT_FLOAT32, // R32G32B32_FLOAT, 12 bytes
+    POSITION_FORMAT_UNORM16, // R16G16B16A16_UNORM, 8 bytes, needs the dequantization transform
+    POSITION_FORMAT_FLOAT16, // R16G16B16A16_FLOAT, 8 bytes, needs the dequantization transform
+} PositionFormat;
+
+// Storage format of the vertex color
+typedef enum ColorFormat
+{
+    COLOR_FORMAT_FLOAT32, // R32G32B32_FLOAT, 12 bytes
+    COLOR_FORMAT_UNORM8,  // R8G8B8A8_UNORM, 4 bytes
+} ColorFormat;
+
+// Storage format of the vertex normal
+typedef enum NormalFormat
+{
+    NORMAL_FORMAT_NONE,
+    NORMAL_FORMAT_FLOAT32, // R32G32B32_FLOAT, 12 bytes
+    NORMAL_FORMAT_OCT16,   // R16G16_SNORM octahedral encoding, 4 bytes
+} NormalFormat;
+
+typedef struct VertexLayout
+{
+    PositionFormat Position;
+    ColorFormat Color;
+    NormalFormat Normal;
+} VertexLayout;
+
+// Source vertex attributes, strides are in bytes. Normals are optional.
+typedef struct MeshStreams
+{
+    const float* Positions;
+    size_t PositionStride;
+    const float* Colors;
+    size_t ColorStride;
+    const float* Normals;
+    size_t NormalStride;
+    size_t VertexCount;
+} MeshStreams;
+
+typedef struct QuantizationStats
+{
+    // Size of the same mesh stored with all-float32 attributes
+    size_t SourceBytes;
+    size_t QuantizedBytes;
+    // Errors measured by decoding the quantized data back
+    float MaxPositionError;
+    float RmsPositionError;
+    float MaxColorError;
+    float MaxNormalErrorDegrees;
+} QuantizationStats;
+
+typedef struct QuantizedMesh
+{
+    VertexLayout Layout;
+    uint8_t* Data;
+    uint32_t Stride;
+    size_t VertexCount;
+    // Object space position = DequantizeOffset + DequantizeScale * stored position
+    float DequantizeScale[3];
+    float DequantizeOffset[3];
+    QuantizationStats Stats;
+} QuantizedMesh;
+
+uint32_t VertexLayout_GetStride(const VertexLayout* layout);
+
+// Quantizes the mesh into a single interleaved stream matching the layout.
+// The attributes are stored in Position, Color, Normal order.
+bool QuantizeMesh(const MeshStreams* streams, const VertexLayout* layout, QuantizedMesh* mesh);
+void QuantizedMesh_Release(QuantizedMesh* mesh);
+
+// Kernels, exposed for the benchmarks
+void QuantizePositionsUnorm16(const float* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                              size_t count, const float offset[3], const float invScale[3]);
+void QuantizePositionsFloat16(const float* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                              size_t count, const float offset[3], const float invScale[3]);
+void QuantizeColorsUnorm8(const float* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                          size_t count);
+void EncodeNormalsOct16(const float* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+                        size_t count);
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+void EncodeOctahedral(const float normal[3], int16_t encoded[2]);
+void DecodeOctahedral(const int16_t encoded[2], float normal[3]);
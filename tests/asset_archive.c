@@ -0,0 +1,217 @@
+// Archives written and opened again: every entry is found and reads back, compressed or
+// stored, and files that are truncated or point past their end fail to open
+
+#include "asset_archive.h"
+#include "test.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define ENTRY_COUNT 100
+#define MAX_ENTRY_SIZE 20000
+#define ARCHIVE_PATH "test-asset_archive.pak"
+#define DAMAGED_PATH "test-asset_archive-damaged.pak"
+// Of the header before the table of contents
+#define HEADER_SIZE 24
+#define HEADER_SLOT_COUNT 8
+#define HEADER_NAMES_SIZE 16
+
+static uint8_t g_Entries[ENTRY_COUNT][MAX_ENTRY_SIZE];
+static size_t g_Sizes[ENTRY_COUNT];
+static uint8_t g_Read[MAX_ENTRY_SIZE];
+static uint8_t g_File[ENTRY_COUNT * MAX_ENTRY_SIZE * 2];
+static size_t g_FileSize;
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static void GetName(char* name, size_t size, int i)
+{
+    snprintf(name, size, "textures/%s/%03d.dds", i % 2 ? "props" : "level", i);
+}
+
+// Compressible, incompressible and empty entries, every fourth one stored as it is
+static bool WriteArchive(void)
+{
+    AssetArchiveWriter writer;
+    AssetArchiveWriter_Create(&writer);
+    uint32_t random = 1;
+    bool added = true;
+    for (int i = 0; i < ENTRY_COUNT; ++i)
+    {
+        g_Sizes[i] = i == 0 ? 0 : NextRandom(&random) % MAX_ENTRY_SIZE;
+        for (size_t x = 0; x < g_Sizes[i]; ++x)
+            g_Entries[i][x] = i % 3 == 0 ? (uint8_t)NextRandom(&random) : (uint8_t)(x / 7 + i);
+        char name[64];
+        GetName(name, sizeof(name), i);
+        added = added && AssetArchiveWriter_Add(&writer, name, g_Entries[i], g_Sizes[i],
+                                                i % 4 == 0 ? ASSET_CODEC_NONE : ASSET_CODEC_LZ4);
+    }
+    added = added && !AssetArchiveWriter_Add(&writer, "textures/level/000.dds", g_Entries[1], 10, ASSET_CODEC_LZ4);
+    bool saved = added && AssetArchiveWriter_Save(&writer, ARCHIVE_PATH);
+    AssetArchiveWriter_Destroy(&writer);
+
+    FILE* file = fopen(ARCHIVE_PATH, "rb");
+    g_FileSize = file != NULL ? fread(g_File, 1, sizeof(g_File), file) : 0;
+    if (file != NULL)
+        fclose(file);
+    return saved && g_FileSize > 0;
+}
+
+static bool WriteDamaged(const uint8_t* data, size_t size)
+{
+    FILE* file = fopen(DAMAGED_PATH, "wb");
+    if (file == NULL)
+        return false;
+    bool written = size == 0 || fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+static bool OpensDamaged(const uint8_t* data, size_t size)
+{
+    AssetArchive archive;
+    CHECK(WriteDamaged(data, size));
+    bool opened = AssetArchive_Open(DAMAGED_PATH, &archive);
+    if (opened)
+        AssetArchive_Close(&archive);
+    return opened;
+}
+
+static void TestRoundTrip(void)
+{
+    AssetArchive archive;
+    CHECK(AssetArchive_Open(ARCHIVE_PATH, &archive));
+    CHECK(archive.EntryCount == ENTRY_COUNT);
+    CHECK(archive.SlotCount > ENTRY_COUNT * 2 && (archive.SlotCount & (archive.SlotCount - 1)) == 0);
+
+    bool found = true;
+    bool read = true;
+    bool compressed = false;
+    for (int i = 0; i < ENTRY_COUNT; ++i)
+    {
+        char name[64];
+        GetName(name, sizeof(name), i);
+        const AssetEntry* entry = AssetArchive_Find(&archive, name);
+        found = found && entry != NULL && entry->Size == g_Sizes[i] && strcmp(AssetArchive_GetName(&archive, entry), name) == 0;
+        if (entry == NULL)
+            continue;
+
+        // Stored on request, or when compressing doesn't pay
+        if (i % 4 == 0 || i % 3 == 0)
+            found = found && entry->Codec == ASSET_CODEC_NONE && entry->CompressedSize == entry->Size;
+        compressed = compressed || entry->Codec == ASSET_CODEC_LZ4;
+        memset(g_Read, 0xAB, sizeof(g_Read));
+        read = read && AssetArchive_Read(&archive, entry, g_Read) && memcmp(g_Read, g_Entries[i], g_Sizes[i]) == 0;
+    }
+    CHECK(found);
+    CHECK(read);
+    CHECK(compressed);
+    CHECK(AssetArchive_Find(&archive, "textures/level/100.dds") == NULL);
+    CHECK(AssetArchive_Find(&archive, "") == NULL);
+    AssetArchive_Close(&archive);
+
+    CHECK(!AssetArchive_Open("test-asset_archive-missing.pak", &archive));
+}
+
+// Cut inside the header, the table of contents, the names and the blobs
+static void TestTruncated(void)
+{
+    AssetArchive archive;
+    CHECK(AssetArchive_Open(ARCHIVE_PATH, &archive));
+    size_t tableSize = (size_t)archive.SlotCount * sizeof(AssetEntry);
+    size_t namesEnd = HEADER_SIZE + tableSize + archive.NamesSize;
+    AssetArchive_Close(&archive);
+
+    size_t sizes[] = { 0, 3, HEADER_SIZE - 1, HEADER_SIZE, HEADER_SIZE + tableSize / 2, HEADER_SIZE + tableSize,
+                       namesEnd - 1, namesEnd, namesEnd + 1, g_FileSize / 2, g_FileSize - 1 };
+    bool rejected = true;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+        rejected = rejected && !OpensDamaged(g_File, sizes[i]);
+    CHECK(rejected);
+    CHECK(OpensDamaged(g_File, g_FileSize));
+}
+
+// Headers and entries that ask for more than the file holds
+static void TestOutOfBounds(void)
+{
+    static uint8_t damaged[sizeof(g_File)];
+    AssetArchive archive;
+    CHECK(AssetArchive_Open(ARCHIVE_PATH, &archive));
+    char name[64];
+    GetName(name, sizeof(name), 5);
+    const AssetEntry* entry = AssetArchive_Find(&archive, name);
+    CHECK(entry != NULL);
+    if (entry == NULL)
+    {
+        AssetArchive_Close(&archive);
+        return;
+    }
+    size_t slot = HEADER_SIZE + (size_t)(entry - archive.Slots) * sizeof(AssetEntry);
+    AssetEntry original = *entry;
+    AssetArchive_Close(&archive);
+
+    // The last byte of the entry a byte past the end, and offsets that wrap when added
+    static const uint64_t offsets[] = { 0, UINT64_MAX - 10, UINT64_MAX };
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); ++i)
+    {
+        memcpy(damaged, g_File, g_FileSize);
+        uint64_t offset = i == 0 ? g_FileSize - original.CompressedSize + 1 : offsets[i];
+        memcpy(damaged + slot + offsetof(AssetEntry, Offset), &offset, sizeof(offset));
+        CHECK(!OpensDamaged(damaged, g_FileSize));
+    }
+    memcpy(damaged, g_File, g_FileSize);
+    uint32_t compressedSize = UINT32_MAX;
+    memcpy(damaged + slot + offsetof(AssetEntry, CompressedSize), &compressedSize, sizeof(compressedSize));
+    CHECK(!OpensDamaged(damaged, g_FileSize));
+
+    // A table of contents or names larger than the file
+    uint32_t slotCount = 1u << 30;
+    memcpy(damaged, g_File, g_FileSize);
+    memcpy(damaged + HEADER_SLOT_COUNT, &slotCount, sizeof(slotCount));
+    CHECK(!OpensDamaged(damaged, g_FileSize));
+    uint32_t namesSize = UINT32_MAX;
+    memcpy(damaged, g_File, g_FileSize);
+    memcpy(damaged + HEADER_NAMES_SIZE, &namesSize, sizeof(namesSize));
+    CHECK(!OpensDamaged(damaged, g_FileSize));
+
+    // Another magic
+    memcpy(damaged, g_File, g_FileSize);
+    damaged[0] ^= 1;
+    CHECK(!OpensDamaged(damaged, g_FileSize));
+}
+
+// A changed byte in a blob opens, the read fails on the checksum
+static void TestCorruptBlob(void)
+{
+    static uint8_t damaged[sizeof(g_File)];
+    memcpy(damaged, g_File, g_FileSize);
+    damaged[g_FileSize - 1] ^= 0x40;
+    CHECK(WriteDamaged(damaged, g_FileSize));
+
+    AssetArchive archive;
+    CHECK(AssetArchive_Open(DAMAGED_PATH, &archive));
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < archive.SlotCount; ++i)
+    {
+        const AssetEntry* entry = &archive.Slots[i];
+        if (entry->NameHash != 0 && !AssetArchive_Read(&archive, entry, g_Read))
+            failed++;
+    }
+    CHECK(failed == 1);
+    AssetArchive_Close(&archive);
+}
+
+int main(void)
+{
+    CHECK(WriteArchive());
+    TestRoundTrip();
+    TestTruncated();
+    TestOutOfBounds();
+    TestCorruptBlob();
+    remove(DAMAGED_PATH);
+    remove(ARCHIVE_PATH);
+    return TEST_RESULT();
+}
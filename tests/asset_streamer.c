@@ -0,0 +1,219 @@
+// The streamer over a written archive: every request completes once with the bytes of its
+// entry, requests queued behind a busy decoder are decoded by priority and first come first
+// served within one, and destroying the streamer completes what it dropped
+
+#include "asset_streamer.h"
+#include "test.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#define ENTRY_COUNT 64
+#define ENTRY_SIZE 4096
+#define ARCHIVE_PATH "test-asset_streamer.pak"
+#define GATE_NAME "gate"
+
+static uint8_t g_Entries[ENTRY_COUNT][ENTRY_SIZE];
+
+typedef struct StreamContext
+{
+    // The gate entry waits in its stage until opened, keeping the single decoder busy
+    atomic_bool GateStaged;
+    atomic_bool GateOpen;
+    // Requests whose stage returns NULL
+    const AssetEntry* Dropped;
+    uint32_t CompletedCount;
+    uint32_t LoadedCount;
+    uint32_t WrongCount;
+    // Request data in the order they completed
+    uintptr_t Order[ENTRY_COUNT + 1];
+} StreamContext;
+
+static void GetName(char* name, size_t size, int i)
+{
+    snprintf(name, size, "meshes/%02d.bin", i);
+}
+
+static bool WriteArchive(void)
+{
+    AssetArchiveWriter writer;
+    AssetArchiveWriter_Create(&writer);
+    bool added = true;
+    for (int i = 0; i < ENTRY_COUNT; ++i)
+    {
+        for (size_t x = 0; x < ENTRY_SIZE; ++x)
+            g_Entries[i][x] = (uint8_t)(x / 5 + i * 7);
+        char name[32];
+        GetName(name, sizeof(name), i);
+        added = added && AssetArchiveWriter_Add(&writer, name, g_Entries[i], ENTRY_SIZE, ASSET_CODEC_LZ4);
+    }
+    added = added && AssetArchiveWriter_Add(&writer, GATE_NAME, g_Entries[0], 16, ASSET_CODEC_NONE);
+    bool saved = added && AssetArchiveWriter_Save(&writer, ARCHIVE_PATH);
+    AssetArchiveWriter_Destroy(&writer);
+    return saved;
+}
+
+static void* Stage(void* context, const AssetEntry* entry, void* requestData)
+{
+    (void)requestData;
+    StreamContext* stream = context;
+    if (entry == stream->Dropped)
+        return NULL;
+    if (entry->Size == 16)
+    {
+        atomic_store(&stream->GateStaged, true);
+        while (!atomic_load(&stream->GateOpen))
+            thrd_yield();
+    }
+    return malloc(entry->Size);
+}
+
+// Request data is the index of the entry, ENTRY_COUNT for the gate
+static void Complete(void* context, const AssetEntry* entry, void* destination, bool loaded, void* requestData)
+{
+    StreamContext* stream = context;
+    uintptr_t index = (uintptr_t)requestData;
+    if (stream->CompletedCount < ENTRY_COUNT + 1)
+        stream->Order[stream->CompletedCount] = index;
+    stream->CompletedCount++;
+    stream->LoadedCount += loaded;
+    if (loaded && index < ENTRY_COUNT &&
+        (entry->Size != ENTRY_SIZE || memcmp(destination, g_Entries[index], ENTRY_SIZE) != 0))
+        stream->WrongCount++;
+    free(destination);
+}
+
+static void ResetContext(StreamContext* stream)
+{
+    memset(stream, 0, sizeof(*stream));
+    atomic_init(&stream->GateStaged, false);
+    atomic_init(&stream->GateOpen, true);
+}
+
+static bool Request(AssetStreamer* streamer, int i, AssetPriority priority)
+{
+    char name[32];
+    GetName(name, sizeof(name), i);
+    return AssetStreamer_Request(streamer, name, priority, (void*)(uintptr_t)i);
+}
+
+static void PollAll(AssetStreamer* streamer)
+{
+    while (AssetStreamer_GetPendingCount(streamer) > 0)
+    {
+        AssetStreamer_Poll(streamer);
+        thrd_yield();
+    }
+}
+
+// Every entry with several decoders, one of them dropped by its stage
+static void TestCompletion(const AssetArchive* archive)
+{
+    StreamContext stream;
+    ResetContext(&stream);
+    char name[32];
+    GetName(name, sizeof(name), 7);
+    stream.Dropped = AssetArchive_Find(archive, name);
+
+    AssetStreamer streamer;
+    CHECK(AssetStreamer_Create(&streamer, archive, 3, Stage, Complete, &stream));
+    bool requested = true;
+    for (int i = 0; i < ENTRY_COUNT; ++i)
+        requested = requested && Request(&streamer, i, (AssetPriority)(i % ASSET_PRIORITY_COUNT));
+    CHECK(requested);
+    CHECK(!AssetStreamer_Request(&streamer, "meshes/missing.bin", ASSET_PRIORITY_HIGH, NULL));
+    CHECK(!Request(&streamer, 0, ASSET_PRIORITY_COUNT));
+    CHECK(!Request(&streamer, 0, (AssetPriority)-1));
+
+    PollAll(&streamer);
+    CHECK(stream.CompletedCount == ENTRY_COUNT);
+    CHECK(stream.LoadedCount == ENTRY_COUNT - 1);
+    CHECK(stream.WrongCount == 0);
+    AssetStreamer_Destroy(&streamer);
+}
+
+// All bytes of the requests read, they wait for the decoder in their queues
+static void WaitForReads(AssetStreamer* streamer, size_t bytes)
+{
+    for (;;)
+    {
+        mtx_lock(&streamer->Mutex);
+        bool read = streamer->BufferedBytes == bytes;
+        mtx_unlock(&streamer->Mutex);
+        if (read)
+            return;
+        thrd_yield();
+    }
+}
+
+static void TestPriorities(const AssetArchive* archive)
+{
+    StreamContext stream;
+    ResetContext(&stream);
+    atomic_store(&stream.GateOpen, false);
+
+    AssetStreamer streamer;
+    CHECK(AssetStreamer_Create(&streamer, archive, 1, Stage, Complete, &stream));
+    CHECK(AssetStreamer_Request(&streamer, GATE_NAME, ASSET_PRIORITY_LOW, (void*)(uintptr_t)ENTRY_COUNT));
+    while (!atomic_load(&stream.GateStaged))
+        thrd_yield();
+
+    static const AssetPriority priorities[] = {
+        ASSET_PRIORITY_LOW, ASSET_PRIORITY_NORMAL, ASSET_PRIORITY_HIGH, ASSET_PRIORITY_LOW,
+        ASSET_PRIORITY_HIGH, ASSET_PRIORITY_NORMAL, ASSET_PRIORITY_HIGH, ASSET_PRIORITY_LOW
+    };
+    size_t count = sizeof(priorities) / sizeof(priorities[0]);
+    size_t bytes = AssetArchive_Find(archive, GATE_NAME)->CompressedSize;
+    for (size_t i = 0; i < count; ++i)
+    {
+        CHECK(Request(&streamer, (int)i, priorities[i]));
+        char name[32];
+        GetName(name, sizeof(name), (int)i);
+        bytes += AssetArchive_Find(archive, name)->CompressedSize;
+    }
+    WaitForReads(&streamer, bytes);
+    atomic_store(&stream.GateOpen, true);
+    PollAll(&streamer);
+
+    static const uintptr_t expected[] = { ENTRY_COUNT, 2, 4, 6, 1, 5, 0, 3, 7 };
+    CHECK(stream.CompletedCount == count + 1 && stream.LoadedCount == count + 1);
+    CHECK(memcmp(stream.Order, expected, sizeof(expected)) == 0);
+    AssetStreamer_Destroy(&streamer);
+}
+
+// Requests still queued when it's destroyed complete without their data
+static void TestDestroy(const AssetArchive* archive)
+{
+    StreamContext stream;
+    ResetContext(&stream);
+    atomic_store(&stream.GateOpen, false);
+
+    AssetStreamer streamer;
+    CHECK(AssetStreamer_Create(&streamer, archive, 1, Stage, Complete, &stream));
+    CHECK(AssetStreamer_Request(&streamer, GATE_NAME, ASSET_PRIORITY_HIGH, (void*)(uintptr_t)ENTRY_COUNT));
+    while (!atomic_load(&stream.GateStaged))
+        thrd_yield();
+    bool requested = true;
+    for (int i = 0; i < ENTRY_COUNT; ++i)
+        requested = requested && Request(&streamer, i, ASSET_PRIORITY_NORMAL);
+    CHECK(requested);
+    CHECK(AssetStreamer_GetPendingCount(&streamer) == ENTRY_COUNT + 1);
+
+    atomic_store(&stream.GateOpen, true);
+    AssetStreamer_Destroy(&streamer);
+    CHECK(stream.CompletedCount == ENTRY_COUNT + 1);
+    CHECK(stream.LoadedCount >= 1 && stream.WrongCount == 0);
+}
+
+int main(void)
+{
+    CHECK(WriteArchive());
+    AssetArchive archive;
+    CHECK(AssetArchive_Open(ARCHIVE_PATH, &archive));
+    TestCompletion(&archive);
+    TestPriorities(&archive);
+    TestDestroy(&archive);
+    AssetArchive_Close(&archive);
+    remove(ARCHIVE_PATH);
+    return TEST_RESULT();
+}
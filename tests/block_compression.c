@@ -0,0 +1,129 @@
+// Round trips of the BC encoders: every format decodes back above its PSNR floor on images of
+// every shape, blocks over the edges included, and the decoder rejects what it can't read
+
+#include "block_compression.h"
+#include "parallel.h"
+#include "test.h"
+
+#include <math.h>
+#include <string.h>
+
+#define MAX_SIZE 256
+
+typedef struct FormatFloor
+{
+    TextureFormat Format;
+    // Lowest PSNR in dB over the stored channels, a little under what the encoder reaches. The
+    // smallest images are the hardest, their gradients are the steepest.
+    double Psnr;
+} FormatFloor;
+
+static const FormatFloor g_Floors[] = {
+    { TEXTURE_FORMAT_BC1, 30.0 },
+    { TEXTURE_FORMAT_BC3, 31.0 },
+    { TEXTURE_FORMAT_BC5, 48.0 },
+    { TEXTURE_FORMAT_BC7, 27.0 },
+};
+
+static uint8_t g_Image[MAX_SIZE * MAX_SIZE * 4];
+static uint8_t g_Decoded[MAX_SIZE * MAX_SIZE * 4];
+static uint8_t g_Blocks[MAX_SIZE * MAX_SIZE];
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// Smooth gradients in every channel with a little noise, like a photo with an alpha mask
+static void CreateImage(uint32_t width, uint32_t height, size_t rowPitch)
+{
+    uint32_t random = 1;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint8_t* texel = &g_Image[y * rowPitch + x * 4];
+            int noise = (int)(NextRandom(&random) % 7) - 3;
+            texel[0] = (uint8_t)(128.0f + 90.0f * sinf(x * 0.07f) + noise);
+            texel[1] = (uint8_t)(128.0f + 90.0f * cosf(y * 0.05f) - noise);
+            texel[2] = (uint8_t)((x + y) * 200 / (width + height) + 20);
+            texel[3] = (uint8_t)(255 - x * 200 / width);
+        }
+    }
+}
+
+static double RoundTrip(TextureFormat format, uint32_t width, uint32_t height)
+{
+    size_t rowPitch = (size_t)width * 4;
+    CreateImage(width, height, rowPitch);
+    memset(g_Decoded, 0, sizeof(g_Decoded));
+    CHECK(TextureFormat_GetRowPitch(format, width) * TextureFormat_GetRowCount(format, height) <= sizeof(g_Blocks));
+    CHECK(CompressImage(g_Image, width, height, rowPitch, format, g_Blocks));
+    CHECK(DecompressImage(g_Blocks, format, width, height, g_Decoded, rowPitch));
+    return ComputePsnr(g_Image, g_Decoded, width, height, rowPitch, GetStoredChannelMask(format));
+}
+
+// Square, wide, tall and sizes that leave partial blocks on the right and at the bottom
+static void TestRoundTrip(void)
+{
+    static const uint32_t sizes[][2] = { { 256, 256 }, { 64, 16 }, { 13, 7 }, { 5, 3 }, { 1, 1 }, { 2, 9 }, { 131, 67 } };
+    for (size_t f = 0; f < sizeof(g_Floors) / sizeof(g_Floors[0]); ++f)
+    {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+        {
+            double psnr = RoundTrip(g_Floors[f].Format, sizes[s][0], sizes[s][1]);
+            CHECK(psnr >= g_Floors[f].Psnr);
+        }
+    }
+}
+
+// A single color is stored exactly, apart from the rounding of BC1 to 565
+static void TestSolidColor(void)
+{
+    uint32_t width = 12;
+    uint32_t height = 12;
+    size_t rowPitch = (size_t)width * 4;
+    for (size_t i = 0; i < width * height; ++i)
+        memcpy(&g_Image[i * 4], (uint8_t[4]){ 200, 100, 50, 255 }, 4);
+
+    for (size_t f = 0; f < sizeof(g_Floors) / sizeof(g_Floors[0]); ++f)
+    {
+        TextureFormat format = g_Floors[f].Format;
+        CHECK(CompressImage(g_Image, width, height, rowPitch, format, g_Blocks));
+        CHECK(DecompressImage(g_Blocks, format, width, height, g_Decoded, rowPitch));
+        bool close = true;
+        for (size_t i = 0; i < width * height * 4; ++i)
+        {
+            if (GetStoredChannelMask(format) & (1u << (i % 4)))
+                close = close && abs(g_Image[i] - g_Decoded[i]) <= 4;
+        }
+        CHECK(close);
+    }
+}
+
+static void TestRejected(void)
+{
+    CHECK(!CompressImage(g_Image, 4, 4, 16, TEXTURE_FORMAT_RGBA8, g_Blocks));
+    CHECK(!CompressImage(g_Image, 0, 4, 0, TEXTURE_FORMAT_BC1, g_Blocks));
+    CHECK(!DecompressImage(g_Blocks, TEXTURE_FORMAT_RGBA8, 4, 4, g_Decoded, 16));
+
+    // Mode 6 is the only one written, a mode 0 block decodes to transparent black
+    uint8_t block[16] = { 0x01, 0xFF, 0xFF, 0xFF };
+    memset(g_Decoded, 0xAB, 64);
+    CHECK(!DecompressImage(block, TEXTURE_FORMAT_BC7, 4, 4, g_Decoded, 16));
+    bool black = true;
+    for (size_t i = 0; i < 64; ++i)
+        black = black && g_Decoded[i] == 0;
+    CHECK(black);
+}
+
+int main(void)
+{
+    CHECK(Parallel_Initialise(3));
+    TestRoundTrip();
+    TestSolidColor();
+    TestRejected();
+    Parallel_Shutdown();
+    return TEST_RESULT();
+}
@@ -0,0 +1,531 @@
+// Command captures recorded, written, parsed and replayed into the null sink: the commands read
+// back equal the recorded ones, a changed argument shows in a diff of two captures, and captures
+// that are truncated or corrupt are rejected
+
+#include "command_stream.h"
+#include "null_backend.h"
+#include "test.h"
+
+#include <string.h>
+
+#define CAPTURE_PATH "test-command_stream.cap"
+#define CHANGED_PATH "test-command_stream-changed.cap"
+#define DAMAGED_PATH "test-command_stream-damaged.cap"
+#define FRAME_COUNT 40
+#define MAX_COMMANDS (FRAME_COUNT * 64)
+// Larger than the flush and the read buffers together
+#define MAX_WRITE_SIZE (700 * 1024)
+#define MAX_FILE_SIZE (4 * 1024 * 1024)
+// Of the magic and the version
+#define HEADER_SIZE 8
+
+// Stand-ins for the objects, the stream only numbers their addresses
+static uint8_t g_Objects[16];
+// Every frame writes from another offset into it
+static uint8_t g_WriteData[MAX_WRITE_SIZE + FRAME_COUNT];
+static Command g_Commands[MAX_COMMANDS];
+static uint32_t g_CommandCount;
+static uint8_t g_File[MAX_FILE_SIZE];
+static size_t g_FileSize;
+static uint8_t g_Damaged[MAX_FILE_SIZE];
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// Cleared so whole commands compare
+static Command* Add(CommandOpcode opcode)
+{
+    Command* command = &g_Commands[g_CommandCount++];
+    memset(command, 0, sizeof(*command));
+    command->Opcode = opcode;
+    return command;
+}
+
+// Field by field, a compound literal may leave its padding set
+static void SetAddress(CommandAddress* address, uint32_t object, uint64_t offset)
+{
+    address->Object = object;
+    address->Offset = offset;
+}
+
+// Loading, then frames using every kind of command, a few with more data than the buffers hold
+static void CreateCommands(void)
+{
+    uint32_t random = 1;
+    for (size_t i = 0; i < sizeof(g_WriteData); ++i)
+        g_WriteData[i] = (uint8_t)NextRandom(&random);
+    g_CommandCount = 0;
+
+    Command* command = Add(COMMAND_CREATE_RESOURCE);
+    command->CreateResource.Resource = 9;
+    command->CreateResource.HeapType = 1;
+    command->CreateResource.Desc.Dimension = 4;
+    command->CreateResource.Desc.Width = 5000000000ull;
+    command->CreateResource.Desc.Height = 720;
+    command->CreateResource.Desc.DepthOrArraySize = 1;
+    command->CreateResource.Desc.MipLevels = 1;
+    command->CreateResource.Desc.Format = 40;
+    command->CreateResource.Desc.SampleCount = 1;
+    command->CreateResource.Desc.Flags = 2;
+    command->CreateResource.InitialState = 0x10;
+    command->CreateResource.HasClearValue = true;
+    command->CreateResource.ClearFormat = 40;
+    command->CreateResource.ClearValue[0] = 1.0f;
+    command = Add(COMMAND_CREATE_DEPTH_STENCIL_VIEW);
+    command->CreateDepthStencilView.Resource = 9;
+    SetAddress(&command->CreateDepthStencilView.View, 6, 32);
+
+    for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        Add(COMMAND_FRAME)->Frame = frame + (frame == 7 ? 1ull << 40 : 0);
+        Add(COMMAND_SET_LIST)->Object = 4;
+        Add(COMMAND_RESET_ALLOCATOR)->Object = 1 + frame % 3;
+        command = Add(COMMAND_RESET);
+        command->Reset.Allocator = 1 + frame % 3;
+        command->Reset.PipelineState = 8;
+        command = Add(COMMAND_RESOURCE_BARRIER);
+        command->Barriers.Count = 1 + frame % COMMAND_STREAM_MAX_ELEMENTS;
+        for (uint32_t i = 0; i < command->Barriers.Count; ++i)
+            command->Barriers.Barriers[i] = (CommandBarrier){ i % 3, 0, { 10 + i, i % 3 == 2 ? 11 + i : 0 }, 0xffffffff, { 0, 4 } };
+        command = Add(COMMAND_SET_DESCRIPTOR_HEAPS);
+        command->DescriptorHeaps.Count = 2;
+        command->DescriptorHeaps.Heaps[0] = 6;
+        command->DescriptorHeaps.Heaps[1] = 7;
+        Add(COMMAND_SET_GRAPHICS_ROOT_SIGNATURE)->Object = 5;
+        Add(COMMAND_SET_PIPELINE_STATE)->Object = 8;
+        Add(COMMAND_SET_PRIMITIVE_TOPOLOGY)->PrimitiveTopology = 4;
+        command = Add(COMMAND_SET_GRAPHICS_ROOT_TABLE);
+        command->RootArgument.Parameter = 1;
+        SetAddress(&command->RootArgument.Address, 7, frame * 64ull);
+        command = Add(COMMAND_SET_VERTEX_BUFFERS);
+        command->VertexBuffers.StartSlot = 1;
+        command->VertexBuffers.Count = 2;
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            CommandVertexBuffer* view = &command->VertexBuffers.Views[i];
+            SetAddress(&view->Location, i == 0 ? 12 : COMMAND_STREAM_NO_OBJECT, i == 0 ? 0 : 0xFFFF000012345678ull);
+            view->Size = i == 0 ? 4096 : 256;
+            view->Stride = i == 0 ? 24 : 16;
+        }
+        command = Add(COMMAND_SET_INDEX_BUFFER);
+        command->IndexBuffer.Bound = frame % 5 != 0;
+        SetAddress(&command->IndexBuffer.Location, 13, 128);
+        command->IndexBuffer.Size = 4096;
+        command->IndexBuffer.Format = 57;
+        command = Add(COMMAND_SET_VIEWPORTS);
+        command->Viewports.Count = 1;
+        command->Viewports.Viewports[0] = (CommandViewport){ 0.5f, -0.25f, 1280.0f, 720.0f, 0.0f, 1.0f };
+        command = Add(COMMAND_SET_SCISSOR_RECTS);
+        command->ScissorRects.Count = 1;
+        command->ScissorRects.Rects[0] = (CommandRect){ -16, -8, 1280, 720 };
+        command = Add(COMMAND_SET_RENDER_TARGETS);
+        command->RenderTargets.Count = 2;
+        command->RenderTargets.SingleHandle = true;
+        SetAddress(&command->RenderTargets.Views[0], 3, 0);
+        SetAddress(&command->RenderTargets.Views[1], 3, 32);
+        command->RenderTargets.HasDepthStencil = true;
+        SetAddress(&command->RenderTargets.DepthStencil, 6, 0);
+        command = Add(COMMAND_CLEAR_RENDER_TARGET);
+        SetAddress(&command->ClearRenderTarget.View, 3, 0);
+        command->ClearRenderTarget.Color[0] = 0.635f;
+        command->ClearRenderTarget.Color[3] = 1.0f;
+        command = Add(COMMAND_CLEAR_DEPTH_STENCIL);
+        SetAddress(&command->ClearDepthStencil.View, 6, 0);
+        command->ClearDepthStencil.Flags = 3;
+        command->ClearDepthStencil.Depth = 1.0f;
+        command->ClearDepthStencil.Stencil = 255;
+
+        for (uint32_t draw = 0; draw < 4; ++draw)
+        {
+            command = Add(COMMAND_SET_GRAPHICS_ROOT_CONSTANTS);
+            command->RootConstants.Count = draw == 3 ? COMMAND_STREAM_MAX_CONSTANTS : 16;
+            for (uint32_t i = 0; i < command->RootConstants.Count; ++i)
+                command->RootConstants.Values[i] = NextRandom(&random);
+            command = Add(COMMAND_DRAW_INDEXED);
+            command->DrawIndexed.IndexCount = 36;
+            command->DrawIndexed.InstanceCount = 1 + draw;
+            command->DrawIndexed.StartIndex = draw * 36;
+            command->DrawIndexed.BaseVertex = -(int32_t)draw;
+        }
+        command = Add(COMMAND_DRAW);
+        command->Draw.VertexCount = 3;
+        command->Draw.InstanceCount = 1;
+        Add(COMMAND_SET_COMPUTE_ROOT_SIGNATURE)->Object = 5;
+        command = Add(COMMAND_SET_COMPUTE_ROOT_CONSTANTS);
+        command->RootConstants.Parameter = 2;
+        command->RootConstants.Offset = 1;
+        command->RootConstants.Count = 0;
+        command = Add(COMMAND_SET_COMPUTE_ROOT_UAV);
+        command->RootArgument.Parameter = 3;
+        SetAddress(&command->RootArgument.Address, 12, 256);
+        command = Add(COMMAND_DISPATCH);
+        command->Dispatch.X = 64;
+        command->Dispatch.Y = frame;
+        command->Dispatch.Z = 1;
+        command = Add(COMMAND_EXECUTE_INDIRECT);
+        command->ExecuteIndirect.Signature = 14;
+        command->ExecuteIndirect.MaxCount = 1024;
+        command->ExecuteIndirect.Arguments = 12;
+        command->ExecuteIndirect.ArgumentOffset = 1ull << 33;
+        command->ExecuteIndirect.CountBuffer = 13;
+        command = Add(COMMAND_COPY_BUFFER);
+        command->CopyBuffer.Destination = 12;
+        command->CopyBuffer.Source = 13;
+        command->CopyBuffer.SourceOffset = frame;
+        command->CopyBuffer.Size = 1ull << 32;
+        command = Add(COMMAND_COPY_TEXTURE);
+        command->CopyTexture.Destination.Resource = 9;
+        command->CopyTexture.Destination.Subresource = 2;
+        CommandCopyLocation* footprint = &command->CopyTexture.Source;
+        footprint->Resource = 13;
+        footprint->Type = 1;
+        footprint->Offset = 512;
+        footprint->Format = 28;
+        footprint->Width = 64;
+        footprint->Height = 64;
+        footprint->Depth = 1;
+        footprint->RowPitch = 256;
+        command->CopyTexture.X = 8;
+        command->CopyTexture.HasBox = frame % 2 == 0;
+        for (int i = 0; i < 6 && command->CopyTexture.HasBox; ++i)
+            command->CopyTexture.Box[i] = i < 3 ? 0 : 16;
+        command = Add(COMMAND_WRITE_BUFFER);
+        command->WriteBuffer.Resource = 13;
+        command->WriteBuffer.Offset = frame * 4096ull;
+        // Sizes off the words, empty, and the largest
+        command->WriteBuffer.Size = frame == 3 ? MAX_WRITE_SIZE : frame % 4 == 1 ? 0 : 1 + NextRandom(&random) % 5000;
+        command->WriteBuffer.Data = g_WriteData + frame;
+        command = Add(COMMAND_END_QUERY);
+        command->Query.Heap = 15;
+        command->Query.Type = 2;
+        command->Query.Index = frame * 2;
+        command = Add(COMMAND_RESOLVE_QUERY);
+        command->ResolveQuery.Heap = 15;
+        command->ResolveQuery.Type = 2;
+        command->ResolveQuery.Count = 2;
+        command->ResolveQuery.Destination = 12;
+        command->ResolveQuery.DestinationOffset = 8;
+        Add(COMMAND_EXECUTE_BUNDLE)->Object = 11;
+        Add(COMMAND_CLOSE);
+        command = Add(COMMAND_EXECUTE_LISTS);
+        command->ExecuteLists.Queue = 0;
+        command->ExecuteLists.Count = 1;
+        command->ExecuteLists.Lists[0] = 4;
+        command = Add(COMMAND_PRESENT);
+        command->Present.SyncInterval = 1;
+    }
+}
+
+static bool WriteCapture(const char* path, const Command* changed, uint32_t changedIndex)
+{
+    CommandStream stream;
+    CHECK(CommandStream_Create(&stream));
+    bool opened = CommandStream_Open(&stream, path);
+    for (uint32_t i = 0; i < g_CommandCount; ++i)
+        CommandStream_Write(&stream, changed != NULL && i == changedIndex ? changed : &g_Commands[i]);
+    bool written = opened && stream.CommandCount == g_CommandCount && CommandStream_Close(&stream);
+    CommandStream_Destroy(&stream);
+    return written;
+}
+
+static bool ReadFile(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    g_FileSize = file != NULL ? fread(g_File, 1, sizeof(g_File), file) : 0;
+    if (file != NULL)
+        fclose(file);
+    return g_FileSize > HEADER_SIZE && g_FileSize < sizeof(g_File);
+}
+
+// The data of a write points into the reader's buffer, it's compared by its bytes
+static bool IsRecorded(Command* command, const Command* recorded)
+{
+    if (command->Opcode == COMMAND_WRITE_BUFFER && recorded->Opcode == COMMAND_WRITE_BUFFER)
+    {
+        if (command->WriteBuffer.Size != recorded->WriteBuffer.Size || command->WriteBuffer.Data == NULL ||
+            memcmp(command->WriteBuffer.Data, recorded->WriteBuffer.Data, recorded->WriteBuffer.Size) != 0)
+            return false;
+        command->WriteBuffer.Data = recorded->WriteBuffer.Data;
+    }
+    return memcmp(command, recorded, sizeof(*command)) == 0;
+}
+
+static void TestRoundTrip(void)
+{
+    CHECK(WriteCapture(CAPTURE_PATH, NULL, 0));
+    CHECK(ReadFile(CAPTURE_PATH));
+
+    CommandReader reader;
+    CHECK(CommandReader_Open(&reader, CAPTURE_PATH));
+    uint32_t count = 0;
+    bool equal = true;
+    Command command;
+    for (;;)
+    {
+        memset(&command, 0, sizeof(command));
+        if (!CommandReader_Next(&reader, &command))
+            break;
+        equal = equal && count < g_CommandCount && IsRecorded(&command, &g_Commands[count]);
+        count++;
+    }
+    CHECK(!reader.Failed && count == g_CommandCount && reader.CommandCount == count);
+    CHECK(equal);
+    CommandReader_Close(&reader);
+
+    // The null sink sees every command once
+    CommandCounts counts = { 0 };
+    CHECK(CommandReader_Open(&reader, CAPTURE_PATH));
+    CHECK(CommandReader_Replay(&reader, CommandCounts_Add, &counts));
+    CommandReader_Close(&reader);
+    CHECK(counts.Commands == g_CommandCount && counts.Frames == FRAME_COUNT);
+    CHECK(counts.Draws == FRAME_COUNT * (1 + 2 + 3 + 4 + 1));
+    CHECK(counts.Opcodes[COMMAND_DRAW_INDEXED] == FRAME_COUNT * 4 && counts.Opcodes[COMMAND_PRESENT] == FRAME_COUNT);
+    CHECK(strcmp(Command_GetName(COMMAND_DRAW_INDEXED), "DrawIndexedInstanced") == 0);
+    CHECK(strcmp(Command_GetName(COMMAND_OPCODE_COUNT), "Unknown") == 0);
+}
+
+// Walks two captures the way command-capture diff does, comparing the encoded commands
+static uint32_t CountDifferences(const char* first, const char* second, uint32_t* firstDifference)
+{
+    CommandReader readers[2];
+    CHECK(CommandReader_Open(&readers[0], first));
+    CHECK(CommandReader_Open(&readers[1], second));
+    uint32_t differences = 0;
+    for (uint32_t index = 0;; ++index)
+    {
+        Command commands[2];
+        bool read[2];
+        for (int i = 0; i < 2; ++i)
+            read[i] = CommandReader_Next(&readers[i], &commands[i]);
+        if (!read[0] && !read[1])
+            break;
+        bool differ = read[0] != read[1] || commands[0].Opcode != commands[1].Opcode ||
+                      readers[0].PayloadWords != readers[1].PayloadWords ||
+                      memcmp(readers[0].Payload, readers[1].Payload, readers[0].PayloadWords * sizeof(uint32_t)) != 0;
+        if (differ && differences++ == 0)
+            *firstDifference = index;
+    }
+    CHECK(!readers[0].Failed && !readers[1].Failed);
+    CommandReader_Close(&readers[0]);
+    CommandReader_Close(&readers[1]);
+    return differences;
+}
+
+// The start index of a draw in the middle of the capture changes
+static void TestDiff(void)
+{
+    uint32_t changedIndex = 0;
+    for (uint32_t i = g_CommandCount / 2; i < g_CommandCount && changedIndex == 0; ++i)
+        changedIndex = g_Commands[i].Opcode == COMMAND_DRAW_INDEXED ? i : 0;
+    Command changed = g_Commands[changedIndex];
+    changed.DrawIndexed.StartIndex++;
+
+    uint32_t firstDifference = UINT32_MAX;
+    CHECK(WriteCapture(CHANGED_PATH, NULL, 0));
+    CHECK(CountDifferences(CAPTURE_PATH, CHANGED_PATH, &firstDifference) == 0);
+    CHECK(WriteCapture(CHANGED_PATH, &changed, changedIndex));
+    CHECK(CountDifferences(CAPTURE_PATH, CHANGED_PATH, &firstDifference) == 1);
+    CHECK(firstDifference == changedIndex);
+}
+
+static bool WriteDamaged(const uint8_t* data, size_t size)
+{
+    FILE* file = fopen(DAMAGED_PATH, "wb");
+    if (file == NULL)
+        return false;
+    bool written = size == 0 || fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+// Whether the damaged capture opens and reads to its end, and how many commands it held
+static bool ReadsDamaged(const uint8_t* data, size_t size, uint64_t* count)
+{
+    CHECK(WriteDamaged(data, size));
+    CommandReader reader;
+    if (!CommandReader_Open(&reader, DAMAGED_PATH))
+        return false;
+    CommandCounts counts = { 0 };
+    bool read = CommandReader_Replay(&reader, CommandCounts_Add, &counts);
+    CommandReader_Close(&reader);
+    *count = counts.Commands;
+    return read;
+}
+
+static uint32_t GetWord(const uint8_t* data, size_t offset)
+{
+    uint32_t word;
+    memcpy(&word, data + offset, sizeof(word));
+    return word;
+}
+
+static void SetWord(uint8_t* data, size_t offset, uint32_t word)
+{
+    memcpy(data + offset, &word, sizeof(word));
+}
+
+// Offset of the header of a command
+static size_t FindCommand(uint32_t index)
+{
+    size_t offset = HEADER_SIZE;
+    for (uint32_t i = 0; i < index; ++i)
+        offset += sizeof(uint32_t) * (1 + (GetWord(g_File, offset) >> 8));
+    return offset;
+}
+
+static void TestMalformed(void)
+{
+    uint64_t count = 0;
+    CHECK(ReadsDamaged(g_File, g_FileSize, &count) && count == g_CommandCount);
+
+    // Cut inside the file header, after it, inside a command header, and inside the payloads
+    // of a draw and of the largest write. Cut between two commands it's a shorter capture.
+    CHECK(!ReadsDamaged(g_File, 0, &count));
+    CHECK(!ReadsDamaged(g_File, HEADER_SIZE - 1, &count));
+    CHECK(ReadsDamaged(g_File, HEADER_SIZE, &count) && count == 0);
+    uint32_t draw = 0;
+    uint32_t write = 0;
+    for (uint32_t i = 0; i < g_CommandCount; ++i)
+    {
+        draw = draw == 0 && g_Commands[i].Opcode == COMMAND_DRAW_INDEXED ? i : draw;
+        write = g_Commands[i].Opcode == COMMAND_WRITE_BUFFER && g_Commands[i].WriteBuffer.Size == MAX_WRITE_SIZE ? i : write;
+    }
+    size_t cuts[] = { FindCommand(draw) + 2, FindCommand(draw) + 8, FindCommand(write) + MAX_WRITE_SIZE / 2, g_FileSize - 1 };
+    bool rejected = true;
+    for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); ++i)
+        rejected = rejected && !ReadsDamaged(g_File, cuts[i], &count);
+    CHECK(rejected);
+    CHECK(ReadsDamaged(g_File, FindCommand(draw + 1), &count) && count == draw + 1);
+
+    // Another magic or version
+    for (size_t offset = 0; offset < HEADER_SIZE; offset += sizeof(uint32_t))
+    {
+        memcpy(g_Damaged, g_File, g_FileSize);
+        SetWord(g_Damaged, offset, GetWord(g_Damaged, offset) + 1);
+        CHECK(!ReadsDamaged(g_Damaged, g_FileSize, &count));
+    }
+
+    // Opcodes no command has
+    size_t offset = FindCommand(draw);
+    uint32_t header = GetWord(g_File, offset);
+    static const uint32_t opcodes[] = { 0, COMMAND_OPCODE_COUNT, 255 };
+    for (size_t i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); ++i)
+    {
+        memcpy(g_Damaged, g_File, g_FileSize);
+        SetWord(g_Damaged, offset, (header & ~0xFFu) | opcodes[i]);
+        CHECK(!ReadsDamaged(g_Damaged, g_FileSize, &count) && count == draw);
+    }
+
+    // A draw with a word less than it needs, and one more
+    memcpy(g_Damaged, g_File, g_FileSize);
+    SetWord(g_Damaged, offset, header - (1u << 8));
+    CHECK(!ReadsDamaged(g_Damaged, g_FileSize, &count) && count == draw);
+    memcpy(g_Damaged, g_File, g_FileSize);
+    SetWord(g_Damaged, offset, header + (1u << 8));
+    CHECK(!ReadsDamaged(g_Damaged, g_FileSize, &count) && count == draw);
+
+    // More words than the file holds
+    memcpy(g_Damaged, g_File, g_FileSize);
+    SetWord(g_Damaged, offset, header | 0xFFFFFF00u);
+    CHECK(!ReadsDamaged(g_Damaged, g_FileSize, &count));
+
+    // More barriers than a command carries, their count is the first word of the payload
+    uint32_t barrier = 0;
+    while (g_Commands[barrier].Opcode != COMMAND_RESOURCE_BARRIER)
+        barrier++;
+    memcpy(g_Damaged, g_File, g_FileSize);
+    SetWord(g_Damaged, FindCommand(barrier) + sizeof(uint32_t), COMMAND_STREAM_MAX_ELEMENTS + 1);
+    CHECK(!ReadsDamaged(g_Damaged, g_FileSize, &count) && count == barrier);
+
+    // A write larger than its payload
+    offset = FindCommand(write);
+    memcpy(g_Damaged, g_File, g_FileSize);
+    SetWord(g_Damaged, offset + 4 * sizeof(uint32_t), MAX_WRITE_SIZE + 4);
+    CHECK(!ReadsDamaged(g_Damaged, g_FileSize, &count));
+}
+
+// Frames of the null backend recorded and replayed, the sink counts the draws it submitted
+static void TestNullBackend(void)
+{
+    NullBackend backend;
+    CHECK(NullBackend_Create(&backend, CAPTURE_PATH));
+    NullMatrix viewProjection = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 0.5f, 0 }, { 0, 0, 0.5f, 1 } };
+    NullMatrix worlds[32];
+    for (uint32_t i = 0; i < 32; ++i)
+    {
+        memset(worlds[i], 0, sizeof(worlds[i]));
+        for (int j = 0; j < 4; ++j)
+            worlds[i][j][j] = 1.0f;
+        // Half of them far outside the frustum
+        worlds[i][3][0] = i % 2 ? 100.0f : 0.0f;
+    }
+    for (uint64_t frame = 0; frame < 10; ++frame)
+        NullBackend_SubmitFrame(&backend, frame, viewProjection, worlds, 32);
+    uint64_t submitted = backend.SubmittedDraws;
+    CHECK(submitted == 10 * 16 && backend.CulledInstances == 10 * 16);
+    CHECK(NullBackend_Destroy(&backend));
+
+    CommandReader reader;
+    CommandCounts counts = { 0 };
+    CHECK(CommandReader_Open(&reader, CAPTURE_PATH));
+    CHECK(CommandReader_Replay(&reader, CommandCounts_Add, &counts));
+    CommandReader_Close(&reader);
+    CHECK(counts.Frames == 10 && counts.Draws == submitted && counts.Opcodes[COMMAND_DRAW_INDEXED] == submitted);
+    CHECK(counts.Opcodes[COMMAND_PRESENT] == 10 && counts.Opcodes[COMMAND_SET_LIST] == 1);
+}
+
+// Ids follow the order objects are added in, addresses resolve into the ranges of the objects
+static void TestObjects(void)
+{
+    CommandStream stream;
+    CHECK(CommandStream_Create(&stream));
+    CHECK(!CommandStream_IsCapturing(&stream));
+    CHECK(CommandStream_GetObject(&stream, NULL) == COMMAND_STREAM_NO_OBJECT);
+    bool numbered = true;
+    for (uint32_t i = 0; i < 8; ++i)
+        numbered = numbered && CommandStream_AddObject(&stream, &g_Objects[i]) == i + 1;
+    CHECK(numbered);
+    CHECK(CommandStream_GetObject(&stream, &g_Objects[3]) == 4);
+    CHECK(CommandStream_GetObject(&stream, &g_Objects[8]) == 9);
+    CHECK(CommandStream_FindObject(&stream, 9) == &g_Objects[8] && CommandStream_FindObject(&stream, 1000) == NULL);
+    // A released object's memory taken by a new one
+    CHECK(CommandStream_AddObject(&stream, &g_Objects[3]) == 10 && CommandStream_GetObject(&stream, &g_Objects[3]) == 10);
+    CommandStream_BindObject(&stream, 700, &g_Objects[9]);
+    CHECK(CommandStream_GetObject(&stream, &g_Objects[9]) == 700 && CommandStream_FindObject(&stream, 700) == &g_Objects[9]);
+
+    CommandStream_AddRange(&stream, COMMAND_ADDRESS_GPU_VIRTUAL, 1, 0x10000, 0x1000);
+    CommandStream_AddRange(&stream, COMMAND_ADDRESS_GPU_VIRTUAL, 2, 0x20000, 0x1000);
+    CommandAddress address = CommandStream_Resolve(&stream, COMMAND_ADDRESS_GPU_VIRTUAL, 0x10010);
+    CHECK(address.Object == 1 && address.Offset == 0x10);
+    CHECK(CommandStream_Unresolve(&stream, COMMAND_ADDRESS_GPU_VIRTUAL, address) == 0x10010);
+    address = CommandStream_Resolve(&stream, COMMAND_ADDRESS_GPU_VIRTUAL, 0x11000);
+    CHECK(address.Object == COMMAND_STREAM_NO_OBJECT && address.Offset == 0x11000);
+    CHECK(CommandStream_Resolve(&stream, COMMAND_ADDRESS_CPU_DESCRIPTOR, 0x10010).Object == COMMAND_STREAM_NO_OBJECT);
+    // A range overlapping both replaces them
+    CommandStream_AddRange(&stream, COMMAND_ADDRESS_GPU_VIRTUAL, 3, 0x10800, 0x10000);
+    CHECK(stream.RangeCounts[COMMAND_ADDRESS_GPU_VIRTUAL] == 1);
+    CHECK(CommandStream_Resolve(&stream, COMMAND_ADDRESS_GPU_VIRTUAL, 0x20000).Object == 3);
+    CHECK(CommandStream_Resolve(&stream, COMMAND_ADDRESS_GPU_VIRTUAL, 0x10010).Object == COMMAND_STREAM_NO_OBJECT);
+
+    // Nothing is written while not capturing
+    Command command = { .Opcode = COMMAND_CLOSE };
+    CommandStream_Write(&stream, &command);
+    CHECK(stream.CommandCount == 0 && stream.Size == 0);
+    CommandStream_Destroy(&stream);
+}
+
+int main(void)
+{
+    CreateCommands();
+    TestRoundTrip();
+    TestDiff();
+    TestMalformed();
+    TestNullBackend();
+    TestObjects();
+    remove(DAMAGED_PATH);
+    remove(CHANGED_PATH);
+    remove(CAPTURE_PATH);
+    return TEST_RESULT();
+}
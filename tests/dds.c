@@ -0,0 +1,302 @@
+// The DDS parser on headers built in memory: legacy and DX10 headers of every format with their
+// mip chains, a save and load round trip, and the files it has to reject, truncated ones and
+// sizes or mip counts that would have the mips point past the end
+
+#include "dds.h"
+#include "test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAGIC 0x20534444u
+#define HEADER_SIZE 124
+#define DX10_HEADER_SIZE 20
+// Header fields as 32-bit words, after the magic
+#define FIELD_SIZE 0
+#define FIELD_FLAGS 1
+#define FIELD_HEIGHT 2
+#define FIELD_WIDTH 3
+#define FIELD_MIP_COUNT 6
+#define FIELD_PF_SIZE 18
+#define FIELD_PF_FLAGS 19
+#define FIELD_PF_FOURCC 20
+#define FIELD_PF_RGB_BIT_COUNT 21
+#define FIELD_PF_R_MASK 22
+#define FIELD_PF_G_MASK 23
+#define FIELD_PF_B_MASK 24
+#define FIELD_PF_A_MASK 25
+#define FIELD_CAPS2 27
+#define FLAG_MIP_COUNT 0x20000u
+#define PF_FOURCC 0x4u
+#define PF_RGB 0x40u
+#define CAPS2_CUBEMAP 0x200u
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+#define FOURCC_DX10 FOURCC('D', 'X', '1', '0')
+
+static uint8_t g_File[1 << 20];
+
+static void WriteWord(uint8_t* data, size_t word, uint32_t value)
+{
+    memcpy(data + word * sizeof(uint32_t), &value, sizeof(value));
+}
+
+// A header of the size and mip count, RGBA8 masks when fourCC is 0, the DX10 extension with the
+// DXGI format when it's DX10. Returns the offset of the first mip.
+static size_t WriteHeader(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t fourCC, uint32_t dxgiFormat)
+{
+    memset(g_File, 0, 4 + HEADER_SIZE + DX10_HEADER_SIZE);
+    WriteWord(g_File, 0, MAGIC);
+    uint8_t* header = g_File + 4;
+    WriteWord(header, FIELD_SIZE, HEADER_SIZE);
+    WriteWord(header, FIELD_FLAGS, 0x1007u | (mipCount != 1 ? FLAG_MIP_COUNT : 0));
+    WriteWord(header, FIELD_HEIGHT, height);
+    WriteWord(header, FIELD_WIDTH, width);
+    WriteWord(header, FIELD_MIP_COUNT, mipCount);
+    WriteWord(header, FIELD_PF_SIZE, 32);
+    if (fourCC == 0)
+    {
+        WriteWord(header, FIELD_PF_FLAGS, PF_RGB);
+        WriteWord(header, FIELD_PF_RGB_BIT_COUNT, 32);
+        WriteWord(header, FIELD_PF_R_MASK, 0x000000FFu);
+        WriteWord(header, FIELD_PF_G_MASK, 0x0000FF00u);
+        WriteWord(header, FIELD_PF_B_MASK, 0x00FF0000u);
+        WriteWord(header, FIELD_PF_A_MASK, 0xFF000000u);
+        return 4 + HEADER_SIZE;
+    }
+
+    WriteWord(header, FIELD_PF_FLAGS, PF_FOURCC);
+    WriteWord(header, FIELD_PF_FOURCC, fourCC);
+    if (fourCC != FOURCC_DX10)
+        return 4 + HEADER_SIZE;
+
+    uint8_t* extension = g_File + 4 + HEADER_SIZE;
+    WriteWord(extension, 0, dxgiFormat);
+    WriteWord(extension, 1, 3);
+    WriteWord(extension, 3, 1);
+    return 4 + HEADER_SIZE + DX10_HEADER_SIZE;
+}
+
+static size_t GetMipSize(TextureFormat format, uint32_t width, uint32_t height)
+{
+    if (format == TEXTURE_FORMAT_RGBA8)
+        return (size_t)width * height * 4;
+    size_t blockSize = format == TEXTURE_FORMAT_BC1 ? 8 : 16;
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
+
+// The mips follow each other after the header with the sizes of their levels. Returns the
+// size of the file, the mips filled with the number of their level.
+static size_t WriteMips(size_t offset, TextureFormat format, uint32_t width, uint32_t height, uint32_t mipCount)
+{
+    for (uint32_t i = 0; i < mipCount; ++i)
+    {
+        uint32_t mipWidth = width >> i > 0 ? width >> i : 1;
+        uint32_t mipHeight = height >> i > 0 ? height >> i : 1;
+        size_t size = GetMipSize(format, mipWidth, mipHeight);
+        memset(g_File + offset, (int)i, size);
+        offset += size;
+    }
+    return offset;
+}
+
+static bool CheckMips(const DdsTexture* texture, size_t offset, uint32_t width, uint32_t height, uint32_t mipCount)
+{
+    bool valid = texture->Width == width && texture->Height == height && texture->MipCount == mipCount;
+    for (uint32_t i = 0; valid && i < mipCount; ++i)
+    {
+        const DdsMip* mip = &texture->Mips[i];
+        uint32_t mipWidth = width >> i > 0 ? width >> i : 1;
+        uint32_t mipHeight = height >> i > 0 ? height >> i : 1;
+        size_t size = GetMipSize(texture->Format, mipWidth, mipHeight);
+        valid = mip->Width == mipWidth && mip->Height == mipHeight && mip->SlicePitch == size &&
+                mip->Data == g_File + offset && mip->Data[0] == i && mip->Data[size - 1] == i;
+        offset += size;
+    }
+    return valid;
+}
+
+// Odd sizes, so the blocks of the smaller levels cover fewer texels than they hold
+static void TestLegacy(void)
+{
+    static const struct
+    {
+        uint32_t FourCC;
+        TextureFormat Format;
+    } formats[] = {
+        { FOURCC('D', 'X', 'T', '1'), TEXTURE_FORMAT_BC1 },
+        { FOURCC('D', 'X', 'T', '5'), TEXTURE_FORMAT_BC3 },
+        { FOURCC('A', 'T', 'I', '2'), TEXTURE_FORMAT_BC5 },
+        { FOURCC('B', 'C', '5', 'U'), TEXTURE_FORMAT_BC5 },
+        { 0, TEXTURE_FORMAT_RGBA8 },
+    };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+    {
+        size_t offset = WriteHeader(67, 30, 7, formats[f].FourCC, 0);
+        size_t size = WriteMips(offset, formats[f].Format, 67, 30, 7);
+        DdsTexture texture;
+        CHECK(Dds_Parse(g_File, size, &texture));
+        CHECK(texture.Format == formats[f].Format && !texture.Srgb);
+        CHECK(CheckMips(&texture, offset, 67, 30, 7));
+    }
+
+    // Without the mip count flag there is a single level
+    size_t offset = WriteHeader(16, 16, 1, FOURCC('D', 'X', 'T', '1'), 0);
+    DdsTexture texture;
+    CHECK(Dds_Parse(g_File, WriteMips(offset, TEXTURE_FORMAT_BC1, 16, 16, 1), &texture));
+    CHECK(CheckMips(&texture, offset, 16, 16, 1));
+
+    // Unknown four character codes and masks
+    WriteHeader(16, 16, 1, FOURCC('D', 'X', 'T', '3'), 0);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(16, 16, 1, 0, 0);
+    WriteWord(g_File + 4, FIELD_PF_R_MASK, 0x00FF0000u);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+}
+
+static void TestDx10(void)
+{
+    static const struct
+    {
+        uint32_t DxgiFormat;
+        TextureFormat Format;
+        bool Srgb;
+    } formats[] = {
+        { 28, TEXTURE_FORMAT_RGBA8, false }, { 29, TEXTURE_FORMAT_RGBA8, true },
+        { 71, TEXTURE_FORMAT_BC1, false },   { 72, TEXTURE_FORMAT_BC1, true },
+        { 77, TEXTURE_FORMAT_BC3, false },   { 78, TEXTURE_FORMAT_BC3, true },
+        { 83, TEXTURE_FORMAT_BC5, false },   { 98, TEXTURE_FORMAT_BC7, false },
+        { 99, TEXTURE_FORMAT_BC7, true },
+    };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+    {
+        size_t offset = WriteHeader(128, 5, 8, FOURCC_DX10, formats[f].DxgiFormat);
+        size_t size = WriteMips(offset, formats[f].Format, 128, 5, 8);
+        DdsTexture texture;
+        CHECK(Dds_Parse(g_File, size, &texture));
+        CHECK(texture.Format == formats[f].Format && texture.Srgb == formats[f].Srgb);
+        CHECK(CheckMips(&texture, offset, 128, 5, 8));
+    }
+
+    // Formats without a texture format, arrays and cube maps
+    DdsTexture texture;
+    WriteHeader(16, 16, 1, FOURCC_DX10, 2);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(16, 16, 1, FOURCC_DX10, 71);
+    WriteWord(g_File + 4 + HEADER_SIZE, 3, 2);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(16, 16, 1, FOURCC_DX10, 71);
+    WriteWord(g_File + 4 + HEADER_SIZE, 2, 0x4u);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(16, 16, 1, FOURCC('D', 'X', 'T', '1'), 0);
+    WriteWord(g_File + 4, FIELD_CAPS2, CAPS2_CUBEMAP);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+}
+
+// Every size short of the whole file fails, the headers included
+static void TestTruncated(void)
+{
+    static const uint32_t fourCCs[] = { FOURCC('D', 'X', 'T', '5'), FOURCC_DX10 };
+    for (size_t f = 0; f < sizeof(fourCCs) / sizeof(fourCCs[0]); ++f)
+    {
+        size_t offset = WriteHeader(33, 17, 6, fourCCs[f], 77);
+        size_t size = WriteMips(offset, TEXTURE_FORMAT_BC3, 33, 17, 6);
+        DdsTexture texture;
+        CHECK(Dds_Parse(g_File, size, &texture));
+        bool rejected = true;
+        for (size_t truncated = 0; truncated < size; ++truncated)
+            rejected = rejected && !Dds_Parse(g_File, truncated, &texture);
+        CHECK(rejected);
+    }
+
+    DdsTexture texture;
+    WriteHeader(16, 16, 1, FOURCC('D', 'X', 'T', '1'), 0);
+    WriteWord(g_File, 0, FOURCC('D', 'D', 'S', '_'));
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(16, 16, 1, FOURCC('D', 'X', 'T', '1'), 0);
+    WriteWord(g_File + 4, FIELD_SIZE, HEADER_SIZE - 4);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+}
+
+// Sizes whose level sizes wrapped to 0 used to parse with the mips past the end of the file
+static void TestDimensions(void)
+{
+    DdsTexture texture;
+    WriteHeader(1u << 31, 1u << 31, 1, 0, 0);
+    CHECK(!Dds_Parse(g_File, 4 + HEADER_SIZE, &texture));
+    WriteHeader(0xFFFFFFFEu, 4, 1, FOURCC('D', 'X', 'T', '1'), 0);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(4, 0xFFFFFFFFu, 1, FOURCC_DX10, 98);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(0, 16, 1, FOURCC('D', 'X', 'T', '1'), 0);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(16, 0, 1, FOURCC('D', 'X', 'T', '1'), 0);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+
+    // The largest texture of D3D12 fits, a texel more doesn't
+    size_t offset = WriteHeader(DDS_MAX_DIMENSION, 4, 1, FOURCC('D', 'X', 'T', '1'), 0);
+    size_t size = WriteMips(offset, TEXTURE_FORMAT_BC1, DDS_MAX_DIMENSION, 4, 1);
+    CHECK(Dds_Parse(g_File, size, &texture));
+    WriteHeader(DDS_MAX_DIMENSION + 1, 4, 1, FOURCC('D', 'X', 'T', '1'), 0);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(4, DDS_MAX_DIMENSION + 1, 1, FOURCC('D', 'X', 'T', '1'), 0);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+}
+
+// At most the levels down to 1x1, log2 of the larger side plus one
+static void TestMipCount(void)
+{
+    DdsTexture texture;
+    size_t offset = WriteHeader(64, 8, 7, FOURCC('D', 'X', 'T', '1'), 0);
+    CHECK(Dds_Parse(g_File, WriteMips(offset, TEXTURE_FORMAT_BC1, 64, 8, 7), &texture));
+    CHECK(CheckMips(&texture, offset, 64, 8, 7));
+
+    offset = WriteHeader(64, 8, 8, FOURCC('D', 'X', 'T', '1'), 0);
+    CHECK(!Dds_Parse(g_File, WriteMips(offset, TEXTURE_FORMAT_BC1, 64, 8, 8), &texture));
+    WriteHeader(1, 1, 2, 0, 0);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(DDS_MAX_DIMENSION, DDS_MAX_DIMENSION, DDS_MAX_MIPS + 1, FOURCC('D', 'X', 'T', '1'), 0);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+    WriteHeader(16, 16, 0xFFFFFFFFu, FOURCC_DX10, 71);
+    CHECK(!Dds_Parse(g_File, sizeof(g_File), &texture));
+
+    // A count of 0 with the flag set is a single level
+    offset = WriteHeader(16, 16, 0, FOURCC('D', 'X', 'T', '1'), 0);
+    CHECK(Dds_Parse(g_File, WriteMips(offset, TEXTURE_FORMAT_BC1, 16, 16, 1), &texture));
+    CHECK(texture.MipCount == 1);
+}
+
+// What the texture compressor writes reads back the same
+static void TestSaveLoad(void)
+{
+    size_t offset = WriteHeader(40, 24, 6, FOURCC_DX10, 99);
+    size_t size = WriteMips(offset, TEXTURE_FORMAT_BC7, 40, 24, 6);
+    DdsTexture texture;
+    CHECK(Dds_Parse(g_File, size, &texture));
+
+    const char* path = "test-dds.dds";
+    CHECK(Dds_Save(path, &texture));
+    DdsTexture loaded;
+    CHECK(Dds_Load(path, &loaded));
+    CHECK(loaded.Format == TEXTURE_FORMAT_BC7 && loaded.Srgb && loaded.MipCount == 6);
+    bool same = loaded.Width == 40 && loaded.Height == 24;
+    for (uint32_t i = 0; same && i < loaded.MipCount; ++i)
+    {
+        same = loaded.Mips[i].SlicePitch == texture.Mips[i].SlicePitch &&
+               memcmp(loaded.Mips[i].Data, texture.Mips[i].Data, texture.Mips[i].SlicePitch) == 0;
+    }
+    CHECK(same);
+    Dds_Release(&loaded);
+    remove(path);
+}
+
+int main(void)
+{
+    TestLegacy();
+    TestDx10();
+    TestTruncated();
+    TestDimensions();
+    TestMipCount();
+    TestSaveLoad();
+    return TEST_RESULT();
+}
@@ -0,0 +1,127 @@
+// The radix sort of the draw queue across the workers against the scalar reference: the same
+// packets in the same order for keys of every shape, and the state filter of a sorted queue
+
+#include "draw_queue.h"
+#include "parallel.h"
+#include "test.h"
+
+#include <math.h>
+#include <string.h>
+
+// A few chunks of the parallel sort and a partial one
+#define PACKET_COUNT 70001
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// Random keys with only the fields of fieldMask set, few distinct values so keys repeat
+static void FillQueues(DrawQueue* queue, DrawQueue* reference, size_t count, uint32_t fieldMask, uint32_t* random)
+{
+    DrawQueue_Clear(queue);
+    DrawQueue_Clear(reference);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t pass = (fieldMask & 1) ? NextRandom(random) % 3 : 0;
+        uint32_t pipeline = (fieldMask & 2) ? NextRandom(random) % 40 : 0;
+        uint32_t material = (fieldMask & 4) ? NextRandom(random) % 500 : 0;
+        uint32_t mesh = (fieldMask & 8) ? NextRandom(random) % 100 : 0;
+        uint32_t depth = (fieldMask & 16) ? NextRandom(random) : 0;
+        uint64_t key = DrawKey_Pack(pass, pipeline, material, mesh, depth);
+        CHECK(DrawQueue_Push(queue, key, (uint32_t)i, (uint32_t)(i % 7)));
+        CHECK(DrawQueue_Push(reference, key, (uint32_t)i, (uint32_t)(i % 7)));
+    }
+}
+
+static bool IsSortedStably(const DrawQueue* queue)
+{
+    for (size_t i = 1; i < queue->Count; ++i)
+    {
+        const DrawPacket* previous = &queue->Packets[i - 1];
+        const DrawPacket* packet = &queue->Packets[i];
+        if (packet->Key < previous->Key || (packet->Key == previous->Key && packet->Instance < previous->Instance))
+            return false;
+    }
+    return true;
+}
+
+static void TestSort(void)
+{
+    DrawQueue queue;
+    DrawQueue reference;
+    CHECK(DrawQueue_Create(&queue, 1));
+    CHECK(DrawQueue_Create(&reference, 1));
+
+    // Every field alone skips the passes of the others, all of them together run every pass
+    static const uint32_t fieldMasks[] = { 0, 1, 2, 4, 8, 16, 31 };
+    static const size_t counts[] = { 0, 1, 2, 3, 255, 16384, 16385, PACKET_COUNT };
+    uint32_t random = 1;
+    for (size_t m = 0; m < sizeof(fieldMasks) / sizeof(fieldMasks[0]); ++m)
+    {
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+        {
+            FillQueues(&queue, &reference, counts[c], fieldMasks[m], &random);
+            DrawQueue_Sort(&queue);
+            DrawQueue_SortScalar(&reference);
+            CHECK(queue.Count == counts[c] && reference.Count == counts[c]);
+            CHECK(counts[c] == 0 || memcmp(queue.Packets, reference.Packets, counts[c] * sizeof(DrawPacket)) == 0);
+            CHECK(IsSortedStably(&queue));
+        }
+    }
+
+    // Sorting a sorted queue keeps it
+    DrawQueue_Sort(&queue);
+    CHECK(memcmp(queue.Packets, reference.Packets, PACKET_COUNT * sizeof(DrawPacket)) == 0);
+
+    DrawQueue_Destroy(&reference);
+    DrawQueue_Destroy(&queue);
+}
+
+static void TestKeys(void)
+{
+    uint64_t key = DrawKey_Pack(5, 1000, 9000, 4000, 123456);
+    CHECK(DrawKey_GetPass(key) == 5 && DrawKey_GetPipeline(key) == 1000);
+    CHECK(DrawKey_GetMaterial(key) == 9000 && DrawKey_GetMesh(key) == 4000);
+    CHECK((key & ((1u << DRAW_KEY_DEPTH_BITS) - 1)) == 123456);
+
+    // Wider fields are truncated instead of spilling into the next one
+    key = DrawKey_Pack(0, 1u << DRAW_KEY_PIPELINE_BITS, 0, 0, 0);
+    CHECK(DrawKey_GetPass(key) == 0 && DrawKey_GetPipeline(key) == 0);
+
+    // The pass outweighs everything after it
+    CHECK(DrawKey_Pack(1, 0, 0, 0, 0) > DrawKey_Pack(0, 1023, 16383, 4095, 0xFFFFFF));
+
+    CHECK(DrawKey_QuantizeDepth(0.25f, false) < DrawKey_QuantizeDepth(0.75f, false));
+    CHECK(DrawKey_QuantizeDepth(0.25f, true) > DrawKey_QuantizeDepth(0.75f, true));
+    CHECK(DrawKey_QuantizeDepth(-1.0f, false) == 0 && DrawKey_QuantizeDepth(2.0f, false) == 0xFFFFFF);
+    CHECK(DrawKey_QuantizeDepth(NAN, false) == 0);
+}
+
+static void TestStateFilter(void)
+{
+    DrawStateFilter filter;
+    DrawStateFilter_Reset(&filter);
+    uint32_t all = DRAW_STATE_PASS | DRAW_STATE_PIPELINE | DRAW_STATE_MATERIAL | DRAW_STATE_MESH;
+    CHECK(DrawStateFilter_Next(&filter, DrawKey_Pack(0, 1, 1, 1, 10)) == all);
+    CHECK(DrawStateFilter_Next(&filter, DrawKey_Pack(0, 1, 1, 1, 20)) == 0);
+    CHECK(DrawStateFilter_Next(&filter, DrawKey_Pack(0, 1, 1, 2, 5)) == DRAW_STATE_MESH);
+    CHECK(DrawStateFilter_Next(&filter, DrawKey_Pack(0, 1, 3, 2, 5)) == DRAW_STATE_MATERIAL);
+    CHECK(DrawStateFilter_Next(&filter, DrawKey_Pack(0, 2, 3, 2, 5)) == DRAW_STATE_PIPELINE);
+    CHECK(DrawStateFilter_Next(&filter, DrawKey_Pack(1, 2, 3, 2, 5)) == DRAW_STATE_PASS);
+    CHECK(filter.PipelineChanges == 2 && filter.MaterialChanges == 2 && filter.MeshChanges == 2);
+
+    DrawStateFilter_Reset(&filter);
+    CHECK(DrawStateFilter_Next(&filter, DrawKey_Pack(1, 2, 3, 2, 5)) == all);
+}
+
+int main(void)
+{
+    CHECK(Parallel_Initialise(3));
+    TestSort();
+    TestKeys();
+    TestStateFilter();
+    Parallel_Shutdown();
+    return TEST_RESULT();
+}
@@ -0,0 +1,221 @@
+// The dynamic resolution controller replaying generated GPU time traces with the readback
+// latency: it holds the target without oscillating, stays within the bounds, only moves the
+// scale in steps and isn't moved by single frame spikes
+
+#include "dynamic_resolution.h"
+#include "test.h"
+
+#include <math.h>
+#include <string.h>
+
+#define TARGET_MILLISECONDS 14.0f
+#define FRAME_COUNT 3000
+#define FIXED_FRACTION 0.15f
+#define LATENCY_FRAMES 3
+// Frames at the start the controller gets to settle
+#define WARM_UP_FRAMES 120
+// Changes of direction closer than this count as oscillating
+#define FLIP_FRAMES 10
+// Frames averaged for the cost the noise is around
+#define EXPECTED_FRAMES 31
+#define MAX_HOLD_ERROR 0.06
+#define MAX_FLIP_RATE 0.005
+
+typedef enum TraceKind
+{
+    // 20 ms with 5% noise
+    TRACE_STEADY,
+    // 9 ms with 5% noise, full resolution fits
+    TRACE_LIGHT,
+    // 11 ms, 24 ms in the middle third
+    TRACE_STEP,
+    // 8 ms rising to 30 ms
+    TRACE_RAMP,
+    // 18 ms with a 2.5x spike in 1% of the frames
+    TRACE_SPIKES,
+    // 18 ms with 20% noise
+    TRACE_NOISY,
+    TRACE_KIND_COUNT
+} TraceKind;
+
+// GPU time of every frame at full resolution
+static float g_Trace[FRAME_COUNT];
+static float g_Expected[FRAME_COUNT];
+static float g_Scales[FRAME_COUNT];
+static float g_GpuMilliseconds[FRAME_COUNT];
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static float RandomUnit(uint32_t* state)
+{
+    return NextRandom(state) / 16777216.0f;
+}
+
+// Roughly normal noise, the sum of uniform ones
+static float RandomNoise(uint32_t* state, float deviation)
+{
+    float sum = RandomUnit(state) + RandomUnit(state) + RandomUnit(state) + RandomUnit(state) - 2.0f;
+    return sum * deviation * 1.7320508f;
+}
+
+static void CreateTrace(TraceKind kind)
+{
+    uint32_t random = 1 + kind;
+    for (uint32_t i = 0; i < FRAME_COUNT; ++i)
+    {
+        float progress = (float)i / FRAME_COUNT;
+        float milliseconds;
+        switch (kind)
+        {
+            case TRACE_STEADY:
+                milliseconds = 20.0f * (1.0f + RandomNoise(&random, 0.05f));
+                break;
+            case TRACE_LIGHT:
+                milliseconds = 9.0f * (1.0f + RandomNoise(&random, 0.05f));
+                break;
+            case TRACE_STEP:
+                milliseconds = (progress >= 1.0f / 3.0f && progress < 2.0f / 3.0f ? 24.0f : 11.0f) *
+                               (1.0f + RandomNoise(&random, 0.03f));
+                break;
+            case TRACE_RAMP:
+                milliseconds = (8.0f + 22.0f * progress) * (1.0f + RandomNoise(&random, 0.03f));
+                break;
+            case TRACE_SPIKES:
+                milliseconds = 18.0f * (1.0f + RandomNoise(&random, 0.03f)) * (RandomUnit(&random) < 0.01f ? 2.5f : 1.0f);
+                break;
+            default:
+                milliseconds = 18.0f * (1.0f + RandomNoise(&random, 0.2f));
+                break;
+        }
+        g_Trace[i] = fmaxf(milliseconds, 0.1f);
+    }
+
+    // Whether the target can be held is judged by the average around a frame, picking frames by
+    // their own noisy time would only keep the expensive ones
+    for (uint32_t i = 0; i < FRAME_COUNT; ++i)
+    {
+        uint32_t first = i > EXPECTED_FRAMES / 2 ? i - EXPECTED_FRAMES / 2 : 0;
+        uint32_t last = i + EXPECTED_FRAMES / 2 < FRAME_COUNT ? i + EXPECTED_FRAMES / 2 : FRAME_COUNT - 1;
+        float sum = 0.0f;
+        for (uint32_t j = first; j <= last; ++j)
+            sum += g_Trace[j];
+        g_Expected[i] = sum / (last - first + 1);
+    }
+}
+
+// A fixed part of the time whatever the scale, the rest in proportion to the pixel count
+static float GetGpuMilliseconds(float fullMilliseconds, float scale)
+{
+    return fullMilliseconds * (FIXED_FRACTION + (1.0f - FIXED_FRACTION) * scale * scale);
+}
+
+// Scale that takes exactly the target, within the bounds
+static float GetIdealScale(const DynamicResolutionSettings* settings, float fullMilliseconds)
+{
+    float pixels = (settings->TargetMilliseconds / fullMilliseconds - FIXED_FRACTION) / (1.0f - FIXED_FRACTION);
+    float scale = pixels > 0.0f ? sqrtf(pixels) : 0.0f;
+    return fminf(fmaxf(scale, settings->MinScale), settings->MaxScale);
+}
+
+// Every frame is learnt about LATENCY_FRAMES late, like from timestamp queries read back once
+// the frame's fence completed
+static void Replay(TraceKind kind, const DynamicResolutionSettings* settings)
+{
+    DynamicResolution controller;
+    DynamicResolution_Init(&controller, settings);
+    CreateTrace(kind);
+
+    double holdMilliseconds = 0.0;
+    uint32_t holdFrames = 0;
+    uint32_t flips = 0;
+    int previousDirection = 0;
+    uint32_t previousChange = 0;
+    bool bounded = true;
+    bool stepped = true;
+    float scale = controller.Scale;
+    for (uint32_t i = 0; i < FRAME_COUNT; ++i)
+    {
+        if (i >= LATENCY_FRAMES)
+        {
+            uint32_t measured = i - LATENCY_FRAMES;
+            float nextScale = DynamicResolution_Update(&controller, g_GpuMilliseconds[measured], g_Scales[measured]);
+            bounded = bounded && nextScale >= settings->MinScale && nextScale <= settings->MaxScale;
+            stepped = stepped && (nextScale == scale || fabsf(nextScale - scale) >= settings->MinScaleStep ||
+                                  nextScale == settings->MinScale || nextScale == settings->MaxScale);
+            if (nextScale != scale && i >= WARM_UP_FRAMES)
+            {
+                int direction = nextScale > scale ? 1 : -1;
+                flips += previousDirection != 0 && direction != previousDirection && i - previousChange < FLIP_FRAMES;
+                previousDirection = direction;
+                previousChange = i;
+            }
+            scale = nextScale;
+        }
+        g_Scales[i] = scale;
+        g_GpuMilliseconds[i] = GetGpuMilliseconds(g_Trace[i], scale);
+
+        // The target can only be held between the bounds
+        float idealScale = GetIdealScale(settings, g_Expected[i]);
+        if (i >= WARM_UP_FRAMES && idealScale > settings->MinScale && idealScale < settings->MaxScale)
+        {
+            holdMilliseconds += g_GpuMilliseconds[i];
+            holdFrames++;
+        }
+    }
+
+    // Noise makes single frames miss it anyway, the mean of them has to hit it
+    double holdError = holdFrames > 0 ? fabs(holdMilliseconds / holdFrames / settings->TargetMilliseconds - 1.0) : 0.0;
+    CHECK(holdError <= MAX_HOLD_ERROR);
+    CHECK((double)flips / (FRAME_COUNT - WARM_UP_FRAMES) <= MAX_FLIP_RATE);
+    CHECK(bounded);
+    CHECK(stepped);
+    // Full resolution fits, it ends there
+    if (kind == TRACE_LIGHT)
+        CHECK(holdFrames == 0 && scale == settings->MaxScale);
+}
+
+static void TestTraces(void)
+{
+    DynamicResolutionSettings settings;
+    DynamicResolution_GetDefaultSettings(&settings, TARGET_MILLISECONDS);
+    for (int kind = 0; kind < TRACE_KIND_COUNT; ++kind)
+        Replay(kind, &settings);
+}
+
+// Far over the target it settles on the smallest scale, and a single spike doesn't move it
+static void TestBounds(void)
+{
+    DynamicResolutionSettings settings;
+    DynamicResolution_GetDefaultSettings(&settings, TARGET_MILLISECONDS);
+    DynamicResolution controller;
+    DynamicResolution_Init(&controller, &settings);
+    CHECK(controller.Scale == settings.MaxScale);
+
+    // Times that aren't positive are ignored
+    CHECK(DynamicResolution_Update(&controller, 0.0f, 1.0f) == settings.MaxScale);
+    CHECK(DynamicResolution_Update(&controller, NAN, 1.0f) == settings.MaxScale);
+    CHECK(DynamicResolution_Update(&controller, 50.0f, 0.0f) == settings.MaxScale);
+    CHECK(controller.UpdateCount == 0);
+
+    float scale = controller.Scale;
+    for (int i = 0; i < 100; ++i)
+        scale = DynamicResolution_Update(&controller, TARGET_MILLISECONDS * 0.8f, scale);
+    CHECK(scale == settings.MaxScale);
+    scale = DynamicResolution_Update(&controller, TARGET_MILLISECONDS * 5.0f, scale);
+    CHECK(scale == settings.MaxScale);
+
+    for (int i = 0; i < 1000; ++i)
+        scale = DynamicResolution_Update(&controller, GetGpuMilliseconds(100.0f, scale), scale);
+    CHECK(scale == settings.MinScale);
+}
+
+int main(void)
+{
+    TestTraces();
+    TestBounds();
+    return TEST_RESULT();
+}
@@ -0,0 +1,189 @@
+// The linear arenas: aligned allocations that never overlap across blocks, resets merging the
+// blocks into one that holds the peak, rollbacks to markers handing the same memory out again,
+// and the frame and scratch arenas of the threads
+
+#include "frame_arena.h"
+#include "job_system.h"
+#include "test.h"
+
+#include <string.h>
+#include <threads.h>
+
+#define BLOCK_SIZE 4096
+#define ALLOCATION_COUNT 2000
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static bool IsAligned(const void* pointer, size_t alignment)
+{
+    return ((uintptr_t)pointer & (alignment - 1)) == 0;
+}
+
+// Random sizes and alignments over several blocks, a few larger than a block. Every allocation
+// is filled with its own byte and checked once all are done.
+static void TestAlignment(void)
+{
+    LinearArena arena;
+    CHECK(LinearArena_Create(&arena, BLOCK_SIZE));
+
+    static uint8_t* pointers[ALLOCATION_COUNT];
+    static size_t sizes[ALLOCATION_COUNT];
+    bool aligned = true;
+    size_t total = 0;
+    uint32_t random = 1;
+    for (size_t i = 0; i < ALLOCATION_COUNT; ++i)
+    {
+        size_t alignment = (size_t)1 << (NextRandom(&random) % 13);
+        sizes[i] = i % 500 == 0 ? BLOCK_SIZE * 3 : NextRandom(&random) % 300;
+        pointers[i] = LinearArena_Alloc(&arena, sizes[i], alignment);
+        CHECK(pointers[i] != NULL);
+        aligned = aligned && IsAligned(pointers[i], alignment);
+        memset(pointers[i], (int)(i & 0xFF), sizes[i]);
+        total += sizes[i];
+    }
+    CHECK(aligned);
+    CHECK(arena.Used >= total && arena.Peak == arena.Used);
+
+    bool intact = true;
+    for (size_t i = 0; i < ALLOCATION_COUNT; ++i)
+    {
+        for (size_t x = 0; x < sizes[i]; ++x)
+            intact = intact && pointers[i][x] == (uint8_t)(i & 0xFF);
+    }
+    CHECK(intact);
+
+    // Typed arrays get the alignment of their type
+    double* values = LinearArena_AllocArray(&arena, double, 3);
+    CHECK(values != NULL && IsAligned(values, _Alignof(double)));
+    LinearArena_Destroy(&arena);
+}
+
+// After a frame that needed several blocks, the same frame fits a single one
+static void TestReset(void)
+{
+    LinearArena arena;
+    CHECK(LinearArena_Create(&arena, BLOCK_SIZE));
+
+    // Within one block the allocations are contiguous, and a reset hands out the same memory
+    uint8_t* first = LinearArena_Alloc(&arena, 100, 1);
+    CHECK(LinearArena_Alloc(&arena, 28, 1) == first + 100);
+    CHECK(arena.Used == 128);
+    LinearArena_Reset(&arena);
+    CHECK(arena.Used == 0 && arena.Peak == 128);
+    CHECK(LinearArena_Alloc(&arena, 100, 1) == first);
+    LinearArena_Reset(&arena);
+
+    for (int i = 0; i < 10; ++i)
+        CHECK(LinearArena_Alloc(&arena, 1000, 1) != NULL);
+    size_t peak = arena.Peak;
+    CHECK(peak >= 10000);
+
+    LinearArena_Reset(&arena);
+    CHECK(arena.Used == 0 && arena.Peak == peak);
+    uint8_t* previous = LinearArena_Alloc(&arena, 1000, 1);
+    bool contiguous = previous != NULL;
+    for (int i = 1; i < 10; ++i)
+    {
+        uint8_t* pointer = LinearArena_Alloc(&arena, 1000, 1);
+        contiguous = contiguous && pointer == previous + 1000;
+        previous = pointer;
+    }
+    CHECK(contiguous);
+    CHECK(arena.Used == 10000);
+    LinearArena_Destroy(&arena);
+}
+
+// Rolling back releases what was allocated after the marker, across blocks as well
+static void TestRollback(void)
+{
+    LinearArena arena;
+    CHECK(LinearArena_Create(&arena, BLOCK_SIZE));
+    CHECK(LinearArena_Alloc(&arena, 1000, 16) != NULL);
+
+    ArenaMarker marker = LinearArena_GetMarker(&arena);
+    size_t used = arena.Used;
+    void* afterMarker = LinearArena_Alloc(&arena, 64, 16);
+    CHECK(LinearArena_Alloc(&arena, 500, 16) != NULL);
+    LinearArena_Rollback(&arena, marker);
+    CHECK(arena.Used == used);
+    CHECK(LinearArena_Alloc(&arena, 64, 16) == afterMarker);
+
+    // Into a second block and back, the second block is reused afterwards
+    LinearArena_Rollback(&arena, marker);
+    void* overflow = LinearArena_Alloc(&arena, BLOCK_SIZE - 512, 16);
+    CHECK(overflow != NULL);
+    memset(overflow, 0xAB, BLOCK_SIZE - 512);
+    LinearArena_Rollback(&arena, marker);
+    CHECK(arena.Used == used);
+    CHECK(LinearArena_Alloc(&arena, 64, 16) == afterMarker);
+    CHECK(LinearArena_Alloc(&arena, BLOCK_SIZE - 512, 16) == overflow);
+
+    // Nested markers unwind in order
+    LinearArena_Rollback(&arena, marker);
+    LinearArena_Alloc(&arena, 10, 1);
+    ArenaMarker inner = LinearArena_GetMarker(&arena);
+    size_t innerUsed = arena.Used;
+    LinearArena_Alloc(&arena, 3000, 1);
+    LinearArena_Rollback(&arena, inner);
+    CHECK(arena.Used == innerUsed);
+    LinearArena_Rollback(&arena, marker);
+    CHECK(arena.Used == used);
+    LinearArena_Destroy(&arena);
+}
+
+static int ScratchThreadMain(void* argument)
+{
+    LinearArena** arena = argument;
+    *arena = ScratchArena_Get();
+    return 0;
+}
+
+// Every job system thread gets its own arena per frame, other threads get none
+static int OutsideThreadMain(void* argument)
+{
+    FrameArenas* arenas = argument;
+    return FrameArenas_Get(arenas, 0) == NULL ? 0 : 1;
+}
+
+static void TestThreads(void)
+{
+    CHECK(JobSystem_Initialise(2));
+    FrameArenas arenas;
+    CHECK(FrameArenas_Create(&arenas, 3, BLOCK_SIZE));
+    CHECK(arenas.ThreadCount == JobSystem_GetThreadIndexCount());
+
+    LinearArena* frame0 = FrameArenas_Get(&arenas, 0);
+    LinearArena* frame1 = FrameArenas_Get(&arenas, 1);
+    CHECK(frame0 != NULL && frame1 != NULL && frame0 != frame1);
+    CHECK(LinearArena_Alloc(frame0, 100, 8) != NULL && LinearArena_Alloc(frame1, 50, 8) != NULL);
+    FrameArenas_Reset(&arenas, 0);
+    CHECK(frame0->Used == 0 && frame1->Used == 50);
+
+    thrd_t thread;
+    int result = 1;
+    CHECK(thrd_create(&thread, OutsideThreadMain, &arenas) == thrd_success);
+    thrd_join(thread, &result);
+    CHECK(result == 0);
+    FrameArenas_Destroy(&arenas);
+    JobSystem_Shutdown();
+
+    LinearArena* scratch = ScratchArena_Get();
+    CHECK(scratch != NULL && ScratchArena_Get() == scratch);
+    LinearArena* otherScratch = NULL;
+    CHECK(thrd_create(&thread, ScratchThreadMain, &otherScratch) == thrd_success);
+    thrd_join(thread, NULL);
+    CHECK(otherScratch != NULL && otherScratch != scratch);
+}
+
+int main(void)
+{
+    TestAlignment();
+    TestReset();
+    TestRollback();
+    TestThreads();
+    return TEST_RESULT();
+}
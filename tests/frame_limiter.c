@@ -0,0 +1,144 @@
+// The frame limiter on a fake clock whose sleeps wake late: frames end on a cadence of one
+// period, a frame ending a little late is made up for and one more than a quarter of a period
+// late starts the cadence over, and the late and overslept frames are counted
+
+#include "frame_limiter.h"
+#include "test.h"
+
+#define PERIOD 10000000
+// Cost of reading the fake clock, the granularity of spinning
+#define CLOCK_READ 100
+#define SLEEP_LATENESS 100000
+#define FRAME_COUNT 200
+
+typedef struct FakeClock
+{
+    int64_t Now;
+    // Added to the next sleep only
+    int64_t Delay;
+    uint32_t ReadCount;
+    uint32_t SleepCount;
+} FakeClock;
+
+static int64_t ReadFakeClock(void* context)
+{
+    FakeClock* clock = context;
+    clock->ReadCount++;
+    clock->Now += CLOCK_READ;
+    return clock->Now;
+}
+
+static void SleepFake(void* context, int64_t nanoseconds)
+{
+    FakeClock* clock = context;
+    clock->SleepCount++;
+    clock->Now += nanoseconds + SLEEP_LATENESS + clock->Delay;
+    clock->Delay = 0;
+}
+
+static void TestCadence(void)
+{
+    FakeClock clock = { .Now = 1000000000 };
+    FrameLimiter limiter;
+    CHECK(FrameLimiter_Create(&limiter, 1e9 / PERIOD, ReadFakeClock, SleepFake, &clock));
+    CHECK(limiter.Period == PERIOD);
+
+    // The first frame doesn't wait, every other one ends a period after the one before
+    int64_t first = FrameLimiter_Wait(&limiter);
+    bool onCadence = true;
+    for (int64_t i = 1; i < FRAME_COUNT; ++i)
+    {
+        clock.Now += PERIOD / 4 + i % 7 * 100000;
+        int64_t end = FrameLimiter_Wait(&limiter);
+        int64_t deadline = first + i * PERIOD;
+        onCadence = onCadence && end >= deadline && end < deadline + CLOCK_READ * 2;
+    }
+    CHECK(onCadence);
+
+    // Most of the wait is slept, the estimate of the slices learnt how late they wake
+    const FrameLimiterCounters* counters = &limiter.Counters;
+    CHECK(counters->FrameCount == FRAME_COUNT && counters->LateCount == 0 && counters->OversleptCount == 0);
+    CHECK(counters->SleepCount == clock.SleepCount && counters->SleepCount > 5 * FRAME_COUNT);
+    CHECK(counters->SpunTime < counters->SleptTime / 4);
+    CHECK(limiter.SliceMean > FRAME_LIMITER_SLEEP_SLICE + SLEEP_LATENESS / 2 &&
+          limiter.SliceMean < FRAME_LIMITER_SLEEP_SLICE + SLEEP_LATENESS * 2);
+    FrameLimiter_Destroy(&limiter);
+}
+
+// A frame a tenth of a period late keeps the cadence, one half a period late starts it over
+static void TestLateFrames(void)
+{
+    FakeClock clock = { .Now = 1000000000 };
+    FrameLimiter limiter;
+    CHECK(FrameLimiter_Create(&limiter, 1e9 / PERIOD, ReadFakeClock, SleepFake, &clock));
+    int64_t first = FrameLimiter_Wait(&limiter);
+
+    clock.Now = first + PERIOD + PERIOD / 10;
+    int64_t late = FrameLimiter_Wait(&limiter);
+    CHECK(late == clock.Now && limiter.Counters.LateCount == 1);
+    clock.Now += PERIOD / 4;
+    int64_t end = FrameLimiter_Wait(&limiter);
+    CHECK(end >= first + 2 * PERIOD && end < first + 2 * PERIOD + CLOCK_READ * 2);
+
+    clock.Now = end + PERIOD + PERIOD / 2;
+    late = FrameLimiter_Wait(&limiter);
+    CHECK(limiter.Counters.LateCount == 2);
+    clock.Now += PERIOD / 4;
+    end = FrameLimiter_Wait(&limiter);
+    CHECK(end >= late + PERIOD && end < late + PERIOD + CLOCK_READ * 2);
+
+    // After a reset the next frame doesn't wait
+    FrameLimiter_Reset(&limiter);
+    clock.Now += PERIOD / 4;
+    CHECK(FrameLimiter_Wait(&limiter) == clock.Now);
+    CHECK(limiter.Counters.FrameCount == 6 && limiter.Counters.LateCount == 2 && limiter.Counters.OversleptCount == 0);
+    FrameLimiter_Destroy(&limiter);
+}
+
+// A sleep waking far later than the estimate overshoots the deadline
+static void TestOverslept(void)
+{
+    FakeClock clock = { .Now = 1000000000 };
+    FrameLimiter limiter;
+    CHECK(FrameLimiter_Create(&limiter, 1e9 / PERIOD, ReadFakeClock, SleepFake, &clock));
+    FrameLimiter_Wait(&limiter);
+    for (int i = 0; i < 20; ++i)
+        FrameLimiter_Wait(&limiter);
+    CHECK(limiter.Counters.OversleptCount == 0);
+
+    clock.Delay = 2 * PERIOD;
+    int64_t deadline = limiter.Deadline;
+    int64_t end = FrameLimiter_Wait(&limiter);
+    CHECK(end > deadline && limiter.Counters.OversleptCount == 1 && limiter.Counters.LateCount == 0);
+    // Overslept by more than a quarter of a period, the cadence starts over
+    CHECK(limiter.Deadline == end + PERIOD);
+    FrameLimiter_Destroy(&limiter);
+}
+
+// A clock given without a sleep gets the caller's context, the system sleep the limiter's
+static void TestContexts(void)
+{
+    FakeClock clock = { .Now = 1000000000 };
+    FrameLimiter limiter;
+    CHECK(FrameLimiter_Create(&limiter, 1e9 / PERIOD, ReadFakeClock, NULL, &clock));
+    CHECK(FrameLimiter_Wait(&limiter) == clock.Now && clock.ReadCount == 1);
+    clock.Now += 2 * PERIOD;
+    CHECK(FrameLimiter_Wait(&limiter) == clock.Now && clock.ReadCount == 2);
+    CHECK(limiter.Counters.FrameCount == 2 && limiter.Counters.LateCount == 1);
+    FrameLimiter_Destroy(&limiter);
+
+    CHECK(FrameLimiter_Create(&limiter, 1e9 / PERIOD, NULL, SleepFake, &clock));
+    CHECK(limiter.ClockContext == &clock && limiter.SleepContext == &clock);
+    FrameLimiter_Destroy(&limiter);
+
+    CHECK(!FrameLimiter_Create(&limiter, 0.0, ReadFakeClock, SleepFake, &clock));
+}
+
+int main(void)
+{
+    TestCadence();
+    TestLateFrames();
+    TestOverslept();
+    TestContexts();
+    return TEST_RESULT();
+}
@@ -0,0 +1,192 @@
+// A producer and a consumer thread racing over the triple buffer and the frame pipeline. The
+// consumer never sees a slot being written or an older frame than the last, and the pipeline
+// hands over every frame in order before the close.
+
+#include "frame_pipeline.h"
+#include "test.h"
+
+#define FRAME_COUNT 20000
+#define SLOT_WORDS 256
+
+// Every word holds the frame number, a slot written while it's read shows mixed ones
+typedef struct Snapshot
+{
+    uint64_t Words[SLOT_WORDS];
+} Snapshot;
+
+typedef struct RaceData
+{
+    TripleBuffer Buffer;
+    FramePipeline Pipeline;
+    atomic_bool Done;
+    Snapshot Slots[TRIPLE_BUFFER_SLOTS];
+} RaceData;
+
+static RaceData g_Race;
+
+static void FillSnapshot(Snapshot* snapshot, uint64_t frame)
+{
+    for (size_t i = 0; i < SLOT_WORDS; ++i)
+        snapshot->Words[i] = frame;
+}
+
+// The frame of the snapshot, 0 when it's torn
+static uint64_t ReadSnapshot(const Snapshot* snapshot)
+{
+    uint64_t frame = snapshot->Words[0];
+    for (size_t i = 1; i < SLOT_WORDS; ++i)
+    {
+        if (snapshot->Words[i] != frame)
+            return 0;
+    }
+    return frame;
+}
+
+static void InitSlots(void* slots[TRIPLE_BUFFER_SLOTS])
+{
+    for (size_t i = 0; i < TRIPLE_BUFFER_SLOTS; ++i)
+    {
+        FillSnapshot(&g_Race.Slots[i], 0);
+        slots[i] = &g_Race.Slots[i];
+    }
+}
+
+static int TripleBufferProducer(void* argument)
+{
+    (void)argument;
+    for (uint64_t frame = 1; frame <= FRAME_COUNT; ++frame)
+    {
+        FillSnapshot(TripleBuffer_GetWriteSlot(&g_Race.Buffer), frame);
+        TripleBuffer_Publish(&g_Race.Buffer);
+    }
+    atomic_store(&g_Race.Done, true);
+    return 0;
+}
+
+// Frames may be skipped, but the ones seen only ever grow
+static void TestTripleBuffer(void)
+{
+    void* slots[TRIPLE_BUFFER_SLOTS];
+    InitSlots(slots);
+    TripleBuffer_Init(&g_Race.Buffer, slots);
+    atomic_init(&g_Race.Done, false);
+    CHECK(!TripleBuffer_Acquire(&g_Race.Buffer));
+
+    thrd_t producer;
+    CHECK(thrd_create(&producer, TripleBufferProducer, NULL) == thrd_success);
+    uint64_t lastFrame = 0;
+    size_t acquired = 0;
+    bool torn = false;
+    bool outOfOrder = false;
+    bool changed = false;
+    for (;;)
+    {
+        // Checked before the acquire, so the last frame is still taken after the producer ends
+        bool done = atomic_load(&g_Race.Done);
+        if (TripleBuffer_Acquire(&g_Race.Buffer))
+        {
+            const Snapshot* snapshot = TripleBuffer_GetReadSlot(&g_Race.Buffer);
+            uint64_t frame = ReadSnapshot(snapshot);
+            torn = torn || frame == 0;
+            outOfOrder = outOfOrder || frame <= lastFrame;
+            lastFrame = frame;
+            ++acquired;
+
+            // Still the same once the producer had time to write more
+            thrd_yield();
+            changed = changed || ReadSnapshot(snapshot) != frame;
+        }
+        else if (done)
+            break;
+    }
+    thrd_join(producer, NULL);
+
+    CHECK(!torn);
+    CHECK(!outOfOrder);
+    CHECK(!changed);
+    CHECK(acquired > 0 && lastFrame == FRAME_COUNT);
+}
+
+static int PipelineProducer(void* argument)
+{
+    (void)argument;
+    for (uint64_t frame = 1; frame <= FRAME_COUNT; ++frame)
+    {
+        FillSnapshot(FramePipeline_BeginFrame(&g_Race.Pipeline), frame);
+        if (!FramePipeline_Publish(&g_Race.Pipeline))
+            return 1;
+    }
+    FramePipeline_Close(&g_Race.Pipeline);
+    return 0;
+}
+
+// No frame is skipped, each one stays unchanged while it's drawn, the close ends the run
+static void TestFramePipeline(void)
+{
+    void* slots[TRIPLE_BUFFER_SLOTS];
+    InitSlots(slots);
+    CHECK(FramePipeline_Create(&g_Race.Pipeline, slots));
+
+    thrd_t producer;
+    CHECK(thrd_create(&producer, PipelineProducer, NULL) == thrd_success);
+    uint64_t expectedFrame = 1;
+    bool inOrder = true;
+    bool changed = false;
+    const Snapshot* snapshot;
+    while ((snapshot = FramePipeline_Acquire(&g_Race.Pipeline)) != NULL)
+    {
+        uint64_t frame = ReadSnapshot(snapshot);
+        inOrder = inOrder && frame == expectedFrame;
+        ++expectedFrame;
+
+        // The simulation fills the next snapshot meanwhile
+        thrd_yield();
+        changed = changed || ReadSnapshot(snapshot) != frame;
+    }
+    int result = 1;
+    thrd_join(producer, &result);
+
+    CHECK(result == 0);
+    CHECK(inOrder);
+    CHECK(!changed);
+    CHECK(expectedFrame == FRAME_COUNT + 1);
+    FramePipeline_Destroy(&g_Race.Pipeline);
+}
+
+static int CloseLater(void* argument)
+{
+    (void)argument;
+    thrd_sleep(&(struct timespec){ .tv_nsec = 20000000 }, NULL);
+    FramePipeline_Close(&g_Race.Pipeline);
+    return 0;
+}
+
+// A consumer asleep on an empty pipeline and a producer waiting on a frame never taken both
+// return once it's closed
+static void TestClose(void)
+{
+    void* slots[TRIPLE_BUFFER_SLOTS];
+    InitSlots(slots);
+    CHECK(FramePipeline_Create(&g_Race.Pipeline, slots));
+
+    thrd_t closer;
+    CHECK(thrd_create(&closer, CloseLater, NULL) == thrd_success);
+    CHECK(FramePipeline_Acquire(&g_Race.Pipeline) == NULL);
+    thrd_join(closer, NULL);
+    FramePipeline_Destroy(&g_Race.Pipeline);
+
+    CHECK(FramePipeline_Create(&g_Race.Pipeline, slots));
+    CHECK(FramePipeline_Publish(&g_Race.Pipeline));
+    CHECK(thrd_create(&closer, CloseLater, NULL) == thrd_success);
+    CHECK(!FramePipeline_Publish(&g_Race.Pipeline));
+    thrd_join(closer, NULL);
+    FramePipeline_Destroy(&g_Race.Pipeline);
+}
+
+int main(void)
+{
+    TestTripleBuffer();
+    TestFramePipeline();
+    TestClose();
+    return TEST_RESULT();
+}
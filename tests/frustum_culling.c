@@ -0,0 +1,137 @@
+// The SIMD frustum culling across the workers against the scalar reference: the same visible
+// bounds in the same order, for counts that leave every tail length of the vector loops
+
+// Left handed like the app
+#define CGLM_FORCE_LEFT_HANDED
+
+#include "frustum_culling.h"
+#include "parallel.h"
+#include "test.h"
+
+#define BOUND_COUNT 10007
+
+static float NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) / 16777216.0f;
+}
+
+// Looking down +Z from the origin, a bit over a quarter of the bounds in the box are visible
+static void CreateFrustum(Frustum* frustum)
+{
+    mat4 projection;
+    glm_perspective(1.0f, 16.0f / 9.0f, 0.5f, 50.0f, projection);
+    Frustum_FromViewProjection(frustum, projection);
+}
+
+static bool IsSameVisibility(const uint32_t* a, size_t aCount, const uint32_t* b, size_t bCount)
+{
+    if (aCount != bCount)
+        return false;
+    for (size_t i = 0; i < aCount; ++i)
+    {
+        if (a[i] != b[i] || (i > 0 && a[i] <= a[i - 1]))
+            return false;
+    }
+    return true;
+}
+
+static void TestSpheres(const Frustum* frustum)
+{
+    SphereBounds bounds = { 0 };
+    CHECK(SphereBounds_Resize(&bounds, BOUND_COUNT));
+    uint32_t random = 1;
+    for (size_t i = 0; i < BOUND_COUNT; ++i)
+    {
+        bounds.X[i] = NextRandom(&random) * 80.0f - 40.0f;
+        bounds.Y[i] = NextRandom(&random) * 60.0f - 30.0f;
+        bounds.Z[i] = NextRandom(&random) * 70.0f - 10.0f;
+        bounds.Radius[i] = NextRandom(&random) * 2.0f;
+    }
+
+    static uint32_t visible[BOUND_COUNT];
+    static uint32_t reference[BOUND_COUNT];
+    for (size_t count = 0; count <= 17; ++count)
+    {
+        bounds.Count = count;
+        CHECK(IsSameVisibility(visible, FrustumCullSpheres(frustum, &bounds, visible),
+                               reference, FrustumCullSpheresScalar(frustum, &bounds, reference)));
+    }
+    bounds.Count = BOUND_COUNT;
+    size_t visibleCount = FrustumCullSpheres(frustum, &bounds, visible);
+    CHECK(IsSameVisibility(visible, visibleCount, reference, FrustumCullSpheresScalar(frustum, &bounds, reference)));
+    CHECK(visibleCount > BOUND_COUNT / 10 && visibleCount < BOUND_COUNT / 2);
+
+    // In front of the camera, behind it, past the far plane and straddling the left plane
+    bounds.Count = 4;
+    const float spheres[4][4] = { { 0, 0, 10, 1 }, { 0, 0, -5, 1 }, { 0, 0, 60, 5 }, { -10, 0, 10, 2 } };
+    for (size_t i = 0; i < 4; ++i)
+    {
+        bounds.X[i] = spheres[i][0];
+        bounds.Y[i] = spheres[i][1];
+        bounds.Z[i] = spheres[i][2];
+        bounds.Radius[i] = spheres[i][3];
+    }
+    CHECK(FrustumCullSpheres(frustum, &bounds, visible) == 2 && visible[0] == 0 && visible[1] == 3);
+    SphereBounds_Release(&bounds);
+}
+
+static void TestAabbs(const Frustum* frustum)
+{
+    AabbBounds bounds = { 0 };
+    CHECK(AabbBounds_Resize(&bounds, BOUND_COUNT));
+    uint32_t random = 2;
+    for (size_t i = 0; i < BOUND_COUNT; ++i)
+    {
+        bounds.CenterX[i] = NextRandom(&random) * 80.0f - 40.0f;
+        bounds.CenterY[i] = NextRandom(&random) * 60.0f - 30.0f;
+        bounds.CenterZ[i] = NextRandom(&random) * 70.0f - 10.0f;
+        bounds.ExtentX[i] = NextRandom(&random) * 3.0f;
+        bounds.ExtentY[i] = NextRandom(&random) * 0.5f;
+        bounds.ExtentZ[i] = NextRandom(&random) * 1.5f;
+    }
+
+    static uint32_t visible[BOUND_COUNT];
+    static uint32_t reference[BOUND_COUNT];
+    for (size_t count = 0; count <= 17; ++count)
+    {
+        bounds.Count = count;
+        CHECK(IsSameVisibility(visible, FrustumCullAabbs(frustum, &bounds, visible),
+                               reference, FrustumCullAabbsScalar(frustum, &bounds, reference)));
+    }
+    bounds.Count = BOUND_COUNT;
+    size_t visibleCount = FrustumCullAabbs(frustum, &bounds, visible);
+    CHECK(IsSameVisibility(visible, visibleCount, reference, FrustumCullAabbsScalar(frustum, &bounds, reference)));
+    CHECK(visibleCount > BOUND_COUNT / 10 && visibleCount < BOUND_COUNT / 2);
+    AabbBounds_Release(&bounds);
+}
+
+// The spheres follow the world matrices, the radius the largest scale of the axes
+static void TestTransform(void)
+{
+    SphereBounds bounds = { 0 };
+    CHECK(SphereBounds_Resize(&bounds, 3));
+    mat4 worlds[3];
+    glm_mat4_identity(worlds[0]);
+    glm_translate_make(worlds[1], (vec3){ 1.0f, 2.0f, 3.0f });
+    glm_scale_make(worlds[2], (vec3){ 1.0f, 4.0f, 2.0f });
+    vec3 center = { 0.5f, 0.0f, 0.0f };
+    TransformSphereBounds(&bounds, worlds, 3, center, 2.0f);
+
+    CHECK(bounds.X[0] == 0.5f && bounds.Y[0] == 0.0f && bounds.Z[0] == 0.0f && bounds.Radius[0] == 2.0f);
+    CHECK(bounds.X[1] == 1.5f && bounds.Y[1] == 2.0f && bounds.Z[1] == 3.0f && bounds.Radius[1] == 2.0f);
+    CHECK(bounds.X[2] == 0.5f && bounds.Radius[2] == 8.0f);
+    SphereBounds_Release(&bounds);
+}
+
+int main(void)
+{
+    CHECK(Parallel_Initialise(3));
+    Frustum frustum;
+    CreateFrustum(&frustum);
+    TestSpheres(&frustum);
+    TestAabbs(&frustum);
+    TestTransform();
+    Parallel_Shutdown();
+    return TEST_RESULT();
+}
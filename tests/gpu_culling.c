@@ -0,0 +1,146 @@
+// The CPU reference of the GPU culling passes: the structs keep the layouts the shaders read,
+// the visible instances are those of the frustum culling in instance order, each drawn with
+// the level SelectLod picks for it
+
+#define CGLM_FORCE_LEFT_HANDED
+
+#include "gpu_culling.h"
+#include "test.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#define INSTANCE_COUNT 3001
+#define VIEWPORT_HEIGHT 720.0f
+#define PIXEL_THRESHOLD 1.0f
+
+static float NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) / 16777216.0f;
+}
+
+// Packing of the cbuffer and structured buffers in shaders/gpu_culling.hlsli
+static void TestLayouts(void)
+{
+    CHECK(offsetof(GpuCullConstants, ViewDepthRow) == 96);
+    CHECK(offsetof(GpuCullConstants, ProjectionScale) == 112);
+    CHECK(offsetof(GpuCullConstants, InstanceCount) == 120);
+    CHECK(offsetof(GpuCullConstants, Levels) == 128);
+    CHECK(sizeof(GpuLodLevel) == 16);
+    CHECK(sizeof(GpuCullConstants) == 128 + 16 * LOD_MAX_LEVELS);
+    CHECK(sizeof(GpuCullInstance) == 80);
+    CHECK(offsetof(GpuDrawCommand, Draw) == 64);
+    CHECK(sizeof(GpuDrawCommand) == 84);
+
+    CHECK(GpuCulling_GetGroupCount(0) == 0);
+    CHECK(GpuCulling_GetGroupCount(GPU_CULLING_GROUP_SIZE) == 1);
+    CHECK(GpuCulling_GetGroupCount(GPU_CULLING_GROUP_SIZE + 1) == 2);
+}
+
+// Four levels of a mesh with a unit bounding sphere, each one twice as coarse
+static void CreateLods(LodChain* lods)
+{
+    memset(lods, 0, sizeof(*lods));
+    lods->LevelCount = 4;
+    lods->Radius = 1.0f;
+    lods->Levels[0] = (LodLevel){ 0, 3000, 0.0f };
+    lods->Levels[1] = (LodLevel){ 3000, 1500, 0.002f };
+    lods->Levels[2] = (LodLevel){ 4500, 750, 0.01f };
+    lods->Levels[3] = (LodLevel){ 5250, 372, 0.05f };
+}
+
+// Whether the projected error of a level lands so close to the threshold that the division
+// SelectLod makes and the multiplication of the shaders may round to different sides of it
+static bool IsNearLevelBoundary(const LodChain* lods, float z, float radius, float projectionScale)
+{
+    double depth = fmax((double)z - radius, GPU_CULLING_MIN_DEPTH);
+    for (uint32_t i = 1; i < lods->LevelCount; ++i)
+    {
+        double pixels = (double)lods->Levels[i].Error * radius / lods->Radius * projectionScale / depth;
+        if (fabs(pixels - PIXEL_THRESHOLD) < 1e-4 * PIXEL_THRESHOLD)
+            return true;
+    }
+    return false;
+}
+
+static void TestCulling(void)
+{
+    // The camera at the origin looking down +Z
+    mat4 view, projection, viewProjection;
+    glm_mat4_identity(view);
+    glm_perspective(1.0f, 16.0f / 9.0f, 0.1f, 200.0f, projection);
+    glm_mat4_mul(projection, view, viewProjection);
+    Frustum frustum;
+    Frustum_FromViewProjection(&frustum, viewProjection);
+    float projectionScale = projection[1][1] * VIEWPORT_HEIGHT * 0.5f;
+
+    LodChain lods;
+    CreateLods(&lods);
+    GpuCullConstants constants;
+    GpuCullConstants_Init(&constants, &frustum, view, projectionScale, PIXEL_THRESHOLD, &lods, INSTANCE_COUNT);
+    CHECK(constants.LevelCount == 4 && constants.InstanceCount == INSTANCE_COUNT);
+    CHECK(constants.Levels[3].ErrorScale == 0.05f && constants.Levels[2].IndexOffset == 4500);
+    CHECK(constants.ViewDepthRow[2] == 1.0f && constants.ViewDepthRow[3] == 0.0f);
+
+    static GpuCullInstance instances[INSTANCE_COUNT];
+    SphereBounds bounds = { 0 };
+    CHECK(SphereBounds_Resize(&bounds, INSTANCE_COUNT));
+    uint32_t random = 9;
+    for (uint32_t i = 0; i < INSTANCE_COUNT; ++i)
+    {
+        GpuCullInstance* instance = &instances[i];
+        for (int k = 0; k < 16; ++k)
+            instance->Mvp[k] = (float)(i * 16 + k);
+        instance->Bounds[2] = NextRandom(&random) * 250.0f - 20.0f;
+        instance->Bounds[0] = (NextRandom(&random) * 2.4f - 1.2f) * fabsf(instance->Bounds[2]);
+        instance->Bounds[1] = (NextRandom(&random) * 1.4f - 0.7f) * fabsf(instance->Bounds[2]);
+        instance->Bounds[3] = 0.25f + NextRandom(&random) * 4.0f;
+        bounds.X[i] = instance->Bounds[0];
+        bounds.Y[i] = instance->Bounds[1];
+        bounds.Z[i] = instance->Bounds[2];
+        bounds.Radius[i] = instance->Bounds[3];
+    }
+
+    static GpuDrawCommand commands[INSTANCE_COUNT];
+    static uint32_t visible[INSTANCE_COUNT];
+    uint32_t drawCount = GpuCullReference(&constants, instances, commands);
+    size_t visibleCount = FrustumCullSpheresScalar(&frustum, &bounds, visible);
+    CHECK(drawCount == visibleCount);
+    CHECK(drawCount > INSTANCE_COUNT / 5 && drawCount < INSTANCE_COUNT);
+
+    uint32_t levelCounts[LOD_MAX_LEVELS] = { 0 };
+    for (uint32_t d = 0; d < drawCount && d < visibleCount; ++d)
+    {
+        // The MVP of the instance follows it unchanged, marking which one it is
+        const GpuDrawCommand* command = &commands[d];
+        uint32_t instance = visible[d];
+        CHECK(memcmp(command->Mvp, instances[instance].Mvp, sizeof(command->Mvp)) == 0);
+        CHECK(command->Draw.InstanceCount == 1 && command->Draw.BaseVertexLocation == 0 &&
+              command->Draw.StartInstanceLocation == 0);
+
+        if (IsNearLevelBoundary(&lods, bounds.Z[instance], bounds.Radius[instance], projectionScale))
+            continue;
+        uint32_t level = SelectLod(&lods, bounds.Z[instance], bounds.Radius[instance] / lods.Radius,
+                                   projectionScale, PIXEL_THRESHOLD);
+        CHECK(command->Draw.IndexCountPerInstance == lods.Levels[level].IndexCount);
+        CHECK(command->Draw.StartIndexLocation == lods.Levels[level].IndexOffset);
+        levelCounts[level]++;
+    }
+    // The instances spread over the levels
+    for (uint32_t i = 0; i < lods.LevelCount; ++i)
+        CHECK(levelCounts[i] > 0);
+
+    // Nothing to draw without instances
+    constants.InstanceCount = 0;
+    CHECK(GpuCullReference(&constants, instances, commands) == 0);
+    SphereBounds_Release(&bounds);
+}
+
+int main(void)
+{
+    TestLayouts();
+    TestCulling();
+    return TEST_RESULT();
+}
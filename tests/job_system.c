@@ -0,0 +1,195 @@
+// Stress of the work stealing deques: every job of many rounds runs exactly once, whether it
+// was taken by its owner, stolen, pushed by a job or by attached threads, and the pinned jobs
+// only ever run on the main thread
+
+#include "job_system.h"
+#include "test.h"
+
+#include <threads.h>
+
+#define WORKER_COUNT 3
+#define ROUND_COUNT 200
+// Above the capacity of a deque, so full deques run some inline
+#define ROUND_JOB_COUNT 5000
+#define SPAWNER_COUNT 64
+#define SPAWNED_JOB_COUNT 100
+#define ATTACHED_THREAD_COUNT 2
+#define ATTACHED_JOB_COUNT 20000
+
+typedef struct CountedJob
+{
+    atomic_uint Runs;
+    atomic_uint ThreadIndex;
+} CountedJob;
+
+static CountedJob g_Jobs[ATTACHED_THREAD_COUNT * ATTACHED_JOB_COUNT];
+// Jobs that saw a thread index they shouldn't have
+static atomic_uint g_WrongThreads;
+
+static void CountJob(void* userData)
+{
+    CountedJob* job = userData;
+    atomic_fetch_add(&job->Runs, 1);
+    uint32_t threadIndex = JobSystem_GetThreadIndex();
+    atomic_store(&job->ThreadIndex, threadIndex);
+    if (threadIndex >= JobSystem_GetThreadIndexCount())
+        atomic_fetch_add(&g_WrongThreads, 1);
+}
+
+static void ResetJobs(size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        atomic_store(&g_Jobs[i].Runs, 0);
+        atomic_store(&g_Jobs[i].ThreadIndex, UINT32_MAX);
+    }
+}
+
+static bool RanOnce(size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (atomic_load(&g_Jobs[i].Runs) != 1)
+            return false;
+    }
+    return true;
+}
+
+static void RunCounted(size_t first, size_t count, JobCounter* counter)
+{
+    JobDecl jobs[256];
+    for (size_t begin = first; begin < first + count; begin += 256)
+    {
+        size_t batch = first + count - begin < 256 ? first + count - begin : 256;
+        for (size_t i = 0; i < batch; ++i)
+            jobs[i] = (JobDecl){ CountJob, &g_Jobs[begin + i] };
+        JobSystem_Run(jobs, batch, counter);
+    }
+}
+
+// The main thread pushes while the workers steal, and takes its own jobs back while waiting
+static void TestRounds(void)
+{
+    bool ranOnce = true;
+    bool stolen = false;
+    for (int round = 0; round < ROUND_COUNT; ++round)
+    {
+        ResetJobs(ROUND_JOB_COUNT);
+        JobCounter counter;
+        atomic_init(&counter.Pending, 0);
+        RunCounted(0, ROUND_JOB_COUNT, &counter);
+        JobSystem_Wait(&counter);
+        ranOnce = ranOnce && RanOnce(ROUND_JOB_COUNT);
+        for (size_t i = 0; i < ROUND_JOB_COUNT && !stolen; ++i)
+            stolen = atomic_load(&g_Jobs[i].ThreadIndex) != 0;
+    }
+    CHECK(ranOnce);
+    CHECK(stolen);
+}
+
+// Jobs that push jobs to the deques of the workers and wait on them there
+static void SpawnJobs(void* userData)
+{
+    size_t spawner = (size_t)(uintptr_t)userData;
+    JobCounter counter;
+    atomic_init(&counter.Pending, 0);
+    RunCounted(spawner * SPAWNED_JOB_COUNT, SPAWNED_JOB_COUNT, &counter);
+    JobSystem_Wait(&counter);
+}
+
+static void TestNested(void)
+{
+    ResetJobs(SPAWNER_COUNT * SPAWNED_JOB_COUNT);
+    JobDecl spawners[SPAWNER_COUNT];
+    for (size_t i = 0; i < SPAWNER_COUNT; ++i)
+        spawners[i] = (JobDecl){ SpawnJobs, (void*)(uintptr_t)i };
+    JobCounter counter;
+    atomic_init(&counter.Pending, 0);
+    JobSystem_Run(spawners, SPAWNER_COUNT, &counter);
+    JobSystem_Wait(&counter);
+    CHECK(RanOnce(SPAWNER_COUNT * SPAWNED_JOB_COUNT));
+}
+
+// Threads from outside pushing to their own deques at the same time as the main thread
+static int AttachedThreadMain(void* argument)
+{
+    size_t thread = (size_t)(uintptr_t)argument;
+    if (!JobSystem_AttachThread())
+        return 1;
+    if (JobSystem_GetThreadIndex() <= WORKER_COUNT)
+        atomic_fetch_add(&g_WrongThreads, 1);
+
+    JobCounter counter;
+    atomic_init(&counter.Pending, 0);
+    RunCounted(thread * ATTACHED_JOB_COUNT, ATTACHED_JOB_COUNT, &counter);
+    JobSystem_Wait(&counter);
+    JobSystem_DetachThread();
+    return 0;
+}
+
+static void TestAttached(void)
+{
+    ResetJobs(ATTACHED_THREAD_COUNT * ATTACHED_JOB_COUNT);
+    thrd_t threads[ATTACHED_THREAD_COUNT];
+    for (size_t i = 0; i < ATTACHED_THREAD_COUNT; ++i)
+        CHECK(thrd_create(&threads[i], AttachedThreadMain, (void*)(uintptr_t)i) == thrd_success);
+    for (size_t i = 0; i < ATTACHED_THREAD_COUNT; ++i)
+    {
+        int result = 1;
+        thrd_join(threads[i], &result);
+        CHECK(result == 0);
+    }
+    CHECK(RanOnce(ATTACHED_THREAD_COUNT * ATTACHED_JOB_COUNT));
+    CHECK(JobSystem_GetThreadIndex() == 0);
+}
+
+// Workers pin jobs, only the main thread runs them, while it waits or between frames
+static atomic_uint g_PinnedQueued;
+
+static void PinJob(void* userData)
+{
+    if (JobSystem_RunPinned((JobDecl){ CountJob, userData }, NULL))
+        atomic_fetch_add(&g_PinnedQueued, 1);
+}
+
+static void TestPinned(void)
+{
+    ResetJobs(SPAWNER_COUNT * 2);
+    atomic_store(&g_PinnedQueued, 0);
+    JobDecl jobs[SPAWNER_COUNT];
+    for (size_t i = 0; i < SPAWNER_COUNT; ++i)
+        jobs[i] = (JobDecl){ PinJob, &g_Jobs[i] };
+    JobCounter counter;
+    atomic_init(&counter.Pending, 0);
+    JobSystem_Run(jobs, SPAWNER_COUNT, &counter);
+    JobSystem_Wait(&counter);
+    JobSystem_RunPinnedJobs();
+    CHECK(atomic_load(&g_PinnedQueued) == SPAWNER_COUNT);
+
+    // Waited on like the other jobs, the counter covers them once they're queued
+    for (size_t i = 0; i < SPAWNER_COUNT; ++i)
+        CHECK(JobSystem_RunPinned((JobDecl){ CountJob, &g_Jobs[SPAWNER_COUNT + i] }, &counter));
+    CHECK(!JobCounter_IsDone(&counter));
+    JobSystem_Wait(&counter);
+
+    CHECK(RanOnce(SPAWNER_COUNT * 2));
+    bool onMainThread = true;
+    for (size_t i = 0; i < SPAWNER_COUNT * 2; ++i)
+        onMainThread = onMainThread && atomic_load(&g_Jobs[i].ThreadIndex) == 0;
+    CHECK(onMainThread);
+}
+
+int main(void)
+{
+    CHECK(JobSystem_Initialise(WORKER_COUNT));
+    CHECK(JobSystem_GetThreadCount() == WORKER_COUNT + 1);
+    CHECK(JobSystem_GetThreadIndex() == 0);
+    TestRounds();
+    TestNested();
+    TestAttached();
+    TestPinned();
+    CHECK(atomic_load(&g_WrongThreads) == 0);
+    JobSystem_Shutdown();
+    CHECK(JobSystem_GetThreadIndex() == UINT32_MAX);
+    return TEST_RESULT();
+}
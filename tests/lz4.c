@@ -0,0 +1,166 @@
+// LZ4 blocks: data of every kind decodes back to itself, a block written by hand decodes as
+// the format says, and malformed blocks are rejected without writing past the output
+
+#include "lz4.h"
+#include "test.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_SIZE (300 * 1024)
+// Written after the output, a decoder going past it changes them
+#define CANARY_SIZE 64
+#define CANARY 0xCD
+
+static uint8_t g_Data[MAX_SIZE];
+static uint8_t g_Compressed[MAX_SIZE + MAX_SIZE / 255 + 16];
+static uint8_t g_Decompressed[MAX_SIZE + CANARY_SIZE];
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+typedef enum DataKind
+{
+    // Incompressible, stored as a single run of literals
+    DATA_RANDOM,
+    // Long runs of a byte, matches at offset 1 with lengths over 255
+    DATA_RUNS,
+    // Records that repeat with small changes, matches at all sorts of offsets
+    DATA_RECORDS,
+    // A random block repeated further apart than the largest offset, and closer
+    DATA_FAR,
+    DATA_KIND_COUNT
+} DataKind;
+
+static void CreateData(DataKind kind, size_t size)
+{
+    uint32_t random = (uint32_t)size + kind;
+    for (size_t i = 0; i < size; ++i)
+    {
+        switch (kind)
+        {
+            case DATA_RANDOM:
+                g_Data[i] = (uint8_t)NextRandom(&random);
+                break;
+            case DATA_RUNS:
+                g_Data[i] = (uint8_t)(i / 1000 % 3);
+                break;
+            case DATA_RECORDS:
+                g_Data[i] = NextRandom(&random) % 16 == 0 ? (uint8_t)NextRandom(&random) : (uint8_t)(i % 24 + i / 240);
+                break;
+            default:
+                g_Data[i] = i < 70000 ? (uint8_t)NextRandom(&random) : g_Data[i - (i < 140000 ? 70000 : 3)];
+                break;
+        }
+    }
+}
+
+static bool CanaryIntact(size_t size)
+{
+    for (size_t i = size; i < size + CANARY_SIZE; ++i)
+    {
+        if (g_Decompressed[i] != CANARY)
+            return false;
+    }
+    return true;
+}
+
+static bool Decompress(const void* compressed, size_t compressedSize, size_t size)
+{
+    memset(g_Decompressed, CANARY, size + CANARY_SIZE);
+    bool decompressed = Lz4_Decompress(compressed, compressedSize, g_Decompressed, size);
+    CHECK(CanaryIntact(size));
+    return decompressed;
+}
+
+// Sizes around the end of the match search and the lengths that take a byte more
+static void TestRoundTrip(void)
+{
+    static const size_t sizes[] = { 0, 1, 5, 12, 13, 17, 255, 270, 4096, 65535, 65536, 200000, MAX_SIZE };
+    for (int kind = 0; kind < DATA_KIND_COUNT; ++kind)
+    {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+        {
+            size_t size = sizes[s];
+            CreateData(kind, size);
+            size_t compressedSize = Lz4_Compress(g_Data, size, g_Compressed, Lz4_GetMaxCompressedSize(size));
+            CHECK(compressedSize > 0 && compressedSize <= Lz4_GetMaxCompressedSize(size));
+            CHECK(Decompress(g_Compressed, compressedSize, size));
+            CHECK(memcmp(g_Decompressed, g_Data, size) == 0);
+            if ((kind == DATA_RUNS || kind == DATA_RECORDS) && size >= 4096)
+                CHECK(compressedSize < size);
+        }
+    }
+
+    // Too little room for the block
+    CreateData(DATA_RANDOM, 4096);
+    CHECK(Lz4_Compress(g_Data, 4096, g_Compressed, 4096) == 0);
+}
+
+// Literals, a match overlapping its own output and the last literals, as any LZ4 writes them
+static void TestFormat(void)
+{
+    static const uint8_t block[] = { 0x44, 'a', 'b', 'c', 'd', 4, 0, 0x50, 'e', 'f', 'g', 'h', 'i' };
+    CHECK(Decompress(block, sizeof(block), 17));
+    CHECK(memcmp(g_Decompressed, "abcdabcdabcdefghi", 17) == 0);
+
+    // A byte too few or too many for the block
+    CHECK(!Decompress(block, sizeof(block), 16));
+    CHECK(!Decompress(block, sizeof(block), 18));
+}
+
+static void TestMalformed(void)
+{
+    // Offsets before the start of the output, and 0
+    static const uint8_t farOffset[] = { 0x40, 'a', 'b', 'c', 'd', 5, 0, 0x10, 'e' };
+    CHECK(!Decompress(farOffset, sizeof(farOffset), 13));
+    static const uint8_t zeroOffset[] = { 0x40, 'a', 'b', 'c', 'd', 0, 0, 0x10, 'e' };
+    CHECK(!Decompress(zeroOffset, sizeof(zeroOffset), 13));
+
+    // More literals than the block holds, in the token and in the length bytes
+    static const uint8_t shortLiterals[] = { 0x50, 'a', 'b' };
+    CHECK(!Decompress(shortLiterals, sizeof(shortLiterals), 5));
+    static const uint8_t longLiterals[] = { 0xF0, 200, 'a', 'b' };
+    CHECK(!Decompress(longLiterals, sizeof(longLiterals), 215));
+    static const uint8_t missingLength[] = { 0xF0 };
+    CHECK(!Decompress(missingLength, sizeof(missingLength), 15));
+
+    // A match longer than the output left, the decoder stops before writing it
+    static const uint8_t longMatch[] = { 0x4F, 'a', 'b', 'c', 'd', 1, 0, 255, 255, 0x10, 'e' };
+    CHECK(!Decompress(longMatch, sizeof(longMatch), 100));
+
+    // A match without its offset, and an empty block
+    static const uint8_t missingOffset[] = { 0x40, 'a', 'b', 'c', 'd', 1 };
+    CHECK(!Decompress(missingOffset, sizeof(missingOffset), 8));
+    CHECK(!Decompress(missingOffset, 0, 0));
+
+    // Every prefix of a real block
+    CreateData(DATA_RECORDS, 20000);
+    size_t compressedSize = Lz4_Compress(g_Data, 20000, g_Compressed, sizeof(g_Compressed));
+    bool rejected = true;
+    for (size_t truncated = 0; truncated < compressedSize; ++truncated)
+        rejected = rejected && !Decompress(g_Compressed, truncated, 20000);
+    CHECK(rejected);
+
+    // Flipped bytes either fail or decode to something else, never out of bounds
+    uint32_t random = 7;
+    for (int i = 0; i < 2000; ++i)
+    {
+        size_t position = NextRandom(&random) % compressedSize;
+        uint8_t original = g_Compressed[position];
+        g_Compressed[position] ^= (uint8_t)(1 + NextRandom(&random) % 255);
+        Decompress(g_Compressed, compressedSize, 20000);
+        g_Compressed[position] = original;
+    }
+}
+
+int main(void)
+{
+    TestRoundTrip();
+    TestFormat();
+    TestMalformed();
+    return TEST_RESULT();
+}
@@ -0,0 +1,173 @@
+// Index buffer optimization of a grid with its triangles shuffled: every pass keeps the
+// triangles of the mesh and the cache pass brings the ACMR down to that of a strip order
+
+#include "mesh_optimizer.h"
+#include "test.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define GRID_SIZE 96
+#define VERTEX_COUNT (GRID_SIZE * GRID_SIZE)
+#define INDEX_COUNT ((GRID_SIZE - 1) * (GRID_SIZE - 1) * 6)
+
+typedef struct GridVertex
+{
+    float Position[3];
+    // Index of the vertex in the grid, follows the vertex through the remapping
+    uint32_t Id;
+} GridVertex;
+
+static GridVertex g_Vertices[VERTEX_COUNT + 1];
+static uint32_t g_Indices[INDEX_COUNT];
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// A grid on the XY plane bending away from the camera, with one vertex no triangle uses
+static void CreateGrid(void)
+{
+    for (uint32_t y = 0; y < GRID_SIZE; ++y)
+    {
+        for (uint32_t x = 0; x < GRID_SIZE; ++x)
+        {
+            float u = (float)x / (GRID_SIZE - 1) - 0.5f;
+            float v = (float)y / (GRID_SIZE - 1) - 0.5f;
+            g_Vertices[y * GRID_SIZE + x] = (GridVertex){ { u, v, u * u + v * v }, y * GRID_SIZE + x };
+        }
+    }
+    g_Vertices[VERTEX_COUNT] = (GridVertex){ { 0.0f, 0.0f, -1.0f }, VERTEX_COUNT };
+
+    uint32_t* index = g_Indices;
+    for (uint32_t y = 0; y + 1 < GRID_SIZE; ++y)
+    {
+        for (uint32_t x = 0; x + 1 < GRID_SIZE; ++x)
+        {
+            uint32_t v = y * GRID_SIZE + x;
+            uint32_t quad[6] = { v, v + GRID_SIZE, v + 1, v + 1, v + GRID_SIZE, v + GRID_SIZE + 1 };
+            memcpy(index, quad, sizeof(quad));
+            index += 6;
+        }
+    }
+
+    // Shuffled triangles leave the cache nothing to reuse
+    uint32_t state = 3;
+    for (uint32_t t = INDEX_COUNT / 3 - 1; t > 0; --t)
+    {
+        uint32_t other = NextRandom(&state) % (t + 1);
+        uint32_t triangle[3];
+        memcpy(triangle, &g_Indices[t * 3], sizeof(triangle));
+        memcpy(&g_Indices[t * 3], &g_Indices[other * 3], sizeof(triangle));
+        memcpy(&g_Indices[other * 3], triangle, sizeof(triangle));
+    }
+}
+
+static int CompareTriangles(const void* a, const void* b)
+{
+    const uint32_t* x = a;
+    const uint32_t* y = b;
+    for (int k = 0; k < 3; ++k)
+    {
+        if (x[k] != y[k])
+            return x[k] < y[k] ? -1 : 1;
+    }
+    return 0;
+}
+
+// The triangles in a canonical order, each rotated to start at its smallest index so the
+// winding is kept
+static void Canonicalize(uint32_t* triangles, const uint32_t* indices, const GridVertex* vertices)
+{
+    for (size_t t = 0; t < INDEX_COUNT / 3; ++t)
+    {
+        uint32_t ids[3];
+        for (int k = 0; k < 3; ++k)
+            ids[k] = vertices != NULL ? vertices[indices[t * 3 + k]].Id : indices[t * 3 + k];
+        int first = ids[0] < ids[1] ? (ids[0] < ids[2] ? 0 : 2) : (ids[1] < ids[2] ? 1 : 2);
+        for (int k = 0; k < 3; ++k)
+            triangles[t * 3 + k] = ids[(first + k) % 3];
+    }
+    qsort(triangles, INDEX_COUNT / 3, 3 * sizeof(uint32_t), CompareTriangles);
+}
+
+static bool HasSameTriangles(const uint32_t* indices, const GridVertex* vertices)
+{
+    static uint32_t expected[INDEX_COUNT];
+    static uint32_t actual[INDEX_COUNT];
+    Canonicalize(expected, g_Indices, NULL);
+    Canonicalize(actual, indices, vertices);
+    return memcmp(expected, actual, sizeof(expected)) == 0;
+}
+
+static void TestVertexCache(void)
+{
+    static uint32_t optimized[INDEX_COUNT];
+    OptimizeVertexCache(optimized, g_Indices, INDEX_COUNT, VERTEX_COUNT + 1);
+    CHECK(HasSameTriangles(optimized, NULL));
+
+    float before = ComputeACMR(g_Indices, INDEX_COUNT, VERTEX_COUNT + 1, MESH_OPTIMIZER_FIFO_SIZE);
+    float after = ComputeACMR(optimized, INDEX_COUNT, VERTEX_COUNT + 1, MESH_OPTIMIZER_FIFO_SIZE);
+    // A grid has half a vertex per triangle, shuffled nearly every corner misses
+    CHECK(before > 2.5f);
+    CHECK(after < 0.8f);
+    CHECK(ComputeATVR(optimized, INDEX_COUNT, VERTEX_COUNT + 1, MESH_OPTIMIZER_FIFO_SIZE) >= 1.0f);
+
+    // The overdraw pass gives up at most the threshold of the cache efficiency
+    static uint32_t sorted[INDEX_COUNT];
+    OptimizeOverdraw(sorted, optimized, INDEX_COUNT, g_Vertices[0].Position, sizeof(GridVertex),
+                     VERTEX_COUNT + 1, 1.05f);
+    CHECK(HasSameTriangles(sorted, NULL));
+    CHECK(ComputeACMR(sorted, INDEX_COUNT, VERTEX_COUNT + 1, MESH_OPTIMIZER_FIFO_SIZE) <= after * 1.05f + 0.01f);
+}
+
+static void TestOptimizeMesh(void)
+{
+    static uint32_t indices[INDEX_COUNT];
+    static GridVertex vertices[VERTEX_COUNT + 1];
+    memcpy(indices, g_Indices, sizeof(indices));
+    memcpy(vertices, g_Vertices, sizeof(vertices));
+
+    MeshOptimizationStats stats;
+    CHECK(OptimizeMesh(indices, INDEX_COUNT, vertices, VERTEX_COUNT + 1, sizeof(GridVertex),
+                       offsetof(GridVertex, Position), &stats));
+    CHECK(HasSameTriangles(indices, vertices));
+    CHECK(stats.UniqueVertexCount == VERTEX_COUNT);
+    CHECK(stats.AcmrAfter < stats.AcmrBefore);
+    CHECK(stats.IndexSize == 2);
+
+    // The vertices are stored in the order the indices first use them
+    uint32_t next = 0;
+    for (size_t i = 0; i < INDEX_COUNT; ++i)
+    {
+        CHECK(indices[i] <= next);
+        if (indices[i] == next)
+            ++next;
+    }
+    CHECK(next == VERTEX_COUNT);
+    for (uint32_t v = 0; v < VERTEX_COUNT; ++v)
+        CHECK(memcmp(vertices[v].Position, g_Vertices[vertices[v].Id].Position, sizeof(vertices[v].Position)) == 0);
+}
+
+static void TestIndexSize(void)
+{
+    // 0xFFFF is the strip cut value, so the last vertex a 16 bit index holds is 0xFFFE
+    CHECK(SelectIndexSize(0xFFFF - 1) == 2);
+    CHECK(SelectIndexSize(0xFFFF) == 4);
+
+    uint32_t indices[3] = { 0, 1, 0xFFFE };
+    uint16_t packed[3];
+    PackIndices(packed, indices, 3, 2);
+    CHECK(packed[0] == 0 && packed[1] == 1 && packed[2] == 0xFFFE);
+}
+
+int main(void)
+{
+    CreateGrid();
+    TestVertexCache();
+    TestOptimizeMesh();
+    TestIndexSize();
+    return TEST_RESULT();
+}
@@ -0,0 +1,199 @@
+// Quadric simplification of height fields: a flat one collapses to a handful of triangles
+// without error, a curved one stays within the error it reports and the levels of its chain
+// get coarser with growing errors
+
+#include "mesh_simplifier.h"
+#include "test.h"
+
+#include <math.h>
+#include <string.h>
+
+#define GRID_SIZE 48
+#define VERTEX_COUNT (GRID_SIZE * GRID_SIZE)
+#define INDEX_COUNT ((GRID_SIZE - 1) * (GRID_SIZE - 1) * 6)
+
+static float g_Positions[VERTEX_COUNT][3];
+static uint32_t g_Indices[INDEX_COUNT];
+
+// Over the unit square, counter-clockwise seen from +Z
+static void CreateGrid(float amplitude)
+{
+    for (uint32_t y = 0; y < GRID_SIZE; ++y)
+    {
+        for (uint32_t x = 0; x < GRID_SIZE; ++x)
+        {
+            float u = (float)x / (GRID_SIZE - 1);
+            float v = (float)y / (GRID_SIZE - 1);
+            g_Positions[y * GRID_SIZE + x][0] = u;
+            g_Positions[y * GRID_SIZE + x][1] = v;
+            g_Positions[y * GRID_SIZE + x][2] = amplitude * sinf(3.0f * u) * cosf(2.0f * v);
+        }
+    }
+    uint32_t* index = g_Indices;
+    for (uint32_t y = 0; y + 1 < GRID_SIZE; ++y)
+    {
+        for (uint32_t x = 0; x + 1 < GRID_SIZE; ++x)
+        {
+            uint32_t v = y * GRID_SIZE + x;
+            uint32_t quad[6] = { v, v + 1, v + GRID_SIZE, v + 1, v + GRID_SIZE + 1, v + GRID_SIZE };
+            memcpy(index, quad, sizeof(quad));
+            index += 6;
+        }
+    }
+}
+
+// Z of the normal of the triangle projected on the XY plane, twice its area
+static float GetSignedArea(const uint32_t* triangle)
+{
+    const float* a = g_Positions[triangle[0]];
+    const float* b = g_Positions[triangle[1]];
+    const float* c = g_Positions[triangle[2]];
+    return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+// Every triangle is valid and none folds over, together they still cover the unit square. A
+// collapse along the curved border can leave a triangle standing on it, edge on from above.
+static bool IsValidSurface(const uint32_t* indices, size_t indexCount)
+{
+    double area = 0.0;
+    for (size_t t = 0; t < indexCount / 3; ++t)
+    {
+        const uint32_t* triangle = &indices[t * 3];
+        if (triangle[0] >= VERTEX_COUNT || triangle[1] >= VERTEX_COUNT || triangle[2] >= VERTEX_COUNT)
+            return false;
+        if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+            return false;
+        float signedArea = GetSignedArea(triangle);
+        if (signedArea < 0.0f)
+            return false;
+        area += 0.5 * signedArea;
+    }
+    return fabs(area - 1.0) < 1e-4;
+}
+
+// Largest vertical distance of the source vertices to the simplified surface
+static float GetMaxDeviation(const uint32_t* indices, size_t indexCount)
+{
+    float maxDeviation = 0.0f;
+    for (uint32_t v = 0; v < VERTEX_COUNT; ++v)
+    {
+        const float* p = g_Positions[v];
+        for (size_t t = 0; t < indexCount / 3; ++t)
+        {
+            const float* a = g_Positions[indices[t * 3 + 0]];
+            const float* b = g_Positions[indices[t * 3 + 1]];
+            const float* c = g_Positions[indices[t * 3 + 2]];
+            float area = GetSignedArea(&indices[t * 3]);
+            if (area <= 0.0f)
+                continue;
+            float wb = ((p[0] - a[0]) * (c[1] - a[1]) - (p[1] - a[1]) * (c[0] - a[0])) / area;
+            float wc = ((b[0] - a[0]) * (p[1] - a[1]) - (b[1] - a[1]) * (p[0] - a[0])) / area;
+            float wa = 1.0f - wb - wc;
+            if (wa < -1e-5f || wb < -1e-5f || wc < -1e-5f)
+                continue;
+            float z = wa * a[2] + wb * b[2] + wc * c[2];
+            maxDeviation = fmaxf(maxDeviation, fabsf(z - p[2]));
+            break;
+        }
+    }
+    return maxDeviation;
+}
+
+static void TestFlat(void)
+{
+    CreateGrid(0.0f);
+    static uint32_t simplified[INDEX_COUNT];
+    float error = -1.0f;
+    size_t count = SimplifyMesh(simplified, g_Indices, INDEX_COUNT, g_Positions[0], sizeof(g_Positions[0]),
+                                VERTEX_COUNT, 0, 1e-4f, &error);
+    // Only the collapses along the border and into the corners cost anything
+    CHECK(count < INDEX_COUNT / 20);
+    CHECK(error >= 0.0f && error < 1e-5f);
+    CHECK(IsValidSurface(simplified, count));
+    CHECK(GetMaxDeviation(simplified, count) == 0.0f);
+}
+
+static void TestCurved(void)
+{
+    CreateGrid(0.2f);
+    static uint32_t simplified[INDEX_COUNT];
+    const float maxErrors[] = { 1e-4f, 1e-3f, 1e-2f };
+    size_t previousCount = INDEX_COUNT + 1;
+    for (int i = 0; i < 3; ++i)
+    {
+        float error;
+        size_t count = SimplifyMesh(simplified, g_Indices, INDEX_COUNT, g_Positions[0], sizeof(g_Positions[0]),
+                                    VERTEX_COUNT, 0, maxErrors[i], &error);
+        // A larger error allows more collapses
+        CHECK(count < previousCount);
+        CHECK(error <= maxErrors[i]);
+        CHECK(IsValidSurface(simplified, count));
+        // The quadrics measure the distance to the planes of the source triangles, which bounds
+        // how far the surface moves away from the source vertices
+        CHECK(GetMaxDeviation(simplified, count) <= maxErrors[i]);
+        previousCount = count;
+    }
+
+    // The target stops the collapses before the error does
+    float error;
+    size_t count = SimplifyMesh(simplified, g_Indices, INDEX_COUNT, g_Positions[0], sizeof(g_Positions[0]),
+                                VERTEX_COUNT, INDEX_COUNT / 2, 1.0f, &error);
+    CHECK(count <= INDEX_COUNT / 2 && count > INDEX_COUNT / 4);
+    CHECK(IsValidSurface(simplified, count));
+}
+
+static void TestLodChain(void)
+{
+    CreateGrid(0.2f);
+    LodChain chain;
+    CHECK(BuildLodChain(g_Indices, INDEX_COUNT, g_Positions[0], sizeof(g_Positions[0]), VERTEX_COUNT,
+                        LOD_MAX_LEVELS, 0.5f, 0.05f, &chain));
+    CHECK(chain.LevelCount > 3);
+    CHECK(chain.Levels[0].IndexCount == INDEX_COUNT && chain.Levels[0].Error == 0.0f);
+    CHECK(memcmp(chain.Indices, g_Indices, sizeof(g_Indices)) == 0);
+    CHECK(fabsf(chain.Center[0] - 0.5f) < 1e-6f && fabsf(chain.Center[1] - 0.5f) < 1e-6f);
+
+    size_t offset = 0;
+    for (uint32_t i = 0; i < chain.LevelCount; ++i)
+    {
+        const LodLevel* level = &chain.Levels[i];
+        CHECK(level->IndexOffset == offset);
+        CHECK(IsValidSurface(chain.Indices + level->IndexOffset, level->IndexCount));
+        CHECK(level->Error <= 0.05f * chain.Radius);
+        if (i > 0)
+        {
+            // Each level aims for half the triangles of the previous one, the last collapse
+            // can take out two past it
+            CHECK(level->IndexCount < chain.Levels[i - 1].IndexCount);
+            CHECK(level->IndexCount + 6 >= chain.Levels[i - 1].IndexCount / 2);
+            CHECK(level->Error >= chain.Levels[i - 1].Error);
+        }
+        offset += level->IndexCount;
+    }
+    CHECK(offset == chain.IndexCount);
+
+    // Close up the source is drawn, far away the coarsest level, in between the levels get
+    // coarser with the distance
+    const float projectionScale = 1000.0f;
+    CHECK(SelectLod(&chain, 1.0f, 1.0f, projectionScale, 1.0f) == 0);
+    CHECK(SelectLod(&chain, 1e6f, 1.0f, projectionScale, 1.0f) == chain.LevelCount - 1);
+    uint32_t previous = 0;
+    for (float depth = 1.0f; depth < 1e4f; depth *= 1.5f)
+    {
+        uint32_t selected = SelectLod(&chain, depth, 1.0f, projectionScale, 1.0f);
+        CHECK(selected >= previous);
+        // The error of the selected level projects to less than the threshold
+        if (selected > 0)
+            CHECK(chain.Levels[selected].Error * projectionScale / (depth - chain.Radius) <= 1.0f + 1e-5f);
+        previous = selected;
+    }
+    LodChain_Release(&chain);
+}
+
+int main(void)
+{
+    TestFlat();
+    TestCurved();
+    TestLodChain();
+    return TEST_RESULT();
+}
@@ -0,0 +1,140 @@
+// The SIMD mip chains across the workers against the scalar reference: odd and non-square
+// sizes down to 1x1, both filters, sRGB and linear, every texel within 1 of the reference
+
+#include "mip_generator.h"
+#include "parallel.h"
+#include "test.h"
+
+#include <string.h>
+
+#define MAX_TEXELS (256 * 256)
+#define MAX_ROWS 256
+// Padding at the end of the rows of the source, like an image in a larger buffer
+#define ROW_PADDING 12
+
+static uint8_t g_Image[MAX_TEXELS * 4 + MAX_ROWS * ROW_PADDING];
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// Noise on top of gradients, the noise is where the rounding of the two paths differs most
+static void CreateImage(uint32_t width, uint32_t height, size_t rowPitch)
+{
+    uint32_t random = width * 31 + height;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint8_t* texel = &g_Image[y * rowPitch + x * 4];
+            texel[0] = (uint8_t)NextRandom(&random);
+            texel[1] = (uint8_t)(x * 255 / width);
+            texel[2] = (uint8_t)(y * 255 / height);
+            texel[3] = (uint8_t)(NextRandom(&random) % 2 ? 255 : NextRandom(&random));
+        }
+    }
+}
+
+static int GetMaxDifference(const MipChain* first, const MipChain* second)
+{
+    int maxDifference = 0;
+    for (uint32_t i = 0; i < first->LevelCount; ++i)
+    {
+        const MipLevel* level = &first->Levels[i];
+        for (uint32_t y = 0; y < level->Height; ++y)
+        {
+            const uint8_t* a = level->Rgba + y * level->RowPitch;
+            const uint8_t* b = second->Levels[i].Rgba + y * second->Levels[i].RowPitch;
+            for (size_t x = 0; x < (size_t)level->Width * 4; ++x)
+                maxDifference = abs(a[x] - b[x]) > maxDifference ? abs(a[x] - b[x]) : maxDifference;
+        }
+    }
+    return maxDifference;
+}
+
+// Every level halves the previous one rounding down, the first one is the image
+static bool HasLevels(const MipChain* chain, uint32_t width, uint32_t height, size_t rowPitch)
+{
+    bool valid = chain->LevelCount == GetMipLevelCount(width, height);
+    for (uint32_t i = 0; valid && i < chain->LevelCount; ++i)
+    {
+        const MipLevel* level = &chain->Levels[i];
+        valid = level->Width == (width >> i > 0 ? width >> i : 1) &&
+                level->Height == (height >> i > 0 ? height >> i : 1) && level->RowPitch >= (size_t)level->Width * 4;
+    }
+    const MipLevel* last = &chain->Levels[chain->LevelCount - 1];
+    valid = valid && last->Width == 1 && last->Height == 1;
+    for (uint32_t y = 0; valid && y < height; ++y)
+        valid = memcmp(chain->Levels[0].Rgba + y * chain->Levels[0].RowPitch, g_Image + y * rowPitch, (size_t)width * 4) == 0;
+    return valid;
+}
+
+static void TestAgainstScalar(void)
+{
+    static const uint32_t sizes[][2] = {
+        { 256, 256 }, { 255, 129 }, { 1000, 37 }, { 67, 3 }, { 3, 67 }, { 1, 17 }, { 5, 1 }, { 2, 2 }, { 1, 1 }
+    };
+    static const MipFilter filters[] = { MIP_FILTER_BOX, MIP_FILTER_KAISER };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        uint32_t width = sizes[s][0];
+        uint32_t height = sizes[s][1];
+        size_t rowPitch = (size_t)width * 4 + ROW_PADDING;
+        CreateImage(width, height, rowPitch);
+        for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f)
+        {
+            for (int srgb = 0; srgb < 2; ++srgb)
+            {
+                MipChain chain;
+                MipChain reference;
+                CHECK(GenerateMips(g_Image, width, height, rowPitch, srgb, filters[f], 0, &chain));
+                CHECK(GenerateMipsScalar(g_Image, width, height, rowPitch, srgb, filters[f], 0, &reference));
+                CHECK(HasLevels(&chain, width, height, rowPitch));
+                CHECK(HasLevels(&reference, width, height, rowPitch));
+                CHECK(GetMaxDifference(&chain, &reference) <= 1);
+                MipChain_Release(&reference);
+                MipChain_Release(&chain);
+            }
+        }
+    }
+}
+
+// A single color stays the same at every level, sRGB or not, and a shorter chain stops early
+static void TestSolidColor(void)
+{
+    uint32_t width = 24;
+    uint32_t height = 10;
+    for (size_t i = 0; i < width * height; ++i)
+        memcpy(&g_Image[i * 4], (uint8_t[4]){ 10, 128, 250, 77 }, 4);
+
+    for (int srgb = 0; srgb < 2; ++srgb)
+    {
+        MipChain chain;
+        CHECK(GenerateMips(g_Image, width, height, (size_t)width * 4, srgb, MIP_FILTER_BOX, 3, &chain));
+        CHECK(chain.LevelCount == 3);
+        bool same = true;
+        for (uint32_t i = 0; i < chain.LevelCount; ++i)
+        {
+            const MipLevel* level = &chain.Levels[i];
+            for (uint32_t y = 0; y < level->Height; ++y)
+            {
+                for (uint32_t x = 0; x < level->Width; ++x)
+                    same = same && memcmp(level->Rgba + y * level->RowPitch + x * 4, g_Image, 4) == 0;
+            }
+        }
+        CHECK(same);
+        MipChain_Release(&chain);
+    }
+}
+
+int main(void)
+{
+    CHECK(Parallel_Initialise(3));
+    CHECK(GetMipLevelCount(1, 1) == 1 && GetMipLevelCount(256, 1) == 9 && GetMipLevelCount(255, 129) == 8);
+    TestAgainstScalar();
+    TestSolidColor();
+    Parallel_Shutdown();
+    return TEST_RESULT();
+}
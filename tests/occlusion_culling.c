@@ -0,0 +1,240 @@
+// Software occlusion culling of bounds behind a wall: the SIMD rasterizer writes the depth of
+// the scalar one, the pyramid test never culls what the scalar reference keeps, and neither
+// culls bounds in front of the wall or beside it
+
+#define CGLM_FORCE_LEFT_HANDED
+
+#include "occlusion_culling.h"
+#include "parallel.h"
+#include "test.h"
+
+#include <math.h>
+#include <string.h>
+
+#define WIDTH 250
+#define HEIGHT 120
+#define BOUND_COUNT 4000
+#define WALL_DEPTH 10.0f
+#define WALL_HALF_SIZE 4.0f
+// Of the screen angle, keeps the classification clear of the pixel snapping at the wall edges
+#define MARGIN 0.05f
+
+// A square wall facing the camera at the origin, its triangles clockwise on the screen
+static const float g_WallPositions[4][3] = {
+    { -WALL_HALF_SIZE, WALL_HALF_SIZE, WALL_DEPTH }, { WALL_HALF_SIZE, WALL_HALF_SIZE, WALL_DEPTH },
+    { WALL_HALF_SIZE, -WALL_HALF_SIZE, WALL_DEPTH }, { -WALL_HALF_SIZE, -WALL_HALF_SIZE, WALL_DEPTH }
+};
+static const uint32_t g_WallIndices[6] = { 0, 1, 2, 0, 2, 3 };
+// The same wall seen from behind
+static const uint32_t g_BackIndices[6] = { 0, 2, 1, 0, 3, 2 };
+
+typedef enum Expectation
+{
+    EXPECT_HIDDEN,
+    EXPECT_VISIBLE,
+    EXPECT_EITHER
+} Expectation;
+
+static float NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) / 16777216.0f;
+}
+
+// Whether a sphere is wholly behind the wall, in front of it or beside it, by the angles it
+// spans seen from the camera
+static Expectation Classify(float x, float y, float z, float radius)
+{
+    const float wallSlope = WALL_HALF_SIZE / WALL_DEPTH;
+    float nearest = z - radius;
+    if (nearest > WALL_DEPTH && fmaxf(fabsf(x), fabsf(y)) + radius < (wallSlope - MARGIN) * nearest)
+        return EXPECT_HIDDEN;
+    if (z + radius < WALL_DEPTH || fmaxf(fabsf(x), fabsf(y)) - radius > (wallSlope + MARGIN) * (z + radius))
+        return EXPECT_VISIBLE;
+    return EXPECT_EITHER;
+}
+
+static void CreateBuffer(OcclusionBuffer* buffer, mat4 viewProjection, bool scalar)
+{
+    CHECK(OcclusionBuffer_Create(buffer, WIDTH, HEIGHT));
+    OccluderMesh wall = { g_WallPositions[0], sizeof(g_WallPositions[0]), 4, g_WallIndices, 6 };
+    OccluderMesh back = { g_WallPositions[0], sizeof(g_WallPositions[0]), 4, g_BackIndices, 6 };
+    OcclusionBuffer_Clear(buffer);
+    CHECK(OcclusionBuffer_AddOccluder(buffer, viewProjection, &wall));
+    CHECK(buffer->TriangleCount == 2);
+    CHECK(OcclusionBuffer_AddOccluder(buffer, viewProjection, &back));
+    CHECK(buffer->TriangleCount == 2);
+    if (scalar)
+        OcclusionBuffer_RasterizeScalar(buffer);
+    else
+        OcclusionBuffer_Rasterize(buffer);
+    OcclusionBuffer_BuildHiZ(buffer);
+}
+
+static void TestRasterize(mat4 viewProjection, OcclusionBuffer* buffer, OcclusionBuffer* reference)
+{
+    CreateBuffer(buffer, viewProjection, false);
+    CreateBuffer(reference, viewProjection, true);
+
+    size_t covered = 0;
+    bool same = true;
+    for (uint32_t y = 0; y < HEIGHT; ++y)
+    {
+        const float* row = buffer->Levels[0] + (size_t)buffer->LevelStrides[0] * y;
+        const float* referenceRow = reference->Levels[0] + (size_t)reference->LevelStrides[0] * y;
+        for (uint32_t x = 0; x < WIDTH; ++x)
+        {
+            same = same && fabsf(row[x] - referenceRow[x]) <= 1e-6f;
+            covered += row[x] < 1.0f;
+        }
+    }
+    CHECK(same);
+    // The wall spans about 0.73 of the height and 0.35 of the width
+    CHECK(covered > WIDTH * HEIGHT / 5 && covered < WIDTH * HEIGHT / 3);
+
+    // Every level keeps the farthest depth of the texels below it
+    for (uint32_t level = 1; level < buffer->LevelCount; ++level)
+    {
+        for (uint32_t y = 0; y < buffer->LevelHeights[level - 1]; ++y)
+        {
+            for (uint32_t x = 0; x < buffer->LevelWidths[level - 1]; ++x)
+            {
+                float below = buffer->Levels[level - 1][(size_t)buffer->LevelStrides[level - 1] * y + x];
+                float above = buffer->Levels[level][(size_t)buffer->LevelStrides[level] * (y / 2) + x / 2];
+                same = same && above >= below;
+            }
+        }
+    }
+    CHECK(same);
+    CHECK(buffer->LevelWidths[buffer->LevelCount - 1] == 1 && buffer->LevelHeights[buffer->LevelCount - 1] == 1);
+}
+
+static void TestSpheres(mat4 viewProjection, const OcclusionBuffer* buffer)
+{
+    SphereBounds bounds = { 0 };
+    CHECK(SphereBounds_Resize(&bounds, BOUND_COUNT));
+    static Expectation expectations[BOUND_COUNT];
+    static uint32_t visible[BOUND_COUNT];
+    static uint32_t reference[BOUND_COUNT];
+    uint32_t random = 1;
+    size_t hiddenCount = 0;
+    for (uint32_t i = 0; i < BOUND_COUNT; ++i)
+    {
+        bounds.Z[i] = 2.0f + NextRandom(&random) * 40.0f;
+        bounds.X[i] = (NextRandom(&random) * 1.2f - 0.6f) * bounds.Z[i];
+        bounds.Y[i] = (NextRandom(&random) * 1.2f - 0.6f) * bounds.Z[i];
+        bounds.Radius[i] = 0.1f + NextRandom(&random) * 1.5f;
+        expectations[i] = Classify(bounds.X[i], bounds.Y[i], bounds.Z[i], bounds.Radius[i]);
+        hiddenCount += expectations[i] == EXPECT_HIDDEN;
+        visible[i] = reference[i] = i;
+    }
+    CHECK(hiddenCount > BOUND_COUNT / 10);
+
+    size_t visibleCount = OcclusionCullSpheres(buffer, viewProjection, &bounds, visible, BOUND_COUNT);
+    size_t referenceCount = OcclusionCullSpheresScalar(buffer, viewProjection, &bounds, reference, BOUND_COUNT);
+    CHECK(referenceCount <= visibleCount);
+
+    // The order is kept and what the reference keeps the pyramid keeps as well
+    size_t r = 0;
+    for (size_t v = 0; v < visibleCount; ++v)
+    {
+        CHECK(v == 0 || visible[v] > visible[v - 1]);
+        if (r < referenceCount && reference[r] == visible[v])
+            ++r;
+    }
+    CHECK(r == referenceCount);
+
+    size_t culled = 0;
+    for (uint32_t i = 0, v = 0, s = 0; i < BOUND_COUNT; ++i)
+    {
+        bool kept = v < visibleCount && visible[v] == i;
+        bool referenceKept = s < referenceCount && reference[s] == i;
+        v += kept;
+        s += referenceKept;
+        if (expectations[i] == EXPECT_VISIBLE)
+            CHECK(kept && referenceKept);
+        if (expectations[i] == EXPECT_HIDDEN)
+        {
+            CHECK(!referenceKept);
+            culled += !kept;
+        }
+    }
+    // The pyramid is coarser, it still culls most of what's clearly hidden
+    CHECK(culled > hiddenCount * 3 / 4);
+
+    // Culling an already culled list keeps it
+    CHECK(OcclusionCullSpheres(buffer, viewProjection, &bounds, visible, visibleCount) == visibleCount);
+    SphereBounds_Release(&bounds);
+}
+
+static void TestAabbs(mat4 viewProjection, const OcclusionBuffer* buffer)
+{
+    AabbBounds bounds = { 0 };
+    CHECK(AabbBounds_Resize(&bounds, BOUND_COUNT));
+    static Expectation expectations[BOUND_COUNT];
+    static uint32_t visible[BOUND_COUNT];
+    static uint32_t reference[BOUND_COUNT];
+    uint32_t random = 2;
+    for (uint32_t i = 0; i < BOUND_COUNT; ++i)
+    {
+        bounds.CenterZ[i] = 2.0f + NextRandom(&random) * 40.0f;
+        bounds.CenterX[i] = (NextRandom(&random) * 1.2f - 0.6f) * bounds.CenterZ[i];
+        bounds.CenterY[i] = (NextRandom(&random) * 1.2f - 0.6f) * bounds.CenterZ[i];
+        float extent = 0.1f + NextRandom(&random);
+        bounds.ExtentX[i] = bounds.ExtentY[i] = bounds.ExtentZ[i] = extent;
+        // The sphere around the box for the hidden ones, the sphere in it for the visible ones
+        Expectation outer = Classify(bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i], extent * sqrtf(3.0f));
+        Expectation inner = Classify(bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i], extent);
+        expectations[i] = outer == EXPECT_HIDDEN ? EXPECT_HIDDEN : inner == EXPECT_VISIBLE ? EXPECT_VISIBLE : EXPECT_EITHER;
+        visible[i] = reference[i] = i;
+    }
+
+    size_t visibleCount = OcclusionCullAabbs(buffer, viewProjection, &bounds, visible, BOUND_COUNT);
+    size_t referenceCount = OcclusionCullAabbsScalar(buffer, viewProjection, &bounds, reference, BOUND_COUNT);
+    CHECK(referenceCount <= visibleCount);
+    for (uint32_t i = 0, v = 0, s = 0; i < BOUND_COUNT; ++i)
+    {
+        bool kept = v < visibleCount && visible[v] == i;
+        bool referenceKept = s < referenceCount && reference[s] == i;
+        v += kept;
+        s += referenceKept;
+        CHECK(kept || !referenceKept);
+        if (expectations[i] == EXPECT_VISIBLE)
+            CHECK(kept && referenceKept);
+        if (expectations[i] == EXPECT_HIDDEN)
+            CHECK(!referenceKept);
+    }
+    AabbBounds_Release(&bounds);
+}
+
+int main(void)
+{
+    CHECK(Parallel_Initialise(3));
+    mat4 viewProjection;
+    glm_perspective(1.0f, (float)WIDTH / HEIGHT, 0.5f, 100.0f, viewProjection);
+
+    OcclusionBuffer buffer;
+    OcclusionBuffer reference;
+    TestRasterize(viewProjection, &buffer, &reference);
+    TestSpheres(viewProjection, &buffer);
+    TestAabbs(viewProjection, &buffer);
+
+    // Cleared, nothing is hidden
+    OcclusionBuffer_Clear(&buffer);
+    OcclusionBuffer_Rasterize(&buffer);
+    OcclusionBuffer_BuildHiZ(&buffer);
+    SphereBounds bounds = { 0 };
+    CHECK(SphereBounds_Resize(&bounds, 1));
+    bounds.X[0] = 0.0f;
+    bounds.Y[0] = 0.0f;
+    bounds.Z[0] = 30.0f;
+    bounds.Radius[0] = 1.0f;
+    uint32_t visible[1] = { 0 };
+    CHECK(OcclusionCullSpheres(&buffer, viewProjection, &bounds, visible, 1) == 1);
+    SphereBounds_Release(&bounds);
+
+    OcclusionBuffer_Destroy(&buffer);
+    OcclusionBuffer_Destroy(&reference);
+    Parallel_Shutdown();
+    return TEST_RESULT();
+}
@@ -0,0 +1,324 @@
+// The residency manager against a simulated GPU and OS: the least recently used idle heaps are
+// evicted first, heaps in flight only after waiting for them, and over synthetic workloads every
+// submission uses resident heaps and the paging calls alternate per heap, like D3D12 requires
+
+#include "residency_manager.h"
+#include "test.h"
+
+#include <string.h>
+
+#define MEGABYTE (1024ull * 1024ull)
+#define FRAMES_IN_FLIGHT 2
+#define EXTERNAL_USAGE (256 * MEGABYTE)
+#define MAX_HEAPS 1024
+#define MAX_EVICTIONS 64
+#define FRAME_COUNT 600
+
+typedef struct SimulatedHeap
+{
+    ResidencyObject Residency;
+    uint64_t Size;
+    // As the simulated GPU sees it
+    bool Resident;
+    uint64_t LastUsedFence;
+} SimulatedHeap;
+
+typedef struct Simulation
+{
+    SimulatedHeap Heaps[MAX_HEAPS];
+    uint32_t HeapCount;
+    uint64_t ResidentSize;
+    uint64_t CompletedFence;
+    // Heaps in the order they were evicted, the first ones
+    uint32_t Evicted[MAX_EVICTIONS];
+    uint32_t EvictedCount;
+    uint32_t WaitCount;
+    // Paging calls D3D12 would reject or that would corrupt the frame
+    uint32_t ViolationCount;
+} Simulation;
+
+static Simulation g_Simulation;
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static void EvictSimulated(void* context, void* const* pageables, uint32_t count)
+{
+    Simulation* simulation = context;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        SimulatedHeap* heap = pageables[i];
+        simulation->ViolationCount += !heap->Resident;
+        simulation->ViolationCount += heap->LastUsedFence > simulation->CompletedFence;
+        heap->Resident = false;
+        simulation->ResidentSize -= heap->Size;
+        if (simulation->EvictedCount < MAX_EVICTIONS)
+            simulation->Evicted[simulation->EvictedCount] = (uint32_t)(heap - simulation->Heaps);
+        simulation->EvictedCount++;
+    }
+}
+
+static void MakeSimulatedResident(void* context, void* const* pageables, uint32_t count)
+{
+    Simulation* simulation = context;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        SimulatedHeap* heap = pageables[i];
+        simulation->ViolationCount += heap->Resident;
+        heap->Resident = true;
+        simulation->ResidentSize += heap->Size;
+    }
+}
+
+static void WaitSimulated(void* context, uint64_t fence)
+{
+    Simulation* simulation = context;
+    simulation->CompletedFence = fence > simulation->CompletedFence ? fence : simulation->CompletedFence;
+    simulation->WaitCount++;
+}
+
+// Heaps are created resident, as in D3D12
+static void CreateHeaps(ResidencyManager* manager, bool wait, const uint64_t* sizes, uint32_t count)
+{
+    memset(&g_Simulation, 0, sizeof(g_Simulation));
+    ResidencyManager_Create(manager, EvictSimulated, MakeSimulatedResident, wait ? WaitSimulated : NULL, &g_Simulation);
+    bool tracked = true;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        SimulatedHeap* heap = &g_Simulation.Heaps[g_Simulation.HeapCount++];
+        heap->Size = sizes[i];
+        heap->Resident = true;
+        g_Simulation.ResidentSize += heap->Size;
+        tracked = tracked && ResidencyManager_Track(manager, &heap->Residency, heap, heap->Size);
+    }
+    CHECK(tracked);
+}
+
+// Submits the set with the budget reported for the frame, and checks it's resident after
+static bool Submit(ResidencyManager* manager, uint64_t budget, uint64_t submitFence)
+{
+    static SimulatedHeap* set[MAX_HEAPS];
+    ResidencyManager_SetBudget(manager, budget, g_Simulation.ResidentSize + EXTERNAL_USAGE);
+    uint32_t setCount = manager->SetCount;
+    for (uint32_t i = 0; i < setCount; ++i)
+        set[i] = manager->Set[i]->Pageable;
+    bool fits = ResidencyManager_Submit(manager, g_Simulation.CompletedFence, submitFence);
+
+    for (uint32_t i = 0; i < setCount; ++i)
+    {
+        g_Simulation.ViolationCount += !set[i]->Resident;
+        set[i]->LastUsedFence = submitFence;
+    }
+    g_Simulation.ViolationCount += manager->Counters.ResidentSize != g_Simulation.ResidentSize;
+    return fits;
+}
+
+static void Use(ResidencyManager* manager, uint32_t heap)
+{
+    CHECK(ResidencyManager_Use(manager, &g_Simulation.Heaps[heap].Residency));
+}
+
+static void TestLeastRecentlyUsed(void)
+{
+    static const uint64_t sizes[] = { 10 * MEGABYTE, 10 * MEGABYTE, 10 * MEGABYTE, 10 * MEGABYTE };
+    ResidencyManager manager;
+    CreateHeaps(&manager, true, sizes, 4);
+
+    // Used one at a time, then the second again: 0, 2, 3, 1 from least to most recent
+    uint64_t fence = 0;
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        Use(&manager, i < 4 ? i : 1);
+        g_Simulation.CompletedFence = fence;
+        CHECK(Submit(&manager, UINT64_MAX, ++fence));
+    }
+    CHECK(manager.Counters.EvictionCount == 0 && manager.Counters.ResidentSize == 40 * MEGABYTE);
+
+    // Room for three, the least recent goes
+    Use(&manager, 3);
+    g_Simulation.CompletedFence = fence;
+    CHECK(Submit(&manager, 30 * MEGABYTE + EXTERNAL_USAGE, ++fence));
+    CHECK(g_Simulation.EvictedCount == 1 && g_Simulation.Evicted[0] == 0);
+
+    // Room for two, the evicted one comes back and the two least recent after it make room
+    Use(&manager, 0);
+    g_Simulation.CompletedFence = fence;
+    CHECK(Submit(&manager, 20 * MEGABYTE + EXTERNAL_USAGE, ++fence));
+    CHECK(g_Simulation.EvictedCount == 3 && g_Simulation.Evicted[1] == 2 && g_Simulation.Evicted[2] == 1);
+    CHECK(g_Simulation.Heaps[0].Resident && g_Simulation.Heaps[3].Resident);
+    CHECK(manager.Counters.MadeResidentCount == 1 && manager.Counters.ResidentCount == 2);
+    CHECK(manager.Counters.OverBudgetCount == 0 && g_Simulation.WaitCount == 0);
+    CHECK(g_Simulation.ViolationCount == 0);
+    ResidencyManager_Destroy(&manager);
+}
+
+// The heaps used by a submission in flight, and one tracked after it, with room for one heap
+static void TestInFlight(void)
+{
+    static const uint64_t sizes[] = { 10 * MEGABYTE, 10 * MEGABYTE, 10 * MEGABYTE };
+    for (int wait = 0; wait < 2; ++wait)
+    {
+        ResidencyManager manager;
+        CreateHeaps(&manager, wait, sizes, 2);
+        Use(&manager, 0);
+        Use(&manager, 1);
+        CHECK(Submit(&manager, UINT64_MAX, 1));
+        SimulatedHeap* late = &g_Simulation.Heaps[g_Simulation.HeapCount++];
+        late->Size = sizes[2];
+        late->Resident = true;
+        g_Simulation.ResidentSize += late->Size;
+        CHECK(ResidencyManager_Track(&manager, &late->Residency, late, late->Size));
+
+        Use(&manager, 1);
+        bool fits = Submit(&manager, 10 * MEGABYTE + EXTERNAL_USAGE, 2);
+        if (wait)
+        {
+            // Waited for the submission to evict them, least recent first
+            CHECK(fits && g_Simulation.WaitCount == 1 && manager.Counters.WaitCount == 1);
+            CHECK(g_Simulation.EvictedCount == 2 && g_Simulation.Evicted[0] == 0 && g_Simulation.Evicted[1] == 2);
+        }
+        else
+        {
+            // Nothing idle to evict, the OS pages behind the submission
+            CHECK(!fits && g_Simulation.EvictedCount == 0);
+            CHECK(manager.Counters.OverBudgetCount == 1 && manager.Counters.OverBudgetSize == 20 * MEGABYTE);
+
+            // Once it completed they go
+            Use(&manager, 1);
+            g_Simulation.CompletedFence = 1;
+            CHECK(Submit(&manager, 10 * MEGABYTE + EXTERNAL_USAGE, 3));
+            CHECK(g_Simulation.EvictedCount == 2);
+        }
+        CHECK(g_Simulation.ViolationCount == 0);
+        ResidencyManager_Destroy(&manager);
+    }
+}
+
+// Untracked heaps leave the counters, the list and the set they were added to
+static void TestUntrack(void)
+{
+    static const uint64_t sizes[] = { 10 * MEGABYTE, 20 * MEGABYTE, 30 * MEGABYTE };
+    ResidencyManager manager;
+    CreateHeaps(&manager, true, sizes, 3);
+    Use(&manager, 0);
+    Use(&manager, 1);
+    ResidencyManager_Untrack(&manager, &g_Simulation.Heaps[1].Residency);
+    g_Simulation.ResidentSize -= sizes[1];
+    CHECK(manager.SetCount == 1 && manager.Set[0] == &g_Simulation.Heaps[0].Residency);
+    CHECK(manager.Counters.TrackedCount == 2 && manager.Counters.TrackedSize == 40 * MEGABYTE);
+    CHECK(manager.Counters.ResidentCount == 2 && manager.Counters.ResidentSize == 40 * MEGABYTE);
+
+    // Room for the set only, the other one is evicted
+    CHECK(Submit(&manager, 10 * MEGABYTE + EXTERNAL_USAGE, 1));
+    CHECK(g_Simulation.EvictedCount == 1 && g_Simulation.Evicted[0] == 2);
+    ResidencyManager_Untrack(&manager, &g_Simulation.Heaps[2].Residency);
+    CHECK(manager.Counters.TrackedCount == 1 && manager.Counters.ResidentSize == 10 * MEGABYTE);
+    CHECK(manager.LeastRecent == &g_Simulation.Heaps[0].Residency && manager.MostRecent == manager.LeastRecent);
+    CHECK(g_Simulation.ViolationCount == 0);
+    ResidencyManager_Destroy(&manager);
+}
+
+typedef enum Workload
+{
+    // Three quarters of the heaps every frame, turning every second, all of them fit
+    WORKLOAD_FITTING,
+    // A window of 64 heaps sliding by one every 4 frames, twice the window fits
+    WORKLOAD_STREAMING,
+    // 48 heaps a frame picked with a skew to the first ones, a third of them fits
+    WORKLOAD_SKEWED,
+    // Fitting, with a fifth of the budget taken in the middle third
+    WORKLOAD_BUDGET_DROP,
+    // Every heap every frame, a quarter over the budget
+    WORKLOAD_OVERSUBSCRIBED,
+    WORKLOAD_COUNT
+} Workload;
+
+static uint64_t GetTotalSize(uint32_t count)
+{
+    uint64_t size = 0;
+    for (uint32_t i = 0; i < count; ++i)
+        size += g_Simulation.Heaps[i].Size;
+    return size;
+}
+
+// Fills the set of a frame and returns the budget of it
+static uint64_t Frame(ResidencyManager* manager, Workload workload, uint32_t frame, uint32_t* random)
+{
+    uint32_t count = g_Simulation.HeapCount;
+    switch (workload)
+    {
+        case WORKLOAD_STREAMING:
+            for (uint32_t i = frame / 4; i < frame / 4 + 64; ++i)
+                Use(manager, i % count);
+            return 2 * GetTotalSize(64) + EXTERNAL_USAGE;
+        case WORKLOAD_SKEWED:
+            for (int i = 0; i < 48; ++i)
+            {
+                // Cubing a uniform number favours the low indices
+                double unit = NextRandom(random) / 16777216.0;
+                Use(manager, (uint32_t)(count * unit * unit * unit));
+            }
+            return GetTotalSize(count) / 3 + EXTERNAL_USAGE;
+        case WORKLOAD_OVERSUBSCRIBED:
+            for (uint32_t i = 0; i < count; ++i)
+                Use(manager, i);
+            return GetTotalSize(count) * 4 / 5 + EXTERNAL_USAGE;
+        default:
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if ((i + frame / 60) % 4 != 0)
+                    Use(manager, i);
+            }
+            uint64_t budget = GetTotalSize(count) + EXTERNAL_USAGE + 512 * MEGABYTE;
+            bool dropped = workload == WORKLOAD_BUDGET_DROP && frame >= FRAME_COUNT / 3 && frame < 2 * FRAME_COUNT / 3;
+            return dropped ? budget / 5 * 4 : budget;
+    }
+}
+
+static void TestWorkloads(void)
+{
+    static uint64_t sizes[MAX_HEAPS];
+    for (int workload = 0; workload < WORKLOAD_COUNT; ++workload)
+    {
+        // 4MB to 64MB, textures and buffers of a level
+        uint32_t random = 1 + workload;
+        uint32_t count = workload == WORKLOAD_STREAMING ? 1024 : workload == WORKLOAD_SKEWED ? 512 : 128;
+        for (uint32_t i = 0; i < count; ++i)
+            sizes[i] = (4 + NextRandom(&random) % 61) * MEGABYTE;
+
+        ResidencyManager manager;
+        CreateHeaps(&manager, true, sizes, count);
+        uint32_t overBudgetFrames = 0;
+        for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame)
+        {
+            uint64_t submitFence = frame + 1;
+            g_Simulation.CompletedFence = submitFence > FRAMES_IN_FLIGHT ? submitFence - 1 - FRAMES_IN_FLIGHT : 0;
+            uint64_t budget = Frame(&manager, workload, frame, &random);
+            overBudgetFrames += !Submit(&manager, budget, submitFence);
+        }
+
+        const ResidencyCounters* counters = &manager.Counters;
+        CHECK(g_Simulation.ViolationCount == 0);
+        CHECK(counters->ResidentCount <= count && counters->TrackedSize == GetTotalSize(count));
+        CHECK(counters->OverBudgetCount == overBudgetFrames);
+        if (workload == WORKLOAD_FITTING)
+            CHECK(counters->EvictionCount == 0 && overBudgetFrames == 0);
+        else if (workload == WORKLOAD_OVERSUBSCRIBED)
+            CHECK(counters->EvictionCount == 0 && overBudgetFrames == FRAME_COUNT);
+        else
+            CHECK(counters->EvictionCount > 0 && counters->MadeResidentCount > 0 && overBudgetFrames == 0);
+        ResidencyManager_Destroy(&manager);
+    }
+}
+
+int main(void)
+{
+    TestLeastRecentlyUsed();
+    TestInFlight();
+    TestUntrack();
+    TestWorkloads();
+    return TEST_RESULT();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Checks of the tests, a failed one reports its location and the test carries on. The test
+// returns TEST_RESULT() from main so ctest sees the failures.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int g_Failures;
+
+#define CHECK(condition)                                                                      \
+    do                                                                                        \
+    {                                                                                         \
+        if (!(condition))                                                                     \
+        {                                                                                     \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);     \
+            ++g_Failures;                                                                     \
+        }                                                                                     \
+    } while (0)
+
+#define TEST_RESULT() (g_Failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
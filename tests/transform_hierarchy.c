@@ -0,0 +1,126 @@
+// The incremental update of the transform hierarchy against the naive one: the same matrices
+// after every frame, with only the moved nodes and their subtrees recomputed
+
+#include "parallel.h"
+#include "test.h"
+#include "transform_hierarchy.h"
+
+#include <string.h>
+
+#define NODE_COUNT 5000
+#define FRAME_COUNT 20
+
+static uint32_t NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static void PoseNode(uint32_t node, uint32_t frame, mat4 local)
+{
+    vec3 angles = { 0.01f * frame, 0.1f * node, 0.0f };
+    glm_euler(angles, local);
+    local[3][0] = (float)(node % 7) - 3.0f;
+    local[3][1] = 0.1f * frame;
+}
+
+static bool IsNear(mat4 a, mat4 b)
+{
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            float difference = a[c][r] - b[c][r];
+            if (difference > 1e-3f || difference < -1e-3f)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Whether node is in the subtree of root
+static bool IsDescendant(const TransformHierarchy* hierarchy, int32_t node, uint32_t root)
+{
+    for (; node != TRANSFORM_NO_PARENT; node = hierarchy->Parents[node])
+    {
+        if ((uint32_t)node == root)
+            return true;
+    }
+    return false;
+}
+
+int main(void)
+{
+    CHECK(Parallel_Initialise(3));
+
+    // A random forest, a few roots with chains and wide fans under them
+    TransformHierarchy incremental;
+    TransformHierarchy naive;
+    CHECK(TransformHierarchy_Create(&incremental, 16));
+    CHECK(TransformHierarchy_Create(&naive, NODE_COUNT));
+    uint32_t random = 5;
+    for (uint32_t i = 0; i < NODE_COUNT; ++i)
+    {
+        int32_t parent = i < 4 ? TRANSFORM_NO_PARENT : (int32_t)(NextRandom(&random) % i);
+        mat4 local;
+        PoseNode(i, 0, local);
+        CHECK(TransformHierarchy_AddNode(&incremental, parent, local) == (int32_t)i);
+        CHECK(TransformHierarchy_AddNode(&naive, parent, local) == (int32_t)i);
+    }
+
+    mat4 viewProjection;
+    glm_perspective(1.0f, 1.5f, 0.1f, 100.0f, viewProjection);
+    TransformHierarchy_Update(&incremental, viewProjection);
+    CHECK(incremental.LastUpdatedCount == NODE_COUNT);
+
+    // Nothing moved, nothing is recomputed
+    TransformHierarchy_Update(&incremental, viewProjection);
+    CHECK(incremental.LastUpdatedCount == 0);
+
+    static bool moved[NODE_COUNT];
+    for (uint32_t frame = 1; frame <= FRAME_COUNT; ++frame)
+    {
+        // A few percent of the nodes, some of them twice
+        memset(moved, 0, sizeof(moved));
+        for (uint32_t n = 0; n < NODE_COUNT / 50; ++n)
+        {
+            uint32_t node = NextRandom(&random) % NODE_COUNT;
+            mat4 local;
+            PoseNode(node, frame, local);
+            TransformHierarchy_SetLocal(&incremental, node, local);
+            TransformHierarchy_SetLocal(&naive, node, local);
+            moved[node] = true;
+        }
+        // Every other frame the camera moves as well
+        if (frame % 2 == 0)
+            viewProjection[3][0] += 0.5f;
+
+        TransformHierarchy_Update(&incremental, viewProjection);
+        TransformHierarchy_UpdateNaive(&naive, viewProjection);
+
+        size_t expected = 0;
+        for (uint32_t i = 0; i < NODE_COUNT; ++i)
+        {
+            for (uint32_t m = 0; m < NODE_COUNT; ++m)
+            {
+                if (moved[m] && IsDescendant(&incremental, (int32_t)i, m))
+                {
+                    ++expected;
+                    break;
+                }
+            }
+        }
+        CHECK(incremental.LastUpdatedCount == expected);
+
+        bool same = true;
+        for (uint32_t i = 0; i < NODE_COUNT; ++i)
+            same = same && IsNear(incremental.WorldMatrices[i], naive.WorldMatrices[i]) &&
+                   IsNear(incremental.MvpMatrices[i], naive.MvpMatrices[i]);
+        CHECK(same);
+    }
+
+    TransformHierarchy_Destroy(&incremental);
+    TransformHierarchy_Destroy(&naive);
+    Parallel_Shutdown();
+    return TEST_RESULT();
+}
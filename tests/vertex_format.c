@@ -0,0 +1,237 @@
+// Round trips of the vertex formats: the quantized meshes decode back within the error bound of
+// every format, and the half float and octahedral conversions within theirs
+
+#include "test.h"
+#include "vertex_format.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#define VERTEX_COUNT 4096
+#define PI 3.14159265358979f
+// Of the coordinates of the box
+#define MAX_COORDINATE 100.0f
+
+typedef struct SourceVertex
+{
+    float Position[3];
+    float Color[3];
+    float Normal[3];
+} SourceVertex;
+
+static SourceVertex g_Vertices[VERTEX_COUNT];
+
+// Deterministic, in [0, 1)
+static float NextRandom(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) / 16777216.0f;
+}
+
+// A box off the origin with a different extent on every axis, so the offsets and scales matter
+static void CreateVertices(void)
+{
+    static const float minimum[3] = { -3.0f, 10.0f, -0.25f };
+    static const float extent[3] = { 8.0f, 0.5f, 100.0f };
+    uint32_t state = 1;
+    for (int i = 0; i < VERTEX_COUNT; ++i)
+    {
+        SourceVertex* vertex = &g_Vertices[i];
+        for (int c = 0; c < 3; ++c)
+        {
+            vertex->Position[c] = minimum[c] + extent[c] * NextRandom(&state);
+            vertex->Color[c] = NextRandom(&state);
+        }
+        float theta = 2.0f * PI * NextRandom(&state);
+        float z = 2.0f * NextRandom(&state) - 1.0f;
+        float r = sqrtf(1.0f - z * z);
+        vertex->Normal[0] = r * cosf(theta);
+        vertex->Normal[1] = r * sinf(theta);
+        vertex->Normal[2] = z;
+    }
+    // The corners of the box are the ones clamped at the ends of the range
+    memcpy(g_Vertices[0].Position, minimum, sizeof(minimum));
+    for (int c = 0; c < 3; ++c)
+        g_Vertices[1].Position[c] = minimum[c] + extent[c];
+}
+
+static MeshStreams GetStreams(void)
+{
+    return (MeshStreams){
+        .Positions = g_Vertices[0].Position,
+        .PositionStride = sizeof(SourceVertex),
+        .Colors = g_Vertices[0].Color,
+        .ColorStride = sizeof(SourceVertex),
+        .Normals = g_Vertices[0].Normal,
+        .NormalStride = sizeof(SourceVertex),
+        .VertexCount = VERTEX_COUNT
+    };
+}
+
+// Decodes the position the way the vertex shader does with the dequantization transform
+static void DecodePosition(const QuantizedMesh* mesh, size_t i, float position[3])
+{
+    const uint8_t* vertex = mesh->Data + (size_t)mesh->Stride * i;
+    if (mesh->Layout.Position == POSITION_FORMAT_FLOAT32)
+    {
+        memcpy(position, vertex, 3 * sizeof(float));
+        return;
+    }
+    uint16_t q[3];
+    memcpy(q, vertex, sizeof(q));
+    for (int c = 0; c < 3; ++c)
+    {
+        float stored = mesh->Layout.Position == POSITION_FORMAT_UNORM16 ? q[c] / 65535.0f : HalfToFloat(q[c]);
+        position[c] = mesh->DequantizeOffset[c] + mesh->DequantizeScale[c] * stored;
+    }
+}
+
+// Half a step of the format on every axis, the scale spans the mesh
+static float GetPositionBound(const QuantizedMesh* mesh)
+{
+    float step = 0.0f;
+    if (mesh->Layout.Position == POSITION_FORMAT_UNORM16)
+        step = 1.0f / 65535.0f;
+    else if (mesh->Layout.Position == POSITION_FORMAT_FLOAT16)
+        step = 1.0f / 1024.0f;
+    float squared = 0.0f;
+    for (int c = 0; c < 3; ++c)
+    {
+        // The float math of the round trip adds an ulp or so of the values
+        float error = 0.5f * step * mesh->DequantizeScale[c] + 4.0f * FLT_EPSILON * MAX_COORDINATE;
+        squared += error * error;
+    }
+    return sqrtf(squared);
+}
+
+static void TestPositions(PositionFormat format)
+{
+    MeshStreams streams = GetStreams();
+    VertexLayout layout = { .Position = format, .Color = COLOR_FORMAT_FLOAT32, .Normal = NORMAL_FORMAT_NONE };
+    QuantizedMesh mesh;
+    CHECK(QuantizeMesh(&streams, &layout, &mesh));
+    CHECK(mesh.VertexCount == VERTEX_COUNT);
+    CHECK(mesh.Stride == VertexLayout_GetStride(&layout));
+
+    float bound = GetPositionBound(&mesh);
+    float maxError = 0.0f;
+    for (size_t i = 0; i < VERTEX_COUNT; ++i)
+    {
+        float position[3];
+        DecodePosition(&mesh, i, position);
+        float squared = 0.0f;
+        for (int c = 0; c < 3; ++c)
+            squared += (position[c] - g_Vertices[i].Position[c]) * (position[c] - g_Vertices[i].Position[c]);
+        maxError = fmaxf(maxError, sqrtf(squared));
+    }
+    CHECK(maxError <= bound);
+    if (format == POSITION_FORMAT_FLOAT32)
+        CHECK(maxError == 0.0f);
+
+    // The stats measure the same errors
+    CHECK(fabsf(mesh.Stats.MaxPositionError - maxError) <= 1e-5f * (1.0f + maxError));
+    CHECK(mesh.Stats.RmsPositionError <= mesh.Stats.MaxPositionError);
+    CHECK(mesh.Stats.QuantizedBytes == (size_t)mesh.Stride * VERTEX_COUNT);
+    QuantizedMesh_Release(&mesh);
+}
+
+// Of the cross and the dot, the acos of the dot alone is off by hundredths of a degree at float
+// precision near 1
+static float GetAngleDegrees(const float a[3], const float b[3])
+{
+    double cx = (double)a[1] * b[2] - (double)a[2] * b[1];
+    double cy = (double)a[2] * b[0] - (double)a[0] * b[2];
+    double cz = (double)a[0] * b[1] - (double)a[1] * b[0];
+    double dot = (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+    return (float)(atan2(sqrt(cx * cx + cy * cy + cz * cz), dot) * 180.0 / PI);
+}
+
+static void TestColorsAndNormals(void)
+{
+    MeshStreams streams = GetStreams();
+    VertexLayout layout = { .Position = POSITION_FORMAT_UNORM16, .Color = COLOR_FORMAT_UNORM8,
+                            .Normal = NORMAL_FORMAT_OCT16 };
+    QuantizedMesh mesh;
+    CHECK(QuantizeMesh(&streams, &layout, &mesh));
+    CHECK(mesh.Stride == 8 + 4 + 4);
+    CHECK(mesh.Stats.QuantizedBytes < mesh.Stats.SourceBytes);
+
+    float maxColorError = 0.0f;
+    float maxNormalError = 0.0f;
+    for (size_t i = 0; i < VERTEX_COUNT; ++i)
+    {
+        const uint8_t* vertex = mesh.Data + (size_t)mesh.Stride * i;
+        for (int c = 0; c < 3; ++c)
+            maxColorError = fmaxf(maxColorError, fabsf(vertex[8 + c] / 255.0f - g_Vertices[i].Color[c]));
+        CHECK(vertex[8 + 3] == 255);
+
+        int16_t encoded[2];
+        float normal[3];
+        memcpy(encoded, vertex + 12, sizeof(encoded));
+        DecodeOctahedral(encoded, normal);
+        const float* source = g_Vertices[i].Normal;
+        maxNormalError = fmaxf(maxNormalError, GetAngleDegrees(normal, source));
+    }
+    CHECK(maxColorError <= 0.5f / 255.0f + 1e-6f);
+    CHECK(mesh.Stats.MaxColorError <= 0.5f / 255.0f + 1e-6f);
+    // 16 bit octahedral normals are good to about a hundredth of a degree
+    CHECK(maxNormalError <= 0.02f);
+    CHECK(mesh.Stats.MaxNormalErrorDegrees <= 0.02f);
+    QuantizedMesh_Release(&mesh);
+}
+
+static void TestHalf(void)
+{
+    // Exact for the values a half holds
+    static const float exact[] = { 0.0f, 1.0f, -1.0f, 0.5f, 2048.0f, 65504.0f, 6.103515625e-05f, 5.9604645e-08f };
+    for (size_t i = 0; i < sizeof(exact) / sizeof(exact[0]); ++i)
+        CHECK(HalfToFloat(FloatToHalf(exact[i])) == exact[i]);
+    CHECK(FloatToHalf(1.0f) == 0x3C00);
+    CHECK(FloatToHalf(-2.0f) == 0xC000);
+
+    // Ties round to even, halfway between 1 and the next half goes down, past it goes up
+    CHECK(FloatToHalf(1.0f + 1.0f / 2048.0f) == 0x3C00);
+    CHECK(FloatToHalf(1.0f + 3.0f / 2048.0f) == 0x3C02);
+    CHECK(FloatToHalf(1e6f) == 0x7C00);
+    CHECK(isinf(HalfToFloat(0x7C00)));
+    CHECK(isnan(HalfToFloat(FloatToHalf(NAN))));
+
+    // Within half an ulp everywhere else in the normal range
+    uint32_t state = 7;
+    for (int i = 0; i < 100000; ++i)
+    {
+        float value = (NextRandom(&state) * 2.0f - 1.0f) * 1000.0f;
+        if (fabsf(value) < 6.103515625e-05f)
+            continue;
+        float decoded = HalfToFloat(FloatToHalf(value));
+        CHECK(fabsf(decoded - value) <= fabsf(value) / 2048.0f);
+    }
+}
+
+static void TestOctahedral(void)
+{
+    // The axes and the folded corners of the lower hemisphere are exact
+    static const float axes[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+    for (int i = 0; i < 6; ++i)
+    {
+        int16_t encoded[2];
+        float normal[3];
+        EncodeOctahedral(axes[i], encoded);
+        DecodeOctahedral(encoded, normal);
+        for (int c = 0; c < 3; ++c)
+            CHECK(fabsf(normal[c] - axes[i][c]) <= 1e-6f);
+    }
+}
+
+int main(void)
+{
+    CreateVertices();
+    TestPositions(POSITION_FORMAT_FLOAT32);
+    TestPositions(POSITION_FORMAT_UNORM16);
+    TestPositions(POSITION_FORMAT_FLOAT16);
+    TestColorsAndNormals();
+    TestHalf();
+    TestOctahedral();
+    return TEST_RESULT();
+}
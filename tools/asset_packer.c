@@ -0,0 +1,329 @@
+// Packs files into an asset archive, lists one, or benchmarks loading it through the streamer.
+//
+//   asset-packer pack <archive> <files...> [--store]
+//   asset-packer list <archive>
+//   asset-packer bench <archive> [--decoders N] [--runs N]
+//
+// The bench reads every entry twice over: once synchronously on the calling thread, then
+// streamed with all but one entry at low priority and the last one requested at high priority
+// after them. The first streamed run is cold where the OS cache can be dropped (POSIX), the
+// others are warm.
+
+#ifndef _WIN32
+// posix_fadvise and fileno
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "asset_archive.h"
+#include "asset_streamer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
+
+typedef struct BenchContext
+{
+    const AssetEntry* Urgent;
+    uint32_t CompletedCount;
+    uint32_t LoadedCount;
+    // Completions before the urgent entry, and when it came in
+    uint32_t UrgentPosition;
+    double UrgentSeconds;
+    double Start;
+} BenchContext;
+
+static double GetSeconds(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+static void* LoadFile(const char* path, size_t* size)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    void* data = NULL;
+    long length;
+    if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        *size = (size_t)length;
+        data = malloc(*size > 0 ? *size : 1);
+        if (data != NULL && fread(data, 1, *size, file) != *size)
+        {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+// Asks the OS to drop the cached pages of the file, false where that isn't possible
+static bool EvictFromCache(const char* path)
+{
+#ifndef _WIN32
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    bool evicted = posix_fadvise(fileno(file), 0, 0, POSIX_FADV_DONTNEED) == 0;
+    fclose(file);
+    return evicted;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+static int Pack(int argc, char** argv)
+{
+    const char* path = argv[2];
+    AssetCodec codec = ASSET_CODEC_LZ4;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--store") == 0)
+            codec = ASSET_CODEC_NONE;
+    }
+
+    AssetArchiveWriter writer;
+    AssetArchiveWriter_Create(&writer);
+    size_t totalSize = 0;
+    double compressSeconds = 0.0;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--store") == 0)
+            continue;
+
+        size_t size;
+        void* data = LoadFile(argv[i], &size);
+        // Names use forward slashes wherever the archive was packed
+        char* name = malloc(strlen(argv[i]) + 1);
+        if (data == NULL || name == NULL)
+        {
+            fprintf(stderr, "Can't read %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        for (size_t j = 0; j <= strlen(argv[i]); ++j)
+            name[j] = argv[i][j] == '\\' ? '/' : argv[i][j];
+
+        double start = GetSeconds();
+        bool added = AssetArchiveWriter_Add(&writer, name, data, size, codec);
+        compressSeconds += GetSeconds() - start;
+        free(data);
+        if (!added)
+        {
+            fprintf(stderr, "Can't add %s, the name is taken or it's too large\n", name);
+            return EXIT_FAILURE;
+        }
+        free(name);
+        totalSize += size;
+    }
+
+    if (!AssetArchiveWriter_Save(&writer, path))
+    {
+        fprintf(stderr, "Can't write %s\n", path);
+        return EXIT_FAILURE;
+    }
+    printf("%u entries, %zu bytes packed to %zu, %.2f:1, compressed at %.1f MB/s\n", writer.EntryCount,
+           totalSize, writer.DataSize, writer.DataSize > 0 ? (double)totalSize / writer.DataSize : 1.0,
+           compressSeconds > 0.0 ? totalSize * 1e-6 / compressSeconds : 0.0);
+    AssetArchiveWriter_Destroy(&writer);
+    return EXIT_SUCCESS;
+}
+
+static int List(const char* path)
+{
+    AssetArchive archive;
+    if (!AssetArchive_Open(path, &archive))
+    {
+        fprintf(stderr, "Can't open %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < archive.SlotCount; ++i)
+    {
+        const AssetEntry* entry = &archive.Slots[i];
+        if (entry->NameHash != 0)
+        {
+            printf("%10u %10u %-4s %s\n", entry->Size, entry->CompressedSize,
+                   entry->Codec == ASSET_CODEC_LZ4 ? "lz4" : "none", AssetArchive_GetName(&archive, entry));
+        }
+    }
+    printf("%u entries in %u slots\n", archive.EntryCount, archive.SlotCount);
+    AssetArchive_Close(&archive);
+    return EXIT_SUCCESS;
+}
+
+static void* StageBench(void* context, const AssetEntry* entry, void* requestData)
+{
+    (void)context;
+    (void)requestData;
+    return malloc(entry->Size > 0 ? entry->Size : 1);
+}
+
+static void CompleteBench(void* context, const AssetEntry* entry, void* destination, bool loaded, void* requestData)
+{
+    (void)requestData;
+    BenchContext* bench = context;
+    if (entry == bench->Urgent)
+    {
+        bench->UrgentPosition = bench->CompletedCount;
+        bench->UrgentSeconds = GetSeconds() - bench->Start;
+    }
+    bench->CompletedCount++;
+    bench->LoadedCount += loaded;
+    free(destination);
+}
+
+// Streams every entry, returns the seconds it took or a negative value on failure
+static double Stream(const AssetArchive* archive, uint32_t decoderCount, BenchContext* bench)
+{
+    memset(bench, 0, sizeof(*bench));
+    for (uint32_t i = 0; i < archive->SlotCount; ++i)
+    {
+        if (archive->Slots[i].NameHash != 0)
+            bench->Urgent = &archive->Slots[i];
+    }
+
+    AssetStreamer streamer;
+    if (!AssetStreamer_Create(&streamer, archive, decoderCount, StageBench, CompleteBench, bench))
+        return -1.0;
+
+    bench->Start = GetSeconds();
+    for (uint32_t i = 0; i < archive->SlotCount; ++i)
+    {
+        const AssetEntry* entry = &archive->Slots[i];
+        if (entry->NameHash != 0 && entry != bench->Urgent)
+            AssetStreamer_Request(&streamer, AssetArchive_GetName(archive, entry), ASSET_PRIORITY_LOW, NULL);
+    }
+    if (bench->Urgent != NULL)
+        AssetStreamer_Request(&streamer, AssetArchive_GetName(archive, bench->Urgent), ASSET_PRIORITY_HIGH, NULL);
+
+    while (AssetStreamer_GetPendingCount(&streamer) > 0)
+    {
+        if (AssetStreamer_Poll(&streamer) == 0)
+            thrd_yield();
+    }
+    double seconds = GetSeconds() - bench->Start;
+    AssetStreamer_Destroy(&streamer);
+    return bench->LoadedCount == archive->EntryCount ? seconds : -1.0;
+}
+
+static int Bench(int argc, char** argv)
+{
+    const char* path = argv[2];
+    uint32_t decoderCount = 2;
+    int runCount = 3;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--decoders") == 0 && i + 1 < argc)
+            decoderCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            runCount = atoi(argv[++i]);
+    }
+
+    AssetArchive archive;
+    if (!AssetArchive_Open(path, &archive))
+    {
+        fprintf(stderr, "Can't open %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    size_t size = 0;
+    size_t compressedSize = 0;
+    for (uint32_t i = 0; i < archive.SlotCount; ++i)
+    {
+        size += archive.Slots[i].Size;
+        compressedSize += archive.Slots[i].CompressedSize;
+    }
+    double megabytes = size * 1e-6;
+    printf("%u entries, %zu bytes, %zu compressed\n", archive.EntryCount, size, compressedSize);
+    if (archive.EntryCount == 0)
+    {
+        AssetArchive_Close(&archive);
+        return EXIT_SUCCESS;
+    }
+
+    bool cold = EvictFromCache(path);
+    BenchContext bench;
+    double seconds = Stream(&archive, decoderCount, &bench);
+    if (seconds < 0.0)
+    {
+        fprintf(stderr, "Streaming %s failed\n", path);
+        AssetArchive_Close(&archive);
+        return EXIT_FAILURE;
+    }
+    printf("%s streamed, %u decoders: %.2f ms, %.1f MB/s, urgent entry done %u of %u at %.2f ms\n",
+           cold ? "Cold" : "First", decoderCount, seconds * 1000.0, megabytes / seconds,
+           bench.UrgentPosition + 1, bench.CompletedCount, bench.UrgentSeconds * 1000.0);
+
+    double fastest = INFINITY;
+    double fastestUrgent = INFINITY;
+    for (int run = 0; run < runCount; ++run)
+    {
+        seconds = Stream(&archive, decoderCount, &bench);
+        if (seconds < 0.0)
+        {
+            fprintf(stderr, "Streaming %s failed\n", path);
+            AssetArchive_Close(&archive);
+            return EXIT_FAILURE;
+        }
+        fastest = fmin(fastest, seconds);
+        fastestUrgent = fmin(fastestUrgent, bench.UrgentSeconds);
+    }
+    printf("Warm streamed, %u decoders: %.2f ms, %.1f MB/s, urgent entry at %.2f ms\n",
+           decoderCount, fastest * 1000.0, megabytes / fastest, fastestUrgent * 1000.0);
+
+    // The same entries one after the other on this thread, for reference
+    double fastestSynchronous = INFINITY;
+    for (int run = 0; run < runCount; ++run)
+    {
+        double start = GetSeconds();
+        for (uint32_t i = 0; i < archive.SlotCount; ++i)
+        {
+            const AssetEntry* entry = &archive.Slots[i];
+            void* data = entry->NameHash != 0 ? malloc(entry->Size > 0 ? entry->Size : 1) : NULL;
+            if (entry->NameHash != 0 && (data == NULL || !AssetArchive_Read(&archive, entry, data)))
+            {
+                fprintf(stderr, "Reading %s failed\n", AssetArchive_GetName(&archive, entry));
+                AssetArchive_Close(&archive);
+                return EXIT_FAILURE;
+            }
+            free(data);
+        }
+        fastestSynchronous = fmin(fastestSynchronous, GetSeconds() - start);
+    }
+    printf("Warm synchronous: %.2f ms, %.1f MB/s\n", fastestSynchronous * 1000.0, megabytes / fastestSynchronous);
+
+    AssetArchive_Close(&archive);
+    return EXIT_SUCCESS;
+}
+
+static int PrintUsage(void)
+{
+    fprintf(stderr, "usage: asset-packer pack <archive> <files...> [--store]\n"
+                    "       asset-packer list <archive>\n"
+                    "       asset-packer bench <archive> [--decoders N] [--runs N]\n");
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+        return PrintUsage();
+    if (strcmp(argv[1], "pack") == 0)
+        return Pack(argc, argv);
+    if (strcmp(argv[1], "list") == 0)
+        return List(argv[2]);
+    if (strcmp(argv[1], "bench") == 0)
+        return Bench(argc, argv);
+    return PrintUsage();
+}
@@ -0,0 +1,164 @@
+// Runs a benchmark workload the way the app's --benchmark mode does, with a null backend in place
+// of D3D12, and writes the same JSON report.
+//
+//   benchmark-null [--workload NAME] [--frames N] [--warm-up N] [--report PATH] [--capture PATH]
+//
+// The simulation builds the world matrices of the instances from the script and the camera's
+// view projection, the null backend culls the instances against the frustum and counts the
+// draws it would submit. No GPU time is measured, the report has null for it. --capture also
+// records the commands of the frames the way the app's direct draws would, for command-capture.
+
+#include "benchmark.h"
+#include "null_backend.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Those of the app's window and UpdatePerspective
+#define FIELD_OF_VIEW 45.0f
+#define ASPECT_RATIO (1280.0f / 720.0f)
+#define NEAR_PLANE 0.1f
+#define FAR_PLANE 100.0f
+
+static double GetMilliseconds(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+// Rotation about x, then y, then z, then the translation, like glm_euler and glm_translate
+static void ComposeWorld(const float position[3], const float angles[3], NullMatrix world)
+{
+    float cx = cosf(angles[0]), sx = sinf(angles[0]);
+    float cy = cosf(angles[1]), sy = sinf(angles[1]);
+    float cz = cosf(angles[2]), sz = sinf(angles[2]);
+    NullMatrix m = {
+        { cy * cz, cx * sz + cz * sx * sy, sx * sz - cx * cz * sy, 0.0f },
+        { -cy * sz, cx * cz - sx * sy * sz, cz * sx + cx * sy * sz, 0.0f },
+        { sy, -cy * sx, cx * cy, 0.0f },
+        { position[0], position[1], position[2], 1.0f }
+    };
+    memcpy(world, m, sizeof(m));
+}
+
+// Left handed, like the app's glm_lookat and glm_perspective
+static void ComposeViewProjection(const float eye[3], const float target[3], NullMatrix viewProjection)
+{
+    float f[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+    float length = sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    for (int i = 0; i < 3; ++i)
+        f[i] /= length;
+    // up x forward, with up the y axis
+    float s[3] = { f[2], 0.0f, -f[0] };
+    length = sqrtf(s[0] * s[0] + s[2] * s[2]);
+    for (int i = 0; i < 3; ++i)
+        s[i] /= length;
+    float u[3] = { f[1] * s[2] - f[2] * s[1], f[2] * s[0] - f[0] * s[2], f[0] * s[1] - f[1] * s[0] };
+    NullMatrix view = {
+        { s[0], u[0], f[0], 0.0f },
+        { s[1], u[1], f[1], 0.0f },
+        { s[2], u[2], f[2], 0.0f },
+        { -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]), -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]),
+          -(f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2]), 1.0f }
+    };
+
+    float focal = 1.0f / tanf(FIELD_OF_VIEW * 3.14159265f / 360.0f);
+    NullMatrix projection = {
+        { focal / ASPECT_RATIO, 0.0f, 0.0f, 0.0f },
+        { 0.0f, focal, 0.0f, 0.0f },
+        { 0.0f, 0.0f, FAR_PLANE / (FAR_PLANE - NEAR_PLANE), 1.0f },
+        { 0.0f, 0.0f, -NEAR_PLANE * FAR_PLANE / (FAR_PLANE - NEAR_PLANE), 0.0f }
+    };
+    NullMatrix_Multiply(projection, view, viewProjection);
+}
+
+int main(int argc, char** argv)
+{
+    const char* workloadName = "grid";
+    const char* reportPath = "benchmark.json";
+    const char* capturePath = NULL;
+    uint32_t frameCount = BENCHMARK_DEFAULT_FRAMES;
+    uint32_t warmUpFrames = BENCHMARK_DEFAULT_WARM_UP_FRAMES;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc)
+            workloadName = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warm-up") == 0 && i + 1 < argc)
+            warmUpFrames = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+            reportPath = argv[++i];
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            capturePath = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: benchmark-null [--workload NAME] [--frames N] [--warm-up N] [--report PATH] "
+                            "[--capture PATH]\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    double start = GetMilliseconds();
+    const BenchmarkWorkload* workload = Benchmark_FindWorkload(workloadName);
+    Benchmark benchmark;
+    if (workload == NULL || !Benchmark_Create(&benchmark, workload, warmUpFrames, frameCount))
+    {
+        fprintf(stderr, "Unknown workload %s or no frames, the workloads are %s\n", workloadName,
+                Benchmark_GetWorkloadNames());
+        return EXIT_FAILURE;
+    }
+    NullMatrix* worlds = malloc(workload->InstanceCount * sizeof(NullMatrix));
+    if (worlds == NULL)
+        return EXIT_FAILURE;
+    NullBackend backend;
+    if (!NullBackend_Create(&backend, capturePath))
+    {
+        fprintf(stderr, "Couldn't open the capture %s\n", capturePath);
+        free(worlds);
+        Benchmark_Destroy(&benchmark);
+        return EXIT_FAILURE;
+    }
+    double end = GetMilliseconds();
+    Benchmark_AddStartupPhase(&benchmark, "workload", end - start);
+
+    double frameStart = end;
+    uint32_t totalFrames = Benchmark_GetTotalFrames(&benchmark);
+    for (uint32_t frame = 0; frame < totalFrames; ++frame)
+    {
+        BenchmarkFrame script;
+        Benchmark_GetFrame(&benchmark, frame, &script);
+        for (uint32_t i = 0; i < workload->InstanceCount; ++i)
+        {
+            float position[3], angles[3];
+            Benchmark_GetInstance(&benchmark, i, &script, position, angles);
+            ComposeWorld(position, angles, worlds[i]);
+        }
+        NullMatrix viewProjection;
+        ComposeViewProjection(script.Eye, script.Target, viewProjection);
+        double simulated = GetMilliseconds();
+
+        NullBackend_SubmitFrame(&backend, frame, viewProjection, worlds, workload->InstanceCount);
+        double submitted = GetMilliseconds();
+
+        Benchmark_Record(&benchmark, BENCHMARK_METRIC_SIMULATION, frame, simulated - frameStart);
+        Benchmark_Record(&benchmark, BENCHMARK_METRIC_RENDER, frame, submitted - simulated);
+        Benchmark_Record(&benchmark, BENCHMARK_METRIC_FRAME, frame, submitted - frameStart);
+        frameStart = submitted;
+    }
+
+    bool captured = NullBackend_Destroy(&backend);
+    if (!captured)
+        fprintf(stderr, "The capture %s couldn't be written\n", capturePath);
+    bool written = Benchmark_WriteReport(&benchmark, "null", reportPath);
+    printf("%s: %u frames after %u of warm-up, %llu draws submitted, %llu instances culled, report %s %s\n",
+           workload->Name, frameCount, warmUpFrames, (unsigned long long)backend.SubmittedDraws,
+           (unsigned long long)backend.CulledInstances, written ? "written to" : "couldn't be written to", reportPath);
+    free(worlds);
+    Benchmark_Destroy(&benchmark);
+    return written && captured ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,186 @@
+// Reads the command captures the app's --capture and benchmark-null --capture write.
+//
+//   command-capture stats FILE
+//   command-capture replay FILE [--runs N]
+//   command-capture diff FILE FILE [--max N]
+//
+// stats counts the commands of every opcode. replay decodes the capture into the null sink and
+// reports the fastest run, the cost of reading a capture without a GPU. diff walks two captures
+// command by command and lists the first commands that differ, with the frame they're in, then
+// how the counts of the opcodes changed. It exits with a failure when the captures differ.
+
+#include "command_stream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_RUNS 5
+#define DEFAULT_MAX_DIFFERENCES 10
+
+static double GetMilliseconds(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+static bool CountCommands(const char* path, CommandCounts* counts)
+{
+    CommandReader reader;
+    if (!CommandReader_Open(&reader, path))
+    {
+        fprintf(stderr, "%s isn't a command capture\n", path);
+        return false;
+    }
+    memset(counts, 0, sizeof(*counts));
+    bool read = CommandReader_Replay(&reader, CommandCounts_Add, counts);
+    CommandReader_Close(&reader);
+    if (!read)
+        fprintf(stderr, "%s is malformed after %llu commands\n", path, (unsigned long long)counts->Commands);
+    return read;
+}
+
+static int Stats(const char* path)
+{
+    CommandCounts counts;
+    if (!CountCommands(path, &counts))
+        return EXIT_FAILURE;
+    printf("%s: %llu commands, %llu frames, %llu instances drawn\n", path, (unsigned long long)counts.Commands,
+           (unsigned long long)counts.Frames, (unsigned long long)counts.Draws);
+    for (int opcode = 1; opcode < COMMAND_OPCODE_COUNT; ++opcode)
+    {
+        if (counts.Opcodes[opcode] > 0)
+            printf("  %-34s %llu\n", Command_GetName(opcode), (unsigned long long)counts.Opcodes[opcode]);
+    }
+    return EXIT_SUCCESS;
+}
+
+static int Replay(const char* path, int runs)
+{
+    double best = 0.0;
+    CommandCounts counts;
+    for (int run = 0; run < runs; ++run)
+    {
+        double start = GetMilliseconds();
+        if (!CountCommands(path, &counts))
+            return EXIT_FAILURE;
+        double milliseconds = GetMilliseconds() - start;
+        if (run == 0 || milliseconds < best)
+            best = milliseconds;
+    }
+    printf("%s: %llu commands, %llu frames replayed into the null sink in %.3f ms, %.0f commands/s, "
+           "%.3f ms per frame\n", path, (unsigned long long)counts.Commands, (unsigned long long)counts.Frames, best,
+           best > 0.0 ? counts.Commands * 1000.0 / best : 0.0, counts.Frames > 0 ? best / counts.Frames : 0.0);
+    return EXIT_SUCCESS;
+}
+
+// Position of the command a reader returned last, in the frame it's in
+typedef struct CapturePosition
+{
+    uint64_t Frame;
+    uint64_t Index;
+} CapturePosition;
+
+static bool Next(CommandReader* reader, Command* command, CapturePosition* position, CommandCounts* counts)
+{
+    if (!CommandReader_Next(reader, command))
+        return false;
+    if (command->Opcode == COMMAND_FRAME)
+    {
+        position->Frame = command->Frame;
+        position->Index = 0;
+    }
+    else
+        position->Index++;
+    CommandCounts_Add(counts, command);
+    return true;
+}
+
+static int Diff(const char* first, const char* second, uint64_t maxDifferences)
+{
+    CommandReader readers[2];
+    if (!CommandReader_Open(&readers[0], first))
+    {
+        fprintf(stderr, "%s isn't a command capture\n", first);
+        return EXIT_FAILURE;
+    }
+    if (!CommandReader_Open(&readers[1], second))
+    {
+        fprintf(stderr, "%s isn't a command capture\n", second);
+        CommandReader_Close(&readers[0]);
+        return EXIT_FAILURE;
+    }
+
+    // The commands are compared as they were encoded, the objects by their ids
+    CommandCounts counts[2] = { 0 };
+    CapturePosition positions[2] = { 0 };
+    uint64_t differences = 0;
+    for (;;)
+    {
+        Command commands[2];
+        bool read[2];
+        for (int i = 0; i < 2; ++i)
+            read[i] = Next(&readers[i], &commands[i], &positions[i], &counts[i]);
+        if (!read[0] && !read[1])
+            break;
+
+        bool differ = read[0] != read[1] || commands[0].Opcode != commands[1].Opcode ||
+                      readers[0].PayloadWords != readers[1].PayloadWords ||
+                      memcmp(readers[0].Payload, readers[1].Payload, readers[0].PayloadWords * sizeof(uint32_t)) != 0;
+        if (!differ)
+            continue;
+        if (differences++ < maxDifferences)
+        {
+            int at = read[0] ? 0 : 1;
+            printf("frame %llu, command %llu: %s in %s, %s in %s\n", (unsigned long long)positions[at].Frame,
+                   (unsigned long long)positions[at].Index, read[0] ? Command_GetName(commands[0].Opcode) : "end",
+                   first, read[1] ? Command_GetName(commands[1].Opcode) : "end", second);
+        }
+    }
+
+    bool malformed = readers[0].Failed || readers[1].Failed;
+    CommandReader_Close(&readers[0]);
+    CommandReader_Close(&readers[1]);
+    if (malformed)
+    {
+        fprintf(stderr, "%s or %s is malformed\n", first, second);
+        return EXIT_FAILURE;
+    }
+
+    for (int opcode = 1; opcode < COMMAND_OPCODE_COUNT; ++opcode)
+    {
+        if (counts[0].Opcodes[opcode] != counts[1].Opcodes[opcode])
+        {
+            printf("  %-34s %llu -> %llu\n", Command_GetName(opcode), (unsigned long long)counts[0].Opcodes[opcode],
+                   (unsigned long long)counts[1].Opcodes[opcode]);
+        }
+    }
+    printf("%s and %s: %llu and %llu commands, %llu differ\n", first, second, (unsigned long long)counts[0].Commands,
+           (unsigned long long)counts[1].Commands, (unsigned long long)differences);
+    return differences == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 3 && strcmp(argv[1], "stats") == 0)
+        return Stats(argv[2]);
+    if (argc >= 3 && strcmp(argv[1], "replay") == 0 && (argc == 3 || (argc == 5 && strcmp(argv[3], "--runs") == 0)))
+    {
+        int runs = argc == 5 ? atoi(argv[4]) : DEFAULT_RUNS;
+        if (runs > 0)
+            return Replay(argv[2], runs);
+    }
+    if (argc >= 4 && strcmp(argv[1], "diff") == 0 && (argc == 4 || (argc == 6 && strcmp(argv[4], "--max") == 0)))
+    {
+        long long maxDifferences = argc == 6 ? atoll(argv[5]) : DEFAULT_MAX_DIFFERENCES;
+        if (maxDifferences >= 0)
+            return Diff(argv[2], argv[3], (uint64_t)maxDifferences);
+    }
+
+    fprintf(stderr, "usage: command-capture stats FILE\n"
+                    "       command-capture replay FILE [--runs N]\n"
+                    "       command-capture diff FILE FILE [--max N]\n");
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,256 @@
+// Runs the frame limiter against a simulated clock, whose sleeps wake late the way the ones of
+// different systems do, and then against the clock and the sleep of this machine.
+//
+//   limiter-sim [--rate HZ] [--frames N] [--real-frames N] [--seed N]
+//
+// Every frame does a random amount of work below the period, a few take several periods.
+// The simulated runs check that no frame ends before its deadline, that the frames average the
+// period, that a late frame doesn't shorten the next ones and that the sleeps rarely overshoot.
+// The jitter of the frame intervals from the period and the share of the wait spent spinning
+// are reported for every run, the run on this machine is only reported.
+
+#include "frame_limiter.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Cost of reading the simulated clock, the granularity of spinning
+#define CLOCK_READ_NANOSECONDS 50
+#define LONG_FRAME_CHANCE 0.02
+#define LONG_FRAME_PERIODS 2.5
+#define MAX_MEAN_ERROR 0.005
+#define MAX_OVERSLEPT_SHARE 0.03
+#define MAX_MEDIAN_JITTER 5000
+
+typedef enum SleepModel
+{
+    // High resolution timers waking 50 to 150 us late
+    SLEEP_MODEL_PRECISE,
+    // Waking on the next tick of a 1 ms system timer, then up to 200 us late
+    SLEEP_MODEL_TICKS,
+    // Precise, but 1% of the sleeps are preempted for another 2 to 4 ms
+    SLEEP_MODEL_PREEMPTED,
+    SLEEP_MODEL_COUNT
+} SleepModel;
+
+static const char* g_SleepModelNames[SLEEP_MODEL_COUNT] = {
+    [SLEEP_MODEL_PRECISE] = "precise",
+    [SLEEP_MODEL_TICKS] = "ticks",
+    [SLEEP_MODEL_PREEMPTED] = "preempted"
+};
+
+typedef struct SimulatedClock
+{
+    int64_t Now;
+    SleepModel Model;
+} SimulatedClock;
+
+typedef struct RunStats
+{
+    double MeanInterval;
+    // Of the intervals of frames whose work fit the period, from the period. The mean keeps the
+    // sign, drifting off the period would show there.
+    double MeanError;
+    double MedianJitter;
+    double P99Jitter;
+    double MaxJitter;
+    // Shortest interval after a frame that ended late
+    double MinRecoveryInterval;
+    uint32_t EarlyCount;
+    double OversleptShare;
+    double SpinShare;
+} RunStats;
+
+static uint64_t g_Random;
+
+static double RandomUnit(void)
+{
+    // xorshift64*
+    g_Random ^= g_Random >> 12;
+    g_Random ^= g_Random << 25;
+    g_Random ^= g_Random >> 27;
+    return (double)((g_Random * 0x2545F4914F6CDD1Dull) >> 11) / 9007199254740992.0;
+}
+
+static int64_t ReadSimulatedClock(void* context)
+{
+    SimulatedClock* clock = context;
+    clock->Now += CLOCK_READ_NANOSECONDS;
+    return clock->Now;
+}
+
+static void SleepSimulated(void* context, int64_t nanoseconds)
+{
+    SimulatedClock* clock = context;
+    int64_t wake = clock->Now + nanoseconds;
+    switch (clock->Model)
+    {
+    case SLEEP_MODEL_PRECISE:
+        wake += 50000 + (int64_t)(RandomUnit() * 100000.0);
+        break;
+    case SLEEP_MODEL_TICKS:
+        wake = (wake / 1000000 + 1) * 1000000 + (int64_t)(RandomUnit() * 200000.0);
+        break;
+    default:
+        wake += 50000 + (int64_t)(RandomUnit() * 100000.0);
+        if (RandomUnit() < 0.01)
+            wake += 2000000 + (int64_t)(RandomUnit() * 2000000.0);
+        break;
+    }
+    clock->Now = wake;
+}
+
+// Work of a frame, mostly between a fifth and 90% of the period
+static int64_t GetWork(int64_t period)
+{
+    if (RandomUnit() < LONG_FRAME_CHANCE)
+        return (int64_t)(LONG_FRAME_PERIODS * period);
+    return (int64_t)((0.2 + 0.7 * RandomUnit()) * period);
+}
+
+static int CompareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Works by advancing the simulated clock, or by spinning on the system one
+static void DoWork(SimulatedClock* clock, int64_t nanoseconds)
+{
+    if (clock != NULL)
+    {
+        clock->Now += nanoseconds;
+        return;
+    }
+    int64_t end = FrameLimiter_GetSystemTime(NULL) + nanoseconds;
+    while (FrameLimiter_GetSystemTime(NULL) < end)
+    {
+    }
+}
+
+static bool Run(FrameLimiter* limiter, SimulatedClock* clock, uint32_t frameCount, RunStats* stats)
+{
+    double* jitters = malloc(frameCount * sizeof(double));
+    if (jitters == NULL)
+        return false;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->MinRecoveryInterval = INFINITY;
+    int64_t period = limiter->Period;
+    int64_t first = FrameLimiter_Wait(limiter);
+    int64_t previous = first;
+    uint32_t jitterCount = 0;
+    double errorSum = 0.0;
+    bool previousLate = false;
+    for (uint32_t i = 1; i < frameCount; ++i)
+    {
+        DoWork(clock, GetWork(period));
+
+        int64_t deadline = limiter->Deadline;
+        uint64_t lateCount = limiter->Counters.LateCount;
+        int64_t end = FrameLimiter_Wait(limiter);
+        bool late = limiter->Counters.LateCount != lateCount;
+        stats->EarlyCount += end < deadline;
+
+        double interval = (double)(end - previous);
+        if (previousLate && !late)
+            stats->MinRecoveryInterval = fmin(stats->MinRecoveryInterval, interval);
+        else if (!late)
+        {
+            errorSum += interval - (double)period;
+            jitters[jitterCount++] = fabs(interval - (double)period);
+        }
+        previousLate = late;
+        previous = end;
+    }
+
+    const FrameLimiterCounters* counters = &limiter->Counters;
+    stats->MeanInterval = (double)(previous - first) / (frameCount - 1);
+    qsort(jitters, jitterCount, sizeof(double), CompareDoubles);
+    if (jitterCount > 0)
+    {
+        stats->MeanError = errorSum / jitterCount / (double)period;
+        stats->MedianJitter = jitters[jitterCount / 2];
+        stats->P99Jitter = jitters[(uint32_t)(jitterCount * 0.99)];
+        stats->MaxJitter = jitters[jitterCount - 1];
+    }
+    uint64_t waitCount = counters->FrameCount - counters->LateCount;
+    stats->OversleptShare = waitCount > 0 ? (double)counters->OversleptCount / waitCount : 0.0;
+    int64_t waited = counters->SleptTime + counters->SpunTime;
+    stats->SpinShare = waited > 0 ? (double)counters->SpunTime / waited : 0.0;
+    free(jitters);
+    return true;
+}
+
+static void PrintStats(const char* name, const RunStats* stats, const char* result)
+{
+    printf("%-10s %7.3f ms per frame, %+7.3f%% off the period, jitter %6.1f us median %7.1f us p99 "
+           "%7.1f us max, %4.1f%% overslept, %4.1f%% of the wait spun %s\n", name, stats->MeanInterval / 1e6,
+           stats->MeanError * 100.0, stats->MedianJitter / 1e3, stats->P99Jitter / 1e3, stats->MaxJitter / 1e3,
+           stats->OversleptShare * 100.0, stats->SpinShare * 100.0, result);
+}
+
+int main(int argc, char** argv)
+{
+    double rate = 120.0;
+    uint32_t frameCount = 20000;
+    uint32_t realFrameCount = 600;
+    g_Random = 0x9E3779B97F4A7C15ull;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--real-frames") == 0 && i + 1 < argc)
+            realFrameCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            g_Random = strtoull(argv[++i], NULL, 0) | 1;
+        else
+        {
+            fprintf(stderr, "usage: limiter-sim [--rate HZ] [--frames N] [--real-frames N] [--seed N]\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (!(rate > 0.0) || frameCount < 2)
+    {
+        fprintf(stderr, "The rate has to be positive and the runs at least 2 frames long\n");
+        return EXIT_FAILURE;
+    }
+
+    bool passed = true;
+    for (int model = 0; model < SLEEP_MODEL_COUNT; ++model)
+    {
+        SimulatedClock clock = { .Now = 1000000000, .Model = (SleepModel)model };
+        FrameLimiter limiter;
+        RunStats stats;
+        if (!FrameLimiter_Create(&limiter, rate, ReadSimulatedClock, SleepSimulated, &clock) ||
+            !Run(&limiter, &clock, frameCount, &stats))
+            return EXIT_FAILURE;
+
+        // Frames after a late one get at least the time the limiter gives back, 3/4 of a period
+        double period = (double)limiter.Period;
+        bool held = stats.EarlyCount == 0 &&
+                    fabs(stats.MeanError) <= MAX_MEAN_ERROR &&
+                    stats.MinRecoveryInterval >= 0.75 * period &&
+                    stats.OversleptShare <= MAX_OVERSLEPT_SHARE &&
+                    stats.MedianJitter <= MAX_MEDIAN_JITTER;
+        PrintStats(g_SleepModelNames[model], &stats, held ? "ok" : "FAILED");
+        passed = passed && held;
+        FrameLimiter_Destroy(&limiter);
+    }
+
+    if (realFrameCount >= 2)
+    {
+        FrameLimiter limiter;
+        RunStats stats;
+        if (!FrameLimiter_Create(&limiter, rate, NULL, NULL, NULL) || !Run(&limiter, NULL, realFrameCount, &stats))
+            return EXIT_FAILURE;
+        PrintStats("system", &stats, "");
+        FrameLimiter_Destroy(&limiter);
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,331 @@
+// Runs the residency manager against synthetic workloads, with the GPU and the OS simulated:
+// submissions complete two frames after they're made unless the manager waits for them, and
+// the usage the OS reports is the simulated resident heaps plus a fixed amount of untracked
+// memory.
+//
+//   residency-sim [--frames N] [--seed N]
+//
+// Every workload checks that each submission only uses resident heaps, that no heap is evicted
+// while a submission in flight uses it and that paging calls alternate per heap, like D3D12
+// requires. The paging traffic, the batches, the waits and the time spent in the manager are
+// reported.
+
+#include "residency_manager.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MEGABYTE (1024ull * 1024ull)
+#define FRAMES_IN_FLIGHT 2
+#define EXTERNAL_USAGE (256 * MEGABYTE)
+#define MAX_HEAPS 2048
+
+typedef struct SimulatedHeap
+{
+    ResidencyObject Residency;
+    uint64_t Size;
+    // As the simulated GPU sees it
+    bool Resident;
+    uint64_t LastUsedFence;
+} SimulatedHeap;
+
+typedef struct Simulation
+{
+    SimulatedHeap Heaps[MAX_HEAPS];
+    uint32_t HeapCount;
+    uint64_t ResidentSize;
+    uint64_t CompletedFence;
+    // Of the current frame
+    uint64_t EvictedSize;
+    uint64_t MadeResidentSize;
+    uint32_t BatchCount;
+    uint32_t LargestBatch;
+    bool Waited;
+    bool Failed;
+} Simulation;
+
+typedef struct Workload
+{
+    const char* Name;
+    const char* Description;
+    void (*Create)(Simulation* simulation);
+    // Fills the set of a frame and returns the budget of it
+    uint64_t (*Frame)(Simulation* simulation, ResidencyManager* manager, uint32_t frame, uint32_t frameCount);
+} Workload;
+
+static uint64_t g_Random;
+
+static uint32_t Random(void)
+{
+    // xorshift64*
+    g_Random ^= g_Random >> 12;
+    g_Random ^= g_Random << 25;
+    g_Random ^= g_Random >> 27;
+    return (uint32_t)((g_Random * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static double RandomUnit(void)
+{
+    return Random() / 4294967296.0;
+}
+
+static double GetSeconds(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+static void Fail(Simulation* simulation, const char* message)
+{
+    if (!simulation->Failed)
+        fprintf(stderr, "%s\n", message);
+    simulation->Failed = true;
+}
+
+static void EvictSimulated(void* context, void* const* pageables, uint32_t count)
+{
+    Simulation* simulation = context;
+    simulation->BatchCount++;
+    simulation->LargestBatch = count > simulation->LargestBatch ? count : simulation->LargestBatch;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        SimulatedHeap* heap = pageables[i];
+        if (!heap->Resident)
+            Fail(simulation, "Evicted a heap that wasn't resident");
+        if (heap->LastUsedFence > simulation->CompletedFence)
+            Fail(simulation, "Evicted a heap a submission in flight uses");
+        heap->Resident = false;
+        simulation->ResidentSize -= heap->Size;
+        simulation->EvictedSize += heap->Size;
+    }
+}
+
+static void MakeSimulatedResident(void* context, void* const* pageables, uint32_t count)
+{
+    Simulation* simulation = context;
+    simulation->BatchCount++;
+    simulation->LargestBatch = count > simulation->LargestBatch ? count : simulation->LargestBatch;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        SimulatedHeap* heap = pageables[i];
+        if (heap->Resident)
+            Fail(simulation, "Made a resident heap resident");
+        heap->Resident = true;
+        simulation->ResidentSize += heap->Size;
+        simulation->MadeResidentSize += heap->Size;
+    }
+}
+
+static void WaitSimulated(void* context, uint64_t fence)
+{
+    Simulation* simulation = context;
+    simulation->CompletedFence = fence > simulation->CompletedFence ? fence : simulation->CompletedFence;
+    simulation->Waited = true;
+}
+
+static void AddHeap(Simulation* simulation, uint64_t size)
+{
+    SimulatedHeap* heap = &simulation->Heaps[simulation->HeapCount++];
+    heap->Size = size;
+}
+
+// 4MB to 64MB, textures and buffers of a level
+static void CreateLevelHeaps(Simulation* simulation, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        AddHeap(simulation, (4 + Random() % 61) * MEGABYTE);
+}
+
+static uint64_t GetTotalSize(const Simulation* simulation, uint32_t first, uint32_t count)
+{
+    uint64_t size = 0;
+    for (uint32_t i = first; i < first + count; ++i)
+        size += simulation->Heaps[i % simulation->HeapCount].Size;
+    return size;
+}
+
+static void CreateFitting(Simulation* simulation)
+{
+    CreateLevelHeaps(simulation, 128);
+}
+
+// Three quarters of the heaps every frame, like a camera turning the quarter left out changes
+// every second. The whole of them fits the budget.
+static uint64_t FrameFitting(Simulation* simulation, ResidencyManager* manager, uint32_t frame, uint32_t frameCount)
+{
+    (void)frameCount;
+    for (uint32_t i = 0; i < simulation->HeapCount; ++i)
+    {
+        if ((i + frame / 60) % 4 != 0)
+            ResidencyManager_Use(manager, &simulation->Heaps[i].Residency);
+    }
+    return GetTotalSize(simulation, 0, simulation->HeapCount) + EXTERNAL_USAGE + 512 * MEGABYTE;
+}
+
+static void CreateStreaming(Simulation* simulation)
+{
+    CreateLevelHeaps(simulation, 1024);
+}
+
+// Moving through a world, a window of 64 heaps slides by one every 4 frames. Twice the window
+// fits the budget.
+static uint64_t FrameStreaming(Simulation* simulation, ResidencyManager* manager, uint32_t frame, uint32_t frameCount)
+{
+    (void)frameCount;
+    uint32_t first = frame / 4;
+    for (uint32_t i = first; i < first + 64; ++i)
+        ResidencyManager_Use(manager, &simulation->Heaps[i % simulation->HeapCount].Residency);
+    return 2 * GetTotalSize(simulation, 0, 64) + EXTERNAL_USAGE;
+}
+
+static void CreateSkewed(Simulation* simulation)
+{
+    CreateLevelHeaps(simulation, 512);
+}
+
+// 48 heaps a frame, the first ones far more often than the rest, a budget of a third of them
+static uint64_t FrameSkewed(Simulation* simulation, ResidencyManager* manager, uint32_t frame, uint32_t frameCount)
+{
+    (void)frame;
+    (void)frameCount;
+    for (int i = 0; i < 48; ++i)
+    {
+        // Cubing a uniform number favours the low indices
+        double unit = RandomUnit();
+        uint32_t index = (uint32_t)(simulation->HeapCount * unit * unit * unit);
+        ResidencyManager_Use(manager, &simulation->Heaps[index].Residency);
+    }
+    return GetTotalSize(simulation, 0, simulation->HeapCount) / 3 + EXTERNAL_USAGE;
+}
+
+// The fitting workload while another application takes a fifth of the budget in the middle third
+static uint64_t FrameBudgetDrop(Simulation* simulation, ResidencyManager* manager, uint32_t frame, uint32_t frameCount)
+{
+    uint64_t budget = FrameFitting(simulation, manager, frame, frameCount);
+    return frame >= frameCount / 3 && frame < 2 * frameCount / 3 ? budget / 5 * 4 : budget;
+}
+
+// Every heap every frame, a quarter more than the budget. Nothing can be evicted, the OS pages.
+static uint64_t FrameOversubscribed(Simulation* simulation, ResidencyManager* manager, uint32_t frame, uint32_t frameCount)
+{
+    (void)frame;
+    (void)frameCount;
+    for (uint32_t i = 0; i < simulation->HeapCount; ++i)
+        ResidencyManager_Use(manager, &simulation->Heaps[i].Residency);
+    return GetTotalSize(simulation, 0, simulation->HeapCount) * 4 / 5 + EXTERNAL_USAGE;
+}
+
+static bool Run(const Workload* workload, uint32_t frameCount)
+{
+    static Simulation simulation;
+    memset(&simulation, 0, sizeof(simulation));
+    workload->Create(&simulation);
+
+    ResidencyManager manager;
+    ResidencyManager_Create(&manager, EvictSimulated, MakeSimulatedResident, WaitSimulated, &simulation);
+    for (uint32_t i = 0; i < simulation.HeapCount; ++i)
+    {
+        SimulatedHeap* heap = &simulation.Heaps[i];
+        if (!ResidencyManager_Track(&manager, &heap->Residency, heap, heap->Size))
+            return false;
+        // Created resident, as in D3D12
+        heap->Resident = true;
+        simulation.ResidentSize += heap->Size;
+    }
+
+    uint64_t pagedSize = 0;
+    uint64_t peakPagedSize = 0;
+    uint32_t pagingFrames = 0;
+    uint32_t overBudgetFrames = 0;
+    uint32_t waitingFrames = 0;
+    uint32_t batchCount = 0;
+    uint32_t largestBatch = 0;
+    double seconds = 0.0;
+    for (uint32_t frame = 0; frame < frameCount && !simulation.Failed; ++frame)
+    {
+        uint64_t submitFence = frame + 1;
+        simulation.CompletedFence = submitFence > FRAMES_IN_FLIGHT ? submitFence - 1 - FRAMES_IN_FLIGHT : 0;
+        simulation.EvictedSize = 0;
+        simulation.MadeResidentSize = 0;
+        simulation.BatchCount = 0;
+        simulation.LargestBatch = 0;
+        simulation.Waited = false;
+
+        double start = GetSeconds();
+        uint64_t budget = workload->Frame(&simulation, &manager, frame, frameCount);
+        ResidencyManager_SetBudget(&manager, budget, simulation.ResidentSize + EXTERNAL_USAGE);
+        // The set is lost once submitted, check it before
+        uint32_t setCount = manager.SetCount;
+        SimulatedHeap* set[MAX_HEAPS];
+        for (uint32_t i = 0; i < setCount; ++i)
+            set[i] = (SimulatedHeap*)manager.Set[i]->Pageable;
+        bool fits = ResidencyManager_Submit(&manager, simulation.CompletedFence, submitFence);
+        seconds += GetSeconds() - start;
+
+        for (uint32_t i = 0; i < setCount; ++i)
+        {
+            if (!set[i]->Resident)
+                Fail(&simulation, "Submitted a heap that isn't resident");
+            set[i]->LastUsedFence = submitFence;
+        }
+        if (manager.Counters.ResidentSize != simulation.ResidentSize)
+            Fail(&simulation, "The resident size of the manager drifted");
+
+        uint64_t framePagedSize = simulation.EvictedSize + simulation.MadeResidentSize;
+        pagedSize += framePagedSize;
+        peakPagedSize = framePagedSize > peakPagedSize ? framePagedSize : peakPagedSize;
+        pagingFrames += framePagedSize > 0;
+        overBudgetFrames += !fits;
+        waitingFrames += simulation.Waited;
+        batchCount += simulation.BatchCount;
+        largestBatch = simulation.LargestBatch > largestBatch ? simulation.LargestBatch : largestBatch;
+    }
+
+    const ResidencyCounters* counters = &manager.Counters;
+    printf("%-16s %s\n", workload->Name, workload->Description);
+    printf("%-16s %u heaps, %.0f MB, %u frames: %u paging, %u waiting, %u over budget\n", "",
+           simulation.HeapCount, (double)counters->TrackedSize / MEGABYTE, frameCount, pagingFrames,
+           waitingFrames, overBudgetFrames);
+    printf("%-16s %.1f MB paged per frame, %.0f MB at most, %u evicted (%.0f MB), %u made resident (%.0f MB)\n", "",
+           (double)pagedSize / MEGABYTE / frameCount, (double)peakPagedSize / MEGABYTE, counters->EvictionCount,
+           (double)counters->EvictedSize / MEGABYTE, counters->MadeResidentCount,
+           (double)counters->MadeResidentSize / MEGABYTE);
+    printf("%-16s %u batches of %u heaps at most, %.2f us per frame in the manager\n", "", batchCount,
+           largestBatch, seconds * 1e6 / frameCount);
+
+    ResidencyManager_Destroy(&manager);
+    return !simulation.Failed;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frameCount = 3000;
+    g_Random = 0x9E3779B97F4A7C15ull;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            g_Random = strtoull(argv[++i], NULL, 0) | 1;
+        else
+        {
+            fprintf(stderr, "usage: residency-sim [--frames N] [--seed N]\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    const Workload workloads[] = {
+        { "fitting", "a turning three quarters of the heaps, all fit", CreateFitting, FrameFitting },
+        { "streaming", "a sliding window of heaps, twice it fits", CreateStreaming, FrameStreaming },
+        { "skewed", "heaps picked with a skew, a third of them fits", CreateSkewed, FrameSkewed },
+        { "budget-drop", "the budget drops by a fifth in the middle third", CreateFitting, FrameBudgetDrop },
+        { "oversubscribed", "every heap every frame, a quarter over", CreateFitting, FrameOversubscribed }
+    };
+    bool passed = true;
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); ++i)
+        passed = Run(&workloads[i], frameCount) && passed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,294 @@
+// Replays GPU frame time traces through the dynamic resolution controller and checks that it
+// holds the target without oscillating.
+//
+//   resolution-sim [--target MS] [--frames N] [--seed N] [--trace FILE]
+//
+// A trace holds the GPU time of every frame at full resolution. The simulated GPU takes a
+// fixed part of it whatever the scale and the rest in proportion to the pixel count, and the
+// controller learns about every frame a few frames late, like from timestamp queries read back
+// once the frame's fence completed. The built in traces are generated from the seed and
+// checked, a recorded one holds a time in milliseconds per line and is only reported.
+
+#include "dynamic_resolution.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIXED_FRACTION 0.15f
+#define LATENCY_FRAMES 3
+// Frames at the start the controller gets to settle
+#define WARM_UP_FRAMES 120
+// Changes of direction closer than this count as oscillating
+#define FLIP_FRAMES 10
+// Frames averaged for the cost the noise is around
+#define EXPECTED_FRAMES 31
+#define MAX_HOLD_ERROR 0.06
+#define MAX_FLIP_RATE 0.005
+
+typedef struct Trace
+{
+    const char* Name;
+    const char* Description;
+    float* Milliseconds;
+    uint32_t FrameCount;
+} Trace;
+
+static uint64_t g_Random;
+
+static float RandomUnit(void)
+{
+    // xorshift64*
+    g_Random ^= g_Random >> 12;
+    g_Random ^= g_Random << 25;
+    g_Random ^= g_Random >> 27;
+    return (float)((g_Random * 0x2545F4914F6CDD1Dull) >> 40) / 16777216.0f;
+}
+
+// Roughly normal noise, the sum of uniform ones
+static float RandomNoise(float deviation)
+{
+    float sum = RandomUnit() + RandomUnit() + RandomUnit() + RandomUnit() - 2.0f;
+    return sum * deviation * 1.7320508f;
+}
+
+static float GetGpuMilliseconds(float fullMilliseconds, float scale)
+{
+    return fullMilliseconds * (FIXED_FRACTION + (1.0f - FIXED_FRACTION) * scale * scale);
+}
+
+// Scale that takes exactly the target, within the bounds
+static float GetIdealScale(const DynamicResolutionSettings* settings, float fullMilliseconds)
+{
+    float pixels = (settings->TargetMilliseconds / fullMilliseconds - FIXED_FRACTION) / (1.0f - FIXED_FRACTION);
+    float scale = pixels > 0.0f ? sqrtf(pixels) : 0.0f;
+    return fminf(fmaxf(scale, settings->MinScale), settings->MaxScale);
+}
+
+static bool GenerateTrace(Trace* trace, const char* name, uint32_t frameCount)
+{
+    trace->Milliseconds = malloc(frameCount * sizeof(float));
+    if (trace->Milliseconds == NULL)
+        return false;
+    trace->FrameCount = frameCount;
+    trace->Name = name;
+
+    for (uint32_t i = 0; i < frameCount; ++i)
+    {
+        float* milliseconds = &trace->Milliseconds[i];
+        float progress = (float)i / frameCount;
+        if (strcmp(name, "steady") == 0)
+        {
+            trace->Description = "20 ms with 5% noise";
+            *milliseconds = 20.0f * (1.0f + RandomNoise(0.05f));
+        }
+        else if (strcmp(name, "light") == 0)
+        {
+            trace->Description = "9 ms with 5% noise, full resolution fits";
+            *milliseconds = 9.0f * (1.0f + RandomNoise(0.05f));
+        }
+        else if (strcmp(name, "step") == 0)
+        {
+            trace->Description = "11 ms, 24 ms in the middle third";
+            *milliseconds = (progress >= 1.0f / 3.0f && progress < 2.0f / 3.0f ? 24.0f : 11.0f) *
+                            (1.0f + RandomNoise(0.03f));
+        }
+        else if (strcmp(name, "ramp") == 0)
+        {
+            trace->Description = "8 ms rising to 30 ms";
+            *milliseconds = (8.0f + 22.0f * progress) * (1.0f + RandomNoise(0.03f));
+        }
+        else if (strcmp(name, "spikes") == 0)
+        {
+            trace->Description = "18 ms with a 2.5x spike in 1% of the frames";
+            *milliseconds = 18.0f * (1.0f + RandomNoise(0.03f)) * (RandomUnit() < 0.01f ? 2.5f : 1.0f);
+        }
+        else
+        {
+            trace->Description = "18 ms with 20% noise";
+            *milliseconds = 18.0f * (1.0f + RandomNoise(0.2f));
+        }
+        *milliseconds = fmaxf(*milliseconds, 0.1f);
+    }
+    return true;
+}
+
+static bool LoadTrace(Trace* trace, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+
+    uint32_t capacity = 1024;
+    trace->Milliseconds = malloc(capacity * sizeof(float));
+    trace->FrameCount = 0;
+    trace->Name = path;
+    trace->Description = "recorded";
+    char line[256];
+    while (trace->Milliseconds != NULL && fgets(line, sizeof(line), file) != NULL)
+    {
+        float milliseconds;
+        // Headers and comments don't parse
+        if (sscanf(line, "%f", &milliseconds) != 1 || !(milliseconds > 0.0f))
+            continue;
+        if (trace->FrameCount == capacity)
+        {
+            capacity *= 2;
+            float* grown = realloc(trace->Milliseconds, capacity * sizeof(float));
+            if (grown == NULL)
+                free(trace->Milliseconds);
+            trace->Milliseconds = grown;
+            if (grown == NULL)
+                break;
+        }
+        trace->Milliseconds[trace->FrameCount++] = milliseconds;
+    }
+    fclose(file);
+    return trace->Milliseconds != NULL && trace->FrameCount > WARM_UP_FRAMES;
+}
+
+// Returns false when a checked trace wasn't held or oscillated
+static bool Replay(const Trace* trace, const DynamicResolutionSettings* settings, bool check)
+{
+    DynamicResolution controller;
+    DynamicResolution_Init(&controller, settings);
+
+    float* scales = malloc(trace->FrameCount * sizeof(float));
+    float* gpuMilliseconds = malloc(trace->FrameCount * sizeof(float));
+    float* expected = malloc(trace->FrameCount * sizeof(float));
+    if (scales == NULL || gpuMilliseconds == NULL || expected == NULL)
+    {
+        free(scales);
+        free(gpuMilliseconds);
+        free(expected);
+        return false;
+    }
+
+    // Whether the target can be held is judged by the average around a frame, picking frames by
+    // their own noisy time would only keep the expensive ones
+    for (uint32_t i = 0; i < trace->FrameCount; ++i)
+    {
+        uint32_t first = i > EXPECTED_FRAMES / 2 ? i - EXPECTED_FRAMES / 2 : 0;
+        uint32_t last = i + EXPECTED_FRAMES / 2 < trace->FrameCount ? i + EXPECTED_FRAMES / 2 : trace->FrameCount - 1;
+        float sum = 0.0f;
+        for (uint32_t j = first; j <= last; ++j)
+            sum += trace->Milliseconds[j];
+        expected[i] = sum / (last - first + 1);
+    }
+
+    double holdError = 0.0;
+    uint32_t holdFrames = 0;
+    uint32_t overFrames = 0;
+    uint32_t measuredFrames = 0;
+    double scaleError = 0.0;
+    uint32_t changes = 0;
+    uint32_t flips = 0;
+    int previousDirection = 0;
+    uint32_t previousChange = 0;
+    float scale = controller.Scale;
+    for (uint32_t i = 0; i < trace->FrameCount; ++i)
+    {
+        if (i >= LATENCY_FRAMES)
+        {
+            uint32_t measured = i - LATENCY_FRAMES;
+            float nextScale = DynamicResolution_Update(&controller, gpuMilliseconds[measured], scales[measured]);
+            if (nextScale != scale && i >= WARM_UP_FRAMES)
+            {
+                int direction = nextScale > scale ? 1 : -1;
+                flips += previousDirection != 0 && direction != previousDirection && i - previousChange < FLIP_FRAMES;
+                previousDirection = direction;
+                previousChange = i;
+                changes++;
+            }
+            scale = nextScale;
+        }
+        scales[i] = scale;
+        gpuMilliseconds[i] = GetGpuMilliseconds(trace->Milliseconds[i], scale);
+
+        if (i < WARM_UP_FRAMES)
+            continue;
+        measuredFrames++;
+        float idealScale = GetIdealScale(settings, expected[i]);
+        scaleError += fabsf(scale - idealScale);
+        overFrames += gpuMilliseconds[i] > 1.1f * settings->TargetMilliseconds;
+        // The target can only be held between the bounds
+        if (idealScale > settings->MinScale && idealScale < settings->MaxScale)
+        {
+            holdError += gpuMilliseconds[i];
+            holdFrames++;
+        }
+    }
+
+    // Noise makes single frames miss it anyway, the mean of them has to hit it
+    double meanHoldError = holdFrames > 0 ? fabs(holdError / holdFrames / settings->TargetMilliseconds - 1.0) : 0.0;
+    double flipRate = measuredFrames > 0 ? (double)flips / measuredFrames : 0.0;
+    bool held = meanHoldError <= MAX_HOLD_ERROR && flipRate <= MAX_FLIP_RATE;
+    printf("%-8s %-44s %5.1f%% off target, %5.1f%% over by 10%%, scale off by %.3f, %4u changes, %3u flips %s\n",
+           trace->Name, trace->Description, meanHoldError * 100.0, 100.0 * overFrames / measuredFrames,
+           scaleError / measuredFrames, changes, flips, !check ? "" : held ? "ok" : "FAILED");
+
+    free(scales);
+    free(gpuMilliseconds);
+    free(expected);
+    return !check || held;
+}
+
+int main(int argc, char** argv)
+{
+    float target = 14.0f;
+    uint32_t frameCount = 3000;
+    const char* tracePath = NULL;
+    g_Random = 0x9E3779B97F4A7C15ull;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--target") == 0 && i + 1 < argc)
+            target = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frameCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            g_Random = strtoull(argv[++i], NULL, 0) | 1;
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: resolution-sim [--target MS] [--frames N] [--seed N] [--trace FILE]\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (!(target > 0.0f) || frameCount <= WARM_UP_FRAMES)
+    {
+        fprintf(stderr, "The target has to be positive and the traces longer than %u frames\n", WARM_UP_FRAMES);
+        return EXIT_FAILURE;
+    }
+
+    DynamicResolutionSettings settings;
+    DynamicResolution_GetDefaultSettings(&settings, target);
+    printf("Target %.2f ms, scale %.2f to %.2f, %u frames of latency, %.0f%% of the time fixed\n", target,
+           settings.MinScale, settings.MaxScale, LATENCY_FRAMES, FIXED_FRACTION * 100.0f);
+
+    bool passed = true;
+    const char* names[] = { "steady", "light", "step", "ramp", "spikes", "noisy" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    {
+        Trace trace;
+        if (!GenerateTrace(&trace, names[i], frameCount))
+            return EXIT_FAILURE;
+        passed = Replay(&trace, &settings, true) && passed;
+        free(trace.Milliseconds);
+    }
+
+    if (tracePath != NULL)
+    {
+        Trace trace;
+        if (!LoadTrace(&trace, tracePath))
+        {
+            fprintf(stderr, "Can't read a trace of more than %u frames from %s\n", WARM_UP_FRAMES, tracePath);
+            free(trace.Milliseconds);
+            return EXIT_FAILURE;
+        }
+        Replay(&trace, &settings, false);
+        free(trace.Milliseconds);
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
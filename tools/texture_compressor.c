@@ -0,0 +1,338 @@
+// Compresses an RGBA8 image to a BCn DDS file and reports the encoding throughput and the
+// quality of the file read back. With --mips the full mip chain is generated first, timed
+// against the scalar reference, and every level is compressed into the file.
+//
+//   texture-compressor <input.tga | --synthetic WxH> <output.dds> [--format bc1|bc3|bc5|bc7]
+//                      [--mips box|kaiser] [--srgb] [--threads N] [--runs N]
+
+#include "block_compression.h"
+#include "dds.h"
+#include "mip_generator.h"
+#include "parallel.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TGA_HEADER_SIZE 18
+#define TGA_TRUECOLOR 2
+#define TGA_TRUECOLOR_RLE 10
+#define TGA_TOP_LEFT 0x20
+
+typedef struct Image
+{
+    uint8_t* Rgba;
+    uint32_t Width;
+    uint32_t Height;
+} Image;
+
+static double GetSeconds(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+// Uncompressed or run-length encoded 24 and 32 bit true color
+static bool LoadTga(const char* path, Image* image)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    uint8_t header[TGA_HEADER_SIZE];
+    bool loaded = fread(header, sizeof(header), 1, file) == 1 && fseek(file, header[0], SEEK_CUR) == 0;
+    int type = header[2];
+    int bytesPerPixel = header[16] / 8;
+    image->Width = (uint32_t)(header[12] | header[13] << 8);
+    image->Height = (uint32_t)(header[14] | header[15] << 8);
+    loaded = loaded && header[1] == 0 && (type == TGA_TRUECOLOR || type == TGA_TRUECOLOR_RLE) &&
+             (bytesPerPixel == 3 || bytesPerPixel == 4) && image->Width > 0 && image->Height > 0;
+
+    image->Rgba = loaded ? malloc((size_t)image->Width * image->Height * 4) : NULL;
+    size_t pixelCount = (size_t)image->Width * image->Height;
+    for (size_t i = 0; image->Rgba != NULL && i < pixelCount;)
+    {
+        // A raw run of one pixel unless the image is run-length encoded
+        size_t runLength = 1;
+        bool repeat = false;
+        if (type == TGA_TRUECOLOR_RLE)
+        {
+            int packet = fgetc(file);
+            if (packet == EOF)
+                break;
+            runLength = (size_t)(packet & 0x7F) + 1;
+            repeat = (packet & 0x80) != 0;
+        }
+
+        uint8_t bgra[4] = { 0, 0, 0, 255 };
+        for (size_t j = 0; j < runLength && i < pixelCount; ++j, ++i)
+        {
+            if ((j == 0 || !repeat) && fread(bgra, (size_t)bytesPerPixel, 1, file) != 1)
+            {
+                free(image->Rgba);
+                image->Rgba = NULL;
+                break;
+            }
+
+            // Bottom-up unless the descriptor says otherwise
+            size_t x = i % image->Width;
+            size_t y = i / image->Width;
+            if (!(header[17] & TGA_TOP_LEFT))
+                y = image->Height - 1 - y;
+            uint8_t* pixel = image->Rgba + (y * image->Width + x) * 4;
+            pixel[0] = bgra[2];
+            pixel[1] = bgra[1];
+            pixel[2] = bgra[0];
+            pixel[3] = bytesPerPixel == 4 ? bgra[3] : 255;
+        }
+    }
+
+    fclose(file);
+    return image->Rgba != NULL;
+}
+
+// Smooth gradients, hard edges and a soft alpha falloff, the cases the formats differ on
+static bool CreateSyntheticImage(uint32_t width, uint32_t height, Image* image)
+{
+    image->Width = width;
+    image->Height = height;
+    image->Rgba = malloc((size_t)width * height * 4);
+    if (image->Rgba == NULL)
+        return false;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            float u = (float)x / width;
+            float v = (float)y / height;
+            float radius = sqrtf((u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f));
+            bool checker = ((x / 32) + (y / 32)) & 1;
+
+            uint8_t* pixel = image->Rgba + ((size_t)y * width + x) * 4;
+            pixel[0] = (uint8_t)(255.0f * u);
+            pixel[1] = (uint8_t)(127.5f + 127.5f * sinf(12.0f * radius));
+            pixel[2] = checker ? 200 : (uint8_t)(255.0f * v);
+            pixel[3] = (uint8_t)(255.0f * fmaxf(0.0f, 1.0f - 1.5f * radius));
+        }
+    }
+    return true;
+}
+
+static TextureFormat ParseFormat(const char* name)
+{
+    static const TextureFormat formats[] = {
+        TEXTURE_FORMAT_BC1, TEXTURE_FORMAT_BC3, TEXTURE_FORMAT_BC5, TEXTURE_FORMAT_BC7
+    };
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+    {
+        const char* formatName = TextureFormat_GetName(formats[i]);
+        if (strlen(name) == strlen(formatName) &&
+            (name[0] == formatName[0] || name[0] == formatName[0] + ('a' - 'A')) &&
+            (name[1] == formatName[1] || name[1] == formatName[1] + ('a' - 'A')) && name[2] == formatName[2])
+            return formats[i];
+    }
+    return TEXTURE_FORMAT_UNKNOWN;
+}
+
+// Largest difference of a channel between two chains of the same size
+static int GetMaxDifference(const MipChain* first, const MipChain* second)
+{
+    int maxDifference = 0;
+    for (uint32_t i = 0; i < first->LevelCount; ++i)
+    {
+        const MipLevel* level = &first->Levels[i];
+        for (uint32_t y = 0; y < level->Height; ++y)
+        {
+            const uint8_t* a = level->Rgba + y * level->RowPitch;
+            const uint8_t* b = second->Levels[i].Rgba + y * second->Levels[i].RowPitch;
+            for (size_t x = 0; x < (size_t)level->Width * 4; ++x)
+                maxDifference = abs(a[x] - b[x]) > maxDifference ? abs(a[x] - b[x]) : maxDifference;
+        }
+    }
+    return maxDifference;
+}
+
+static int PrintUsage(void)
+{
+    fprintf(stderr, "usage: texture-compressor <input.tga | --synthetic WxH> <output.dds> "
+                    "[--format bc1|bc3|bc5|bc7] [--mips box|kaiser] [--srgb] [--threads N] [--runs N]\n");
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char** argv)
+{
+    const char* input = NULL;
+    const char* output = NULL;
+    uint32_t syntheticWidth = 0;
+    uint32_t syntheticHeight = 0;
+    TextureFormat format = TEXTURE_FORMAT_BC7;
+    bool mips = false;
+    MipFilter filter = MIP_FILTER_BOX;
+    bool srgb = false;
+    uint32_t threadCount = 0;
+    int runCount = 3;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &syntheticWidth, &syntheticHeight) != 2)
+                return PrintUsage();
+        }
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+            format = ParseFormat(argv[++i]);
+        else if (strcmp(argv[i], "--mips") == 0 && i + 1 < argc)
+        {
+            mips = true;
+            ++i;
+            if (strcmp(argv[i], "kaiser") == 0)
+                filter = MIP_FILTER_KAISER;
+            else if (strcmp(argv[i], "box") != 0)
+                return PrintUsage();
+        }
+        else if (strcmp(argv[i], "--srgb") == 0)
+            srgb = true;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threadCount = (uint32_t)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+            runCount = atoi(argv[++i]);
+        else if (input == NULL && syntheticWidth == 0 && argv[i][0] != '-')
+            input = argv[i];
+        else if (output == NULL && argv[i][0] != '-')
+            output = argv[i];
+        else
+            return PrintUsage();
+    }
+    if ((input == NULL && syntheticWidth == 0) || output == NULL || format == TEXTURE_FORMAT_UNKNOWN || runCount < 1)
+        return PrintUsage();
+
+    Image image;
+    if (input != NULL ? !LoadTga(input, &image) : !CreateSyntheticImage(syntheticWidth, syntheticHeight, &image))
+    {
+        fprintf(stderr, "Can't load %s\n", input != NULL ? input : "the synthetic image");
+        return EXIT_FAILURE;
+    }
+
+    // Workers less one, the calling thread takes part as well. Without the job system
+    // ParallelFor runs serially, which is what a single thread asks for.
+    bool parallel = threadCount != 1;
+    if (parallel && !Parallel_Initialise(threadCount > 1 ? threadCount - 1 : 0))
+        return EXIT_FAILURE;
+
+    // A single level is a chain of one, the image itself
+    MipChain chain;
+    double fastestMips = INFINITY;
+    double fastestScalarMips = INFINITY;
+    int maxDifference = 0;
+    for (int run = 0; run < (mips ? runCount : 1); ++run)
+    {
+        double start = GetSeconds();
+        bool generated = GenerateMips(image.Rgba, image.Width, image.Height, (size_t)image.Width * 4, srgb, filter,
+                                      mips ? 0 : 1, &chain);
+        fastestMips = fmin(fastestMips, GetSeconds() - start);
+        if (!generated)
+            return EXIT_FAILURE;
+        if (run + 1 < (mips ? runCount : 1))
+            MipChain_Release(&chain);
+    }
+    for (int run = 0; mips && run < runCount; ++run)
+    {
+        MipChain reference;
+        double start = GetSeconds();
+        if (!GenerateMipsScalar(image.Rgba, image.Width, image.Height, (size_t)image.Width * 4, srgb, filter, 0, &reference))
+            return EXIT_FAILURE;
+        fastestScalarMips = fmin(fastestScalarMips, GetSeconds() - start);
+        maxDifference = GetMaxDifference(&chain, &reference);
+        MipChain_Release(&reference);
+    }
+
+    DdsTexture texture = {
+        .Format = format,
+        .Srgb = srgb,
+        .Width = image.Width,
+        .Height = image.Height,
+        .MipCount = chain.LevelCount
+    };
+    size_t compressedSize = 0;
+    for (uint32_t i = 0; i < chain.LevelCount; ++i)
+    {
+        texture.Mips[i].Width = chain.Levels[i].Width;
+        texture.Mips[i].Height = chain.Levels[i].Height;
+        texture.Mips[i].RowPitch = TextureFormat_GetRowPitch(format, chain.Levels[i].Width);
+        texture.Mips[i].SlicePitch = texture.Mips[i].RowPitch * TextureFormat_GetRowCount(format, chain.Levels[i].Height);
+        compressedSize += texture.Mips[i].SlicePitch;
+    }
+
+    size_t rowPitch = (size_t)image.Width * 4;
+    uint8_t* blocks = malloc(compressedSize);
+    uint8_t* decoded = malloc(rowPitch * image.Height);
+    if (blocks == NULL || decoded == NULL)
+        return EXIT_FAILURE;
+    size_t offset = 0;
+    for (uint32_t i = 0; i < chain.LevelCount; ++i)
+    {
+        texture.Mips[i].Data = blocks + offset;
+        offset += texture.Mips[i].SlicePitch;
+    }
+
+    double fastest = INFINITY;
+    for (int run = 0; run < runCount; ++run)
+    {
+        double start = GetSeconds();
+        for (uint32_t i = 0; i < chain.LevelCount; ++i)
+        {
+            const MipLevel* level = &chain.Levels[i];
+            CompressImage(level->Rgba, level->Width, level->Height, level->RowPitch, format, (void*)texture.Mips[i].Data);
+        }
+        fastest = fmin(fastest, GetSeconds() - start);
+    }
+
+    if (!Dds_Save(output, &texture))
+    {
+        fprintf(stderr, "Can't write %s\n", output);
+        return EXIT_FAILURE;
+    }
+
+    // Measured on the file read back, so the header round trip is checked too
+    DdsTexture written;
+    bool matches = Dds_Load(output, &written) && written.Format == format && written.Width == image.Width &&
+                   written.Height == image.Height && written.MipCount == chain.LevelCount;
+    for (uint32_t i = 0; matches && i < chain.LevelCount; ++i)
+        matches = memcmp(written.Mips[i].Data, texture.Mips[i].Data, texture.Mips[i].SlicePitch) == 0;
+    if (!matches || !DecompressImage(written.Mips[0].Data, written.Format, written.Width, written.Height, decoded, rowPitch))
+    {
+        fprintf(stderr, "%s doesn't read back as written\n", output);
+        return EXIT_FAILURE;
+    }
+
+    // Every level counts towards the compression throughput, the top one towards the mips
+    double megapixels = (double)image.Width * image.Height * 1e-6;
+    double levelMegapixels = 0.0;
+    for (uint32_t i = 0; i < chain.LevelCount; ++i)
+        levelMegapixels += (double)chain.Levels[i].Width * chain.Levels[i].Height * 1e-6;
+    uint32_t threads = parallel ? Parallel_GetThreadCount() : 1;
+    if (mips)
+    {
+        printf("%s mips %ux%u, %u levels, %u threads: %.2f ms, %.1f MPixel/s, scalar %.2f ms, %.1f MPixel/s, "
+               "max difference %d\n", filter == MIP_FILTER_KAISER ? "Kaiser" : "Box", image.Width, image.Height,
+               chain.LevelCount, threads, fastestMips * 1000.0, megapixels / fastestMips,
+               fastestScalarMips * 1000.0, megapixels / fastestScalarMips, maxDifference);
+    }
+    printf("%s %ux%u, %u threads: %.2f ms, %.1f MPixel/s, %.1f:1, PSNR %.2f dB\n",
+           TextureFormat_GetName(format), image.Width, image.Height, threads, fastest * 1000.0,
+           levelMegapixels / fastest, levelMegapixels * 4e6 / compressedSize,
+           ComputePsnr(image.Rgba, decoded, image.Width, image.Height, rowPitch, GetStoredChannelMask(format)));
+
+    Dds_Release(&written);
+    free(decoded);
+    free(blocks);
+    MipChain_Release(&chain);
+    free(image.Rgba);
+    if (parallel)
+        Parallel_Shutdown();
+    return EXIT_SUCCESS;
+}